@@ -0,0 +1,119 @@
+#ifndef ARROW_WRITER_H
+#define ARROW_WRITER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Arrow logical types produced by the exporter. */
+enum ArrowTypeId {
+  ARROW_TYPE_INT,
+  ARROW_TYPE_FLOAT,
+  ARROW_TYPE_DOUBLE,
+  ARROW_TYPE_UTF8,
+  ARROW_TYPE_BINARY,
+  ARROW_TYPE_DATE32,
+  ARROW_TYPE_TIMESTAMP_US
+};
+
+/** One field of an Arrow schema. */
+struct ArrowField {
+  std::string name;
+  ArrowTypeId type;
+  /** Width of an ARROW_TYPE_INT in bits: 8, 16, 32 or 64 */
+  uint32_t bit_width;
+  bool is_signed;
+  bool nullable;
+  /** Time zone of an ARROW_TYPE_TIMESTAMP_US, empty for a local time */
+  std::string timezone;
+};
+
+/** Columnar buffers (validity bitmap, offsets and values) of one field for
+the record batch being built. */
+class ArrowColumnBuilder {
+public:
+  explicit ArrowColumnBuilder(const ArrowField &field);
+
+  void AppendNull();
+  /** Append to an ARROW_TYPE_INT, ARROW_TYPE_DATE32 or
+  ARROW_TYPE_TIMESTAMP_US column. */
+  void AppendInt(int64_t v);
+  /** Append n values of an ARROW_TYPE_INT column in host byte order.
+  @param[in]	values	n values of bit_width / 8 bytes
+  @param[in]	valid	n flags, 0 for a null value */
+  void AppendInts(const void *values, const uint8_t *valid, size_t n);
+  /** Append to an ARROW_TYPE_FLOAT or ARROW_TYPE_DOUBLE column. */
+  void AppendDouble(double v);
+  /** Append to an ARROW_TYPE_UTF8 or ARROW_TYPE_BINARY column. */
+  void AppendBytes(const void *data, size_t len);
+  /** Append Latin-1 text to an ARROW_TYPE_UTF8 column. */
+  void AppendLatin1(const void *data, size_t len);
+  /** Append a value of an ARROW_TYPE_UTF8 or ARROW_TYPE_BINARY column a
+  part at a time, then end it with FinishBytes(), or drop the parts with
+  DiscardBytes(). */
+  void AppendBytesPart(const void *data, size_t len);
+  void AppendLatin1Part(const void *data, size_t len);
+  void FinishBytes();
+  void DiscardBytes();
+
+  void Reset();
+
+  int64_t length() const { return length_; }
+  int64_t null_count() const { return null_count_; }
+  const ArrowField &field() const { return field_; }
+  bool is_var_width() const {
+    return field_.type == ARROW_TYPE_UTF8 || field_.type == ARROW_TYPE_BINARY;
+  }
+  const std::vector<uint8_t> &validity() const { return validity_; }
+  const std::vector<int32_t> &offsets() const { return offsets_; }
+  const std::vector<uint8_t> &values() const { return values_; }
+
+private:
+  void SetValid(bool valid);
+  /** Width in bytes of a fixed-width value */
+  uint32_t ValueWidth() const;
+
+  ArrowField field_;
+  int64_t length_;
+  int64_t null_count_;
+  std::vector<uint8_t> validity_;
+  std::vector<int32_t> offsets_;
+  std::vector<uint8_t> values_;
+};
+
+/** Writer of the Arrow IPC file format (Feather v2). The schema is written
+by Open(), every WriteBatch() appends one record batch and Close() writes
+the footer. */
+class ArrowFileWriter {
+public:
+  ArrowFileWriter();
+  ~ArrowFileWriter();
+
+  /** @return 0 on success, -1 on error */
+  int Open(const char *path, const std::vector<ArrowField> &fields);
+  /** Write the builders as one record batch and reset them.
+  @return 0 on success, -1 on error */
+  int WriteBatch(std::vector<ArrowColumnBuilder> &columns);
+  /** @return 0 on success, -1 on error */
+  int Close();
+
+  uint64_t n_batches() const { return batches_.size(); }
+
+private:
+  struct Block {
+    int64_t offset;
+    int32_t metadata_len;
+    int64_t body_len;
+  };
+
+  int Write(const void *data, size_t len);
+  int WriteMessage(const std::vector<uint8_t> &metadata,
+                   const std::vector<uint8_t> &body, Block *block);
+
+  int fd_;
+  int64_t pos_;
+  std::vector<ArrowField> fields_;
+  std::vector<Block> batches_;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef DBLWR_H
+#define DBLWR_H
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "include/udef.h"
+
+/** Checksum written instead of a checksum by innodb_checksum_algorithm=none */
+static const uint32_t BUF_NO_CHECKSUM_MAGIC = 0xDEADBEEFUL;
+
+/** Pages written back by one pwrite() of a restoration */
+static const uint32_t DBLWR_WRITE_PAGES = 64;
+
+/** @return whether a page is all zeroes, never written */
+bool page_is_zero(const byte *page);
+
+/** Check a page read from a data file: its checksums of the crc32 (in
+either byte order), innodb or none algorithm, and the low 4 bytes of
+FIL_PAGE_LSN repeated at the end of the page, which tell a torn write.
+@return whether the page is corrupt */
+bool page_is_corrupted(const byte *page);
+
+/** Counters of the doublewrite copies read. */
+struct DblwrStats {
+  DblwrStats()
+      : n_files(0), n_slots(0), n_empty(0), n_invalid(0), n_superseded(0) {}
+
+  uint64_t n_files;
+  /** Page slots of the doublewrite files and blocks */
+  uint64_t n_slots;
+  /** Slots never written */
+  uint64_t n_empty;
+  /** Slots holding a corrupt or torn copy, left out */
+  uint64_t n_invalid;
+  /** Valid copies of a page replaced by a copy with a higher LSN */
+  uint64_t n_superseded;
+};
+
+/** The page copies of the doublewrite buffer of an instance: the
+#ib_<page size>_<n>.dblwr files of MySQL 8.0.20 and later, or the two
+blocks of the system tablespace of earlier versions. Only the valid copy
+with the highest FIL_PAGE_LSN of each page is kept, in memory: the buffer
+holds few pages. */
+class DblwrSet {
+ public:
+  /** Read a doublewrite file. A file whose name ends in .dblwr is a
+  sequence of page copies, anything else is read as the data files of a
+  system tablespace, see sys_space_parse(), and its doublewrite blocks are
+  found from the TRX_SYS page.
+  @param[in]	spec	file name or data file list
+  @return 0 on success, -1 on error */
+  int AddFile(const char *spec);
+
+  /** @return the newest valid copy of a page, nullptr if none */
+  const byte *Find(uint32_t space_id, uint32_t page_no) const;
+
+  /** @return number of pages with a copy */
+  size_t n_pages() const { return index_.size(); }
+
+  const DblwrStats &stats() const { return stats_; }
+
+ private:
+  /** Keep a copy of a page if it is valid and newer than the one kept. */
+  void AddCopy(const byte *page);
+
+  static uint64_t Key(uint32_t space_id, uint32_t page_no) {
+    return (uint64_t)space_id << 32 | page_no;
+  }
+
+  /** Copies, UNIV_PAGE_SIZE bytes each */
+  std::vector<byte> pages_;
+  /** Key to index of the copy in pages_ */
+  std::unordered_map<uint64_t, size_t> index_;
+  DblwrStats stats_;
+};
+
+/** Outcome of the restoration of a tablespace. */
+struct DblwrRestoreStats {
+  DblwrRestoreStats()
+      : n_pages(0),
+        n_corrupt(0),
+        n_restored(0),
+        n_no_copy(0),
+        n_stale_copy(0),
+        n_writes(0) {}
+
+  /** Pages read */
+  uint64_t n_pages;
+  /** Corrupt, torn or zeroed pages found */
+  uint64_t n_corrupt;
+  /** Of n_corrupt, the pages with a copy written back */
+  uint64_t n_restored;
+  /** Of n_corrupt, the pages with no valid copy, left as they are */
+  uint64_t n_no_copy;
+  /** Of n_corrupt, the pages whose copy is older than the LSN of the page,
+  left as they are */
+  uint64_t n_stale_copy;
+  /** pwrite() calls */
+  uint64_t n_writes;
+  /** Page numbers of the corrupt pages */
+  std::vector<uint32_t> corrupt_pages;
+};
+
+/** Check every page of a tablespace and replace the corrupt ones by their
+doublewrite copy. A page is restored when it is corrupt (see
+page_is_corrupted()) or all zeroes while a valid copy of it exists, and
+the copy is at least as new as the page: the LSN of a page whose header
+is intact must not exceed the LSN of the copy. The copies are written in
+page order, runs of adjacent pages with one pwrite() each, and the file
+is synced once at the end.
+@param[in]	fd		tablespace file, opened for writing unless
+				dry_run
+@param[in]	space_id	id of the tablespace
+@param[in]	dblwr		the doublewrite copies
+@param[in]	dry_run		only count and list, write nothing
+@param[out]	stats		outcome
+@return 0 on success, -1 on a read or write error */
+int dblwr_restore(int fd, uint32_t space_id, const DblwrSet &dblwr,
+                  bool dry_run, DblwrRestoreStats *stats);
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef FLASHBACK_H
+#define FLASHBACK_H
+
+#include <stdint.h>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "include/udef.h"
+#include "include/table_scan.h"
+
+/** Roll pointer fields (DB_ROLL_PTR): the insert flag, the undo space
+number, the page and the offset of the undo record */
+static const uint32_t ROLL_PTR_INSERT_FLAG_POS = 55;
+static const uint32_t ROLL_PTR_SPACE_NUM_POS = 48;
+static const uint32_t ROLL_PTR_PAGE_POS = 16;
+
+/** Pages kept by the undo page cache of a flashback */
+static const uint32_t FLASHBACK_CACHE_PAGES = 4096;
+/** Rows of a flashback window */
+static const size_t FLASHBACK_WINDOW_ROWS = 65536;
+/** Versions of a record rolled back before its history is given up as
+corrupt */
+static const uint32_t FLASHBACK_MAX_VERSIONS = 100000;
+
+/** @return key of an undo page in an UndoPageCache */
+static inline uint64_t undo_page_key(uint32_t space_num, uint32_t page_no) {
+  return (uint64_t)space_num << 32 | page_no;
+}
+
+/** @return undo space number of a tablespace id, the number roll pointers
+refer to an undo tablespace with, 0 for the system tablespace */
+uint32_t undo_space_id2num(uint32_t space_id);
+
+/** Undo log pages of a set of undo tablespaces, by the space number of
+the roll pointers. Holds at most capacity pages, the least recently used
+one is replaced. The pages are loaded a set at a time, those not cached
+sorted by file and page and read with one pread() per run of adjacent
+pages. */
+class UndoPageCache {
+ public:
+  explicit UndoPageCache(uint32_t capacity);
+  ~UndoPageCache();
+
+  UndoPageCache(const UndoPageCache &) = delete;
+  UndoPageCache &operator=(const UndoPageCache &) = delete;
+
+  /** Add an undo tablespace, or the system tablespace for the undo logs
+  written before undo tablespaces existed. Its space number is read from
+  the FSP header.
+  @param[in]	fd	tablespace file, owned by the caller
+  @return the space number, or -1 on a read error or a duplicate number */
+  int AddFile(int fd);
+
+  uint32_t capacity() const { return capacity_; }
+
+  /** Make a set of pages resident, replacing pages not in the set.
+  @param[in]	keys	distinct keys sorted ascending, at most capacity()
+  @return 0 on success, -1 on a read error */
+  int Load(const std::vector<uint64_t> &keys);
+
+  /** @return a page of the last Load(), nullptr if its space was not added
+  or the page is beyond the end of the file */
+  const byte *Get(uint64_t key) const;
+
+  /** Pages found in the cache, pages read and pread() calls */
+  uint64_t n_hits() const { return n_hits_; }
+  uint64_t n_pages_read() const { return n_pages_read_; }
+  uint64_t n_reads() const { return n_reads_; }
+
+ private:
+  struct Space {
+    int fd;
+    uint64_t n_pages;
+  };
+  struct Slot {
+    uint32_t frame;
+    std::list<uint64_t>::iterator lru;
+  };
+
+  const uint32_t capacity_;
+  byte *frames_;
+  std::vector<uint32_t> free_frames_;
+  std::unordered_map<uint32_t, Space> spaces_;
+  std::unordered_map<uint64_t, Slot> slots_;
+  /** Keys of the resident pages, the most recently used first */
+  std::list<uint64_t> lru_;
+  uint64_t n_hits_;
+  uint64_t n_pages_read_;
+  uint64_t n_reads_;
+};
+
+/** A field of a reconstructed row, see rec_field_get(). An externally
+stored field is its local prefix followed by the LOB reference. */
+struct FlashbackField {
+  const byte *data;
+  ulint len;
+  bool is_null;
+  bool is_extern;
+};
+
+/** Counters of a flashback. */
+struct FlashbackStats {
+  FlashbackStats()
+      : n_leaf_pages(0),
+        n_records(0),
+        n_rows(0),
+        n_rebuilt(0),
+        n_versions(0),
+        n_inserted_after(0),
+        n_deleted(0),
+        n_history_missing(0),
+        n_rounds(0) {}
+
+  uint64_t n_leaf_pages;
+  /** Records of the clustered index, delete-marked ones included */
+  uint64_t n_records;
+  /** Rows of the table as of the transaction */
+  uint64_t n_rows;
+  /** Rows changed since, of n_rows, rebuilt from the undo logs */
+  uint64_t n_rebuilt;
+  /** Undo records applied */
+  uint64_t n_versions;
+  /** Records inserted since, the row did not exist */
+  uint64_t n_inserted_after;
+  /** Rows deleted at the time, delete-marked and not purged yet */
+  uint64_t n_deleted;
+  /** Records whose older versions were purged or are in an undo
+  tablespace that was not given, left out */
+  uint64_t n_history_missing;
+  /** Batched rounds of undo record reads */
+  uint64_t n_rounds;
+};
+
+/** Callback of flashback_scan() for every row, return false to stop.
+@param[in]	fields	scan.leaf_layout.fields.size() fields of the row */
+typedef std::function<bool(const FlashbackField *fields)> flashback_row_cb;
+
+/** Rebuild the rows of the clustered index of a table as they were seen
+by a transaction: the versions written by transactions with an id lower
+than as_of. The records of the leaf pages are copied, delete-marked ones
+included, into a window of up to FLASHBACK_WINDOW_ROWS rows. The records
+changed since are rolled back together a version per round: the roll
+pointers of a round are sorted, their undo pages loaded at once through
+the cache and the old values of the undo records applied, until every
+row reached a visible version. The window is then passed to cb in key
+order.
+@param[in]	fd	tablespace file of the table
+@param[in]	scan	scan of the clustered index
+@param[in]	cache	undo tablespaces of the instance
+@param[in]	as_of	transaction id
+@param[in]	cb	called for every row
+@param[out]	stats	counters
+@return number of leaf pages visited, or -1 on error */
+int64_t flashback_scan(int fd, const TableScan &scan, UndoPageCache *cache,
+                       uint64_t as_of, const flashback_row_cb &cb,
+                       FlashbackStats *stats);
+
+#endif
@@ -265,5 +265,18 @@ class File_segment_inode {
   fseg_inode_t *m_fseg_inode;
 };
 
+/** Calculates reserved fragment page slots.
+ @return number of fragment pages */
+ulint fseg_get_n_frag_pages(fseg_inode_t *inode);
+
+/** Calculates the number of pages reserved by a segment, and how many
+pages are currently used.
+@param[in]      space_id    Unique tablespace identifier
+@param[in]      inode       File segment inode pointer
+@param[out]     used        Number of pages used (not more than reserved)
+@return number of reserved pages */
+ulint fseg_n_reserved_pages_low(space_id_t space_id, fseg_inode_t *inode,
+                                ulint *used);
+
 /* @} */
 #endif
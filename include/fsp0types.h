@@ -56,6 +56,9 @@ typedef byte fseg_header_t;
      header, in bytes */
 /* @} */
 
+/** Transaction system header page of the system tablespace */
+#define FSP_TRX_SYS_PAGE_NO 5
+
 /** The structure of undo page header */
 #define FSP_RSEG_ARRAY_PAGE_NO      \
   3 /*!< rollback segment directory \
@@ -0,0 +1,144 @@
+#ifndef INDEX_SCAN_H
+#define INDEX_SCAN_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "include/udef.h"
+#include "include/rem0types.h"
+#include "include/rec_decoder.h"
+
+/** Read one page of the tablespace.
+@return 0 on success, -1 on a read error or short read */
+int page_read(int fd, uint32_t page_no, byte *buf);
+
+/** Get the next record in the singly linked record list of a compact page.
+@param[in]	page	page frame
+@param[in]	rec	current record
+@return next record, or nullptr after the last user record or if the link
+points outside of the page */
+const rec_t *page_rec_get_next_comp(const byte *page, const rec_t *rec);
+
+/** @return the first user record of a compact page, or nullptr if empty */
+const rec_t *page_first_user_rec_comp(const byte *page);
+
+/** Get the next record in the record list of a REDUNDANT page, where the
+links are absolute offsets.
+@return next record, or nullptr after the last user record or if the link
+points outside of the page */
+const rec_t *page_rec_get_next_old(const byte *page, const rec_t *rec);
+
+/** @return whether an index page is in the compact format (PAGE_IS_COMPACT
+in PAGE_N_HEAP), false for REDUNDANT */
+bool page_is_comp(const byte *page);
+
+/** @return the infimum record of a page of either format */
+const rec_t *page_get_infimum(const byte *page);
+
+/** Get the next record of a page of either format, see
+page_rec_get_next_comp(). Loops over a whole page pick the function of
+the format once with page_rec_next_func(). */
+const rec_t *page_rec_get_next(const byte *page, const rec_t *rec);
+
+/** @return the first user record of a page of either format, or nullptr */
+const rec_t *page_first_user_rec(const byte *page);
+
+/** Function following the record list of a page */
+typedef const rec_t *(*page_rec_next_func_t)(const byte *page,
+                                             const rec_t *rec);
+
+/** @return the record list function of the format of a page */
+page_rec_next_func_t page_rec_next_func(const byte *page);
+
+/** @return whether a user record of a page is an ordinary record (not a
+node pointer) that is not delete-marked. REDUNDANT records have no
+status, a leaf page holds only ordinary ones. */
+static inline bool page_rec_is_live(const rec_t *rec, bool comp) {
+  return comp ? rec_get_status(rec) == REC_STATUS_ORDINARY &&
+                    !(rec_get_info_bits(rec, true) & REC_INFO_DELETED_FLAG)
+              : !(rec_get_info_bits(rec, false) & REC_INFO_DELETED_FLAG);
+}
+
+/** Descend from the root to the leftmost page of the leaf level, checking
+that each page is an index page of the index of the root, one level below
+its parent.
+@param[in]	fd		tablespace file
+@param[in]	node_layout	node pointer decode plan of the index
+@param[in]	root		root page number
+@param[out]	buf		page buffer, holds the leaf page on return
+@return leftmost leaf page number, or FIL_NULL on error */
+uint32_t btr_leftmost_leaf(int fd, const RecLayout &node_layout,
+                           uint32_t root, byte *buf);
+
+/** Callback of index_scan_leaves(), return false to stop the scan. */
+typedef std::function<bool(const byte *page, uint32_t page_no)> leaf_page_cb;
+
+/** Visit the leaf pages of an index in key order. The scan stops with an
+error on a page of the list that is not a leaf page of the index of the
+root.
+@param[in]	fd		tablespace file
+@param[in]	node_layout	node pointer decode plan of the index
+@param[in]	root		root page number
+@param[in]	cb		called for every leaf page
+@return number of leaf pages visited, or -1 on error */
+int64_t index_scan_leaves(int fd, const RecLayout &node_layout, uint32_t root,
+                          const leaf_page_cb &cb);
+
+/** A search key on the first fields of an index, in stored form. */
+struct SearchTuple {
+  std::vector<std::string> keys;
+  std::vector<bool> pad_space;
+
+  size_t n_fields() const { return keys.size(); }
+};
+
+/** Build a search tuple from comma separated values of the first fields
+of an index, e.g. "42" or "7,abc".
+@param[in]	layout	decode plan of the index
+@param[in]	text	key values
+@param[out]	tuple	search tuple
+@return 0 on success, -1 with a message on stderr on error */
+int search_tuple_build(const RecLayout &layout, const char *text,
+                       SearchTuple *tuple);
+
+/** Compare a search tuple with the first fields of a record.
+@param[in]	tuple	search tuple
+@param[in]	rec	record
+@param[in]	offs	field offsets of the record
+@return negative, 0 or positive as the tuple sorts before, equal to or
+after the record */
+int search_tuple_cmp(const SearchTuple &tuple, const rec_t *rec,
+                     const ulint *offs);
+
+/** Binary search the page directory of a compact page for the last record
+that sorts before a search tuple, then scan forward within the slot.
+@param[in]	page	index page
+@param[in]	layout	decode plan of the records on the page
+@param[in]	tuple	search tuple
+@param[in]	le	also accept a record equal to the tuple
+@param[out]	offs	scratch space for the field offsets
+@return the last user record less than (or equal to) tuple, or the
+infimum */
+const rec_t *page_search(const byte *page, const RecLayout &layout,
+                         const SearchTuple &tuple, bool le, ulint *offs);
+
+/** Descend from the root to the leaf page where the first record not less
+than a search tuple is, reading one page per level. A search for a whole
+clustered index key follows the node pointer equal to it, a search for a
+key prefix the last node pointer less than it, as the prefix may also
+match records on the left sibling. Each page is checked as by
+btr_leftmost_leaf().
+@param[in]	fd		tablespace file
+@param[in]	node_layout	node pointer decode plan of the index
+@param[in]	root		root page number
+@param[in]	tuple		search tuple
+@param[out]	buf		page buffer, holds the leaf page on return
+@param[out]	n_reads		number of pages read
+@return leaf page number, or FIL_NULL on error */
+uint32_t btr_search_leaf(int fd, const RecLayout &node_layout, uint32_t root,
+                         const SearchTuple &tuple, byte *buf,
+                         uint32_t *n_reads);
+
+#endif
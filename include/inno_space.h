@@ -8,6 +8,7 @@
 #include "fil0fil.h"
 #include "page0page.h"
 #include "ut0crc32.h"
+#include "page_decoder.h"
 #include "fsp0fsp.h"
 #include "fsp0types.h"
 #include "page0types.h"
@@ -22,12 +23,31 @@ public:
     ~InnoSpace();
 
     void SetSdiPath(const char* sdi);
+    void SetWhere(const char* where);
+    void SetColumns(const char* columns);
+    void SetIndex(const char* index);
+    void SetSalvage(bool undelete);
+    void SetThreads(uint32_t n_threads);
+    void SetSchemaCache();
 
     void ShowSpaceHeader();
     void ShowSpacePageType();
+    void ShowSysSpace();
     void ShowIndexSummary();
     void ShowUndoFile();
+    void ShowUndoRecords();
+    void ShowUndoHistory();
+    void ShowUndoUsage();
+    void ShowTrxTimeline(const char* lo, const char* hi, bool by_trx_no,
+                         uint64_t table_id);
+    /** Reads the redo log only, no tablespace is opened */
+    static void ShowRedoLog(const char* redo_paths, uint64_t since_lsn,
+                            uint32_t top, bool list_pages);
+    void Flashback(uint64_t as_of, const char* undo_paths);
     void DumpAllRecords();
+    void LookupRecords(const char* lo, const char* hi);
+    void ShowColumnUsage();
+    void ExportArrow(const char* out_path, uint32_t batch_rows);
 
     void ShowFILHeader(uint32_t page_num, uint16_t* type);
     void ShowIndexHeader(uint32_t page_num, bool show_records);
@@ -38,28 +58,27 @@ public:
     void ShowUndoPageHeader(uint32_t page_num);
     void ShowRsegArray(uint32_t page_num, uint32_t* rseg_array = nullptr);
     void DeletePage(uint32_t page_num);
+    void RestoreFromDoublewrite(const char* dblwr_paths, bool dry_run);
+    void RedoApply(const char* redo_paths, const char* page_list,
+                   uint64_t target_lsn, bool dry_run);
     void UpdateCheckSum(uint32_t page_num);
 
 private:
-    struct dict_col {
-        std::string col_name;
-        std::string column_type_utf8;
-        int char_length{};
-    };
-
-    int rec_init_offsets();
-    void ShowRecord(rec_t* rec);
     void ShowUndoLogHdr(uint32_t page_num, uint32_t page_offset);
     void ShowUndoRseg(uint32_t rseg_id, uint32_t page_num);
 
 public:
     static char path_[1024];
     static char sdi_path_[1024];
+    static std::string where_;
+    static std::string columns_;
+    static std::string index_;
+    static bool salvage_;
+    static bool undelete_;
+    static uint32_t threads_;
     static int fd_;
     static byte* read_buf_;
     static byte* inode_page_buf_;
-    static ulint offsets_[REC_OFFS_NORMAL_SIZE];
-    static std::vector<dict_col> dict_cols_;
 };
 
 #endif // INNO_SPACE_H
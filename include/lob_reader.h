@@ -0,0 +1,106 @@
+#ifndef LOB_READER_H
+#define LOB_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+#include "include/udef.h"
+
+struct z_stream_s;
+
+/** Offsets in the reference to an externally stored field */
+static const ulint BTR_EXTERN_SPACE_ID = 0;
+static const ulint BTR_EXTERN_PAGE_NO = 4;
+/** Offset of the BLOB header of an old format BLOB, the LOB version of a
+new format LOB */
+static const ulint BTR_EXTERN_OFFSET = 8;
+/** 8 bytes: the flags in the most significant byte and the length of the
+externally stored part in the 4 least significant bytes */
+static const ulint BTR_EXTERN_LEN = 12;
+
+/** Flags in the most significant byte of BTR_EXTERN_LEN */
+static const ulint BTR_EXTERN_OWNER_FLAG = 128;
+static const ulint BTR_EXTERN_INHERITED_FLAG = 64;
+
+/** Pages of a LOB read with one batch of reads */
+static const uint32_t LOB_BATCH_PAGES = 64;
+
+/** Receives the parts of an externally stored value in order.
+@return false to stop reading the value */
+typedef std::function<bool(const byte *data, ulint len)> lob_part_cb;
+
+/** Reader of the values of externally stored columns. A new format LOB is
+read by following the index list of its first page to the data pages,
+which are read in batches of up to LOB_BATCH_PAGES, every run of
+contiguous pages with one read, while the next batch is prefetched. An
+old format BLOB is a chain of pages, the read of the next page is started
+as soon as its number is known, before the part of the current page is
+consumed. A compressed BLOB is one zlib stream split across a chain of
+pages, fed page by page into one inflate stream reused for every value,
+the output is passed on every LOB_BATCH_PAGES pages worth of bytes. Only
+one batch of a value is in memory at a time. */
+class LobReader {
+ public:
+  explicit LobReader(int fd);
+  ~LobReader();
+
+  LobReader(const LobReader &) = delete;
+  LobReader &operator=(const LobReader &) = delete;
+
+  /** Stream an externally stored field: the prefix stored in the record,
+  then the part the reference at its end points to.
+  @param[in]	data	field as stored in the record
+  @param[in]	len	length of the field, reference included
+  @param[in]	cb	receives the parts of the value
+  @return length of the value, or -1 with a message on stderr on error */
+  int64_t ReadField(const byte *data, ulint len, const lob_part_cb &cb);
+
+  /** Stream the externally stored part of a field.
+  @param[in]	ref	BTR_EXTERN_FIELD_REF_SIZE bytes reference
+  @param[in]	cb	receives the parts of the value
+  @return length of the part, or -1 with a message on stderr on error */
+  int64_t Read(const byte *ref, const lob_part_cb &cb);
+
+ private:
+  /** Read a new format LOB (FIL_PAGE_TYPE_LOB_FIRST) whose first page is
+  in first_buf_. */
+  int64_t ReadNew(uint32_t first_page_no, uint64_t len, const lob_part_cb &cb);
+
+  /** Read an old format BLOB, a chain of FIL_PAGE_TYPE_BLOB or
+FIL_PAGE_SDI_BLOB pages whose first page is in first_buf_. The chain must
+not come back to a page and must hold exactly len bytes. */
+  int64_t ReadOld(uint32_t first_page_no, ulint offset, uint64_t len,
+                  uint16_t type, const lob_part_cb &cb);
+
+  /** Read a compressed BLOB, a zlib stream in a FIL_PAGE_TYPE_ZBLOB page
+whose first page is in first_buf_ followed by a chain of
+FIL_PAGE_TYPE_ZBLOB2 pages. The inflated value must be len bytes. */
+  int64_t ReadZip(uint32_t first_page_no, ulint offset, uint64_t len,
+                  const lob_part_cb &cb);
+
+  /** Read a page of page_size_ bytes.
+  @return 0 on success, -1 if the page is out of the file or unreadable */
+  int ReadPage(uint32_t page_no, byte *buf);
+
+  /** Read pages into batch_buf_, a run of contiguous pages at a time.
+  @return 0 on success, -1 on error */
+  int ReadPages(const uint32_t *pages, size_t n);
+
+  /** Ask the kernel to start reading pages that will be needed next. */
+  void Prefetch(const uint32_t *pages, size_t n);
+
+  int fd_;
+  /** Physical page size: the compressed page size of a compressed
+  tablespace, UNIV_PAGE_SIZE otherwise */
+  ulint page_size_;
+  /** Pages in the file, bounds the lists and chains followed */
+  uint64_t n_pages_;
+  byte *first_buf_;
+  byte *index_buf_;
+  byte *batch_buf_;
+  /** Inflate stream of compressed BLOBs, created on first use */
+  struct z_stream_s *zstream_;
+};
+
+#endif
@@ -13,10 +13,16 @@ uint8_t mach_read_from_1(const byte *b);
 
 uint16_t mach_read_from_2(const byte *b);
 
+uint32_t mach_read_from_3(const byte *b);
+
 uint32_t mach_read_from_4(const byte *b);
 
 uint64_t mach_read_from_6(const byte *b);
 
+/** Read 7 bytes, the size of a roll pointer. The most significant byte
+is at the lowest address. */
+uint64_t mach_read_from_7(const byte *b);
+
 /** The following function is used to fetch data from 8 consecutive
  * bytes. The most significant byte is at the lowest address.
  * @param[in]  b pointer to 8 bytes from where read
@@ -48,4 +54,48 @@ bytes. We store the most significant byte to the lowest address.
 @param[in]  n 4 byte integer to be stored */
 void mach_write_to_4(byte *b, ulint n);
 
+/** Store 6 bytes, the size of a transaction id, and 7 bytes, the size
+of a roll pointer. The most significant byte is at the lowest address. */
+void mach_write_to_6(byte *b, uint64_t n);
+void mach_write_to_7(byte *b, uint64_t n);
+
+/** The following function is used to store data in 8 consecutive
+bytes. We store the most significant byte to the lowest address.
+@param[in]  b pointer to 8 bytes where to store
+@param[in]  n 8 byte integer to be stored */
+void mach_write_to_8(byte *b, uint64_t n);
+
+/** Write a 32-bit integer in a compressed form, 1..5 bytes. Values close
+to 0xFFFFFFFF, like UNIV_SQL_NULL, take 2..4 bytes.
+@param[in]	b	pointer to memory where to store
+@param[in]	n	integer to be stored
+@return stored size in bytes */
+ulint mach_write_compressed(byte *b, uint32_t n);
+
+/** Write a 64-bit integer in a compressed form: the high 32 bits
+compressed, then the low 32 bits in 4 bytes.
+@return stored size in bytes */
+ulint mach_u64_write_compressed(byte *b, uint64_t n);
+
+/** Write a 64-bit integer in a much compressed form: like a 32-bit one if
+it fits, else 0xFF and the high and low 32 bits compressed.
+@return stored size in bytes */
+ulint mach_u64_write_much_compressed(byte *b, uint64_t n);
+
+/** Read a 32-bit integer in a compressed form.
+@param[in,out]	ptr	pointer to the integer, advanced past it, or set to
+nullptr if the integer does not end before end_ptr
+@param[in]	end_ptr	end of the buffer
+@return the integer, 0 if *ptr was set to nullptr */
+uint32_t mach_parse_compressed(const byte **ptr, const byte *end_ptr);
+
+/** Read a 64-bit integer written by mach_u64_write_compressed(), see
+mach_parse_compressed(). */
+uint64_t mach_u64_parse_compressed(const byte **ptr, const byte *end_ptr);
+
+/** Read a 64-bit integer written by mach_u64_write_much_compressed(), see
+mach_parse_compressed(). */
+uint64_t mach_parse_u64_much_compressed(const byte **ptr,
+                                        const byte *end_ptr);
+
 #endif
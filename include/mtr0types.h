@@ -0,0 +1,91 @@
+#ifndef mtr0types_h
+#define mtr0types_h
+
+#include <stdint.h>
+
+/** Types of the redo log records of MySQL 8.0. The types suffixed _8027
+are written by MySQL 8.0.27 and earlier, the records of their successors
+log the index with its instant column versions. */
+enum mlog_id_t {
+  /** If the mini-transaction writes a single log record, its type is
+  or'ed with this flag instead of ending it with MLOG_MULTI_REC_END */
+  MLOG_SINGLE_REC_FLAG = 128,
+
+  /** One, two, four or eight bytes written to a page */
+  MLOG_1BYTE = 1,
+  MLOG_2BYTES = 2,
+  MLOG_4BYTES = 4,
+  MLOG_8BYTES = 8,
+
+  MLOG_REC_INSERT_8027 = 9,
+  MLOG_REC_CLUST_DELETE_MARK_8027 = 10,
+  MLOG_REC_SEC_DELETE_MARK = 11,
+  MLOG_REC_UPDATE_IN_PLACE_8027 = 13,
+  MLOG_REC_DELETE_8027 = 14,
+  MLOG_LIST_END_DELETE_8027 = 15,
+  MLOG_LIST_START_DELETE_8027 = 16,
+  MLOG_LIST_END_COPY_CREATED_8027 = 17,
+  MLOG_PAGE_REORGANIZE_8027 = 18,
+  MLOG_PAGE_CREATE = 19,
+  MLOG_UNDO_INSERT = 20,
+  MLOG_UNDO_ERASE_END = 21,
+  MLOG_UNDO_INIT = 22,
+  MLOG_UNDO_HDR_REUSE = 24,
+  MLOG_UNDO_HDR_CREATE = 25,
+  MLOG_REC_MIN_MARK = 26,
+  MLOG_IBUF_BITMAP_INIT = 27,
+  MLOG_LSN = 28,
+  MLOG_INIT_FILE_PAGE = 29,
+  MLOG_WRITE_STRING = 30,
+  /** End of the records of a mini-transaction */
+  MLOG_MULTI_REC_END = 31,
+  /** Padding, without a page */
+  MLOG_DUMMY_RECORD = 32,
+  MLOG_FILE_CREATE = 33,
+  MLOG_FILE_RENAME = 34,
+  MLOG_FILE_DELETE = 35,
+  MLOG_COMP_REC_MIN_MARK = 36,
+  MLOG_COMP_PAGE_CREATE = 37,
+  MLOG_COMP_REC_INSERT_8027 = 38,
+  MLOG_COMP_REC_CLUST_DELETE_MARK_8027 = 39,
+  MLOG_COMP_REC_SEC_DELETE_MARK = 40,
+  MLOG_COMP_REC_UPDATE_IN_PLACE_8027 = 41,
+  MLOG_COMP_REC_DELETE_8027 = 42,
+  MLOG_COMP_LIST_END_DELETE_8027 = 43,
+  MLOG_COMP_LIST_START_DELETE_8027 = 44,
+  MLOG_COMP_LIST_END_COPY_CREATED_8027 = 45,
+  MLOG_COMP_PAGE_REORGANIZE_8027 = 46,
+  MLOG_ZIP_WRITE_NODE_PTR = 48,
+  MLOG_ZIP_WRITE_BLOB_PTR = 49,
+  MLOG_ZIP_WRITE_HEADER = 50,
+  MLOG_ZIP_PAGE_COMPRESS = 51,
+  MLOG_ZIP_PAGE_COMPRESS_NO_DATA_8027 = 52,
+  MLOG_ZIP_PAGE_REORGANIZE_8027 = 53,
+  MLOG_PAGE_CREATE_RTREE = 57,
+  MLOG_COMP_PAGE_CREATE_RTREE = 58,
+  MLOG_INIT_FILE_PAGE2 = 59,
+  MLOG_INDEX_LOAD = 61,
+  /** Persistent metadata of a table, without a page */
+  MLOG_TABLE_DYNAMIC_META = 62,
+  MLOG_PAGE_CREATE_SDI = 63,
+  MLOG_COMP_PAGE_CREATE_SDI = 64,
+  MLOG_FILE_EXTEND = 65,
+  MLOG_TEST = 66,
+  MLOG_REC_INSERT = 67,
+  MLOG_REC_CLUST_DELETE_MARK = 68,
+  MLOG_REC_DELETE = 69,
+  MLOG_REC_UPDATE_IN_PLACE = 70,
+  MLOG_LIST_END_COPY_CREATED = 71,
+  MLOG_PAGE_REORGANIZE = 72,
+  MLOG_ZIP_PAGE_REORGANIZE = 73,
+  MLOG_ZIP_PAGE_COMPRESS_NO_DATA = 74,
+  MLOG_LIST_END_DELETE = 75,
+  MLOG_LIST_START_DELETE = 76,
+
+  MLOG_BIGGEST_TYPE = 76
+};
+
+/** @return name of a redo log record type, "?" if unknown */
+const char *mlog_type_name(uint32_t type);
+
+#endif
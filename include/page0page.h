@@ -93,6 +93,43 @@ enum class BlobFirstPage {
   /** The offset where the list base node is located.  This is the list
   of LOB pages. */
   OFFSET_INDEX_LIST = OFFSET_TRX_ID + 6,
+
+  /** The offset where the list base node is located.  This is the list
+  of free index entries. */
+  OFFSET_INDEX_FREE_NODES = OFFSET_INDEX_LIST + FLST_BASE_NODE_SIZE,
+
+  /** The offset where the contents of the first page begins: the index
+  entries, then the data. */
+  LOB_PAGE_DATA = OFFSET_INDEX_FREE_NODES + FLST_BASE_NODE_SIZE,
+
+  /** Number of index entries in the first page of a 16KiB page size */
+  N_INDEX_ENTRIES = 10
+};
+
+/* Blob index entry, in the first page or a blob index page */
+enum class BlobIndexEntry {
+  /** Location of the previous and next index entries */
+  OFFSET_PREV = 0,
+  OFFSET_NEXT = OFFSET_PREV + FIL_ADDR_SIZE,
+
+  /** List of the older versions of this entry */
+  OFFSET_VERSIONS = OFFSET_NEXT + FIL_ADDR_SIZE,
+
+  /** The trx that created and last modified the data of the entry */
+  OFFSET_TRXID = OFFSET_VERSIONS + FLST_BASE_NODE_SIZE,
+  OFFSET_TRXID_MODIFIER = OFFSET_TRXID + 6,
+  OFFSET_TRX_UNDO_NO = OFFSET_TRXID_MODIFIER + 6,
+  OFFSET_TRX_UNDO_NO_MODIFIER = OFFSET_TRX_UNDO_NO + 4,
+
+  /** The page holding the data of the entry, 4 bytes */
+  OFFSET_PAGE_NO = OFFSET_TRX_UNDO_NO_MODIFIER + 4,
+
+  /** Length of the data of the entry, 2 bytes in a 4 byte slot */
+  OFFSET_DATA_LEN = OFFSET_PAGE_NO + 4,
+
+  OFFSET_LOB_VERSION = OFFSET_DATA_LEN + 4,
+
+  SIZE = OFFSET_LOB_VERSION + 4
 };
 
 /* Blob index page */
@@ -112,6 +149,9 @@ enum class BlobDataPage {
 /* Slot size */
 #define TRX_RSEG_SLOT_SIZE 4
 
+/* Number of undo log slots in a rollback segment file copy */
+#define TRX_RSEG_N_SLOTS (UNIV_PAGE_SIZE / 16)
+
 /* The offset of the rollback segment header on its page */
 #define TRX_RSEG FSEG_PAGE_DATA
 
@@ -191,6 +231,61 @@ If it does overflow, transaction resuming will disable for this transaction */
 /* Max number of rollback segments */
 #define TRX_SYS_N_RSEGS 128
 
+/** The offset of the transaction system header on its page */
+#define TRX_SYS FSEG_PAGE_DATA
+
+/** Transaction system header */
+/*------------------------------------------------------------- */
+#define TRX_SYS_TRX_ID_STORE                  \
+  0 /*!< the maximum trx id or trx number     \
+    modulo TRX_SYS_TRX_ID_WRITE_MARGIN written \
+    to a file page by any transaction */
+#define TRX_SYS_FSEG_HEADER 8 /*!< segment header for the tablespace \
+                              segment the trx system is created into */
+#define TRX_SYS_RSEGS (8 + FSEG_HEADER_SIZE)
+/*!< the start of the array of rollback segment specification slots */
+
+/** Rollback segment specification slot offsets */
+#define TRX_SYS_RSEG_SPACE 0   /* space where the segment header is placed */
+#define TRX_SYS_RSEG_PAGE_NO 4 /* page number where the segment header is \
+                               placed; FIL_NULL if the slot is unused */
+#define TRX_SYS_RSEG_SLOT_SIZE 8
+
+/** The transaction system stores the trx id in steps of this margin */
+#define TRX_SYS_TRX_ID_WRITE_MARGIN 256
+
+/** The offset of the MySQL binlog offset info in the trx system header */
+#define TRX_SYS_MYSQL_LOG_INFO (UNIV_PAGE_SIZE - 1000)
+#define TRX_SYS_MYSQL_LOG_MAGIC_N_FLD \
+  0 /*!< magic number which is TRX_SYS_MYSQL_LOG_MAGIC_N if we have valid data \
+    in the MySQL binlog info */
+#define TRX_SYS_MYSQL_LOG_OFFSET_HIGH \
+  4 /*!< high 4 bytes of the offset within that file */
+#define TRX_SYS_MYSQL_LOG_OFFSET_LOW \
+  8 /*!< low 4 bytes of the offset within that file */
+#define TRX_SYS_MYSQL_LOG_NAME 12 /*!< MySQL log file name */
+#define TRX_SYS_MYSQL_LOG_NAME_LEN 512
+#define TRX_SYS_MYSQL_LOG_MAGIC_N 873422344
+
+/** Doublewrite buffer of MySQL before 8.0.20, in the TRX_SYS page */
+/*------------------------------------------------------------- */
+/** The offset of the doublewrite buffer header on the trx system header page */
+#define TRX_SYS_DOUBLEWRITE (UNIV_PAGE_SIZE - 200)
+#define TRX_SYS_DOUBLEWRITE_FSEG 0 /*!< fseg header of the fseg containing \
+                                   the doublewrite buffer */
+#define TRX_SYS_DOUBLEWRITE_MAGIC FSEG_HEADER_SIZE
+/*!< 4-byte magic number which shows if we already have created the
+doublewrite buffer */
+#define TRX_SYS_DOUBLEWRITE_BLOCK1 (4 + FSEG_HEADER_SIZE)
+/*!< page number of the first page in the first sequence of 64
+(= FSP_EXTENT_SIZE) consecutive pages in the doublewrite buffer */
+#define TRX_SYS_DOUBLEWRITE_BLOCK2 (8 + FSEG_HEADER_SIZE)
+/*!< page number of the first page in the second sequence of 64
+consecutive pages in the doublewrite buffer */
+#define TRX_SYS_DOUBLEWRITE_MAGIC_N 536853855
+/** Size of the doublewrite block in pages */
+#define TRX_SYS_DOUBLEWRITE_BLOCK_SIZE 64
+
 /** The offset of the Rollback Segment Directory header on an RSEG_ARRAY page */
 #define RSEG_ARRAY_HEADER FSEG_PAGE_DATA
 
@@ -261,9 +356,30 @@ log page header, in bytes */
   2 /*!< Offset of the last undo log header \
     on the segment header page, 0 if        \
     none */
+#define TRX_UNDO_FSEG_HEADER               \
+  4 /*!< Header for the file segment which \
+    the undo log segment occupies */
+#define TRX_UNDO_PAGE_LIST                 \
+  (4 + FSEG_HEADER_SIZE) /*!< Base node for \
+    the list of pages in the undo log      \
+    segment */
+#define TRX_UNDO_SEG_HDR_SIZE (4 + FSEG_HEADER_SIZE + FLST_BASE_NODE_SIZE)
 
 #define UNIV_PAGE_SIZE (16 * 1024)
 
+/*			PAGE DIRECTORY
+        ==============
+The sparse page directory grows downwards from the page trailer. Slot 0
+owns the infimum, the last slot the supremum, every slot points to the
+record that owns it. */
+
+#define PAGE_DIR FIL_PAGE_DATA_END /* offset of the page directory from the
+                                   end of the page */
+#define PAGE_DIR_SLOT_SIZE 2 /* size of a page directory slot */
+#define PAGE_DIR_SLOT_MAX_N_OWNED 8 /* most records a slot owns */
+#define PAGE_DIR_SLOT_MIN_N_OWNED 4 /* fewest records a slot owns, but for
+                                    the first and last slots */
+
 /** Gets the page number.
  @return page number */
 page_no_t page_get_page_no(const page_t *page); /*!< in: page */
@@ -1,3 +1,5 @@
+#ifndef PAGE_CRC32_H
+#define PAGE_CRC32_H
 
 #include "include/ut0crc32.h"
 #include "include/fil0fil.h"
@@ -12,8 +14,8 @@ and 64-bit architectures.
 @param[in]  use_legacy_big_endian if true then use big endian
 byteorder when converting byte strings to integers
 @return checksum */
-uint32_t buf_calc_page_crc32(const byte *page,
-                             bool use_legacy_big_endian /* = false */) {
+inline uint32_t buf_calc_page_crc32(const byte *page,
+                                    bool use_legacy_big_endian /* = false */) {
   /* Since the field FIL_PAGE_FILE_FLUSH_LSN, and in versions <= 4.1.x
   FIL_PAGE_ARCH_LOG_NO_OR_SPACE_ID, are written outside the buffer pool
   to the first pages of data files, we have to skip them in the page
@@ -34,3 +36,51 @@ uint32_t buf_calc_page_crc32(const byte *page,
 
   return (c1 ^ c2);
 }
+
+/** Random masks of ut_fold_ulint_pair() */
+static const uint64_t UT_HASH_RANDOM_MASK = 1463735687;
+static const uint64_t UT_HASH_RANDOM_MASK2 = 1653893711;
+
+/** Folds a pair of ulints. The fold is done in 64 bits, the ulint of the
+64-bit servers that wrote the pages.
+@return folded value */
+inline uint64_t ut_fold_ulint_pair(uint64_t n1, uint64_t n2) {
+  return (((((n1 ^ n2 ^ UT_HASH_RANDOM_MASK2) << 8) + n1) ^
+           UT_HASH_RANDOM_MASK) +
+          n2);
+}
+
+/** Folds a binary string.
+@return folded value */
+inline uint64_t ut_fold_binary(const byte *str, ulint len) {
+  uint64_t fold = 0;
+  for (const byte *str_end = str + len; str < str_end; str++) {
+    fold = ut_fold_ulint_pair(fold, *str);
+  }
+  return fold;
+}
+
+/** Calculates a page checksum of innodb_checksum_algorithm=innodb, stored
+in the header of the page, over the same bytes as buf_calc_page_crc32().
+@param[in]  page      buffer page (UNIV_PAGE_SIZE bytes)
+@return checksum */
+inline uint32_t buf_calc_page_new_checksum(const byte *page) {
+  const uint64_t checksum =
+      ut_fold_binary(page + FIL_PAGE_OFFSET,
+                     FIL_PAGE_FILE_FLUSH_LSN - FIL_PAGE_OFFSET) +
+      ut_fold_binary(page + FIL_PAGE_DATA,
+                     UNIV_PAGE_SIZE - FIL_PAGE_DATA -
+                         FIL_PAGE_END_LSN_OLD_CHKSUM);
+  return (uint32_t)(checksum & 0xFFFFFFFFUL);
+}
+
+/** Calculates the old formula checksum of innodb_checksum_algorithm=innodb,
+stored in the trailer of the page, over the first bytes of the page only.
+@param[in]  page      buffer page (UNIV_PAGE_SIZE bytes)
+@return checksum */
+inline uint32_t buf_calc_page_old_checksum(const byte *page) {
+  return (uint32_t)(ut_fold_binary(page, FIL_PAGE_FILE_FLUSH_LSN) &
+                    0xFFFFFFFFUL);
+}
+
+#endif
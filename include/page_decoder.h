@@ -0,0 +1,87 @@
+#ifndef PAGE_DECODER_H
+#define PAGE_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "include/udef.h"
+#include "include/rem0types.h"
+#include "include/rec_decoder.h"
+#include "include/row_filter.h"
+
+/** The records of one leaf page selected by a scan, with their field
+offsets, so that columns can be decoded a page at a time. */
+struct PageBatch {
+  PageBatch() : page(nullptr), page_no(0), layout(nullptr), stride(0) {}
+
+  const byte *page;
+  uint32_t page_no;
+  /** Decode plan of the records */
+  const RecLayout *layout;
+  std::vector<const rec_t *> recs;
+  /** Field offsets of the records, stride entries per record */
+  std::vector<ulint> offs;
+  size_t stride;
+
+  size_t size() const { return recs.size(); }
+  const ulint *rec_offs(size_t i) const { return &offs[i * stride]; }
+};
+
+/** Collect the live records of a leaf page that satisfy a filter. The
+origins of all records are gathered first by following the next-record
+chain, then their offsets are computed in one pass.
+@param[in]	page		leaf page
+@param[in]	page_no		page number
+@param[in]	layout		leaf decode plan of the index
+@param[in]	n_decode	number of leading fields to compute offsets for
+@param[in]	filter		rows to keep
+@param[out]	batch		selected records
+@return number of live records examined */
+size_t page_batch_collect(const byte *page, uint32_t page_no,
+                          const RecLayout &layout, size_t n_decode,
+                          const RowFilter &filter, PageBatch *batch);
+
+/** Decode a fixed-width integer field of every record of a batch into a
+contiguous vector. The stored big-endian values are gathered first, then
+converted to host byte order with the sign bit flipped back for signed
+columns, which is the layout of an Arrow integer column of that width.
+@param[in]	batch		records
+@param[in]	field		position of the field in the decode plan
+@param[in]	width		stored width of the field: 1, 2, 4 or 8
+@param[in]	is_signed	whether the column is signed
+@param[out]	out		batch.size() values of width bytes, 0 for
+NULL and externally stored fields
+@param[out]	valid		batch.size() flags, 0 for NULL fields */
+void page_batch_decode_int(const PageBatch &batch, size_t field,
+                           uint32_t width, bool is_signed, void *out,
+                           uint8_t *valid);
+
+/** Function converting n big-endian integers of one width, stored back to
+back, to host byte order, optionally flipping their sign bit. */
+typedef void (*int_be_decode_func_t)(const byte *in, size_t n, bool flip_sign,
+                                     void *out);
+
+/** Conversion kernels by width (2, 4 and 8 bytes). They use AVX2 when
+page_decoder_init() found it on the CPU. */
+extern int_be_decode_func_t int_be_decode2;
+extern int_be_decode_func_t int_be_decode4;
+extern int_be_decode_func_t int_be_decode8;
+
+/** Portable versions of the kernels. */
+void int_be_decode2_scalar(const byte *in, size_t n, bool flip_sign,
+                           void *out);
+void int_be_decode4_scalar(const byte *in, size_t n, bool flip_sign,
+                           void *out);
+void int_be_decode8_scalar(const byte *in, size_t n, bool flip_sign,
+                           void *out);
+
+/** Convert n big-endian integers of width 1, 2, 4 or 8 bytes. */
+void int_be_decode(const byte *in, size_t n, uint32_t width, bool flip_sign,
+                   void *out);
+
+/** Select the conversion kernels for the CPU.
+@return whether the AVX2 kernels are used */
+bool page_decoder_init();
+
+#endif
@@ -117,7 +117,10 @@ B-tree page that is the leftmost page on its level
 #define REC_INFO_DELETED_FLAG                  \
   0x20UL /* when bit is set to 1, it means the \
          record has been delete marked */
-/* The 0x40UL can also be used in the future */
+/* The row version flag (MySQL 8.0.29+). When it is set to 1, the record
+was inserted/updated after an instant ADD/DROP COLUMN and has a one byte
+row version before the null bitmap. */
+#define REC_INFO_VERSION_FLAG 0x40UL
 /* The instant ADD COLUMN flag. When it is set to 1, it means this record
 was inserted/updated after an instant ADD COLUMN. */
 #define REC_INFO_INSTANT_FLAG 0x80UL
@@ -0,0 +1,222 @@
+#ifndef REC_DECODER_H
+#define REC_DECODER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "include/udef.h"
+#include "include/rem0types.h"
+#include "include/rec.h"
+#include "include/table_def.h"
+
+/** col_no of the child page number field of a node pointer record */
+static const uint32_t REC_FIELD_CHILD_PAGE = 0xFFFFFFFF;
+
+/** Length of a column of an InnoDB system field */
+static const uint32_t DATA_ROW_ID_LEN = 6;
+static const uint32_t DATA_TRX_ID_LEN = 6;
+static const uint32_t DATA_ROLL_PTR_LEN = 7;
+
+/** Length of the reference to an externally stored field */
+static const uint32_t BTR_EXTERN_FIELD_REF_SIZE = 20;
+
+/** How one field of a compact record is laid out. */
+struct RecFieldPlan {
+  /** Position in TableDef::columns, or REC_FIELD_CHILD_PAGE */
+  uint32_t col_no;
+  /** Length of a fixed-width field, 0 for a variable-length field */
+  uint32_t fixed_len;
+  /** Maximum number of bytes stored for the field */
+  uint32_t max_len;
+  /** The field has a bit in the null bitmap */
+  bool nullable;
+  /** The length header may take two bytes and the field may be stored
+  externally (DATA_BIG_COL) */
+  bool big;
+  /** Records written without the field read RecLayout::defaults[i] instead
+  of SQL NULL (instant ADD COLUMN ... DEFAULT) */
+  bool has_default;
+};
+
+/** Which fields a record of one row version stores, for tables that went
+through an instant ADD/DROP COLUMN. */
+struct RecVersionPlan {
+  /** Size of the null bitmap in bits */
+  uint32_t n_nullable;
+  /** stored[i] is 0 for a field added after the version or dropped in or
+  before it */
+  std::vector<uint8_t> stored;
+};
+
+/** Decode plan for the records of one index: the physical order of the
+fields and everything needed to compute their offsets from the record
+header without consulting the dictionary again. */
+struct RecLayout {
+  const TableDef *table;
+  const IndexDef *index;
+  std::vector<RecFieldPlan> fields;
+  /** Number of nullable fields of the index, this sizes the null bitmap
+  for both leaf and node pointer records */
+  uint32_t n_nullable;
+  /** Number of fields that identify a record in the tree: the primary
+  key of the clustered index, all fields of a secondary index */
+  uint32_t n_uniq;
+  bool is_clustered;
+  bool is_leaf;
+  /** COMPACT/DYNAMIC records, false for REDUNDANT (old-style) records
+  with an array of field end offsets */
+  bool is_compact;
+  /** The records may store fewer fields than the plan: the leaf records
+  of the clustered index of a table with instant ADD/DROP COLUMNs */
+  bool is_instant;
+  /** Plan of the records without a row version or field count, written
+  before the first instant ADD/DROP COLUMN */
+  RecVersionPlan base;
+  /** Plans of the records with a row version (REC_INFO_VERSION_FLAG),
+  indexed by the version */
+  std::vector<RecVersionPlan> versions;
+  /** n_nullable_before[n] is the size of the null bitmap of a record that
+  stores its first n fields (REC_INFO_INSTANT_FLAG) */
+  std::vector<uint32_t> n_nullable_before;
+  /** Stored values of the fields for the records written without them */
+  std::vector<std::string> defaults;
+};
+
+/** Build the decode plan of an index.
+@param[in]	table	table definition
+@param[in]	index	index of the table
+@param[in]	leaf	true for leaf records, false for node pointers
+@param[out]	layout	decode plan
+@return 0 on success, -1 if a column type is not supported */
+int rec_layout_build(const TableDef &table, const IndexDef &index, bool leaf,
+                     RecLayout *layout);
+
+/** Select the record format of a decode plan from the PAGE_IS_COMPACT bit
+of an index page, which rec_layout_build() takes from the row format of
+the SDI.
+@param[in,out]	layout	decode plan
+@param[in]	page	page of the index */
+void rec_layout_set_format(RecLayout *layout, const byte *page);
+
+/** Fixed length of a column in a compact record.
+@return length in bytes, or 0 if the column is stored with a length */
+uint32_t rec_col_fixed_len(const ColumnDef &col);
+
+/** @return whether the column is the system column DB_ROW_ID, DB_TRX_ID or
+DB_ROLL_PTR */
+bool rec_col_is_system(const ColumnDef &col);
+
+/** Compute the field end offsets of a record in the format of the plan:
+compact (COMPACT/DYNAMIC) or REDUNDANT. offs[i] is the end offset of field
+i relative to the record origin, ORed with REC_OFFS_SQL_NULL or
+REC_OFFS_EXTERNAL. A field the record was written without is empty and has
+REC_OFFS_DEFAULT, with REC_OFFS_SQL_NULL if its default is NULL;
+rec_field_get() returns its value.
+@param[in]	rec	record origin
+@param[in]	layout	decode plan of the index
+@param[out]	offs	layout.fields.size() entries */
+void rec_layout_get_offsets(const rec_t *rec, const RecLayout &layout,
+                            ulint *offs);
+
+/** Compute the end offsets of the first n_fields fields of a record
+only. Fields after them are not looked at, so a projection that
+needs the leading columns of a wide record stops walking the header early.
+@param[in]	rec		record origin
+@param[in]	layout		decode plan of the index
+@param[out]	offs		n_fields entries
+@param[in]	n_fields	number of leading fields to compute */
+void rec_layout_get_offsets(const rec_t *rec, const RecLayout &layout,
+                            ulint *offs, size_t n_fields);
+
+/** Compute the size of the header of a record: the extra bytes, and the
+null bitmap and the lengths of the variable-length fields of a compact
+record or the field end offsets of a REDUNDANT one.
+@param[in]	rec	record origin
+@param[in]	layout	decode plan of the index
+@return number of bytes before the record origin */
+ulint rec_layout_extra_size(const rec_t *rec, const RecLayout &layout);
+
+/** @return start offset of field i */
+static inline ulint rec_offs_field_start(const ulint *offs, ulint i) {
+  return i == 0 ? 0 : (offs[i - 1] & REC_OFFS_MASK);
+}
+
+/** @return stored length of field i */
+static inline ulint rec_offs_field_len(const ulint *offs, ulint i) {
+  return (offs[i] & REC_OFFS_MASK) - rec_offs_field_start(offs, i);
+}
+
+/** @return whether field i is SQL NULL */
+static inline bool rec_offs_field_is_null(const ulint *offs, ulint i) {
+  return (offs[i] & REC_OFFS_SQL_NULL) != 0;
+}
+
+/** @return whether field i is stored externally */
+static inline bool rec_offs_field_is_extern(const ulint *offs, ulint i) {
+  return (offs[i] & REC_OFFS_EXTERNAL) != 0;
+}
+
+/** Get the value of field i of a record: the bytes in the record, or the
+default of a column the record was written without.
+@param[in]	rec	record origin
+@param[in]	layout	decode plan of the index
+@param[in]	offs	field offsets from rec_layout_get_offsets()
+@param[in]	i	field
+@param[out]	len	length of the value
+@return value */
+static inline const byte *rec_field_get(const rec_t *rec,
+                                        const RecLayout &layout,
+                                        const ulint *offs, ulint i,
+                                        ulint *len) {
+  if (offs[i] & REC_OFFS_DEFAULT) {
+    const std::string &value = layout.defaults[i];
+    *len = value.size();
+    return reinterpret_cast<const byte *>(value.data());
+  }
+  *len = rec_offs_field_len(offs, i);
+  return rec + rec_offs_field_start(offs, i);
+}
+
+/** Read an integer column (including YEAR, ENUM, SET and BIT), undoing the
+InnoDB sign bit flip of signed columns. */
+int64_t rec_field_read_int(const ColumnDef &col, const byte *data, ulint len);
+
+/** Read a FLOAT or DOUBLE column. */
+double rec_field_read_double(const ColumnDef &col, const byte *data, ulint len);
+
+/** Read a DATE column as days since 1970-01-01. */
+int32_t rec_field_read_date(const byte *data);
+
+/** Read a DATETIME2 or TIMESTAMP2 column as microseconds since
+1970-01-01 00:00:00. */
+int64_t rec_field_read_datetime(const ColumnDef &col, const byte *data);
+
+/** Append the text representation of a column value to out. */
+void rec_field_to_string(const ColumnDef &col, const byte *data, ulint len,
+                         std::string *out);
+
+/** Text representation of a value read in parts, an externally stored
+column streamed from its LOB pages: the parts appended make the same text
+as rec_field_to_string() of the whole value. A binary value gets one 0x
+prefix, the trailing spaces of a CHAR value are held back until a later
+part has more text. */
+class RecFieldStream {
+ public:
+  explicit RecFieldStream(const ColumnDef &col);
+
+  /** Append the text of the next part of the value to out. */
+  void Append(const byte *part, ulint len, std::string *out);
+
+ private:
+  /** Whether the value is written in hex */
+  const bool hex_;
+  /** Whether the trailing spaces of the value are dropped */
+  const bool trim_;
+  /** Whether a part was appended */
+  bool started_;
+  /** Spaces at the end of the parts so far, not appended yet */
+  ulint n_spaces_;
+};
+
+#endif
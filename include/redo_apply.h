@@ -0,0 +1,126 @@
+#ifndef REDO_APPLY_H
+#define REDO_APPLY_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "include/redo_log.h"
+#include "include/udef.h"
+
+/** Applies the redo records of a few pages of a tablespace, offline, to
+bring pages restored from a backup or the doublewrite buffer forward to
+the LSN of the rest of the tablespace. Only the record types writing
+bytes, undo log records, the creation of index pages and the inserts,
+deletes, delete marks and in-place updates of records are applied: the
+records copying or deleting lists of records, or reorganizing or
+compressing index pages, are left to crash recovery. */
+
+/** Of an update or delete mark of a clustered index record, do not write
+the transaction id and roll pointer */
+static const uint32_t BTR_KEEP_SYS_FLAG = 4;
+
+/** Apply a page record of the redo log to a page.
+@param[in,out]	page		page of UNIV_PAGE_SIZE bytes
+@param[in]	space_id	tablespace of the page
+@param[in]	page_no		number of the page
+@param[in]	type		record type
+@param[in]	body		body of the record, after its page number
+@param[in]	body_len	bytes of the body
+@return 0 if applied, 1 if the type, or the format of the record changed,
+is not supported here, -1 if the record does not fit the page; the page is
+partly changed unless 0 */
+int redo_apply_record(byte *page, uint32_t space_id, uint32_t page_no,
+                      uint32_t type, const byte *body, uint32_t body_len);
+
+/** State of a page after redo_apply_pages(). */
+enum redo_page_state {
+  /** No record to apply: the page is at the target LSN, or the log has no
+  later change of it */
+  REDO_PAGE_CURRENT,
+  /** The records up to the target LSN were applied */
+  REDO_PAGE_APPLIED,
+  /** The mini-transactions before the first one with a record that could
+  not be applied were applied */
+  REDO_PAGE_STOPPED,
+  /** The page is corrupt or all zeroes: its LSN is not known */
+  REDO_PAGE_CORRUPT,
+  /** The log starts after the LSN of the page */
+  REDO_PAGE_LOG_MISSING
+};
+
+/** @return name of a redo_page_state */
+const char *redo_page_state_name(redo_page_state state);
+
+/** Outcome of the redo apply of a page. */
+struct RedoPageApply {
+  RedoPageApply()
+      : page_no(0),
+        state(REDO_PAGE_CURRENT),
+        old_lsn(0),
+        new_lsn(0),
+        n_applied(0),
+        n_left(0),
+        stop_type(0),
+        stop_lsn(0) {}
+
+  uint32_t page_no;
+  redo_page_state state;
+  /** FIL_PAGE_LSN before and after the apply */
+  uint64_t old_lsn;
+  uint64_t new_lsn;
+  /** Records applied */
+  uint64_t n_applied;
+  /** Records from the mini-transaction that stopped the apply on */
+  uint64_t n_left;
+  /** Of REDO_PAGE_STOPPED, the type of the record that stopped the apply
+  and the start LSN of its mini-transaction */
+  uint32_t stop_type;
+  uint64_t stop_lsn;
+};
+
+/** Counters of redo_apply_pages(). */
+struct RedoApplyStats {
+  RedoApplyStats()
+      : n_records(0), n_bytes(0), n_index_load(0), n_changed(0), n_writes(0) {}
+
+  /** Records of the pages kept from the scan, and bytes of their bodies */
+  uint64_t n_records;
+  uint64_t n_bytes;
+  /** MLOG_INDEX_LOAD records of the tablespace: an index built without
+  redo logging, its pages may have changes missing from the log */
+  uint64_t n_index_load;
+  /** Pages brought forward */
+  uint64_t n_changed;
+  /** pwrite() calls */
+  uint64_t n_writes;
+  /** Counters of the scan of the log, up to the target LSN */
+  RedoScanStats scan;
+};
+
+/** Bring pages of a tablespace forward to a target LSN. Each page is read
+once, the log is scanned once from the lowest LSN of the pages, and the
+records of the pages are kept in a hash table of the pages, their
+mini-transactions ending at or before the target LSN. Each page then gets
+the mini-transactions starting at or after its FIL_PAGE_LSN, in LSN order,
+each applied whole or not at all, and is written once with its new LSN and
+crc32 checksum. The file is synced once at the end. Nothing is written if
+the log has a gap, a bad block or a record that could not be parsed
+before the target LSN.
+@param[in]	fd		tablespace file, opened for writing unless
+				dry_run
+@param[in]	space_id	id of the tablespace
+@param[in]	page_nos	pages to bring forward
+@param[in]	log		redo log
+@param[in]	target_lsn	LSN to stop at, UINT64_MAX for the end of
+				the log
+@param[in]	dry_run		only apply in memory, write nothing
+@param[out]	pages		outcome of each page, by page number
+@param[out]	stats		counters
+@return 0 on success, -1 on a read or write error, a page number past the
+end of the file or a gap in the log */
+int redo_apply_pages(int fd, uint32_t space_id,
+                     const std::vector<uint32_t> &page_nos, const RedoLog &log,
+                     uint64_t target_lsn, bool dry_run,
+                     std::vector<RedoPageApply> *pages, RedoApplyStats *stats);
+
+#endif
@@ -0,0 +1,272 @@
+#ifndef REDO_LOG_H
+#define REDO_LOG_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "include/mtr0types.h"
+#include "include/udef.h"
+
+/** Size of a redo log block */
+static const uint32_t OS_FILE_LOG_BLOCK_SIZE = 512;
+
+/** Log block header: the block number, with the flush bit, the bytes of
+the block used, header included, the offset of the first mini-transaction
+starting in the block, 0 if none, and the epoch (checkpoint number before
+8.0.30) */
+static const uint32_t LOG_BLOCK_HDR_NO = 0;
+static const uint32_t LOG_BLOCK_FLUSH_BIT_MASK = 0x80000000UL;
+static const uint32_t LOG_BLOCK_HDR_DATA_LEN = 4;
+static const uint32_t LOG_BLOCK_FIRST_REC_GROUP = 6;
+static const uint32_t LOG_BLOCK_EPOCH_NO = 8;
+static const uint32_t LOG_BLOCK_HDR_SIZE = 12;
+/** Log block trailer: crc32 of the rest of the block */
+static const uint32_t LOG_BLOCK_CHECKSUM = OS_FILE_LOG_BLOCK_SIZE - 4;
+static const uint32_t LOG_BLOCK_TRL_SIZE = 4;
+/** Bytes of log of a full block */
+static const uint32_t LOG_BLOCK_DATA_SIZE =
+    OS_FILE_LOG_BLOCK_SIZE - LOG_BLOCK_HDR_SIZE - LOG_BLOCK_TRL_SIZE;
+/** Checksum of the blocks written with innodb_log_checksums=OFF */
+static const uint32_t LOG_NO_CHECKSUM_MAGIC = 0xDEADBEEFUL;
+
+/** Log file header, four blocks: the header, checkpoint 1, encryption
+information and checkpoint 2 */
+static const uint32_t LOG_FILE_HDR_SIZE = 4 * OS_FILE_LOG_BLOCK_SIZE;
+static const uint32_t LOG_HEADER_FORMAT = 0;
+/** LSN of the first block after the file header (8.0.30 and later) */
+static const uint32_t LOG_HEADER_START_LSN = 8;
+static const uint32_t LOG_HEADER_CREATOR = 16;
+static const uint32_t LOG_HEADER_CREATOR_END = 48;
+static const uint32_t LOG_CHECKPOINT_1 = OS_FILE_LOG_BLOCK_SIZE;
+static const uint32_t LOG_CHECKPOINT_2 = 3 * OS_FILE_LOG_BLOCK_SIZE;
+/** Checkpoint block: its number (before 8.0.30), the checkpoint LSN and,
+before 8.0.30, the byte offset of that LSN in the log file group */
+static const uint32_t LOG_CHECKPOINT_NO = 0;
+static const uint32_t LOG_CHECKPOINT_LSN = 8;
+static const uint32_t LOG_CHECKPOINT_OFFSET = 16;
+
+/** Log formats: the first of MySQL 8.0, and the #innodb_redo/#ib_redoN
+files of 8.0.30, each file with its start LSN instead of the circular
+group of ib_logfileN files of the same size */
+static const uint32_t LOG_HEADER_FORMAT_8_0_1 = 2;
+static const uint32_t LOG_HEADER_FORMAT_8_0_30 = 6;
+
+/** @return the number of the log block holding an LSN */
+inline uint32_t log_block_convert_lsn_to_no(uint64_t lsn) {
+  return ((lsn / OS_FILE_LOG_BLOCK_SIZE) & 0x3FFFFFFFUL) + 1;
+}
+
+/** @return whether the crc32 or the no-checksum magic of a log block, or
+of a log file header block, is right */
+bool log_block_checksum_is_ok(const byte *block);
+
+/** A redo log file, mapped. */
+struct RedoFile {
+  RedoFile()
+      : fd(-1), map(nullptr), size(0), format(0), start_lsn(0) {}
+
+  std::string file_name;
+  int fd;
+  const byte *map;
+  uint64_t size;
+  uint32_t format;
+  /** LOG_HEADER_START_LSN */
+  uint64_t start_lsn;
+  std::string creator;
+};
+
+/** A page record of the redo log, with the LSN range of its
+mini-transaction: end_lsn is the FIL_PAGE_LSN of the page once the
+mini-transaction is applied. */
+struct RedoRecord {
+  RedoRecord()
+      : start_lsn(0),
+        end_lsn(0),
+        type(0),
+        space_id(0),
+        page_no(0),
+        len(0),
+        body(nullptr),
+        body_len(0) {}
+
+  uint64_t start_lsn;
+  uint64_t end_lsn;
+  /** mlog_id_t, without MLOG_SINGLE_REC_FLAG */
+  uint32_t type;
+  uint32_t space_id;
+  uint32_t page_no;
+  /** Bytes of the record, its header included */
+  uint32_t len;
+  /** The record after its space id and page number, only valid during the
+  callback */
+  const byte *body;
+  uint32_t body_len;
+};
+
+/** Callback of RedoLog::Scan(), return false to stop. */
+typedef std::function<bool(const RedoRecord &rec)> redo_record_cb;
+
+/** Counters of a scan of the redo log. */
+struct RedoScanStats {
+  RedoScanStats()
+      : n_blocks(0),
+        n_bad_blocks(0),
+        n_mtrs(0),
+        n_records(0),
+        n_resyncs(0),
+        n_unparsed_bytes(0),
+        n_runs(0),
+        start_lsn(0),
+        first_lsn(0),
+        end_lsn(0),
+        n_by_type(MLOG_BIGGEST_TYPE + 1, 0) {}
+
+  /** Blocks of the LSNs scanned */
+  uint64_t n_blocks;
+  /** Of n_blocks, the blocks with a wrong checksum or length */
+  uint64_t n_bad_blocks;
+  uint64_t n_mtrs;
+  /** Page records */
+  uint64_t n_records;
+  /** Records of an unknown type or length: the scan resumes at the next
+  block where a mini-transaction starts */
+  uint64_t n_resyncs;
+  /** Log bytes skipped by resyncs and bad blocks, or left at the end in
+  an incomplete mini-transaction */
+  uint64_t n_unparsed_bytes;
+  /** Runs of consecutive blocks parsed, and the LSN of the first
+  mini-transaction of the first run: with a single run, the log is
+  complete from start_lsn to end_lsn */
+  uint64_t n_runs;
+  uint64_t start_lsn;
+  /** Start LSN of the first mini-transaction parsed and end LSN of the
+  last one */
+  uint64_t first_lsn;
+  uint64_t end_lsn;
+  /** Page records by type */
+  std::vector<uint64_t> n_by_type;
+};
+
+/** Parse a mini-transaction: its page records up to MLOG_MULTI_REC_END or
+a single record flagged MLOG_SINGLE_REC_FLAG. The LSNs of the records are
+left to the caller, their bodies point into ptr.
+@param[in]	ptr	start of the mini-transaction
+@param[in]	end_ptr	end of the log read
+@param[out]	recs	page records
+@param[out]	len	bytes of the mini-transaction
+@return 1 if parsed, 0 if it does not end before end_ptr, -1 if a record
+is of an unknown type or its length cannot be told */
+int redo_parse_mtr(const byte *ptr, const byte *end_ptr,
+                   std::vector<RedoRecord> *recs, size_t *len);
+
+/** The index logged by the records of a B-tree page. */
+struct RedoIndex {
+  RedoIndex() : comp(false), instant(false), n_fields(0), n_uniq(0) {}
+
+  /** Whether the records are in the compact format, the length of each
+  field logged */
+  bool comp;
+  /** Whether the index has fields added or dropped by an instant DDL: a
+  record may lack some of the fields */
+  bool instant;
+  uint32_t n_fields;
+  uint32_t n_uniq;
+  /** Of a compact index, the length of each field: its fixed length, 0 if
+  it is of variable length up to 255 bytes, 0x7FFF if longer, with the
+  high bit set if the field is NOT NULL */
+  std::vector<uint16_t> field_lens;
+};
+
+/** Read the index logged at the start of the body of a record. The
+records of redundant tables and the types not changing records log none,
+the index is then left empty and not compact.
+@param[in]	type	record type
+@param[in]	body	body of the record
+@param[in]	end	end of the body
+@param[out]	index	the index logged
+@return the body after the index, nullptr if it is corrupt */
+const byte *redo_parse_index(uint32_t type, const byte *body,
+                             const byte *end, RedoIndex *index);
+
+/** The redo log of an instance: the #ib_redoN files of 8.0.30 and later
+or the ib_logfileN group of the earlier 8.0 versions, mapped read-only.
+The blocks are checked and their log parsed in LSN order. */
+class RedoLog {
+ public:
+  RedoLog() : checkpoint_lsn_(0) {}
+  ~RedoLog();
+
+  RedoLog(const RedoLog &) = delete;
+  RedoLog &operator=(const RedoLog &) = delete;
+
+  /** Map the log files.
+  @param[in]	spec	comma separated file names, or a directory: the
+  			#ib_redoN files in it, else its ib_logfileN files
+  @return 0 on success, -1 on error */
+  int Open(const char *spec);
+
+  const std::vector<RedoFile> &files() const { return files_; }
+
+  /** @return the newest checkpoint LSN of the file headers, 0 if none */
+  uint64_t checkpoint_lsn() const { return checkpoint_lsn_; }
+
+  /** Parse the page records of the mini-transactions starting at or
+  after an LSN. The blocks before the one holding from_lsn are not read.
+  A block whose number does not match its LSN is not part of the log,
+  and ends the log parsed before it.
+  @param[in]	from_lsn	first LSN of interest
+  @param[in]	cb		callback of each page record
+  @param[out]	stats		counters
+  @return 0 on success, -1 if the callback stopped the scan */
+  int Scan(uint64_t from_lsn, const redo_record_cb &cb,
+           RedoScanStats *stats) const;
+
+ private:
+  /** Log blocks of a file at consecutive LSNs. */
+  struct Segment {
+    const byte *blocks;
+    uint64_t n_blocks;
+    /** LSN of the first block */
+    uint64_t lsn;
+  };
+
+  int OpenFile(const std::string &file_name);
+
+  /** The segments of a circular ib_logfileN group, from the checkpoint:
+  each block read at the LSN of the last lap before the checkpoint, and
+  at the LSN of the lap after it. */
+  int MapGroup();
+
+  std::vector<RedoFile> files_;
+  /** In LSN order */
+  std::vector<Segment> segments_;
+  uint64_t checkpoint_lsn_;
+};
+
+/** The changes of a page in the redo log. */
+struct RedoPageChanges {
+  RedoPageChanges()
+      : space_id(0), page_no(0), n_records(0), n_bytes(0), last_lsn(0) {}
+
+  uint32_t space_id;
+  uint32_t page_no;
+  uint64_t n_records;
+  uint64_t n_bytes;
+  /** End LSN of the last mini-transaction changing the page */
+  uint64_t last_lsn;
+};
+
+/** Collect the pages changed by the mini-transactions starting at or
+after an LSN.
+@param[in]	log		redo log
+@param[in]	since_lsn	first LSN of interest
+@param[out]	pages		changed pages, by space id and page number
+@param[out]	stats		counters of the scan
+@return 0 */
+int redo_changed_pages(const RedoLog &log, uint64_t since_lsn,
+                       std::vector<RedoPageChanges> *pages,
+                       RedoScanStats *stats);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef ROW_FILTER_H
+#define ROW_FILTER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "include/udef.h"
+#include "include/rem0types.h"
+#include "include/rec_decoder.h"
+
+/** Comparison of a RecPredicate. */
+enum rec_pred_op {
+  PRED_EQ,
+  PRED_NE,
+  PRED_LT,
+  PRED_LE,
+  PRED_GT,
+  PRED_GE,
+  PRED_BETWEEN,
+  PRED_IN,
+  PRED_IS_NULL,
+  PRED_IS_NOT_NULL
+};
+
+/** One condition of a --where clause, compiled against a decode plan.
+
+The literals are converted to the format InnoDB stores the column in, so
+that the condition is evaluated with memcmp() on the field bytes of the
+record: big-endian integers with the sign bit flipped, packed DATE,
+DATETIME2/TIMESTAMP2 and TIME2 values and the raw bytes of strings all
+sort like unsigned byte strings. Only FLOAT and DOUBLE, which InnoDB stores
+in the little-endian machine format, are compared as numbers. */
+struct RecPredicate {
+  /** Position of the field in the decode plan */
+  size_t field;
+  rec_pred_op op;
+  /** Compare as FLOAT/DOUBLE instead of bytes */
+  bool is_double;
+  /** Ignore trailing spaces (CHAR columns are stored padded) */
+  bool pad_space;
+  /** Stored form of the literals: one for a comparison, two for BETWEEN,
+  sorted and unique for IN */
+  std::vector<std::string> keys;
+  std::vector<double> nums;
+};
+
+/** A conjunction of conditions on the fields of a record. */
+struct RowFilter {
+  RowFilter() : layout(nullptr) {}
+
+  std::vector<RecPredicate> preds;
+  /** Decode plan the filter was compiled against */
+  const RecLayout *layout;
+
+  bool empty() const { return preds.empty(); }
+};
+
+/** Compile a --where clause. The clause is a list of conditions joined by
+AND, each one of
+  col {=|!=|<>|<|<=|>|>=} literal
+  col BETWEEN literal AND literal
+  col IN (literal, ...)
+  col IS [NOT] NULL
+where literal is a number or a quoted string. Strings are compared
+byte-wise, as with a binary collation: the order and equality of a _ci or
+_ai collation are not those of MySQL. A date, time or datetime literal must
+be one of 'YYYY-MM-DD', 'YYYY-MM-DD HH:MM:SS[.ffffff]' and
+'[-]HH:MM:SS[.ffffff]'. DECIMAL columns only support IS [NOT] NULL.
+@param[in]	where	clause text, nullptr or "" for no filter
+@param[in]	layout	leaf decode plan of the scanned index
+@param[out]	filter	compiled filter
+@return 0 on success, -1 with a message on stderr on error */
+int row_filter_compile(const char *where, const RecLayout &layout,
+                       RowFilter *filter);
+
+/** Evaluate a filter on a record. Conditions on externally stored values
+do not match, except IS NOT NULL.
+@param[in]	filter	compiled filter
+@param[in]	rec	record
+@param[in]	offs	field offsets from rec_layout_get_offsets()
+@return whether the record satisfies every condition */
+bool row_filter_match(const RowFilter &filter, const rec_t *rec,
+                      const ulint *offs);
+
+/** Convert a value to the form a field is stored in, so that it can be
+compared with rec_field_cmp_key(). FLOAT and DOUBLE are not supported.
+@param[in]	layout		decode plan
+@param[in]	field		position of the field in the decode plan
+@param[in]	value		value as text
+@param[out]	key		stored form of the value
+@param[out]	pad_space	whether trailing spaces are to be ignored
+@return 0 on success, -1 if the value does not fit the column */
+int rec_field_encode(const RecLayout &layout, size_t field,
+                     const std::string &value, std::string *key,
+                     bool *pad_space);
+
+/** Compare the bytes of a field with a key from rec_field_encode().
+@return negative, 0 or positive as the field sorts before, equal to or
+after the key */
+int rec_field_cmp_key(const byte *data, ulint len, const std::string &key,
+                      bool pad_space);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef SALVAGE_SCAN_H
+#define SALVAGE_SCAN_H
+
+#include <stdint.h>
+
+#include "include/udef.h"
+#include "include/table_scan.h"
+
+/** Counters of a salvage scan. */
+struct SalvageStats {
+  SalvageStats()
+      : n_pages(0),
+        n_leaf_pages(0),
+        n_torn_pages(0),
+        n_records(0),
+        n_bad_records(0),
+        n_free_records(0),
+        n_garbage_records(0),
+        n_rows(0),
+        n_deleted(0),
+        n_examined(0) {}
+
+  /** Pages read */
+  uint64_t n_pages;
+  /** Leaf pages of the index found */
+  uint64_t n_leaf_pages;
+  /** Leaf pages skipped because the LSN in the trailer does not match the
+  header, the page was only partially written */
+  uint64_t n_torn_pages;
+  /** Records found on the leaf pages, including older copies of a row */
+  uint64_t n_records;
+  /** Records skipped because their fields extend past the page */
+  uint64_t n_bad_records;
+  /** Records of the PAGE_FREE lists */
+  uint64_t n_free_records;
+  /** Records found by scanning the garbage space of the pages */
+  uint64_t n_garbage_records;
+  /** Distinct primary keys */
+  uint64_t n_rows;
+  /** Primary keys whose newest copy is deleted */
+  uint64_t n_deleted;
+  /** Rows the filter was evaluated on, live or deleted */
+  uint64_t n_examined;
+};
+
+/** Recover the rows of the scanned index without following the B-tree.
+Every page of the file is read sequentially, split in ranges across
+n_threads threads, and the records of the FIL_PAGE_INDEX pages at level 0
+with the PAGE_INDEX_ID of the index are decoded from the page. Pages that
+were freed or split keep stale copies of rows, so the copies are
+deduplicated by the fields that identify them in the index (the primary
+key of the clustered index) and the one on the page with the highest
+FIL_PAGE_LSN is kept, a live copy before a deleted one of the same LSN.
+A row whose newest copy is delete-marked is dropped.
+
+To recover deleted rows the scan can return the rows whose newest copy
+is deleted instead. The records purged from a page are then collected
+too: those of the PAGE_FREE list, and those in the garbage space that are
+on no list, found by checking every offset of the heap for a plausible
+record header and fields that fit their columns. A purged copy only counts
+for a key with no live or delete-marked copy on any leaf page, since the
+records moved by a page split or merge are purged from the old page.
+
+Only the key and the location of the newest copy of each row are held in
+memory until the scan completes. The rows are then passed to cb in primary
+key order in batches without a page (batch.page is nullptr), the pages of
+each batch read again in page order.
+@param[in]	fd		tablespace file
+@param[in]	scan		prepared scan
+@param[in]	n_threads	number of reader threads, 0 for one per CPU
+@param[in]	deleted		return the deleted rows instead of the live ones
+@param[in]	cb		called for every batch of matching rows
+@param[out]	stats		counters of the scan
+@return number of leaf pages of the index found, or -1 on error */
+int64_t salvage_scan(int fd, const TableScan &scan, uint32_t n_threads,
+                     bool deleted, const table_page_cb &cb,
+                     SalvageStats *stats);
+
+/** Print the counters of a salvage scan. */
+void salvage_print_stats(const SalvageStats &stats);
+
+#endif
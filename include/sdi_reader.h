@@ -0,0 +1,38 @@
+#ifndef SDI_READER_H
+#define SDI_READER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "include/udef.h"
+
+/** SDI object types (dd::enum_sdi_type) */
+static const uint32_t SDI_TYPE_TABLE = 1;
+static const uint32_t SDI_TYPE_TABLESPACE = 2;
+
+/** One record of the SDI B-tree of a tablespace: a serialized dictionary
+object, the JSON ibd2sdi prints under "object". */
+struct SdiObject {
+  uint32_t type;
+  uint64_t id;
+  std::string json;
+};
+
+/** Get the root page of the SDI B-tree from the FSP header page. The SDI
+version and root page number follow the extent descriptors and the
+encryption information of page 0.
+@param[in]	page0	first page of the tablespace
+@return root page number, or FIL_NULL if the tablespace has no SDI */
+uint32_t sdi_root_page(const byte *page0);
+
+/** Read the objects of the SDI B-tree of a tablespace, as ibd2sdi does:
+the leaf records are visited in key order, the externally stored ones are
+read from their FIL_PAGE_SDI_BLOB chain and the zlib stream of every
+record is inflated. Delete-marked records are skipped.
+@param[in]	fd		tablespace file
+@param[out]	objects		objects in (type, id) order
+@return 0 on success, -1 with a message on stderr on error */
+int sdi_read_objects(int fd, std::vector<SdiObject> *objects);
+
+#endif
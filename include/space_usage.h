@@ -0,0 +1,99 @@
+#ifndef SPACE_USAGE_H
+#define SPACE_USAGE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "include/udef.h"
+#include "include/table_scan.h"
+
+/** Storage of one field of the clustered index records. */
+struct ColumnUsage {
+  ColumnUsage()
+      : n_values(0),
+        n_null(0),
+        inrow_bytes(0),
+        n_extern(0),
+        extern_bytes(0),
+        lob_pages(0) {}
+
+  /** Records with a value in the field, SQL NULL excluded */
+  uint64_t n_values;
+  uint64_t n_null;
+  /** Bytes of the field in the records, the local prefix and the
+  reference of the externally stored values included */
+  uint64_t inrow_bytes;
+  /** Values stored off-page */
+  uint64_t n_extern;
+  /** Length of the off-page parts, as recorded in the references */
+  uint64_t extern_bytes;
+  /** LOB and BLOB pages of the off-page parts */
+  uint64_t lob_pages;
+};
+
+/** Pages of one index of the table, found by their PAGE_INDEX_ID. */
+struct IndexUsage {
+  IndexUsage()
+      : n_leaf_pages(0), n_node_pages(0), n_recs(0), data_bytes(0) {}
+
+  uint64_t n_leaf_pages;
+  uint64_t n_node_pages;
+  /** User records of the leaf pages, delete-marked ones included */
+  uint64_t n_recs;
+  /** Bytes of the records of the leaf pages, headers included */
+  uint64_t data_bytes;
+};
+
+/** Storage of a table, by column and by index. */
+struct SpaceUsage {
+  SpaceUsage()
+      : n_pages(0),
+        n_torn_pages(0),
+        n_recs(0),
+        header_bytes(0),
+        n_lob_pages(0),
+        n_lobs(0),
+        n_dangling(0) {}
+
+  /** Pages read */
+  uint64_t n_pages;
+  /** Leaf pages of the clustered index skipped because they are torn */
+  uint64_t n_torn_pages;
+  /** Records of the clustered index leaf pages */
+  uint64_t n_recs;
+  /** Bytes of the headers of those records */
+  uint64_t header_bytes;
+  /** By field of TableScan::leaf_layout */
+  std::vector<ColumnUsage> columns;
+  /** By index of TableDef::indexes */
+  std::vector<IndexUsage> indexes;
+  /** Pages of the LOB and BLOB page types in the file */
+  uint64_t n_lob_pages;
+  /** Distinct off-page values referenced by the records */
+  uint64_t n_lobs;
+  /** References to a page that starts no LOB or BLOB */
+  uint64_t n_dangling;
+};
+
+/** Account for the storage of a table in one parallel pass over the file.
+Every page is read once, the pages split in ranges across n_threads
+threads. The fields of the records of the clustered index leaf pages are
+measured, and the references of their externally stored values collected.
+The pages of the LOBs (their first page, index pages and data pages, the
+older versions of the entries included) and of the BLOB chains are linked
+to the first page while they are read. The pages reached from the
+references are then attributed to the column of the reference. The LOB
+pages reached from no reference are mostly free pages that kept the type
+of the freed value they held.
+@param[in]	fd		tablespace file
+@param[in]	scan		prepared scan of the clustered index
+@param[in]	n_threads	number of reader threads, 0 for one per CPU
+@param[out]	usage		storage of the table
+@return 0 on success, -1 on error */
+int space_usage_scan(int fd, const TableScan &scan, uint32_t n_threads,
+                     SpaceUsage *usage);
+
+/** Print the storage of a table by column and by index. */
+void space_usage_print(const TableScan &scan, const SpaceUsage &usage);
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef SYS_SPACE_H
+#define SYS_SPACE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+#include "include/udef.h"
+#include "include/fil0fil.h"
+
+/** A data file of a tablespace made of several files. */
+struct SysDataFile {
+  SysDataFile() : fd(-1), first_page(0), n_pages(0), autoextend(false) {}
+
+  std::string file_name;
+  int fd;
+  /** Page number of the first page of the file in the tablespace */
+  uint32_t first_page;
+  uint32_t n_pages;
+  bool autoextend;
+};
+
+/** Parse a list of data files, either file names separated by ',' or an
+innodb_data_file_path style list: "ibdata1:12M;ibdata2:1G:autoextend".
+A size ends with K, M, G or T; a file without one takes its size on disk.
+@param[in]	spec	the list
+@param[out]	files	the files, not opened
+@return 0 on success, -1 on a malformed list */
+int sys_space_parse(const char *spec, std::vector<SysDataFile> *files);
+
+/** @return whether a file argument names several data files */
+bool sys_space_is_multi_file(const char *spec);
+
+/** A tablespace stored in one or more data files, like the system
+tablespace ibdata1, ibdata2, ...: its pages are numbered across the files
+in their order, each file but the last one holding its declared size. */
+class SysSpace {
+ public:
+  SysSpace() : n_pages_(0) {}
+  ~SysSpace();
+
+  SysSpace(const SysSpace &) = delete;
+  SysSpace &operator=(const SysSpace &) = delete;
+
+  /** Open the data files of a list, see sys_space_parse().
+  @return 0 on success, -1 on error */
+  int Open(const char *spec);
+
+  const std::vector<SysDataFile> &files() const { return files_; }
+  uint64_t n_pages() const { return n_pages_; }
+
+  /** Find the file of a page.
+  @param[in]	page_no	page number in the tablespace
+  @param[out]	file	index of the file in files()
+  @param[out]	offset	byte offset of the page in the file
+  @return 0, or -1 if the page is beyond the last file */
+  int Locate(uint32_t page_no, size_t *file, uint64_t *offset) const;
+
+  /** Read consecutive pages, which may span files.
+  @return 0 on success, -1 on a read error or pages beyond the last file */
+  int ReadPages(uint32_t page_no, uint32_t n_pages, byte *buf) const;
+
+ private:
+  std::vector<SysDataFile> files_;
+  uint64_t n_pages_;
+};
+
+/** A run of pages of the same type. */
+struct PageTypeRun {
+  uint32_t first_page;
+  uint32_t n_pages;
+  page_type_t type;
+};
+
+/** Read every page of a tablespace in one parallel pass, the files split
+in ranges of pages across n_threads threads so that all the files are read
+at the same time, and collect the runs of consecutive pages of the same
+type.
+@param[in]	space		the tablespace
+@param[in]	n_threads	number of reader threads, 0 for one per CPU
+@param[out]	runs		runs in page order
+@return 0 on success, -1 on a read error */
+int sys_space_page_types(const SysSpace &space, uint32_t n_threads,
+                         std::vector<PageTypeRun> *runs);
+
+/** The transaction system header page (FIL_PAGE_TYPE_TRX_SYS) of the
+system tablespace. */
+struct TrxSysInfo {
+  TrxSysInfo()
+      : max_trx_id(0),
+        has_binlog(false),
+        binlog_offset(0),
+        has_doublewrite(false),
+        doublewrite_block1(0),
+        doublewrite_block2(0) {}
+
+  /** The highest trx id or trx_no written, in steps of
+  TRX_SYS_TRX_ID_WRITE_MARGIN: the ids handed out on restart start from
+  this value rounded up to the margin, plus twice the margin */
+  uint64_t max_trx_id;
+  /** The binary log position of the last committed transaction */
+  bool has_binlog;
+  std::string binlog_name;
+  uint64_t binlog_offset;
+  /** The doublewrite buffer of MySQL before 8.0.20: two blocks of
+  TRX_SYS_DOUBLEWRITE_BLOCK_SIZE pages */
+  bool has_doublewrite;
+  uint32_t doublewrite_block1;
+  uint32_t doublewrite_block2;
+  /** The used rollback segment slots: space id and header page */
+  struct Rseg {
+    uint32_t slot;
+    uint32_t space_id;
+    uint32_t page_no;
+  };
+  std::vector<Rseg> rsegs;
+};
+
+/** Decode the transaction system header page.
+@param[in]	page	page FSP_TRX_SYS_PAGE_NO of the system tablespace
+@param[out]	info	the header
+@return 0 on success, -1 if the page is not a TRX_SYS page */
+int trx_sys_decode(const byte *page, TrxSysInfo *info);
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef TABLE_DEF_H
+#define TABLE_DEF_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <rapidjson/document.h>
+
+/** Column types as stored in the "type" attribute of an SDI column
+(dd::enum_column_types). */
+enum dd_column_type {
+  DD_TYPE_DECIMAL = 1,
+  DD_TYPE_TINY = 2,
+  DD_TYPE_SHORT = 3,
+  DD_TYPE_LONG = 4,
+  DD_TYPE_FLOAT = 5,
+  DD_TYPE_DOUBLE = 6,
+  DD_TYPE_NULL = 7,
+  DD_TYPE_TIMESTAMP = 8,
+  DD_TYPE_LONGLONG = 9,
+  DD_TYPE_INT24 = 10,
+  DD_TYPE_DATE = 11,
+  DD_TYPE_TIME = 12,
+  DD_TYPE_DATETIME = 13,
+  DD_TYPE_YEAR = 14,
+  DD_TYPE_NEWDATE = 15,
+  DD_TYPE_VARCHAR = 16,
+  DD_TYPE_BIT = 17,
+  DD_TYPE_TIMESTAMP2 = 18,
+  DD_TYPE_DATETIME2 = 19,
+  DD_TYPE_TIME2 = 20,
+  DD_TYPE_NEWDECIMAL = 21,
+  DD_TYPE_ENUM = 22,
+  DD_TYPE_SET = 23,
+  DD_TYPE_TINY_BLOB = 24,
+  DD_TYPE_MEDIUM_BLOB = 25,
+  DD_TYPE_LONG_BLOB = 26,
+  DD_TYPE_BLOB = 27,
+  DD_TYPE_VAR_STRING = 28,
+  DD_TYPE_STRING = 29,
+  DD_TYPE_GEOMETRY = 30,
+  DD_TYPE_JSON = 31
+};
+
+/** Row formats as stored in the "row_format" attribute of an SDI table
+(dd::Table::enum_row_format). */
+enum dd_row_format {
+  DD_ROW_FORMAT_FIXED = 1,
+  DD_ROW_FORMAT_DYNAMIC = 2,
+  DD_ROW_FORMAT_COMPRESSED = 3,
+  DD_ROW_FORMAT_REDUNDANT = 4,
+  DD_ROW_FORMAT_COMPACT = 5,
+  DD_ROW_FORMAT_PAGED = 6
+};
+
+/** Index types as stored in the "type" attribute of an SDI index. */
+enum dd_index_type {
+  DD_INDEX_PRIMARY = 1,
+  DD_INDEX_UNIQUE = 2,
+  DD_INDEX_MULTIPLE = 3,
+  DD_INDEX_FULLTEXT = 4,
+  DD_INDEX_SPATIAL = 5
+};
+
+/** ColumnDef::physical_pos of a table without row versions. */
+static const uint32_t DD_NO_PHYSICAL_POS = 0xFFFFFFFF;
+
+/** Length of an SDI index element which covers the whole column. */
+static const uint32_t DD_ELEMENT_FULL_LENGTH = 0xFFFFFFFF;
+
+/** One column of a table, as described by the SDI. */
+struct ColumnDef {
+  std::string name;
+  std::string column_type_utf8;
+  uint32_t type;
+  bool is_nullable;
+  bool is_unsigned;
+  bool is_virtual;
+  /** 1: visible user column, 2: system column (DB_TRX_ID, ...) */
+  uint32_t hidden;
+  /** Maximum length in bytes */
+  uint32_t char_length;
+  uint32_t numeric_precision;
+  uint32_t numeric_scale;
+  uint32_t datetime_precision;
+  uint32_t collation_id;
+  /** Number of ENUM/SET elements */
+  uint32_t n_elements;
+  /** Row version of the instant ADD COLUMN (MySQL 8.0.29+) that added the
+  column, 0 if it was created with the table */
+  uint32_t version_added;
+  /** Row version of the instant DROP COLUMN that dropped it, 0 if it was
+  not dropped. A dropped column stays in the records written before. */
+  uint32_t version_dropped;
+  /** Position of the field in the clustered index records, or
+  DD_NO_PHYSICAL_POS if the table has no row versions */
+  uint32_t physical_pos;
+  /** Added by an instant ADD COLUMN of MySQL 8.0.12 to 8.0.28 */
+  bool instant_v1;
+  /** Value of an instantly added column in the records written before it
+  was added: SQL NULL, or default_value in the stored format */
+  bool default_null;
+  std::string default_value;
+};
+
+/** One field of an index record. */
+struct IndexFieldDef {
+  /** Position of the column in TableDef::columns */
+  uint32_t col_no;
+  /** Prefix length in bytes, or DD_ELEMENT_FULL_LENGTH */
+  uint32_t length;
+  /** Part of the key (false for the appended hidden fields) */
+  bool is_key;
+};
+
+/** One index of a table, as described by the SDI. */
+struct IndexDef {
+  std::string name;
+  uint32_t type;
+  uint64_t id;
+  uint32_t root;
+  uint32_t space_id;
+  std::vector<IndexFieldDef> fields;
+};
+
+/** A table definition extracted from the serialized dictionary
+information (SDI) of a tablespace. */
+struct TableDef {
+  std::string name;
+  /** InnoDB table id ("se_private_id"), as in the undo records */
+  uint64_t id;
+  uint32_t row_format;
+  /** Number of user columns before the first instant ADD COLUMN of MySQL
+  8.0.12 to 8.0.28 ("instant_col"), 0 if there was none */
+  uint32_t instant_cols;
+  /** Highest row version of the instant ADD/DROP COLUMNs of MySQL
+  8.0.29+, 0 if there was none */
+  uint32_t max_row_version;
+  std::vector<ColumnDef> columns;
+  std::vector<IndexDef> indexes;
+};
+
+/** Build a table definition from the "dd_object" member of a Table SDI.
+@param[in]	dd_object	SDI dd_object of a table
+@param[out]	table		table definition
+@return 0 on success, -1 if the object is not a usable table */
+int table_def_parse(const rapidjson::Value &dd_object, TableDef *table);
+
+/** Load a table definition from an ibd2sdi JSON file, or from the SDI
+B-tree of the tablespace itself when sdi_path is an .ibd file. The file is
+parsed once per run, later calls copy the cached definition while the file
+is unchanged.
+@param[in]	sdi_path	path to the ibd2sdi output or the tablespace
+@param[out]	table		table definition
+@return 0 on success, -1 on error */
+int table_def_load(const char *sdi_path, TableDef *table);
+
+/** Keep a compiled copy of each table definition loaded next to its SDI
+file, in sdi_path.schema, and load it instead of parsing the SDI when the
+checksum of the SDI still matches. Off by default. */
+void table_def_set_schema_cache(bool enable);
+
+/** Encode a table definition in the compiled schema format. */
+void table_def_serialize(const TableDef &table, std::string *out);
+
+/** Decode a table definition encoded by table_def_serialize().
+@return 0 on success, -1 if the input is truncated or corrupt */
+int table_def_deserialize(const std::string &in, TableDef *table);
+
+/** Look up a column by name.
+@return position in TableDef::columns, or -1 if not found */
+int table_def_find_column(const TableDef &table, const char *name);
+
+/** @return the clustered index, or nullptr if the SDI has none */
+const IndexDef *table_def_clust_index(const TableDef &table);
+
+/** @return the index with a name (case insensitive), or nullptr */
+const IndexDef *table_def_find_index(const TableDef &table, const char *name);
+
+/** Maximum number of bytes per character of a collation. */
+uint32_t collation_mbmaxlen(uint32_t collation_id);
+
+/** @return whether the text of a collation is latin1 (cp1252), or ascii
+that is a subset of it */
+bool collation_is_latin1(uint32_t collation_id);
+
+/** Read the value of a key from a "k1=v1;k2=v2;" SDI property string.
+@return true if the key was found */
+bool dd_properties_get(const std::string &props, const char *key,
+                       std::string *value);
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef TABLE_SCAN_H
+#define TABLE_SCAN_H
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+#include "include/udef.h"
+#include "include/rem0types.h"
+#include "include/index_scan.h"
+#include "include/page_decoder.h"
+#include "include/rec_decoder.h"
+#include "include/row_filter.h"
+#include "include/table_def.h"
+
+/** A scan of an index of a table, the clustered index unless another one
+is named: the table definition, the decode plans of the index and the
+rows and columns to return. A secondary index returns the columns of its
+key and the primary key, in far fewer pages than the clustered index when
+those are all a query needs. The layouts point into the table definition,
+so a scan is not copyable. */
+struct TableScan {
+  TableScan() : index(nullptr), root(0), n_decode(0) {}
+  TableScan(const TableScan &) = delete;
+  TableScan &operator=(const TableScan &) = delete;
+
+  TableDef table;
+  const IndexDef *index;
+  /** Root page of the index */
+  uint32_t root;
+  RecLayout leaf_layout;
+  RecLayout node_layout;
+  /** Fields of leaf_layout to output, in table column order or in the
+  order of the --columns list */
+  std::vector<size_t> out_fields;
+  /** Rows to return */
+  RowFilter filter;
+  /** Number of leading fields of a leaf record the output and the filter
+  need, the offsets of the fields after them are never computed */
+  size_t n_decode;
+};
+
+/** Prepare a scan of the clustered index.
+This is table_scan_open_index() without an index name.
+@param[in]	sdi_path	ibd2sdi output of the table
+@param[in]	where		--where clause, nullptr or "" for all rows
+@param[in]	columns		comma separated columns to output, nullptr or
+"" for all visible columns. The system columns DB_ROW_ID, DB_TRX_ID and
+DB_ROLL_PTR may be named too.
+@param[out]	scan		scan to prepare
+@return 0 on success, -1 with a message on stderr on error */
+int table_scan_open(const char *sdi_path, const char *where,
+                    const char *columns, TableScan *scan);
+
+/** Prepare a scan of an index. The columns and the conditions of the
+filter must be fields of the index.
+@param[in]	sdi_path	ibd2sdi output of the table
+@param[in]	index_name	index to scan, nullptr or "" for the clustered
+index
+@param[in]	where		--where clause, nullptr or "" for all rows
+@param[in]	columns		comma separated columns to output, nullptr or
+"" for all visible columns of the index
+@param[out]	scan		scan to prepare
+@return 0 on success, -1 with a message on stderr on error */
+int table_scan_open_index(const char *sdi_path, const char *index_name,
+                          const char *where, const char *columns,
+                          TableScan *scan);
+
+/** Select the record format of the decode plans of a scan, COMPACT or
+REDUNDANT, from the header of the root page of the index. The SDI row
+format is kept if the root page is not an index page, so that a salvage
+scan of a damaged file still has a format.
+@param[in]	fd	tablespace file
+@param[in,out]	scan	prepared scan
+@return 0 if the root page was read, -1 otherwise */
+int table_scan_read_format(int fd, TableScan *scan);
+
+/** Callback of table_scan_rows() for every matching row, return false to
+stop the scan.
+@param[in]	rec	record
+@param[in]	offs	field offsets of the record in scan.leaf_layout */
+typedef std::function<bool(const rec_t *rec, const ulint *offs)> table_row_cb;
+
+/** Visit the live (not delete-marked) records of the index that satisfy
+the filter of the scan, in key order. The filter is
+evaluated on the raw record, only matching rows are passed to cb.
+@param[in]	fd		tablespace file
+@param[in]	scan		prepared scan
+@param[in]	cb		called for every matching row
+@param[out]	n_examined	number of live records examined, or nullptr
+@return number of leaf pages visited, or -1 on error */
+int64_t table_scan_rows(int fd, const TableScan &scan, const table_row_cb &cb,
+                        uint64_t *n_examined);
+
+/** Callback of table_scan_pages() for every leaf page, return false to
+stop the scan.
+@param[in]	batch	matching rows of the page, possibly none */
+typedef std::function<bool(const PageBatch &batch)> table_page_cb;
+
+/** Visit the leaf pages of the index in key order, with
+the live records of each page that satisfy the filter of the scan. The
+offsets of scan.n_decode fields are computed for every record.
+@param[in]	fd		tablespace file
+@param[in]	scan		prepared scan
+@param[in]	cb		called for every leaf page
+@param[out]	n_examined	number of live records examined, or nullptr
+@return number of leaf pages visited, or -1 on error */
+int64_t table_scan_pages(int fd, const TableScan &scan, const table_page_cb &cb,
+                         uint64_t *n_examined);
+
+/** Visit the live records of the index with a key between lo and hi that
+satisfy the filter of the scan. The B-tree is descended from the root to
+the first key not less than lo, reading one page per level, and the leaf
+level is read forward until the first key greater than hi, stopping with
+an error at a page that is not a leaf page of the index. Keys may be a
+prefix of the key of the index.
+@param[in]	fd		tablespace file
+@param[in]	scan		prepared scan
+@param[in]	lo		lower bound, or nullptr for the first row
+@param[in]	hi		upper bound, or nullptr for the last row
+@param[in]	cb		called for every matching row
+@param[out]	n_examined	number of live records examined, or nullptr
+@return number of pages read, or -1 on error */
+int64_t table_scan_range(int fd, const TableScan &scan, const SearchTuple *lo,
+                         const SearchTuple *hi, const table_row_cb &cb,
+                         uint64_t *n_examined);
+
+#endif
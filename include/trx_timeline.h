@@ -0,0 +1,117 @@
+#ifndef TRX_TIMELINE_H
+#define TRX_TIMELINE_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "include/udef.h"
+
+/** Suffix of the transaction index kept next to an undo tablespace */
+static const char *const TRX_TIMELINE_SUFFIX = ".trxidx";
+
+/** An undo log of an undo tablespace: one transaction, its pages and the
+tables it changed. */
+struct TrxLog {
+  TrxLog()
+      : trx_id(0),
+        trx_no(0),
+        page_no(0),
+        log_offset(0),
+        type(0),
+        state(0),
+        del_marks(false),
+        n_pages(0),
+        n_records(0) {}
+
+  uint64_t trx_id;
+  /** Commit number, 0 if not committed or an insert undo log */
+  uint64_t trx_no;
+  /** Header page of the undo log segment and offset of the log header */
+  uint32_t page_no;
+  uint32_t log_offset;
+  /** TRX_UNDO_INSERT or TRX_UNDO_UPDATE */
+  ulint type;
+  /** TRX_UNDO_STATE of the segment, for the last log of the segment only,
+  the earlier logs of a reused segment are committed */
+  ulint state;
+  /** TRX_UNDO_DEL_MARKS: the transaction delete-marked records */
+  bool del_marks;
+  /** Pages of the log: its header page and, for the last log of its
+  segment, the other pages of the segment */
+  uint32_t n_pages;
+  uint32_t n_records;
+  /** Table ids of the records, sorted */
+  std::vector<uint64_t> tables;
+};
+
+/** Callback of TrxTimeline::Find(), return false to stop. */
+typedef std::function<bool(const TrxLog &log)> trx_log_cb;
+
+/** Scan every undo log page of an undo tablespace once for the undo log
+headers and the table ids of their records, and serialize them as a
+transaction index: fixed-size entries sorted by trx_id, the table ids of
+the entries, and the entries in trx_no order.
+@param[in]	fd	undo tablespace file
+@param[out]	index	serialized index, without the file header
+@return 0 on success, -1 on a read error */
+int trx_timeline_build(int fd, std::string *index);
+
+/** The transaction index of an undo tablespace, kept in <undo file>.trxidx
+and mapped on later runs while the undo file keeps its identity, size and
+modification time. Lookups binary search the mapped entries, only the
+entries in range are decoded. */
+class TrxTimeline {
+ public:
+  TrxTimeline();
+  ~TrxTimeline();
+
+  TrxTimeline(const TrxTimeline &) = delete;
+  TrxTimeline &operator=(const TrxTimeline &) = delete;
+
+  /** Map the index of an undo tablespace, or build it with one scan of
+  the file and write it next to the file. The index is kept in memory if
+  it cannot be written.
+  @param[in]	undo_path	undo tablespace file name
+  @param[in]	fd		undo tablespace file
+  @return 0 on success, -1 on error */
+  int Open(const char *undo_path, int fd);
+
+  /** @return whether the index was read from an earlier run */
+  bool reused() const { return reused_; }
+
+  uint32_t n_logs() const { return n_logs_; }
+
+  /** Visit the undo logs with lo <= trx_id <= hi, or lo <= trx_no <= hi,
+  in that order.
+  @param[in]	lo		lower bound
+  @param[in]	hi		upper bound
+  @param[in]	by_trx_no	range of commit numbers instead of ids
+  @param[in]	table_id	only the logs that changed this table, 0
+  for all
+  @param[in]	cb		called for every log
+  @return number of logs passed to cb */
+  uint64_t Find(uint64_t lo, uint64_t hi, bool by_trx_no, uint64_t table_id,
+                const trx_log_cb &cb) const;
+
+ private:
+  /** Point the sections at an index body, validating its counts.
+  @return 0 if the body is well-formed */
+  int Attach(const byte *body, size_t size);
+  void Close();
+  void ReadLog(uint32_t i, TrxLog *log) const;
+
+  void *map_;
+  size_t map_size_;
+  /** The index if it was built in this run */
+  std::string built_;
+  bool reused_;
+  uint32_t n_logs_;
+  uint32_t n_tables_;
+  const byte *logs_;
+  const byte *tables_;
+  const byte *by_trx_no_;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef UNDO_DECODER_H
+#define UNDO_DECODER_H
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+#include "include/udef.h"
+#include "include/fsp0types.h"
+#include "include/page0page.h"
+#include "include/rec_decoder.h"
+
+/** Undo log page types (TRX_UNDO_PAGE_TYPE) */
+static const ulint TRX_UNDO_INSERT = 1;
+static const ulint TRX_UNDO_UPDATE = 2;
+
+/** Undo log segment states (TRX_UNDO_STATE) */
+static const ulint TRX_UNDO_ACTIVE = 1;
+static const ulint TRX_UNDO_CACHED = 2;
+static const ulint TRX_UNDO_TO_FREE = 3;
+static const ulint TRX_UNDO_TO_PURGE = 4;
+static const ulint TRX_UNDO_PREPARED = 5;
+
+/** Undo record types, the low 4 bits of the type byte */
+static const ulint TRX_UNDO_RENAME_TABLE = 9;
+static const ulint TRX_UNDO_INSERT_REC = 11;
+static const ulint TRX_UNDO_UPD_EXIST_REC = 12;
+static const ulint TRX_UNDO_UPD_DEL_REC = 13;
+static const ulint TRX_UNDO_DEL_MARK_REC = 14;
+/** The compiler info of the update is the type byte divided by
+TRX_UNDO_CMPL_INFO_MULT */
+static const ulint TRX_UNDO_CMPL_INFO_MULT = 16;
+/** A flag byte follows the type byte: the update changed a LOB in place */
+static const ulint TRX_UNDO_MODIFY_BLOB = 64;
+/** The update changed an externally stored field */
+static const ulint TRX_UNDO_UPD_EXTERN = 128;
+
+/** Length of an SQL NULL field in an undo record */
+static const uint32_t UNIV_SQL_NULL = 0xFFFFFFFF;
+/** Added to the length of an externally stored field in an undo record */
+static const uint32_t UNIV_EXTERN_STORAGE_FIELD = UNIV_SQL_NULL - 65536;
+
+/** A field of an undo record, pointing into the undo page. */
+struct UndoField {
+  /** Position of the field in the clustered index record */
+  uint32_t field_no;
+  const byte *data;
+  uint32_t len;
+  bool is_null;
+  /** The data is the local prefix and the reference of an externally
+  stored value */
+  bool is_extern;
+};
+
+/** A decoded undo record. The vectors keep their capacity from record to
+record, so that decoding a file allocates nothing once warmed up. */
+struct UndoRecord {
+  /** Offset of the record on its page */
+  ulint offset;
+  /** TRX_UNDO_INSERT_REC, ... */
+  ulint type;
+  ulint cmpl_info;
+  bool updated_extern;
+  uint64_t undo_no;
+  uint64_t table_id;
+  /** Of the record version the update replaced, update records only */
+  ulint info_bits;
+  uint64_t trx_id;
+  uint64_t roll_ptr;
+  /** Primary key fields, empty if the table of the record is not the one
+  of the plan and it is not an insert record */
+  std::vector<UndoField> pk;
+  /** Old values of the updated fields, update records only */
+  std::vector<UndoField> update;
+  /** The update vector could not be decoded to its end, after a field of
+  a LOB modified in place */
+  bool update_truncated;
+};
+
+/** How to decode the records of a table: the primary key fields of an
+update record can only be told from the update vector that follows with
+the number of fields of the primary key. */
+struct UndoPlan {
+  UndoPlan() : table_id(0), layout(nullptr) {}
+
+  /** Table whose records are fully decoded, 0 for none */
+  uint64_t table_id;
+  /** Clustered index leaf decode plan of the table */
+  const RecLayout *layout;
+};
+
+/** Decode an undo record.
+@param[in]	page	undo page
+@param[in]	offset	offset of the record on the page
+@param[in]	end	offset of the next record
+@param[in]	plan	tables to decode fully
+@param[out]	rec	decoded record
+@return 0 on success, -1 if the record is corrupt */
+int undo_rec_decode(const byte *page, ulint offset, ulint end,
+                    const UndoPlan &plan, UndoRecord *rec);
+
+/** An undo log header of the first page of an undo log segment. */
+struct UndoLogHeader {
+  /** Offset of the header on the page */
+  ulint offset;
+  uint64_t trx_id;
+  uint64_t trx_no;
+  bool del_marks;
+};
+
+/** Most undo log headers a page can hold */
+static const size_t UNDO_PAGE_MAX_LOGS = UNIV_PAGE_SIZE / TRX_UNDO_HISTORY_NODE;
+
+/** Read the undo log headers of the first page of an undo log segment,
+following TRX_UNDO_LAST_LOG and TRX_UNDO_PREV_LOG.
+@param[in]	page	undo log page
+@param[out]	logs	UNDO_PAGE_MAX_LOGS entries, the headers by offset
+@return number of headers, 0 if the page is not the first page of its
+segment */
+size_t undo_page_logs(const byte *page, UndoLogHeader *logs);
+
+/** Counters of an undo file scan. */
+struct UndoScanStats {
+  UndoScanStats()
+      : n_pages(0), n_undo_pages(0), n_records(0), n_bad_records(0) {}
+
+  uint64_t n_pages;
+  uint64_t n_undo_pages;
+  uint64_t n_records;
+  /** Records that could not be decoded, the rest of their page is
+  skipped */
+  uint64_t n_bad_records;
+};
+
+/** Callback of undo_scan_file() for every record, return false to stop.
+@param[in]	page_no	page of the record
+@param[in]	log	undo log of the record if it is on the first page of
+its undo segment, else nullptr
+@param[in]	rec	decoded record */
+typedef std::function<bool(uint32_t page_no, const UndoLogHeader *log,
+                           const UndoRecord &rec)>
+    undo_rec_cb;
+
+/** Visit the undo records of one undo log page, those between the start
+of each undo log (TRX_UNDO_LOG_START) or of the page and
+TRX_UNDO_PAGE_FREE.
+@return false if cb stopped the visit */
+bool undo_page_records(uint32_t page_no, const byte *page,
+                       const UndoPlan &plan, UndoRecord *rec,
+                       UndoScanStats *stats, const undo_rec_cb &cb);
+
+/** Decode the undo records of every undo log page of an undo tablespace,
+reading the file sequentially in large reads.
+@param[in]	fd	undo tablespace file
+@param[in]	plan	tables to decode fully
+@param[in]	cb	called for every record
+@param[out]	stats	counters of the scan
+@return 0 on success, -1 on a read error */
+int undo_scan_file(int fd, const UndoPlan &plan, const undo_rec_cb &cb,
+                   UndoScanStats *stats);
+
+/** @return name of an undo record type */
+const char *undo_rec_type_name(ulint type);
+
+#endif
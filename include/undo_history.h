@@ -0,0 +1,78 @@
+#ifndef UNDO_HISTORY_H
+#define UNDO_HISTORY_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "include/udef.h"
+
+/** The history list of a rollback segment: the undo logs of committed
+transactions that purge has not processed yet. */
+struct RsegHistory {
+  RsegHistory()
+      : rseg_id(0),
+        page_no(0),
+        max_size(0),
+        history_size(0),
+        history_len(0),
+        n_logs(0),
+        n_seg_pages(0),
+        oldest_trx_no(UINT64_MAX),
+        newest_trx_no(0),
+        corrupt(false) {}
+
+  /** Slot of the rollback segment in the RSEG_ARRAY page */
+  uint32_t rseg_id;
+  /** Rollback segment header page */
+  uint32_t page_no;
+  /** TRX_RSEG_MAX_SIZE */
+  uint32_t max_size;
+  /** TRX_RSEG_HISTORY_SIZE, the pages of the logs of the history as
+  accounted by InnoDB */
+  uint32_t history_size;
+  /** Length of TRX_RSEG_HISTORY as recorded in its base node */
+  uint32_t history_len;
+  /** Undo logs reached by walking the list */
+  uint64_t n_logs;
+  /** Header pages of the distinct undo log segments of those logs,
+  sorted */
+  std::vector<uint32_t> segments;
+  /** Pages of those segments, from their TRX_UNDO_PAGE_LIST */
+  uint64_t n_seg_pages;
+  /** Smallest and largest TRX_UNDO_TRX_NO of the logs, UINT64_MAX and 0
+  for an empty history */
+  uint64_t oldest_trx_no;
+  uint64_t newest_trx_no;
+  /** The walk stopped at a node out of the file, a loop or a list
+  shorter than its base node says */
+  bool corrupt;
+};
+
+/** Read the rollback segment header pages of an undo tablespace from its
+RSEG_ARRAY page.
+@param[in]	fd		undo tablespace file
+@param[out]	rseg_pages	page of each of the TRX_SYS_N_RSEGS slots,
+FIL_NULL for an unused slot
+@return 0 on success, -1 on error */
+int undo_rseg_array_read(int fd, std::vector<uint32_t> *rseg_pages);
+
+/** Walk the history list of every rollback segment. The rollback segments
+are spread across n_threads threads. A thread walks its lists in lockstep:
+every round reads the next node page of all its lists at once, sorted by
+page number and coalesced into one pread() per run of adjacent pages, so
+that a walk costs one read per round instead of one per node. The nodes of
+a list on a page already read are followed without reading it again.
+@param[in]	fd		undo tablespace file
+@param[in]	rseg_pages	rollback segment header pages, FIL_NULL slots
+are skipped
+@param[in]	n_threads	number of threads, 0 for one per CPU
+@param[out]	history		one entry per rollback segment walked
+@return 0 on success, -1 on a read error */
+int undo_history_walk(int fd, const std::vector<uint32_t> &rseg_pages,
+                      uint32_t n_threads, std::vector<RsegHistory> *history);
+
+/** Print the history of the rollback segments, one line each, and the
+totals of the tablespace. */
+void undo_history_print(const std::vector<RsegHistory> &history);
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef UNDO_USAGE_H
+#define UNDO_USAGE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "include/udef.h"
+
+/** Number of TRX_UNDO_STATE values counted, 0 for an unknown state */
+static const ulint UNDO_N_STATES = 6;
+
+/** An undo log segment, found by its header page: the undo log page
+whose TRX_UNDO_PAGE_NODE has no previous page. */
+struct UndoSegment {
+  UndoSegment()
+      : page_no(0),
+        rseg_id(UINT32_MAX),
+        state(0),
+        type(0),
+        n_logs(0),
+        list_len(0),
+        n_pages(0),
+        inode_page(UINT32_MAX),
+        inode_offset(0),
+        reserved(0),
+        used(0),
+        in_slot(false),
+        in_history(false) {}
+
+  /** Header page of the segment */
+  uint32_t page_no;
+  /** Rollback segment whose undo slots or history list hold the segment,
+  UINT32_MAX for none */
+  uint32_t rseg_id;
+  /** TRX_UNDO_STATE, 0 if not a known state */
+  ulint state;
+  /** TRX_UNDO_INSERT or TRX_UNDO_UPDATE */
+  ulint type;
+  /** Undo log headers on the header page, more than one once a cached
+  update undo segment was reused */
+  uint32_t n_logs;
+  /** Length of TRX_UNDO_PAGE_LIST */
+  uint32_t list_len;
+  /** Undo log pages of the file linked to the header page, the header
+  page included */
+  uint32_t n_pages;
+  /** File segment inode of the segment (TRX_UNDO_FSEG_HEADER) */
+  uint32_t inode_page;
+  uint32_t inode_offset;
+  /** Pages reserved by the file segment and pages in use, 0 if the inode
+  could not be read */
+  uint32_t reserved;
+  uint32_t used;
+  bool in_slot;
+  bool in_history;
+};
+
+/** The undo log segments of a rollback segment, by state. */
+struct RsegUsage {
+  RsegUsage()
+      : rseg_id(0),
+        page_no(0),
+        n_segments(),
+        n_pages(),
+        n_cached_reused(0),
+        n_reserved(0),
+        n_free(0) {}
+
+  uint32_t rseg_id;
+  uint32_t page_no;
+  /** By TRX_UNDO_STATE */
+  uint64_t n_segments[UNDO_N_STATES];
+  uint64_t n_pages[UNDO_N_STATES];
+  /** Cached segments that hold the logs of several transactions */
+  uint64_t n_cached_reused;
+  /** Pages reserved by the file segments of the undo log segments and
+  not in use by them */
+  uint64_t n_reserved;
+  uint64_t n_free;
+};
+
+/** Pages of an undo tablespace by owner and state. */
+struct UndoSpaceUsage {
+  UndoSpaceUsage()
+      : n_pages(0),
+        n_undo_pages(0),
+        n_orphan_pages(0),
+        n_rseg_pages(0),
+        n_space_pages(0),
+        n_allocated_pages(0),
+        n_other_pages(0) {}
+
+  /** Pages read */
+  uint64_t n_pages;
+  /** Pages of type FIL_PAGE_UNDO_LOG */
+  uint64_t n_undo_pages;
+  /** Undo log pages linked to no segment header page, mostly freed
+  pages that kept their type */
+  uint64_t n_orphan_pages;
+  /** RSEG_ARRAY and rollback segment header pages */
+  uint64_t n_rseg_pages;
+  /** FSP_HDR, XDES and INODE pages */
+  uint64_t n_space_pages;
+  /** Pages never written (FIL_PAGE_TYPE_ALLOCATED) */
+  uint64_t n_allocated_pages;
+  uint64_t n_other_pages;
+  /** By header page */
+  std::vector<UndoSegment> segments;
+  /** One per rollback segment of the RSEG_ARRAY page */
+  std::vector<RsegUsage> rsegs;
+};
+
+/** Classify every page of an undo tablespace in one parallel pass over
+the file, the pages split in ranges across n_threads threads. The undo log
+pages are linked to the header page of their segment by their
+TRX_UNDO_PAGE_NODE. The rollback segment of each segment is found from the
+undo slots of the rollback segment headers and from their history lists,
+and its free pages from the file segment inode, with one read per inode
+page. Takes 4 bytes of memory per page of the file.
+@param[in]	fd		undo tablespace file
+@param[in]	n_threads	number of reader threads, 0 for one per CPU
+@param[out]	usage		pages by owner and state
+@return 0 on success, -1 on error */
+int undo_usage_scan(int fd, uint32_t n_threads, UndoSpaceUsage *usage);
+
+/** Print the pages of an undo tablespace by rollback segment and state. */
+void undo_usage_print(const UndoSpaceUsage &usage);
+
+#endif
@@ -0,0 +1,409 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "include/arrow_writer.h"
+#include "include/lob_reader.h"
+#include "include/mach_data.h"
+#include "include/page_decoder.h"
+#include "include/salvage_scan.h"
+#include "include/rec_decoder.h"
+#include "include/table_def.h"
+#include "include/table_scan.h"
+#include "inno_space.h"
+
+/** Arrow type of a column. Integers and temporal types keep a native
+representation, everything else is exported as text or binary. */
+static ArrowField arrow_field_for(const ColumnDef &col) {
+  ArrowField f;
+  f.name = col.name;
+  f.type = ARROW_TYPE_UTF8;
+  f.bit_width = 0;
+  f.is_signed = !col.is_unsigned;
+  f.nullable = col.is_nullable;
+
+  if (rec_col_is_system(col)) {
+    f.type = ARROW_TYPE_INT;
+    f.bit_width = 64;
+    f.is_signed = false;
+    return f;
+  }
+  switch (col.type) {
+    case DD_TYPE_TINY:
+      f.type = ARROW_TYPE_INT;
+      f.bit_width = 8;
+      break;
+    case DD_TYPE_SHORT:
+    case DD_TYPE_YEAR:
+      f.type = ARROW_TYPE_INT;
+      f.bit_width = 16;
+      break;
+    case DD_TYPE_INT24:
+    case DD_TYPE_LONG:
+      f.type = ARROW_TYPE_INT;
+      f.bit_width = 32;
+      break;
+    case DD_TYPE_LONGLONG:
+      f.type = ARROW_TYPE_INT;
+      f.bit_width = 64;
+      break;
+    case DD_TYPE_ENUM:
+    case DD_TYPE_SET:
+    case DD_TYPE_BIT:
+      f.type = ARROW_TYPE_INT;
+      f.bit_width = 64;
+      f.is_signed = false;
+      break;
+    case DD_TYPE_FLOAT:
+      f.type = ARROW_TYPE_FLOAT;
+      break;
+    case DD_TYPE_DOUBLE:
+      f.type = ARROW_TYPE_DOUBLE;
+      break;
+    case DD_TYPE_NEWDATE:
+      f.type = ARROW_TYPE_DATE32;
+      break;
+    case DD_TYPE_DATETIME2:
+      f.type = ARROW_TYPE_TIMESTAMP_US;
+      break;
+    case DD_TYPE_TIMESTAMP2:
+      f.type = ARROW_TYPE_TIMESTAMP_US;
+      f.timezone = "UTC";
+      break;
+    case DD_TYPE_TINY_BLOB:
+    case DD_TYPE_MEDIUM_BLOB:
+    case DD_TYPE_LONG_BLOB:
+    case DD_TYPE_BLOB:
+    case DD_TYPE_VARCHAR:
+    case DD_TYPE_VAR_STRING:
+    case DD_TYPE_STRING:
+      /* Only latin1 is turned into UTF-8, the text of the other single
+      byte character sets is exported as it is stored */
+      if (collation_mbmaxlen(col.collation_id) == 1 &&
+          !collation_is_latin1(col.collation_id)) {
+        f.type = ARROW_TYPE_BINARY;
+      }
+      /* Unreadable externally stored values are exported as null. */
+      f.nullable = true;
+      break;
+    case DD_TYPE_GEOMETRY:
+    case DD_TYPE_JSON:
+      f.type = ARROW_TYPE_BINARY;
+      f.nullable = true;
+      break;
+    default:
+      break;
+  }
+  return f;
+}
+
+/** Append one field value of a record to its column builder. */
+static void arrow_append_field(ArrowColumnBuilder &b, const ColumnDef &col,
+                               const byte *data, ulint len) {
+  if (col.type == DD_TYPE_STRING && col.collation_id != 63) {
+    /* CHAR values are padded with spaces, BINARY ones with 0x00 */
+    while (len > 0 && data[len - 1] == ' ') {
+      len--;
+    }
+  }
+  switch (b.field().type) {
+    case ARROW_TYPE_INT:
+      if (col.type == DD_TYPE_YEAR) {
+        /* YEAR is stored as the offset from 1900, 0 for 0000 */
+        int64_t y = rec_field_read_int(col, data, len);
+        b.AppendInt(y ? y + 1900 : 0);
+        return;
+      }
+      b.AppendInt(rec_field_read_int(col, data, len));
+      return;
+    case ARROW_TYPE_FLOAT:
+    case ARROW_TYPE_DOUBLE:
+      b.AppendDouble(rec_field_read_double(col, data, len));
+      return;
+    case ARROW_TYPE_DATE32:
+      b.AppendInt(rec_field_read_date(data));
+      return;
+    case ARROW_TYPE_TIMESTAMP_US:
+      b.AppendInt(rec_field_read_datetime(col, data));
+      return;
+    case ARROW_TYPE_BINARY:
+      b.AppendBytes(data, len);
+      return;
+    case ARROW_TYPE_UTF8:
+      break;
+  }
+
+  switch (col.type) {
+    case DD_TYPE_STRING:
+    case DD_TYPE_VARCHAR:
+    case DD_TYPE_VAR_STRING:
+    case DD_TYPE_TINY_BLOB:
+    case DD_TYPE_MEDIUM_BLOB:
+    case DD_TYPE_LONG_BLOB:
+    case DD_TYPE_BLOB:
+      if (collation_is_latin1(col.collation_id)) {
+        b.AppendLatin1(data, len);
+      } else {
+        b.AppendBytes(data, len);
+      }
+      return;
+    default: {
+      std::string text;
+      rec_field_to_string(col, data, len, &text);
+      b.AppendBytes(text.data(), text.size());
+      return;
+    }
+  }
+}
+
+/** Most bytes of the values of a variable width column in one record
+batch, the most its int32 offsets address */
+static const uint64_t ARROW_MAX_BATCH_BYTES = INT32_MAX;
+
+/** @return the most bytes a field adds to the values of its column
+builder: an externally stored value of the length in its reference, twice
+that as Latin-1 text turned into UTF-8, an inline value with room for its
+text */
+static uint64_t arrow_field_max_len(const ArrowColumnBuilder &b,
+                                    const ColumnDef &col, const byte *data,
+                                    ulint len, bool is_extern) {
+  if (!is_extern) {
+    return 4 * (uint64_t)len + 64;
+  }
+  if (len < BTR_EXTERN_FIELD_REF_SIZE) {
+    return 0;
+  }
+  const byte *ref = data + len - BTR_EXTERN_FIELD_REF_SIZE;
+  const uint64_t n = len - BTR_EXTERN_FIELD_REF_SIZE +
+                     mach_read_from_4(ref + BTR_EXTERN_LEN + 4);
+  const bool latin1 = b.field().type == ARROW_TYPE_UTF8 &&
+                      collation_is_latin1(col.collation_id);
+  return latin1 ? 2 * n : n;
+}
+
+/** Cut the rows [start, end) of a page short at the first row that could
+take the values of a variable width column of the record batch past
+ARROW_MAX_BATCH_BYTES.
+@return the end of the rows that fit */
+static size_t arrow_rows_fit(const std::vector<ArrowColumnBuilder> &builders,
+                             const TableScan &scan, const PageBatch &batch,
+                             size_t start, size_t end) {
+  for (size_t i = 0; i < builders.size(); i++) {
+    if (!builders[i].is_var_width()) {
+      continue;
+    }
+    const size_t f = scan.out_fields[i];
+    const ColumnDef &col =
+        scan.table.columns[scan.leaf_layout.fields[f].col_no];
+    uint64_t bytes = builders[i].values().size();
+    for (size_t r = start; r < end; r++) {
+      const ulint *offs = batch.rec_offs(r);
+      if (rec_offs_field_is_null(offs, f)) {
+        continue;
+      }
+      ulint len;
+      const byte *data =
+          rec_field_get(batch.recs[r], scan.leaf_layout, offs, f, &len);
+      bytes += arrow_field_max_len(builders[i], col, data, len,
+                                   rec_offs_field_is_extern(offs, f));
+      if (bytes > ARROW_MAX_BATCH_BYTES) {
+        end = r;
+        break;
+      }
+    }
+  }
+  return end;
+}
+
+/** Append an externally stored value to its column builder, streamed
+from the LOB pages a part at a time.
+@return 0 on success, -1 if the value could not be read, or is longer than
+its reference said */
+static int arrow_append_extern(ArrowColumnBuilder &b, const ColumnDef &col,
+                               LobReader &lob, const byte *data, ulint len) {
+  if (!b.is_var_width()) {
+    return -1;
+  }
+  const bool latin1 = b.field().type == ARROW_TYPE_UTF8 &&
+                      collation_is_latin1(col.collation_id);
+  int64_t ret = lob.ReadField(data, len, [&](const byte *part, ulint n) {
+    if (latin1) {
+      b.AppendLatin1Part(part, n);
+    } else {
+      b.AppendBytesPart(part, n);
+    }
+    return true;
+  });
+  if (ret < 0 || b.values().size() > ARROW_MAX_BATCH_BYTES) {
+    b.DiscardBytes();
+    return -1;
+  }
+  b.FinishBytes();
+  return 0;
+}
+
+/** Export the clustered index of the table as an Arrow IPC file.
+@param[in]	out_path	output file
+@param[in]	batch_rows	maximum number of rows per record batch */
+void ExportArrow(const char *out_path, uint32_t batch_rows) {
+  printf("==========================Arrow export==========================\n");
+  TableScan scan;
+  if (table_scan_open_index(InnoSpace::sdi_path_, InnoSpace::index_.c_str(),
+                            InnoSpace::where_.c_str(),
+                            InnoSpace::columns_.c_str(), &scan) != 0) {
+    return;
+  }
+  table_scan_read_format(InnoSpace::fd_, &scan);
+  if (!scan.leaf_layout.is_clustered) {
+    printf("Index: %s\n", scan.index->name.c_str());
+  }
+
+  std::vector<ArrowField> fields;
+  std::vector<ArrowColumnBuilder> builders;
+  for (size_t i = 0; i < scan.out_fields.size(); i++) {
+    const RecFieldPlan &plan = scan.leaf_layout.fields[scan.out_fields[i]];
+    fields.push_back(arrow_field_for(scan.table.columns[plan.col_no]));
+    builders.push_back(ArrowColumnBuilder(fields.back()));
+  }
+  if (builders.empty()) {
+    fprintf(stderr, "[ERROR] table %s has no columns to export\n",
+            scan.table.name.c_str());
+    return;
+  }
+
+  ArrowFileWriter writer;
+  if (writer.Open(out_path, fields) != 0) {
+    return;
+  }
+
+  /* Integer columns stored with the width of their Arrow type are decoded
+  a page at a time, the others a row at a time. */
+  std::vector<bool> batched(builders.size(), false);
+  for (size_t i = 0; i < scan.out_fields.size(); i++) {
+    const RecFieldPlan &plan = scan.leaf_layout.fields[scan.out_fields[i]];
+    batched[i] = fields[i].type == ARROW_TYPE_INT &&
+                 scan.table.columns[plan.col_no].type != DD_TYPE_YEAR &&
+                 plan.fixed_len * 8 == fields[i].bit_width;
+  }
+
+  uint64_t n_rows = 0;
+  uint64_t n_examined = 0;
+  uint64_t n_extern = 0;
+  uint64_t n_extern_null = 0;
+  LobReader lob(InnoSpace::fd_);
+  bool failed = false;
+  std::vector<std::vector<uint8_t> > values(builders.size());
+  std::vector<std::vector<uint8_t> > valid(builders.size());
+
+  const table_page_cb append_batch = [&](const PageBatch &batch) {
+    const size_t n = batch.size();
+    for (size_t i = 0; i < builders.size(); i++) {
+      if (batched[i]) {
+        values[i].resize(n * fields[i].bit_width / 8);
+        valid[i].resize(n);
+        page_batch_decode_int(batch, scan.out_fields[i],
+                              fields[i].bit_width / 8, fields[i].is_signed,
+                              values[i].data(), valid[i].data());
+      }
+    }
+
+    /* Rows [start, end) of the page go to the current record batch, which
+    is written early when their values would not fit it */
+    for (size_t start = 0; start < n;) {
+      size_t end = std::min<size_t>(
+          n, start + batch_rows - builders[0].length());
+      end = arrow_rows_fit(builders, scan, batch, start, end);
+      if (end == start) {
+        if (builders[0].length() == 0) {
+          fprintf(stderr,
+                  "[ERROR] a value of row %lu does not fit the 2 GiB of a "
+                  "record batch\n",
+                  n_rows + 1);
+          failed = true;
+          return false;
+        }
+        if (writer.WriteBatch(builders) != 0) {
+          failed = true;
+          return false;
+        }
+        continue;
+      }
+      for (size_t i = 0; i < builders.size(); i++) {
+        size_t f = scan.out_fields[i];
+        if (batched[i]) {
+          builders[i].AppendInts(
+              &values[i][start * fields[i].bit_width / 8],
+              &valid[i][start], end - start);
+          continue;
+        }
+        const ColumnDef &col =
+            scan.table.columns[scan.leaf_layout.fields[f].col_no];
+        for (size_t r = start; r < end; r++) {
+          const ulint *offs = batch.rec_offs(r);
+          if (rec_offs_field_is_null(offs, f)) {
+            builders[i].AppendNull();
+          } else if (rec_offs_field_is_extern(offs, f)) {
+            ulint len;
+            const byte *data =
+                rec_field_get(batch.recs[r], scan.leaf_layout, offs, f, &len);
+            if (arrow_append_extern(builders[i], col, lob, data, len) != 0) {
+              builders[i].AppendNull();
+              n_extern_null++;
+            }
+            n_extern++;
+          } else {
+            ulint len;
+            const byte *data =
+                rec_field_get(batch.recs[r], scan.leaf_layout, offs, f, &len);
+            arrow_append_field(builders[i], col, data, len);
+          }
+        }
+      }
+      n_rows += end - start;
+      start = end;
+      if (builders[0].length() >= (int64_t)batch_rows &&
+          writer.WriteBatch(builders) != 0) {
+        failed = true;
+        return false;
+      }
+    }
+    return true;
+  };
+
+  int64_t n_pages;
+  SalvageStats stats;
+  if (InnoSpace::salvage_) {
+    n_pages = salvage_scan(InnoSpace::fd_, scan, InnoSpace::threads_,
+                           InnoSpace::undelete_, append_batch, &stats);
+    n_examined = stats.n_examined;
+  } else {
+    n_pages = table_scan_pages(InnoSpace::fd_, scan, append_batch, &n_examined);
+  }
+
+  if (failed || n_pages < 0 || writer.WriteBatch(builders) != 0 ||
+      writer.Close() != 0) {
+    fprintf(stderr, "[ERROR] Arrow export to %s failed\n", out_path);
+    return;
+  }
+  if (InnoSpace::salvage_) {
+    salvage_print_stats(stats);
+  } else {
+    printf("Leaf pages: %ld\n", n_pages);
+  }
+  if (!scan.filter.empty()) {
+    printf("Rows examined: %lu\n", n_examined);
+  }
+  printf("Rows: %lu\n", n_rows);
+  printf("Record batches: %lu\n", writer.n_batches());
+  if (n_extern > 0) {
+    printf("Externally stored values: %lu\n", n_extern);
+  }
+  if (n_extern_null > 0) {
+    printf("Externally stored values exported as null: %lu\n", n_extern_null);
+  }
+  printf("Arrow file: %s\n", out_path);
+}
@@ -0,0 +1,536 @@
+#include "include/arrow_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Arrow IPC constants, see format/Message.fbs and format/Schema.fbs */
+static const int16_t kMetadataV5 = 4;
+static const uint8_t kHeaderSchema = 1;
+static const uint8_t kHeaderRecordBatch = 3;
+static const uint8_t kTypeInt = 2;
+static const uint8_t kTypeFloatingPoint = 3;
+static const uint8_t kTypeBinary = 4;
+static const uint8_t kTypeUtf8 = 5;
+static const uint8_t kTypeDate = 8;
+static const uint8_t kTypeTimestamp = 10;
+static const int16_t kPrecisionSingle = 1;
+static const int16_t kPrecisionDouble = 2;
+static const int16_t kDateUnitDay = 0;
+static const int16_t kTimeUnitMicrosecond = 2;
+static const uint32_t kContinuation = 0xFFFFFFFF;
+static const char kArrowMagic[8] = {'A', 'R', 'R', 'O', 'W', '1', 0, 0};
+
+/** Minimal FlatBuffers builder, enough for the Arrow metadata. Like the
+reference implementation it builds the buffer back to front, so children
+are created before their parents and an object is identified by its
+distance from the end of the buffer. */
+class FlatBuilder {
+public:
+  FlatBuilder() : minalign_(1), table_start_(0) {}
+
+  uint32_t Size() const { return static_cast<uint32_t>(buf_.size()); }
+
+  template <typename T>
+  void Push(T v) {
+    uint8_t bytes[sizeof(T)];
+    memcpy(bytes, &v, sizeof(T)); /* little-endian host */
+    buf_.insert(buf_.begin(), bytes, bytes + sizeof(T));
+  }
+
+  void Pad(size_t n) { buf_.insert(buf_.begin(), n, 0); }
+
+  /** Pad so that len bytes pushed next end up aligned to align. */
+  void PreAlign(size_t len, size_t align) {
+    if (align > minalign_) {
+      minalign_ = align;
+    }
+    Pad((~(buf_.size() + len) + 1) & (align - 1));
+  }
+
+  template <typename T>
+  void PushScalar(T v) {
+    PreAlign(sizeof(T), sizeof(T));
+    Push(v);
+  }
+
+  void PushUOffset(uint32_t target) {
+    PreAlign(sizeof(uint32_t), sizeof(uint32_t));
+    Push<uint32_t>(Size() + sizeof(uint32_t) - target);
+  }
+
+  uint32_t CreateString(const std::string &s) {
+    PreAlign(s.size() + 1, sizeof(uint32_t));
+    Pad(1);
+    buf_.insert(buf_.begin(), s.begin(), s.end());
+    Push<uint32_t>(static_cast<uint32_t>(s.size()));
+    return Size();
+  }
+
+  void StartVector(size_t n, size_t elem_size, size_t align) {
+    PreAlign(n * elem_size, sizeof(uint32_t));
+    PreAlign(n * elem_size, align);
+  }
+
+  uint32_t EndVector(size_t n) {
+    Push<uint32_t>(static_cast<uint32_t>(n));
+    return Size();
+  }
+
+  uint32_t CreateOffsetVector(const std::vector<uint32_t> &offsets) {
+    StartVector(offsets.size(), sizeof(uint32_t), sizeof(uint32_t));
+    for (size_t i = offsets.size(); i > 0; i--) {
+      PushUOffset(offsets[i - 1]);
+    }
+    return EndVector(offsets.size());
+  }
+
+  void StartTable() {
+    fields_.clear();
+    table_start_ = Size();
+  }
+
+  template <typename T>
+  void AddScalar(uint16_t slot, T v) {
+    PushScalar(v);
+    fields_.push_back(FieldLoc(slot, Size()));
+  }
+
+  void AddOffset(uint16_t slot, uint32_t target) {
+    PushUOffset(target);
+    fields_.push_back(FieldLoc(slot, Size()));
+  }
+
+  uint32_t EndTable() {
+    PushScalar<int32_t>(0);
+    const uint32_t table_loc = Size();
+
+    uint16_t n_slots = 0;
+    for (size_t i = 0; i < fields_.size(); i++) {
+      if (fields_[i].slot + 1 > n_slots) {
+        n_slots = fields_[i].slot + 1;
+      }
+    }
+    std::vector<uint16_t> vtable(n_slots, 0);
+    for (size_t i = 0; i < fields_.size(); i++) {
+      vtable[fields_[i].slot] =
+          static_cast<uint16_t>(table_loc - fields_[i].loc);
+    }
+    for (size_t i = n_slots; i > 0; i--) {
+      Push<uint16_t>(vtable[i - 1]);
+    }
+    Push<uint16_t>(static_cast<uint16_t>(table_loc - table_start_));
+    Push<uint16_t>(static_cast<uint16_t>((n_slots + 2) * sizeof(uint16_t)));
+
+    /* The table starts with the signed distance back to its vtable. */
+    int32_t soffset = static_cast<int32_t>(Size() - table_loc);
+    memcpy(&buf_[Size() - table_loc], &soffset, sizeof(soffset));
+    return table_loc;
+  }
+
+  /** Finish the buffer with the root table and pad it to 8 bytes. */
+  std::vector<uint8_t> Finish(uint32_t root) {
+    PreAlign(sizeof(uint32_t), minalign_);
+    PushUOffset(root);
+    std::vector<uint8_t> out(buf_.begin(), buf_.end());
+    out.resize((out.size() + 7) & ~static_cast<size_t>(7), 0);
+    return out;
+  }
+
+private:
+  struct FieldLoc {
+    FieldLoc(uint16_t s, uint32_t l) : slot(s), loc(l) {}
+    uint16_t slot;
+    uint32_t loc;
+  };
+
+  std::vector<uint8_t> buf_;
+  size_t minalign_;
+  uint32_t table_start_;
+  std::vector<FieldLoc> fields_;
+};
+
+/** Create the Field table of one schema field. */
+static uint32_t build_field(FlatBuilder &fb, const ArrowField &field) {
+  uint32_t name = fb.CreateString(field.name);
+  uint32_t timezone = 0;
+  if (field.type == ARROW_TYPE_TIMESTAMP_US && !field.timezone.empty()) {
+    timezone = fb.CreateString(field.timezone);
+  }
+
+  uint8_t type_type = 0;
+  fb.StartTable();
+  switch (field.type) {
+    case ARROW_TYPE_INT:
+      type_type = kTypeInt;
+      fb.AddScalar<int32_t>(0, static_cast<int32_t>(field.bit_width));
+      fb.AddScalar<uint8_t>(1, field.is_signed ? 1 : 0);
+      break;
+    case ARROW_TYPE_FLOAT:
+      type_type = kTypeFloatingPoint;
+      fb.AddScalar<int16_t>(0, kPrecisionSingle);
+      break;
+    case ARROW_TYPE_DOUBLE:
+      type_type = kTypeFloatingPoint;
+      fb.AddScalar<int16_t>(0, kPrecisionDouble);
+      break;
+    case ARROW_TYPE_UTF8:
+      type_type = kTypeUtf8;
+      break;
+    case ARROW_TYPE_BINARY:
+      type_type = kTypeBinary;
+      break;
+    case ARROW_TYPE_DATE32:
+      type_type = kTypeDate;
+      fb.AddScalar<int16_t>(0, kDateUnitDay);
+      break;
+    case ARROW_TYPE_TIMESTAMP_US:
+      type_type = kTypeTimestamp;
+      fb.AddScalar<int16_t>(0, kTimeUnitMicrosecond);
+      if (timezone) {
+        fb.AddOffset(1, timezone);
+      }
+      break;
+  }
+  uint32_t type = fb.EndTable();
+  uint32_t children = fb.CreateOffsetVector(std::vector<uint32_t>());
+
+  fb.StartTable();
+  fb.AddOffset(0, name);
+  fb.AddScalar<uint8_t>(1, field.nullable ? 1 : 0);
+  fb.AddScalar<uint8_t>(2, type_type);
+  fb.AddOffset(3, type);
+  fb.AddOffset(5, children);
+  return fb.EndTable();
+}
+
+/** Create the Schema table. */
+static uint32_t build_schema(FlatBuilder &fb,
+                             const std::vector<ArrowField> &fields) {
+  std::vector<uint32_t> offsets;
+  for (size_t i = 0; i < fields.size(); i++) {
+    offsets.push_back(build_field(fb, fields[i]));
+  }
+  uint32_t vec = fb.CreateOffsetVector(offsets);
+  fb.StartTable();
+  fb.AddScalar<int16_t>(0, 0); /* little endian */
+  fb.AddOffset(1, vec);
+  return fb.EndTable();
+}
+
+/** Create a Message table around a header. */
+static std::vector<uint8_t> finish_message(FlatBuilder &fb, uint8_t type,
+                                           uint32_t header,
+                                           int64_t body_len) {
+  fb.StartTable();
+  fb.AddScalar<int64_t>(3, body_len);
+  fb.AddOffset(2, header);
+  fb.AddScalar<int16_t>(0, kMetadataV5);
+  fb.AddScalar<uint8_t>(1, type);
+  return fb.Finish(fb.EndTable());
+}
+
+ArrowColumnBuilder::ArrowColumnBuilder(const ArrowField &field)
+    : field_(field), length_(0), null_count_(0) {
+  Reset();
+}
+
+uint32_t ArrowColumnBuilder::ValueWidth() const {
+  switch (field_.type) {
+    case ARROW_TYPE_INT:
+      return field_.bit_width / 8;
+    case ARROW_TYPE_FLOAT:
+    case ARROW_TYPE_DATE32:
+      return 4;
+    default:
+      return 8;
+  }
+}
+
+void ArrowColumnBuilder::SetValid(bool valid) {
+  if (length_ % 8 == 0) {
+    validity_.push_back(0);
+  }
+  if (valid) {
+    validity_.back() |= static_cast<uint8_t>(1 << (length_ % 8));
+  } else {
+    null_count_++;
+  }
+  length_++;
+}
+
+void ArrowColumnBuilder::AppendNull() {
+  SetValid(false);
+  if (is_var_width()) {
+    offsets_.push_back(offsets_.back());
+  } else {
+    values_.resize(values_.size() + ValueWidth(), 0);
+  }
+}
+
+void ArrowColumnBuilder::AppendInts(const void *values, const uint8_t *valid,
+                                    size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    SetValid(valid[i] != 0);
+  }
+  const size_t len = n * ValueWidth();
+  const uint8_t *p = static_cast<const uint8_t *>(values);
+  values_.insert(values_.end(), p, p + len);
+}
+
+void ArrowColumnBuilder::AppendInt(int64_t v) {
+  SetValid(true);
+  size_t pos = values_.size();
+  values_.resize(pos + ValueWidth());
+  switch (ValueWidth()) {
+    case 1: {
+      int8_t x = static_cast<int8_t>(v);
+      memcpy(&values_[pos], &x, 1);
+      break;
+    }
+    case 2: {
+      int16_t x = static_cast<int16_t>(v);
+      memcpy(&values_[pos], &x, 2);
+      break;
+    }
+    case 4: {
+      int32_t x = static_cast<int32_t>(v);
+      memcpy(&values_[pos], &x, 4);
+      break;
+    }
+    default:
+      memcpy(&values_[pos], &v, 8);
+      break;
+  }
+}
+
+void ArrowColumnBuilder::AppendDouble(double v) {
+  SetValid(true);
+  size_t pos = values_.size();
+  values_.resize(pos + ValueWidth());
+  if (field_.type == ARROW_TYPE_FLOAT) {
+    float f = static_cast<float>(v);
+    memcpy(&values_[pos], &f, sizeof(f));
+  } else {
+    memcpy(&values_[pos], &v, sizeof(v));
+  }
+}
+
+void ArrowColumnBuilder::AppendBytes(const void *data, size_t len) {
+  AppendBytesPart(data, len);
+  FinishBytes();
+}
+
+void ArrowColumnBuilder::AppendLatin1(const void *data, size_t len) {
+  AppendLatin1Part(data, len);
+  FinishBytes();
+}
+
+void ArrowColumnBuilder::AppendBytesPart(const void *data, size_t len) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  values_.insert(values_.end(), p, p + len);
+}
+
+void ArrowColumnBuilder::AppendLatin1Part(const void *data, size_t len) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < len; i++) {
+    if (p[i] < 0x80) {
+      values_.push_back(p[i]);
+    } else {
+      values_.push_back(static_cast<uint8_t>(0xC0 | (p[i] >> 6)));
+      values_.push_back(static_cast<uint8_t>(0x80 | (p[i] & 0x3F)));
+    }
+  }
+}
+
+void ArrowColumnBuilder::FinishBytes() {
+  SetValid(true);
+  offsets_.push_back(static_cast<int32_t>(values_.size()));
+}
+
+void ArrowColumnBuilder::DiscardBytes() {
+  values_.resize(offsets_.back());
+}
+
+void ArrowColumnBuilder::Reset() {
+  length_ = 0;
+  null_count_ = 0;
+  validity_.clear();
+  values_.clear();
+  offsets_.clear();
+  if (is_var_width()) {
+    offsets_.push_back(0);
+  }
+}
+
+ArrowFileWriter::ArrowFileWriter() : fd_(-1), pos_(0) {}
+
+ArrowFileWriter::~ArrowFileWriter() {
+  if (fd_ != -1) {
+    close(fd_);
+  }
+}
+
+int ArrowFileWriter::Write(const void *data, size_t len) {
+  const char *p = static_cast<const char *>(data);
+  while (len > 0) {
+    ssize_t ret = write(fd_, p, len);
+    if (ret == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf(stderr, "[ERROR] Arrow write failed: %s\n", strerror(errno));
+      return -1;
+    }
+    p += ret;
+    len -= ret;
+    pos_ += ret;
+  }
+  return 0;
+}
+
+int ArrowFileWriter::WriteMessage(const std::vector<uint8_t> &metadata,
+                                  const std::vector<uint8_t> &body,
+                                  Block *block) {
+  block->offset = pos_;
+  block->metadata_len = static_cast<int32_t>(8 + metadata.size());
+  block->body_len = static_cast<int64_t>(body.size());
+
+  int32_t len = static_cast<int32_t>(metadata.size());
+  if (Write(&kContinuation, 4) || Write(&len, 4) ||
+      Write(metadata.data(), metadata.size())) {
+    return -1;
+  }
+  return body.empty() ? 0 : Write(body.data(), body.size());
+}
+
+int ArrowFileWriter::Open(const char *path,
+                          const std::vector<ArrowField> &fields) {
+  fd_ = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ == -1) {
+    fprintf(stderr, "[ERROR] Open %s failed: %s\n", path, strerror(errno));
+    return -1;
+  }
+  fields_ = fields;
+  pos_ = 0;
+  batches_.clear();
+
+  FlatBuilder fb;
+  uint32_t schema = build_schema(fb, fields_);
+  Block block;
+  if (Write(kArrowMagic, sizeof(kArrowMagic)) ||
+      WriteMessage(finish_message(fb, kHeaderSchema, schema, 0),
+                   std::vector<uint8_t>(), &block)) {
+    return -1;
+  }
+  return 0;
+}
+
+/** Append a buffer to the record batch body, padded to 8 bytes. */
+static void append_body(std::vector<uint8_t> &body,
+                        std::vector<int64_t> &buffers, const void *data,
+                        size_t len) {
+  buffers.push_back(static_cast<int64_t>(body.size()));
+  buffers.push_back(static_cast<int64_t>(len));
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  body.insert(body.end(), p, p + len);
+  body.resize((body.size() + 7) & ~static_cast<size_t>(7), 0);
+}
+
+int ArrowFileWriter::WriteBatch(std::vector<ArrowColumnBuilder> &columns) {
+  if (columns.empty() || columns[0].length() == 0) {
+    return 0;
+  }
+  const int64_t n_rows = columns[0].length();
+
+  std::vector<uint8_t> body;
+  std::vector<int64_t> buffers; /* (offset, length) pairs */
+  for (size_t i = 0; i < columns.size(); i++) {
+    const ArrowColumnBuilder &c = columns[i];
+    if (c.null_count() == 0) {
+      append_body(body, buffers, nullptr, 0);
+    } else {
+      append_body(body, buffers, c.validity().data(), c.validity().size());
+    }
+    if (c.is_var_width()) {
+      append_body(body, buffers, c.offsets().data(),
+                  c.offsets().size() * sizeof(int32_t));
+    }
+    append_body(body, buffers, c.values().data(), c.values().size());
+  }
+
+  FlatBuilder fb;
+  size_t n_buffers = buffers.size() / 2;
+  fb.StartVector(n_buffers, 16, 8);
+  for (size_t i = n_buffers; i > 0; i--) {
+    fb.Push<int64_t>(buffers[2 * i - 1]);
+    fb.Push<int64_t>(buffers[2 * i - 2]);
+  }
+  uint32_t buffer_vec = fb.EndVector(n_buffers);
+
+  fb.StartVector(columns.size(), 16, 8);
+  for (size_t i = columns.size(); i > 0; i--) {
+    fb.Push<int64_t>(columns[i - 1].null_count());
+    fb.Push<int64_t>(columns[i - 1].length());
+  }
+  uint32_t node_vec = fb.EndVector(columns.size());
+
+  fb.StartTable();
+  fb.AddScalar<int64_t>(0, n_rows);
+  fb.AddOffset(1, node_vec);
+  fb.AddOffset(2, buffer_vec);
+  uint32_t batch = fb.EndTable();
+
+  Block block;
+  if (WriteMessage(finish_message(fb, kHeaderRecordBatch, batch,
+                                  static_cast<int64_t>(body.size())),
+                   body, &block)) {
+    return -1;
+  }
+  batches_.push_back(block);
+
+  for (size_t i = 0; i < columns.size(); i++) {
+    columns[i].Reset();
+  }
+  return 0;
+}
+
+int ArrowFileWriter::Close() {
+  if (fd_ == -1) {
+    return -1;
+  }
+
+  /* End-of-stream marker */
+  uint32_t eos[2] = {kContinuation, 0};
+  if (Write(eos, sizeof(eos))) {
+    return -1;
+  }
+
+  FlatBuilder fb;
+  uint32_t schema = build_schema(fb, fields_);
+  fb.StartVector(batches_.size(), 24, 8);
+  for (size_t i = batches_.size(); i > 0; i--) {
+    const Block &b = batches_[i - 1];
+    fb.Push<int64_t>(b.body_len);
+    fb.Pad(4);
+    fb.Push<int32_t>(b.metadata_len);
+    fb.Push<int64_t>(b.offset);
+  }
+  uint32_t batch_vec = fb.EndVector(batches_.size());
+  fb.StartTable();
+  fb.AddOffset(3, batch_vec);
+  fb.AddOffset(1, schema);
+  fb.AddScalar<int16_t>(0, kMetadataV5);
+  std::vector<uint8_t> footer = fb.Finish(fb.EndTable());
+
+  int32_t footer_len = static_cast<int32_t>(footer.size());
+  if (Write(footer.data(), footer.size()) || Write(&footer_len, 4) ||
+      Write(kArrowMagic, 6)) {
+    return -1;
+  }
+  int ret = close(fd_);
+  fd_ = -1;
+  return ret == 0 ? 0 : -1;
+}
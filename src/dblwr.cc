@@ -0,0 +1,272 @@
+#include "include/dblwr.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "include/fil0fil.h"
+#include "include/fil0types.h"
+#include "include/fsp0types.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+#include "include/page_crc32.h"
+#include "include/sys_space.h"
+
+/** Number of pages read by one pread() of a doublewrite file or a
+tablespace */
+static const uint32_t DBLWR_READ_PAGES = 64;
+
+/** Suffix of the doublewrite files of MySQL 8.0.20 and later */
+static const char DBLWR_FILE_SUFFIX[] = ".dblwr";
+
+bool page_is_zero(const byte *page) {
+  for (ulint i = 0; i < UNIV_PAGE_SIZE; i++) {
+    if (page[i] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool page_is_corrupted(const byte *page) {
+  if (mach_read_from_4(page + FIL_PAGE_LSN + 4) !=
+      mach_read_from_4(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM +
+                       4)) {
+    return true;
+  }
+  const uint32_t checksum = mach_read_from_4(page + FIL_PAGE_SPACE_OR_CHKSUM);
+  const uint32_t old_checksum =
+      mach_read_from_4(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM);
+  /* Like buf_page_is_corrupted(), accept the page if it is valid under any
+  algorithm, the header and the trailer each checked against the formula
+  the algorithm writes there. */
+  if (checksum == BUF_NO_CHECKSUM_MAGIC &&
+      old_checksum == BUF_NO_CHECKSUM_MAGIC) {
+    return false;
+  }
+  if (checksum == old_checksum &&
+      (checksum == buf_calc_page_crc32(page, false) ||
+       checksum == buf_calc_page_crc32(page, true))) {
+    return false;
+  }
+  /* innodb: the old formula, or the low 4 bytes of the LSN written by
+  versions before 4.0.14, in the trailer, the new formula or 0 in the
+  header */
+  if (old_checksum != mach_read_from_4(page + FIL_PAGE_LSN) &&
+      old_checksum != buf_calc_page_old_checksum(page)) {
+    return true;
+  }
+  return checksum != 0 && checksum != buf_calc_page_new_checksum(page);
+}
+
+void DblwrSet::AddCopy(const byte *page) {
+  stats_.n_slots++;
+  if (page_is_zero(page)) {
+    stats_.n_empty++;
+    return;
+  }
+  if (page_is_corrupted(page)) {
+    stats_.n_invalid++;
+    return;
+  }
+  const uint64_t key = Key(mach_read_from_4(page + FIL_PAGE_SPACE_ID),
+                           mach_read_from_4(page + FIL_PAGE_OFFSET));
+  const auto it = index_.find(key);
+  if (it != index_.end()) {
+    byte *kept = &pages_[it->second * UNIV_PAGE_SIZE];
+    stats_.n_superseded++;
+    if (mach_read_from_8(page + FIL_PAGE_LSN) >
+        mach_read_from_8(kept + FIL_PAGE_LSN)) {
+      memcpy(kept, page, UNIV_PAGE_SIZE);
+    }
+    return;
+  }
+  index_[key] = pages_.size() / UNIV_PAGE_SIZE;
+  pages_.insert(pages_.end(), page, page + UNIV_PAGE_SIZE);
+}
+
+int DblwrSet::AddFile(const char *spec) {
+  const size_t len = strlen(spec);
+  const size_t suffix_len = sizeof DBLWR_FILE_SUFFIX - 1;
+  std::vector<byte> buf(DBLWR_READ_PAGES * UNIV_PAGE_SIZE);
+  if (len > suffix_len &&
+      strcmp(spec + len - suffix_len, DBLWR_FILE_SUFFIX) == 0) {
+    int fd = open(spec, O_RDONLY);
+    struct stat stat_buf;
+    if (fd == -1 || fstat(fd, &stat_buf) == -1) {
+      fprintf(stderr, "[ERROR] Open %s failed: %s\n", spec, strerror(errno));
+      if (fd != -1) {
+        close(fd);
+      }
+      return -1;
+    }
+    if (stat_buf.st_size % UNIV_PAGE_SIZE != 0) {
+      fprintf(stderr, "[WARN] %s is not a multiple of the page size, the "
+              "last partial page is ignored\n", spec);
+    }
+    const uint64_t n_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+    for (uint64_t p = 0; p < n_pages; p += DBLWR_READ_PAGES) {
+      const uint64_t n = std::min<uint64_t>(DBLWR_READ_PAGES, n_pages - p);
+      const ssize_t size = n * UNIV_PAGE_SIZE;
+      if (pread(fd, buf.data(), size, p * UNIV_PAGE_SIZE) != size) {
+        fprintf(stderr, "[ERROR] read of %s failed\n", spec);
+        close(fd);
+        return -1;
+      }
+      for (uint64_t i = 0; i < n; i++) {
+        AddCopy(&buf[i * UNIV_PAGE_SIZE]);
+      }
+    }
+    close(fd);
+    stats_.n_files++;
+    return 0;
+  }
+
+  /* The two blocks of the system tablespace */
+  SysSpace space;
+  if (space.Open(spec) != 0) {
+    return -1;
+  }
+  TrxSysInfo info;
+  if (space.ReadPages(FSP_TRX_SYS_PAGE_NO, 1, buf.data()) != 0 ||
+      trx_sys_decode(buf.data(), &info) != 0) {
+    fprintf(stderr, "[ERROR] %s is neither a .dblwr file nor a system "
+            "tablespace\n", spec);
+    return -1;
+  }
+  if (!info.has_doublewrite) {
+    fprintf(stderr, "[ERROR] %s has no doublewrite buffer\n", spec);
+    return -1;
+  }
+  const uint32_t blocks[] = {info.doublewrite_block1, info.doublewrite_block2};
+  for (uint32_t block : blocks) {
+    if (space.ReadPages(block, TRX_SYS_DOUBLEWRITE_BLOCK_SIZE, buf.data()) !=
+        0) {
+      fprintf(stderr, "[ERROR] read of the doublewrite block at page %u of "
+              "%s failed\n", block, spec);
+      return -1;
+    }
+    for (uint32_t i = 0; i < TRX_SYS_DOUBLEWRITE_BLOCK_SIZE; i++) {
+      AddCopy(&buf[i * UNIV_PAGE_SIZE]);
+    }
+  }
+  stats_.n_files++;
+  return 0;
+}
+
+const byte *DblwrSet::Find(uint32_t space_id, uint32_t page_no) const {
+  const auto it = index_.find(Key(space_id, page_no));
+  return it == index_.end() ? nullptr : &pages_[it->second * UNIV_PAGE_SIZE];
+}
+
+/** Write the copies of a run of adjacent pages with one pwrite(). */
+static int dblwr_write_run(int fd, uint32_t first_page,
+                           const std::vector<const byte *> &copies,
+                           byte *buf, DblwrRestoreStats *stats) {
+  for (size_t i = 0; i < copies.size(); i++) {
+    memcpy(buf + i * UNIV_PAGE_SIZE, copies[i], UNIV_PAGE_SIZE);
+  }
+  const ssize_t size = copies.size() * UNIV_PAGE_SIZE;
+  if (pwrite(fd, buf, size, (uint64_t)first_page * UNIV_PAGE_SIZE) != size) {
+    fprintf(stderr, "[ERROR] write of pages %u..%lu failed: %s\n", first_page,
+            first_page + copies.size() - 1, strerror(errno));
+    return -1;
+  }
+  stats->n_writes++;
+  return 0;
+}
+
+int dblwr_restore(int fd, uint32_t space_id, const DblwrSet &dblwr,
+                  bool dry_run, DblwrRestoreStats *stats) {
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  const uint64_t n_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE,
+                     std::max(DBLWR_READ_PAGES, DBLWR_WRITE_PAGES) *
+                         UNIV_PAGE_SIZE) != 0) {
+    return -1;
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  /* The pages to write back, in page order */
+  std::vector<std::pair<uint32_t, const byte *> > restore;
+  int ret = 0;
+  for (uint64_t first = 0; first < n_pages; first += DBLWR_READ_PAGES) {
+    const uint64_t n = std::min<uint64_t>(DBLWR_READ_PAGES, n_pages - first);
+    const ssize_t size = n * UNIV_PAGE_SIZE;
+    if (pread(fd, buf, size, first * UNIV_PAGE_SIZE) != size) {
+      fprintf(stderr, "[ERROR] read of pages %lu..%lu failed\n", first,
+              first + n - 1);
+      ret = -1;
+      break;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+      const uint32_t page_no = first + i;
+      const byte *page = buf + i * UNIV_PAGE_SIZE;
+      stats->n_pages++;
+      const byte *copy = dblwr.Find(space_id, page_no);
+      const bool zero = page_is_zero(page);
+      /* A zero page is a page never written unless the doublewrite
+      buffer has a copy of it */
+      if (zero ? copy == nullptr : !page_is_corrupted(page)) {
+        continue;
+      }
+      stats->n_corrupt++;
+      stats->corrupt_pages.push_back(page_no);
+      if (copy == nullptr) {
+        stats->n_no_copy++;
+        continue;
+      }
+      /* The LSN of a page whose header and trailer agree was written
+      after the copy if it is higher */
+      if (!zero &&
+          mach_read_from_4(page + FIL_PAGE_LSN + 4) ==
+              mach_read_from_4(page + UNIV_PAGE_SIZE -
+                               FIL_PAGE_END_LSN_OLD_CHKSUM + 4) &&
+          mach_read_from_8(page + FIL_PAGE_LSN) >
+              mach_read_from_8(copy + FIL_PAGE_LSN)) {
+        stats->n_stale_copy++;
+        continue;
+      }
+      stats->n_restored++;
+      restore.push_back(std::make_pair(page_no, copy));
+    }
+  }
+  if (ret != 0 || dry_run || restore.empty()) {
+    free(buf);
+    return ret;
+  }
+
+  std::vector<const byte *> run;
+  uint32_t run_first = 0;
+  for (size_t i = 0; i < restore.size() && ret == 0; i++) {
+    if (!run.empty() && (restore[i].first != run_first + run.size() ||
+                         run.size() == DBLWR_WRITE_PAGES)) {
+      ret = dblwr_write_run(fd, run_first, run, buf, stats);
+      run.clear();
+    }
+    if (run.empty()) {
+      run_first = restore[i].first;
+    }
+    run.push_back(restore[i].second);
+  }
+  if (ret == 0) {
+    ret = dblwr_write_run(fd, run_first, run, buf, stats);
+  }
+  free(buf);
+  if (ret == 0 && fsync(fd) != 0) {
+    fprintf(stderr, "[ERROR] fsync failed: %s\n", strerror(errno));
+    ret = -1;
+  }
+  return ret;
+}
@@ -0,0 +1,530 @@
+#include "include/flashback.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include "include/fil0fil.h"
+#include "include/fsp0fsp.h"
+#include "include/fsp0types.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+#include "include/rem0types.h"
+#include "include/undo_decoder.h"
+
+/** Undo tablespace ids are reserved below the redo log ids, each undo
+space number owning one id per truncation out of 512 */
+static const uint32_t UNDO_SPACE_MAX_ID = 0xFFFFFFEF;
+static const uint32_t UNDO_SPACE_MAX_NUM = 127;
+static const uint32_t UNDO_SPACE_MIN_ID =
+    UNDO_SPACE_MAX_ID + 1 - UNDO_SPACE_MAX_NUM * 512;
+
+/** Number of pages read by one pread() of the undo page cache */
+static const uint32_t UNDO_CACHE_READ_PAGES = 64;
+
+uint32_t undo_space_id2num(uint32_t space_id) {
+  if (space_id < UNDO_SPACE_MIN_ID || space_id > UNDO_SPACE_MAX_ID) {
+    /* The system tablespace, or an undo tablespace of 5.7 */
+    return space_id;
+  }
+  return (UNDO_SPACE_MAX_ID - space_id) % UNDO_SPACE_MAX_NUM + 1;
+}
+
+UndoPageCache::UndoPageCache(uint32_t capacity)
+    : capacity_(std::max<uint32_t>(capacity, 1)),
+      frames_(nullptr),
+      n_hits_(0),
+      n_pages_read_(0),
+      n_reads_(0) {
+  if (posix_memalign((void **)&frames_, UNIV_PAGE_SIZE,
+                     (size_t)capacity_ * UNIV_PAGE_SIZE) != 0) {
+    frames_ = nullptr;
+    return;
+  }
+  for (uint32_t i = capacity_; i > 0; i--) {
+    free_frames_.push_back(i - 1);
+  }
+}
+
+UndoPageCache::~UndoPageCache() { free(frames_); }
+
+int UndoPageCache::AddFile(int fd) {
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  byte *page = nullptr;
+  if (posix_memalign((void **)&page, UNIV_PAGE_SIZE, UNIV_PAGE_SIZE) != 0) {
+    return -1;
+  }
+  ssize_t n_read = pread(fd, page, UNIV_PAGE_SIZE, 0);
+  const uint32_t space_id =
+      mach_read_from_4(page + FSP_HEADER_OFFSET + FSP_SPACE_ID);
+  free(page);
+  if (n_read != (ssize_t)UNIV_PAGE_SIZE) {
+    fprintf(stderr, "[ERROR] read of the FSP header failed: %s\n",
+            n_read < 0 ? strerror(errno) : "short read");
+    return -1;
+  }
+  const uint32_t space_num = undo_space_id2num(space_id);
+  if (space_num > UNDO_SPACE_MAX_NUM) {
+    fprintf(stderr, "[ERROR] space %u is not an undo tablespace\n", space_id);
+    return -1;
+  }
+  if (spaces_.count(space_num) != 0) {
+    fprintf(stderr, "[ERROR] two undo tablespaces with space number %u\n",
+            space_num);
+    return -1;
+  }
+  Space &space = spaces_[space_num];
+  space.fd = fd;
+  space.n_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+  return space_num;
+}
+
+int UndoPageCache::Load(const std::vector<uint64_t> &keys) {
+  if (frames_ == nullptr || keys.size() > capacity_) {
+    return -1;
+  }
+  /* The cached pages of the set become the most recently used, so that
+  the pages replaced below are never pages of the set */
+  std::vector<uint64_t> missing;
+  for (size_t i = 0; i < keys.size(); i++) {
+    std::unordered_map<uint64_t, Slot>::iterator it = slots_.find(keys[i]);
+    if (it != slots_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      n_hits_++;
+      continue;
+    }
+    std::unordered_map<uint32_t, Space>::const_iterator space =
+        spaces_.find(keys[i] >> 32);
+    if (space != spaces_.end() &&
+        (keys[i] & 0xFFFFFFFF) < space->second.n_pages) {
+      missing.push_back(keys[i]);
+    }
+  }
+
+  byte *buf = nullptr;
+  if (!missing.empty() &&
+      posix_memalign((void **)&buf, UNIV_PAGE_SIZE,
+                     UNDO_CACHE_READ_PAGES * UNIV_PAGE_SIZE) != 0) {
+    return -1;
+  }
+  int ret = 0;
+  for (size_t i = 0; i < missing.size();) {
+    /* A run of adjacent pages of one file */
+    size_t n = 1;
+    while (i + n < missing.size() && n < UNDO_CACHE_READ_PAGES &&
+           missing[i + n] == missing[i] + n) {
+      n++;
+    }
+    const Space &space = spaces_[missing[i] >> 32];
+    const uint64_t page_no = missing[i] & 0xFFFFFFFF;
+    ssize_t n_read = pread(space.fd, buf, n * UNIV_PAGE_SIZE,
+                           page_no * UNIV_PAGE_SIZE);
+    n_reads_++;
+    if (n_read != (ssize_t)(n * UNIV_PAGE_SIZE)) {
+      fprintf(stderr, "[ERROR] read of undo pages %lu..%lu failed: %s\n",
+              page_no, page_no + n - 1,
+              n_read < 0 ? strerror(errno) : "short read");
+      ret = -1;
+      break;
+    }
+    n_pages_read_ += n;
+    for (size_t j = 0; j < n; j++) {
+      if (free_frames_.empty()) {
+        const uint64_t victim = lru_.back();
+        lru_.pop_back();
+        free_frames_.push_back(slots_[victim].frame);
+        slots_.erase(victim);
+      }
+      Slot &slot = slots_[missing[i + j]];
+      slot.frame = free_frames_.back();
+      free_frames_.pop_back();
+      lru_.push_front(missing[i + j]);
+      slot.lru = lru_.begin();
+      memcpy(frames_ + (size_t)slot.frame * UNIV_PAGE_SIZE,
+             buf + j * UNIV_PAGE_SIZE, UNIV_PAGE_SIZE);
+    }
+    i += n;
+  }
+  free(buf);
+  return ret;
+}
+
+const byte *UndoPageCache::Get(uint64_t key) const {
+  std::unordered_map<uint64_t, Slot>::const_iterator it = slots_.find(key);
+  if (it == slots_.end()) {
+    return nullptr;
+  }
+  return frames_ + (size_t)it->second.frame * UNIV_PAGE_SIZE;
+}
+
+/** @return position of DB_TRX_ID in the clustered index records of a
+table, followed by DB_ROLL_PTR, or UINT32_MAX */
+static uint32_t flashback_trx_id_field(const TableScan &scan) {
+  const RecLayout &layout = scan.leaf_layout;
+  for (size_t i = 0; i + 1 < layout.fields.size(); i++) {
+    if (scan.table.columns[layout.fields[i].col_no].name == "DB_TRX_ID" &&
+        scan.table.columns[layout.fields[i + 1].col_no].name ==
+            "DB_ROLL_PTR") {
+      return i;
+    }
+  }
+  return UINT32_MAX;
+}
+
+namespace {
+
+/** A field of a row of the window, in the arena of the window */
+struct WindowField {
+  uint32_t off;
+  uint32_t len;
+  bool is_null;
+  bool is_extern;
+};
+
+enum RowState {
+  /** The version is the one seen by the transaction */
+  ROW_VISIBLE,
+  /** An older version is needed */
+  ROW_PENDING,
+  /** The record was inserted since */
+  ROW_INSERTED,
+  ROW_MISSING
+};
+
+struct WindowRow {
+  /** First field in Window::fields */
+  uint32_t field;
+  uint64_t trx_id;
+  uint64_t roll_ptr;
+  RowState state;
+  bool deleted;
+  bool rebuilt;
+  uint32_t n_versions;
+};
+
+/** A roll pointer to follow in a round */
+struct UndoRequest {
+  uint64_t key;
+  uint32_t offset;
+  uint32_t row;
+
+  bool operator<(const UndoRequest &other) const {
+    return key != other.key ? key < other.key : offset < other.offset;
+  }
+};
+
+/** Rows of consecutive leaf pages in key order, with their fields copied
+into one arena. The fields of older versions are appended to the arena,
+the fields are referenced by offset as the arena grows. */
+class Window {
+ public:
+  Window(const TableScan &scan, UndoPageCache *cache, uint64_t as_of,
+         FlashbackStats *stats)
+      : layout_(scan.leaf_layout),
+        n_fields_(scan.leaf_layout.fields.size()),
+        trx_id_field_(flashback_trx_id_field(scan)),
+        cache_(cache),
+        as_of_(as_of),
+        stats_(stats) {
+    plan_.table_id = scan.table.id;
+    plan_.layout = &scan.leaf_layout;
+  }
+
+  size_t size() const { return rows_.size(); }
+
+  /** Copy a record of a leaf page. */
+  void Add(const rec_t *rec, bool deleted, const ulint *offs) {
+    WindowRow row;
+    row.field = fields_.size();
+    row.deleted = deleted;
+    row.rebuilt = false;
+    row.n_versions = 0;
+    for (size_t i = 0; i < n_fields_; i++) {
+      WindowField f;
+      ulint len = 0;
+      const byte *data = rec_field_get(rec, layout_, offs, i, &len);
+      f.is_null = rec_offs_field_is_null(offs, i);
+      f.is_extern = rec_offs_field_is_extern(offs, i);
+      f.off = arena_.size();
+      f.len = f.is_null ? 0 : len;
+      arena_.append((const char *)data, f.len);
+      fields_.push_back(f);
+    }
+    ReadSystemFields(&row);
+    rows_.push_back(row);
+    Settle(rows_.size() - 1);
+  }
+
+  /** Roll back the pending rows to the version of the transaction, then
+  pass the rows to cb and empty the window.
+  @return 0 on success, 1 if cb stopped, -1 on a read error */
+  int Flush(const flashback_row_cb &cb) {
+    int ret = Resolve();
+    std::vector<FlashbackField> out(n_fields_);
+    for (size_t r = 0; r < rows_.size() && ret == 0; r++) {
+      const WindowRow &row = rows_[r];
+      if (row.state == ROW_INSERTED) {
+        stats_->n_inserted_after++;
+        continue;
+      }
+      if (row.state == ROW_MISSING) {
+        stats_->n_history_missing++;
+        continue;
+      }
+      if (row.deleted) {
+        stats_->n_deleted++;
+        continue;
+      }
+      for (size_t i = 0; i < n_fields_; i++) {
+        const WindowField &f = fields_[row.field + i];
+        out[i].data = (const byte *)arena_.data() + f.off;
+        out[i].len = f.len;
+        out[i].is_null = f.is_null;
+        out[i].is_extern = f.is_extern;
+      }
+      stats_->n_rows++;
+      if (row.rebuilt) {
+        stats_->n_rebuilt++;
+      }
+      if (!cb(out.data())) {
+        ret = 1;
+      }
+    }
+    rows_.clear();
+    fields_.clear();
+    arena_.clear();
+    pending_.clear();
+    return ret;
+  }
+
+ private:
+  void ReadSystemFields(WindowRow *row) {
+    const WindowField &trx_id = fields_[row->field + trx_id_field_];
+    const WindowField &roll_ptr = fields_[row->field + trx_id_field_ + 1];
+    row->trx_id =
+        trx_id.len == DATA_TRX_ID_LEN
+            ? mach_read_from_6((const byte *)arena_.data() + trx_id.off)
+            : 0;
+    row->roll_ptr =
+        roll_ptr.len == DATA_ROLL_PTR_LEN
+            ? mach_read_from_7((const byte *)arena_.data() + roll_ptr.off)
+            : 0;
+  }
+
+  /** Decide whether the version of a row is the one to output. */
+  void Settle(size_t r) {
+    WindowRow &row = rows_[r];
+    if (row.trx_id < as_of_) {
+      row.state = ROW_VISIBLE;
+    } else if ((row.roll_ptr >> ROLL_PTR_INSERT_FLAG_POS) & 1) {
+      row.state = ROW_INSERTED;
+    } else if (row.n_versions >= FLASHBACK_MAX_VERSIONS) {
+      row.state = ROW_MISSING;
+    } else {
+      row.state = ROW_PENDING;
+      pending_.push_back(r);
+    }
+  }
+
+  /** Point a field of a row at a new value appended to the arena. */
+  void SetField(const WindowRow &row, uint32_t field_no, const byte *data,
+                uint32_t len, bool is_null, bool is_extern) {
+    WindowField &f = fields_[row.field + field_no];
+    f.off = arena_.size();
+    f.len = is_null ? 0 : len;
+    f.is_null = is_null;
+    f.is_extern = is_extern;
+    arena_.append((const char *)data, f.len);
+  }
+
+  /** Check that an undo record is the previous version of a row: a roll
+  pointer into a purged and reused undo page leads to another record or
+  to garbage. */
+  bool IsPrevious(const WindowRow &row, const UndoRecord &rec) const {
+    if (rec.table_id != plan_.table_id || rec.update_truncated ||
+        rec.trx_id > row.trx_id || rec.pk.size() != layout_.n_uniq ||
+        (rec.type != TRX_UNDO_UPD_EXIST_REC &&
+         rec.type != TRX_UNDO_UPD_DEL_REC &&
+         rec.type != TRX_UNDO_DEL_MARK_REC)) {
+      return false;
+    }
+    for (size_t i = 0; i < rec.pk.size(); i++) {
+      const WindowField &f = fields_[row.field + i];
+      if (rec.pk[i].is_null || rec.pk[i].len != f.len ||
+          memcmp(rec.pk[i].data, arena_.data() + f.off, f.len) != 0) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < rec.update.size(); i++) {
+      if (rec.update[i].field_no >= n_fields_) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /** Apply the undo record of a pending row to get its previous version.
+  @return false if the record is not the previous version */
+  bool Apply(size_t r, const byte *page, uint32_t offset) {
+    WindowRow &row = rows_[r];
+    if (page == nullptr || fil_page_get_type(page) != FIL_PAGE_UNDO_LOG) {
+      return false;
+    }
+    const ulint free =
+        mach_read_from_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE);
+    if (offset < TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_HDR_SIZE ||
+        free > UNIV_PAGE_SIZE - FIL_PAGE_DATA_END || offset >= free) {
+      return false;
+    }
+    /* A record ends with its own offset */
+    const ulint next = mach_read_from_2(page + offset);
+    if (next <= offset + 4 || next > free ||
+        mach_read_from_2(page + next - 2) != offset ||
+        undo_rec_decode(page, offset, next, plan_, &rec_) != 0 ||
+        !IsPrevious(row, rec_)) {
+      return false;
+    }
+
+    for (size_t i = 0; i < rec_.update.size(); i++) {
+      const UndoField &f = rec_.update[i];
+      SetField(row, f.field_no, f.data, f.len, f.is_null, f.is_extern);
+    }
+    byte sys[DATA_TRX_ID_LEN + DATA_ROLL_PTR_LEN];
+    mach_write_to_6(sys, rec_.trx_id);
+    mach_write_to_7(sys + DATA_TRX_ID_LEN, rec_.roll_ptr);
+    SetField(row, trx_id_field_, sys, DATA_TRX_ID_LEN, false, false);
+    SetField(row, trx_id_field_ + 1, sys + DATA_TRX_ID_LEN, DATA_ROLL_PTR_LEN,
+             false, false);
+    row.trx_id = rec_.trx_id;
+    row.roll_ptr = rec_.roll_ptr;
+    row.deleted = (rec_.info_bits & REC_INFO_DELETED_FLAG) != 0;
+    row.rebuilt = true;
+    row.n_versions++;
+    stats_->n_versions++;
+    return true;
+  }
+
+  /** Roll back the pending rows a version per round, the undo pages of a
+  round read through the cache in page order. */
+  int Resolve() {
+    std::vector<UndoRequest> requests;
+    std::vector<uint64_t> keys;
+    while (!pending_.empty()) {
+      stats_->n_rounds++;
+      requests.clear();
+      for (size_t i = 0; i < pending_.size(); i++) {
+        const WindowRow &row = rows_[pending_[i]];
+        UndoRequest req;
+        req.key = undo_page_key(
+            (row.roll_ptr >> ROLL_PTR_SPACE_NUM_POS) & 0x7F,
+            (row.roll_ptr >> ROLL_PTR_PAGE_POS) & 0xFFFFFFFF);
+        req.offset = row.roll_ptr & 0xFFFF;
+        req.row = pending_[i];
+        requests.push_back(req);
+      }
+      pending_.clear();
+      std::sort(requests.begin(), requests.end());
+
+      /* The requests of at most capacity distinct pages at a time */
+      for (size_t start = 0; start < requests.size();) {
+        keys.clear();
+        size_t end = start;
+        while (end < requests.size()) {
+          if (keys.empty() || requests[end].key != keys.back()) {
+            if (keys.size() == cache_->capacity()) {
+              break;
+            }
+            keys.push_back(requests[end].key);
+          }
+          end++;
+        }
+        if (cache_->Load(keys) != 0) {
+          return -1;
+        }
+        for (size_t i = start; i < end; i++) {
+          const UndoRequest &req = requests[i];
+          if (Apply(req.row, cache_->Get(req.key), req.offset)) {
+            Settle(req.row);
+          } else {
+            rows_[req.row].state = ROW_MISSING;
+          }
+        }
+        start = end;
+      }
+    }
+    return 0;
+  }
+
+  const RecLayout &layout_;
+  const size_t n_fields_;
+  /** DB_TRX_ID, followed by DB_ROLL_PTR */
+  const uint32_t trx_id_field_;
+  UndoPageCache *cache_;
+  const uint64_t as_of_;
+  FlashbackStats *stats_;
+  UndoPlan plan_;
+  UndoRecord rec_;
+  std::vector<WindowRow> rows_;
+  std::vector<WindowField> fields_;
+  std::string arena_;
+  std::vector<size_t> pending_;
+};
+
+}  // namespace
+
+int64_t flashback_scan(int fd, const TableScan &scan, UndoPageCache *cache,
+                       uint64_t as_of, const flashback_row_cb &cb,
+                       FlashbackStats *stats) {
+  if (!scan.leaf_layout.is_clustered ||
+      flashback_trx_id_field(scan) == UINT32_MAX) {
+    fprintf(stderr, "[ERROR] flashback needs the clustered index with "
+            "DB_TRX_ID and DB_ROLL_PTR\n");
+    return -1;
+  }
+  Window window(scan, cache, as_of, stats);
+  std::vector<ulint> offs(scan.leaf_layout.fields.size());
+  int ret = 0;
+
+  int64_t n_pages = index_scan_leaves(
+      fd, scan.node_layout, scan.root,
+      [&](const byte *page, uint32_t page_no) {
+        (void)page_no;
+        const bool comp = page_is_comp(page);
+        const page_rec_next_func_t next_rec = page_rec_next_func(page);
+        for (const rec_t *rec = next_rec(page, page_get_infimum(page));
+             rec != nullptr; rec = next_rec(page, rec)) {
+          if (comp && rec_get_status(rec) != REC_STATUS_ORDINARY) {
+            continue;
+          }
+          stats->n_records++;
+          rec_layout_get_offsets(rec, scan.leaf_layout, offs.data());
+          window.Add(rec,
+                     (rec_get_info_bits(rec, comp) & REC_INFO_DELETED_FLAG) !=
+                         0,
+                     offs.data());
+        }
+        if (window.size() >= FLASHBACK_WINDOW_ROWS) {
+          ret = window.Flush(cb);
+        }
+        return ret == 0;
+      });
+
+  if (n_pages >= 0 && ret == 0) {
+    ret = window.Flush(cb);
+  }
+  if (n_pages < 0 || ret < 0) {
+    return -1;
+  }
+  stats->n_leaf_pages = n_pages;
+  return n_pages;
+}
@@ -1,4 +1,8 @@
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
 #include "include/fsp0fsp.h"
+#include "include/page0page.h"
+#include "include/mach_data.h"
 
 
 
@@ -8,3 +12,63 @@ uint32_t File_segment_inode::read_not_full_n_used() const {
   return (n_used);
 }
 
+/** Calculates reserved fragment page slots.
+ @return number of fragment pages */
+ulint fseg_get_n_frag_pages(
+    fseg_inode_t *inode) /*!< in: segment inode */
+{
+  ulint i;
+  ulint count = 0;
+
+
+  for (i = 0; i < FSEG_FRAG_ARR_N_SLOTS; i++) {
+    if (FIL_NULL != mach_read_from_4(inode + FSEG_FRAG_ARR + i * FSEG_FRAG_SLOT_SIZE)) {
+      count++;
+    }
+  }
+
+  return (count);
+}
+
+/** Calculates the number of pages reserved by a segment, and how many
+pages are currently used.
+@param[in]      space_id    Unique tablespace identifier
+@param[in]      inode       File segment inode pointer
+@param[out]     used        Number of pages used (not more than reserved)
+@return number of reserved pages */
+ulint fseg_n_reserved_pages_low(space_id_t space_id, fseg_inode_t *inode,
+                                ulint *used) {
+  ulint ret;
+
+  File_segment_inode fseg_inode(space_id, inode);
+
+  /* number of used segment pages in the FSEG_NOT_FULL list */
+  uint32_t n_used_not_full = fseg_inode.read_not_full_n_used();
+
+  /* total number of segment pages in the FSEG_NOT_FULL list */
+  ulint n_total_not_full =
+      FSP_EXTENT_SIZE * mach_read_from_4(inode + FSEG_NOT_FULL);
+
+  /* n_used can be zero only if n_total is zero. */
+  ut_ad(n_used_not_full > 0 || n_total_not_full == 0);
+  ut_ad((n_used_not_full < n_total_not_full) ||
+        ((n_used_not_full == 0) && (n_total_not_full == 0)));
+
+  /* total number of pages in FSEG_FULL list. */
+  ulint n_total_full = FSP_EXTENT_SIZE * mach_read_from_4(inode + FSEG_FULL + FLST_LEN);
+
+  /* total number of pages in FSEG_FREE list. */
+  ulint n_total_free = FSP_EXTENT_SIZE * flst_get_len(inode + FSEG_FREE);
+
+  /* Number of fragment pages in the segment. */
+  ulint n_frags = fseg_get_n_frag_pages(inode);
+
+  *used = n_frags + n_total_full + n_used_not_full;
+  ret = n_frags + n_total_full + n_total_free + n_total_not_full;
+
+  ut_ad(*used <= ret);
+  ut_ad((*used < ret) || ((n_used_not_full == 0) && (n_total_not_full == 0) &&
+                          (n_total_free == 0)));
+
+  return (ret);
+}
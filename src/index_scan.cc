@@ -0,0 +1,346 @@
+#include "include/index_scan.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/page0page.h"
+#include "include/rec.h"
+#include "include/row_filter.h"
+
+int page_read(int fd, uint32_t page_no, byte *buf) {
+  uint64_t offset = (uint64_t)UNIV_PAGE_SIZE * (uint64_t)page_no;
+  ssize_t ret = pread(fd, buf, UNIV_PAGE_SIZE, offset);
+  if (ret != UNIV_PAGE_SIZE) {
+    return -1;
+  }
+  return 0;
+}
+
+const rec_t *page_rec_get_next_comp(const byte *page, const rec_t *rec) {
+  ulint off = mach_read_from_2(rec - REC_NEXT);
+  if (off == 0) {
+    return nullptr;
+  }
+  /* The next record offset is relative and wraps around the page */
+  off = ((rec - page) + off) & (UNIV_PAGE_SIZE - 1);
+  if (off == PAGE_NEW_SUPREMUM || off < PAGE_NEW_SUPREMUM_END ||
+      off >= UNIV_PAGE_SIZE - FIL_PAGE_DATA_END) {
+    return nullptr;
+  }
+  return page + off;
+}
+
+const rec_t *page_first_user_rec_comp(const byte *page) {
+  return page_rec_get_next_comp(page, page + PAGE_NEW_INFIMUM);
+}
+
+const rec_t *page_rec_get_next_old(const byte *page, const rec_t *rec) {
+  /* The next record offset is from the start of the page */
+  ulint off = mach_read_from_2(rec - REC_NEXT);
+  if (off == 0 || off == PAGE_OLD_SUPREMUM || off < PAGE_OLD_SUPREMUM_END ||
+      off >= UNIV_PAGE_SIZE - FIL_PAGE_DATA_END) {
+    return nullptr;
+  }
+  return page + off;
+}
+
+bool page_is_comp(const byte *page) {
+  return (mach_read_from_2(page + PAGE_HEADER + PAGE_N_HEAP) &
+          PAGE_IS_COMPACT) != 0;
+}
+
+const rec_t *page_get_infimum(const byte *page) {
+  return page + (page_is_comp(page) ? PAGE_NEW_INFIMUM : PAGE_OLD_INFIMUM);
+}
+
+page_rec_next_func_t page_rec_next_func(const byte *page) {
+  return page_is_comp(page) ? page_rec_get_next_comp : page_rec_get_next_old;
+}
+
+const rec_t *page_rec_get_next(const byte *page, const rec_t *rec) {
+  return page_rec_next_func(page)(page, rec);
+}
+
+const rec_t *page_first_user_rec(const byte *page) {
+  return page_rec_get_next(page, page_get_infimum(page));
+}
+
+/** @return child page number stored in a node pointer record */
+static uint32_t node_ptr_get_child(const rec_t *rec,
+                                   const RecLayout &node_layout,
+                                   ulint *offs) {
+  rec_layout_get_offsets(rec, node_layout, offs);
+  ulint n = node_layout.fields.size();
+  return mach_read_from_4(rec + rec_offs_field_start(offs, n - 1));
+}
+
+/** Check that a page read on the way down from the root is a page of the
+index, one level below its parent.
+@param[in]	page		page read
+@param[in]	page_no		page number
+@param[in]	depth		0 for the root
+@param[in,out]	index_id	index id, set from the root
+@param[in,out]	level		level of the parent, set to that of the page
+@return whether the page is the expected child */
+static bool btr_page_check(const byte *page, uint32_t page_no, int depth,
+                           uint64_t *index_id, ulint *level) {
+  if (fil_page_get_type(page) != FIL_PAGE_INDEX) {
+    fprintf(stderr, "[ERROR] page %u is not an index page\n", page_no);
+    return false;
+  }
+  const uint64_t page_index_id =
+      mach_read_from_8(page + PAGE_HEADER + PAGE_INDEX_ID);
+  const ulint page_level = mach_read_from_2(page + PAGE_HEADER + PAGE_LEVEL);
+  if (depth == 0) {
+    *index_id = page_index_id;
+  } else if (page_index_id != *index_id) {
+    fprintf(stderr, "[ERROR] page %u is not a page of index %lu\n", page_no,
+            *index_id);
+    return false;
+  } else if (page_level + 1 != *level) {
+    /* A node pointer to a page of the same or a higher level would loop,
+    one skipping a level leads to the wrong records */
+    fprintf(stderr, "[ERROR] page %u is at level %u, not %u\n", page_no,
+            page_level, *level - 1);
+    return false;
+  }
+  *level = page_level;
+  return true;
+}
+
+uint32_t btr_leftmost_leaf(int fd, const RecLayout &node_layout,
+                           uint32_t root, byte *buf) {
+  std::vector<ulint> offs(node_layout.fields.size());
+  uint32_t page_no = root;
+  uint64_t index_id = 0;
+  ulint level = 0;
+  /* A B-tree is never deeper than this, stop on cyclic node pointers. */
+  for (int depth = 0; depth < 64; depth++) {
+    if (page_read(fd, page_no, buf) != 0) {
+      fprintf(stderr, "[ERROR] read page %u failed\n", page_no);
+      return FIL_NULL;
+    }
+    if (!btr_page_check(buf, page_no, depth, &index_id, &level)) {
+      return FIL_NULL;
+    }
+    if (level == 0) {
+      return page_no;
+    }
+    const rec_t *rec = page_first_user_rec(buf);
+    if (rec == nullptr) {
+      fprintf(stderr, "[ERROR] empty non-leaf page %u\n", page_no);
+      return FIL_NULL;
+    }
+    page_no = node_ptr_get_child(rec, node_layout, offs.data());
+  }
+  fprintf(stderr, "[ERROR] B-tree from root %u is too deep\n", root);
+  return FIL_NULL;
+}
+
+int64_t index_scan_leaves(int fd, const RecLayout &node_layout, uint32_t root,
+                          const leaf_page_cb &cb) {
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  const uint64_t n_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE, UNIV_PAGE_SIZE) != 0) {
+    return -1;
+  }
+
+  int64_t n_visited = 0;
+  uint32_t page_no = btr_leftmost_leaf(fd, node_layout, root, buf);
+  uint64_t index_id = 0;
+  if (page_no == FIL_NULL) {
+    n_visited = -1;
+  } else {
+    index_id = mach_read_from_8(buf + PAGE_HEADER + PAGE_INDEX_ID);
+  }
+  while (page_no != FIL_NULL) {
+    if ((uint64_t)n_visited >= n_pages) {
+      fprintf(stderr, "[ERROR] leaf page list has a cycle at page %u\n",
+              page_no);
+      n_visited = -1;
+      break;
+    }
+    if (n_visited > 0 && page_read(fd, page_no, buf) != 0) {
+      fprintf(stderr, "[ERROR] read page %u failed\n", page_no);
+      n_visited = -1;
+      break;
+    }
+    /* A stale or corrupt FIL_PAGE_NEXT may point to a freed page, a page
+    of another index or a non-leaf page. */
+    if (fil_page_get_type(buf) != FIL_PAGE_INDEX ||
+        mach_read_from_8(buf + PAGE_HEADER + PAGE_INDEX_ID) != index_id ||
+        mach_read_from_2(buf + PAGE_HEADER + PAGE_LEVEL) != 0) {
+      fprintf(stderr, "[ERROR] page %u is not a leaf page of index %lu\n",
+              page_no, index_id);
+      n_visited = -1;
+      break;
+    }
+    n_visited++;
+    if (!cb(buf, page_no)) {
+      break;
+    }
+    page_no = mach_read_from_4(buf + FIL_PAGE_NEXT);
+  }
+  free(buf);
+  return n_visited;
+}
+
+int search_tuple_build(const RecLayout &layout, const char *text,
+                       SearchTuple *tuple) {
+  tuple->keys.clear();
+  tuple->pad_space.clear();
+  std::string s(text);
+  size_t start = 0;
+  for (;;) {
+    size_t end = s.find(',', start);
+    std::string value =
+        s.substr(start, end == std::string::npos ? end : end - start);
+    size_t field = tuple->keys.size();
+    if (field >= layout.n_uniq) {
+      fprintf(stderr, "[ERROR] key %s has more than %u fields\n", text,
+              layout.n_uniq);
+      return -1;
+    }
+    std::string key;
+    bool pad_space;
+    if (rec_field_encode(layout, field, value, &key, &pad_space) != 0) {
+      const ColumnDef &col =
+          layout.table->columns[layout.fields[field].col_no];
+      fprintf(stderr, "[ERROR] cannot search %s (%s) for %s\n",
+              col.name.c_str(), col.column_type_utf8.c_str(), value.c_str());
+      return -1;
+    }
+    tuple->keys.push_back(key);
+    tuple->pad_space.push_back(pad_space);
+    if (end == std::string::npos) {
+      return 0;
+    }
+    start = end + 1;
+  }
+}
+
+int search_tuple_cmp(const SearchTuple &tuple, const rec_t *rec,
+                     const ulint *offs) {
+  for (size_t i = 0; i < tuple.n_fields(); i++) {
+    if (rec_offs_field_is_null(offs, i)) {
+      /* SQL NULL sorts first */
+      return 1;
+    }
+    int cmp = rec_field_cmp_key(rec + rec_offs_field_start(offs, i),
+                                rec_offs_field_len(offs, i), tuple.keys[i],
+                                tuple.pad_space[i]);
+    if (cmp != 0) {
+      return -cmp;
+    }
+  }
+  return 0;
+}
+
+const rec_t *page_search(const byte *page, const RecLayout &layout,
+                         const SearchTuple &tuple, bool le, ulint *offs) {
+  const byte *dir = page + UNIV_PAGE_SIZE - PAGE_DIR;
+  const ulint n_slots = mach_read_from_2(page + PAGE_HEADER + PAGE_N_DIR_SLOTS);
+  const bool comp = page_is_comp(page);
+  const page_rec_next_func_t next_rec = page_rec_next_func(page);
+  const rec_t *infimum = page_get_infimum(page);
+
+  /* The record owning a directory slot, nullptr if the slot is corrupt */
+  auto slot_rec = [&](ulint i) -> const rec_t * {
+    ulint off = mach_read_from_2(dir - (i + 1) * PAGE_DIR_SLOT_SIZE);
+    if (page + off < infimum || off >= UNIV_PAGE_SIZE - PAGE_DIR) {
+      return nullptr;
+    }
+    return page + off;
+  };
+  /* The leftmost node pointer of a level is less than any key */
+  auto rec_lt = [&](const rec_t *rec) {
+    if (rec_get_info_bits(rec, comp) & REC_INFO_MIN_REC_FLAG) {
+      return true;
+    }
+    rec_layout_get_offsets(rec, layout, offs);
+    int cmp = search_tuple_cmp(tuple, rec, offs);
+    return cmp > 0 || (le && cmp == 0);
+  };
+
+  /* Slot 0 owns the infimum and the last slot the supremum, so the owner
+  of low always precedes the tuple and the owner of up does not. */
+  ulint low = 0;
+  ulint up = n_slots > 1 ? n_slots - 1 : 0;
+  const rec_t *up_rec = nullptr;
+  while (up - low > 1) {
+    ulint mid = (low + up) / 2;
+    const rec_t *rec = slot_rec(mid);
+    if (rec == nullptr) {
+      /* Fall back to a linear scan of the page */
+      low = 0;
+      up_rec = nullptr;
+      break;
+    }
+    if (rec_lt(rec)) {
+      low = mid;
+    } else {
+      up = mid;
+      up_rec = rec;
+    }
+  }
+
+  const rec_t *rec = low == 0 ? infimum : slot_rec(low);
+  /* A slot owns at most 8 records, but do not trust a corrupt page */
+  for (ulint n = 0; n < UNIV_PAGE_SIZE / REC_N_NEW_EXTRA_BYTES; n++) {
+    const rec_t *next = next_rec(page, rec);
+    if (next == nullptr || next == up_rec || !rec_lt(next)) {
+      break;
+    }
+    rec = next;
+  }
+  return rec;
+}
+
+uint32_t btr_search_leaf(int fd, const RecLayout &node_layout, uint32_t root,
+                         const SearchTuple &tuple, byte *buf,
+                         uint32_t *n_reads) {
+  std::vector<ulint> offs(node_layout.fields.size());
+  const bool le =
+      node_layout.is_clustered && tuple.n_fields() == node_layout.n_uniq;
+  uint32_t page_no = root;
+  uint64_t index_id = 0;
+  ulint level = 0;
+  for (int depth = 0; depth < 64; depth++) {
+    if (page_read(fd, page_no, buf) != 0) {
+      fprintf(stderr, "[ERROR] read page %u failed\n", page_no);
+      return FIL_NULL;
+    }
+    (*n_reads)++;
+    if (!btr_page_check(buf, page_no, depth, &index_id, &level)) {
+      return FIL_NULL;
+    }
+    if (level == 0) {
+      return page_no;
+    }
+    const rec_t *rec = page_search(buf, node_layout, tuple, le, offs.data());
+    if (rec == page_get_infimum(buf)) {
+      rec = page_first_user_rec(buf);
+    }
+    if (rec == nullptr) {
+      fprintf(stderr, "[ERROR] empty non-leaf page %u\n", page_no);
+      return FIL_NULL;
+    }
+    page_no = node_ptr_get_child(rec, node_layout, offs.data());
+  }
+  fprintf(stderr, "[ERROR] B-tree from root %u is too deep\n", root);
+  return FIL_NULL;
+}
@@ -16,6 +16,8 @@
 #include <errno.h>
 #include <string.h>
 #include <vector>
+#include <algorithm>
+#include <map>
 #include <iostream>
 #include <fstream>
 
@@ -43,9 +45,22 @@
 #include "include/page_crc32.h"
 #include "include/fsp0fsp.h"
 #include "include/fsp0types.h"
+#include "include/dblwr.h"
 #include "include/page0types.h"
+#include "include/redo_apply.h"
+#include "include/redo_log.h"
 #include "include/rem0types.h"
 #include "include/rec.h"
+#include "include/flashback.h"
+#include "include/lob_reader.h"
+#include "include/salvage_scan.h"
+#include "include/space_usage.h"
+#include "include/sys_space.h"
+#include "include/table_scan.h"
+#include "include/trx_timeline.h"
+#include "include/undo_decoder.h"
+#include "include/undo_history.h"
+#include "include/undo_usage.h"
 #include "inno_space.h"
 
 #define kPageSize InnoSpace::kPageSize
@@ -54,8 +69,6 @@
 #define fd InnoSpace::fd_
 #define read_buf InnoSpace::read_buf_
 #define inode_page_buf InnoSpace::inode_page_buf_
-#define offsets_ InnoSpace::offsets_
-#define dict_cols InnoSpace::dict_cols_
 
 struct dict_col {
   std::string col_name;
@@ -148,8 +161,9 @@ static inline bool page_rec_is_infimum_low(
 }
 
 /** Forward declarations of your existing functions: */
-int rec_init_offsets();
-void ShowRecord(rec_t *rec);
+static int rec_layout_for_page(const byte *page, TableDef *table,
+                               RecLayout *layout);
+void ShowRecord(rec_t *rec, const RecLayout &layout);
 
 /** This is your original ShowIndexHeader() that expects the 
     page is NOT compressed. */
@@ -212,7 +226,12 @@ void ShowIndexHeaderPossibleDecompress(uint32_t page_num, bool is_show_records)
       return;
     }
     // Now parse records (like your code).
-    rec_init_offsets(); 
+    TableDef table;
+    RecLayout layout;
+    if (rec_layout_for_page(uncompressed_page, &table, &layout) != 0) {
+      free(uncompressed_page);
+      return;
+    }
     byte* rec_ptr = uncompressed_page + PAGE_NEW_INFIMUM;
 
     while (true) {
@@ -226,7 +245,7 @@ void ShowIndexHeaderPossibleDecompress(uint32_t page_num, bool is_show_records)
         break;
       }
       rec_ptr = uncompressed_page + off;
-      ShowRecord(rec_ptr);
+      ShowRecord(rec_ptr, layout);
       printf("\n");
     }
 
@@ -273,164 +292,83 @@ void hexDump(void *ptr, size_t size) {
   std::cout << std::endl;
 } 
 
-int rec_init_offsets() {
-  // Load the JSON file containing the table schema (columns, etc.)
-  std::ifstream file(sdi_path);
-  if (!file.is_open()) {
-    std::cerr << "Failed to open SDI json file." << std::endl;
-    return 1;
+/** Build the decode plan of the records of an index page from the SDI of
+the table: the index is the one with the PAGE_INDEX_ID of the page, leaf
+records or node pointers as the PAGE_LEVEL says.
+@return 0 on success, -1 if the page is not of an index of the table */
+static int rec_layout_for_page(const byte *page, TableDef *table,
+                               RecLayout *layout) {
+  if (table_def_load(sdi_path, table) != 0) {
+    return -1;
   }
-
-  std::string file_contents;
-  std::string line;
-  while (std::getline(file, line)) {
-    file_contents += line + '\n';
-  }
-  file.close();
-
-  rapidjson::Document d;
-  d.Parse(file_contents.c_str());
-  if (d.HasParseError()) {
-    std::cerr << "JSON parse error: " << rapidjson::GetParseError_En(d.GetParseError())
-              << " offset: " << d.GetErrorOffset() << std::endl;
-    return 1;
-  }
-
-  // 1) Clear out offsets_[] and dict_cols, just to be safe
-  memset(offsets_, 0, sizeof(offsets_));
-  dict_cols.clear();
-  dict_cols.resize(REC_OFFS_NORMAL_SIZE); // Keep same fixed size or enlarge
-
-  // 2) Number of user columns (from JSON).
-  //    Depending on your SDI file format, you may need to adapt indexing:
-  // Instead of this:
-  // auto columns = d[1]["object"]["dd_object"]["columns"];
-  // Do this:
-  const rapidjson::Value& columns = d[1]["object"]["dd_object"]["columns"];
-  const size_t n_user_cols = columns.Size();
-
-  // Store in offsets_[1] how many *user* columns we have
-  offsets_[0] = REC_OFFS_NORMAL_SIZE;   // Usually just a “magic” constant
-  offsets_[1] = n_user_cols;            // total user columns
-
-  // 3) We track the “running offset” for each column within the record
-  ulint current_offset = 0;
-
-  // We'll fill dict_cols[] starting from index=3, so as not to stomp on offsets_[0..2].
-  // This is just a convention inherited from the original code.
-  ulint dict_idx = 3;
-
-  // 4) Parse each user column from the JSON
-  for (size_t i = 0; i < n_user_cols; i++) {
-    dict_cols[dict_idx].col_name 
-      = columns[i]["name"].GetString();
-
-    dict_cols[dict_idx].column_type_utf8 
-      = columns[i]["column_type_utf8"].GetString();
-
-    // Determine length for char(N) vs int, etc.
-    int col_len = 0;
-    if (dict_cols[dict_idx].column_type_utf8 == "int") {
-      col_len = 4;  // typical
-    } else if (dict_cols[dict_idx].column_type_utf8.rfind("char", 0) == 0) {
-      col_len = columns[i]["char_length"].GetInt();
-    } else {
-      std::cerr << "Unsupported column type: " 
-                << dict_cols[dict_idx].column_type_utf8 << std::endl;
-      return -1;
+  const uint64_t index_id = mach_read_from_8(page + PAGE_HEADER + PAGE_INDEX_ID);
+  for (size_t i = 0; i < table->indexes.size(); i++) {
+    if (table->indexes[i].id == index_id) {
+      printf("Index name: %s\n", table->indexes[i].name.c_str());
+      const bool leaf = mach_read_from_2(page + PAGE_HEADER + PAGE_LEVEL) == 0;
+      if (rec_layout_build(*table, table->indexes[i], leaf, layout) != 0) {
+        return -1;
+      }
+      rec_layout_set_format(layout, page);
+      return 0;
     }
-    dict_cols[dict_idx].char_length = col_len;
-
-    // Save the offset of this column in offsets_
-    offsets_[dict_idx] = current_offset;
-
-    // Advance the running offset
-    current_offset += col_len;
-    dict_idx++;
   }
-
-  // 5) Append hidden columns: TRX_ID (6 bytes) and ROLL_PTR (7 bytes).
-  //    (In older MySQL versions, TRX_ID might be 6 or 8 bytes, etc. 
-  //     The code below follows the original approach: 6 for trx_id, 7 for roll_ptr.)
-  offsets_[dict_idx] = current_offset; // TRX_ID
-  current_offset += 6; 
-  dict_idx++;
-
-  offsets_[dict_idx] = current_offset; // ROLL_PTR
-  current_offset += 7; 
-  dict_idx++;
-
-  // 6) offsets_[2] can store the total row length if the code needs it
-  offsets_[2] = current_offset;
-
-  // Return success
-  return 0;
+  fprintf(stderr, "[ERROR] index id %lu is not an index of table %s\n",
+          index_id, table->name.c_str());
+  return -1;
 }
 
-void ShowRecord(rec_t *rec) {
-  ulint heap_no = rec_get_bit_field_2(rec, REC_NEW_HEAP_NO, 
+void ShowRecord(rec_t *rec, const RecLayout &layout) {
+  // REDUNDANT records have their header fields at other offsets and no
+  // status, but the number of fields
+  const bool comp = layout.is_compact;
+  ulint heap_no = rec_get_bit_field_2(rec, comp ? REC_NEW_HEAP_NO : REC_OLD_HEAP_NO,
                                       REC_HEAP_NO_MASK, REC_HEAP_NO_SHIFT);
   printf("heap no %u\n", heap_no);
-  printf("rec status %u\n", rec_get_status(rec));
+  if (comp) {
+    printf("rec status %u\n", rec_get_status(rec));
+  } else {
+    printf("n fields %u\n", rec_get_n_fields_old_raw(rec));
+  }
 
   // If it's marked deleted or sup/min, skip printing
-  if (rec_get_status(rec) >= 2 || heap_no == 1) {
+  if ((comp && rec_get_status(rec) >= 2) || heap_no == 1) {
     return;
   }
 
-  ulint is_delete = rec_get_bit_field_1(rec, REC_NEW_INFO_BITS, 
+  const ulint info_bits = comp ? REC_NEW_INFO_BITS : REC_OLD_INFO_BITS;
+  ulint is_delete = rec_get_bit_field_1(rec, info_bits, 
                                         REC_INFO_DELETED_FLAG,
                                         REC_INFO_BITS_SHIFT);
-  ulint is_min_record = rec_get_bit_field_1(rec, REC_NEW_INFO_BITS, 
+  ulint is_min_record = rec_get_bit_field_1(rec, info_bits, 
                                             REC_INFO_MIN_REC_FLAG,
                                             REC_INFO_BITS_SHIFT);
   printf("Info Flags: is_deleted %u is_min_record %u\n", 
          is_delete, is_min_record);
 
-  // Number of user columns
-  const size_t n_user_cols = offsets_[1];
-
-  // Print each user column
-  for (size_t i = 0; i < n_user_cols; i++) {
-    // The dict_col index is i+3 (we started storing user columns at offset 3)
-    const size_t dict_idx = i + 3;
-    // The offset within the record
-    ulint col_offset = offsets_[dict_idx];
-
-    // Column name
-    printf("%s: ", dict_cols[dict_idx].col_name.c_str());
-
-    // Print according to type
-    if (dict_cols[dict_idx].column_type_utf8 == "int") {
-      // In InnoDB, int fields in a clustered index often have the “sign bit” flipped
-      // for correct sort order. The original code used XOR 0x80000000.
-      // If that’s your preference, keep it:
-      uint32_t val = mach_read_from_4(rec + col_offset) ^ 0x80000000;
-      printf("%u\n", val);
+  // The fields in the order of the index: for a secondary index the key
+  // columns then the primary key, for node pointers the child page last
+  std::vector<ulint> offs(layout.fields.size());
+  rec_layout_get_offsets(rec, layout, offs.data());
+  std::string value;
+  for (size_t i = 0; i < layout.fields.size(); i++) {
+    ulint len;
+    const byte *data = rec_field_get(rec, layout, offs.data(), i, &len);
+    if (layout.fields[i].col_no == REC_FIELD_CHILD_PAGE) {
+      printf("child page no: %u\n", mach_read_from_4(data));
+      continue;
+    }
+    const ColumnDef &col = layout.table->columns[layout.fields[i].col_no];
+    if (rec_offs_field_is_null(offs.data(), i)) {
+      printf("%s: NULL\n", col.name.c_str());
+    } else if (rec_offs_field_is_extern(offs.data(), i)) {
+      printf("%s: <extern>\n", col.name.c_str());
     } else {
-      // e.g. char(N)
-      int len = dict_cols[dict_idx].char_length;
-      printf("%.*s\n", len, rec + col_offset);
+      value.clear();
+      rec_field_to_string(col, data, len, &value);
+      printf("%s: %s\n", col.name.c_str(), value.c_str());
     }
   }
-
-  // 2 hidden columns are stored after all user columns:
-  //   offsets_[n_user_cols+3] => TRX_ID offset
-  //   offsets_[n_user_cols+4] => ROLL_PTR offset
-  ulint trx_id_offset  = offsets_[n_user_cols + 3];
-  ulint roll_ptr_offset = offsets_[n_user_cols + 4];
-
-  // The original code used 6 bytes for TRX_ID, 7 for ROLL_PTR.
-  // You can read them with mach_read_from_6 / mach_read_from_7 or similar:
-  uint64_t trx_id = mach_read_from_6(rec + trx_id_offset);
-  // For roll_ptr, you might do mach_read_from_7(...) or treat it as 7 bytes, etc.
-  // The simplest might be reading 8 bytes but ignoring 1? Or a dedicated function:
-  // If your code does not define mach_read_from_7, you can create it or do a manual approach.
-  // For brevity, assume we have one:
-  uint64_t roll_ptr = mach_read_from_8(rec + roll_ptr_offset);
-
-  printf("trx_id: %llu\n", (unsigned long long) trx_id);
-  printf("roll_ptr: %llu\n", (unsigned long long) roll_ptr);
 }
 
 // void ShowCompressInfo(uint32_t page_num) {
@@ -494,8 +432,14 @@ void ShowIndexHeader(uint32_t page_num, bool is_show_records) {
     return;
   }
   
-  rec_init_offsets();
-  byte *rec_ptr = read_buf + PAGE_NEW_INFIMUM;
+  TableDef table;
+  RecLayout layout;
+  if (rec_layout_for_page(read_buf, &table, &layout) != 0) {
+    return;
+  }
+  // The record list starts at the infimum of the format of the page
+  const bool comp = layout.is_compact;
+  byte *rec_ptr = read_buf + (comp ? PAGE_NEW_INFIMUM : PAGE_OLD_INFIMUM);
   // printf("page_rec_is_infimum_low %d page_rec_is_supremum_low %d\n", page_rec_is_infimum_low(PAGE_NEW_INFIMUM), page_rec_is_supremum_low(PAGE_NEW_SUPREMUM));
   // printf("infimum %d\n", PAGE_NEW_INFIMUM);
   // printf("supremum %d\n", PAGE_NEW_SUPREMUM);
@@ -510,8 +454,14 @@ void ShowIndexHeader(uint32_t page_num, bool is_show_records) {
     // the rec_ptr + off will > 16kb
     // and the result & (UNIV_PAGE_SIZE - 1) will be less then current position
     // after this, off is offset inside page offset
-    off = (((ulong)((rec_ptr + off))) & (UNIV_PAGE_SIZE - 1));
+    // In a REDUNDANT page off is already the offset inside the page
+    if (comp) {
+      off = (((ulong)((rec_ptr - read_buf + off))) & (UNIV_PAGE_SIZE - 1));
+    }
     printf("offset inside page %hu\n", off);
+    if (off == 0 || off >= UNIV_PAGE_SIZE) {
+      break;
+    }
     // handle supremum
     // https://raw.githubusercontent.com/baotiao/bb/main/uPic/image-20211212031146188.png
     // off == 0 mean this is SUPREMUM record
@@ -519,7 +469,7 @@ void ShowIndexHeader(uint32_t page_num, bool is_show_records) {
       break;
     }
     rec_ptr = read_buf + off;
-    ShowRecord(rec_ptr);
+    ShowRecord(rec_ptr, layout);
     printf("\n");
   }
 
@@ -766,6 +716,161 @@ void ShowUndoFile() {
   }
 }
 
+void ShowUndoHistory() {
+  printf("==========================Undo history==========================\n");
+  std::vector<uint32_t> rseg_pages;
+  if (undo_rseg_array_read(fd, &rseg_pages) != 0) {
+    return;
+  }
+  std::vector<RsegHistory> history;
+  if (undo_history_walk(fd, rseg_pages, InnoSpace::threads_, &history) != 0) {
+    fprintf(stderr, "[ERROR] walk of the history lists failed\n");
+    return;
+  }
+  undo_history_print(history);
+}
+
+void ShowUndoUsage() {
+  printf("==========================Undo usage==========================\n");
+  UndoSpaceUsage usage;
+  if (undo_usage_scan(fd, InnoSpace::threads_, &usage) != 0) {
+    fprintf(stderr, "[ERROR] undo usage scan failed\n");
+    return;
+  }
+  undo_usage_print(usage);
+}
+
+static const char *trx_log_state_name(ulint state) {
+  switch (state) {
+    case 0:
+      return "-";
+    case TRX_UNDO_ACTIVE:
+      return "active";
+    case TRX_UNDO_CACHED:
+      return "cached";
+    case TRX_UNDO_TO_FREE:
+      return "to_free";
+    case TRX_UNDO_TO_PURGE:
+      return "to_purge";
+    case TRX_UNDO_PREPARED:
+      return "prepared";
+    default:
+      return "unknown";
+  }
+}
+
+void ShowTrxTimeline(const char *lo, const char *hi, bool by_trx_no,
+                     uint64_t table_id) {
+  printf("==========================Trx timeline==========================\n");
+  TrxTimeline timeline;
+  if (timeline.Open(path, fd) != 0) {
+    fprintf(stderr, "[ERROR] build of the transaction index failed\n");
+    return;
+  }
+  printf("Index: %s%s %s, %u undo logs\n", path, TRX_TIMELINE_SUFFIX,
+         timeline.reused() ? "reused" : "built", timeline.n_logs());
+  const uint64_t low = lo[0] != '\0' ? strtoull(lo, nullptr, 10) : 0;
+  const uint64_t high = hi[0] != '\0' ? strtoull(hi, nullptr, 10) : UINT64_MAX;
+  printf("%-14s %-14s %-6s %-8s %-3s %-14s %7s %9s  %s\n", "trx_id", "trx_no",
+         "type", "state", "del", "page:offset", "pages", "records",
+         "tables");
+  const uint64_t n_found = timeline.Find(
+      low, high, by_trx_no, table_id, [](const TrxLog &log) {
+        std::string tables;
+        for (size_t i = 0; i < log.tables.size(); i++) {
+          tables += (i > 0 ? "," : "") + std::to_string(log.tables[i]);
+        }
+        char location[32];
+        snprintf(location, sizeof(location), "%u:%u", log.page_no,
+                 log.log_offset);
+        printf("%-14lu %-14lu %-6s %-8s %-3s %-14s %7u %9u  %s\n", log.trx_id,
+               log.trx_no,
+               log.type == TRX_UNDO_INSERT
+                   ? "insert"
+                   : log.type == TRX_UNDO_UPDATE ? "update" : "?",
+               trx_log_state_name(log.state), log.del_marks ? "yes" : "no",
+               location, log.n_pages, log.n_records, tables.c_str());
+        return true;
+      });
+  printf("Undo logs found: %lu\n", n_found);
+}
+
+void ShowRedoLog(const char *redo_paths, uint64_t since_lsn, uint32_t top,
+                 bool list_pages) {
+  printf("==========================Redo log==========================\n");
+  RedoLog redo;
+  if (redo.Open(redo_paths) != 0) {
+    fprintf(stderr, "[ERROR] open of the redo log failed\n");
+    return;
+  }
+  for (const RedoFile &file : redo.files()) {
+    printf("File: %s, format %u, start LSN %lu, %lu bytes, created by %s\n",
+           file.file_name.c_str(), file.format, file.start_lsn, file.size,
+           file.creator.c_str());
+  }
+  printf("Checkpoint LSN: %lu\n", redo.checkpoint_lsn());
+  std::vector<RedoPageChanges> pages;
+  RedoScanStats stats;
+  redo_changed_pages(redo, since_lsn, &pages, &stats);
+  printf("LSN: %lu..%lu, blocks: %lu, bad blocks: %lu, mini-transactions: "
+         "%lu, records: %lu, resyncs: %lu, bytes not parsed: %lu\n",
+         stats.first_lsn, stats.end_lsn, stats.n_blocks, stats.n_bad_blocks,
+         stats.n_mtrs, stats.n_records, stats.n_resyncs,
+         stats.n_unparsed_bytes);
+
+  if (list_pages) {
+    printf("%-12s %-12s %10s %12s %16s\n", "space_id", "page_no", "records",
+           "bytes", "last_lsn");
+    for (const RedoPageChanges &page : pages) {
+      printf("%-12u %-12u %10lu %12lu %16lu\n", page.space_id, page.page_no,
+             page.n_records, page.n_bytes, page.last_lsn);
+    }
+    printf("Pages changed since LSN %lu: %lu\n", since_lsn, pages.size());
+    return;
+  }
+
+  printf("%-40s %12s\n", "record type", "records");
+  for (uint32_t type = 0; type < stats.n_by_type.size(); type++) {
+    if (stats.n_by_type[type] != 0) {
+      printf("%-40s %12lu\n", mlog_type_name(type), stats.n_by_type[type]);
+    }
+  }
+
+  /* Pages are sorted by space id */
+  printf("%-12s %12s %14s %10s\n", "space_id", "records", "bytes", "pages");
+  for (size_t i = 0; i < pages.size();) {
+    const uint32_t space_id = pages[i].space_id;
+    uint64_t n_records = 0;
+    uint64_t n_bytes = 0;
+    uint64_t n_pages = 0;
+    for (; i < pages.size() && pages[i].space_id == space_id; i++) {
+      n_records += pages[i].n_records;
+      n_bytes += pages[i].n_bytes;
+      n_pages++;
+    }
+    printf("%-12u %12lu %14lu %10lu\n", space_id, n_records, n_bytes, n_pages);
+  }
+  printf("Pages changed since LSN %lu: %lu\n", since_lsn, pages.size());
+
+  const size_t n_hot = std::min<size_t>(top, pages.size());
+  std::partial_sort(pages.begin(), pages.begin() + n_hot, pages.end(),
+                    [](const RedoPageChanges &a, const RedoPageChanges &b) {
+                      return a.n_records != b.n_records
+                                 ? a.n_records > b.n_records
+                                 : a.n_bytes > b.n_bytes;
+                    });
+  printf("Hottest pages:\n");
+  printf("%-24s %10s %12s %16s\n", "space_id:page_no", "records", "bytes",
+         "last_lsn");
+  for (size_t i = 0; i < n_hot; i++) {
+    char location[32];
+    snprintf(location, sizeof(location), "%u:%u", pages[i].space_id,
+             pages[i].page_no);
+    printf("%-24s %10lu %12lu %16lu\n", location, pages[i].n_records,
+           pages[i].n_bytes, pages[i].last_lsn);
+  }
+}
+
 void UpdateCheckSum(uint32_t page_num) {
   printf("==========================DeletePage==========================\n");
   uint64_t offset = (uint64_t)kPageSize * (uint64_t)page_num;
@@ -828,6 +933,136 @@ static uint32_t find_next_page(uint32_t page_num) {
   return 0;
 }
 
+void RestoreFromDoublewrite(const char *dblwr_paths, bool dry_run) {
+  printf("==========================Doublewrite %s==========================\n",
+         dry_run ? "check" : "restore");
+  DblwrSet dblwr;
+  std::string paths = dblwr_paths;
+  for (size_t pos = 0; pos <= paths.size();) {
+    size_t comma = paths.find(',', pos);
+    if (comma == std::string::npos) {
+      comma = paths.size();
+    }
+    if (dblwr.AddFile(paths.substr(pos, comma - pos).c_str()) != 0) {
+      return;
+    }
+    pos = comma + 1;
+  }
+  const DblwrStats &ds = dblwr.stats();
+  printf("Doublewrite files: %lu, slots: %lu, empty: %lu, invalid: %lu, "
+         "superseded: %lu, pages with a copy: %lu\n",
+         ds.n_files, ds.n_slots, ds.n_empty, ds.n_invalid, ds.n_superseded,
+         dblwr.n_pages());
+
+  int ret = pread(fd, read_buf, kPageSize, 0);
+  if (ret != (int)kPageSize) {
+    fprintf(stderr, "[ERROR] read of page 0 failed\n");
+    return;
+  }
+  const uint32_t space_id =
+      mach_read_from_4(read_buf + FSP_HEADER_OFFSET + FSP_SPACE_ID);
+  DblwrRestoreStats stats;
+  ret = dblwr_restore(fd, space_id, dblwr, dry_run, &stats);
+  for (size_t i = 0; i < stats.corrupt_pages.size(); i++) {
+    const uint32_t page_no = stats.corrupt_pages[i];
+    printf("Corrupt page %u: %s\n", page_no,
+           dblwr.Find(space_id, page_no) != nullptr ? "copy found"
+                                                    : "no copy");
+  }
+  printf("Space id: %u, pages: %lu, corrupt: %lu, %s: %lu, no copy: %lu, "
+         "copy older than the page: %lu, writes: %lu\n",
+         space_id, stats.n_pages, stats.n_corrupt,
+         dry_run ? "restorable" : "restored", stats.n_restored,
+         stats.n_no_copy, stats.n_stale_copy, stats.n_writes);
+  if (ret != 0) {
+    fprintf(stderr, "[ERROR] doublewrite restore failed\n");
+  }
+}
+
+void RedoApply(const char *redo_paths, const char *page_list,
+               uint64_t target_lsn, bool dry_run) {
+  printf("==========================Redo apply%s==========================\n",
+         dry_run ? " check" : "");
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) != 0) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return;
+  }
+  const uint64_t n_file_pages = stat_buf.st_size / kPageSize;
+  /* Page numbers and ranges lo..hi, comma separated, checked against the
+  size of the file before a range is expanded */
+  std::vector<uint32_t> page_nos;
+  std::string list = page_list;
+  for (size_t pos = 0; pos <= list.size();) {
+    size_t comma = list.find(',', pos);
+    if (comma == std::string::npos) {
+      comma = list.size();
+    }
+    const std::string item = list.substr(pos, comma - pos);
+    const size_t dots = item.find("..");
+    char *end = nullptr;
+    const uint32_t lo = strtoul(item.c_str(), &end, 10);
+    uint32_t hi = lo;
+    if (dots != std::string::npos && end == item.c_str() + dots) {
+      hi = strtoul(item.c_str() + dots + 2, &end, 10);
+    }
+    if (item.empty() || *end != '\0' || hi < lo) {
+      fprintf(stderr, "[ERROR] Invalid page list %s\n", page_list);
+      return;
+    }
+    if (hi >= n_file_pages) {
+      fprintf(stderr,
+              "[ERROR] page %u is past the end of the file, %lu pages\n", hi,
+              n_file_pages);
+      return;
+    }
+    for (uint64_t page_no = lo; page_no <= hi; page_no++) {
+      page_nos.push_back(page_no);
+    }
+    pos = comma + 1;
+  }
+
+  RedoLog redo;
+  if (redo.Open(redo_paths) != 0) {
+    return;
+  }
+  int ret = pread(fd, read_buf, kPageSize, 0);
+  if (ret != (int)kPageSize) {
+    fprintf(stderr, "[ERROR] read of page 0 failed\n");
+    return;
+  }
+  const uint32_t space_id =
+      mach_read_from_4(read_buf + FSP_HEADER_OFFSET + FSP_SPACE_ID);
+  std::vector<RedoPageApply> pages;
+  RedoApplyStats stats;
+  ret = redo_apply_pages(fd, space_id, page_nos, redo, target_lsn, dry_run,
+                         &pages, &stats);
+  for (const RedoPageApply &page : pages) {
+    printf("Page %u: %s, LSN %lu -> %lu, records applied: %lu",
+           page.page_no, redo_page_state_name(page.state), page.old_lsn,
+           page.new_lsn, page.n_applied);
+    if (page.state == REDO_PAGE_STOPPED) {
+      printf(", stopped by %s at LSN %lu, records left: %lu",
+             mlog_type_name(page.stop_type), page.stop_lsn, page.n_left);
+    }
+    printf("\n");
+  }
+  if (stats.n_index_load > 0) {
+    printf("[WARN] %lu MLOG_INDEX_LOAD records: an index of the tablespace "
+           "was built without redo logging\n",
+           stats.n_index_load);
+  }
+  printf("Space id: %u, pages: %lu, records kept: %lu (%lu bytes), %s: %lu, "
+         "writes: %lu, log parsed: %lu..%lu\n",
+         space_id, pages.size(), stats.n_records, stats.n_bytes,
+         dry_run ? "can be brought forward" : "brought forward",
+         stats.n_changed, stats.n_writes, stats.scan.start_lsn,
+         stats.scan.end_lsn);
+  if (ret != 0) {
+    fprintf(stderr, "[ERROR] redo apply failed\n");
+  }
+}
+
 void DeletePage(uint32_t page_num) {
   printf("==========================DeletePage==========================\n");
   uint64_t offset = (uint64_t)kPageSize * (uint64_t)page_num;
@@ -966,8 +1201,31 @@ void PrintPageType(page_type_t page_type) {
   
 }
 
+/** Print the runs of page types of a space of several data files, read
+in parallel. */
+static void ShowSysSpacePageType() {
+  SysSpace space;
+  std::vector<PageTypeRun> runs;
+  if (space.Open(path) != 0 ||
+      sys_space_page_types(space, InnoSpace::threads_, &runs) != 0) {
+    return;
+  }
+  printf("File size %lu\n", space.n_pages() * kPageSize);
+  printf("start\t\tend\t\tcount\t\ttype\n");
+  for (const PageTypeRun &run : runs) {
+    printf("%u\t\t%u\t\t%u\t\t", run.first_page,
+           run.first_page + run.n_pages - 1, run.n_pages);
+    PrintPageType(run.type);
+    printf("\n");
+  }
+}
+
 void ShowSpacePageType() {
   printf("==========================space page type==========================\n");
+  if (sys_space_is_multi_file(path)) {
+    ShowSysSpacePageType();
+    return;
+  }
   struct stat stat_buf;
   int ret = fstat(fd, &stat_buf);
   if (ret == -1) {
@@ -1007,6 +1265,61 @@ void ShowSpacePageType() {
   printf("\n");
 }
 
+void ShowSysSpace() {
+  printf("==========================System space==========================\n");
+  SysSpace space;
+  if (space.Open(path) != 0) {
+    return;
+  }
+  printf("%-6s %-40s %12s %12s\n", "file", "path", "first page", "pages");
+  for (size_t i = 0; i < space.files().size(); i++) {
+    const SysDataFile &file = space.files()[i];
+    printf("%-6lu %-40s %12u %12u%s\n", i, file.file_name.c_str(), file.first_page,
+           file.n_pages, file.autoextend ? " autoextend" : "");
+  }
+  printf("Total pages: %lu\n", space.n_pages());
+
+  printf("==========================TRX_SYS==========================\n");
+  TrxSysInfo info;
+  if (space.ReadPages(FSP_TRX_SYS_PAGE_NO, 1, read_buf) != 0) {
+    fprintf(stderr, "[ERROR] read of the TRX_SYS page failed\n");
+    return;
+  }
+  if (trx_sys_decode(read_buf, &info) != 0) {
+    fprintf(stderr, "[ERROR] page %u is not a TRX_SYS page, not the system "
+            "tablespace\n", FSP_TRX_SYS_PAGE_NO);
+    return;
+  }
+  /* Like trx_sys_init_at_db_start(): round the stored id up to the margin,
+  then skip two margins, the ids handed out since the last write */
+  const uint64_t restart_id =
+      (info.max_trx_id + TRX_SYS_TRX_ID_WRITE_MARGIN - 1) /
+          TRX_SYS_TRX_ID_WRITE_MARGIN * TRX_SYS_TRX_ID_WRITE_MARGIN +
+      2 * TRX_SYS_TRX_ID_WRITE_MARGIN;
+  printf("Max trx id stored: %lu (ids restart from %lu)\n", info.max_trx_id,
+         restart_id);
+  if (info.has_binlog) {
+    printf("Binlog position: %s:%lu\n", info.binlog_name.c_str(),
+           info.binlog_offset);
+  } else {
+    printf("Binlog position: none\n");
+  }
+  if (info.has_doublewrite) {
+    printf("Doublewrite buffer: pages %u..%u and %u..%u\n",
+           info.doublewrite_block1,
+           info.doublewrite_block1 + TRX_SYS_DOUBLEWRITE_BLOCK_SIZE - 1,
+           info.doublewrite_block2,
+           info.doublewrite_block2 + TRX_SYS_DOUBLEWRITE_BLOCK_SIZE - 1);
+  } else {
+    printf("Doublewrite buffer: none, in #ib_*.dblwr files since 8.0.20\n");
+  }
+  printf("Rollback segment slots used: %lu\n", info.rsegs.size());
+  for (const TrxSysInfo::Rseg &rseg : info.rsegs) {
+    printf("  slot %3u: space %u page %u\n", rseg.slot, rseg.space_id,
+           rseg.page_no);
+  }
+}
+
 void ShowSpaceHeader() {
   printf("==========================Space Header==========================\n");
   uint64_t offset = (uint64_t)kPageSize * (uint64_t)0;
@@ -1043,67 +1356,6 @@ static bool btr_root_fseg_validate(
 }
 
 
-/** Calculates reserved fragment page slots.
- @return number of fragment pages */
-static ulint fseg_get_n_frag_pages(
-    fseg_inode_t *inode) /*!< in: segment inode */
-{
-  ulint i;
-  ulint count = 0;
-
-
-  for (i = 0; i < FSEG_FRAG_ARR_N_SLOTS; i++) {
-    if (FIL_NULL != mach_read_from_4(inode + FSEG_FRAG_ARR + i * FSEG_FRAG_SLOT_SIZE)) {
-      count++;
-    }
-  }
-
-  return (count);
-}
-
-/** Calculates the number of pages reserved by a segment, and how many
-pages are currently used.
-@param[in]      space_id    Unique tablespace identifier
-@param[in]      inode       File segment inode pointer
-@param[out]     used        Number of pages used (not more than reserved)
-@return number of reserved pages */
-static ulint fseg_n_reserved_pages_low(space_id_t space_id,
-                                       fseg_inode_t *inode, ulint *used) {
-  ulint ret;
-
-  File_segment_inode fseg_inode(space_id, inode);
-
-  /* number of used segment pages in the FSEG_NOT_FULL list */
-  uint32_t n_used_not_full = fseg_inode.read_not_full_n_used();
-
-  /* total number of segment pages in the FSEG_NOT_FULL list */
-  ulint n_total_not_full =
-      FSP_EXTENT_SIZE * mach_read_from_4(inode + FSEG_NOT_FULL);
-
-  /* n_used can be zero only if n_total is zero. */
-  ut_ad(n_used_not_full > 0 || n_total_not_full == 0);
-  ut_ad((n_used_not_full < n_total_not_full) ||
-        ((n_used_not_full == 0) && (n_total_not_full == 0)));
-
-  /* total number of pages in FSEG_FULL list. */
-  ulint n_total_full = FSP_EXTENT_SIZE * mach_read_from_4(inode + FSEG_FULL + FLST_LEN);
-
-  /* total number of pages in FSEG_FREE list. */
-  ulint n_total_free = FSP_EXTENT_SIZE * flst_get_len(inode + FSEG_FREE);
-
-  /* Number of fragment pages in the segment. */
-  ulint n_frags = fseg_get_n_frag_pages(inode);
-
-  *used = n_frags + n_total_full + n_used_not_full;
-  ret = n_frags + n_total_full + n_total_free + n_total_not_full;
-
-  ut_ad(*used <= ret);
-  ut_ad((*used < ret) || ((n_used_not_full == 0) && (n_total_not_full == 0) &&
-                          (n_total_free == 0)));
-
-  return (ret);
-}
-
 /** Writes info of a segment. */
 static void fseg_print_low(space_id_t space_id,
                            fseg_inode_t *inode, uint32_t &free_page) /*!< in: segment inode */
@@ -1228,126 +1480,390 @@ void ShowIndexSummary() {
   return;
 }
 
-void DumpAllRecords() {
-    printf("=== [Debug] Entering DumpAllRecords() ===\n");
-
-    // 1) We'll assume the primary index root is always page 4
-    uint32_t root_page_id = 4;
-    printf("[Debug] root_page_id = %u\n", root_page_id);
+/** Append a value to a tab separated output line, escaping like
+mysql --batch so that every row stays on one line. */
+static void append_escaped(const std::string &v, std::string *line) {
+  for (size_t i = 0; i < v.size(); i++) {
+    switch (v[i]) {
+      case '\t':
+        line->append("\\t");
+        break;
+      case '\n':
+        line->append("\\n");
+        break;
+      case '\\':
+        line->append("\\\\");
+        break;
+      case '\0':
+        line->append("\\0");
+        break;
+      default:
+        line->push_back(v[i]);
+    }
+  }
+}
 
-    // 2) Calculate file offset of page 4
-    uint64_t offset = (uint64_t)kPageSize * (uint64_t)root_page_id;
-    printf("[Debug] reading from offset: %lu (page 4)\n", offset);
+/** Print the column names of a scan as a tab separated line. */
+static void print_scan_header(const TableScan &scan) {
+  std::string line;
+  for (size_t i = 0; i < scan.out_fields.size(); i++) {
+    const RecFieldPlan &plan = scan.leaf_layout.fields[scan.out_fields[i]];
+    line.append(i ? "\t" : "");
+    line.append(scan.table.columns[plan.col_no].name);
+  }
+  printf("%s\n", line.c_str());
+}
 
-    // 3) Read the page into read_buf
-    int ret = pread(fd, read_buf, kPageSize, offset);
-    if (ret == -1) {
-        printf("[ERROR] DumpAllRecords: pread() for root page failed\n");
-        return;
+/** Append a field value to an output line. An externally stored value
+is written out with the line so far a LOB part at a time. */
+static void append_scan_field(const ColumnDef &col, LobReader &lob,
+                              const byte *data, ulint len, bool is_extern,
+                              std::string *line) {
+  std::string value;
+  if (is_extern) {
+    fwrite(line->data(), 1, line->size(), stdout);
+    line->clear();
+    RecFieldStream stream(col);
+    int64_t ret = lob.ReadField(data, len, [&](const byte *part, ulint n) {
+      value.clear();
+      stream.Append(part, n, &value);
+      append_escaped(value, line);
+      fwrite(line->data(), 1, line->size(), stdout);
+      line->clear();
+      return true;
+    });
+    if (ret < 0) {
+      line->append("<extern>");
     }
-    printf("[Debug] pread() returned %d bytes\n", ret);
+    return;
+  }
+  rec_field_to_string(col, data, len, &value);
+  append_escaped(value, line);
+}
 
-    // 4) Check the page type
-    uint16_t page_type = mach_read_from_2(read_buf + FIL_PAGE_TYPE);
-    printf("[Debug] page_type = %u\n", page_type);
+/** Print the output columns of a record as a tab separated line. */
+static void print_scan_row(const TableScan &scan, LobReader &lob,
+                           const rec_t *rec, const ulint *offs) {
+  std::string line;
+  for (size_t i = 0; i < scan.out_fields.size(); i++) {
+    size_t f = scan.out_fields[i];
+    line.append(i ? "\t" : "");
+    if (rec_offs_field_is_null(offs, f)) {
+      line.append("NULL");
+      continue;
+    }
+    ulint len;
+    const byte *data = rec_field_get(rec, scan.leaf_layout, offs, f, &len);
+    append_scan_field(scan.table.columns[scan.leaf_layout.fields[f].col_no],
+                      lob, data, len, rec_offs_field_is_extern(offs, f),
+                      &line);
+  }
+  printf("%s\n", line.c_str());
+}
 
-    // If it's not an index page, do not parse as if it's a B-tree
-    if (page_type != FIL_PAGE_INDEX) {
-        printf("[Warn] This is not an INDEX PAGE. Aborting record parse.\n");
-        return;
+void DumpAllRecords() {
+  printf("==========================Records==========================\n");
+  TableScan scan;
+  if (table_scan_open_index(sdi_path, InnoSpace::index_.c_str(),
+                            InnoSpace::where_.c_str(),
+                            InnoSpace::columns_.c_str(), &scan) != 0) {
+    return;
+  }
+  table_scan_read_format(fd, &scan);
+  if (!scan.leaf_layout.is_clustered) {
+    printf("Index: %s\n", scan.index->name.c_str());
+  }
+  print_scan_header(scan);
+
+  uint64_t n_rows = 0;
+  uint64_t n_examined = 0;
+  LobReader lob(fd);
+  const table_page_cb print_batch = [&](const PageBatch &batch) {
+    for (size_t i = 0; i < batch.size(); i++) {
+      print_scan_row(scan, lob, batch.recs[i], batch.rec_offs(i));
+    }
+    n_rows += batch.size();
+    return true;
+  };
+
+  if (InnoSpace::salvage_) {
+    SalvageStats stats;
+    if (salvage_scan(fd, scan, InnoSpace::threads_, InnoSpace::undelete_,
+                     print_batch, &stats) < 0) {
+      fprintf(stderr, "[ERROR] salvage scan of index %s failed\n",
+              scan.index->name.c_str());
+      return;
     }
+    salvage_print_stats(stats);
+    n_examined = stats.n_examined;
+  } else {
+    int64_t n_pages = table_scan_pages(fd, scan, print_batch, &n_examined);
+    if (n_pages < 0) {
+      fprintf(stderr, "[ERROR] scan of index %s failed\n",
+              scan.index->name.c_str());
+      return;
+    }
+    printf("Leaf pages: %ld\n", n_pages);
+  }
+  if (!scan.filter.empty()) {
+    printf("Rows examined: %lu\n", n_examined);
+  }
+  printf("Rows: %lu\n", n_rows);
+}
 
-    // 5) Read the page level
-    uint16_t page_level = mach_read_from_2(read_buf + PAGE_HEADER + PAGE_LEVEL);
-    printf("[Debug] page_level = %hu\n", page_level);
+void LookupRecords(const char *lo, const char *hi) {
+  printf("==========================Lookup==========================\n");
+  TableScan scan;
+  if (table_scan_open_index(sdi_path, InnoSpace::index_.c_str(),
+                            InnoSpace::where_.c_str(),
+                            InnoSpace::columns_.c_str(), &scan) != 0) {
+    return;
+  }
+  table_scan_read_format(fd, &scan);
+  SearchTuple lo_tuple;
+  SearchTuple hi_tuple;
+  const bool has_lo = lo != nullptr && *lo != '\0';
+  const bool has_hi = hi != nullptr && *hi != '\0';
+  if ((has_lo && search_tuple_build(scan.leaf_layout, lo, &lo_tuple) != 0) ||
+      (has_hi && search_tuple_build(scan.leaf_layout, hi, &hi_tuple) != 0)) {
+    return;
+  }
+  if (!scan.leaf_layout.is_clustered) {
+    printf("Index: %s\n", scan.index->name.c_str());
+  }
+  print_scan_header(scan);
+
+  uint64_t n_rows = 0;
+  uint64_t n_examined = 0;
+  LobReader lob(fd);
+  int64_t n_reads = table_scan_range(
+      fd, scan, has_lo ? &lo_tuple : nullptr, has_hi ? &hi_tuple : nullptr,
+      [&](const rec_t *rec, const ulint *offs) {
+        print_scan_row(scan, lob, rec, offs);
+        n_rows++;
+        return true;
+      },
+      &n_examined);
+
+  if (n_reads < 0) {
+    fprintf(stderr, "[ERROR] lookup in index %s failed\n",
+            scan.index->name.c_str());
+    return;
+  }
+  printf("Pages read: %ld\n", n_reads);
+  if (!scan.filter.empty()) {
+    printf("Rows examined: %lu\n", n_examined);
+  }
+  printf("Rows: %lu\n", n_rows);
+}
 
-    // Let's say we are doing a loop from the root down to leaf
-    // In your code, you might do something like a BFS or DFS to reach leaf pages.
-    // For demonstration, we do a single pass:
-    uint32_t curr_page = root_page_id;
+void ShowColumnUsage() {
+  printf("==========================Column usage==========================\n");
+  TableScan scan;
+  if (table_scan_open(sdi_path, nullptr, nullptr, &scan) != 0) {
+    return;
+  }
+  table_scan_read_format(fd, &scan);
+  SpaceUsage usage;
+  if (space_usage_scan(fd, scan, InnoSpace::threads_, &usage) != 0) {
+    fprintf(stderr, "[ERROR] column usage scan failed\n");
+    return;
+  }
+  space_usage_print(scan, usage);
+}
 
-    // 6) For debugging, just one iteration, or a while loop if needed
-    //    We'll show pointer math checks inside the loop
-    while (true) {
-        printf("[Debug] curr_page = %u, page_level = %hu\n", curr_page, page_level);
+/** Append the fields of an undo record to an output line, formatted by
+the columns of the table when the record is of the table of the plan, in
+hex otherwise. */
+static void append_undo_fields(const std::vector<UndoField> &fields,
+                               const TableScan *scan, std::string *line) {
+  std::string value;
+  for (size_t i = 0; i < fields.size(); i++) {
+    const UndoField &f = fields[i];
+    line->append(i ? " " : "");
+    const bool named = scan != nullptr &&
+                       f.field_no < scan->leaf_layout.fields.size();
+    const ColumnDef *col =
+        named ? &scan->table.columns[scan->leaf_layout.fields[f.field_no].col_no]
+              : nullptr;
+    if (col != nullptr) {
+      line->append(col->name);
+    } else {
+      line->append(std::to_string(f.field_no));
+    }
+    line->push_back('=');
+    if (f.is_null) {
+      line->append("NULL");
+      continue;
+    }
+    if (f.is_extern) {
+      line->append("<extern>");
+      continue;
+    }
+    value.clear();
+    if (col != nullptr) {
+      rec_field_to_string(*col, f.data, f.len, &value);
+    } else {
+      char hex[3];
+      for (uint32_t b = 0; b < f.len; b++) {
+        snprintf(hex, sizeof(hex), "%02x", f.data[b]);
+        value.append(hex);
+      }
+    }
+    append_escaped(value, line);
+  }
+}
 
-        // The "infimum" record offset is PAGE_NEW_INFIMUM (commonly 99 in 16KB pages)
-        byte* rec_ptr = read_buf + PAGE_NEW_INFIMUM;
-        printf("[Debug] rec_ptr = %p (PAGE_NEW_INFIMUM=%d)\n",
-               (void*)rec_ptr, PAGE_NEW_INFIMUM);
+void ShowUndoRecords() {
+  printf("==========================Undo records==========================\n");
+  /* The records of the table of -s are decoded in full, the SDI of an
+  undo tablespace is not a table */
+  TableScan scan;
+  UndoPlan plan;
+  if (strcmp(sdi_path, path) != 0) {
+    if (table_scan_open(sdi_path, nullptr, nullptr, &scan) != 0) {
+      return;
+    }
+    plan.table_id = scan.table.id;
+    plan.layout = &scan.leaf_layout;
+  }
 
-        // Safety check: ensure rec_ptr is still inside read_buf
-        if (rec_ptr < read_buf || rec_ptr >= read_buf + kPageSize) {
-            printf("[Error] rec_ptr is out of range! Aborting.\n");
-            break;
+  std::string line;
+  UndoScanStats stats;
+  int ret = undo_scan_file(
+      fd, plan,
+      [&](uint32_t page_no, const UndoLogHeader *log, const UndoRecord &rec) {
+        char buf[160];
+        snprintf(buf, sizeof(buf), "page %u offset %u", page_no,
+                 (uint32_t)rec.offset);
+        line.assign(buf);
+        if (log != nullptr) {
+          snprintf(buf, sizeof(buf), " log_trx_id %lu", log->trx_id);
+          line.append(buf);
         }
-
-        // We read REC_NEXT from the 2 bytes before rec_ptr
-        // i.e. rec_ptr - REC_NEXT. This is how InnoDB internally stores "next record" offset
-        // But let's do a boundary check first
-        if (rec_ptr < read_buf + REC_NEXT) {
-            printf("[Error] rec_ptr - REC_NEXT is out of bounds.\n");
-            break;
+        snprintf(buf, sizeof(buf), " %s undo_no %lu table_id %lu",
+                 undo_rec_type_name(rec.type), rec.undo_no, rec.table_id);
+        line.append(buf);
+        if (rec.type != TRX_UNDO_INSERT_REC &&
+            rec.type != TRX_UNDO_RENAME_TABLE) {
+          snprintf(buf, sizeof(buf),
+                   " info_bits 0x%x trx_id %lu roll_ptr 0x%014lx",
+                   (uint32_t)rec.info_bits, rec.trx_id, rec.roll_ptr);
+          line.append(buf);
         }
-
-        ulint off = mach_read_from_2(rec_ptr - REC_NEXT);
-        printf("[Debug] offset from previous record = %u\n", off);
-
-        // If offset is beyond page boundary, it is invalid.
-        if (off >= kPageSize) {
-            printf("[Error] offset %u >= kPageSize. Aborting.\n", off);
-            break;
+        const TableScan *named =
+            plan.layout != nullptr && rec.table_id == plan.table_id ? &scan
+                                                                    : nullptr;
+        if (!rec.pk.empty()) {
+          line.append(" pk (");
+          append_undo_fields(rec.pk, named, &line);
+          line.append(")");
         }
-
-        // Calculate the "next record" pointer
-        byte* next_rec_ptr = rec_ptr + off;
-        printf("[Debug] next_rec_ptr = %p\n", (void*)next_rec_ptr);
-
-        // Check that next_rec_ptr is still inside [read_buf .. read_buf + kPageSize)
-        if (next_rec_ptr < read_buf || next_rec_ptr + 4 > read_buf + kPageSize) {
-            printf("[Error] next_rec_ptr out of range! Aborting.\n");
-            break;
+        if (!rec.update.empty()) {
+          line.append(" update (");
+          append_undo_fields(rec.update, named, &line);
+          line.append(rec.update_truncated ? " ...)" : ")");
         }
+        printf("%s\n", line.c_str());
+        return true;
+      },
+      &stats);
+  if (ret != 0) {
+    fprintf(stderr, "[ERROR] undo records scan failed\n");
+  }
+  printf("Pages: %lu, undo pages: %lu, records: %lu, corrupt records: %lu\n",
+         stats.n_pages, stats.n_undo_pages, stats.n_records,
+         stats.n_bad_records);
+}
 
-        // Suppose we interpret next_rec_ptr+4 as a child_page_num
-        uint32_t child_page_num = mach_read_from_4(next_rec_ptr + 4);
-        printf("[Debug] child_page_num=%u\n", child_page_num);
-
-        // If your code needs to read records (like ShowRecord(next_rec_ptr)), you can do it here:
-        // ShowRecord(next_rec_ptr);
-
-        // If page_level > 0, we might follow child_page_num as the next page to read
-        if (page_level > 0) {
-            printf("[Debug] Going down one level in the B-tree to page %u.\n", child_page_num);
+void Flashback(uint64_t as_of, const char *undo_paths) {
+  printf("==========================Flashback==========================\n");
+  if (!InnoSpace::where_.empty() || !InnoSpace::index_.empty() ||
+      InnoSpace::salvage_) {
+    fprintf(stderr, "[ERROR] flashback supports neither --where, --index "
+            "nor --salvage\n");
+    return;
+  }
+  TableScan scan;
+  if (table_scan_open(sdi_path, nullptr, InnoSpace::columns_.c_str(),
+                      &scan) != 0) {
+    return;
+  }
+  table_scan_read_format(fd, &scan);
+
+  UndoPageCache cache(FLASHBACK_CACHE_PAGES);
+  std::vector<int> undo_fds;
+  const char *p = undo_paths;
+  bool failed = false;
+  while (*p != '\0' && !failed) {
+    const char *comma = strchr(p, ',');
+    std::string undo_path =
+        comma == nullptr ? std::string(p) : std::string(p, comma - p);
+    p = comma == nullptr ? p + strlen(p) : comma + 1;
+    int undo_fd = open(undo_path.c_str(), O_RDONLY);
+    if (undo_fd == -1) {
+      fprintf(stderr, "[ERROR] Open %s failed: %s\n", undo_path.c_str(),
+              strerror(errno));
+      failed = true;
+      break;
+    }
+    undo_fds.push_back(undo_fd);
+    int space_num = cache.AddFile(undo_fd);
+    if (space_num < 0) {
+      failed = true;
+      break;
+    }
+    printf("Undo space %d: %s\n", space_num, undo_path.c_str());
+  }
 
-            // read the child page
-            uint64_t child_offset = (uint64_t)kPageSize * (uint64_t)child_page_num;
-            int ret2 = pread(fd, read_buf, kPageSize, child_offset);
-            if (ret2 == -1) {
-                printf("[ERROR] pread() for child page %u failed.\n", child_page_num);
-                break;
+  if (!failed) {
+    printf("As of trx_id: %lu\n", as_of);
+    print_scan_header(scan);
+    LobReader lob(fd);
+    FlashbackStats stats;
+    std::string line;
+    int64_t n_pages = flashback_scan(
+        fd, scan, &cache, as_of,
+        [&](const FlashbackField *fields) {
+          line.clear();
+          for (size_t i = 0; i < scan.out_fields.size(); i++) {
+            const size_t f = scan.out_fields[i];
+            line.append(i ? "\t" : "");
+            if (fields[f].is_null) {
+              line.append("NULL");
+              continue;
             }
-            printf("[Debug] read child page %u successfully.\n", child_page_num);
-
-            // re-check the page type/level
-            page_type = mach_read_from_2(read_buf + FIL_PAGE_TYPE);
-            page_level = mach_read_from_2(read_buf + PAGE_HEADER + PAGE_LEVEL);
-            curr_page = child_page_num;
-
-            // Possibly continue the while loop to step further down
-            continue;
-        }
-
-        // If page_level == 0, we are at a leaf page
-        // Then you'd parse all the records in the leaf, maybe with ShowIndexHeader() or something
-        printf("[Debug] We are at a leaf page, parse all records here...\n");
-        // ShowIndexHeader(...) or your own leaf parse code
-
-        // For demonstration, let's just break
-        break;
+            append_scan_field(
+                scan.table.columns[scan.leaf_layout.fields[f].col_no], lob,
+                fields[f].data, fields[f].len, fields[f].is_extern, &line);
+          }
+          printf("%s\n", line.c_str());
+          return true;
+        },
+        &stats);
+    if (n_pages < 0) {
+      fprintf(stderr, "[ERROR] flashback of table %s failed\n",
+              scan.table.name.c_str());
+    } else {
+      printf("Leaf pages: %ld, records: %lu\n", n_pages, stats.n_records);
+      printf("Rows: %lu, rebuilt from undo: %lu, undo records applied: %lu\n",
+             stats.n_rows, stats.n_rebuilt, stats.n_versions);
+      printf("Inserted since: %lu, deleted at the time: %lu\n",
+             stats.n_inserted_after, stats.n_deleted);
+      printf("Undo rounds: %lu, undo pages read: %lu in %lu reads, "
+             "cache hits: %lu\n",
+             stats.n_rounds, cache.n_pages_read(), cache.n_reads(),
+             cache.n_hits());
+      if (stats.n_history_missing > 0) {
+        fprintf(stderr, "[WARN] %lu rows left out, their history is purged "
+                "or in an undo tablespace not given\n",
+                stats.n_history_missing);
+      }
     }
-
-    printf("=== [Debug] Exiting DumpAllRecords() ===\n");
+  }
+  for (size_t i = 0; i < undo_fds.size(); i++) {
+    close(undo_fds[i]);
+  }
 }
 
 void ShowSpaceIndexs() {
@@ -1,5 +1,8 @@
 #include "inno_space.h"
+#include "table_def.h"
+#include "sys_space.h"
 #include <unistd.h>
+#include <getopt.h>
 #include <fcntl.h>
 #include <cstring>
 #include <cstdlib>
@@ -9,9 +12,19 @@
 // Forward declarations of functions implemented in inno_impl.cc
 void ShowSpaceHeader();
 void ShowSpacePageType();
+void ShowSysSpace();
 void ShowIndexSummary();
 void ShowUndoFile();
+void ShowUndoRecords();
+void ShowUndoHistory();
+void ShowUndoUsage();
+void ShowTrxTimeline(const char*, const char*, bool, uint64_t);
+void ShowRedoLog(const char*, uint64_t, uint32_t, bool);
+void Flashback(uint64_t, const char*);
 void DumpAllRecords();
+void LookupRecords(const char*, const char*);
+void ShowColumnUsage();
+void ExportArrow(const char*, uint32_t);
 void ShowFILHeader(uint32_t, uint16_t*);
 void ShowIndexHeader(uint32_t, bool);
 void ShowBlobHeader(uint32_t);
@@ -21,26 +34,43 @@ void ShowBlobDataPage(uint32_t);
 void ShowUndoPageHeader(uint32_t);
 void ShowRsegArray(uint32_t, uint32_t*);
 void DeletePage(uint32_t);
+void RestoreFromDoublewrite(const char*, bool);
+void RedoApply(const char*, const char*, uint64_t, bool);
 void UpdateCheckSum(uint32_t);
 
 // Static member definitions
 char InnoSpace::path_[1024] = {0};
 char InnoSpace::sdi_path_[1024] = {0};
+std::string InnoSpace::where_;
+std::string InnoSpace::columns_;
+std::string InnoSpace::index_;
+bool InnoSpace::salvage_ = false;
+bool InnoSpace::undelete_ = false;
+uint32_t InnoSpace::threads_ = 0;
 int InnoSpace::fd_ = -1;
 byte* InnoSpace::read_buf_ = nullptr;
 byte* InnoSpace::inode_page_buf_ = nullptr;
-ulint InnoSpace::offsets_[REC_OFFS_NORMAL_SIZE];
-std::vector<InnoSpace::dict_col> InnoSpace::dict_cols_;
 
 InnoSpace::InnoSpace(const char* path) {
     std::snprintf(path_, sizeof(path_), "%s", path);
-    fd_ = open(path, O_RDWR, 0644);
+    /* The page commands of a space of several data files read its first
+    file, which holds the space header and TRX_SYS */
+    std::string first_file = path;
+    std::vector<SysDataFile> files;
+    if (sys_space_is_multi_file(path)) {
+        if (sys_space_parse(path, &files) != 0) {
+            std::exit(1);
+        }
+        first_file = files[0].file_name;
+    }
+    fd_ = open(first_file.c_str(), O_RDWR, 0644);
     if (fd_ == -1) {
-        fprintf(stderr, "[ERROR] Open %s failed: %s\n", path, strerror(errno));
+        fprintf(stderr, "[ERROR] Open %s failed: %s\n", first_file.c_str(), strerror(errno));
         std::exit(1);
     }
     posix_memalign((void**)&read_buf_, kPageSize, kPageSize);
     ut_crc32_init();
+    page_decoder_init();
 }
 
 InnoSpace::~InnoSpace() {
@@ -54,12 +84,47 @@ void InnoSpace::SetSdiPath(const char* sdi) {
     std::snprintf(sdi_path_, sizeof(sdi_path_), "%s", sdi);
 }
 
+void InnoSpace::SetWhere(const char* where) {
+    where_ = where;
+}
+
+void InnoSpace::SetColumns(const char* columns) {
+    columns_ = columns;
+}
+
+void InnoSpace::SetIndex(const char* index) {
+    index_ = index;
+}
+
+void InnoSpace::SetSalvage(bool undelete) {
+    salvage_ = true;
+    undelete_ = undelete;
+}
+
+void InnoSpace::SetThreads(uint32_t n_threads) {
+    threads_ = n_threads;
+}
+
+void InnoSpace::SetSchemaCache() {
+    table_def_set_schema_cache(true);
+}
+
 // Wrapper methods
 void InnoSpace::ShowSpaceHeader() { ::ShowSpaceHeader(); }
 void InnoSpace::ShowSpacePageType() { ::ShowSpacePageType(); }
+void InnoSpace::ShowSysSpace() { ::ShowSysSpace(); }
 void InnoSpace::ShowIndexSummary() { ::ShowIndexSummary(); }
 void InnoSpace::ShowUndoFile() { ::ShowUndoFile(); }
+void InnoSpace::ShowUndoRecords() { ::ShowUndoRecords(); }
+void InnoSpace::ShowUndoHistory() { ::ShowUndoHistory(); }
+void InnoSpace::ShowUndoUsage() { ::ShowUndoUsage(); }
+void InnoSpace::ShowTrxTimeline(const char* l, const char* h, bool n, uint64_t t) { ::ShowTrxTimeline(l, h, n, t); }
+void InnoSpace::ShowRedoLog(const char* r, uint64_t s, uint32_t t, bool p) { ::ShowRedoLog(r, s, t, p); }
+void InnoSpace::Flashback(uint64_t as_of, const char* undo_paths) { ::Flashback(as_of, undo_paths); }
 void InnoSpace::DumpAllRecords() { ::DumpAllRecords(); }
+void InnoSpace::LookupRecords(const char* l, const char* h) { ::LookupRecords(l, h); }
+void InnoSpace::ShowColumnUsage() { ::ShowColumnUsage(); }
+void InnoSpace::ExportArrow(const char* o, uint32_t n) { ::ExportArrow(o, n); }
 void InnoSpace::ShowFILHeader(uint32_t p, uint16_t* t) { ::ShowFILHeader(p,t); }
 void InnoSpace::ShowIndexHeader(uint32_t p, bool s) { ::ShowIndexHeader(p,s); }
 void InnoSpace::ShowBlobHeader(uint32_t p){ ::ShowBlobHeader(p); }
@@ -69,6 +134,8 @@ void InnoSpace::ShowBlobDataPage(uint32_t p){ ::ShowBlobDataPage(p); }
 void InnoSpace::ShowUndoPageHeader(uint32_t p){ ::ShowUndoPageHeader(p); }
 void InnoSpace::ShowRsegArray(uint32_t p, uint32_t* a){ ::ShowRsegArray(p,a); }
 void InnoSpace::DeletePage(uint32_t p){ ::DeletePage(p); }
+void InnoSpace::RestoreFromDoublewrite(const char* d, bool n){ ::RestoreFromDoublewrite(d, n); }
+void InnoSpace::RedoApply(const char* r, const char* p, uint64_t t, bool d){ ::RedoApply(r, p, t, d); }
 void InnoSpace::UpdateCheckSum(uint32_t p){ ::UpdateCheckSum(p); }
 
 static void usage() {
@@ -76,11 +143,79 @@ static void usage() {
         "Inno space\n"
         "usage: inno [-h] [-f test/t.ibd] [-p page_num]\n"
         "\t-h                -- show this help\n"
-        "\t-f test/t.ibd     -- ibd file \n"
+        "\t-f test/t.ibd     -- ibd file, or the data files of the system tablespace:\n"
+        "\t                     ibdata1,ibdata2 or ibdata1:12M;ibdata2:1G:autoextend\n"
         "\t\t-c list-page-type      -- show all page type\n"
+        "\t\t-c sys-space           -- data files of the system tablespace and its\n"
+        "\t\t                          TRX_SYS page: max trx id, binlog position, rsegs\n"
         "\t\t-c index-summary       -- show indexes information\n"
         "\t\t-c show-undo-file      -- show undo log file detail\n"
-        "\t\t-c dump-all-records    -- parse all records from a known root\n"
+        "\t\t-c show-undo-records   -- decode every undo record of an undo tablespace,\n"
+        "\t\t                          the fields of the table of -s by column\n"
+        "\t\t-c undo-history        -- walk the history list of every rollback segment:\n"
+        "\t\t                          length, oldest trx_no and pages held\n"
+        "\t\t-c undo-usage          -- pages of an undo tablespace by rollback segment and\n"
+        "\t\t                          state of their undo log segment, free pages\n"
+        "\t\t-c trx-timeline [--range L..H] [--by-commit] [--table-id N]\n"
+        "\t\t                       -- undo logs of an undo tablespace by trx_id (or\n"
+        "\t\t                          trx_no): pages, records and tables changed,\n"
+        "\t\t                          indexed in <file>.trxidx for the next runs\n"
+        "\t\t-c redo-stats --redo r [--since-lsn L] [--top N]\n"
+        "\t\t                       -- check and parse the redo log, without -f: records\n"
+        "\t\t                          by type, redo volume by tablespace, hottest pages\n"
+        "\t\t-c redo-pages --redo r [--since-lsn L]\n"
+        "\t\t                       -- every page changed by the redo log since LSN L\n"
+        "\t\t-c dump-all-records    -- dump all rows of the clustered index\n"
+        "\t\t-c flashback --as-of T --undo u1,u2\n"
+        "\t\t                       -- dump the rows as transaction T saw them, the\n"
+        "\t\t                          changes since rolled back from the undo tablespaces\n"
+        "\t\t-c dblwr-check --dblwr d1,d2\n"
+        "\t\t                       -- list the corrupt pages and whether the doublewrite\n"
+        "\t\t                          buffer has a good copy of them\n"
+        "\t\t-c dblwr-restore --dblwr d1,d2\n"
+        "\t\t                       -- write the doublewrite copies over the corrupt pages\n"
+        "\t\t-c redo-apply --redo r --pages 3,8..12 [--target-lsn L]\n"
+        "\t\t                       -- bring pages restored from a backup or the\n"
+        "\t\t                          doublewrite buffer forward to LSN L (default the\n"
+        "\t\t                          end of the log)\n"
+        "\t\t-c redo-apply-check --redo r --pages 3,8..12 [--target-lsn L]\n"
+        "\t\t                       -- the same without writing the pages\n"
+        "\t\t-c export-arrow        -- export the clustered index to an Arrow IPC file\n"
+        "\t\t-c lookup --key K      -- find the row with primary key K\n"
+        "\t\t-c lookup --range L..H -- rows with L <= primary key <= H, L or H may be empty\n"
+        "\t\t-c column-usage        -- in-row and off-page (LOB) storage of every column,\n"
+        "\t\t                          pages of every index\n"
+        "\t-s table.json      -- ibd2sdi output of the table, the SDI of the ibd\n"
+        "\t                      file is read by default\n"
+        "\t-o out.arrow       -- output file of export commands\n"
+        "\t--batch-rows N     -- rows per Arrow record batch (default 65536)\n"
+        "\t--where \"k = 42\"   -- only dump/export rows matching the conditions, strings\n"
+        "\t                      compare byte by byte whatever the collation\n"
+        "\t--columns a,b,c    -- only dump/export these columns\n"
+        "\t--index name       -- dump/export/lookup a secondary index instead of the\n"
+        "\t                      clustered index\n"
+        "\t--salvage          -- dump/export by reading every leaf page of the clustered\n"
+        "\t                      index instead of walking the B-tree, newest copy of each row\n"
+        "\t--undelete         -- like --salvage, but dump/export the deleted rows, also\n"
+        "\t                      the purged ones left in the free space of the pages\n"
+        "\t--threads N        -- reader threads of --salvage, column-usage, undo-history and\n"
+        "\t                      undo-usage (default one per CPU)\n"
+        "\t--as-of TRX_ID     -- transaction id of flashback, changes of transactions\n"
+        "\t                      with this id or a higher one are rolled back\n"
+        "\t--undo u1,u2       -- undo tablespaces of flashback (undo_001, ..., or\n"
+        "\t                      ibdata1 for undo logs in the system tablespace)\n"
+        "\t--by-commit        -- trx-timeline ranges are commit numbers (trx_no)\n"
+        "\t--table-id N       -- trx-timeline only lists transactions that changed table N\n"
+        "\t--dblwr d1,d2      -- doublewrite files (#ib_16384_0.dblwr, ..., or ibdata1 for\n"
+        "\t                      the doublewrite buffer of MySQL before 8.0.20)\n"
+        "\t--redo r           -- redo log files (#ib_redo10,#ib_redo11 or ib_logfile0,\n"
+        "\t                      ib_logfile1), or the directory of the files (#innodb_redo)\n"
+        "\t--since-lsn L      -- redo commands only count the mini-transactions from LSN L\n"
+        "\t--top N            -- hottest pages listed by redo-stats (default 10)\n"
+        "\t--pages 3,8..12    -- pages of redo-apply\n"
+        "\t--target-lsn L     -- LSN redo-apply brings the pages to\n"
+        "\t--schema-cache     -- keep the parsed table definition in <sdi file>.schema\n"
+        "\t                      and reuse it while the SDI is unchanged\n"
         "\t-p page_num       -- show page information\n"
         "\t\t-c show-records        -- show all records from that page\n"
         "\t-u page_num       -- update page checksum\n"
@@ -103,7 +238,53 @@ int main(int argc, char *argv[]) {
     char command[128] = {0};
     char filepath[1024] = {0};
     char sdi_path[1024] = {0};
-    while (-1 != (c = getopt(argc, argv, "hf:s:p:d:u:c:"))) {
+    char out_path[1024] = {0};
+    uint32_t batch_rows = 65536;
+    const char* where = nullptr;
+    const char* columns = nullptr;
+    const char* index = nullptr;
+    std::string key_lo;
+    std::string key_hi;
+    bool key_opt = false;
+    bool salvage = false;
+    bool undelete = false;
+    uint32_t n_threads = 0;
+    bool schema_cache = false;
+    uint64_t as_of = 0;
+    bool as_of_opt = false;
+    const char* undo_paths = "";
+    bool by_commit = false;
+    uint64_t table_id = 0;
+    const char* dblwr_paths = "";
+    const char* redo_paths = "";
+    uint64_t since_lsn = 0;
+    uint32_t top = 10;
+    const char* page_list = "";
+    uint64_t target_lsn = UINT64_MAX;
+    static const struct option long_options[] = {
+        {"output", required_argument, nullptr, 'o'},
+        {"batch-rows", required_argument, nullptr, 'B'},
+        {"where", required_argument, nullptr, 'W'},
+        {"columns", required_argument, nullptr, 'C'},
+        {"index", required_argument, nullptr, 'I'},
+        {"key", required_argument, nullptr, 'K'},
+        {"range", required_argument, nullptr, 'R'},
+        {"salvage", no_argument, nullptr, 'S'},
+        {"undelete", no_argument, nullptr, 'U'},
+        {"threads", required_argument, nullptr, 'T'},
+        {"schema-cache", no_argument, nullptr, 'H'},
+        {"as-of", required_argument, nullptr, 'A'},
+        {"undo", required_argument, nullptr, 'N'},
+        {"by-commit", no_argument, nullptr, 'Y'},
+        {"table-id", required_argument, nullptr, 'J'},
+        {"dblwr", required_argument, nullptr, 'D'},
+        {"redo", required_argument, nullptr, 'E'},
+        {"since-lsn", required_argument, nullptr, 'L'},
+        {"top", required_argument, nullptr, 'P'},
+        {"pages", required_argument, nullptr, 'G'},
+        {"target-lsn", required_argument, nullptr, 'X'},
+        {nullptr, 0, nullptr, 0}};
+    while (-1 != (c = getopt_long(argc, argv, "hf:s:p:d:u:c:o:", long_options, nullptr))) {
         switch (c) {
             case 'f':
                 snprintf(filepath, sizeof(filepath), "%s", optarg);
@@ -130,6 +311,84 @@ int main(int argc, char *argv[]) {
             case 'c':
                 snprintf(command, sizeof(command), "%s", optarg);
                 break;
+            case 'o':
+                snprintf(out_path, sizeof(out_path), "%s", optarg);
+                break;
+            case 'B':
+                batch_rows = std::atol(optarg);
+                if (batch_rows == 0) {
+                    fprintf(stderr, "Invalid --batch-rows %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'W':
+                where = optarg;
+                break;
+            case 'C':
+                columns = optarg;
+                break;
+            case 'I':
+                index = optarg;
+                break;
+            case 'K':
+                key_lo = key_hi = optarg;
+                key_opt = true;
+                break;
+            case 'R': {
+                const char* dots = strstr(optarg, "..");
+                if (dots == nullptr) {
+                    fprintf(stderr, "Invalid --range %s, expected lo..hi\n", optarg);
+                    return -1;
+                }
+                key_lo.assign(optarg, dots - optarg);
+                key_hi = dots + 2;
+                key_opt = true;
+                break;
+            }
+            case 'S':
+                salvage = true;
+                break;
+            case 'U':
+                salvage = true;
+                undelete = true;
+                break;
+            case 'T':
+                n_threads = std::atol(optarg);
+                break;
+            case 'H':
+                schema_cache = true;
+                break;
+            case 'A':
+                as_of = std::strtoull(optarg, nullptr, 10);
+                as_of_opt = true;
+                break;
+            case 'N':
+                undo_paths = optarg;
+                break;
+            case 'Y':
+                by_commit = true;
+                break;
+            case 'J':
+                table_id = std::strtoull(optarg, nullptr, 10);
+                break;
+            case 'D':
+                dblwr_paths = optarg;
+                break;
+            case 'E':
+                redo_paths = optarg;
+                break;
+            case 'L':
+                since_lsn = std::strtoull(optarg, nullptr, 10);
+                break;
+            case 'P':
+                top = std::atol(optarg);
+                break;
+            case 'G':
+                page_list = optarg;
+                break;
+            case 'X':
+                target_lsn = std::strtoull(optarg, nullptr, 10);
+                break;
             case 'h':
                 usage();
                 return 0;
@@ -138,34 +397,100 @@ int main(int argc, char *argv[]) {
                 return 0;
         }
     }
+    if (strcmp(command, "redo-stats") == 0 || strcmp(command, "redo-pages") == 0) {
+        /* The redo log is read without a tablespace */
+        if (redo_paths[0] == '\0') {
+            fprintf(stderr, "Please specify --redo\n");
+            return -1;
+        }
+        InnoSpace::ShowRedoLog(redo_paths, since_lsn, top, strcmp(command, "redo-pages") == 0);
+        return 0;
+    }
     if (!path_opt) {
         fprintf(stderr, "Please specify the ibd file path\n");
         usage();
         return -1;
     }
     InnoSpace space(filepath);
-    if (sdi_path_opt) {
-        space.SetSdiPath(sdi_path);
+    /* Without -s the table definition is read from the tablespace */
+    space.SetSdiPath(sdi_path_opt ? sdi_path : filepath);
+    if (where != nullptr) {
+        space.SetWhere(where);
+    }
+    if (columns != nullptr) {
+        space.SetColumns(columns);
+    }
+    if (index != nullptr) {
+        space.SetIndex(index);
+    }
+    if (salvage) {
+        space.SetSalvage(undelete);
+    }
+    space.SetThreads(n_threads);
+    if (schema_cache) {
+        space.SetSchemaCache();
     }
     printf("File path %s path, page num %u\n", filepath, user_page);
     if (show_file) {
         space.ShowSpaceHeader();
         if (strcmp(command, "list-page-type") == 0) {
             space.ShowSpacePageType();
+        } else if (strcmp(command, "sys-space") == 0) {
+            space.ShowSysSpace();
         } else if (strcmp(command, "index-summary") == 0) {
             space.ShowIndexSummary();
         } else if (strcmp(command, "show-undo-file") == 0) {
             space.ShowUndoFile();
+        } else if (strcmp(command, "show-undo-records") == 0) {
+            space.ShowUndoRecords();
+        } else if (strcmp(command, "undo-history") == 0) {
+            space.ShowUndoHistory();
+        } else if (strcmp(command, "undo-usage") == 0) {
+            space.ShowUndoUsage();
+        } else if (strcmp(command, "trx-timeline") == 0) {
+            space.ShowTrxTimeline(key_lo.c_str(), key_hi.c_str(), by_commit, table_id);
         } else if (strcmp(command, "dump-all-records") == 0) {
             space.DumpAllRecords();
+        } else if (strcmp(command, "flashback") == 0) {
+            if (!as_of_opt || undo_paths[0] == '\0') {
+                fprintf(stderr, "Please specify --as-of and --undo\n");
+                return -1;
+            }
+            space.Flashback(as_of, undo_paths);
+        } else if (strcmp(command, "dblwr-check") == 0 ||
+                   strcmp(command, "dblwr-restore") == 0) {
+            if (dblwr_paths[0] == '\0') {
+                fprintf(stderr, "Please specify --dblwr\n");
+                return -1;
+            }
+            space.RestoreFromDoublewrite(dblwr_paths, strcmp(command, "dblwr-check") == 0);
+        } else if (strcmp(command, "redo-apply") == 0 ||
+                   strcmp(command, "redo-apply-check") == 0) {
+            if (redo_paths[0] == '\0' || page_list[0] == '\0') {
+                fprintf(stderr, "Please specify --redo and --pages\n");
+                return -1;
+            }
+            space.RedoApply(redo_paths, page_list, target_lsn,
+                            strcmp(command, "redo-apply-check") == 0);
+        } else if (strcmp(command, "lookup") == 0) {
+            if (!key_opt) {
+                fprintf(stderr, "Please specify --key or --range\n");
+                return -1;
+            }
+            space.LookupRecords(key_lo.c_str(), key_hi.c_str());
+        } else if (strcmp(command, "column-usage") == 0) {
+            space.ShowColumnUsage();
+        } else if (strcmp(command, "export-arrow") == 0) {
+            if (out_path[0] == '\0') {
+                fprintf(stderr, "Please specify the output file\n");
+                return -1;
+            }
+            space.ExportArrow(out_path, batch_rows);
         }
     } else {
         uint16_t type = 0;
         space.ShowFILHeader(user_page, &type);
         if (strcmp(command, "show-records") == 0) {
-            if (!sdi_path_opt) {
-                fprintf(stderr, "Please specify the sdi file path\n");
-            }
             is_show_records = true;
         }
         if (type == FIL_PAGE_TYPE_BLOB) {
@@ -0,0 +1,405 @@
+#include "include/lob_reader.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/fsp0fsp.h"
+#include "include/index_scan.h"
+#include "include/page0page.h"
+#include "include/rec_decoder.h"
+
+/** Capacity of the first page and of a data page of a new format LOB */
+static const ulint LOB_FIRST_DATA =
+    (ulint)BlobFirstPage::LOB_PAGE_DATA +
+    (ulint)BlobFirstPage::N_INDEX_ENTRIES * (ulint)BlobIndexEntry::SIZE;
+static const ulint LOB_FIRST_CAPACITY =
+    UNIV_PAGE_SIZE - FIL_PAGE_DATA_END - LOB_FIRST_DATA;
+static const ulint LOB_DATA_CAPACITY =
+    UNIV_PAGE_SIZE - FIL_PAGE_DATA_END - (ulint)BlobDataPage::LOB_PAGE_DATA;
+
+/** Compressed page size in the tablespace flags: 0 if the tablespace is
+not compressed, else the size is 512 << ssize */
+static const ulint FSP_FLAGS_POS_ZIP_SSIZE = 1;
+static const ulint FSP_FLAGS_MASK_ZIP_SSIZE = 15 << FSP_FLAGS_POS_ZIP_SSIZE;
+
+LobReader::LobReader(int fd)
+    : fd_(fd), page_size_(UNIV_PAGE_SIZE), n_pages_(0), first_buf_(nullptr),
+      index_buf_(nullptr), batch_buf_(nullptr), zstream_(nullptr) {
+  /* The flags are at the same place whatever the page size */
+  byte flags[4];
+  if (pread(fd, flags, sizeof(flags), FSP_HEADER_OFFSET + FSP_SPACE_FLAGS) ==
+      (ssize_t)sizeof(flags)) {
+    const ulint ssize = (mach_read_from_4(flags) & FSP_FLAGS_MASK_ZIP_SSIZE) >>
+                        FSP_FLAGS_POS_ZIP_SSIZE;
+    if (ssize != 0 && (512U << ssize) <= UNIV_PAGE_SIZE) {
+      page_size_ = 512U << ssize;
+    }
+  }
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == 0) {
+    n_pages_ = stat_buf.st_size / page_size_;
+  }
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE,
+                     (2 + LOB_BATCH_PAGES) * UNIV_PAGE_SIZE) == 0) {
+    first_buf_ = buf;
+    index_buf_ = buf + UNIV_PAGE_SIZE;
+    batch_buf_ = buf + 2 * UNIV_PAGE_SIZE;
+  }
+}
+
+LobReader::~LobReader() {
+  if (zstream_ != nullptr) {
+    inflateEnd(zstream_);
+    delete zstream_;
+  }
+  free(first_buf_);
+}
+
+int LobReader::ReadPage(uint32_t page_no, byte *buf) {
+  if (page_no >= n_pages_ ||
+      pread(fd_, buf, page_size_, (uint64_t)page_no * page_size_) !=
+          (ssize_t)page_size_) {
+    return -1;
+  }
+  return 0;
+}
+
+int LobReader::ReadPages(const uint32_t *pages, size_t n) {
+  for (size_t i = 0; i < n;) {
+    size_t j = i + 1;
+    while (j < n && pages[j] == pages[j - 1] + 1) {
+      j++;
+    }
+    const size_t size = (j - i) * page_size_;
+    if (pages[j - 1] >= n_pages_ ||
+        pread(fd_, batch_buf_ + i * page_size_, size,
+              (uint64_t)pages[i] * page_size_) != (ssize_t)size) {
+      fprintf(stderr, "[ERROR] read of LOB pages %u..%u failed\n", pages[i],
+              pages[j - 1]);
+      return -1;
+    }
+    i = j;
+  }
+  return 0;
+}
+
+void LobReader::Prefetch(const uint32_t *pages, size_t n) {
+  for (size_t i = 0; i < n;) {
+    size_t j = i + 1;
+    while (j < n && pages[j] == pages[j - 1] + 1) {
+      j++;
+    }
+    posix_fadvise(fd_, (uint64_t)pages[i] * page_size_, (j - i) * page_size_,
+                  POSIX_FADV_WILLNEED);
+    i = j;
+  }
+}
+
+int64_t LobReader::ReadNew(uint32_t first_page_no, uint64_t len,
+                           const lob_part_cb &cb) {
+  /* The index list gives the page and the length of every part in order.
+  Its entries are in the first page, then in LOB index pages. */
+  struct LobPart {
+    uint32_t page_no;
+    ulint len;
+  };
+  std::vector<LobPart> parts;
+  std::vector<uint32_t> data_pages;
+  const byte *base = first_buf_ + (ulint)BlobFirstPage::OFFSET_INDEX_LIST;
+  const ulint n_entries = flst_get_len(base);
+  if (n_entries > n_pages_) {
+    fprintf(stderr, "[ERROR] LOB at page %u has %u index entries\n",
+            first_page_no, n_entries);
+    return -1;
+  }
+  uint32_t index_page_no = FIL_NULL;
+  fil_addr_t addr = flst_get_first(base);
+  for (ulint i = 0; i < n_entries; i++) {
+    const byte *page = first_buf_;
+    if (addr.page != first_page_no) {
+      if (addr.page != index_page_no &&
+          (ReadPage(addr.page, index_buf_) != 0 ||
+           fil_page_get_type(index_buf_) != FIL_PAGE_TYPE_LOB_INDEX)) {
+        fprintf(stderr, "[ERROR] bad LOB index page %u of LOB at page %u\n",
+                addr.page, first_page_no);
+        return -1;
+      }
+      index_page_no = addr.page;
+      page = index_buf_;
+    }
+    if (addr.boffset < FIL_PAGE_DATA ||
+        addr.boffset + (ulint)BlobIndexEntry::SIZE >
+            UNIV_PAGE_SIZE - FIL_PAGE_DATA_END) {
+      fprintf(stderr, "[ERROR] bad LOB index entry %u:%u of LOB at page %u\n",
+              addr.page, addr.boffset, first_page_no);
+      return -1;
+    }
+    const byte *entry = page + addr.boffset;
+    LobPart part;
+    part.page_no = mach_read_from_4(entry + (ulint)BlobIndexEntry::OFFSET_PAGE_NO);
+    part.len = mach_read_from_2(entry + (ulint)BlobIndexEntry::OFFSET_DATA_LEN);
+    parts.push_back(part);
+    if (part.page_no != first_page_no) {
+      data_pages.push_back(part.page_no);
+    }
+    addr = flst_get_next_addr(entry);
+  }
+
+  uint64_t total = 0;
+  size_t next = 0;
+  size_t in_batch = 0;
+  size_t batch_size = 0;
+  for (size_t i = 0; i < parts.size(); i++) {
+    const byte *data;
+    ulint capacity;
+    if (parts[i].page_no == first_page_no) {
+      data = first_buf_ + LOB_FIRST_DATA;
+      capacity = LOB_FIRST_CAPACITY;
+    } else {
+      if (in_batch == batch_size) {
+        batch_size = std::min<size_t>(LOB_BATCH_PAGES, data_pages.size() - next);
+        if (ReadPages(&data_pages[next], batch_size) != 0) {
+          return -1;
+        }
+        next += batch_size;
+        in_batch = 0;
+        Prefetch(data_pages.data() + next,
+                 std::min<size_t>(LOB_BATCH_PAGES, data_pages.size() - next));
+      }
+      const byte *page = batch_buf_ + in_batch++ * page_size_;
+      if (fil_page_get_type(page) != FIL_PAGE_TYPE_LOB_DATA) {
+        fprintf(stderr, "[ERROR] page %u of LOB at page %u is not a LOB data page\n",
+                parts[i].page_no, first_page_no);
+        return -1;
+      }
+      data = page + (ulint)BlobDataPage::LOB_PAGE_DATA;
+      capacity = LOB_DATA_CAPACITY;
+    }
+    if (parts[i].len > capacity) {
+      fprintf(stderr, "[ERROR] bad length %u of page %u of LOB at page %u\n",
+              parts[i].len, parts[i].page_no, first_page_no);
+      return -1;
+    }
+    total += parts[i].len;
+    if (!cb(data, parts[i].len)) {
+      return total;
+    }
+  }
+  if (total != len) {
+    fprintf(stderr, "[ERROR] LOB at page %u has %lu bytes, expected %lu\n",
+            first_page_no, total, len);
+    return -1;
+  }
+  return total;
+}
+
+int64_t LobReader::ReadOld(uint32_t first_page_no, ulint offset, uint64_t len,
+                           uint16_t type, const lob_part_cb &cb) {
+  std::unordered_set<uint32_t> visited;
+  visited.insert(first_page_no);
+  uint32_t page_no = first_page_no;
+  uint64_t total = 0;
+  for (;;) {
+    if (fil_page_get_type(first_buf_) != type) {
+      fprintf(stderr, "[ERROR] page %u of BLOB at page %u is of type %u\n",
+              page_no, first_page_no, fil_page_get_type(first_buf_));
+      return -1;
+    }
+    if (offset < FIL_PAGE_DATA ||
+        offset + BTR_BLOB_HDR_SIZE > UNIV_PAGE_SIZE - FIL_PAGE_DATA_END) {
+      fprintf(stderr, "[ERROR] bad offset %u of BLOB at page %u\n", offset,
+              first_page_no);
+      return -1;
+    }
+    const byte *part = first_buf_ + offset;
+    const ulint part_len = mach_read_from_4(part + BTR_BLOB_HDR_PART_LEN);
+    const uint32_t next = mach_read_from_4(part + BTR_BLOB_HDR_NEXT_PAGE_NO);
+    if (part_len >
+            UNIV_PAGE_SIZE - FIL_PAGE_DATA_END - offset - BTR_BLOB_HDR_SIZE ||
+        total + part_len > len) {
+      fprintf(stderr, "[ERROR] bad length %u of page %u of BLOB at page %u\n",
+              part_len, page_no, first_page_no);
+      return -1;
+    }
+    if (next != FIL_NULL && next < n_pages_) {
+      Prefetch(&next, 1);
+    }
+    total += part_len;
+    if (!cb(part + BTR_BLOB_HDR_SIZE, part_len)) {
+      return total;
+    }
+    if (next == FIL_NULL) {
+      break;
+    }
+    if (!visited.insert(next).second) {
+      fprintf(stderr, "[ERROR] BLOB chain at page %u comes back to page %u\n",
+              first_page_no, next);
+      return -1;
+    }
+    if (ReadPage(next, first_buf_) != 0) {
+      fprintf(stderr, "[ERROR] BLOB chain at page %u is broken at page %u\n",
+              first_page_no, next);
+      return -1;
+    }
+    page_no = next;
+    offset = FIL_PAGE_DATA;
+  }
+  if (total != len) {
+    fprintf(stderr, "[ERROR] BLOB chain at page %u ends after %lu of %lu bytes\n",
+            first_page_no, total, len);
+    return -1;
+  }
+  return total;
+}
+
+int64_t LobReader::ReadZip(uint32_t first_page_no, ulint offset, uint64_t len,
+                           const lob_part_cb &cb) {
+  if (zstream_ == nullptr) {
+    zstream_ = new z_stream();
+    if (inflateInit(zstream_) != Z_OK) {
+      delete zstream_;
+      zstream_ = nullptr;
+      fprintf(stderr, "[ERROR] inflateInit failed\n");
+      return -1;
+    }
+  } else if (inflateReset(zstream_) != Z_OK) {
+    fprintf(stderr, "[ERROR] inflateReset failed\n");
+    return -1;
+  }
+  z_stream *zs = zstream_;
+  const ulint out_size = LOB_BATCH_PAGES * UNIV_PAGE_SIZE;
+  std::unordered_set<uint32_t> visited;
+  visited.insert(first_page_no);
+  uint32_t page_no = first_page_no;
+  uint16_t type = FIL_PAGE_TYPE_ZBLOB;
+  uint64_t total = 0;
+  /* Bytes of batch_buf_ inflated and not passed on yet */
+  ulint pending = 0;
+  int err = Z_OK;
+  for (;;) {
+    if (fil_page_get_type(first_buf_) != type) {
+      fprintf(stderr, "[ERROR] page %u of compressed BLOB at page %u is of type %u\n",
+              page_no, first_page_no, fil_page_get_type(first_buf_));
+      return -1;
+    }
+    /* The first page has the next page number at the offset of the
+    reference, the other pages in FIL_PAGE_NEXT. The stream fills the
+    rest of the page, the trailer included. */
+    if (offset < FIL_PAGE_NEXT || offset + 4 >= page_size_) {
+      fprintf(stderr, "[ERROR] bad offset %u of compressed BLOB at page %u\n",
+              offset, first_page_no);
+      return -1;
+    }
+    const uint32_t next = mach_read_from_4(first_buf_ + offset);
+    if (next != FIL_NULL && next < n_pages_) {
+      Prefetch(&next, 1);
+    }
+    const ulint data = offset == FIL_PAGE_NEXT ? FIL_PAGE_DATA : offset + 4;
+    zs->next_in = first_buf_ + data;
+    zs->avail_in = page_size_ - data;
+    do {
+      zs->next_out = batch_buf_ + pending;
+      zs->avail_out =
+          std::min<uint64_t>(out_size - pending, len - total - pending);
+      err = inflate(zs, Z_NO_FLUSH);
+      pending = zs->next_out - batch_buf_;
+      if (pending == out_size || total + pending == len) {
+        total += pending;
+        if (!cb(batch_buf_, pending)) {
+          return total;
+        }
+        pending = 0;
+      }
+    } while (err == Z_OK && zs->avail_in > 0 && total < len);
+    if (err == Z_STREAM_END || total == len) {
+      break;
+    }
+    if (err != Z_OK && err != Z_BUF_ERROR) {
+      fprintf(stderr, "[ERROR] inflate of compressed BLOB at page %u failed at page %u: %s\n",
+              first_page_no, page_no, zs->msg != nullptr ? zs->msg : "");
+      return -1;
+    }
+    if (next == FIL_NULL) {
+      break;
+    }
+    if (!visited.insert(next).second) {
+      fprintf(stderr, "[ERROR] compressed BLOB chain at page %u comes back to page %u\n",
+              first_page_no, next);
+      return -1;
+    }
+    if (ReadPage(next, first_buf_) != 0) {
+      fprintf(stderr, "[ERROR] compressed BLOB chain at page %u is broken at page %u\n",
+              first_page_no, next);
+      return -1;
+    }
+    page_no = next;
+    offset = FIL_PAGE_NEXT;
+    type = FIL_PAGE_TYPE_ZBLOB2;
+  }
+  if (pending > 0) {
+    total += pending;
+    if (!cb(batch_buf_, pending)) {
+      return total;
+    }
+  }
+  if (total != len) {
+    fprintf(stderr, "[ERROR] compressed BLOB at page %u inflates to %lu of %lu bytes\n",
+            first_page_no, total, len);
+    return -1;
+  }
+  return total;
+}
+
+int64_t LobReader::Read(const byte *ref, const lob_part_cb &cb) {
+  const uint32_t page_no = mach_read_from_4(ref + BTR_EXTERN_PAGE_NO);
+  /* The 4 most significant bytes of the length are always 0 */
+  const uint64_t len = mach_read_from_4(ref + BTR_EXTERN_LEN + 4);
+  if (len == 0) {
+    /* The value was not written yet, or has been freed by a rollback */
+    return 0;
+  }
+  if (first_buf_ == nullptr || ReadPage(page_no, first_buf_) != 0) {
+    fprintf(stderr, "[ERROR] read of LOB page %u failed\n", page_no);
+    return -1;
+  }
+  const uint16_t type = fil_page_get_type(first_buf_);
+  switch (type) {
+    case FIL_PAGE_TYPE_LOB_FIRST:
+      return ReadNew(page_no, len, cb);
+    case FIL_PAGE_TYPE_BLOB:
+    case FIL_PAGE_SDI_BLOB:
+      return ReadOld(page_no, mach_read_from_4(ref + BTR_EXTERN_OFFSET), len,
+                     type, cb);
+    case FIL_PAGE_TYPE_ZBLOB:
+      return ReadZip(page_no, mach_read_from_4(ref + BTR_EXTERN_OFFSET), len,
+                     cb);
+    default:
+      fprintf(stderr, "[ERROR] LOB page %u of type %u is not supported\n",
+              page_no, type);
+      return -1;
+  }
+}
+
+int64_t LobReader::ReadField(const byte *data, ulint len,
+                             const lob_part_cb &cb) {
+  if (len < BTR_EXTERN_FIELD_REF_SIZE) {
+    fprintf(stderr, "[ERROR] externally stored field of %u bytes\n", len);
+    return -1;
+  }
+  const ulint local_len = len - BTR_EXTERN_FIELD_REF_SIZE;
+  if (local_len > 0 && !cb(data, local_len)) {
+    return local_len;
+  }
+  int64_t ret = Read(data + local_len, cb);
+  return ret < 0 ? -1 : local_len + ret;
+}
@@ -1,6 +1,8 @@
 
 #include "include/mach_data.h"
 
+#include <stddef.h>
+
 /*******************************************************//**
 Creates a 64-bit integer out of two 32-bit integers.
 @return	created integer */
@@ -23,6 +25,11 @@ uint16_t mach_read_from_2(const byte *b) {
   return (((ulint)(b[0]) << 8) | (ulint)(b[1]));
 }
 
+uint32_t mach_read_from_3(const byte *b) {
+  return ((static_cast<uint32_t>(b[0]) << 16) |
+      (static_cast<uint32_t>(b[1]) << 8) | static_cast<uint32_t>(b[2]));
+}
+
 uint32_t mach_read_from_4(const byte *b) {
   return ((static_cast<uint32_t>(b[0]) << 24) |
       (static_cast<uint32_t>(b[1]) << 16) |
@@ -33,6 +40,10 @@ uint64_t mach_read_from_6(const byte*	b) {
   return(ut_ull_create(mach_read_from_2(b), mach_read_from_4(b + 2)));
 }
 
+uint64_t mach_read_from_7(const byte *b) {
+  return(ut_ull_create(mach_read_from_3(b), mach_read_from_4(b + 3)));
+}
+
 /** The following function is used to fetch data from 8 consecutive
  * bytes. The most significant byte is at the lowest address.
  * @param[in]  b pointer to 8 bytes from where read
@@ -97,3 +108,147 @@ void mach_write_to_4(byte *b, ulint n) {
   b[3] = static_cast<byte>(n);
 }
 
+void mach_write_to_6(byte *b, uint64_t n) {
+  ut_ad(b);
+
+  mach_write_to_2(b, static_cast<ulint>(n >> 32));
+  mach_write_to_4(b + 2, static_cast<ulint>(n));
+}
+
+void mach_write_to_7(byte *b, uint64_t n) {
+  ut_ad(b);
+
+  mach_write_to_3(b, static_cast<ulint>(n >> 32));
+  mach_write_to_4(b + 3, static_cast<ulint>(n));
+}
+
+void mach_write_to_8(byte *b, uint64_t n) {
+  ut_ad(b);
+
+  mach_write_to_4(b, static_cast<ulint>(n >> 32));
+  mach_write_to_4(b + 4, static_cast<ulint>(n));
+}
+
+
+ulint mach_write_compressed(byte *b, uint32_t n) {
+  if (n < 0x80) {
+    mach_write_to_1(b, n);
+    return 1;
+  } else if (n < 0x4000) {
+    mach_write_to_2(b, n | 0x8000);
+    return 2;
+  } else if (n < 0x200000) {
+    mach_write_to_3(b, n | 0xC00000);
+    return 3;
+  } else if (n < 0x10000000) {
+    mach_write_to_4(b, n | 0xE0000000);
+    return 4;
+  } else if (n >= 0xFFFFFC00) {
+    mach_write_to_2(b, (n & 0x3FF) | 0xF800);
+    return 2;
+  } else if (n >= 0xFFFE0000) {
+    mach_write_to_3(b, (n & 0x1FFFF) | 0xFC0000);
+    return 3;
+  } else if (n >= 0xFE000000) {
+    mach_write_to_4(b, (n & 0x1FFFFFF) | 0xFE000000);
+    return 4;
+  }
+  mach_write_to_1(b, 0xF0);
+  mach_write_to_4(b + 1, n);
+  return 5;
+}
+
+ulint mach_u64_write_compressed(byte *b, uint64_t n) {
+  ulint size = mach_write_compressed(b, (uint32_t)(n >> 32));
+  mach_write_to_4(b + size, (uint32_t)n);
+  return size + 4;
+}
+
+ulint mach_u64_write_much_compressed(byte *b, uint64_t n) {
+  if (!(n >> 32)) {
+    return mach_write_compressed(b, (uint32_t)n);
+  }
+  mach_write_to_1(b, 0xFF);
+  ulint size = 1 + mach_write_compressed(b + 1, (uint32_t)(n >> 32));
+  return size + mach_write_compressed(b + size, (uint32_t)n);
+}
+
+uint32_t mach_parse_compressed(const byte **ptr, const byte *end_ptr) {
+  if (*ptr >= end_ptr) {
+    *ptr = nullptr;
+    return 0;
+  }
+  const byte *b = *ptr;
+  const uint32_t first = b[0];
+  ulint size;
+  uint32_t val;
+  if (first < 0x80) {
+    size = 1;
+  } else if (first < 0xC0) {
+    size = 2;
+  } else if (first < 0xE0) {
+    size = 3;
+  } else if (first < 0xF0) {
+    size = 4;
+  } else if (first < 0xF8) {
+    size = 5;
+  } else if (first < 0xFC) {
+    size = 2;
+  } else if (first < 0xFE) {
+    size = 3;
+  } else {
+    size = 4;
+  }
+  if (end_ptr - b < (ptrdiff_t)size) {
+    *ptr = nullptr;
+    return 0;
+  }
+  if (first < 0x80) {
+    val = first;
+  } else if (first < 0xC0) {
+    val = mach_read_from_2(b) & 0x3FFF;
+  } else if (first < 0xE0) {
+    val = ((uint32_t)mach_read_from_2(b) << 8 | b[2]) & 0x1FFFFF;
+  } else if (first < 0xF0) {
+    val = mach_read_from_4(b) & 0xFFFFFFF;
+  } else if (first < 0xF8) {
+    val = mach_read_from_4(b + 1);
+  } else if (first < 0xFC) {
+    val = (mach_read_from_2(b) & 0x3FF) | 0xFFFFFC00;
+  } else if (first < 0xFE) {
+    val = (((uint32_t)mach_read_from_2(b) << 8 | b[2]) & 0x1FFFF) | 0xFFFE0000;
+  } else {
+    val = (mach_read_from_4(b) & 0x1FFFFFF) | 0xFE000000;
+  }
+  *ptr = b + size;
+  return val;
+}
+
+uint64_t mach_u64_parse_compressed(const byte **ptr, const byte *end_ptr) {
+  const uint64_t high = mach_parse_compressed(ptr, end_ptr);
+  if (*ptr == nullptr || end_ptr - *ptr < 4) {
+    *ptr = nullptr;
+    return 0;
+  }
+  const uint64_t val = high << 32 | mach_read_from_4(*ptr);
+  *ptr += 4;
+  return val;
+}
+
+uint64_t mach_parse_u64_much_compressed(const byte **ptr,
+                                        const byte *end_ptr) {
+  if (*ptr >= end_ptr) {
+    *ptr = nullptr;
+    return 0;
+  }
+  if (**ptr != 0xFF) {
+    return mach_parse_compressed(ptr, end_ptr);
+  }
+  ++*ptr;
+  const uint64_t high = mach_parse_compressed(ptr, end_ptr);
+  if (*ptr == nullptr) {
+    return 0;
+  }
+  const uint64_t low = mach_parse_compressed(ptr, end_ptr);
+  return *ptr == nullptr ? 0 : high << 32 | low;
+}
@@ -0,0 +1,209 @@
+#include "include/page_decoder.h"
+
+#include <string.h>
+
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/index_scan.h"
+#include "include/my_compiler.h"
+#include "include/page0page.h"
+#include "include/rec.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define gnuc64
+#include <immintrin.h>
+#endif
+
+size_t page_batch_collect(const byte *page, uint32_t page_no,
+                          const RecLayout &layout, size_t n_decode,
+                          const RowFilter &filter, PageBatch *batch) {
+  batch->page = page;
+  batch->page_no = page_no;
+  batch->layout = &layout;
+  batch->stride = layout.fields.size();
+  batch->recs.clear();
+
+  /* Gather the record origins first, the chain is a dependent load per
+  record while the offsets of the records can be computed independently. */
+  const bool comp = page_is_comp(page);
+  const page_rec_next_func_t next_rec = page_rec_next_func(page);
+  size_t n_visited = 0;
+  for (const rec_t *rec = next_rec(page, page_get_infimum(page));
+       rec != nullptr && n_visited < UNIV_PAGE_SIZE / REC_N_NEW_EXTRA_BYTES;
+       rec = next_rec(page, rec), n_visited++) {
+    /* The bound stops at a loop in the chain of a corrupt page */
+    if (page_rec_is_live(rec, comp)) {
+      batch->recs.push_back(rec);
+    }
+  }
+  const size_t n_examined = batch->recs.size();
+
+  batch->offs.resize(n_examined * batch->stride);
+  size_t n = 0;
+  for (size_t i = 0; i < n_examined; i++) {
+    const rec_t *rec = batch->recs[i];
+    ulint *offs = &batch->offs[n * batch->stride];
+    rec_layout_get_offsets(rec, layout, offs, n_decode);
+    if (row_filter_match(filter, rec, offs)) {
+      batch->recs[n++] = rec;
+    }
+  }
+  batch->recs.resize(n);
+  batch->offs.resize(n * batch->stride);
+  return n_examined;
+}
+
+void page_batch_decode_int(const PageBatch &batch, size_t field,
+                           uint32_t width, bool is_signed, void *out,
+                           uint8_t *valid) {
+  const size_t n = batch.size();
+  std::vector<byte> raw(n * width);
+  for (size_t i = 0; i < n; i++) {
+    const ulint *offs = batch.rec_offs(i);
+    ulint len;
+    const byte *data =
+        rec_field_get(batch.recs[i], *batch.layout, offs, field, &len);
+    if (rec_offs_field_is_null(offs, field) ||
+        rec_offs_field_is_extern(offs, field) || len != width) {
+      valid[i] = 0;
+      /* Decodes to 0 */
+      memset(&raw[i * width], 0, width);
+      if (is_signed) {
+        raw[i * width] = 0x80;
+      }
+      continue;
+    }
+    valid[i] = 1;
+    memcpy(&raw[i * width], data, width);
+  }
+  int_be_decode(raw.data(), n, width, is_signed, out);
+}
+
+void int_be_decode2_scalar(const byte *in, size_t n, bool flip_sign,
+                           void *out) {
+  const uint16_t flip = flip_sign ? 0x8000 : 0;
+  byte *o = static_cast<byte *>(out);
+  for (size_t i = 0; i < n; i++) {
+    uint16_t v = static_cast<uint16_t>(mach_read_from_2(in + i * 2) ^ flip);
+    memcpy(o + i * 2, &v, 2);
+  }
+}
+
+void int_be_decode4_scalar(const byte *in, size_t n, bool flip_sign,
+                           void *out) {
+  const uint32_t flip = flip_sign ? 0x80000000U : 0;
+  byte *o = static_cast<byte *>(out);
+  for (size_t i = 0; i < n; i++) {
+    uint32_t v = static_cast<uint32_t>(mach_read_from_4(in + i * 4)) ^ flip;
+    memcpy(o + i * 4, &v, 4);
+  }
+}
+
+void int_be_decode8_scalar(const byte *in, size_t n, bool flip_sign,
+                           void *out) {
+  const uint64_t flip = flip_sign ? 0x8000000000000000ULL : 0;
+  byte *o = static_cast<byte *>(out);
+  for (size_t i = 0; i < n; i++) {
+    uint64_t v = mach_read_from_8(in + i * 8) ^ flip;
+    memcpy(o + i * 8, &v, 8);
+  }
+}
+
+#ifdef gnuc64
+/* The AVX2 kernels reverse the bytes of every lane with one shuffle and
+flip the sign bit with one xor, 32 bytes at a time. */
+
+MY_ATTRIBUTE((target("avx2")))
+static void int_be_decode2_avx2(const byte *in, size_t n, bool flip_sign,
+                                void *out) {
+  const __m256i shuf =
+      _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1,
+                       0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  const __m256i flip = _mm256_set1_epi16(flip_sign ? (int16_t)0x8000 : 0);
+  byte *o = static_cast<byte *>(out);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i * 2));
+    v = _mm256_xor_si256(_mm256_shuffle_epi8(v, shuf), flip);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(o + i * 2), v);
+  }
+  int_be_decode2_scalar(in + i * 2, n - i, flip_sign, o + i * 2);
+}
+
+MY_ATTRIBUTE((target("avx2")))
+static void int_be_decode4_avx2(const byte *in, size_t n, bool flip_sign,
+                                void *out) {
+  const __m256i shuf =
+      _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3,
+                       2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  const __m256i flip = _mm256_set1_epi32(flip_sign ? (int32_t)0x80000000U : 0);
+  byte *o = static_cast<byte *>(out);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i * 4));
+    v = _mm256_xor_si256(_mm256_shuffle_epi8(v, shuf), flip);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(o + i * 4), v);
+  }
+  int_be_decode4_scalar(in + i * 4, n - i, flip_sign, o + i * 4);
+}
+
+MY_ATTRIBUTE((target("avx2")))
+static void int_be_decode8_avx2(const byte *in, size_t n, bool flip_sign,
+                                void *out) {
+  const __m256i shuf =
+      _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7,
+                       6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  const __m256i flip =
+      _mm256_set1_epi64x(flip_sign ? (int64_t)0x8000000000000000ULL : 0);
+  byte *o = static_cast<byte *>(out);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i * 8));
+    v = _mm256_xor_si256(_mm256_shuffle_epi8(v, shuf), flip);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(o + i * 8), v);
+  }
+  int_be_decode8_scalar(in + i * 8, n - i, flip_sign, o + i * 8);
+}
+#endif /* gnuc64 */
+
+int_be_decode_func_t int_be_decode2 = int_be_decode2_scalar;
+int_be_decode_func_t int_be_decode4 = int_be_decode4_scalar;
+int_be_decode_func_t int_be_decode8 = int_be_decode8_scalar;
+
+void int_be_decode(const byte *in, size_t n, uint32_t width, bool flip_sign,
+                   void *out) {
+  switch (width) {
+    case 1: {
+      const byte flip = flip_sign ? 0x80 : 0;
+      byte *o = static_cast<byte *>(out);
+      for (size_t i = 0; i < n; i++) {
+        o[i] = in[i] ^ flip;
+      }
+      break;
+    }
+    case 2:
+      int_be_decode2(in, n, flip_sign, out);
+      break;
+    case 4:
+      int_be_decode4(in, n, flip_sign, out);
+      break;
+    case 8:
+      int_be_decode8(in, n, flip_sign, out);
+      break;
+  }
+}
+
+bool page_decoder_init() {
+#ifdef gnuc64
+  if (__builtin_cpu_supports("avx2")) {
+    int_be_decode2 = int_be_decode2_avx2;
+    int_be_decode4 = int_be_decode4_avx2;
+    int_be_decode8 = int_be_decode8_avx2;
+    return true;
+  }
+#endif /* gnuc64 */
+  int_be_decode2 = int_be_decode2_scalar;
+  int_be_decode4 = int_be_decode4_scalar;
+  int_be_decode8 = int_be_decode8_scalar;
+  return false;
+}
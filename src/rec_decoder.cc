@@ -0,0 +1,793 @@
+#include "include/rec_decoder.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "include/fsp0types.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+
+bool rec_col_is_system(const ColumnDef &col) {
+  return col.hidden == 2 &&
+         (col.name == "DB_ROW_ID" || col.name == "DB_TRX_ID" ||
+          col.name == "DB_ROLL_PTR");
+}
+
+/** Storage size of a packed DECIMAL(precision, scale). */
+static uint32_t decimal_bin_size(uint32_t precision, uint32_t scale) {
+  static const uint32_t dig2bytes[10] = {0, 1, 1, 2, 2, 3, 3, 4, 4, 4};
+  uint32_t intg = precision - scale;
+  return (intg / 9) * 4 + dig2bytes[intg % 9] + (scale / 9) * 4 +
+         dig2bytes[scale % 9];
+}
+
+uint32_t rec_col_fixed_len(const ColumnDef &col) {
+  if (rec_col_is_system(col)) {
+    if (col.name == "DB_ROLL_PTR") {
+      return DATA_ROLL_PTR_LEN;
+    }
+    return col.name == "DB_TRX_ID" ? DATA_TRX_ID_LEN : DATA_ROW_ID_LEN;
+  }
+  switch (col.type) {
+    case DD_TYPE_TINY:
+    case DD_TYPE_YEAR:
+      return 1;
+    case DD_TYPE_SHORT:
+      return 2;
+    case DD_TYPE_INT24:
+    case DD_TYPE_NEWDATE:
+    case DD_TYPE_DATE:
+    case DD_TYPE_TIME:
+      return 3;
+    case DD_TYPE_LONG:
+    case DD_TYPE_FLOAT:
+    case DD_TYPE_TIMESTAMP:
+      return 4;
+    case DD_TYPE_LONGLONG:
+    case DD_TYPE_DOUBLE:
+    case DD_TYPE_DATETIME:
+      return 8;
+    case DD_TYPE_TIMESTAMP2:
+      return 4 + (col.datetime_precision + 1) / 2;
+    case DD_TYPE_DATETIME2:
+      return 5 + (col.datetime_precision + 1) / 2;
+    case DD_TYPE_TIME2:
+      return 3 + (col.datetime_precision + 1) / 2;
+    case DD_TYPE_NEWDECIMAL:
+      return decimal_bin_size(col.numeric_precision, col.numeric_scale);
+    case DD_TYPE_BIT:
+      return (col.numeric_precision + 7) / 8;
+    case DD_TYPE_ENUM:
+      return col.n_elements < 256 ? 1 : 2;
+    case DD_TYPE_SET: {
+      uint32_t len = (col.n_elements + 7) / 8;
+      return len > 4 ? 8 : len;
+    }
+    case DD_TYPE_STRING:
+      /* CHAR in a multi-byte character set is stored with a length in
+      COMPACT and DYNAMIC records. */
+      return collation_mbmaxlen(col.collation_id) == 1 ? col.char_length : 0;
+    default:
+      return 0;
+  }
+}
+
+/** @return whether a variable-length column may need a two byte length and
+may be stored externally (DATA_BIG_COL) */
+static bool rec_col_is_big(const ColumnDef &col) {
+  switch (col.type) {
+    case DD_TYPE_TINY_BLOB:
+    case DD_TYPE_MEDIUM_BLOB:
+    case DD_TYPE_LONG_BLOB:
+    case DD_TYPE_BLOB:
+    case DD_TYPE_GEOMETRY:
+    case DD_TYPE_JSON:
+      return true;
+    default:
+      return col.char_length > 255;
+  }
+}
+
+/** Build the plans of the row versions of the clustered index leaf records
+of a table that went through an instant ADD/DROP COLUMN, so that a record
+selects its plan by the version in its header. */
+static void rec_layout_build_versions(const TableDef &table,
+                                      RecLayout *layout) {
+  const size_t n = layout->fields.size();
+  layout->is_instant = true;
+  layout->base.n_nullable = 0;
+  layout->base.stored.assign(n, 0);
+  layout->versions.resize(table.max_row_version + 1);
+  for (size_t v = 0; v < layout->versions.size(); v++) {
+    layout->versions[v].n_nullable = 0;
+    layout->versions[v].stored.assign(n, 0);
+  }
+  layout->n_nullable_before.assign(n + 1, 0);
+
+  for (size_t i = 0; i < n; i++) {
+    const RecFieldPlan &f = layout->fields[i];
+    const ColumnDef &col = table.columns[f.col_no];
+    layout->n_nullable_before[i + 1] =
+        layout->n_nullable_before[i] + (f.nullable ? 1 : 0);
+
+    /* Records without a version were written before any instant ADD and
+    store the columns dropped since. */
+    if (!col.instant_v1 && col.version_added == 0) {
+      layout->base.stored[i] = 1;
+      layout->base.n_nullable += f.nullable ? 1 : 0;
+    }
+    for (uint32_t v = 0; v < layout->versions.size(); v++) {
+      if (col.version_added <= v &&
+          (col.version_dropped == 0 || col.version_dropped > v)) {
+        layout->versions[v].stored[i] = 1;
+        layout->versions[v].n_nullable += f.nullable ? 1 : 0;
+      }
+    }
+  }
+}
+
+int rec_layout_build(const TableDef &table, const IndexDef &index, bool leaf,
+                     RecLayout *layout) {
+  layout->table = &table;
+  layout->index = &index;
+  layout->fields.clear();
+  layout->n_nullable = 0;
+  layout->n_uniq = 0;
+  layout->is_clustered = (&index == table_def_clust_index(table));
+  layout->is_leaf = leaf;
+  layout->is_compact = table.row_format != DD_ROW_FORMAT_REDUNDANT;
+  layout->is_instant = false;
+  layout->versions.clear();
+  layout->n_nullable_before.clear();
+  layout->defaults.clear();
+
+  for (size_t i = 0; i < index.fields.size(); i++) {
+    const IndexFieldDef &f = index.fields[i];
+    const ColumnDef &col = table.columns[f.col_no];
+    if (col.type == DD_TYPE_DECIMAL || col.type == DD_TYPE_NULL) {
+      fprintf(stderr, "Unsupported column type: %s\n",
+              col.column_type_utf8.c_str());
+      return -1;
+    }
+
+    RecFieldPlan plan;
+    plan.col_no = f.col_no;
+    plan.fixed_len = rec_col_fixed_len(col);
+    plan.max_len = plan.fixed_len ? plan.fixed_len : col.char_length;
+    if (f.length != DD_ELEMENT_FULL_LENGTH && f.length < plan.max_len) {
+      /* A column prefix is always stored with a length. */
+      plan.fixed_len = 0;
+      plan.max_len = f.length;
+    }
+    plan.nullable = col.is_nullable;
+    plan.big = plan.fixed_len == 0 && rec_col_is_big(col);
+    plan.has_default = !col.default_null;
+    layout->fields.push_back(plan);
+    layout->defaults.push_back(col.default_value);
+
+    if (plan.nullable) {
+      layout->n_nullable++;
+    }
+    if (f.is_key) {
+      layout->n_uniq++;
+    }
+  }
+
+  if (!layout->is_clustered) {
+    /* The records of a secondary index are (key columns, primary key
+    columns). They are only unique in the tree with all of their fields,
+    which node pointers carry too. */
+    layout->n_uniq = static_cast<uint32_t>(layout->fields.size());
+  }
+
+  if (leaf && layout->is_clustered &&
+      (table.instant_cols > 0 || table.max_row_version > 0)) {
+    rec_layout_build_versions(table, layout);
+  }
+
+  if (!leaf) {
+    /* Node pointers carry the fields that identify a record in the tree,
+    followed by the child page number. */
+    size_t n_node_fields =
+        layout->is_clustered ? layout->n_uniq : layout->fields.size();
+    layout->fields.resize(n_node_fields);
+
+    RecFieldPlan child;
+    child.col_no = REC_FIELD_CHILD_PAGE;
+    child.fixed_len = REC_NODE_PTR_SIZE;
+    child.max_len = REC_NODE_PTR_SIZE;
+    child.nullable = false;
+    child.big = false;
+    child.has_default = false;
+    layout->fields.push_back(child);
+    layout->defaults.push_back(std::string());
+  }
+  return 0;
+}
+
+void rec_layout_set_format(RecLayout *layout, const byte *page) {
+  layout->is_compact =
+      (mach_read_from_2(page + PAGE_HEADER + PAGE_N_HEAP) & PAGE_IS_COMPACT) !=
+      0;
+}
+
+void rec_layout_get_offsets(const rec_t *rec, const RecLayout &layout,
+                            ulint *offs) {
+  rec_layout_get_offsets(rec, layout, offs, layout.fields.size());
+}
+
+/** Read the header of a REDUNDANT record: which fields it stores and where
+its array of field end offsets starts.
+@param[in]	rec		record origin
+@param[in]	layout		decode plan of the index
+@param[out]	plan		stored fields of a record with a row version,
+or nullptr if the record stores its first *n_stored fields
+@param[out]	n_stored	number of fields in the record
+@param[out]	one_byte	the end offsets take one byte each
+@return the byte just above the end offset of the first field */
+static const byte *rec_old_header(const rec_t *rec, const RecLayout &layout,
+                                  const RecVersionPlan **plan,
+                                  size_t *n_stored, bool *one_byte) {
+  const byte *ends = rec - REC_N_OLD_EXTRA_BYTES;
+  *plan = nullptr;
+  *n_stored = rec_get_n_fields_old_raw(rec);
+  *one_byte = rec_get_bit_field_1(rec, REC_OLD_SHORT, REC_OLD_SHORT_MASK,
+                                  REC_OLD_SHORT_SHIFT) != 0;
+  if (layout.is_instant &&
+      (rec_get_info_bits(rec, false) & REC_INFO_VERSION_FLAG)) {
+    const ulint version = *--ends;
+    if (version < layout.versions.size()) {
+      *plan = &layout.versions[version];
+    }
+  }
+  return ends;
+}
+
+/** rec_layout_get_offsets() for REDUNDANT records. The header has the end
+offset of every stored field, so a field is read from the array instead of
+being summed from lengths, and a NULL fixed-length field keeps its space. */
+static void rec_layout_get_offsets_old(const rec_t *rec,
+                                       const RecLayout &layout, ulint *offs,
+                                       size_t n_fields) {
+  const RecVersionPlan *plan;
+  size_t n_stored;
+  bool one_byte;
+  const byte *ends = rec_old_header(rec, layout, &plan, &n_stored, &one_byte);
+  ulint end = 0;
+  size_t k = 0;
+
+  for (size_t i = 0; i < n_fields; i++) {
+    if (plan != nullptr ? !plan->stored[i] : i >= n_stored) {
+      offs[i] = end | REC_OFFS_DEFAULT |
+                (layout.fields[i].has_default ? 0 : REC_OFFS_SQL_NULL);
+      continue;
+    }
+    if (one_byte) {
+      const ulint v = *(ends - 1 - k);
+      end = v & 0x7F;
+      offs[i] = (v & 0x80) ? (end | REC_OFFS_SQL_NULL) : end;
+    } else {
+      const ulint v = mach_read_from_2(ends - 2 - 2 * k);
+      end = v & 0x3FFF;
+      offs[i] = end | ((v & 0x8000) ? REC_OFFS_SQL_NULL : 0) |
+                ((v & 0x4000) ? REC_OFFS_EXTERNAL : 0);
+    }
+    k++;
+  }
+}
+
+/** Read the header of a record of a table with instant ADD/DROP COLUMNs:
+which fields the record stores and where its null bitmap starts.
+@param[in]	rec		record origin
+@param[in]	layout		decode plan of the index
+@param[out]	plan		stored fields, or nullptr if the record
+stores its first *n_stored fields (REC_INFO_INSTANT_FLAG)
+@param[out]	n_stored	number of leading fields stored
+@param[out]	n_nullable	size of the null bitmap in bits
+@return the byte of the null bitmap holding the first bit */
+static const byte *rec_instant_header(const rec_t *rec,
+                                      const RecLayout &layout,
+                                      const RecVersionPlan **plan,
+                                      size_t *n_stored,
+                                      uint32_t *n_nullable) {
+  const byte *nulls = rec - (REC_N_NEW_EXTRA_BYTES + 1);
+  const ulint info = rec_get_info_bits(rec, true);
+  *plan = &layout.base;
+  *n_stored = layout.fields.size();
+
+  if (info & REC_INFO_VERSION_FLAG) {
+    const ulint version = *nulls--;
+    if (version < layout.versions.size()) {
+      *plan = &layout.versions[version];
+    }
+  } else if (info & REC_INFO_INSTANT_FLAG) {
+    /* One byte, or two with the high bit set on the first */
+    size_t n = *nulls--;
+    if (n & 0x80) {
+      n = ((n & 0x7f) << 8) | *nulls--;
+    }
+    *plan = nullptr;
+    *n_stored = std::min(n, layout.fields.size());
+    *n_nullable = layout.n_nullable_before[*n_stored];
+    return nulls;
+  }
+  *n_nullable = (*plan)->n_nullable;
+  return nulls;
+}
+
+/** rec_layout_get_offsets() for the records of a table with instant
+ADD/DROP COLUMNs. */
+static void rec_layout_get_offsets_instant(const rec_t *rec,
+                                           const RecLayout &layout,
+                                           ulint *offs, size_t n_fields) {
+  const RecVersionPlan *plan;
+  size_t n_stored;
+  uint32_t n_nullable;
+  const byte *nulls =
+      rec_instant_header(rec, layout, &plan, &n_stored, &n_nullable);
+  const byte *lens = nulls - (n_nullable + 7) / 8;
+  ulint null_mask = 1;
+  ulint end = 0;
+
+  for (size_t i = 0; i < n_fields; i++) {
+    const RecFieldPlan &f = layout.fields[i];
+
+    if (plan != nullptr ? !plan->stored[i] : i >= n_stored) {
+      offs[i] = end | REC_OFFS_DEFAULT |
+                (f.has_default ? 0 : REC_OFFS_SQL_NULL);
+      continue;
+    }
+
+    if (f.nullable) {
+      if (!(byte)null_mask) {
+        nulls--;
+        null_mask = 1;
+      }
+      if (*nulls & null_mask) {
+        null_mask <<= 1;
+        offs[i] = end | REC_OFFS_SQL_NULL;
+        continue;
+      }
+      null_mask <<= 1;
+    }
+
+    if (f.fixed_len) {
+      end += f.fixed_len;
+      offs[i] = end;
+      continue;
+    }
+
+    ulint len = *lens--;
+    if (f.big && (len & 0x80)) {
+      len <<= 8;
+      len |= *lens--;
+      end += len & 0x3fff;
+      offs[i] = (len & 0x4000) ? (end | REC_OFFS_EXTERNAL) : end;
+      continue;
+    }
+    end += len;
+    offs[i] = end;
+  }
+}
+
+void rec_layout_get_offsets(const rec_t *rec, const RecLayout &layout,
+                            ulint *offs, size_t n_fields) {
+  if (!layout.is_compact) {
+    rec_layout_get_offsets_old(rec, layout, offs, n_fields);
+    return;
+  }
+  if (layout.is_instant) {
+    rec_layout_get_offsets_instant(rec, layout, offs, n_fields);
+    return;
+  }
+  const byte *nulls = rec - (REC_N_NEW_EXTRA_BYTES + 1);
+  const byte *lens = nulls - (layout.n_nullable + 7) / 8;
+  ulint null_mask = 1;
+  ulint end = 0;
+
+  for (size_t i = 0; i < n_fields; i++) {
+    const RecFieldPlan &f = layout.fields[i];
+
+    if (f.nullable) {
+      if (!(byte)null_mask) {
+        nulls--;
+        null_mask = 1;
+      }
+      if (*nulls & null_mask) {
+        null_mask <<= 1;
+        offs[i] = end | REC_OFFS_SQL_NULL;
+        continue;
+      }
+      null_mask <<= 1;
+    }
+
+    if (f.fixed_len) {
+      end += f.fixed_len;
+      offs[i] = end;
+      continue;
+    }
+
+    ulint len = *lens--;
+    if (f.big && (len & 0x80)) {
+      len <<= 8;
+      len |= *lens--;
+      end += len & 0x3fff;
+      offs[i] = (len & 0x4000) ? (end | REC_OFFS_EXTERNAL) : end;
+      continue;
+    }
+    end += len;
+    offs[i] = end;
+  }
+}
+
+ulint rec_layout_extra_size(const rec_t *rec, const RecLayout &layout) {
+  if (!layout.is_compact) {
+    const RecVersionPlan *plan;
+    size_t n_stored;
+    bool one_byte;
+    const byte *ends =
+        rec_old_header(rec, layout, &plan, &n_stored, &one_byte);
+    return (rec - ends) + n_stored * (one_byte ? 1 : 2);
+  }
+  const RecVersionPlan *plan = nullptr;
+  size_t n_stored = layout.fields.size();
+  uint32_t n_nullable = layout.n_nullable;
+  const byte *nulls = layout.is_instant
+                          ? rec_instant_header(rec, layout, &plan, &n_stored,
+                                               &n_nullable)
+                          : rec - (REC_N_NEW_EXTRA_BYTES + 1);
+  const byte *lens = nulls - (n_nullable + 7) / 8;
+  ulint null_mask = 1;
+
+  for (size_t i = 0; i < n_stored; i++) {
+    const RecFieldPlan &f = layout.fields[i];
+    if (plan != nullptr && !plan->stored[i]) {
+      continue;
+    }
+
+    if (f.nullable) {
+      if (!(byte)null_mask) {
+        nulls--;
+        null_mask = 1;
+      }
+      const bool is_null = *nulls & null_mask;
+      null_mask <<= 1;
+      if (is_null) {
+        continue;
+      }
+    }
+    if (f.fixed_len) {
+      continue;
+    }
+    if (f.big && (*lens & 0x80)) {
+      lens--;
+    }
+    lens--;
+  }
+  return rec - (lens + 1);
+}
+
+/** Read a big-endian unsigned integer of 1..8 bytes. */
+static uint64_t read_be(const byte *data, ulint len) {
+  uint64_t v = 0;
+  for (ulint i = 0; i < len; i++) {
+    v = (v << 8) | data[i];
+  }
+  return v;
+}
+
+int64_t rec_field_read_int(const ColumnDef &col, const byte *data, ulint len) {
+  uint64_t v = read_be(data, len);
+  if (col.is_unsigned || len == 0 || col.type == DD_TYPE_YEAR ||
+      col.type == DD_TYPE_ENUM || col.type == DD_TYPE_SET ||
+      col.type == DD_TYPE_BIT || rec_col_is_system(col)) {
+    return static_cast<int64_t>(v);
+  }
+  /* Signed integers are stored with the sign bit flipped so that they
+  compare as unsigned big-endian byte strings. */
+  uint32_t bits = static_cast<uint32_t>(len * 8);
+  v ^= 1ULL << (bits - 1);
+  if (bits < 64 && (v & (1ULL << (bits - 1)))) {
+    v |= ~0ULL << bits;
+  }
+  return static_cast<int64_t>(v);
+}
+
+double rec_field_read_double(const ColumnDef &col, const byte *data,
+                             ulint len) {
+  /* FLOAT and DOUBLE are stored in the little-endian machine format. */
+  if (col.type == DD_TYPE_FLOAT && len == sizeof(float)) {
+    float f;
+    memcpy(&f, data, sizeof(f));
+    return f;
+  }
+  double d = 0;
+  if (len == sizeof(double)) {
+    memcpy(&d, data, sizeof(d));
+  }
+  return d;
+}
+
+/** Days since 1970-01-01 of a proleptic Gregorian date. */
+static int64_t days_from_civil(int64_t y, uint32_t m, uint32_t d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const uint32_t yoe = static_cast<uint32_t>(y - era * 400);
+  const uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+/** Fractional seconds of a temporal column, in microseconds. */
+static uint32_t read_frac(const byte *data, uint32_t precision) {
+  switch ((precision + 1) / 2) {
+    case 1:
+      return static_cast<uint32_t>(read_be(data, 1)) * 10000;
+    case 2:
+      return static_cast<uint32_t>(read_be(data, 2)) * 100;
+    case 3:
+      return static_cast<uint32_t>(read_be(data, 3));
+    default:
+      return 0;
+  }
+}
+
+int32_t rec_field_read_date(const byte *data) {
+  uint32_t v = static_cast<uint32_t>(read_be(data, 3)) ^ 0x800000;
+  return static_cast<int32_t>(
+      days_from_civil(v >> 9, (v >> 5) & 15, v & 31));
+}
+
+int64_t rec_field_read_datetime(const ColumnDef &col, const byte *data) {
+  if (col.type == DD_TYPE_TIMESTAMP2) {
+    return static_cast<int64_t>(read_be(data, 4)) * 1000000 +
+           read_frac(data + 4, col.datetime_precision);
+  }
+  int64_t packed = static_cast<int64_t>(read_be(data, 5)) - 0x8000000000LL;
+  int64_t ymd = packed >> 17;
+  int64_t ym = ymd >> 5;
+  int64_t hms = packed % (1 << 17);
+  int64_t days = days_from_civil(ym / 13, ym % 13, ymd % 32);
+  int64_t secs = days * 86400 + (hms >> 12) * 3600 + ((hms >> 6) % 64) * 60 +
+                 hms % 64;
+  return secs * 1000000 + read_frac(data + 5, col.datetime_precision);
+}
+
+static void append_frac(uint32_t usec, uint32_t precision, std::string *out) {
+  if (precision == 0) {
+    return;
+  }
+  char buf[16];
+  snprintf(buf, sizeof(buf), ".%06u", usec);
+  out->append(buf, 1 + precision);
+}
+
+/** Append a packed DECIMAL value, see decimal2bin() in the server. */
+static void append_decimal(const ColumnDef &col, const byte *data,
+                           std::string *out) {
+  static const uint32_t dig2bytes[10] = {0, 1, 1, 2, 2, 3, 3, 4, 4, 4};
+  uint32_t scale = col.numeric_scale;
+  uint32_t intg = col.numeric_precision - scale;
+  uint32_t size = decimal_bin_size(col.numeric_precision, scale);
+
+  byte buf[64];
+  if (size > sizeof(buf) || size == 0) {
+    return;
+  }
+  memcpy(buf, data, size);
+  const bool negative = !(buf[0] & 0x80);
+  buf[0] ^= 0x80;
+  if (negative) {
+    for (uint32_t i = 0; i < size; i++) {
+      buf[i] = ~buf[i];
+    }
+  }
+
+  std::string digits;
+  const byte *p = buf;
+  char part[16];
+  uint32_t lead = dig2bytes[intg % 9];
+  if (lead) {
+    snprintf(part, sizeof(part), "%llu", (unsigned long long)read_be(p, lead));
+    digits += part;
+    p += lead;
+  }
+  for (uint32_t i = 0; i < intg / 9; i++) {
+    snprintf(part, sizeof(part), "%09llu", (unsigned long long)read_be(p, 4));
+    digits += part;
+    p += 4;
+  }
+  size_t nz = digits.find_first_not_of('0');
+  digits = nz == std::string::npos ? "0" : digits.substr(nz);
+
+  if (negative) {
+    out->push_back('-');
+  }
+  out->append(digits);
+  if (scale == 0) {
+    return;
+  }
+  out->push_back('.');
+  for (uint32_t i = 0; i < scale / 9; i++) {
+    snprintf(part, sizeof(part), "%09llu", (unsigned long long)read_be(p, 4));
+    out->append(part);
+    p += 4;
+  }
+  uint32_t trail = scale % 9;
+  if (trail) {
+    snprintf(part, sizeof(part), "%0*llu", (int)trail,
+             (unsigned long long)read_be(p, dig2bytes[trail]));
+    out->append(part);
+  }
+}
+
+static void append_hex_digits(const byte *data, ulint len, std::string *out) {
+  static const char hex[] = "0123456789ABCDEF";
+  for (ulint i = 0; i < len; i++) {
+    out->push_back(hex[data[i] >> 4]);
+    out->push_back(hex[data[i] & 15]);
+  }
+}
+
+static void append_hex(const byte *data, ulint len, std::string *out) {
+  out->append("0x");
+  append_hex_digits(data, len, out);
+}
+
+/** @return whether rec_field_to_string() writes a string column in hex */
+static bool rec_col_is_hex(const ColumnDef &col) {
+  return col.type == DD_TYPE_GEOMETRY || col.type == DD_TYPE_JSON ||
+         col.collation_id == 63;
+}
+
+void rec_field_to_string(const ColumnDef &col, const byte *data, ulint len,
+                         std::string *out) {
+  char buf[64];
+
+  if (rec_col_is_system(col)) {
+    snprintf(buf, sizeof(buf), "%llu",
+             (unsigned long long)read_be(data, len));
+    out->append(buf);
+    return;
+  }
+
+  switch (col.type) {
+    case DD_TYPE_TINY:
+    case DD_TYPE_SHORT:
+    case DD_TYPE_INT24:
+    case DD_TYPE_LONG:
+    case DD_TYPE_LONGLONG:
+    case DD_TYPE_ENUM:
+    case DD_TYPE_SET:
+    case DD_TYPE_BIT:
+      if (col.is_unsigned || col.type >= DD_TYPE_BIT) {
+        snprintf(buf, sizeof(buf), "%llu",
+                 (unsigned long long)rec_field_read_int(col, data, len));
+      } else {
+        snprintf(buf, sizeof(buf), "%lld",
+                 (long long)rec_field_read_int(col, data, len));
+      }
+      break;
+    case DD_TYPE_YEAR: {
+      uint32_t y = data[0];
+      snprintf(buf, sizeof(buf), "%04u", y ? y + 1900 : 0);
+      break;
+    }
+    case DD_TYPE_FLOAT:
+      snprintf(buf, sizeof(buf), "%g", rec_field_read_double(col, data, len));
+      break;
+    case DD_TYPE_DOUBLE:
+      snprintf(buf, sizeof(buf), "%.17g",
+               rec_field_read_double(col, data, len));
+      break;
+    case DD_TYPE_NEWDATE:
+    case DD_TYPE_DATE: {
+      uint32_t v = static_cast<uint32_t>(read_be(data, 3)) ^ 0x800000;
+      snprintf(buf, sizeof(buf), "%04u-%02u-%02u", v >> 9, (v >> 5) & 15,
+               v & 31);
+      break;
+    }
+    case DD_TYPE_DATETIME2: {
+      int64_t packed = static_cast<int64_t>(read_be(data, 5)) - 0x8000000000LL;
+      int64_t ymd = packed >> 17;
+      int64_t ym = ymd >> 5;
+      int64_t hms = packed % (1 << 17);
+      snprintf(buf, sizeof(buf), "%04lld-%02lld-%02lld %02lld:%02lld:%02lld",
+               (long long)(ym / 13), (long long)(ym % 13),
+               (long long)(ymd % 32), (long long)(hms >> 12),
+               (long long)((hms >> 6) % 64), (long long)(hms % 64));
+      out->append(buf);
+      append_frac(read_frac(data + 5, col.datetime_precision),
+                  col.datetime_precision, out);
+      return;
+    }
+    case DD_TYPE_TIMESTAMP2: {
+      time_t secs = static_cast<time_t>(read_be(data, 4));
+      struct tm tm;
+      gmtime_r(&secs, &tm);
+      strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+      out->append(buf);
+      append_frac(read_frac(data + 4, col.datetime_precision),
+                  col.datetime_precision, out);
+      return;
+    }
+    case DD_TYPE_TIME2: {
+      int64_t v = static_cast<int64_t>(read_be(data, 3)) - 0x800000;
+      const char *sign = v < 0 ? "-" : "";
+      if (v < 0) {
+        v = -v;
+      }
+      snprintf(buf, sizeof(buf), "%s%02lld:%02lld:%02lld", sign,
+               (long long)((v >> 12) % 1024), (long long)((v >> 6) % 64),
+               (long long)(v % 64));
+      out->append(buf);
+      append_frac(read_frac(data + 3, col.datetime_precision),
+                  col.datetime_precision, out);
+      return;
+    }
+    case DD_TYPE_TIMESTAMP:
+      snprintf(buf, sizeof(buf), "%llu", (unsigned long long)read_be(data, 4));
+      break;
+    case DD_TYPE_DATETIME:
+    case DD_TYPE_TIME:
+      snprintf(buf, sizeof(buf), "%lld",
+               (long long)rec_field_read_int(col, data, len));
+      break;
+    case DD_TYPE_NEWDECIMAL:
+      append_decimal(col, data, out);
+      return;
+    case DD_TYPE_GEOMETRY:
+    case DD_TYPE_JSON:
+      append_hex(data, len, out);
+      return;
+    default:
+      /* CHAR, VARCHAR, TEXT and BLOB */
+      if (col.collation_id == 63) {
+        append_hex(data, len, out);
+      } else {
+        if (col.type == DD_TYPE_STRING) {
+          /* CHAR values are stored padded with spaces */
+          while (len > 0 && data[len - 1] == ' ') {
+            len--;
+          }
+        }
+        out->append(reinterpret_cast<const char *>(data), len);
+      }
+      return;
+  }
+  out->append(buf);
+}
+
+RecFieldStream::RecFieldStream(const ColumnDef &col)
+    : hex_(rec_col_is_hex(col)),
+      trim_(!hex_ && col.type == DD_TYPE_STRING),
+      started_(false),
+      n_spaces_(0) {}
+
+void RecFieldStream::Append(const byte *part, ulint len, std::string *out) {
+  if (hex_) {
+    if (!started_) {
+      out->append("0x");
+    }
+    started_ = true;
+    append_hex_digits(part, len, out);
+    return;
+  }
+  started_ = true;
+  ulint end = len;
+  if (trim_) {
+    while (end > 0 && part[end - 1] == ' ') {
+      end--;
+    }
+    if (end == 0) {
+      n_spaces_ += len;
+      return;
+    }
+    out->append(n_spaces_, ' ');
+    n_spaces_ = len - end;
+  }
+  out->append(reinterpret_cast<const char *>(part), end);
+}
@@ -0,0 +1,1225 @@
+#include "include/redo_apply.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "include/dblwr.h"
+#include "include/fil0fil.h"
+#include "include/fil0types.h"
+#include "include/index_scan.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+#include "include/page_crc32.h"
+#include "include/rec.h"
+#include "include/rec_decoder.h"
+#include "include/rem0types.h"
+#include "include/undo_decoder.h"
+
+/** Where the data of a field of a record is. */
+struct RedoRecField {
+  /** Offset of the data in the page */
+  uint32_t offset;
+  /** Bytes of the data: of an SQL NULL of a redundant record, the bytes
+  it reserves */
+  uint32_t len;
+  bool null;
+};
+
+/** @return whether a record offset leaves room for the header of a record
+before it and its origin on the page */
+static bool redo_rec_offset_ok(uint32_t offset, uint32_t extra) {
+  return offset >= PAGE_DATA + extra &&
+         offset < UNIV_PAGE_SIZE - FIL_PAGE_DATA_END;
+}
+
+/** Locate the fields of a record, the way rec_get_offsets() does: from the
+field end offsets of a redundant record, or from the null flags and the
+lengths of a compact record with the fields of the index logged. The
+infimum and supremum of a compact page have one field of 8 bytes, a node
+pointer the unique fields and the child page number.
+@param[in]	page	page
+@param[in]	offset	offset of the record origin
+@param[in]	index	index logged with the change of the record
+@param[out]	fields	the fields
+@param[out]	extra	bytes of the header of the record
+@return 0, 1 if the record is a compact record of an instant index, -1 if
+it does not fit the page */
+static int redo_rec_fields(const byte *page, uint32_t offset,
+                           const RedoIndex &index,
+                           std::vector<RedoRecField> *fields,
+                           uint32_t *extra) {
+  fields->clear();
+  const byte *rec = page + offset;
+  const uint32_t data_end = UNIV_PAGE_SIZE - FIL_PAGE_DATA_END;
+  if (!page_is_comp(page)) {
+    if (!redo_rec_offset_ok(offset, REC_N_OLD_EXTRA_BYTES)) {
+      return -1;
+    }
+    const uint32_t n = rec_get_n_fields_old_raw(rec);
+    const bool one_byte =
+        rec_get_bit_field_1(rec, REC_OLD_SHORT, REC_OLD_SHORT_MASK,
+                            REC_OLD_SHORT_SHIFT) != 0;
+    *extra = REC_N_OLD_EXTRA_BYTES + n * (one_byte ? 1 : 2);
+    if (n == 0 || PAGE_DATA + *extra > offset) {
+      return -1;
+    }
+    uint32_t start = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t end;
+      bool null;
+      if (one_byte) {
+        const uint32_t b =
+            mach_read_from_1(rec - (REC_N_OLD_EXTRA_BYTES + i + 1));
+        end = b & ~REC_1BYTE_SQL_NULL_MASK;
+        null = (b & REC_1BYTE_SQL_NULL_MASK) != 0;
+      } else {
+        const uint32_t b =
+            mach_read_from_2(rec - (REC_N_OLD_EXTRA_BYTES + 2 * i + 2));
+        end = b & ~(REC_2BYTE_SQL_NULL_MASK | REC_2BYTE_EXTERN_MASK);
+        null = (b & REC_2BYTE_SQL_NULL_MASK) != 0;
+      }
+      if (end < start || offset + end > data_end) {
+        return -1;
+      }
+      RedoRecField field = {offset + start, end - start, null};
+      fields->push_back(field);
+      start = end;
+    }
+    return 0;
+  }
+
+  if (!redo_rec_offset_ok(offset, REC_N_NEW_EXTRA_BYTES)) {
+    return -1;
+  }
+  const uint32_t status = rec_get_status(rec);
+  if (status == REC_STATUS_INFIMUM || status == REC_STATUS_SUPREMUM) {
+    RedoRecField field = {offset, 8, false};
+    fields->push_back(field);
+    *extra = REC_N_NEW_EXTRA_BYTES;
+    return 0;
+  }
+  if (!index.comp || index.instant ||
+      (rec_get_info_bits(rec, true) &
+       (REC_INFO_INSTANT_FLAG | REC_INFO_VERSION_FLAG))) {
+    return 1;
+  }
+  const bool node_ptr = status == REC_STATUS_NODE_PTR;
+  const uint32_t n = node_ptr ? index.n_uniq : index.n_fields;
+  if (status != REC_STATUS_ORDINARY && !node_ptr) {
+    return -1;
+  }
+  if (n == 0 || n > index.n_fields) {
+    return -1;
+  }
+  uint32_t n_nullable = 0;
+  for (uint16_t len : index.field_lens) {
+    n_nullable += !(len & 0x8000);
+  }
+  /* The null flags and the lengths are read backwards from the header */
+  int64_t nulls = offset - REC_N_NEW_EXTRA_BYTES - 1;
+  int64_t lens = nulls - (n_nullable + 7) / 8;
+  uint32_t null_mask = 1;
+  uint32_t start = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    const uint32_t field_len = index.field_lens[i];
+    if (!(field_len & 0x8000)) {
+      if (nulls < PAGE_DATA) {
+        return -1;
+      }
+      const bool null = (page[nulls] & null_mask) != 0;
+      null_mask <<= 1;
+      if (null_mask == 0x100) {
+        nulls--;
+        null_mask = 1;
+      }
+      if (null) {
+        RedoRecField field = {offset + start, 0, true};
+        fields->push_back(field);
+        continue;
+      }
+    }
+    const uint32_t fixed_len = field_len & 0x7FFF;
+    uint32_t len = fixed_len;
+    if (fixed_len == 0 || fixed_len == 0x7FFF) {
+      if (lens < PAGE_DATA) {
+        return -1;
+      }
+      len = page[lens--];
+      /* A field longer than 255 bytes may have a two byte length */
+      if (fixed_len == 0x7FFF && (len & 0x80)) {
+        if (lens < PAGE_DATA) {
+          return -1;
+        }
+        len = (len << 8 | page[lens--]) & 0x3FFF;
+      }
+    }
+    if (offset + start + len > data_end) {
+      return -1;
+    }
+    RedoRecField field = {offset + start, len, false};
+    fields->push_back(field);
+    start += len;
+  }
+  if (node_ptr) {
+    if (offset + start + REC_NODE_PTR_SIZE > data_end) {
+      return -1;
+    }
+    RedoRecField field = {offset + start, REC_NODE_PTR_SIZE, false};
+    fields->push_back(field);
+  }
+  if (lens + 1 < PAGE_DATA) {
+    return -1;
+  }
+  *extra = offset - (lens + 1);
+  return 0;
+}
+
+/** Get the bytes of a record, rec_offs_size(), and of its header,
+rec_offs_extra_size().
+@return 0, 1 or -1 as redo_rec_fields() */
+static int redo_rec_size(const byte *page, uint32_t offset,
+                         const RedoIndex &index, uint32_t *extra,
+                         uint32_t *size) {
+  std::vector<RedoRecField> fields;
+  const int ret = redo_rec_fields(page, offset, index, &fields, extra);
+  if (ret != 0) {
+    return ret;
+  }
+  const RedoRecField &last = fields.back();
+  *size = *extra + last.offset + last.len - offset;
+  return 0;
+}
+
+/** Set the info bits of a record. */
+static void redo_rec_set_info_bits(byte *rec, bool comp, uint32_t bits) {
+  byte *b = rec - (comp ? REC_NEW_INFO_BITS : REC_OLD_INFO_BITS);
+  *b = (*b & ~REC_INFO_BITS_MASK) | (bits & REC_INFO_BITS_MASK);
+}
+
+/** Set or clear the delete mark of a record, btr_rec_set_deleted_flag(). */
+static void redo_rec_set_deleted(byte *rec, bool comp, bool deleted) {
+  const uint32_t bits = rec_get_info_bits(rec, comp);
+  redo_rec_set_info_bits(rec, comp,
+                         deleted ? bits | REC_INFO_DELETED_FLAG
+                                 : bits & ~REC_INFO_DELETED_FLAG);
+}
+
+/** Write the transaction id and roll pointer of a clustered index record,
+row_upd_rec_sys_fields_in_recovery().
+@return 0, or -1 if the record has no such fields at pos */
+static int redo_rec_set_sys_fields(byte *page,
+                                   const std::vector<RedoRecField> &fields,
+                                   uint32_t pos, uint64_t trx_id,
+                                   const byte *roll_ptr) {
+  if (pos + 1 >= fields.size() || fields[pos].null ||
+      fields[pos].len != DATA_TRX_ID_LEN ||
+      fields[pos + 1].len != DATA_ROLL_PTR_LEN) {
+    return -1;
+  }
+  mach_write_to_6(page + fields[pos].offset, trx_id);
+  memcpy(page + fields[pos + 1].offset, roll_ptr, DATA_ROLL_PTR_LEN);
+  return 0;
+}
+
+/** Set the null flag of a field of a redundant record. */
+static void redo_rec_set_null_old(byte *rec, uint32_t i, bool null) {
+  if (rec_get_bit_field_1(rec, REC_OLD_SHORT, REC_OLD_SHORT_MASK,
+                          REC_OLD_SHORT_SHIFT)) {
+    byte *b = rec - (REC_N_OLD_EXTRA_BYTES + i + 1);
+    *b = null ? *b | REC_1BYTE_SQL_NULL_MASK : *b & ~REC_1BYTE_SQL_NULL_MASK;
+  } else {
+    byte *b = rec - (REC_N_OLD_EXTRA_BYTES + 2 * i + 2);
+    const uint32_t v = mach_read_from_2(b);
+    mach_write_to_2(b, null ? v | REC_2BYTE_SQL_NULL_MASK
+                            : v & ~REC_2BYTE_SQL_NULL_MASK);
+  }
+}
+
+/** Apply an update in place of a record: its info bits, then each field
+of the update vector, of the same length as before, row_upd_rec_in_place().
+@return 0, 1 if a field changes its length, -1 if the vector does not fit
+the record */
+static int redo_rec_update_in_place(byte *page, uint32_t offset,
+                                    const std::vector<RedoRecField> &fields,
+                                    const byte *ptr, const byte *end) {
+  if (ptr == end) {
+    return -1;
+  }
+  const bool comp = page_is_comp(page);
+  byte *rec = page + offset;
+  redo_rec_set_info_bits(rec, comp, mach_read_from_1(ptr++));
+  const uint32_t n_fields = mach_parse_compressed(&ptr, end);
+  for (uint32_t i = 0; i < n_fields && ptr != nullptr; i++) {
+    const uint32_t field_no = mach_parse_compressed(&ptr, end);
+    if (ptr == nullptr) {
+      break;
+    }
+    const uint32_t len = mach_parse_compressed(&ptr, end);
+    if (ptr == nullptr) {
+      break;
+    }
+    const uint32_t data_len = len == UNIV_SQL_NULL ? 0 : len;
+    if ((size_t)(end - ptr) < data_len) {
+      return -1;
+    }
+    /* Virtual columns are not stored in the record */
+    if (field_no >= REC_MAX_N_FIELDS) {
+      ptr += data_len;
+      continue;
+    }
+    /* A field added by instant ADD COLUMN after the record was written */
+    if (field_no >= fields.size()) {
+      return 1;
+    }
+    const RedoRecField &field = fields[field_no];
+    if (len == UNIV_SQL_NULL) {
+      if (!field.null) {
+        /* Only a redundant record keeps the bytes of a NULL */
+        if (comp) {
+          return 1;
+        }
+        redo_rec_set_null_old(rec, field_no, true);
+        memset(page + field.offset, 0, field.len);
+      }
+      continue;
+    }
+    if (field.null) {
+      if (comp || len != field.len) {
+        return 1;
+      }
+      redo_rec_set_null_old(rec, field_no, false);
+    } else if (len != field.len) {
+      return 1;
+    }
+    memcpy(page + field.offset, ptr, len);
+    ptr += len;
+  }
+  return ptr == nullptr ? -1 : 0;
+}
+
+/** @return a field of the page header */
+static uint32_t redo_page_get(const byte *page, uint32_t field) {
+  return mach_read_from_2(page + PAGE_HEADER + field);
+}
+
+/** Set a field of the page header. */
+static void redo_page_set(byte *page, uint32_t field, uint32_t val) {
+  mach_write_to_2(page + PAGE_HEADER + field, val);
+}
+
+/** @return the nth slot of the page directory, slot 0 at the page end */
+static byte *redo_dir_slot(byte *page, uint32_t n) {
+  return page + UNIV_PAGE_SIZE - PAGE_DIR - (n + 1) * PAGE_DIR_SLOT_SIZE;
+}
+
+/** @return offset of the record of the nth slot of the page directory */
+static uint32_t redo_dir_slot_rec(byte *page, uint32_t n) {
+  return mach_read_from_2(redo_dir_slot(page, n));
+}
+
+/** @return offset of the next record, rec_get_next_offs(): relative to the
+record on a compact page; 0 after the supremum and at the end of the free
+list */
+static uint32_t redo_rec_get_next(const byte *page, uint32_t offset,
+                                  bool comp) {
+  const uint32_t next = mach_read_from_2(page + offset - REC_NEXT);
+  if (!comp || next == 0) {
+    return next;
+  }
+  return (offset + next) & (UNIV_PAGE_SIZE - 1);
+}
+
+/** Set the offset of the next record, 0 for none. */
+static void redo_rec_set_next(byte *page, uint32_t offset, uint32_t next,
+                              bool comp) {
+  mach_write_to_2(page + offset - REC_NEXT,
+                  comp && next != 0 ? (next - offset) & REC_NEXT_MASK : next);
+}
+
+/** @return the records owned by a record, 0 unless it is in a slot */
+static uint32_t redo_rec_get_n_owned(const byte *page, uint32_t offset,
+                                     bool comp) {
+  return page[offset - (comp ? REC_NEW_N_OWNED : REC_OLD_N_OWNED)] &
+         REC_N_OWNED_MASK;
+}
+
+/** Set the records owned by a record. */
+static void redo_rec_set_n_owned(byte *page, uint32_t offset, bool comp,
+                                 uint32_t n_owned) {
+  byte *b = page + offset - (comp ? REC_NEW_N_OWNED : REC_OLD_N_OWNED);
+  *b = (*b & ~REC_N_OWNED_MASK) | n_owned;
+}
+
+/** @return the heap number of a record, its order of creation */
+static uint32_t redo_rec_get_heap_no(const byte *page, uint32_t offset,
+                                     bool comp) {
+  return (mach_read_from_2(page + offset -
+                           (comp ? REC_NEW_HEAP_NO : REC_OLD_HEAP_NO)) &
+          REC_HEAP_NO_MASK) >>
+         REC_HEAP_NO_SHIFT;
+}
+
+/** Set the heap number of a record. */
+static void redo_rec_set_heap_no(byte *page, uint32_t offset, bool comp,
+                                 uint32_t heap_no) {
+  byte *b = page + offset - (comp ? REC_NEW_HEAP_NO : REC_OLD_HEAP_NO);
+  mach_write_to_2(b, (mach_read_from_2(b) & ~REC_HEAP_NO_MASK) |
+                         heap_no << REC_HEAP_NO_SHIFT);
+}
+
+/** @return whether the directory of a page holds at least the infimum and
+the supremum slots and stays above the heap */
+static bool redo_dir_ok(const byte *page) {
+  const uint32_t n_slots = redo_page_get(page, PAGE_N_DIR_SLOTS);
+  return n_slots >= 2 &&
+         n_slots * PAGE_DIR_SLOT_SIZE <=
+             UNIV_PAGE_SIZE - PAGE_DIR - redo_page_get(page, PAGE_HEAP_TOP);
+}
+
+/** Find the record owning a record, page_rec_find_owner_rec(): the first
+one from it on with records owned.
+@return its offset, 0 if the list or the owned counts are corrupt */
+static uint32_t redo_rec_find_owner(const byte *page, uint32_t offset,
+                                    bool comp) {
+  const uint32_t extra = comp ? REC_N_NEW_EXTRA_BYTES : REC_N_OLD_EXTRA_BYTES;
+  for (uint32_t i = 0; redo_rec_get_n_owned(page, offset, comp) == 0; i++) {
+    offset = redo_rec_get_next(page, offset, comp);
+    if (i == PAGE_DIR_SLOT_MAX_N_OWNED || !redo_rec_offset_ok(offset, extra)) {
+      return 0;
+    }
+  }
+  return offset;
+}
+
+/** Find the slot of the directory pointing to a record.
+@return the slot number, -1 if none does */
+static int redo_dir_find_slot(byte *page, uint32_t offset) {
+  const uint32_t n_slots = redo_page_get(page, PAGE_N_DIR_SLOTS);
+  for (uint32_t i = 0; i < n_slots; i++) {
+    if (redo_dir_slot_rec(page, i) == offset) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/** Split a slot owning too many records in two, page_dir_split_slot(): a
+slot added below it gets the lower half of its records.
+@return 0, or -1 if the slot or its list is corrupt */
+static int redo_dir_split_slot(byte *page, bool comp, uint32_t slot_no) {
+  const uint32_t extra = comp ? REC_N_NEW_EXTRA_BYTES : REC_N_OLD_EXTRA_BYTES;
+  const uint32_t n_slots = redo_page_get(page, PAGE_N_DIR_SLOTS);
+  if (slot_no == 0 || slot_no >= n_slots ||
+      redo_dir_slot(page, n_slots) <
+          page + redo_page_get(page, PAGE_HEAP_TOP)) {
+    return -1;
+  }
+  const uint32_t n_owned =
+      redo_rec_get_n_owned(page, redo_dir_slot_rec(page, slot_no), comp);
+  uint32_t rec = redo_dir_slot_rec(page, slot_no - 1);
+  for (uint32_t i = 0; i < n_owned / 2; i++) {
+    rec = redo_rec_get_next(page, rec, comp);
+    if (!redo_rec_offset_ok(rec, extra)) {
+      return -1;
+    }
+  }
+  /* page_dir_add_slot(): the slots from slot_no up move down by one */
+  byte *last = redo_dir_slot(page, n_slots);
+  memmove(last, last + PAGE_DIR_SLOT_SIZE,
+          (n_slots - slot_no) * PAGE_DIR_SLOT_SIZE);
+  redo_page_set(page, PAGE_N_DIR_SLOTS, n_slots + 1);
+  mach_write_to_2(redo_dir_slot(page, slot_no), rec);
+  redo_rec_set_n_owned(page, rec, comp, n_owned / 2);
+  redo_rec_set_n_owned(page, redo_dir_slot_rec(page, slot_no + 1), comp,
+                       n_owned - n_owned / 2);
+  return 0;
+}
+
+/** Balance a slot owning too few records with the slot above it,
+page_dir_balance_slot(): take a record of the upper slot if it can spare
+one, else merge the two, page_dir_delete_slot().
+@return 0, or -1 if the slot is corrupt */
+static int redo_dir_balance_slot(byte *page, bool comp, uint32_t slot_no) {
+  const uint32_t n_slots = redo_page_get(page, PAGE_N_DIR_SLOTS);
+  /* The supremum slot has no upper neighbour */
+  if (slot_no + 1 == n_slots) {
+    return 0;
+  }
+  if (slot_no == 0 || slot_no >= n_slots) {
+    return -1;
+  }
+  const uint32_t rec = redo_dir_slot_rec(page, slot_no);
+  const uint32_t up_rec = redo_dir_slot_rec(page, slot_no + 1);
+  const uint32_t n_owned = redo_rec_get_n_owned(page, rec, comp);
+  const uint32_t up_n_owned = redo_rec_get_n_owned(page, up_rec, comp);
+  if (up_n_owned > PAGE_DIR_SLOT_MIN_N_OWNED) {
+    const uint32_t new_rec = redo_rec_get_next(page, rec, comp);
+    if (!redo_rec_offset_ok(new_rec, comp ? REC_N_NEW_EXTRA_BYTES
+                                          : REC_N_OLD_EXTRA_BYTES)) {
+      return -1;
+    }
+    redo_rec_set_n_owned(page, rec, comp, 0);
+    redo_rec_set_n_owned(page, new_rec, comp, n_owned + 1);
+    mach_write_to_2(redo_dir_slot(page, slot_no), new_rec);
+    redo_rec_set_n_owned(page, up_rec, comp, up_n_owned - 1);
+    return 0;
+  }
+  redo_rec_set_n_owned(page, rec, comp, 0);
+  redo_rec_set_n_owned(page, up_rec, comp, n_owned + up_n_owned);
+  for (uint32_t i = slot_no + 1; i < n_slots; i++) {
+    mach_write_to_2(redo_dir_slot(page, i - 1), redo_dir_slot_rec(page, i));
+  }
+  mach_write_to_2(redo_dir_slot(page, n_slots - 1), 0);
+  redo_page_set(page, PAGE_N_DIR_SLOTS, n_slots - 1);
+  return 0;
+}
+
+/** The infimum and supremum records of a new page, with their headers */
+static const byte redo_infimum_supremum_compact[] = {
+    0x01, 0x00, 0x02, 0x00, 0x0d, 'i', 'n', 'f', 'i', 'm', 'u', 'm', 0,
+    0x01, 0x00, 0x0b, 0x00, 0x00, 's', 'u', 'p', 'r', 'e', 'm', 'u', 'm'};
+static const byte redo_infimum_supremum_redundant[] = {
+    0x08, 0x01, 0x00, 0x00, 0x03, 0x00, 0x74, 'i', 'n', 'f', 'i', 'm',
+    'u',  'm',  0,    0x09, 0x01, 0x00, 0x08, 0x03, 0x00, 0x00, 's', 'u',
+    'p',  'r',  'e',  'm',  'u',  'm',  0};
+
+/** Make a page an empty index page, page_create_low(). Its level and index
+id are logged apart. */
+static void redo_page_create(byte *page, bool comp, uint32_t page_type) {
+  mach_write_to_2(page + FIL_PAGE_TYPE, page_type);
+  memset(page + PAGE_HEADER, 0, PAGE_HEADER_PRIV_END);
+  redo_page_set(page, PAGE_N_DIR_SLOTS, 2);
+  redo_page_set(page, PAGE_DIRECTION, PAGE_NO_DIRECTION);
+  redo_page_set(page, PAGE_N_HEAP,
+                (comp ? PAGE_IS_COMPACT : 0) | PAGE_HEAP_NO_USER_LOW);
+  const uint32_t supremum_end =
+      comp ? PAGE_NEW_SUPREMUM_END : PAGE_OLD_SUPREMUM_END;
+  redo_page_set(page, PAGE_HEAP_TOP, supremum_end);
+  if (comp) {
+    memcpy(page + PAGE_DATA, redo_infimum_supremum_compact,
+           sizeof redo_infimum_supremum_compact);
+  } else {
+    memcpy(page + PAGE_DATA, redo_infimum_supremum_redundant,
+           sizeof redo_infimum_supremum_redundant);
+  }
+  memset(page + supremum_end, 0, UNIV_PAGE_SIZE - PAGE_DIR - supremum_end);
+  mach_write_to_2(redo_dir_slot(page, 0),
+                  comp ? PAGE_NEW_INFIMUM : PAGE_OLD_INFIMUM);
+  mach_write_to_2(redo_dir_slot(page, 1),
+                  comp ? PAGE_NEW_SUPREMUM : PAGE_OLD_SUPREMUM);
+}
+
+/** Insert a record after another, page_cur_insert_rec_low(): its space is
+taken from the head of the free list if the record there is big enough,
+else from the top of the heap.
+@param[in,out]	page	index page
+@param[in]	index	index logged with the insert
+@param[in]	cursor	offset of the record to insert after
+@param[in]	rec	the record, from the start of its header
+@param[in]	extra	bytes of the header of the record
+@param[in]	size	bytes of the record
+@return 0, 1 if a record is of an instant index, -1 if the record does
+not fit the page */
+static int redo_page_insert(byte *page, const RedoIndex &index,
+                            uint32_t cursor, const byte *rec, uint32_t extra,
+                            uint32_t size) {
+  const bool comp = page_is_comp(page);
+  const uint32_t data_end = UNIV_PAGE_SIZE - FIL_PAGE_DATA_END;
+  if (!redo_dir_ok(page) ||
+      cursor == (comp ? PAGE_NEW_SUPREMUM : PAGE_OLD_SUPREMUM)) {
+    return -1;
+  }
+  const uint32_t next = redo_rec_get_next(page, cursor, comp);
+  if (!redo_rec_offset_ok(next, comp ? REC_N_NEW_EXTRA_BYTES
+                                     : REC_N_OLD_EXTRA_BYTES)) {
+    return -1;
+  }
+
+  uint32_t start;
+  uint32_t heap_no;
+  const uint32_t free_rec = redo_page_get(page, PAGE_FREE);
+  uint32_t free_extra = 0;
+  uint32_t free_size = 0;
+  if (free_rec != 0) {
+    const int ret = redo_rec_size(page, free_rec, index, &free_extra,
+                                  &free_size);
+    if (ret != 0) {
+      return ret;
+    }
+  }
+  if (free_rec != 0 && free_size >= size) {
+    /* page_mem_alloc_free() */
+    start = free_rec - free_extra;
+    heap_no = redo_rec_get_heap_no(page, free_rec, comp);
+    redo_page_set(page, PAGE_FREE, redo_rec_get_next(page, free_rec, comp));
+    const uint32_t garbage = redo_page_get(page, PAGE_GARBAGE);
+    if (garbage < size) {
+      return -1;
+    }
+    redo_page_set(page, PAGE_GARBAGE, garbage - size);
+  } else {
+    /* page_mem_alloc_heap(), with the room page_get_max_insert_size()
+    leaves for the record and a share of a directory slot */
+    const uint32_t heap_top = redo_page_get(page, PAGE_HEAP_TOP);
+    const uint32_t n_heap = redo_page_get(page, PAGE_N_HEAP) & 0x7FFF;
+    const uint32_t supremum_end =
+        comp ? PAGE_NEW_SUPREMUM_END : PAGE_OLD_SUPREMUM_END;
+    const uint32_t occupied = heap_top - supremum_end +
+                              (PAGE_DIR_SLOT_SIZE * (n_heap - 1) +
+                               PAGE_DIR_SLOT_MIN_N_OWNED - 1) /
+                                  PAGE_DIR_SLOT_MIN_N_OWNED;
+    const uint32_t free_space =
+        UNIV_PAGE_SIZE - supremum_end - PAGE_DIR - 2 * PAGE_DIR_SLOT_SIZE;
+    if (heap_top < supremum_end || occupied > free_space ||
+        free_space - occupied < size) {
+      return -1;
+    }
+    start = heap_top;
+    heap_no = n_heap;
+    redo_page_set(page, PAGE_HEAP_TOP, heap_top + size);
+    redo_page_set(page, PAGE_N_HEAP,
+                  (comp ? PAGE_IS_COMPACT : 0) | (n_heap + 1));
+  }
+  const uint32_t offset = start + extra;
+  if (start < PAGE_DATA || start + size > data_end) {
+    return -1;
+  }
+  memcpy(page + start, rec, size);
+  uint32_t rec_extra;
+  uint32_t rec_size;
+  const int ret = redo_rec_size(page, offset, index, &rec_extra, &rec_size);
+  if (ret != 0) {
+    return ret;
+  }
+  if (rec_extra != extra || rec_size != size) {
+    return -1;
+  }
+
+  redo_rec_set_next(page, offset, next, comp);
+  redo_rec_set_next(page, cursor, offset, comp);
+  redo_page_set(page, PAGE_N_RECS, redo_page_get(page, PAGE_N_RECS) + 1);
+  redo_rec_set_n_owned(page, offset, comp, 0);
+  redo_rec_set_heap_no(page, offset, comp, heap_no);
+
+  /* The direction of the inserts, kept by the server for the page splits
+  of a B-tree but not of an R-tree */
+  const uint32_t last_insert = redo_page_get(page, PAGE_LAST_INSERT);
+  if (mach_read_from_2(page + FIL_PAGE_TYPE) != FIL_PAGE_RTREE) {
+    uint32_t n_direction = redo_page_get(page, PAGE_N_DIRECTION) + 1;
+    uint32_t direction = redo_page_get(page, PAGE_DIRECTION);
+    if (last_insert != 0 && last_insert == cursor && direction != PAGE_LEFT) {
+      direction = PAGE_RIGHT;
+    } else if (last_insert != 0 && last_insert == next &&
+               direction != PAGE_RIGHT) {
+      direction = PAGE_LEFT;
+    } else {
+      direction = PAGE_NO_DIRECTION;
+      n_direction = 0;
+    }
+    redo_page_set(page, PAGE_DIRECTION, direction);
+    redo_page_set(page, PAGE_N_DIRECTION, n_direction);
+  }
+  redo_page_set(page, PAGE_LAST_INSERT, offset);
+
+  const uint32_t owner = redo_rec_find_owner(page, offset, comp);
+  if (owner == 0) {
+    return -1;
+  }
+  const uint32_t n_owned = redo_rec_get_n_owned(page, owner, comp);
+  redo_rec_set_n_owned(page, owner, comp, n_owned + 1);
+  if (n_owned == PAGE_DIR_SLOT_MAX_N_OWNED) {
+    const int slot_no = redo_dir_find_slot(page, owner);
+    if (slot_no < 0 || redo_dir_split_slot(page, comp, slot_no) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/** Delete a record, page_cur_delete_rec(): unlink it, put it at the head
+of the free list and balance its slot if it owns too few records.
+@return 0, 1 if the record is of an instant index, -1 if it is not a user
+record of the page */
+static int redo_page_delete(byte *page, const RedoIndex &index,
+                            uint32_t offset) {
+  const bool comp = page_is_comp(page);
+  if (!redo_dir_ok(page)) {
+    return -1;
+  }
+  uint32_t extra;
+  uint32_t size;
+  const int ret = redo_rec_size(page, offset, index, &extra, &size);
+  if (ret != 0) {
+    return ret;
+  }
+  const uint32_t owner = redo_rec_find_owner(page, offset, comp);
+  const int slot_no = owner == 0 ? -1 : redo_dir_find_slot(page, owner);
+  /* Neither the infimum nor the supremum can be deleted */
+  if (slot_no <= 0 ||
+      offset == (comp ? PAGE_NEW_SUPREMUM : PAGE_OLD_SUPREMUM)) {
+    return -1;
+  }
+  const uint32_t n_owned = redo_rec_get_n_owned(page, owner, comp);
+  redo_page_set(page, PAGE_LAST_INSERT, 0);
+
+  /* The record before, from the record of the slot below */
+  uint32_t prev = redo_dir_slot_rec(page, slot_no - 1);
+  for (uint32_t i = 0;; i++) {
+    const uint32_t next = redo_rec_get_next(page, prev, comp);
+    if (next == offset) {
+      break;
+    }
+    if (i == PAGE_DIR_SLOT_MAX_N_OWNED || next == 0) {
+      return -1;
+    }
+    prev = next;
+  }
+  /* A slot owning the record alone would be left pointing to the record of
+  the slot below */
+  if (owner == offset && prev == redo_dir_slot_rec(page, slot_no - 1)) {
+    return -1;
+  }
+  redo_rec_set_next(page, prev, redo_rec_get_next(page, offset, comp), comp);
+  if (owner == offset) {
+    mach_write_to_2(redo_dir_slot(page, slot_no), prev);
+  }
+  redo_rec_set_n_owned(page, owner == offset ? prev : owner, comp,
+                       n_owned - 1);
+
+  /* page_mem_free() */
+  redo_rec_set_next(page, offset, redo_page_get(page, PAGE_FREE), comp);
+  redo_page_set(page, PAGE_FREE, offset);
+  redo_page_set(page, PAGE_GARBAGE, redo_page_get(page, PAGE_GARBAGE) + size);
+  redo_page_set(page, PAGE_N_RECS, redo_page_get(page, PAGE_N_RECS) - 1);
+  if (n_owned <= PAGE_DIR_SLOT_MIN_N_OWNED) {
+    return redo_dir_balance_slot(page, comp, slot_no);
+  }
+  return 0;
+}
+
+/** Apply the insert of a record, page_cur_parse_insert_rec(): the record
+is the bytes it shares with the start of the record before it, up to the
+mismatch index, then the end segment logged. Unless logged, its info and
+status bits and the origin are those of the record before it.
+@return 0, 1 or -1 as redo_apply_record() */
+static int redo_apply_insert(byte *page, const RedoIndex &index,
+                             const byte *ptr, const byte *end) {
+  const bool comp = page_is_comp(page);
+  if (end - ptr < 2) {
+    return -1;
+  }
+  const uint32_t cursor = mach_read_from_2(ptr);
+  ptr += 2;
+  uint32_t end_seg_len = mach_parse_compressed(&ptr, end);
+  if (ptr == nullptr || end_seg_len >= UNIV_PAGE_SIZE << 1) {
+    return -1;
+  }
+  const bool logged = (end_seg_len & 1) != 0;
+  end_seg_len >>= 1;
+  uint32_t info_bits = 0;
+  uint32_t origin = 0;
+  uint32_t mismatch = 0;
+  if (logged) {
+    if (ptr == end) {
+      return -1;
+    }
+    info_bits = mach_read_from_1(ptr++);
+    origin = mach_parse_compressed(&ptr, end);
+    if (ptr == nullptr) {
+      return -1;
+    }
+    mismatch = mach_parse_compressed(&ptr, end);
+    if (ptr == nullptr) {
+      return -1;
+    }
+  }
+  if ((size_t)(end - ptr) < end_seg_len) {
+    return -1;
+  }
+  uint32_t cursor_extra;
+  uint32_t cursor_size;
+  const int ret =
+      redo_rec_size(page, cursor, index, &cursor_extra, &cursor_size);
+  if (ret != 0) {
+    return ret;
+  }
+  const byte *cursor_rec = page + cursor;
+  if (!logged) {
+    info_bits = rec_get_info_bits(cursor_rec, comp) |
+                (comp ? rec_get_status(cursor_rec) : 0);
+    origin = cursor_extra;
+    if (cursor_size < end_seg_len) {
+      return -1;
+    }
+    mismatch = cursor_size - end_seg_len;
+  }
+  const uint32_t size = mismatch + end_seg_len;
+  if (mismatch > cursor_size ||
+      origin < (comp ? REC_N_NEW_EXTRA_BYTES : REC_N_OLD_EXTRA_BYTES) ||
+      origin > size) {
+    return -1;
+  }
+  std::vector<byte> rec(size);
+  memcpy(rec.data(), cursor_rec - cursor_extra, mismatch);
+  memcpy(rec.data() + mismatch, ptr, end_seg_len);
+  byte *rec_origin = rec.data() + origin;
+  if (comp) {
+    byte *status = rec_origin - REC_NEW_STATUS;
+    *status = (*status & ~REC_NEW_STATUS_MASK) |
+              (info_bits & REC_NEW_STATUS_MASK);
+  }
+  redo_rec_set_info_bits(rec_origin, comp, info_bits);
+  return redo_page_insert(page, index, cursor, rec.data(), origin, size);
+}
+
+/** Apply the records changing the records of an index page: the inserts,
+the deletes, the delete marks and the updates in place. */
+static int redo_apply_rec_change(byte *page, uint32_t type, const byte *ptr,
+                                 const byte *end) {
+  RedoIndex index;
+  ptr = redo_parse_index(type, ptr, end, &index);
+  if (ptr == nullptr) {
+    return -1;
+  }
+  /* Only the records of compact pages log the format of the fields, but
+  for the delete marks of secondary index records, logged with no index
+  since 8.0.28, btr_cur_parse_del_mark_set_sec_rec() */
+  const bool comp = page_is_comp(page);
+  if (index.comp != comp && type != MLOG_REC_SEC_DELETE_MARK &&
+      type != MLOG_COMP_REC_SEC_DELETE_MARK) {
+    return -1;
+  }
+  std::vector<RedoRecField> fields;
+  switch (type) {
+    case MLOG_REC_INSERT_8027:
+    case MLOG_COMP_REC_INSERT_8027:
+    case MLOG_REC_INSERT:
+      return redo_apply_insert(page, index, ptr, end);
+    case MLOG_REC_DELETE_8027:
+    case MLOG_COMP_REC_DELETE_8027:
+    case MLOG_REC_DELETE:
+      /* page_cur_parse_delete_rec() */
+      if (end - ptr < 2) {
+        return -1;
+      }
+      return redo_page_delete(page, index, mach_read_from_2(ptr));
+    case MLOG_REC_SEC_DELETE_MARK:
+    case MLOG_COMP_REC_SEC_DELETE_MARK: {
+      if (end - ptr < 3) {
+        return -1;
+      }
+      const bool deleted = mach_read_from_1(ptr) != 0;
+      const uint32_t offset = mach_read_from_2(ptr + 1);
+      if (!redo_rec_offset_ok(offset, comp ? REC_N_NEW_EXTRA_BYTES
+                                           : REC_N_OLD_EXTRA_BYTES)) {
+        return -1;
+      }
+      redo_rec_set_deleted(page + offset, comp, deleted);
+      return 0;
+    }
+    case MLOG_REC_CLUST_DELETE_MARK_8027:
+    case MLOG_COMP_REC_CLUST_DELETE_MARK_8027:
+    case MLOG_REC_CLUST_DELETE_MARK:
+    case MLOG_REC_UPDATE_IN_PLACE_8027:
+    case MLOG_COMP_REC_UPDATE_IN_PLACE_8027:
+    case MLOG_REC_UPDATE_IN_PLACE:
+      break;
+    default:
+      return 1;
+  }
+
+  const bool delete_mark = type == MLOG_REC_CLUST_DELETE_MARK_8027 ||
+                           type == MLOG_COMP_REC_CLUST_DELETE_MARK_8027 ||
+                           type == MLOG_REC_CLUST_DELETE_MARK;
+  if (end - ptr < 2) {
+    return -1;
+  }
+  const uint32_t flags = mach_read_from_1(ptr++);
+  const bool deleted = delete_mark && mach_read_from_1(ptr++) != 0;
+  const uint32_t pos = mach_parse_compressed(&ptr, end);
+  if (ptr == nullptr || (size_t)(end - ptr) < DATA_ROLL_PTR_LEN) {
+    return -1;
+  }
+  const byte *roll_ptr = ptr;
+  ptr += DATA_ROLL_PTR_LEN;
+  const uint64_t trx_id = mach_u64_parse_compressed(&ptr, end);
+  if (ptr == nullptr || end - ptr < 2) {
+    return -1;
+  }
+  const uint32_t offset = mach_read_from_2(ptr);
+  ptr += 2;
+  uint32_t extra;
+  const int ret = redo_rec_fields(page, offset, index, &fields, &extra);
+  if (ret != 0) {
+    return ret;
+  }
+  /* Only the user records of a leaf page are delete marked or updated */
+  if (comp && rec_get_status(page + offset) != REC_STATUS_ORDINARY) {
+    return 1;
+  }
+  if (delete_mark) {
+    redo_rec_set_deleted(page + offset, comp, deleted);
+  }
+  if (!(flags & BTR_KEEP_SYS_FLAG) &&
+      redo_rec_set_sys_fields(page, fields, pos, trx_id, roll_ptr) != 0) {
+    return -1;
+  }
+  return delete_mark ? 0
+                     : redo_rec_update_in_place(page, offset, fields, ptr, end);
+}
+
+int redo_apply_record(byte *page, uint32_t space_id, uint32_t page_no,
+                      uint32_t type, const byte *body, uint32_t body_len) {
+  const byte *ptr = body;
+  const byte *end = body + body_len;
+  const uint32_t data_end = UNIV_PAGE_SIZE - FIL_PAGE_DATA_END;
+  switch (type) {
+    case MLOG_1BYTE:
+    case MLOG_2BYTES:
+    case MLOG_4BYTES:
+    case MLOG_8BYTES: {
+      if (body_len < 2) {
+        return -1;
+      }
+      const uint32_t offset = mach_read_from_2(ptr);
+      ptr += 2;
+      /* The type is the number of bytes written */
+      if (offset + type > UNIV_PAGE_SIZE) {
+        return -1;
+      }
+      if (type == MLOG_8BYTES) {
+        const uint64_t val = mach_u64_parse_compressed(&ptr, end);
+        if (ptr == nullptr) {
+          return -1;
+        }
+        mach_write_to_8(page + offset, val);
+        return 0;
+      }
+      const uint32_t val = mach_parse_compressed(&ptr, end);
+      if (ptr == nullptr || (type == MLOG_1BYTE && val > 0xFF) ||
+          (type == MLOG_2BYTES && val > 0xFFFF)) {
+        return -1;
+      }
+      if (type == MLOG_1BYTE) {
+        mach_write_to_1(page + offset, val);
+      } else if (type == MLOG_2BYTES) {
+        mach_write_to_2(page + offset, val);
+      } else {
+        mach_write_to_4(page + offset, val);
+      }
+      return 0;
+    }
+    case MLOG_WRITE_STRING: {
+      if (body_len < 4) {
+        return -1;
+      }
+      const uint32_t offset = mach_read_from_2(ptr);
+      const uint32_t len = mach_read_from_2(ptr + 2);
+      if (offset + len > UNIV_PAGE_SIZE || 4 + len > body_len) {
+        return -1;
+      }
+      memcpy(page + offset, ptr + 4, len);
+      return 0;
+    }
+    case MLOG_INIT_FILE_PAGE:
+    case MLOG_INIT_FILE_PAGE2:
+      /* fsp_init_file_page_low() */
+      memset(page, 0, UNIV_PAGE_SIZE);
+      mach_write_to_4(page + FIL_PAGE_OFFSET, page_no);
+      mach_write_to_4(page + FIL_PAGE_SPACE_ID, space_id);
+      return 0;
+    case MLOG_UNDO_INIT: {
+      /* trx_undo_page_init() */
+      const uint32_t undo_type = mach_parse_compressed(&ptr, end);
+      if (ptr == nullptr) {
+        return -1;
+      }
+      byte *page_hdr = page + TRX_UNDO_PAGE_HDR;
+      mach_write_to_2(page_hdr + TRX_UNDO_PAGE_TYPE, undo_type);
+      mach_write_to_2(page_hdr + TRX_UNDO_PAGE_START,
+                      TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_HDR_SIZE);
+      mach_write_to_2(page_hdr + TRX_UNDO_PAGE_FREE,
+                      TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_HDR_SIZE);
+      mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_UNDO_LOG);
+      return 0;
+    }
+    case MLOG_UNDO_INSERT: {
+      /* trx_undo_parse_add_undo_rec(): the record between the offsets of
+      the next record and of itself */
+      if (body_len < 2) {
+        return -1;
+      }
+      const uint32_t len = mach_read_from_2(ptr);
+      byte *free_ptr = page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE;
+      const uint32_t first_free = mach_read_from_2(free_ptr);
+      if (2 + len > body_len ||
+          first_free < TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_HDR_SIZE ||
+          first_free + 4 + len > data_end) {
+        return -1;
+      }
+      byte *rec = page + first_free;
+      mach_write_to_2(rec, first_free + 4 + len);
+      mach_write_to_2(rec + 2 + len, first_free);
+      mach_write_to_2(free_ptr, first_free + 4 + len);
+      memcpy(rec + 2, ptr + 2, len);
+      return 0;
+    }
+    case MLOG_UNDO_ERASE_END: {
+      /* trx_undo_erase_page_end() */
+      const uint32_t first_free =
+          mach_read_from_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE);
+      if (first_free < TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_HDR_SIZE ||
+          first_free > data_end) {
+        return -1;
+      }
+      memset(page + first_free, 0, data_end - first_free);
+      return 0;
+    }
+    case MLOG_PAGE_CREATE:
+    case MLOG_COMP_PAGE_CREATE:
+      redo_page_create(page, type == MLOG_COMP_PAGE_CREATE, FIL_PAGE_INDEX);
+      return 0;
+    case MLOG_PAGE_CREATE_RTREE:
+    case MLOG_COMP_PAGE_CREATE_RTREE:
+      redo_page_create(page, type == MLOG_COMP_PAGE_CREATE_RTREE,
+                       FIL_PAGE_RTREE);
+      return 0;
+    case MLOG_PAGE_CREATE_SDI:
+    case MLOG_COMP_PAGE_CREATE_SDI:
+      redo_page_create(page, type == MLOG_COMP_PAGE_CREATE_SDI, FIL_PAGE_SDI);
+      return 0;
+    case MLOG_REC_MIN_MARK:
+    case MLOG_COMP_REC_MIN_MARK: {
+      /* btr_set_min_rec_mark() */
+      const bool comp = page_is_comp(page);
+      if (body_len < 2 || comp != (type == MLOG_COMP_REC_MIN_MARK)) {
+        return -1;
+      }
+      const uint32_t offset = mach_read_from_2(ptr);
+      if (!redo_rec_offset_ok(offset, comp ? REC_N_NEW_EXTRA_BYTES
+                                           : REC_N_OLD_EXTRA_BYTES)) {
+        return -1;
+      }
+      byte *rec = page + offset;
+      redo_rec_set_info_bits(
+          rec, comp, rec_get_info_bits(rec, comp) | REC_INFO_MIN_REC_FLAG);
+      return 0;
+    }
+    default:
+      return redo_apply_rec_change(page, type, ptr, end);
+  }
+}
+
+const char *redo_page_state_name(redo_page_state state) {
+  switch (state) {
+    case REDO_PAGE_CURRENT:
+      return "current";
+    case REDO_PAGE_APPLIED:
+      return "applied";
+    case REDO_PAGE_STOPPED:
+      return "stopped";
+    case REDO_PAGE_CORRUPT:
+      return "corrupt";
+    case REDO_PAGE_LOG_MISSING:
+      return "log missing";
+  }
+  return "?";
+}
+
+namespace {
+
+/** A page record kept for redo apply, its body in the arena of the
+records. */
+struct RedoApplyRecord {
+  uint64_t start_lsn;
+  uint64_t end_lsn;
+  uint32_t type;
+  uint32_t body_len;
+  size_t body;
+};
+
+}  // namespace
+
+/** @return whether a record changes the tablespace instead of a page */
+static bool redo_is_file_record(uint32_t type) {
+  return type == MLOG_FILE_CREATE || type == MLOG_FILE_RENAME ||
+         type == MLOG_FILE_DELETE || type == MLOG_FILE_EXTEND ||
+         type == MLOG_INDEX_LOAD;
+}
+
+/** Apply the mini-transactions of a page, each whole or not at all.
+@param[in,out]	page	the page, its LSN and checksum left as they are
+@param[in]	space_id	tablespace of the page
+@param[in]	recs	records of the page, in LSN order
+@param[in]	arena	bodies of the records
+@param[in,out]	result	outcome of the page */
+static void redo_apply_page(byte *page, uint32_t space_id,
+                            const std::vector<RedoApplyRecord> &recs,
+                            const std::vector<byte> &arena,
+                            RedoPageApply *result) {
+  std::vector<byte> copy(UNIV_PAGE_SIZE);
+  for (size_t first = 0; first < recs.size();) {
+    size_t last = first;
+    while (last < recs.size() && recs[last].start_lsn == recs[first].start_lsn) {
+      last++;
+    }
+    memcpy(copy.data(), page, UNIV_PAGE_SIZE);
+    for (size_t i = first; i < last; i++) {
+      const RedoApplyRecord &rec = recs[i];
+      if (redo_apply_record(copy.data(), space_id, result->page_no, rec.type,
+                            &arena[rec.body], rec.body_len) != 0) {
+        result->state = REDO_PAGE_STOPPED;
+        result->stop_type = rec.type;
+        result->stop_lsn = rec.start_lsn;
+        result->n_left = recs.size() - first;
+        return;
+      }
+    }
+    memcpy(page, copy.data(), UNIV_PAGE_SIZE);
+    result->n_applied += last - first;
+    result->new_lsn = recs[first].end_lsn;
+    result->state = REDO_PAGE_APPLIED;
+    first = last;
+  }
+}
+
+int redo_apply_pages(int fd, uint32_t space_id,
+                     const std::vector<uint32_t> &page_nos, const RedoLog &log,
+                     uint64_t target_lsn, bool dry_run,
+                     std::vector<RedoPageApply> *pages, RedoApplyStats *stats) {
+  pages->clear();
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) != 0) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  const uint64_t n_file_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+  std::vector<uint32_t> sorted(page_nos);
+  std::sort(sorted.begin(), sorted.end());
+  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+  if (!sorted.empty() && sorted.back() >= n_file_pages) {
+    fprintf(stderr, "[ERROR] page %u is past the end of the file, %lu pages\n",
+            sorted.back(), n_file_pages);
+    return -1;
+  }
+
+  /* Read each page once, its index in buf by page number */
+  std::vector<byte> buf(sorted.size() * UNIV_PAGE_SIZE);
+  std::unordered_map<uint32_t, size_t> slots;
+  uint64_t min_lsn = UINT64_MAX;
+  for (size_t i = 0; i < sorted.size(); i++) {
+    byte *page = &buf[i * UNIV_PAGE_SIZE];
+    if (pread(fd, page, UNIV_PAGE_SIZE, (uint64_t)sorted[i] * UNIV_PAGE_SIZE) !=
+        (ssize_t)UNIV_PAGE_SIZE) {
+      fprintf(stderr, "[ERROR] read of page %u failed\n", sorted[i]);
+      return -1;
+    }
+    RedoPageApply result;
+    result.page_no = sorted[i];
+    if (page_is_zero(page) || page_is_corrupted(page)) {
+      result.state = REDO_PAGE_CORRUPT;
+    } else {
+      result.old_lsn = result.new_lsn = mach_read_from_8(page + FIL_PAGE_LSN);
+      if (result.old_lsn < target_lsn) {
+        slots[sorted[i]] = i;
+        min_lsn = std::min(min_lsn, result.old_lsn);
+      }
+    }
+    pages->push_back(result);
+  }
+  if (slots.empty()) {
+    return 0;
+  }
+
+  /* The records of the pages, by page, from the LSN of each page */
+  std::unordered_map<uint32_t, std::vector<RedoApplyRecord> > recs;
+  std::vector<byte> arena;
+  log.Scan(min_lsn,
+           [&](const RedoRecord &rec) {
+             if (rec.end_lsn > target_lsn) {
+               return false;
+             }
+             if (rec.space_id != space_id) {
+               return true;
+             }
+             if (redo_is_file_record(rec.type)) {
+               stats->n_index_load += rec.type == MLOG_INDEX_LOAD;
+               return true;
+             }
+             auto slot = slots.find(rec.page_no);
+             if (slot == slots.end() ||
+                 rec.start_lsn < (*pages)[slot->second].old_lsn) {
+               return true;
+             }
+             RedoApplyRecord kept = {rec.start_lsn, rec.end_lsn, rec.type,
+                                     rec.body_len, arena.size()};
+             arena.insert(arena.end(), rec.body, rec.body + rec.body_len);
+             recs[rec.page_no].push_back(kept);
+             stats->n_records++;
+             stats->n_bytes += rec.body_len;
+             return true;
+           },
+           &stats->scan);
+  if (stats->scan.n_runs > 1) {
+    fprintf(stderr,
+            "[ERROR] the redo log has a gap before the target LSN: %lu bad "
+            "blocks, %lu records not parsed\n",
+            stats->scan.n_bad_blocks, stats->scan.n_resyncs);
+    return -1;
+  }
+
+  for (auto &slot : slots) {
+    RedoPageApply &result = (*pages)[slot.second];
+    /* A page older than the log can't be told whether it missed a change */
+    if (stats->scan.n_runs == 0 || result.old_lsn < stats->scan.start_lsn) {
+      result.state = REDO_PAGE_LOG_MISSING;
+      continue;
+    }
+    auto page_recs = recs.find(slot.first);
+    if (page_recs == recs.end()) {
+      continue;
+    }
+    byte *page = &buf[slot.second * UNIV_PAGE_SIZE];
+    redo_apply_page(page, space_id, page_recs->second, arena, &result);
+    if (result.new_lsn == result.old_lsn) {
+      continue;
+    }
+    mach_write_to_8(page + FIL_PAGE_LSN, result.new_lsn);
+    mach_write_to_4(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM + 4,
+                    result.new_lsn & 0xFFFFFFFF);
+    const uint32_t checksum = buf_calc_page_crc32(page, false);
+    mach_write_to_4(page + FIL_PAGE_SPACE_OR_CHKSUM, checksum);
+    mach_write_to_4(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM,
+                    checksum);
+    stats->n_changed++;
+  }
+  if (dry_run || stats->n_changed == 0) {
+    return 0;
+  }
+
+  for (const RedoPageApply &result : *pages) {
+    if (result.new_lsn == result.old_lsn) {
+      continue;
+    }
+    const byte *page = &buf[slots.at(result.page_no) * UNIV_PAGE_SIZE];
+    if (pwrite(fd, page, UNIV_PAGE_SIZE,
+               (uint64_t)result.page_no * UNIV_PAGE_SIZE) !=
+        (ssize_t)UNIV_PAGE_SIZE) {
+      fprintf(stderr, "[ERROR] write of page %u failed: %s\n", result.page_no,
+              strerror(errno));
+      return -1;
+    }
+    stats->n_writes++;
+  }
+  if (fsync(fd) != 0) {
+    fprintf(stderr, "[ERROR] fsync failed: %s\n", strerror(errno));
+    return -1;
+  }
+  return 0;
+}
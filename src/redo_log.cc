@@ -0,0 +1,1012 @@
+#include "include/redo_log.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "include/mach_data.h"
+#include "include/page0page.h"
+#include "include/rec_decoder.h"
+#include "include/rem0types.h"
+#include "include/undo_decoder.h"
+#include "include/ut0crc32.h"
+
+/** Names of the redo log files of 8.0.30 and later, and of the earlier
+versions */
+static const char REDO_FILE_PREFIX[] = "#ib_redo";
+static const char LOG_FILE_PREFIX[] = "ib_logfile";
+
+/** Flags of the index logged by the records of 8.0.28 and later */
+static const uint32_t INDEX_LOG_COMPACT = 1;
+static const uint32_t INDEX_LOG_VERSIONED = 2;
+static const uint32_t INDEX_LOG_INSTANT = 4;
+
+/** Parsed bytes kept before the unparsed log is moved to the start of
+the buffer */
+static const size_t REDO_PARSER_COMPACT_SIZE = 1 << 16;
+
+const char *mlog_type_name(uint32_t type) {
+#define MLOG_TYPE_NAME(t) \
+  case t:                 \
+    return #t;
+  switch (type) {
+    MLOG_TYPE_NAME(MLOG_1BYTE)
+    MLOG_TYPE_NAME(MLOG_2BYTES)
+    MLOG_TYPE_NAME(MLOG_4BYTES)
+    MLOG_TYPE_NAME(MLOG_8BYTES)
+    MLOG_TYPE_NAME(MLOG_REC_INSERT_8027)
+    MLOG_TYPE_NAME(MLOG_REC_CLUST_DELETE_MARK_8027)
+    MLOG_TYPE_NAME(MLOG_REC_SEC_DELETE_MARK)
+    MLOG_TYPE_NAME(MLOG_REC_UPDATE_IN_PLACE_8027)
+    MLOG_TYPE_NAME(MLOG_REC_DELETE_8027)
+    MLOG_TYPE_NAME(MLOG_LIST_END_DELETE_8027)
+    MLOG_TYPE_NAME(MLOG_LIST_START_DELETE_8027)
+    MLOG_TYPE_NAME(MLOG_LIST_END_COPY_CREATED_8027)
+    MLOG_TYPE_NAME(MLOG_PAGE_REORGANIZE_8027)
+    MLOG_TYPE_NAME(MLOG_PAGE_CREATE)
+    MLOG_TYPE_NAME(MLOG_UNDO_INSERT)
+    MLOG_TYPE_NAME(MLOG_UNDO_ERASE_END)
+    MLOG_TYPE_NAME(MLOG_UNDO_INIT)
+    MLOG_TYPE_NAME(MLOG_UNDO_HDR_REUSE)
+    MLOG_TYPE_NAME(MLOG_UNDO_HDR_CREATE)
+    MLOG_TYPE_NAME(MLOG_REC_MIN_MARK)
+    MLOG_TYPE_NAME(MLOG_IBUF_BITMAP_INIT)
+    MLOG_TYPE_NAME(MLOG_LSN)
+    MLOG_TYPE_NAME(MLOG_INIT_FILE_PAGE)
+    MLOG_TYPE_NAME(MLOG_WRITE_STRING)
+    MLOG_TYPE_NAME(MLOG_MULTI_REC_END)
+    MLOG_TYPE_NAME(MLOG_DUMMY_RECORD)
+    MLOG_TYPE_NAME(MLOG_FILE_CREATE)
+    MLOG_TYPE_NAME(MLOG_FILE_RENAME)
+    MLOG_TYPE_NAME(MLOG_FILE_DELETE)
+    MLOG_TYPE_NAME(MLOG_COMP_REC_MIN_MARK)
+    MLOG_TYPE_NAME(MLOG_COMP_PAGE_CREATE)
+    MLOG_TYPE_NAME(MLOG_COMP_REC_INSERT_8027)
+    MLOG_TYPE_NAME(MLOG_COMP_REC_CLUST_DELETE_MARK_8027)
+    MLOG_TYPE_NAME(MLOG_COMP_REC_SEC_DELETE_MARK)
+    MLOG_TYPE_NAME(MLOG_COMP_REC_UPDATE_IN_PLACE_8027)
+    MLOG_TYPE_NAME(MLOG_COMP_REC_DELETE_8027)
+    MLOG_TYPE_NAME(MLOG_COMP_LIST_END_DELETE_8027)
+    MLOG_TYPE_NAME(MLOG_COMP_LIST_START_DELETE_8027)
+    MLOG_TYPE_NAME(MLOG_COMP_LIST_END_COPY_CREATED_8027)
+    MLOG_TYPE_NAME(MLOG_COMP_PAGE_REORGANIZE_8027)
+    MLOG_TYPE_NAME(MLOG_ZIP_WRITE_NODE_PTR)
+    MLOG_TYPE_NAME(MLOG_ZIP_WRITE_BLOB_PTR)
+    MLOG_TYPE_NAME(MLOG_ZIP_WRITE_HEADER)
+    MLOG_TYPE_NAME(MLOG_ZIP_PAGE_COMPRESS)
+    MLOG_TYPE_NAME(MLOG_ZIP_PAGE_COMPRESS_NO_DATA_8027)
+    MLOG_TYPE_NAME(MLOG_ZIP_PAGE_REORGANIZE_8027)
+    MLOG_TYPE_NAME(MLOG_PAGE_CREATE_RTREE)
+    MLOG_TYPE_NAME(MLOG_COMP_PAGE_CREATE_RTREE)
+    MLOG_TYPE_NAME(MLOG_INIT_FILE_PAGE2)
+    MLOG_TYPE_NAME(MLOG_INDEX_LOAD)
+    MLOG_TYPE_NAME(MLOG_TABLE_DYNAMIC_META)
+    MLOG_TYPE_NAME(MLOG_PAGE_CREATE_SDI)
+    MLOG_TYPE_NAME(MLOG_COMP_PAGE_CREATE_SDI)
+    MLOG_TYPE_NAME(MLOG_FILE_EXTEND)
+    MLOG_TYPE_NAME(MLOG_TEST)
+    MLOG_TYPE_NAME(MLOG_REC_INSERT)
+    MLOG_TYPE_NAME(MLOG_REC_CLUST_DELETE_MARK)
+    MLOG_TYPE_NAME(MLOG_REC_DELETE)
+    MLOG_TYPE_NAME(MLOG_REC_UPDATE_IN_PLACE)
+    MLOG_TYPE_NAME(MLOG_LIST_END_COPY_CREATED)
+    MLOG_TYPE_NAME(MLOG_PAGE_REORGANIZE)
+    MLOG_TYPE_NAME(MLOG_ZIP_PAGE_REORGANIZE)
+    MLOG_TYPE_NAME(MLOG_ZIP_PAGE_COMPRESS_NO_DATA)
+    MLOG_TYPE_NAME(MLOG_LIST_END_DELETE)
+    MLOG_TYPE_NAME(MLOG_LIST_START_DELETE)
+    default:
+      return "?";
+  }
+#undef MLOG_TYPE_NAME
+}
+
+bool log_block_checksum_is_ok(const byte *block) {
+  const uint32_t checksum = mach_read_from_4(block + LOG_BLOCK_CHECKSUM);
+  return checksum == LOG_NO_CHECKSUM_MAGIC ||
+         checksum == ut_crc32(block, LOG_BLOCK_CHECKSUM);
+}
+
+namespace {
+
+/** A cursor over a log record. ptr is set to nullptr once past the end of
+the log read, and corrupt is set too if the record cannot be parsed. */
+struct RedoCursor {
+  RedoCursor(const byte *p, const byte *e) : ptr(p), end(e), corrupt(false) {}
+
+  void Fail() {
+    ptr = nullptr;
+    corrupt = true;
+  }
+
+  bool Skip(uint64_t n) {
+    if (ptr == nullptr || (uint64_t)(end - ptr) < n) {
+      ptr = nullptr;
+      return false;
+    }
+    ptr += n;
+    return true;
+  }
+
+  uint32_t Read1() {
+    const byte *p = ptr;
+    return Skip(1) ? mach_read_from_1(p) : 0;
+  }
+
+  uint32_t Read2() {
+    const byte *p = ptr;
+    return Skip(2) ? mach_read_from_2(p) : 0;
+  }
+
+  uint32_t Read4() {
+    const byte *p = ptr;
+    return Skip(4) ? mach_read_from_4(p) : 0;
+  }
+
+  uint32_t Compressed() {
+    return ptr == nullptr ? 0 : mach_parse_compressed(&ptr, end);
+  }
+
+  uint64_t U64Compressed() {
+    return ptr == nullptr ? 0 : mach_u64_parse_compressed(&ptr, end);
+  }
+
+  uint64_t MuchCompressed() {
+    return ptr == nullptr ? 0 : mach_parse_u64_much_compressed(&ptr, end);
+  }
+
+  /** Skip a length and that many bytes, no more than max_len */
+  void SkipLengthAnd(uint32_t len, uint32_t max_len) {
+    if (ptr != nullptr && len > max_len) {
+      Fail();
+      return;
+    }
+    Skip(len);
+  }
+
+  const byte *ptr;
+  const byte *end;
+  bool corrupt;
+};
+
+}  // namespace
+
+/** Read the index of a record of 8.0.27 or earlier. Only the records of
+compact tables log it: the number of fields, preceded by the fields before
+instant ADD COLUMN if its high bit is set, the unique fields and the
+length of each field.
+@param[in,out]	c	cursor
+@param[out]	index	the index read, nullptr to skip it */
+static void redo_read_index_8027(RedoCursor *c, RedoIndex *index) {
+  uint32_t n = c->Read2();
+  const bool instant = (n & 0x8000) != 0;
+  if (instant) {
+    n = c->Read2();
+  }
+  const uint32_t n_uniq = c->Read2();
+  if (c->ptr != nullptr && n > REC_MAX_N_FIELDS) {
+    c->Fail();
+    return;
+  }
+  if (index == nullptr) {
+    c->Skip(2 * n);
+    return;
+  }
+  index->comp = true;
+  index->instant = instant;
+  index->n_fields = n;
+  index->n_uniq = n_uniq;
+  index->field_lens.clear();
+  for (uint32_t i = 0; i < n && c->ptr != nullptr; i++) {
+    index->field_lens.push_back(c->Read2());
+  }
+}
+
+/** Read the index of a record of 8.0.28 or later: its log version and
+flags, the number of fields, of fields before instant ADD COLUMN and of
+unique fields, the fields added or dropped by an instant DDL with their
+versions, and the length of each field of a compact table.
+@param[in,out]	c	cursor
+@param[out]	index	the index read, nullptr to skip it */
+static void redo_read_index(RedoCursor *c, RedoIndex *index) {
+  c->Skip(1);
+  const uint32_t flag = c->Read1();
+  if (c->ptr != nullptr &&
+      (flag & ~(INDEX_LOG_COMPACT | INDEX_LOG_VERSIONED | INDEX_LOG_INSTANT))) {
+    c->Fail();
+    return;
+  }
+  uint32_t n = 0;
+  uint32_t n_uniq = 0;
+  if (flag & (INDEX_LOG_COMPACT | INDEX_LOG_VERSIONED)) {
+    n = c->Read2();
+    if (flag & INDEX_LOG_INSTANT) {
+      c->Skip(2);
+    }
+    n_uniq = c->Read2();
+  }
+  if (flag & INDEX_LOG_VERSIONED) {
+    const uint32_t n_versioned = c->Compressed();
+    if (c->ptr != nullptr && n_versioned > REC_MAX_N_FIELDS) {
+      c->Fail();
+      return;
+    }
+    for (uint32_t i = 0; i < n_versioned && c->ptr != nullptr; i++) {
+      c->Compressed();
+      c->Compressed();
+    }
+  }
+  if (c->ptr != nullptr && n > REC_MAX_N_FIELDS) {
+    c->Fail();
+    return;
+  }
+  if (index != nullptr) {
+    index->comp = (flag & INDEX_LOG_COMPACT) != 0;
+    index->instant = (flag & (INDEX_LOG_VERSIONED | INDEX_LOG_INSTANT)) != 0;
+    index->n_fields = n;
+    index->n_uniq = n_uniq;
+    index->field_lens.clear();
+  }
+  if (!(flag & INDEX_LOG_COMPACT)) {
+    return;
+  }
+  if (index == nullptr) {
+    c->Skip(2 * n);
+    return;
+  }
+  for (uint32_t i = 0; i < n && c->ptr != nullptr; i++) {
+    index->field_lens.push_back(c->Read2());
+  }
+}
+
+/** Read the index logged at the start of the body of a record, if its
+type logs one.
+@param[in]	type	record type
+@param[in,out]	c	cursor
+@param[out]	index	the index read, nullptr to skip it */
+static void redo_read_body_index(uint32_t type, RedoCursor *c,
+                                 RedoIndex *index) {
+  switch (type) {
+    case MLOG_COMP_REC_INSERT_8027:
+    case MLOG_COMP_REC_CLUST_DELETE_MARK_8027:
+    case MLOG_COMP_REC_SEC_DELETE_MARK:
+    case MLOG_COMP_REC_UPDATE_IN_PLACE_8027:
+    case MLOG_COMP_REC_DELETE_8027:
+    case MLOG_COMP_LIST_END_DELETE_8027:
+    case MLOG_COMP_LIST_START_DELETE_8027:
+    case MLOG_COMP_LIST_END_COPY_CREATED_8027:
+    case MLOG_COMP_PAGE_REORGANIZE_8027:
+    case MLOG_ZIP_PAGE_COMPRESS_NO_DATA_8027:
+    case MLOG_ZIP_PAGE_REORGANIZE_8027:
+      redo_read_index_8027(c, index);
+      break;
+    case MLOG_REC_INSERT:
+    case MLOG_REC_CLUST_DELETE_MARK:
+    case MLOG_REC_DELETE:
+    case MLOG_REC_UPDATE_IN_PLACE:
+    case MLOG_LIST_END_COPY_CREATED:
+    case MLOG_PAGE_REORGANIZE:
+    case MLOG_ZIP_PAGE_REORGANIZE:
+    case MLOG_ZIP_PAGE_COMPRESS_NO_DATA:
+    case MLOG_LIST_END_DELETE:
+    case MLOG_LIST_START_DELETE:
+      redo_read_index(c, index);
+      break;
+    default:
+      break;
+  }
+}
+
+/** Skip the position, roll pointer and transaction id written to a
+clustered index record. */
+static void redo_skip_sys_vals(RedoCursor *c) {
+  c->Compressed();
+  c->Skip(DATA_ROLL_PTR_LEN);
+  c->U64Compressed();
+}
+
+/** Skip a record inserted on a page: the offset of the record before it,
+the length of its end segment, shifted left by one, with the low bit set
+if its info bits and the origin and length of the segment shared with the
+record before are logged, and the end segment. */
+static void redo_skip_insert(RedoCursor *c) {
+  c->Skip(2);
+  const uint32_t end_seg_len = c->Compressed();
+  if (c->ptr != nullptr && end_seg_len >= 2 * UNIV_PAGE_SIZE) {
+    c->Fail();
+    return;
+  }
+  if (end_seg_len & 1) {
+    c->Skip(1);
+    c->Compressed();
+    c->Compressed();
+  }
+  c->Skip(end_seg_len >> 1);
+}
+
+/** Skip an update vector: the info bits and the number of fields, then
+the number, length and data of each field. */
+static void redo_skip_update(RedoCursor *c) {
+  c->Skip(1);
+  const uint32_t n_fields = c->Compressed();
+  if (c->ptr != nullptr && n_fields > REC_MAX_N_FIELDS) {
+    c->Fail();
+    return;
+  }
+  for (uint32_t i = 0; i < n_fields && c->ptr != nullptr; i++) {
+    c->Compressed();
+    const uint32_t len = c->Compressed();
+    if (len != UNIV_SQL_NULL) {
+      c->SkipLengthAnd(len, UNIV_PAGE_SIZE);
+    }
+  }
+}
+
+/** Skip the body of a page record, after its space id and page number. A
+record whose layout is not known here fails the cursor. */
+static void redo_skip_body(uint32_t type, RedoCursor *c) {
+  redo_read_body_index(type, c, nullptr);
+
+  switch (type) {
+    case MLOG_1BYTE:
+    case MLOG_2BYTES:
+    case MLOG_4BYTES:
+      c->Skip(2);
+      c->Compressed();
+      break;
+    case MLOG_8BYTES:
+      c->Skip(2);
+      c->U64Compressed();
+      break;
+    case MLOG_WRITE_STRING:
+      c->Skip(2);
+      c->SkipLengthAnd(c->Read2(), UNIV_PAGE_SIZE);
+      break;
+    case MLOG_UNDO_INSERT:
+      c->SkipLengthAnd(c->Read2(), UNIV_PAGE_SIZE);
+      break;
+    case MLOG_UNDO_INIT:
+      c->Compressed();
+      break;
+    case MLOG_UNDO_HDR_REUSE:
+    case MLOG_UNDO_HDR_CREATE:
+      c->MuchCompressed();
+      break;
+    case MLOG_UNDO_ERASE_END:
+    case MLOG_PAGE_CREATE:
+    case MLOG_COMP_PAGE_CREATE:
+    case MLOG_PAGE_CREATE_RTREE:
+    case MLOG_COMP_PAGE_CREATE_RTREE:
+    case MLOG_PAGE_CREATE_SDI:
+    case MLOG_COMP_PAGE_CREATE_SDI:
+    case MLOG_IBUF_BITMAP_INIT:
+    case MLOG_INIT_FILE_PAGE:
+    case MLOG_INIT_FILE_PAGE2:
+    case MLOG_INDEX_LOAD:
+    case MLOG_PAGE_REORGANIZE_8027:
+    case MLOG_COMP_PAGE_REORGANIZE_8027:
+    case MLOG_PAGE_REORGANIZE:
+      break;
+    case MLOG_REC_MIN_MARK:
+    case MLOG_COMP_REC_MIN_MARK:
+    case MLOG_REC_DELETE_8027:
+    case MLOG_COMP_REC_DELETE_8027:
+    case MLOG_REC_DELETE:
+    case MLOG_LIST_END_DELETE_8027:
+    case MLOG_COMP_LIST_END_DELETE_8027:
+    case MLOG_LIST_END_DELETE:
+    case MLOG_LIST_START_DELETE_8027:
+    case MLOG_COMP_LIST_START_DELETE_8027:
+    case MLOG_LIST_START_DELETE:
+      c->Skip(2);
+      break;
+    case MLOG_REC_SEC_DELETE_MARK:
+    case MLOG_COMP_REC_SEC_DELETE_MARK:
+      c->Skip(1 + 2);
+      break;
+    case MLOG_REC_INSERT_8027:
+    case MLOG_COMP_REC_INSERT_8027:
+    case MLOG_REC_INSERT:
+      redo_skip_insert(c);
+      break;
+    case MLOG_REC_CLUST_DELETE_MARK_8027:
+    case MLOG_COMP_REC_CLUST_DELETE_MARK_8027:
+    case MLOG_REC_CLUST_DELETE_MARK:
+      /* flags and value, the system columns, the record offset */
+      c->Skip(2);
+      redo_skip_sys_vals(c);
+      c->Skip(2);
+      break;
+    case MLOG_REC_UPDATE_IN_PLACE_8027:
+    case MLOG_COMP_REC_UPDATE_IN_PLACE_8027:
+    case MLOG_REC_UPDATE_IN_PLACE:
+      c->Skip(1);
+      redo_skip_sys_vals(c);
+      c->Skip(2);
+      redo_skip_update(c);
+      break;
+    case MLOG_LIST_END_COPY_CREATED_8027:
+    case MLOG_COMP_LIST_END_COPY_CREATED_8027:
+    case MLOG_LIST_END_COPY_CREATED:
+      c->SkipLengthAnd(c->Read4(), UNIV_PAGE_SIZE);
+      break;
+    case MLOG_ZIP_PAGE_REORGANIZE_8027:
+    case MLOG_ZIP_PAGE_REORGANIZE:
+    case MLOG_ZIP_PAGE_COMPRESS_NO_DATA_8027:
+    case MLOG_ZIP_PAGE_COMPRESS_NO_DATA:
+      /* the compression level */
+      c->Skip(1);
+      break;
+    case MLOG_ZIP_WRITE_NODE_PTR:
+      /* offsets on the page and in the compressed page, a child page */
+      c->Skip(2 + 2 + 4);
+      break;
+    case MLOG_ZIP_WRITE_BLOB_PTR:
+      c->Skip(2 + 2 + 20);
+      break;
+    case MLOG_ZIP_WRITE_HEADER:
+      c->Skip(1);
+      c->Skip(c->Read1());
+      break;
+    case MLOG_ZIP_PAGE_COMPRESS: {
+      const uint32_t size = c->Read2();
+      const uint32_t trailer_size = c->Read2();
+      /* FIL_PAGE_PREV and FIL_PAGE_NEXT, the compressed data, the trailer */
+      c->SkipLengthAnd(8 + size + trailer_size, UNIV_PAGE_SIZE);
+      break;
+    }
+    case MLOG_FILE_CREATE:
+      /* the flags of the tablespace and its file name */
+      c->Skip(4);
+      c->SkipLengthAnd(c->Read2(), UNIV_PAGE_SIZE);
+      break;
+    case MLOG_FILE_RENAME:
+      c->SkipLengthAnd(c->Read2(), UNIV_PAGE_SIZE);
+      c->SkipLengthAnd(c->Read2(), UNIV_PAGE_SIZE);
+      break;
+    case MLOG_FILE_DELETE:
+      c->SkipLengthAnd(c->Read2(), UNIV_PAGE_SIZE);
+      break;
+    case MLOG_FILE_EXTEND:
+      /* offset and size of the extension */
+      c->Skip(8 + 8);
+      break;
+    default:
+      /* MLOG_LSN, MLOG_TEST and MLOG_TABLE_DYNAMIC_META */
+      c->Fail();
+      break;
+  }
+}
+
+const byte *redo_parse_index(uint32_t type, const byte *body,
+                             const byte *end, RedoIndex *index) {
+  *index = RedoIndex();
+  RedoCursor c(body, end);
+  redo_read_body_index(type, &c, index);
+  return c.ptr;
+}
+
+int redo_parse_mtr(const byte *ptr, const byte *end_ptr,
+                   std::vector<RedoRecord> *recs, size_t *len) {
+  recs->clear();
+  const byte *p = ptr;
+  for (bool first = true;; first = false) {
+    if (p >= end_ptr) {
+      return 0;
+    }
+    const bool single = (*p & MLOG_SINGLE_REC_FLAG) != 0;
+    const uint32_t type = *p & ~MLOG_SINGLE_REC_FLAG;
+    if (type == 0 || type > MLOG_BIGGEST_TYPE || (single && !first)) {
+      return -1;
+    }
+    if (type == MLOG_MULTI_REC_END) {
+      if (first) {
+        return -1;
+      }
+      *len = p + 1 - ptr;
+      return 1;
+    }
+    if (type == MLOG_DUMMY_RECORD) {
+      /* Padding between mini-transactions is a group of its own */
+      p++;
+      if (first) {
+        *len = p - ptr;
+        return 1;
+      }
+      continue;
+    }
+    RedoRecord rec;
+    rec.type = type;
+    RedoCursor c(p + 1, end_ptr);
+    rec.space_id = c.Compressed();
+    rec.page_no = c.Compressed();
+    rec.body = c.ptr;
+    if (c.ptr != nullptr) {
+      redo_skip_body(type, &c);
+    }
+    if (c.corrupt) {
+      return -1;
+    }
+    if (c.ptr == nullptr) {
+      return 0;
+    }
+    rec.body_len = c.ptr - rec.body;
+    rec.len = c.ptr - p;
+    recs->push_back(rec);
+    p = c.ptr;
+    if (single) {
+      *len = p - ptr;
+      return 1;
+    }
+  }
+}
+
+namespace {
+
+/** The log of a run of consecutive blocks, parsed as the blocks are
+read. A run starts at the first mini-transaction of a block and ends at a
+block not following the previous one, a bad block, a record that cannot
+be parsed or the last block written. */
+class RedoParser {
+ public:
+  RedoParser(uint64_t from_lsn, const redo_record_cb &cb,
+             RedoScanStats *stats)
+      : from_lsn_(from_lsn),
+        cb_(cb),
+        stats_(stats),
+        in_run_(false),
+        run_lsn_(0),
+        next_lsn_(0),
+        pos_(0),
+        buf_offset_(0) {}
+
+  /** Add a block and parse the mini-transactions completed by it.
+  @return false if the callback stopped the scan */
+  bool Add(const byte *block, uint64_t lsn);
+
+  /** End the run, its incomplete mini-transaction left unparsed. */
+  void End() {
+    if (in_run_) {
+      stats_->n_unparsed_bytes += buf_.size() - pos_;
+      in_run_ = false;
+    }
+    buf_.clear();
+    pos_ = 0;
+  }
+
+ private:
+  bool Parse();
+
+  /** @return LSN of a byte of the run, by its offset in the log of the
+  blocks of the run. The end LSN of a mini-transaction ending a block is
+  after the header of the next block, as InnoDB counts it. */
+  uint64_t Lsn(uint64_t offset) const {
+    return run_lsn_ + offset / LOG_BLOCK_DATA_SIZE * OS_FILE_LOG_BLOCK_SIZE +
+           LOG_BLOCK_HDR_SIZE + offset % LOG_BLOCK_DATA_SIZE;
+  }
+
+  const uint64_t from_lsn_;
+  const redo_record_cb &cb_;
+  RedoScanStats *stats_;
+  bool in_run_;
+  /** LSN of the first block of the run */
+  uint64_t run_lsn_;
+  /** LSN of the block following the run */
+  uint64_t next_lsn_;
+  /** Log of the run not parsed yet, from pos_ */
+  std::vector<byte> buf_;
+  size_t pos_;
+  /** Offset of buf_[0] in the log of the run */
+  uint64_t buf_offset_;
+  std::vector<RedoRecord> recs_;
+};
+
+}  // namespace
+
+bool RedoParser::Add(const byte *block, uint64_t lsn) {
+  const uint32_t data_len = mach_read_from_2(block + LOG_BLOCK_HDR_DATA_LEN);
+  const uint32_t first_rec =
+      mach_read_from_2(block + LOG_BLOCK_FIRST_REC_GROUP);
+  if (data_len < LOG_BLOCK_HDR_SIZE || data_len > OS_FILE_LOG_BLOCK_SIZE) {
+    stats_->n_bad_blocks++;
+    End();
+    return true;
+  }
+  const uint32_t data_end = std::min(data_len, LOG_BLOCK_CHECKSUM);
+  if (in_run_ && lsn != next_lsn_) {
+    End();
+  }
+  uint32_t from = LOG_BLOCK_HDR_SIZE;
+  if (!in_run_) {
+    if (first_rec < LOG_BLOCK_HDR_SIZE || first_rec >= data_end) {
+      /* No mini-transaction starts in the block */
+      stats_->n_unparsed_bytes += data_end - LOG_BLOCK_HDR_SIZE;
+      return true;
+    }
+    stats_->n_unparsed_bytes += first_rec - LOG_BLOCK_HDR_SIZE;
+    if (stats_->n_runs++ == 0) {
+      stats_->start_lsn = lsn + first_rec;
+    }
+    in_run_ = true;
+    run_lsn_ = lsn;
+    buf_offset_ = first_rec - LOG_BLOCK_HDR_SIZE;
+    from = first_rec;
+  }
+  buf_.insert(buf_.end(), block + from, block + data_end);
+  next_lsn_ = lsn + OS_FILE_LOG_BLOCK_SIZE;
+  const bool go_on = Parse();
+  if (data_len < OS_FILE_LOG_BLOCK_SIZE) {
+    /* The last block written */
+    End();
+  }
+  return go_on;
+}
+
+bool RedoParser::Parse() {
+  while (in_run_ && pos_ < buf_.size()) {
+    size_t len = 0;
+    const int ret = redo_parse_mtr(&buf_[pos_], buf_.data() + buf_.size(),
+                                   &recs_, &len);
+    if (ret == 0) {
+      break;
+    }
+    if (ret < 0) {
+      stats_->n_resyncs++;
+      End();
+      return true;
+    }
+    const uint64_t start_lsn = Lsn(buf_offset_ + pos_);
+    const uint64_t end_lsn = Lsn(buf_offset_ + pos_ + len);
+    pos_ += len;
+    if (start_lsn < from_lsn_ || recs_.empty()) {
+      continue;
+    }
+    stats_->n_mtrs++;
+    if (stats_->first_lsn == 0) {
+      stats_->first_lsn = start_lsn;
+    }
+    stats_->end_lsn = end_lsn;
+    for (RedoRecord &rec : recs_) {
+      rec.start_lsn = start_lsn;
+      rec.end_lsn = end_lsn;
+      stats_->n_records++;
+      stats_->n_by_type[rec.type]++;
+      if (!cb_(rec)) {
+        return false;
+      }
+    }
+  }
+  if (pos_ == buf_.size() || pos_ >= REDO_PARSER_COMPACT_SIZE) {
+    buf_.erase(buf_.begin(), buf_.begin() + pos_);
+    buf_offset_ += pos_;
+    pos_ = 0;
+  }
+  return true;
+}
+
+RedoLog::~RedoLog() {
+  for (RedoFile &file : files_) {
+    if (file.map != nullptr) {
+      munmap(const_cast<byte *>(file.map), file.size);
+    }
+    if (file.fd != -1) {
+      close(file.fd);
+    }
+  }
+}
+
+/** @return the number N of a file name prefixN, -1 if it is not one */
+static int64_t redo_file_no(const char *name, const char *prefix) {
+  const size_t len = strlen(prefix);
+  if (strncmp(name, prefix, len) != 0 || name[len] == '\0') {
+    return -1;
+  }
+  char *end = nullptr;
+  const int64_t n = strtoll(name + len, &end, 10);
+  return *end == '\0' && isdigit((unsigned char)name[len]) ? n : -1;
+}
+
+int RedoLog::OpenFile(const std::string &file_name) {
+  RedoFile file;
+  file.file_name = file_name;
+  file.fd = open(file_name.c_str(), O_RDONLY);
+  struct stat stat_buf;
+  if (file.fd == -1 || fstat(file.fd, &stat_buf) == -1) {
+    fprintf(stderr, "[ERROR] Open %s failed: %s\n", file_name.c_str(),
+            strerror(errno));
+    if (file.fd != -1) {
+      close(file.fd);
+    }
+    return -1;
+  }
+  file.size = stat_buf.st_size;
+  if (file.size < LOG_FILE_HDR_SIZE + OS_FILE_LOG_BLOCK_SIZE) {
+    fprintf(stderr, "[ERROR] %s is too small for a redo log file\n",
+            file_name.c_str());
+    close(file.fd);
+    return -1;
+  }
+  void *map = mmap(nullptr, file.size, PROT_READ, MAP_SHARED, file.fd, 0);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "[ERROR] mmap of %s failed: %s\n", file_name.c_str(),
+            strerror(errno));
+    close(file.fd);
+    return -1;
+  }
+  madvise(map, file.size, MADV_SEQUENTIAL);
+  file.map = static_cast<const byte *>(map);
+  file.format = mach_read_from_4(file.map + LOG_HEADER_FORMAT);
+  file.start_lsn = mach_read_from_8(file.map + LOG_HEADER_START_LSN);
+  const char *creator =
+      reinterpret_cast<const char *>(file.map + LOG_HEADER_CREATOR);
+  file.creator.assign(
+      creator, strnlen(creator, LOG_HEADER_CREATOR_END - LOG_HEADER_CREATOR));
+  files_.push_back(file);
+  return 0;
+}
+
+int RedoLog::Open(const char *spec) {
+  ut_crc32_init();
+  std::vector<std::string> names;
+  struct stat stat_buf;
+  if (stat(spec, &stat_buf) == 0 && S_ISDIR(stat_buf.st_mode)) {
+    DIR *dir = opendir(spec);
+    if (dir == nullptr) {
+      fprintf(stderr, "[ERROR] Open %s failed: %s\n", spec, strerror(errno));
+      return -1;
+    }
+    std::vector<std::pair<int64_t, std::string> > redo_files;
+    std::vector<std::pair<int64_t, std::string> > log_files;
+    for (struct dirent *entry = readdir(dir); entry != nullptr;
+         entry = readdir(dir)) {
+      const std::string file_name = std::string(spec) + "/" + entry->d_name;
+      int64_t n = redo_file_no(entry->d_name, REDO_FILE_PREFIX);
+      if (n >= 0) {
+        redo_files.push_back(std::make_pair(n, file_name));
+      }
+      n = redo_file_no(entry->d_name, LOG_FILE_PREFIX);
+      if (n >= 0) {
+        log_files.push_back(std::make_pair(n, file_name));
+      }
+    }
+    closedir(dir);
+    std::vector<std::pair<int64_t, std::string> > &found =
+        redo_files.empty() ? log_files : redo_files;
+    std::sort(found.begin(), found.end());
+    for (const auto &f : found) {
+      names.push_back(f.second);
+    }
+    if (names.empty()) {
+      fprintf(stderr, "[ERROR] no %sN or %sN file in %s\n", REDO_FILE_PREFIX,
+              LOG_FILE_PREFIX, spec);
+      return -1;
+    }
+  } else {
+    const std::string s = spec;
+    for (size_t pos = 0; pos <= s.size();) {
+      size_t comma = s.find(',', pos);
+      if (comma == std::string::npos) {
+        comma = s.size();
+      }
+      names.push_back(s.substr(pos, comma - pos));
+      pos = comma + 1;
+    }
+  }
+  for (const std::string &name : names) {
+    if (OpenFile(name) != 0) {
+      return -1;
+    }
+  }
+
+  const uint32_t format = files_[0].format;
+  for (const RedoFile &file : files_) {
+    if (file.format < LOG_HEADER_FORMAT_8_0_1) {
+      fprintf(stderr, "[ERROR] %s: log format %u of MySQL 5.7 or earlier is "
+              "not supported\n", file.file_name.c_str(), file.format);
+      return -1;
+    }
+    if ((file.format >= LOG_HEADER_FORMAT_8_0_30) !=
+        (format >= LOG_HEADER_FORMAT_8_0_30)) {
+      fprintf(stderr, "[ERROR] %s and %s are of different log formats\n",
+              files_[0].file_name.c_str(), file.file_name.c_str());
+      return -1;
+    }
+  }
+  if (format < LOG_HEADER_FORMAT_8_0_30) {
+    return MapGroup();
+  }
+
+  /* Each file holds the log from its start LSN on */
+  for (const RedoFile &file : files_) {
+    const uint32_t checkpoints[] = {LOG_CHECKPOINT_1, LOG_CHECKPOINT_2};
+    for (uint32_t cp : checkpoints) {
+      if (log_block_checksum_is_ok(file.map + cp)) {
+        checkpoint_lsn_ = std::max(
+            checkpoint_lsn_, mach_read_from_8(file.map + cp + LOG_CHECKPOINT_LSN));
+      }
+    }
+    if (file.start_lsn % OS_FILE_LOG_BLOCK_SIZE != 0) {
+      fprintf(stderr, "[WARN] %s: start LSN %lu is not at a block, the file "
+              "is skipped\n", file.file_name.c_str(), file.start_lsn);
+      continue;
+    }
+    Segment segment;
+    segment.blocks = file.map + LOG_FILE_HDR_SIZE;
+    segment.n_blocks = (file.size - LOG_FILE_HDR_SIZE) / OS_FILE_LOG_BLOCK_SIZE;
+    segment.lsn = file.start_lsn;
+    segments_.push_back(segment);
+  }
+  std::sort(segments_.begin(), segments_.end(),
+            [](const Segment &a, const Segment &b) { return a.lsn < b.lsn; });
+  return 0;
+}
+
+int RedoLog::MapGroup() {
+  const RedoFile &first = files_[0];
+  for (const RedoFile &file : files_) {
+    if (file.size != first.size) {
+      fprintf(stderr, "[ERROR] the files of the log group differ in size: "
+              "%s and %s\n", first.file_name.c_str(), file.file_name.c_str());
+      return -1;
+    }
+  }
+  /* The checkpoint with the highest number, in the first file */
+  uint64_t checkpoint_no = 0;
+  uint64_t checkpoint_offset = 0;
+  bool found = false;
+  const uint32_t checkpoints[] = {LOG_CHECKPOINT_1, LOG_CHECKPOINT_2};
+  for (uint32_t cp : checkpoints) {
+    const byte *block = first.map + cp;
+    if (!log_block_checksum_is_ok(block)) {
+      continue;
+    }
+    const uint64_t no = mach_read_from_8(block + LOG_CHECKPOINT_NO);
+    if (!found || no > checkpoint_no) {
+      found = true;
+      checkpoint_no = no;
+      checkpoint_lsn_ = mach_read_from_8(block + LOG_CHECKPOINT_LSN);
+      checkpoint_offset = mach_read_from_8(block + LOG_CHECKPOINT_OFFSET);
+    }
+  }
+  if (!found) {
+    fprintf(stderr, "[ERROR] %s has no valid checkpoint, the LSNs of the "
+            "log group are unknown\n", first.file_name.c_str());
+    return -1;
+  }
+
+  /* The log of the group, the file headers left out, is a ring */
+  const uint64_t file_data =
+      (first.size - LOG_FILE_HDR_SIZE) / OS_FILE_LOG_BLOCK_SIZE *
+      OS_FILE_LOG_BLOCK_SIZE;
+  const uint64_t capacity = file_data * files_.size();
+  const uint64_t in_file = checkpoint_offset % first.size;
+  const uint64_t lsn_in_block = checkpoint_lsn_ % OS_FILE_LOG_BLOCK_SIZE;
+  if (checkpoint_offset / first.size >= files_.size() ||
+      in_file < LOG_FILE_HDR_SIZE + lsn_in_block ||
+      in_file - LOG_FILE_HDR_SIZE >= file_data ||
+      (in_file - lsn_in_block) % OS_FILE_LOG_BLOCK_SIZE != 0) {
+    fprintf(stderr, "[ERROR] checkpoint offset %lu is out of the log group\n",
+            checkpoint_offset);
+    return -1;
+  }
+  /* Position in the ring and LSN of the block of the checkpoint */
+  const uint64_t block_pos = checkpoint_offset / first.size * file_data +
+                             in_file - LOG_FILE_HDR_SIZE - lsn_in_block;
+  const uint64_t block_lsn = checkpoint_lsn_ - lsn_in_block;
+
+  /* The ring from the checkpoint block to its end, then from its start
+  back to the checkpoint block, at the LSNs of the previous lap, then of
+  the current one */
+  const uint64_t spans[2][2] = {{block_pos, capacity - block_pos},
+                                {0, block_pos}};
+  for (uint64_t lap = 0; lap < 2; lap++) {
+    uint64_t lsn = block_lsn;
+    for (const auto &span : spans) {
+      uint64_t pos = span[0];
+      uint64_t len = span[1];
+      /* lap 0 is capacity behind */
+      uint64_t span_lsn = lsn;
+      if (lap == 0) {
+        if (span_lsn < capacity) {
+          const uint64_t skip = std::min(len, capacity - span_lsn);
+          pos += skip;
+          len -= skip;
+          span_lsn = capacity;
+        }
+        span_lsn -= capacity;
+      }
+      lsn += span[1];
+      while (len > 0) {
+        const uint64_t f = pos / file_data;
+        const uint64_t off = pos % file_data;
+        const uint64_t n = std::min(len, file_data - off);
+        Segment segment;
+        segment.blocks = files_[f].map + LOG_FILE_HDR_SIZE + off;
+        segment.n_blocks = n / OS_FILE_LOG_BLOCK_SIZE;
+        segment.lsn = span_lsn;
+        segments_.push_back(segment);
+        pos += n;
+        len -= n;
+        span_lsn += n;
+      }
+    }
+  }
+  return 0;
+}
+
+int RedoLog::Scan(uint64_t from_lsn, const redo_record_cb &cb,
+                  RedoScanStats *stats) const {
+  RedoParser parser(from_lsn, cb, stats);
+  const uint64_t from_block =
+      from_lsn / OS_FILE_LOG_BLOCK_SIZE * OS_FILE_LOG_BLOCK_SIZE;
+  for (const Segment &segment : segments_) {
+    if (segment.lsn + segment.n_blocks * OS_FILE_LOG_BLOCK_SIZE <=
+        from_block) {
+      continue;
+    }
+    uint64_t i = segment.lsn < from_block
+                     ? (from_block - segment.lsn) / OS_FILE_LOG_BLOCK_SIZE
+                     : 0;
+    for (; i < segment.n_blocks; i++) {
+      const byte *block = segment.blocks + i * OS_FILE_LOG_BLOCK_SIZE;
+      const uint64_t lsn = segment.lsn + i * OS_FILE_LOG_BLOCK_SIZE;
+      /* A block of an older lap, or never written */
+      if ((mach_read_from_4(block + LOG_BLOCK_HDR_NO) &
+           ~LOG_BLOCK_FLUSH_BIT_MASK) != log_block_convert_lsn_to_no(lsn)) {
+        parser.End();
+        continue;
+      }
+      stats->n_blocks++;
+      if (!log_block_checksum_is_ok(block)) {
+        stats->n_bad_blocks++;
+        stats->n_unparsed_bytes += LOG_BLOCK_DATA_SIZE;
+        parser.End();
+        continue;
+      }
+      if (!parser.Add(block, lsn)) {
+        return -1;
+      }
+    }
+  }
+  parser.End();
+  return 0;
+}
+
+int redo_changed_pages(const RedoLog &log, uint64_t since_lsn,
+                       std::vector<RedoPageChanges> *pages,
+                       RedoScanStats *stats) {
+  std::unordered_map<uint64_t, RedoPageChanges> changes;
+  log.Scan(since_lsn,
+           [&changes](const RedoRecord &rec) {
+             RedoPageChanges &page =
+                 changes[(uint64_t)rec.space_id << 32 | rec.page_no];
+             page.space_id = rec.space_id;
+             page.page_no = rec.page_no;
+             page.n_records++;
+             page.n_bytes += rec.len;
+             page.last_lsn = rec.end_lsn;
+             return true;
+           },
+           stats);
+  pages->clear();
+  pages->reserve(changes.size());
+  for (const auto &c : changes) {
+    pages->push_back(c.second);
+  }
+  std::sort(pages->begin(), pages->end(),
+            [](const RedoPageChanges &a, const RedoPageChanges &b) {
+              return a.space_id != b.space_id ? a.space_id < b.space_id
+                                              : a.page_no < b.page_no;
+            });
+  return 0;
+}
@@ -0,0 +1,638 @@
+#include "include/row_filter.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+namespace {
+
+enum TokenType { TOK_END, TOK_IDENT, TOK_NUMBER, TOK_STRING, TOK_SYMBOL };
+
+struct Token {
+  TokenType type;
+  std::string text;
+};
+
+/** Split a --where clause into tokens.
+@return 0 on success, -1 on an unterminated string or a stray character */
+int tokenize(const char *s, std::vector<Token> *tokens) {
+  while (*s) {
+    if (isspace((unsigned char)*s)) {
+      s++;
+      continue;
+    }
+    Token tok;
+    if (*s == '\'' || *s == '"' || *s == '`') {
+      const char quote = *s++;
+      tok.type = quote == '`' ? TOK_IDENT : TOK_STRING;
+      while (*s && *s != quote) {
+        if (*s == '\\' && quote != '`' && s[1]) {
+          s++;
+        }
+        tok.text.push_back(*s++);
+      }
+      if (*s != quote) {
+        fprintf(stderr, "[ERROR] --where: unterminated %c\n", quote);
+        return -1;
+      }
+      s++;
+    } else if (isdigit((unsigned char)*s) ||
+               ((*s == '-' || *s == '+' || *s == '.') &&
+                (isdigit((unsigned char)s[1]) || s[1] == '.'))) {
+      tok.type = TOK_NUMBER;
+      tok.text.push_back(*s++);
+      while (isalnum((unsigned char)*s) || *s == '.' ||
+             ((*s == '-' || *s == '+') && (s[-1] == 'e' || s[-1] == 'E'))) {
+        tok.text.push_back(*s++);
+      }
+    } else if (isalpha((unsigned char)*s) || *s == '_' || *s == '$') {
+      tok.type = TOK_IDENT;
+      while (isalnum((unsigned char)*s) || *s == '_' || *s == '$') {
+        tok.text.push_back(*s++);
+      }
+    } else if (strchr("=<>!(),", *s)) {
+      tok.type = TOK_SYMBOL;
+      tok.text.push_back(*s++);
+      if ((tok.text[0] == '<' && (*s == '=' || *s == '>')) ||
+          ((tok.text[0] == '>' || tok.text[0] == '!') && *s == '=')) {
+        tok.text.push_back(*s++);
+      }
+      if (tok.text == "!") {
+        fprintf(stderr, "[ERROR] --where: unexpected '!'\n");
+        return -1;
+      }
+    } else {
+      fprintf(stderr, "[ERROR] --where: unexpected '%c'\n", *s);
+      return -1;
+    }
+    tokens->push_back(tok);
+  }
+  Token end;
+  end.type = TOK_END;
+  tokens->push_back(end);
+  return 0;
+}
+
+bool is_keyword(const Token &tok, const char *kw) {
+  return tok.type == TOK_IDENT && strcasecmp(tok.text.c_str(), kw) == 0;
+}
+
+bool is_symbol(const Token &tok, const char *sym) {
+  return tok.type == TOK_SYMBOL && tok.text == sym;
+}
+
+/** Append the low len bytes of v in big-endian order. */
+void append_be(uint64_t v, uint32_t len, std::string *out) {
+  for (uint32_t i = len; i > 0; i--) {
+    out->push_back(static_cast<char>((v >> (8 * (i - 1))) & 0xFF));
+  }
+}
+
+bool parse_int(const std::string &text, bool is_unsigned, int64_t *v) {
+  char *end = nullptr;
+  errno = 0;
+  if (is_unsigned) {
+    if (text[0] == '-') {
+      return false;
+    }
+    *v = static_cast<int64_t>(strtoull(text.c_str(), &end, 0));
+  } else {
+    *v = strtoll(text.c_str(), &end, 0);
+  }
+  return errno == 0 && end != text.c_str() && *end == '\0';
+}
+
+/** Encode an integer literal like InnoDB stores an integer column. The
+system columns are stored as plain big-endian unsigned integers, whatever
+their data dictionary type. */
+bool encode_int(const ColumnDef &col, uint32_t len, const std::string &text,
+                std::string *key) {
+  const bool is_unsigned = col.is_unsigned || col.type == DD_TYPE_ENUM ||
+                           col.type == DD_TYPE_SET || col.type == DD_TYPE_BIT ||
+                           col.type == DD_TYPE_YEAR || rec_col_is_system(col);
+  int64_t v;
+  if (len == 0 || len > 8 || !parse_int(text, is_unsigned, &v)) {
+    return false;
+  }
+  const uint32_t bits = len * 8;
+  uint64_t u = static_cast<uint64_t>(v);
+  if (col.type == DD_TYPE_YEAR) {
+    /* YEAR is stored as the offset from 1900, 0 stays 0 */
+    if (v != 0 && (v < 1901 || v > 2155)) {
+      return false;
+    }
+    u = v ? v - 1900 : 0;
+  } else if (is_unsigned) {
+    if (bits < 64 && u >> bits) {
+      return false;
+    }
+  } else {
+    if (bits < 64 && (v < -(1LL << (bits - 1)) || v >= (1LL << (bits - 1)))) {
+      return false;
+    }
+    u ^= 1ULL << (bits - 1);
+  }
+  append_be(u, len, key);
+  return true;
+}
+
+/** @return the microseconds of up to 6 digits of fractional seconds */
+uint32_t parse_frac(const char *frac) {
+  size_t digits = strlen(frac);
+  uint32_t usec = atoi(frac);
+  for (; digits < 6; digits++) {
+    usec *= 10;
+  }
+  return usec;
+}
+
+/** Parse 'YYYY-MM-DD[ HH:MM:SS[.ffffff]]'. */
+bool parse_datetime(const std::string &text, struct tm *tm, uint32_t *usec) {
+  memset(tm, 0, sizeof(*tm));
+  *usec = 0;
+  char frac[8] = {0};
+  /* End of the date, of the time and of the fractional seconds, to check
+  that nothing follows the part that was read */
+  int ends[3] = {-1, -1, -1};
+  int n = sscanf(text.c_str(), "%d-%d-%d%n%*[ T]%d:%d:%d%n.%6[0-9]%n",
+                 &tm->tm_year, &tm->tm_mon, &tm->tm_mday, &ends[0],
+                 &tm->tm_hour, &tm->tm_min, &tm->tm_sec, &ends[1], frac,
+                 &ends[2]);
+  const int len = text.size();
+  if (!(n == 3 && ends[0] == len) && !(n == 6 && ends[1] == len) &&
+      !(n == 7 && ends[2] == len)) {
+    return false;
+  }
+  if (tm->tm_mon < 0 || tm->tm_mon > 12 || tm->tm_mday < 0 ||
+      tm->tm_mday > 31 || tm->tm_hour < 0 || tm->tm_hour > 23 ||
+      tm->tm_min < 0 || tm->tm_min > 59 || tm->tm_sec < 0 || tm->tm_sec > 59) {
+    return false;
+  }
+  if (n == 7) {
+    *usec = parse_frac(frac);
+  }
+  return true;
+}
+
+/** Encode '[-]HH:MM:SS[.ffffff]' like InnoDB stores a TIME2 column, from
+the packed value of my_time_packed_to_binary(). */
+bool encode_time(const ColumnDef &col, const std::string &text,
+                 std::string *key) {
+  const bool neg = !text.empty() && text[0] == '-';
+  int hour;
+  int min;
+  int sec;
+  char frac[8] = {0};
+  int ends[2] = {-1, -1};
+  int n = sscanf(text.c_str() + neg, "%d:%d:%d%n.%6[0-9]%n", &hour, &min,
+                 &sec, &ends[0], frac, &ends[1]);
+  const int len = text.size() - neg;
+  if ((!(n == 3 && ends[0] == len) && !(n == 4 && ends[1] == len)) ||
+      hour < 0 || hour > 838 || min < 0 || min > 59 || sec < 0 || sec > 59) {
+    return false;
+  }
+  const int64_t intpart = (hour << 12) | (min << 6) | sec;
+  int64_t usec = n == 4 ? parse_frac(frac) : 0;
+  int64_t packed = (intpart << 24) + usec;
+  if (neg) {
+    packed = -packed;
+  }
+  /* Fractional seconds of 1 or 2 bytes are stored apart from the integer
+  part, which is rounded down: -1.25 is stored as -2 and .75 */
+  int64_t ipart = packed / (1 << 24);
+  int64_t fpart = packed % (1 << 24);
+  switch ((col.datetime_precision + 1) / 2) {
+    case 0:
+      append_be(ipart + 0x800000, 3, key);
+      break;
+    case 1:
+      fpart /= 10000;
+      if (fpart < 0) {
+        ipart--;
+        fpart += 100;
+      }
+      append_be(ipart + 0x800000, 3, key);
+      append_be(fpart, 1, key);
+      break;
+    case 2:
+      fpart /= 100;
+      if (fpart < 0) {
+        ipart--;
+        fpart += 10000;
+      }
+      append_be(ipart + 0x800000, 3, key);
+      append_be(fpart, 2, key);
+      break;
+    default:
+      append_be(packed + 0x800000000000LL, 6, key);
+      break;
+  }
+  return true;
+}
+
+/** Append the fractional seconds of a temporal column. */
+void append_frac(uint32_t usec, uint32_t precision, std::string *key) {
+  switch ((precision + 1) / 2) {
+    case 1:
+      append_be(usec / 10000, 1, key);
+      break;
+    case 2:
+      append_be(usec / 100, 2, key);
+      break;
+    case 3:
+      append_be(usec, 3, key);
+      break;
+  }
+}
+
+/** Convert a literal to the stored form of a column.
+@return false if the literal does not fit the column */
+bool encode_literal(const ColumnDef &col, const RecFieldPlan &plan,
+                    const Token &lit, RecPredicate *pred) {
+  if (lit.type != TOK_NUMBER && lit.type != TOK_STRING) {
+    return false;
+  }
+  std::string key;
+  switch (col.type) {
+    case DD_TYPE_TINY:
+    case DD_TYPE_SHORT:
+    case DD_TYPE_INT24:
+    case DD_TYPE_LONG:
+    case DD_TYPE_LONGLONG:
+    case DD_TYPE_YEAR:
+    case DD_TYPE_ENUM:
+    case DD_TYPE_SET:
+    case DD_TYPE_BIT:
+      if (!encode_int(col, plan.fixed_len, lit.text, &key)) {
+        return false;
+      }
+      break;
+    case DD_TYPE_FLOAT:
+    case DD_TYPE_DOUBLE: {
+      char *end = nullptr;
+      double d = strtod(lit.text.c_str(), &end);
+      if (end == lit.text.c_str() || *end != '\0') {
+        return false;
+      }
+      pred->is_double = true;
+      pred->nums.push_back(d);
+      return true;
+    }
+    case DD_TYPE_NEWDATE: {
+      struct tm tm;
+      uint32_t usec;
+      if (!parse_datetime(lit.text, &tm, &usec)) {
+        return false;
+      }
+      uint32_t v = (tm.tm_year << 9) | (tm.tm_mon << 5) | tm.tm_mday;
+      append_be(v ^ 0x800000, 3, &key);
+      break;
+    }
+    case DD_TYPE_DATETIME2: {
+      struct tm tm;
+      uint32_t usec;
+      if (!parse_datetime(lit.text, &tm, &usec)) {
+        return false;
+      }
+      uint64_t ymd = ((uint64_t)(tm.tm_year * 13 + tm.tm_mon) << 5) |
+                     tm.tm_mday;
+      uint64_t hms = (tm.tm_hour << 12) | (tm.tm_min << 6) | tm.tm_sec;
+      append_be(((ymd << 17) | hms) + 0x8000000000ULL, 5, &key);
+      append_frac(usec, col.datetime_precision, &key);
+      break;
+    }
+    case DD_TYPE_TIMESTAMP2: {
+      struct tm tm;
+      uint32_t usec;
+      if (!parse_datetime(lit.text, &tm, &usec)) {
+        return false;
+      }
+      /* TIMESTAMP literals are UTC, like the values printed by dumps */
+      tm.tm_year -= 1900;
+      tm.tm_mon -= 1;
+      time_t secs = timegm(&tm);
+      if (secs < 0 || secs > 0xFFFFFFFFLL) {
+        return false;
+      }
+      append_be(secs, 4, &key);
+      append_frac(usec, col.datetime_precision, &key);
+      break;
+    }
+    case DD_TYPE_TIME2:
+      if (!encode_time(col, lit.text, &key)) {
+        return false;
+      }
+      break;
+    case DD_TYPE_STRING:
+      key = lit.text;
+      /* CHAR values are stored padded with spaces, BINARY values with
+      0x00 that take part in comparisons */
+      if (col.collation_id == 63) {
+        break;
+      }
+      pred->pad_space = true;
+      while (!key.empty() && key[key.size() - 1] == ' ') {
+        key.erase(key.size() - 1);
+      }
+      break;
+    case DD_TYPE_VARCHAR:
+    case DD_TYPE_VAR_STRING:
+    case DD_TYPE_TINY_BLOB:
+    case DD_TYPE_MEDIUM_BLOB:
+    case DD_TYPE_LONG_BLOB:
+    case DD_TYPE_BLOB:
+      key = lit.text;
+      break;
+    default:
+      return false;
+  }
+  pred->keys.push_back(key);
+  return true;
+}
+
+bool op_match(rec_pred_op op, int cmp) {
+  switch (op) {
+    case PRED_EQ:
+      return cmp == 0;
+    case PRED_NE:
+      return cmp != 0;
+    case PRED_LT:
+      return cmp < 0;
+    case PRED_LE:
+      return cmp <= 0;
+    case PRED_GT:
+      return cmp > 0;
+    case PRED_GE:
+      return cmp >= 0;
+    default:
+      return false;
+  }
+}
+
+int compare_double(double a, double b) { return a < b ? -1 : (a > b ? 1 : 0); }
+
+bool pred_match(const RecPredicate &pred, const RecLayout &layout,
+                const rec_t *rec, const ulint *offs) {
+  const bool is_null = rec_offs_field_is_null(offs, pred.field);
+  if (pred.op == PRED_IS_NULL || pred.op == PRED_IS_NOT_NULL) {
+    return is_null == (pred.op == PRED_IS_NULL);
+  }
+  if (is_null || rec_offs_field_is_extern(offs, pred.field)) {
+    return false;
+  }
+  ulint len;
+  const byte *data = rec_field_get(rec, layout, offs, pred.field, &len);
+
+  if (pred.is_double) {
+    double v = 0;
+    if (len == sizeof(float)) {
+      float f;
+      memcpy(&f, data, sizeof(f));
+      v = f;
+    } else if (len == sizeof(double)) {
+      memcpy(&v, data, sizeof(v));
+    }
+    switch (pred.op) {
+      case PRED_BETWEEN:
+        return v >= pred.nums[0] && v <= pred.nums[1];
+      case PRED_IN:
+        return std::find(pred.nums.begin(), pred.nums.end(), v) !=
+               pred.nums.end();
+      default:
+        return op_match(pred.op, compare_double(v, pred.nums[0]));
+    }
+  }
+
+  switch (pred.op) {
+    case PRED_BETWEEN:
+      return rec_field_cmp_key(data, len, pred.keys[0], pred.pad_space) >= 0 &&
+             rec_field_cmp_key(data, len, pred.keys[1], pred.pad_space) <= 0;
+    case PRED_IN: {
+      /* keys are sorted in memcmp() order */
+      size_t lo = 0;
+      size_t hi = pred.keys.size();
+      while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int cmp = rec_field_cmp_key(data, len, pred.keys[mid], pred.pad_space);
+        if (cmp == 0) {
+          return true;
+        }
+        if (cmp < 0) {
+          hi = mid;
+        } else {
+          lo = mid + 1;
+        }
+      }
+      return false;
+    }
+    default:
+      return op_match(pred.op,
+                      rec_field_cmp_key(data, len, pred.keys[0], pred.pad_space));
+  }
+}
+
+}  // namespace
+
+int rec_field_cmp_key(const byte *data, ulint len, const std::string &key,
+                      bool pad_space) {
+  if (pad_space) {
+    while (len > 0 && data[len - 1] == ' ') {
+      len--;
+    }
+  }
+  const size_t n = std::min<size_t>(len, key.size());
+  int cmp = memcmp(data, key.data(), n);
+  if (cmp != 0) {
+    return cmp;
+  }
+  return len < key.size() ? -1 : (len > key.size() ? 1 : 0);
+}
+
+int rec_field_encode(const RecLayout &layout, size_t field,
+                     const std::string &value, std::string *key,
+                     bool *pad_space) {
+  const RecFieldPlan &plan = layout.fields[field];
+  const ColumnDef &col = layout.table->columns[plan.col_no];
+  RecPredicate pred;
+  pred.is_double = false;
+  pred.pad_space = false;
+  Token lit;
+  lit.type = TOK_STRING;
+  lit.text = value;
+  if (!encode_literal(col, plan, lit, &pred) || pred.is_double) {
+    return -1;
+  }
+  *key = pred.keys[0];
+  *pad_space = pred.pad_space;
+  return 0;
+}
+
+int row_filter_compile(const char *where, const RecLayout &layout,
+                       RowFilter *filter) {
+  filter->preds.clear();
+  filter->layout = &layout;
+  if (where == nullptr || *where == '\0') {
+    return 0;
+  }
+  std::vector<Token> toks;
+  if (tokenize(where, &toks) != 0) {
+    return -1;
+  }
+
+  const TableDef &table = *layout.table;
+  size_t i = 0;
+  /* Consume a token, never moving past TOK_END */
+  auto next = [&]() -> const Token & {
+    const Token &tok = toks[i];
+    if (tok.type != TOK_END) {
+      i++;
+    }
+    return tok;
+  };
+  for (;;) {
+    if (toks[i].type != TOK_IDENT) {
+      fprintf(stderr, "[ERROR] --where: expected a column name at '%s'\n",
+              toks[i].text.c_str());
+      return -1;
+    }
+    const std::string &name = next().text;
+    RecPredicate pred;
+    pred.field = layout.fields.size();
+    pred.is_double = false;
+    pred.pad_space = false;
+    for (size_t f = 0; f < layout.fields.size(); f++) {
+      if (layout.fields[f].col_no != REC_FIELD_CHILD_PAGE &&
+          strcasecmp(table.columns[layout.fields[f].col_no].name.c_str(),
+                     name.c_str()) == 0) {
+        pred.field = f;
+        break;
+      }
+    }
+    if (pred.field == layout.fields.size()) {
+      if (table_def_find_column(table, name.c_str()) >= 0) {
+        fprintf(stderr, "[ERROR] --where: column %s is not in index %s\n",
+                name.c_str(), layout.index->name.c_str());
+      } else {
+        fprintf(stderr, "[ERROR] --where: unknown column %s\n", name.c_str());
+      }
+      return -1;
+    }
+    const RecFieldPlan &plan = layout.fields[pred.field];
+    const ColumnDef &col = table.columns[plan.col_no];
+
+    /* Literals of this condition */
+    std::vector<Token> lits;
+    const Token &op = next();
+    if (is_keyword(op, "IS")) {
+      pred.op = PRED_IS_NULL;
+      if (is_keyword(toks[i], "NOT")) {
+        pred.op = PRED_IS_NOT_NULL;
+        i++;
+      }
+      if (!is_keyword(next(), "NULL")) {
+        fprintf(stderr, "[ERROR] --where: expected NULL after IS\n");
+        return -1;
+      }
+    } else if (is_keyword(op, "BETWEEN")) {
+      pred.op = PRED_BETWEEN;
+      lits.push_back(next());
+      if (!is_keyword(next(), "AND")) {
+        fprintf(stderr, "[ERROR] --where: expected AND in BETWEEN\n");
+        return -1;
+      }
+      lits.push_back(next());
+    } else if (is_keyword(op, "IN")) {
+      pred.op = PRED_IN;
+      if (!is_symbol(next(), "(")) {
+        fprintf(stderr, "[ERROR] --where: expected ( after IN\n");
+        return -1;
+      }
+      for (;;) {
+        lits.push_back(next());
+        if (is_symbol(toks[i], ",")) {
+          i++;
+          continue;
+        }
+        if (!is_symbol(next(), ")")) {
+          fprintf(stderr, "[ERROR] --where: expected ) after IN list\n");
+          return -1;
+        }
+        break;
+      }
+    } else if (op.type == TOK_SYMBOL) {
+      static const struct {
+        const char *sym;
+        rec_pred_op op;
+      } ops[] = {{"=", PRED_EQ},  {"!=", PRED_NE}, {"<>", PRED_NE},
+                 {"<", PRED_LT},  {"<=", PRED_LE}, {">", PRED_GT},
+                 {">=", PRED_GE}};
+      size_t k = 0;
+      for (; k < sizeof(ops) / sizeof(ops[0]); k++) {
+        if (op.text == ops[k].sym) {
+          pred.op = ops[k].op;
+          break;
+        }
+      }
+      if (k == sizeof(ops) / sizeof(ops[0])) {
+        fprintf(stderr, "[ERROR] --where: unexpected '%s'\n", op.text.c_str());
+        return -1;
+      }
+      lits.push_back(next());
+    } else {
+      fprintf(stderr, "[ERROR] --where: expected an operator after %s\n",
+              name.c_str());
+      return -1;
+    }
+
+    for (size_t k = 0; k < lits.size(); k++) {
+      if (lits[k].type == TOK_END) {
+        fprintf(stderr, "[ERROR] --where: unexpected end of clause\n");
+        return -1;
+      }
+      if (col.type == DD_TYPE_NEWDECIMAL) {
+        fprintf(stderr,
+                "[ERROR] --where: DECIMAL column %s only supports IS [NOT] "
+                "NULL\n",
+                col.name.c_str());
+        return -1;
+      }
+      if (!encode_literal(col, plan, lits[k], &pred)) {
+        fprintf(stderr, "[ERROR] --where: cannot compare %s (%s) with %s\n",
+                col.name.c_str(), col.column_type_utf8.c_str(),
+                lits[k].text.c_str());
+        return -1;
+      }
+    }
+    if (pred.op == PRED_IN) {
+      std::sort(pred.keys.begin(), pred.keys.end());
+      pred.keys.erase(std::unique(pred.keys.begin(), pred.keys.end()),
+                      pred.keys.end());
+    }
+    filter->preds.push_back(pred);
+
+    if (toks[i].type == TOK_END) {
+      return 0;
+    }
+    const Token &conj = next();
+    if (!is_keyword(conj, "AND")) {
+      fprintf(stderr, "[ERROR] --where: expected AND at '%s'\n",
+              conj.text.c_str());
+      return -1;
+    }
+  }
+}
+
+bool row_filter_match(const RowFilter &filter, const rec_t *rec,
+                      const ulint *offs) {
+  for (size_t i = 0; i < filter.preds.size(); i++) {
+    if (!pred_match(filter.preds[i], *filter.layout, rec, offs)) {
+      return false;
+    }
+  }
+  return true;
+}
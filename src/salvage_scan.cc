@@ -0,0 +1,524 @@
+#include "include/salvage_scan.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+
+/** Number of pages read by one pread() of a salvage reader */
+static const uint32_t SALVAGE_READ_PAGES = 64;
+
+/** Number of rows passed to the callback at a time */
+static const size_t SALVAGE_BATCH_ROWS = 1024;
+
+namespace {
+
+/** Where a copy of a row was found, in the order of preference between
+copies on pages with the same LSN. A purged copy, of the PAGE_FREE list or
+the garbage space, is only kept if the key has no copy on the record list
+of any page: a split or merge moves records and leaves their purged copies
+on the old page, with a higher LSN than the page they moved to. */
+enum salvage_source {
+  SALVAGE_LIVE,
+  SALVAGE_DELETE_MARKED,
+  SALVAGE_FREE_LIST,
+  SALVAGE_GARBAGE
+};
+
+/** Where the newest copy of a row found so far is. Its bytes are left on
+the page, which is read again to return the row. */
+struct SalvageRow {
+  /** FIL_PAGE_LSN of the page the copy was found on */
+  uint64_t lsn;
+  uint32_t page_no;
+  /** Offset of the record origin in the page */
+  uint32_t offset;
+  salvage_source source;
+
+  bool deleted() const { return source != SALVAGE_LIVE; }
+  bool purged() const { return source >= SALVAGE_FREE_LIST; }
+  /** @return whether a copy found on a page with a given LSN replaces
+  this one */
+  bool older_than(uint64_t other_lsn, salvage_source other_source) const {
+    const bool other_purged = other_source >= SALVAGE_FREE_LIST;
+    if (purged() != other_purged) {
+      return purged();
+    }
+    return lsn < other_lsn || (lsn == other_lsn && source > other_source);
+  }
+};
+
+typedef std::unordered_map<std::string, SalvageRow> SalvageMap;
+
+/** What a reader thread needs to know about the index. */
+struct SalvageIndex {
+  const RecLayout *layout;
+  uint64_t index_id;
+  /** Number of leading fields to decode, at least the primary key */
+  size_t n_fields;
+  /** Also collect the purged records of the PAGE_FREE list and the
+  garbage space */
+  bool deleted;
+};
+
+}  // namespace
+
+/** Build the deduplication key of a record from its primary key fields. */
+static void salvage_key(const rec_t *rec, const ulint *offs, size_t n_uniq,
+                        std::string *key) {
+  key->clear();
+  for (size_t i = 0; i < n_uniq; i++) {
+    byte len[4];
+    const ulint n = rec_offs_field_len(offs, i);
+    mach_write_to_4(len, rec_offs_field_is_null(offs, i) ? 0xFFFFFFFF : n);
+    key->append(reinterpret_cast<const char *>(len), sizeof(len));
+    key->append(reinterpret_cast<const char *>(rec) +
+                    rec_offs_field_start(offs, i),
+                n);
+  }
+}
+
+/** Keep the location of a copy of a record if it is the newest one found
+so far.
+@return false if the fields of the record extend past the page */
+static bool salvage_add(const byte *page, uint32_t page_no, const rec_t *rec,
+                        const SalvageIndex &index, uint64_t lsn,
+                        salvage_source source, std::vector<ulint> &offs,
+                        SalvageMap *rows, std::string &key) {
+  rec_layout_get_offsets(rec, *index.layout, offs.data(), index.n_fields);
+  const ulint end = offs[index.n_fields - 1] & REC_OFFS_MASK;
+  if (rec < page + (index.layout->is_compact ? PAGE_NEW_SUPREMUM_END
+                                             : PAGE_OLD_SUPREMUM_END) ||
+      rec + end > page + UNIV_PAGE_SIZE - PAGE_DIR) {
+    return false;
+  }
+
+  salvage_key(rec, offs.data(), index.layout->n_uniq, &key);
+  SalvageMap::iterator it = rows->find(key);
+  if (it != rows->end() && !it->second.older_than(lsn, source)) {
+    return true;
+  }
+  SalvageRow &row = (*rows)[key];
+  row.lsn = lsn;
+  row.page_no = page_no;
+  row.offset = rec - page;
+  row.source = source;
+  return true;
+}
+
+/** Check whether a purged record could start at an offset of the garbage
+space of a leaf page: the header must be that of a leaf record of the
+heap and every field must fit its column and the heap.
+@param[in]	page		leaf page
+@param[in]	rec		candidate record origin
+@param[in]	layout		leaf decode plan of the index
+@param[in]	offs		scratch space for the offsets of all fields
+@return size of the header, or 0 if no record starts at rec */
+static ulint salvage_rec_plausible(const byte *page, const rec_t *rec,
+                                   const RecLayout &layout, ulint *offs) {
+  const ulint heap_top = mach_read_from_2(page + PAGE_HEADER + PAGE_HEAP_TOP);
+  const ulint n_heap =
+      mach_read_from_2(page + PAGE_HEADER + PAGE_N_HEAP) & 0x7FFF;
+  const ulint heap_no = mach_read_from_2(rec - 4) >> 3;
+  const ulint info_mask =
+      REC_INFO_DELETED_FLAG |
+      (layout.is_instant ? REC_INFO_VERSION_FLAG | REC_INFO_INSTANT_FLAG : 0);
+  if (rec_get_status(rec) != REC_STATUS_ORDINARY ||
+      (rec[-5] & 0xF0 & ~info_mask) != 0 ||
+      (rec[-5] & 0x0F) > PAGE_DIR_SLOT_MAX_N_OWNED ||
+      heap_no < PAGE_HEAP_NO_USER_LOW || heap_no >= n_heap) {
+    return 0;
+  }
+
+  /* The longest possible header must not reach below the heap, with a
+  row version or a two byte field count */
+  ulint max_extra = REC_N_NEW_EXTRA_BYTES + (layout.n_nullable + 7) / 8 +
+                    (layout.is_instant ? 2 : 0);
+  for (size_t i = 0; i < layout.fields.size(); i++) {
+    if (!layout.fields[i].fixed_len) {
+      max_extra += 2;
+    }
+  }
+  if ((ulint)(rec - page) < PAGE_NEW_SUPREMUM_END + max_extra) {
+    return 0;
+  }
+
+  rec_layout_get_offsets(rec, layout, offs);
+  for (size_t i = 0; i < layout.fields.size(); i++) {
+    const RecFieldPlan &f = layout.fields[i];
+    const ulint len = rec_offs_field_len(offs, i);
+    if (rec_offs_field_is_null(offs, i) && !f.nullable &&
+        !(offs[i] & REC_OFFS_DEFAULT)) {
+      return 0;
+    }
+    if (rec_offs_field_is_extern(offs, i)
+            ? len < BTR_EXTERN_FIELD_REF_SIZE
+            : len > f.max_len) {
+      return 0;
+    }
+  }
+  if ((ulint)(rec - page) + (offs[layout.fields.size() - 1] & REC_OFFS_MASK) >
+      heap_top) {
+    return 0;
+  }
+  return rec_layout_extra_size(rec, layout);
+}
+
+/** Collect the records of one page if it is a leaf page of the index. */
+static void salvage_page(const byte *page, uint32_t page_no,
+                         const SalvageIndex &index, SalvageMap *rows,
+                         SalvageStats *stats) {
+  if (mach_read_from_2(page + FIL_PAGE_TYPE) != FIL_PAGE_INDEX ||
+      mach_read_from_8(page + PAGE_HEADER + PAGE_INDEX_ID) != index.index_id ||
+      mach_read_from_2(page + PAGE_HEADER + PAGE_LEVEL) != 0 ||
+      page_is_comp(page) != index.layout->is_compact) {
+    return;
+  }
+  if (mach_read_from_4(page + FIL_PAGE_LSN + 4) !=
+      mach_read_from_4(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM +
+                       4)) {
+    stats->n_torn_pages++;
+    return;
+  }
+  stats->n_leaf_pages++;
+  const uint64_t lsn = mach_read_from_8(page + FIL_PAGE_LSN);
+  const RecLayout &layout = *index.layout;
+  std::vector<ulint> offs(layout.fields.size());
+  std::string key;
+  /* Bytes of the page occupied by the records of the two lists */
+  std::vector<bool> used;
+  if (index.deleted) {
+    used.resize(UNIV_PAGE_SIZE);
+  }
+
+  /* The live records, then the purged ones of the PAGE_FREE list */
+  const bool comp = layout.is_compact;
+  const page_rec_next_func_t next_rec = page_rec_next_func(page);
+  const rec_t *lists[2] = {
+      page_first_user_rec(page),
+      mach_read_from_2(page + PAGE_HEADER + PAGE_FREE)
+          ? page + mach_read_from_2(page + PAGE_HEADER + PAGE_FREE)
+          : nullptr};
+  for (int l = 0; l < (index.deleted ? 2 : 1); l++) {
+    size_t n_visited = 0;
+    for (const rec_t *rec = lists[l];
+         rec != nullptr && n_visited < UNIV_PAGE_SIZE / REC_N_NEW_EXTRA_BYTES;
+         rec = next_rec(page, rec), n_visited++) {
+      /* The bound stops at a loop in the chain of a corrupt page */
+      if (comp && rec_get_status(rec) != REC_STATUS_ORDINARY) {
+        continue;
+      }
+      salvage_source source = SALVAGE_FREE_LIST;
+      if (l == 0) {
+        source = rec_get_info_bits(rec, comp) & REC_INFO_DELETED_FLAG
+                     ? SALVAGE_DELETE_MARKED
+                     : SALVAGE_LIVE;
+      }
+      stats->n_records++;
+      if (!salvage_add(page, page_no, rec, index, lsn, source, offs, rows,
+                       key)) {
+        stats->n_bad_records++;
+        continue;
+      }
+      if (l == 1) {
+        stats->n_free_records++;
+      }
+      if (index.deleted) {
+        rec_layout_get_offsets(rec, layout, offs.data());
+        const ulint start = (rec - page) - rec_layout_extra_size(rec, layout);
+        const ulint end = std::min<ulint>(
+            UNIV_PAGE_SIZE,
+            (rec - page) + (offs[layout.fields.size() - 1] & REC_OFFS_MASK));
+        std::fill(used.begin() + std::min<ulint>(start, end),
+                  used.begin() + end, true);
+      }
+    }
+  }
+  if (!index.deleted || !comp) {
+    /* The garbage space of REDUNDANT pages is not searched, their records
+    have no status bits to tell a plausible header. */
+    return;
+  }
+
+  /* Purged records that are on neither list, e.g. the rest of a free
+  record reused for a shorter one, are found by trying every offset of
+  the heap outside of the known records as a record origin. */
+  const ulint heap_top = std::min<ulint>(
+      UNIV_PAGE_SIZE - PAGE_DIR,
+      mach_read_from_2(page + PAGE_HEADER + PAGE_HEAP_TOP));
+  for (ulint off = PAGE_NEW_SUPREMUM_END + REC_N_NEW_EXTRA_BYTES;
+       off < heap_top; off++) {
+    if (used[off] || used[off - 1]) {
+      continue;
+    }
+    const rec_t *rec = page + off;
+    const ulint extra = salvage_rec_plausible(page, rec, layout, offs.data());
+    if (extra == 0) {
+      continue;
+    }
+    const ulint end =
+        off + (offs[layout.fields.size() - 1] & REC_OFFS_MASK);
+    if (std::find(used.begin() + (off - extra), used.begin() + end, true) !=
+        used.begin() + end) {
+      continue;
+    }
+    stats->n_records++;
+    if (!salvage_add(page, page_no, rec, index, lsn, SALVAGE_GARBAGE, offs,
+                     rows, key)) {
+      stats->n_bad_records++;
+      continue;
+    }
+    stats->n_garbage_records++;
+    std::fill(used.begin() + (off - extra), used.begin() + end, true);
+    off = end - 1;
+  }
+}
+
+/** Read the pages [first, last) and collect the rows of the index. */
+static void salvage_range(int fd, const SalvageIndex &index, uint64_t first,
+                          uint64_t last, SalvageMap *rows,
+                          SalvageStats *stats, bool *failed) {
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE,
+                     SALVAGE_READ_PAGES * UNIV_PAGE_SIZE) != 0) {
+    *failed = true;
+    return;
+  }
+  for (uint64_t page_no = first; page_no < last;
+       page_no += SALVAGE_READ_PAGES) {
+    const uint64_t n = std::min<uint64_t>(SALVAGE_READ_PAGES, last - page_no);
+    ssize_t ret = pread(fd, buf, n * UNIV_PAGE_SIZE, page_no * UNIV_PAGE_SIZE);
+    if (ret != (ssize_t)(n * UNIV_PAGE_SIZE)) {
+      fprintf(stderr, "[ERROR] read of pages %lu..%lu failed: %s\n", page_no,
+              page_no + n - 1, ret < 0 ? strerror(errno) : "short read");
+      *failed = true;
+      break;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+      salvage_page(buf + i * UNIV_PAGE_SIZE, page_no + i, index, rows, stats);
+    }
+    stats->n_pages += n;
+  }
+  free(buf);
+}
+
+/** Compare two keys built by salvage_key(), field by field as byte
+strings. */
+static bool salvage_key_less(const std::string &a, const std::string &b,
+                             size_t n_uniq) {
+  size_t a_pos = 0;
+  size_t b_pos = 0;
+  for (size_t i = 0; i < n_uniq; i++) {
+    ulint a_len = mach_read_from_4((const byte *)a.data() + a_pos);
+    ulint b_len = mach_read_from_4((const byte *)b.data() + b_pos);
+    a_len = a_len == 0xFFFFFFFF ? 0 : a_len;
+    b_len = b_len == 0xFFFFFFFF ? 0 : b_len;
+    a_pos += 4;
+    b_pos += 4;
+    int cmp = memcmp(a.data() + a_pos, b.data() + b_pos,
+                     std::min(a_len, b_len));
+    if (cmp != 0) {
+      return cmp < 0;
+    }
+    if (a_len != b_len) {
+      return a_len < b_len;
+    }
+    a_pos += a_len;
+    b_pos += b_len;
+  }
+  return false;
+}
+
+/** Read pages in page number order, each contiguous run with one pread().
+@param[in]	fd		tablespace file
+@param[in]	page_nos	distinct page numbers, sorted
+@param[out]	buf		the pages, in the order of page_nos
+@return 0 on success, -1 on a read error */
+static int salvage_read_pages(int fd, const std::vector<uint32_t> &page_nos,
+                              std::vector<byte> *buf) {
+  buf->resize(page_nos.size() * UNIV_PAGE_SIZE);
+  for (size_t first = 0; first < page_nos.size();) {
+    size_t last = first + 1;
+    while (last < page_nos.size() &&
+           page_nos[last] == page_nos[last - 1] + 1) {
+      last++;
+    }
+    const size_t len = (last - first) * UNIV_PAGE_SIZE;
+    ssize_t ret = pread(fd, &(*buf)[first * UNIV_PAGE_SIZE], len,
+                        (uint64_t)page_nos[first] * UNIV_PAGE_SIZE);
+    if (ret != (ssize_t)len) {
+      fprintf(stderr, "[ERROR] read of pages %u..%u failed: %s\n",
+              page_nos[first], page_nos[last - 1],
+              ret < 0 ? strerror(errno) : "short read");
+      return -1;
+    }
+    first = last;
+  }
+  return 0;
+}
+
+int64_t salvage_scan(int fd, const TableScan &scan, uint32_t n_threads,
+                     bool deleted, const table_page_cb &cb,
+                     SalvageStats *stats) {
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  const uint64_t n_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+
+  SalvageIndex index;
+  index.layout = &scan.leaf_layout;
+  index.index_id = scan.index->id;
+  index.n_fields = std::max<size_t>(scan.n_decode, scan.leaf_layout.n_uniq);
+  index.deleted = deleted;
+
+  if (n_threads == 0) {
+    n_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  /* Give every thread at least one read */
+  n_threads = std::max<uint64_t>(
+      1, std::min<uint64_t>(n_threads, n_pages / SALVAGE_READ_PAGES));
+  const uint64_t per_thread = (n_pages + n_threads - 1) / n_threads;
+
+  std::vector<SalvageMap> rows(n_threads);
+  std::vector<SalvageStats> thread_stats(n_threads);
+  std::unique_ptr<bool[]> failed(new bool[n_threads]());
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < n_threads; t++) {
+    const uint64_t first = std::min(n_pages, t * per_thread);
+    const uint64_t last = std::min(n_pages, first + per_thread);
+    threads.push_back(std::thread(salvage_range, fd, std::cref(index), first,
+                                  last, &rows[t], &thread_stats[t],
+                                  &failed[t]));
+  }
+  for (uint32_t t = 0; t < n_threads; t++) {
+    threads[t].join();
+  }
+
+  *stats = SalvageStats();
+  for (uint32_t t = 0; t < n_threads; t++) {
+    if (failed[t]) {
+      return -1;
+    }
+    stats->n_pages += thread_stats[t].n_pages;
+    stats->n_leaf_pages += thread_stats[t].n_leaf_pages;
+    stats->n_torn_pages += thread_stats[t].n_torn_pages;
+    stats->n_records += thread_stats[t].n_records;
+    stats->n_bad_records += thread_stats[t].n_bad_records;
+    stats->n_free_records += thread_stats[t].n_free_records;
+    stats->n_garbage_records += thread_stats[t].n_garbage_records;
+  }
+
+  /* Merge the copies found by the threads, the newest one wins */
+  SalvageMap &merged = rows[0];
+  for (uint32_t t = 1; t < n_threads; t++) {
+    for (SalvageMap::iterator it = rows[t].begin(); it != rows[t].end(); ++it) {
+      SalvageMap::iterator dst = merged.find(it->first);
+      if (dst == merged.end()) {
+        dst = merged.insert(std::make_pair(it->first, SalvageRow())).first;
+      } else if (!dst->second.older_than(it->second.lsn, it->second.source)) {
+        continue;
+      }
+      dst->second = it->second;
+    }
+    SalvageMap().swap(rows[t]);
+  }
+
+  stats->n_rows = merged.size();
+  typedef SalvageMap::value_type SalvageEntry;
+  std::vector<const SalvageEntry *> found;
+  for (SalvageMap::const_iterator it = merged.begin(); it != merged.end();
+       ++it) {
+    if (it->second.deleted()) {
+      stats->n_deleted++;
+    }
+    if (it->second.deleted() == deleted) {
+      found.push_back(&*it);
+    }
+  }
+  const size_t n_uniq = scan.leaf_layout.n_uniq;
+  std::sort(found.begin(), found.end(),
+            [n_uniq](const SalvageEntry *a, const SalvageEntry *b) {
+              return salvage_key_less(a->first, b->first, n_uniq);
+            });
+
+  /* The rows are returned in primary key order, SALVAGE_BATCH_ROWS at a
+  time: the pages of a batch are read again in page order, each once */
+  PageBatch batch;
+  batch.page_no = FIL_NULL;
+  batch.layout = &scan.leaf_layout;
+  batch.stride = scan.leaf_layout.fields.size();
+  std::vector<uint32_t> page_nos;
+  std::vector<byte> pages;
+  std::vector<ulint> offs(batch.stride);
+  for (size_t start = 0; start < found.size(); start += SALVAGE_BATCH_ROWS) {
+    const size_t end = std::min(found.size(), start + SALVAGE_BATCH_ROWS);
+    page_nos.clear();
+    for (size_t i = start; i < end; i++) {
+      page_nos.push_back(found[i]->second.page_no);
+    }
+    std::sort(page_nos.begin(), page_nos.end());
+    page_nos.erase(std::unique(page_nos.begin(), page_nos.end()),
+                   page_nos.end());
+    if (salvage_read_pages(fd, page_nos, &pages) != 0) {
+      return -1;
+    }
+    batch.recs.clear();
+    batch.offs.clear();
+    for (size_t i = start; i < end; i++) {
+      const SalvageRow &row = found[i]->second;
+      const size_t slot =
+          std::lower_bound(page_nos.begin(), page_nos.end(), row.page_no) -
+          page_nos.begin();
+      const rec_t *rec = &pages[slot * UNIV_PAGE_SIZE + row.offset];
+      rec_layout_get_offsets(rec, scan.leaf_layout, offs.data(),
+                             index.n_fields);
+      stats->n_examined++;
+      if (!row_filter_match(scan.filter, rec, offs.data())) {
+        continue;
+      }
+      batch.recs.push_back(rec);
+      batch.offs.insert(batch.offs.end(), offs.begin(), offs.end());
+    }
+    if (!batch.recs.empty() && !cb(batch)) {
+      break;
+    }
+  }
+  return stats->n_leaf_pages;
+}
+
+void salvage_print_stats(const SalvageStats &stats) {
+  printf("Pages read: %lu\n", stats.n_pages);
+  printf("Leaf pages of the index: %lu\n", stats.n_leaf_pages);
+  if (stats.n_torn_pages > 0) {
+    printf("Torn pages skipped: %lu\n", stats.n_torn_pages);
+  }
+  printf("Record copies: %lu\n", stats.n_records);
+  if (stats.n_bad_records > 0) {
+    printf("Corrupt records skipped: %lu\n", stats.n_bad_records);
+  }
+  if (stats.n_free_records > 0) {
+    printf("Records of the PAGE_FREE lists: %lu\n", stats.n_free_records);
+  }
+  if (stats.n_garbage_records > 0) {
+    printf("Records found in garbage space: %lu\n", stats.n_garbage_records);
+  }
+  printf("Distinct primary keys: %lu\n", stats.n_rows);
+  printf("Deleted rows: %lu\n", stats.n_deleted);
+}
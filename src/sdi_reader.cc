@@ -0,0 +1,175 @@
+#include "include/sdi_reader.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/fsp0fsp.h"
+#include "include/index_scan.h"
+#include "include/lob_reader.h"
+#include "include/page0page.h"
+#include "include/rec.h"
+
+/** Size of the encryption information stored after the extent
+descriptors of page 0 (Encryption::INFO_MAX_SIZE) */
+static const ulint SDI_ENCRYPTION_INFO_MAX_SIZE = 115;
+
+/** Size of an extent descriptor, XDES_SIZE */
+static const ulint SDI_XDES_SIZE =
+    XDES_BITMAP + (FSP_EXTENT_SIZE * XDES_BITS_PER_PAGE + 7) / 8;
+
+/** Offset of the SDI version and root page number in page 0 */
+static const ulint SDI_HEADER_OFFSET =
+    XDES_ARR_OFFSET + SDI_XDES_SIZE * (UNIV_PAGE_SIZE / FSP_EXTENT_SIZE) +
+    SDI_ENCRYPTION_INFO_MAX_SIZE;
+
+/** Version of the SDI header */
+static const uint32_t SDI_VERSION = 1;
+
+/** Offsets of the fields of an SDI leaf record: the key (type, id), the
+system columns, the lengths of the JSON and of its zlib stream, then the
+stream, stored externally when it does not fit the page. */
+static const ulint SDI_REC_TYPE = 0;
+static const ulint SDI_REC_ID = 4;
+static const ulint SDI_REC_UNCOMP_LEN = 4 + 8 + 6 + 7;
+static const ulint SDI_REC_COMP_LEN = SDI_REC_UNCOMP_LEN + 4;
+static const ulint SDI_REC_DATA = SDI_REC_COMP_LEN + 4;
+
+/** Offset of the child page number of an SDI node pointer (type, id) */
+static const ulint SDI_NODE_PTR_CHILD = 4 + 8;
+
+uint32_t sdi_root_page(const byte *page0) {
+  if (mach_read_from_4(page0 + SDI_HEADER_OFFSET) != SDI_VERSION) {
+    return FIL_NULL;
+  }
+  return mach_read_from_4(page0 + SDI_HEADER_OFFSET + 4);
+}
+
+/** Decode one SDI leaf record and inflate its JSON.
+@return 0 on success, -1 on error */
+static int sdi_read_rec(LobReader &lob, const byte *page, const rec_t *rec,
+                        SdiObject *object) {
+  /* No nullable fields, the length of the stream is the only one */
+  ulint len = rec[-(REC_N_NEW_EXTRA_BYTES + 1)];
+  bool is_extern = false;
+  if (len & 0x80) {
+    is_extern = (len & 0x40) != 0;
+    len = ((len & 0x3f) << 8) | rec[-(REC_N_NEW_EXTRA_BYTES + 2)];
+  }
+  if ((ulint)(rec - page) + SDI_REC_DATA + len >
+          UNIV_PAGE_SIZE - FIL_PAGE_DATA_END ||
+      (is_extern && len < BTR_EXTERN_FIELD_REF_SIZE)) {
+    fprintf(stderr, "[ERROR] bad SDI record at offset %u\n",
+            (ulint)(rec - page));
+    return -1;
+  }
+  object->type = mach_read_from_4(rec + SDI_REC_TYPE);
+  object->id = mach_read_from_8(rec + SDI_REC_ID);
+  const ulint uncomp_len = mach_read_from_4(rec + SDI_REC_UNCOMP_LEN);
+  const ulint comp_len = mach_read_from_4(rec + SDI_REC_COMP_LEN);
+
+  const byte *data = rec + SDI_REC_DATA;
+  const ulint local_len = is_extern ? len - BTR_EXTERN_FIELD_REF_SIZE : len;
+  std::string stream(reinterpret_cast<const char *>(data), local_len);
+  /* The rest of the stream is in a chain of FIL_PAGE_SDI_BLOB pages */
+  if (is_extern &&
+      lob.Read(data + local_len, [&stream](const byte *part, ulint n) {
+        stream.append(reinterpret_cast<const char *>(part), n);
+        return true;
+      }) < 0) {
+    return -1;
+  }
+  if (stream.size() != comp_len) {
+    fprintf(stderr, "[ERROR] SDI %u:%lu is %zu bytes, expected %u\n",
+            object->type, object->id, stream.size(), comp_len);
+    return -1;
+  }
+
+  object->json.resize(uncomp_len);
+  uLongf n = uncomp_len;
+  if (uncompress(reinterpret_cast<Bytef *>(&object->json[0]), &n,
+                 reinterpret_cast<const Bytef *>(stream.data()),
+                 stream.size()) != Z_OK ||
+      n != uncomp_len) {
+    fprintf(stderr, "[ERROR] inflate of SDI %u:%lu failed\n", object->type,
+            object->id);
+    return -1;
+  }
+  return 0;
+}
+
+int sdi_read_objects(int fd, std::vector<SdiObject> *objects) {
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  const uint64_t n_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE, UNIV_PAGE_SIZE) != 0) {
+    return -1;
+  }
+  LobReader lob(fd);
+  objects->clear();
+  int ret = -1;
+
+  uint32_t page_no = FIL_NULL;
+  if (page_read(fd, 0, buf) == 0) {
+    page_no = sdi_root_page(buf);
+  }
+  if (page_no == FIL_NULL) {
+    fprintf(stderr, "[ERROR] the tablespace has no SDI\n");
+    free(buf);
+    return -1;
+  }
+
+  /* Descend to the leftmost leaf, then follow the leaf list */
+  uint64_t n_visited = 0;
+  bool leaf = false;
+  while (page_no != FIL_NULL) {
+    if (n_visited++ >= n_pages || page_read(fd, page_no, buf) != 0 ||
+        fil_page_get_type(buf) != FIL_PAGE_SDI) {
+      fprintf(stderr, "[ERROR] bad SDI page %u\n", page_no);
+      break;
+    }
+    if (!leaf && mach_read_from_2(buf + PAGE_HEADER + PAGE_LEVEL) != 0) {
+      const rec_t *rec = page_first_user_rec(buf);
+      if (rec == nullptr) {
+        fprintf(stderr, "[ERROR] empty SDI page %u\n", page_no);
+        break;
+      }
+      page_no = mach_read_from_4(rec + SDI_NODE_PTR_CHILD);
+      continue;
+    }
+    leaf = true;
+
+    const page_rec_next_func_t next_rec = page_rec_next_func(buf);
+    const rec_t *rec = next_rec(buf, page_get_infimum(buf));
+    for (; rec != nullptr; rec = next_rec(buf, rec)) {
+      if (!page_rec_is_live(rec, true)) {
+        continue;
+      }
+      SdiObject object;
+      if (sdi_read_rec(lob, buf, rec, &object) != 0) {
+        break;
+      }
+      objects->push_back(object);
+    }
+    if (rec != nullptr) {
+      break;
+    }
+    page_no = mach_read_from_4(buf + FIL_PAGE_NEXT);
+    if (page_no == FIL_NULL) {
+      ret = 0;
+    }
+  }
+  free(buf);
+  return ret;
+}
@@ -0,0 +1,485 @@
+#include "include/space_usage.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/lob_reader.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+
+/** Number of pages read by one pread() of a usage reader */
+static const uint32_t USAGE_READ_PAGES = 64;
+
+namespace {
+
+/** Externally stored part of a field */
+struct LobRef {
+  /** First page of the LOB or BLOB */
+  uint32_t page_no;
+  /** Field of the clustered index record */
+  uint32_t field;
+
+  bool operator<(const LobRef &other) const { return page_no < other.page_no; }
+};
+
+/** Two linked pages of off-page values: a LOB first page and one of its
+pages, or a BLOB page and the next page of its chain */
+typedef std::pair<uint32_t, uint32_t> PageLink;
+
+/** What a reader thread needs to know about the table. */
+struct UsageTable {
+  const RecLayout *layout;
+  /** PAGE_INDEX_ID of TableDef::indexes */
+  std::vector<uint64_t> index_ids;
+  /** Position of the clustered index in index_ids */
+  size_t clust;
+  uint64_t n_pages;
+};
+
+/** What a reader thread found in its range of pages. */
+struct UsageRange {
+  UsageRange() : failed(false) {}
+
+  SpaceUsage usage;
+  std::vector<LobRef> refs;
+  /** First pages of the new format LOBs */
+  std::vector<uint32_t> lob_firsts;
+  /** (first page, page) for the other pages of the new format LOBs */
+  std::vector<PageLink> lob_pages;
+  /** (page, next page) of the BLOB chains */
+  std::vector<PageLink> chains;
+  bool failed;
+};
+
+}  // namespace
+
+/** @return whether a page type is that of a page of an off-page value of
+a table. The BLOBs of the SDI are not counted, no record of the table
+refers to them. */
+static bool usage_is_lob_page(page_type_t type) {
+  switch (type) {
+    case FIL_PAGE_TYPE_BLOB:
+    case FIL_PAGE_TYPE_ZBLOB:
+    case FIL_PAGE_TYPE_ZBLOB2:
+    case FIL_PAGE_TYPE_LOB_INDEX:
+    case FIL_PAGE_TYPE_LOB_DATA:
+    case FIL_PAGE_TYPE_LOB_FIRST:
+    case FIL_PAGE_TYPE_ZLOB_FIRST:
+    case FIL_PAGE_TYPE_ZLOB_DATA:
+    case FIL_PAGE_TYPE_ZLOB_INDEX:
+    case FIL_PAGE_TYPE_ZLOB_FRAG:
+    case FIL_PAGE_TYPE_ZLOB_FRAG_ENTRY:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/** Measure the fields of the records of a clustered index leaf page and
+collect the references of their externally stored parts. */
+static void usage_leaf_page(const byte *page, const UsageTable &table,
+                            std::vector<ulint> &offs, UsageRange *range) {
+  const RecLayout &layout = *table.layout;
+  SpaceUsage &usage = range->usage;
+  if (page_is_comp(page) != layout.is_compact) {
+    return;
+  }
+  if (mach_read_from_4(page + FIL_PAGE_LSN + 4) !=
+      mach_read_from_4(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM +
+                       4)) {
+    usage.n_torn_pages++;
+    return;
+  }
+  const bool comp = layout.is_compact;
+  const page_rec_next_func_t next_rec = page_rec_next_func(page);
+  const size_t n_fields = layout.fields.size();
+  size_t n_visited = 0;
+  for (const rec_t *rec = page_first_user_rec(page);
+       rec != nullptr && n_visited < UNIV_PAGE_SIZE / REC_N_NEW_EXTRA_BYTES;
+       rec = next_rec(page, rec), n_visited++) {
+    /* The bound stops at a loop in the chain of a corrupt page */
+    if (comp && rec_get_status(rec) != REC_STATUS_ORDINARY) {
+      continue;
+    }
+    rec_layout_get_offsets(rec, layout, offs.data());
+    if (rec + (offs[n_fields - 1] & REC_OFFS_MASK) >
+        page + UNIV_PAGE_SIZE - PAGE_DIR) {
+      continue;
+    }
+    usage.n_recs++;
+    usage.header_bytes += rec_layout_extra_size(rec, layout);
+    for (size_t i = 0; i < n_fields; i++) {
+      ColumnUsage &col = usage.columns[i];
+      if (rec_offs_field_is_null(offs.data(), i)) {
+        col.n_null++;
+        continue;
+      }
+      const ulint len = rec_offs_field_len(offs.data(), i);
+      col.n_values++;
+      col.inrow_bytes += len;
+      if (!rec_offs_field_is_extern(offs.data(), i) ||
+          len < BTR_EXTERN_FIELD_REF_SIZE) {
+        continue;
+      }
+      const byte *ref = rec + rec_offs_field_start(offs.data(), i) + len -
+                        BTR_EXTERN_FIELD_REF_SIZE;
+      const ulint extern_len = mach_read_from_4(ref + BTR_EXTERN_LEN + 4);
+      col.n_extern++;
+      col.extern_bytes += extern_len;
+      if (extern_len > 0) {
+        LobRef lob_ref;
+        lob_ref.page_no = mach_read_from_4(ref + BTR_EXTERN_PAGE_NO);
+        lob_ref.field = i;
+        range->refs.push_back(lob_ref);
+      }
+    }
+  }
+}
+
+/** Collect the pages of a new format LOB: the pages of the entries of its
+index list and of their older versions, and the LOB index pages holding
+entries. The entries of the first page are read from it, the index pages
+are read into buf. */
+static void usage_lob_first(int fd, uint32_t first_page_no, const byte *first,
+                            const UsageTable &table, byte *buf,
+                            UsageRange *range) {
+  range->lob_firsts.push_back(first_page_no);
+  uint32_t buf_page_no = FIL_NULL;
+  /* Get the entry at an address, reading its index page if needed */
+  const auto entry_at = [&](const fil_addr_t &addr) -> const byte * {
+    if (addr.boffset < FIL_PAGE_DATA ||
+        addr.boffset + (ulint)BlobIndexEntry::SIZE >
+            UNIV_PAGE_SIZE - FIL_PAGE_DATA_END) {
+      return nullptr;
+    }
+    if (addr.page == first_page_no) {
+      return first + addr.boffset;
+    }
+    if (addr.page != buf_page_no) {
+      if (addr.page >= table.n_pages || page_read(fd, addr.page, buf) != 0 ||
+          fil_page_get_type(buf) != FIL_PAGE_TYPE_LOB_INDEX) {
+        return nullptr;
+      }
+      buf_page_no = addr.page;
+      range->lob_pages.push_back(PageLink(first_page_no, addr.page));
+    }
+    return buf + addr.boffset;
+  };
+  const auto add_page = [&](const byte *entry) {
+    const uint32_t page_no =
+        mach_read_from_4(entry + (ulint)BlobIndexEntry::OFFSET_PAGE_NO);
+    if (page_no != first_page_no && page_no < table.n_pages) {
+      range->lob_pages.push_back(PageLink(first_page_no, page_no));
+    }
+  };
+
+  const byte *base = first + (ulint)BlobFirstPage::OFFSET_INDEX_LIST;
+  const ulint n_entries = std::min<uint64_t>(flst_get_len(base), table.n_pages);
+  fil_addr_t addr = flst_get_first(base);
+  for (ulint i = 0; i < n_entries; i++) {
+    const byte *entry = entry_at(addr);
+    if (entry == nullptr) {
+      return;
+    }
+    add_page(entry);
+    addr = flst_get_next_addr(entry);
+    /* The older versions of the entry, after a partial update */
+    const byte *versions = entry + (ulint)BlobIndexEntry::OFFSET_VERSIONS;
+    const ulint n_versions =
+        std::min<uint64_t>(flst_get_len(versions), table.n_pages);
+    fil_addr_t version_addr = flst_get_first(versions);
+    for (ulint v = 0; v < n_versions; v++) {
+      const byte *version = entry_at(version_addr);
+      if (version == nullptr) {
+        break;
+      }
+      add_page(version);
+      version_addr = flst_get_next_addr(version);
+    }
+  }
+}
+
+/** Account for one page. */
+static void usage_page(int fd, uint32_t page_no, const byte *page,
+                       const UsageTable &table, std::vector<ulint> &offs,
+                       byte *buf, UsageRange *range) {
+  const page_type_t type = fil_page_get_type(page);
+  if (usage_is_lob_page(type)) {
+    range->usage.n_lob_pages++;
+  }
+  switch (type) {
+    case FIL_PAGE_INDEX: {
+      const uint64_t index_id = mach_read_from_8(page + PAGE_HEADER + PAGE_INDEX_ID);
+      const size_t i =
+          std::find(table.index_ids.begin(), table.index_ids.end(), index_id) -
+          table.index_ids.begin();
+      if (i == table.index_ids.size()) {
+        break;
+      }
+      IndexUsage &index = range->usage.indexes[i];
+      if (mach_read_from_2(page + PAGE_HEADER + PAGE_LEVEL) != 0) {
+        index.n_node_pages++;
+        break;
+      }
+      index.n_leaf_pages++;
+      index.n_recs += mach_read_from_2(page + PAGE_HEADER + PAGE_N_RECS);
+      const ulint heap_top =
+          mach_read_from_2(page + PAGE_HEADER + PAGE_HEAP_TOP);
+      const ulint heap_bottom =
+          page_is_comp(page) ? PAGE_NEW_SUPREMUM_END : PAGE_OLD_SUPREMUM_END;
+      const ulint garbage = mach_read_from_2(page + PAGE_HEADER + PAGE_GARBAGE);
+      if (heap_top > heap_bottom + garbage && heap_top <= UNIV_PAGE_SIZE) {
+        index.data_bytes += heap_top - heap_bottom - garbage;
+      }
+      if (i == table.clust) {
+        usage_leaf_page(page, table, offs, range);
+      }
+      break;
+    }
+    case FIL_PAGE_TYPE_BLOB:
+      range->chains.push_back(PageLink(
+          page_no,
+          mach_read_from_4(page + FIL_PAGE_DATA + BTR_BLOB_HDR_NEXT_PAGE_NO)));
+      break;
+    case FIL_PAGE_TYPE_ZBLOB:
+    case FIL_PAGE_TYPE_ZBLOB2:
+      /* The chain of the compressed BLOBs written by InnoDB is linked
+      through FIL_PAGE_NEXT from the first page on */
+      range->chains.push_back(
+          PageLink(page_no, mach_read_from_4(page + FIL_PAGE_NEXT)));
+      break;
+    case FIL_PAGE_TYPE_LOB_FIRST:
+      usage_lob_first(fd, page_no, page, table, buf, range);
+      break;
+    default:
+      break;
+  }
+}
+
+/** Read the pages [first, last) and account for them. */
+static void usage_range(int fd, const UsageTable &table, uint64_t first,
+                        uint64_t last, UsageRange *range) {
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE,
+                     (USAGE_READ_PAGES + 1) * UNIV_PAGE_SIZE) != 0) {
+    range->failed = true;
+    return;
+  }
+  byte *index_buf = buf + USAGE_READ_PAGES * UNIV_PAGE_SIZE;
+  std::vector<ulint> offs(table.layout->fields.size());
+  for (uint64_t page_no = first; page_no < last;
+       page_no += USAGE_READ_PAGES) {
+    const uint64_t n = std::min<uint64_t>(USAGE_READ_PAGES, last - page_no);
+    ssize_t ret = pread(fd, buf, n * UNIV_PAGE_SIZE, page_no * UNIV_PAGE_SIZE);
+    if (ret != (ssize_t)(n * UNIV_PAGE_SIZE)) {
+      fprintf(stderr, "[ERROR] read of pages %lu..%lu failed: %s\n", page_no,
+              page_no + n - 1, ret < 0 ? strerror(errno) : "short read");
+      range->failed = true;
+      break;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+      usage_page(fd, page_no + i, buf + i * UNIV_PAGE_SIZE, table, offs,
+                 index_buf, range);
+    }
+    range->usage.n_pages += n;
+  }
+  free(buf);
+}
+
+/** Count the pages of the off-page value starting at a page.
+@return number of pages, 0 if no LOB or BLOB starts at the page */
+static uint64_t usage_lob_size(uint32_t page_no, const UsageRange &all) {
+  if (std::binary_search(all.lob_firsts.begin(), all.lob_firsts.end(),
+                         page_no)) {
+    std::pair<std::vector<PageLink>::const_iterator,
+              std::vector<PageLink>::const_iterator>
+        pages = std::equal_range(all.lob_pages.begin(), all.lob_pages.end(),
+                                 PageLink(page_no, 0),
+                                 [](const PageLink &a, const PageLink &b) {
+                                   return a.first < b.first;
+                                 });
+    return 1 + (pages.second - pages.first);
+  }
+  /* A BLOB chain, bounded by the number of BLOB pages in case it loops */
+  uint64_t n = 0;
+  uint32_t next = page_no;
+  while (n < all.chains.size()) {
+    std::vector<PageLink>::const_iterator it = std::lower_bound(
+        all.chains.begin(), all.chains.end(), PageLink(next, 0));
+    if (it == all.chains.end() || it->first != next) {
+      break;
+    }
+    n++;
+    next = it->second;
+  }
+  return n;
+}
+
+int space_usage_scan(int fd, const TableScan &scan, uint32_t n_threads,
+                     SpaceUsage *usage) {
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  UsageTable table;
+  table.layout = &scan.leaf_layout;
+  table.n_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+  table.clust = 0;
+  for (size_t i = 0; i < scan.table.indexes.size(); i++) {
+    if (&scan.table.indexes[i] == scan.index) {
+      table.clust = i;
+    }
+    table.index_ids.push_back(scan.table.indexes[i].id);
+  }
+
+  if (n_threads == 0) {
+    n_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  /* Give every thread at least one read */
+  n_threads = std::max<uint64_t>(
+      1, std::min<uint64_t>(n_threads, table.n_pages / USAGE_READ_PAGES));
+  const uint64_t per_thread = (table.n_pages + n_threads - 1) / n_threads;
+
+  std::vector<UsageRange> ranges(n_threads);
+  for (uint32_t t = 0; t < n_threads; t++) {
+    ranges[t].usage.columns.resize(scan.leaf_layout.fields.size());
+    ranges[t].usage.indexes.resize(table.index_ids.size());
+  }
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < n_threads; t++) {
+    const uint64_t first = std::min(table.n_pages, t * per_thread);
+    const uint64_t last = std::min(table.n_pages, first + per_thread);
+    threads.push_back(std::thread(usage_range, fd, std::cref(table), first,
+                                  last, &ranges[t]));
+  }
+  for (uint32_t t = 0; t < n_threads; t++) {
+    threads[t].join();
+  }
+
+  /* The ranges are in page order, so are the first pages and the chains
+  once appended */
+  UsageRange &all = ranges[0];
+  for (uint32_t t = 0; t < n_threads; t++) {
+    if (ranges[t].failed) {
+      return -1;
+    }
+    if (t == 0) {
+      continue;
+    }
+    const SpaceUsage &u = ranges[t].usage;
+    all.usage.n_pages += u.n_pages;
+    all.usage.n_torn_pages += u.n_torn_pages;
+    all.usage.n_recs += u.n_recs;
+    all.usage.header_bytes += u.header_bytes;
+    all.usage.n_lob_pages += u.n_lob_pages;
+    for (size_t i = 0; i < u.columns.size(); i++) {
+      ColumnUsage &col = all.usage.columns[i];
+      col.n_values += u.columns[i].n_values;
+      col.n_null += u.columns[i].n_null;
+      col.inrow_bytes += u.columns[i].inrow_bytes;
+      col.n_extern += u.columns[i].n_extern;
+      col.extern_bytes += u.columns[i].extern_bytes;
+    }
+    for (size_t i = 0; i < u.indexes.size(); i++) {
+      IndexUsage &index = all.usage.indexes[i];
+      index.n_leaf_pages += u.indexes[i].n_leaf_pages;
+      index.n_node_pages += u.indexes[i].n_node_pages;
+      index.n_recs += u.indexes[i].n_recs;
+      index.data_bytes += u.indexes[i].data_bytes;
+    }
+    all.refs.insert(all.refs.end(), ranges[t].refs.begin(),
+                    ranges[t].refs.end());
+    all.lob_firsts.insert(all.lob_firsts.end(), ranges[t].lob_firsts.begin(),
+                          ranges[t].lob_firsts.end());
+    all.lob_pages.insert(all.lob_pages.end(), ranges[t].lob_pages.begin(),
+                         ranges[t].lob_pages.end());
+    all.chains.insert(all.chains.end(), ranges[t].chains.begin(),
+                      ranges[t].chains.end());
+  }
+
+  /* A page of a LOB may be reached from several entries, e.g. an index
+  page, and every LOB is counted once whatever the number of records that
+  refer to it */
+  std::sort(all.lob_pages.begin(), all.lob_pages.end());
+  all.lob_pages.erase(std::unique(all.lob_pages.begin(), all.lob_pages.end()),
+                      all.lob_pages.end());
+  std::sort(all.refs.begin(), all.refs.end());
+  for (size_t i = 0; i < all.refs.size(); i++) {
+    if (i > 0 && all.refs[i].page_no == all.refs[i - 1].page_no) {
+      continue;
+    }
+    const uint64_t n = usage_lob_size(all.refs[i].page_no, all);
+    if (n == 0) {
+      all.usage.n_dangling++;
+      continue;
+    }
+    all.usage.n_lobs++;
+    all.usage.columns[all.refs[i].field].lob_pages += n;
+  }
+  *usage = all.usage;
+  return 0;
+}
+
+/** @return part of a total as a percentage */
+static double usage_percent(uint64_t part, uint64_t total) {
+  return total == 0 ? 0.0 : (double)part * 100.0 / (double)total;
+}
+
+void space_usage_print(const TableScan &scan, const SpaceUsage &usage) {
+  uint64_t total = usage.header_bytes;
+  uint64_t lob_pages = 0;
+  for (size_t i = 0; i < usage.columns.size(); i++) {
+    total += usage.columns[i].inrow_bytes +
+             usage.columns[i].lob_pages * UNIV_PAGE_SIZE;
+    lob_pages += usage.columns[i].lob_pages;
+  }
+  printf("Pages read: %lu\n", usage.n_pages);
+  if (usage.n_torn_pages > 0) {
+    printf("Torn pages skipped: %lu\n", usage.n_torn_pages);
+  }
+  printf("Records of the clustered index: %lu\n", usage.n_recs);
+  printf("%-24s %12s %12s %16s %12s %16s %12s %7s\n", "Column", "Values",
+         "NULL", "In-row bytes", "Off-page", "Off-page bytes", "LOB pages",
+         "Share");
+  for (size_t i = 0; i < usage.columns.size(); i++) {
+    const ColumnUsage &col = usage.columns[i];
+    const uint64_t bytes = col.inrow_bytes + col.lob_pages * UNIV_PAGE_SIZE;
+    printf("%-24s %12lu %12lu %16lu %12lu %16lu %12lu %6.2f%%\n",
+           scan.table.columns[scan.leaf_layout.fields[i].col_no].name.c_str(),
+           col.n_values, col.n_null, col.inrow_bytes, col.n_extern,
+           col.extern_bytes, col.lob_pages, usage_percent(bytes, total));
+  }
+  printf("%-24s %12s %12s %16lu %12s %16s %12s %6.2f%%\n", "(record headers)",
+         "", "", usage.header_bytes, "", "", "",
+         usage_percent(usage.header_bytes, total));
+  printf("Off-page values: %lu in %lu pages\n", usage.n_lobs, lob_pages);
+  if (usage.n_dangling > 0) {
+    printf("References to no LOB: %lu\n", usage.n_dangling);
+  }
+  printf("LOB pages in the file: %lu, referenced by no record: %lu\n",
+         usage.n_lob_pages,
+         usage.n_lob_pages > lob_pages ? usage.n_lob_pages - lob_pages : 0);
+
+  printf("%-24s %12s %12s %12s %16s %7s\n", "Index", "Leaf pages",
+         "Node pages", "Records", "Data bytes", "Fill");
+  for (size_t i = 0; i < usage.indexes.size(); i++) {
+    const IndexUsage &index = usage.indexes[i];
+    printf("%-24s %12lu %12lu %12lu %16lu %6.2f%%\n",
+           scan.table.indexes[i].name.c_str(), index.n_leaf_pages,
+           index.n_node_pages, index.n_recs, index.data_bytes,
+           usage_percent(index.data_bytes,
+                         index.n_leaf_pages * UNIV_PAGE_SIZE));
+  }
+}
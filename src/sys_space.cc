@@ -0,0 +1,337 @@
+#include "include/sys_space.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "include/fsp0types.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+
+/** Number of pages read by one pread() of a page type reader */
+static const uint32_t SYS_SPACE_READ_PAGES = 64;
+
+/** Parse a data file size: a number followed by K, M, G or T.
+@return the size in bytes, 0 if malformed */
+static uint64_t sys_space_parse_size(const std::string &s) {
+  if (s.size() < 2) {
+    return 0;
+  }
+  char *end = nullptr;
+  const uint64_t n = strtoull(s.c_str(), &end, 10);
+  if (end != s.c_str() + s.size() - 1) {
+    return 0;
+  }
+  switch (*end) {
+    case 'K':
+    case 'k':
+      return n << 10;
+    case 'M':
+    case 'm':
+      return n << 20;
+    case 'G':
+    case 'g':
+      return n << 30;
+    case 'T':
+    case 't':
+      return n << 40;
+    default:
+      return 0;
+  }
+}
+
+bool sys_space_is_multi_file(const char *spec) {
+  return strpbrk(spec, ",;:") != nullptr;
+}
+
+int sys_space_parse(const char *spec, std::vector<SysDataFile> *files) {
+  files->clear();
+  const char *p = spec;
+  while (true) {
+    const char *end = p + strcspn(p, ",;");
+    const std::string entry(p, end - p);
+    std::vector<std::string> tokens;
+    for (size_t pos = 0;;) {
+      const size_t colon = entry.find(':', pos);
+      tokens.push_back(entry.substr(pos, colon - pos));
+      if (colon == std::string::npos) {
+        break;
+      }
+      pos = colon + 1;
+    }
+    SysDataFile file;
+    file.file_name = tokens[0];
+    if (file.file_name.empty()) {
+      fprintf(stderr, "[ERROR] empty data file name in %s\n", spec);
+      return -1;
+    }
+    for (size_t t = 1; t < tokens.size(); t++) {
+      if (tokens[t] == "autoextend") {
+        file.autoextend = true;
+      } else if (tokens[t] == "max" && t + 1 < tokens.size()) {
+        /* The size limit of an autoextending file */
+        t++;
+      } else if (t == 1 && sys_space_parse_size(tokens[t]) != 0) {
+        file.n_pages = sys_space_parse_size(tokens[t]) / UNIV_PAGE_SIZE;
+      } else {
+        fprintf(stderr, "[ERROR] invalid data file %s\n", entry.c_str());
+        return -1;
+      }
+    }
+    files->push_back(file);
+    if (*end == '\0') {
+      break;
+    }
+    p = end + 1;
+  }
+  for (size_t i = 0; i + 1 < files->size(); i++) {
+    if ((*files)[i].autoextend) {
+      fprintf(stderr, "[ERROR] only the last data file can autoextend: %s\n",
+              spec);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+SysSpace::~SysSpace() {
+  for (size_t i = 0; i < files_.size(); i++) {
+    if (files_[i].fd != -1) {
+      close(files_[i].fd);
+    }
+  }
+}
+
+int SysSpace::Open(const char *spec) {
+  if (sys_space_parse(spec, &files_) != 0) {
+    return -1;
+  }
+  n_pages_ = 0;
+  for (size_t i = 0; i < files_.size(); i++) {
+    SysDataFile &file = files_[i];
+    file.fd = open(file.file_name.c_str(), O_RDONLY);
+    struct stat stat_buf;
+    if (file.fd == -1 || fstat(file.fd, &stat_buf) == -1) {
+      fprintf(stderr, "[ERROR] Open %s failed: %s\n", file.file_name.c_str(),
+              strerror(errno));
+      return -1;
+    }
+    const uint64_t on_disk = stat_buf.st_size / UNIV_PAGE_SIZE;
+    /* The page numbers of a file follow the declared sizes of the files
+    before it, only the last file can grow past its declared size */
+    if (file.n_pages == 0 ||
+        (i + 1 == files_.size() && on_disk > file.n_pages)) {
+      file.n_pages = on_disk;
+    } else if (on_disk != file.n_pages) {
+      fprintf(stderr,
+              "[WARN] %s has %lu pages, %u declared, the pages of the next "
+              "files are numbered by the declared size\n",
+              file.file_name.c_str(), on_disk, file.n_pages);
+    }
+    file.first_page = n_pages_;
+    n_pages_ += file.n_pages;
+    if (n_pages_ > FIL_NULL) {
+      fprintf(stderr, "[ERROR] %s: more pages than a tablespace can hold\n",
+              spec);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int SysSpace::Locate(uint32_t page_no, size_t *file, uint64_t *offset) const {
+  /* The first file whose pages end after page_no */
+  const auto it = std::upper_bound(
+      files_.begin(), files_.end(), page_no,
+      [](uint32_t p, const SysDataFile &f) {
+        return p < (uint64_t)f.first_page + f.n_pages;
+      });
+  if (it == files_.end()) {
+    return -1;
+  }
+  *file = it - files_.begin();
+  *offset = (uint64_t)(page_no - it->first_page) * UNIV_PAGE_SIZE;
+  return 0;
+}
+
+int SysSpace::ReadPages(uint32_t page_no, uint32_t n_pages, byte *buf) const {
+  while (n_pages > 0) {
+    size_t f;
+    uint64_t offset;
+    if (Locate(page_no, &f, &offset) != 0) {
+      return -1;
+    }
+    const SysDataFile &file = files_[f];
+    const uint32_t n =
+        std::min<uint64_t>(n_pages, file.first_page + file.n_pages - page_no);
+    const ssize_t len = (ssize_t)n * UNIV_PAGE_SIZE;
+    if (pread(file.fd, buf, len, offset) != len) {
+      return -1;
+    }
+    page_no += n;
+    n_pages -= n;
+    buf += len;
+  }
+  return 0;
+}
+
+namespace {
+
+/** Pages of one file read by a reader thread. */
+struct PageTypeRange {
+  PageTypeRange()
+      : fd(-1), first_page(0), n_pages(0), offset(0), failed(false) {}
+
+  int fd;
+  uint32_t first_page;
+  uint32_t n_pages;
+  /** Byte offset of the first page in the file */
+  uint64_t offset;
+  std::vector<PageTypeRun> runs;
+  bool failed;
+};
+
+}  // namespace
+
+static void append_run(std::vector<PageTypeRun> *runs, uint32_t page_no,
+                       uint32_t n_pages, page_type_t type) {
+  if (!runs->empty() && runs->back().type == type &&
+      runs->back().first_page + runs->back().n_pages == page_no) {
+    runs->back().n_pages += n_pages;
+    return;
+  }
+  PageTypeRun run;
+  run.first_page = page_no;
+  run.n_pages = n_pages;
+  run.type = type;
+  runs->push_back(run);
+}
+
+static void page_type_reader(std::vector<PageTypeRange> *ranges,
+                             std::atomic<size_t> *next) {
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE,
+                     SYS_SPACE_READ_PAGES * UNIV_PAGE_SIZE) != 0) {
+    return;
+  }
+  for (size_t r = (*next)++; r < ranges->size(); r = (*next)++) {
+    PageTypeRange &range = (*ranges)[r];
+    for (uint32_t i = 0; i < range.n_pages; i += SYS_SPACE_READ_PAGES) {
+      const uint32_t n =
+          std::min<uint32_t>(SYS_SPACE_READ_PAGES, range.n_pages - i);
+      const ssize_t len = (ssize_t)n * UNIV_PAGE_SIZE;
+      if (pread(range.fd, buf, len,
+                range.offset + (uint64_t)i * UNIV_PAGE_SIZE) != len) {
+        range.failed = true;
+        break;
+      }
+      for (uint32_t p = 0; p < n; p++) {
+        append_run(&range.runs, range.first_page + i + p, 1,
+                   fil_page_get_type(buf + (size_t)p * UNIV_PAGE_SIZE));
+      }
+    }
+  }
+  free(buf);
+}
+
+int sys_space_page_types(const SysSpace &space, uint32_t n_threads,
+                         std::vector<PageTypeRun> *runs) {
+  runs->clear();
+  if (n_threads == 0) {
+    n_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  /* Ranges of about a thread's share of the pages, none across files, so
+  that the files are read at the same time */
+  const uint64_t per_thread = std::max<uint64_t>(
+      SYS_SPACE_READ_PAGES, (space.n_pages() + n_threads - 1) / n_threads);
+  std::vector<PageTypeRange> ranges;
+  for (const SysDataFile &file : space.files()) {
+    for (uint64_t p = 0; p < file.n_pages; p += per_thread) {
+      PageTypeRange range;
+      range.fd = file.fd;
+      range.first_page = file.first_page + p;
+      range.n_pages = std::min<uint64_t>(per_thread, file.n_pages - p);
+      range.offset = p * UNIV_PAGE_SIZE;
+      ranges.push_back(range);
+    }
+  }
+  n_threads = std::max<size_t>(1, std::min<size_t>(n_threads, ranges.size()));
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < n_threads; t++) {
+    threads.push_back(std::thread(page_type_reader, &ranges, &next));
+  }
+  for (uint32_t t = 0; t < n_threads; t++) {
+    threads[t].join();
+  }
+  for (const PageTypeRange &range : ranges) {
+    if (range.failed) {
+      fprintf(stderr, "[ERROR] read of pages %u..%u failed\n",
+              range.first_page, range.first_page + range.n_pages - 1);
+      return -1;
+    }
+    for (const PageTypeRun &run : range.runs) {
+      append_run(runs, run.first_page, run.n_pages, run.type);
+    }
+  }
+  return 0;
+}
+
+int trx_sys_decode(const byte *page, TrxSysInfo *info) {
+  if (fil_page_get_type(page) != FIL_PAGE_TYPE_TRX_SYS) {
+    return -1;
+  }
+  const byte *sys_header = page + TRX_SYS;
+  info->max_trx_id = mach_read_from_8(sys_header + TRX_SYS_TRX_ID_STORE);
+
+  info->rsegs.clear();
+  for (uint32_t slot = 0; slot < TRX_SYS_N_RSEGS; slot++) {
+    const byte *s =
+        sys_header + TRX_SYS_RSEGS + slot * TRX_SYS_RSEG_SLOT_SIZE;
+    TrxSysInfo::Rseg rseg;
+    rseg.slot = slot;
+    rseg.space_id = mach_read_from_4(s + TRX_SYS_RSEG_SPACE);
+    rseg.page_no = mach_read_from_4(s + TRX_SYS_RSEG_PAGE_NO);
+    if (rseg.page_no != FIL_NULL && rseg.space_id != FIL_NULL) {
+      info->rsegs.push_back(rseg);
+    }
+  }
+
+  const byte *log_info = sys_header + TRX_SYS_MYSQL_LOG_INFO;
+  info->has_binlog =
+      mach_read_from_4(log_info + TRX_SYS_MYSQL_LOG_MAGIC_N_FLD) ==
+      TRX_SYS_MYSQL_LOG_MAGIC_N;
+  info->binlog_name.clear();
+  info->binlog_offset = 0;
+  if (info->has_binlog) {
+    const char *name =
+        reinterpret_cast<const char *>(log_info + TRX_SYS_MYSQL_LOG_NAME);
+    info->binlog_name.assign(name, strnlen(name, TRX_SYS_MYSQL_LOG_NAME_LEN));
+    info->binlog_offset =
+        (uint64_t)mach_read_from_4(log_info + TRX_SYS_MYSQL_LOG_OFFSET_HIGH)
+            << 32 |
+        mach_read_from_4(log_info + TRX_SYS_MYSQL_LOG_OFFSET_LOW);
+  }
+
+  const byte *doublewrite = page + TRX_SYS_DOUBLEWRITE;
+  info->has_doublewrite =
+      mach_read_from_4(doublewrite + TRX_SYS_DOUBLEWRITE_MAGIC) ==
+      TRX_SYS_DOUBLEWRITE_MAGIC_N;
+  info->doublewrite_block1 =
+      info->has_doublewrite
+          ? mach_read_from_4(doublewrite + TRX_SYS_DOUBLEWRITE_BLOCK1)
+          : 0;
+  info->doublewrite_block2 =
+      info->has_doublewrite
+          ? mach_read_from_4(doublewrite + TRX_SYS_DOUBLEWRITE_BLOCK2)
+          : 0;
+  return 0;
+}
@@ -0,0 +1,712 @@
+#include "include/table_def.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+
+#include <zlib.h>
+
+#include <rapidjson/error/en.h>
+
+#include "include/fil0fil.h"
+#include "include/fil0types.h"
+#include "include/sdi_reader.h"
+
+uint32_t collation_mbmaxlen(uint32_t collation_id) {
+  switch (collation_id) {
+    case 1: case 84:                  /* big5 */
+    case 13: case 88:                 /* sjis */
+    case 19: case 85:                 /* euckr */
+    case 24: case 86:                 /* gb2312 */
+    case 28: case 87:                 /* gbk */
+    case 95: case 96:                 /* cp932 */
+    case 35: case 90:                 /* ucs2 */
+      return 2;
+    case 12: case 91:                 /* ujis */
+    case 97: case 98:                 /* eucjpms */
+    case 33: case 76: case 83:        /* utf8mb3 */
+      return 3;
+    case 45: case 46:                 /* utf8mb4 */
+    case 248: case 249: case 250:     /* gb18030 */
+      return 4;
+    default:
+      break;
+  }
+  if (collation_id >= 128 && collation_id <= 151) {
+    return 2; /* ucs2 */
+  }
+  if (collation_id >= 192 && collation_id <= 215) {
+    return 3; /* utf8mb3 */
+  }
+  if (collation_id >= 224 && collation_id <= 247) {
+    return 4; /* utf8mb4 */
+  }
+  if (collation_id >= 255 && collation_id <= 323) {
+    return 4; /* utf8mb4, 8.0 collations */
+  }
+  /* latin1, binary, ascii and the other single byte character sets */
+  return 1;
+}
+
+bool collation_is_latin1(uint32_t collation_id) {
+  switch (collation_id) {
+    case 5: case 8: case 15: case 31: /* latin1 */
+    case 47: case 48: case 49: case 94:
+    case 11: case 65:                 /* ascii */
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool dd_properties_get(const std::string &props, const char *key,
+                       std::string *value) {
+  size_t key_len = strlen(key);
+  size_t pos = 0;
+  while (pos < props.size()) {
+    size_t end = props.find(';', pos);
+    if (end == std::string::npos) {
+      end = props.size();
+    }
+    if (end - pos > key_len && props.compare(pos, key_len, key) == 0 &&
+        props[pos + key_len] == '=') {
+      value->assign(props, pos + key_len + 1, end - pos - key_len - 1);
+      return true;
+    }
+    pos = end + 1;
+  }
+  return false;
+}
+
+static uint32_t json_get_uint(const rapidjson::Value &v, const char *name) {
+  if (!v.HasMember(name)) {
+    return 0;
+  }
+  const rapidjson::Value &m = v[name];
+  if (m.IsUint()) {
+    return m.GetUint();
+  }
+  if (m.IsBool()) {
+    return m.GetBool() ? 1 : 0;
+  }
+  return 0;
+}
+
+static uint64_t json_get_uint64(const rapidjson::Value &v, const char *name) {
+  if (!v.HasMember(name) || !v[name].IsUint64()) {
+    return 0;
+  }
+  return v[name].GetUint64();
+}
+
+static bool json_get_bool(const rapidjson::Value &v, const char *name) {
+  if (!v.HasMember(name)) {
+    return false;
+  }
+  const rapidjson::Value &m = v[name];
+  return m.IsBool() ? m.GetBool() : (m.IsUint() && m.GetUint() != 0);
+}
+
+static std::string json_get_string(const rapidjson::Value &v,
+                                   const char *name) {
+  if (!v.HasMember(name) || !v[name].IsString()) {
+    return std::string();
+  }
+  return std::string(v[name].GetString(), v[name].GetStringLength());
+}
+
+/** Decode the hex digits of an SDI "default" property. */
+static std::string hex_decode(const std::string &hex) {
+  std::string out;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+    out.push_back(static_cast<char>(strtoul(hex.substr(i, 2).c_str(),
+                                            nullptr, 16)));
+  }
+  return out;
+}
+
+/** Read the instant ADD/DROP COLUMN properties of a column from its
+se_private_data. */
+static void column_parse_instant(const std::string &props, ColumnDef *col) {
+  std::string value;
+  col->version_added = 0;
+  col->version_dropped = 0;
+  col->physical_pos = DD_NO_PHYSICAL_POS;
+  col->instant_v1 = false;
+  col->default_null = !dd_properties_get(props, "default", &value);
+  col->default_value = col->default_null ? std::string() : hex_decode(value);
+  if (dd_properties_get(props, "version_added", &value)) {
+    col->version_added = strtoul(value.c_str(), nullptr, 10);
+  }
+  if (dd_properties_get(props, "version_dropped", &value)) {
+    col->version_dropped = strtoul(value.c_str(), nullptr, 10);
+  }
+  if (dd_properties_get(props, "physical_pos", &value)) {
+    col->physical_pos = strtoul(value.c_str(), nullptr, 10);
+  }
+}
+
+/** Put the fields of the clustered index of a table that went through an
+instant ADD/DROP COLUMN of MySQL 8.0.29+ in their physical order. Columns
+added with AFTER are appended to the records whatever their position in
+the table, and dropped columns stay in the records written before. */
+static void clust_index_physical_order(TableDef *table, IndexDef *index) {
+  for (size_t i = 0; i < table->columns.size(); i++) {
+    const ColumnDef &col = table->columns[i];
+    if (col.version_dropped == 0) {
+      continue;
+    }
+    bool found = false;
+    for (size_t j = 0; j < index->fields.size(); j++) {
+      found = found || index->fields[j].col_no == i;
+    }
+    if (!found) {
+      IndexFieldDef field;
+      field.col_no = static_cast<uint32_t>(i);
+      field.length = DD_ELEMENT_FULL_LENGTH;
+      field.is_key = false;
+      index->fields.push_back(field);
+    }
+  }
+  for (size_t j = 0; j < index->fields.size(); j++) {
+    if (table->columns[index->fields[j].col_no].physical_pos ==
+        DD_NO_PHYSICAL_POS) {
+      return;
+    }
+  }
+  const std::vector<ColumnDef> &columns = table->columns;
+  std::stable_sort(index->fields.begin(), index->fields.end(),
+                   [&columns](const IndexFieldDef &a, const IndexFieldDef &b) {
+                     return columns[a.col_no].physical_pos <
+                            columns[b.col_no].physical_pos;
+                   });
+}
+
+int table_def_parse(const rapidjson::Value &dd_object, TableDef *table) {
+  if (!dd_object.IsObject() || !dd_object.HasMember("columns") ||
+      !dd_object["columns"].IsArray()) {
+    return -1;
+  }
+
+  table->name = json_get_string(dd_object, "name");
+  table->id = json_get_uint64(dd_object, "se_private_id");
+  table->row_format = json_get_uint(dd_object, "row_format");
+  table->instant_cols = 0;
+  table->max_row_version = 0;
+  table->columns.clear();
+  table->indexes.clear();
+
+  const rapidjson::Value &columns = dd_object["columns"];
+  for (rapidjson::SizeType i = 0; i < columns.Size(); i++) {
+    const rapidjson::Value &c = columns[i];
+    ColumnDef col;
+    col.name = json_get_string(c, "name");
+    col.column_type_utf8 = json_get_string(c, "column_type_utf8");
+    col.type = json_get_uint(c, "type");
+    col.is_nullable = json_get_bool(c, "is_nullable");
+    col.is_unsigned = json_get_bool(c, "is_unsigned");
+    col.is_virtual = json_get_bool(c, "is_virtual");
+    col.hidden = json_get_uint(c, "hidden");
+    col.char_length = json_get_uint(c, "char_length");
+    col.numeric_precision = json_get_uint(c, "numeric_precision");
+    col.numeric_scale = json_get_uint(c, "numeric_scale");
+    col.datetime_precision = json_get_uint(c, "datetime_precision");
+    col.collation_id = json_get_uint(c, "collation_id");
+    col.n_elements = (c.HasMember("elements") && c["elements"].IsArray())
+                         ? c["elements"].Size()
+                         : 0;
+    column_parse_instant(json_get_string(c, "se_private_data"), &col);
+    table->max_row_version = std::max(
+        table->max_row_version,
+        std::max(col.version_added, col.version_dropped));
+    table->columns.push_back(col);
+  }
+
+  std::string value;
+  if (dd_properties_get(json_get_string(dd_object, "se_private_data"),
+                        "instant_col", &value)) {
+    table->instant_cols = strtoul(value.c_str(), nullptr, 10);
+    /* The columns added by instant ADD COLUMN before 8.0.29 follow the
+    instant_cols user columns the table had at the first one. */
+    uint32_t n_user = 0;
+    for (size_t i = 0; i < table->columns.size(); i++) {
+      ColumnDef &col = table->columns[i];
+      if (col.is_virtual || col.hidden == 2 || col.version_added != 0) {
+        continue;
+      }
+      col.instant_v1 = n_user++ >= table->instant_cols;
+    }
+  }
+
+  if (dd_object.HasMember("indexes") && dd_object["indexes"].IsArray()) {
+    const rapidjson::Value &indexes = dd_object["indexes"];
+    for (rapidjson::SizeType i = 0; i < indexes.Size(); i++) {
+      const rapidjson::Value &x = indexes[i];
+      IndexDef index;
+      index.name = json_get_string(x, "name");
+      index.type = json_get_uint(x, "type");
+      index.id = 0;
+      index.root = 0;
+      index.space_id = 0;
+
+      std::string props = json_get_string(x, "se_private_data");
+      if (dd_properties_get(props, "id", &value)) {
+        index.id = strtoull(value.c_str(), nullptr, 10);
+      }
+      if (dd_properties_get(props, "root", &value)) {
+        index.root = strtoul(value.c_str(), nullptr, 10);
+      }
+      if (dd_properties_get(props, "space_id", &value)) {
+        index.space_id = strtoul(value.c_str(), nullptr, 10);
+      }
+
+      if (x.HasMember("elements") && x["elements"].IsArray()) {
+        const rapidjson::Value &elements = x["elements"];
+        for (rapidjson::SizeType j = 0; j < elements.Size(); j++) {
+          IndexFieldDef field;
+          field.col_no = json_get_uint(elements[j], "column_opx");
+          field.length = json_get_uint(elements[j], "length");
+          field.is_key = !json_get_bool(elements[j], "hidden");
+          if (field.col_no >= table->columns.size()) {
+            return -1;
+          }
+          /* Virtual columns are not materialized in the records. */
+          if (table->columns[field.col_no].is_virtual) {
+            continue;
+          }
+          index.fields.push_back(field);
+        }
+      }
+      table->indexes.push_back(index);
+    }
+  }
+
+  IndexDef *clust = const_cast<IndexDef *>(table_def_clust_index(*table));
+  if (clust != nullptr && table->max_row_version > 0) {
+    clust_index_physical_order(table, clust);
+  }
+  return 0;
+}
+
+/** @return whether the file is a tablespace, its first page being the FSP
+header page, rather than ibd2sdi output */
+static bool table_def_is_tablespace(int fd) {
+  byte page[FIL_PAGE_DATA];
+  return pread(fd, page, sizeof page, 0) == (ssize_t)sizeof page &&
+         mach_read_from_2(page + FIL_PAGE_TYPE) == FIL_PAGE_TYPE_FSP_HDR;
+}
+
+/** Get the JSON of the table object of the SDI B-tree of a tablespace. */
+static int table_def_read_tablespace(int fd, const char *path,
+                                     std::string *json) {
+  std::vector<SdiObject> objects;
+  if (sdi_read_objects(fd, &objects) != 0) {
+    return -1;
+  }
+  for (size_t i = 0; i < objects.size(); i++) {
+    if (objects[i].type == SDI_TYPE_TABLE) {
+      json->swap(objects[i].json);
+      return 0;
+    }
+  }
+  std::cerr << "No table definition found in " << path << std::endl;
+  return -1;
+}
+
+/** Parse SDI JSON in place: the output of ibd2sdi, ["ibd2sdi", {table sdi},
+{tablespace sdi}], or the object of one SDI record. The strings of the
+document point into json, which is modified.
+@param[in,out]	json	NUL terminated JSON
+@param[in]	path	file the JSON comes from, for messages
+@param[out]	table	table definition
+@return 0 on success, -1 on error */
+static int table_def_parse_json(char *json, const char *path,
+                                TableDef *table) {
+  rapidjson::Document d;
+  d.ParseInsitu(json);
+  if (d.HasParseError()) {
+    std::cerr << "JSON parse error: "
+              << rapidjson::GetParseError_En(d.GetParseError())
+              << " offset: " << d.GetErrorOffset() << std::endl;
+    return -1;
+  }
+  if (d.IsObject() && d.HasMember("dd_object")) {
+    return table_def_parse(d["dd_object"], table);
+  }
+  if (!d.IsArray()) {
+    std::cerr << "Unexpected SDI json layout." << std::endl;
+    return -1;
+  }
+  for (rapidjson::SizeType i = 0; i < d.Size(); i++) {
+    const rapidjson::Value &entry = d[i];
+    if (!entry.IsObject() || !entry.HasMember("object")) {
+      continue;
+    }
+    const rapidjson::Value &object = entry["object"];
+    if (json_get_string(object, "dd_object_type") != "Table" ||
+        !object.HasMember("dd_object")) {
+      continue;
+    }
+    return table_def_parse(object["dd_object"], table);
+  }
+  std::cerr << "No table definition found in " << path << std::endl;
+  return -1;
+}
+
+/** Magic number and version of a compiled schema file */
+static const char TABLE_DEF_SCHEMA_MAGIC[8] = {'I', 'N', 'N', 'O',
+                                               'S', 'D', 'I', '2'};
+
+/** Suffix of the compiled schema file kept next to the SDI file */
+static const char *const TABLE_DEF_SCHEMA_SUFFIX = ".schema";
+
+static bool table_def_use_schema_file = false;
+
+void table_def_set_schema_cache(bool enable) {
+  table_def_use_schema_file = enable;
+}
+
+static void schema_put_u32(std::string *out, uint32_t v) {
+  byte buf[4];
+  mach_write_to_4(buf, v);
+  out->append(reinterpret_cast<const char *>(buf), sizeof buf);
+}
+
+static void schema_put_u64(std::string *out, uint64_t v) {
+  schema_put_u32(out, (uint32_t)(v >> 32));
+  schema_put_u32(out, (uint32_t)v);
+}
+
+static void schema_put_str(std::string *out, const std::string &v) {
+  schema_put_u32(out, v.size());
+  out->append(v);
+}
+
+/** Reader of a compiled schema, every read fails after a short one. */
+struct SchemaReader {
+  const byte *ptr;
+  const byte *end;
+  bool ok;
+
+  uint32_t u32() {
+    if (!ok || end - ptr < 4) {
+      ok = false;
+      return 0;
+    }
+    uint32_t v = mach_read_from_4(ptr);
+    ptr += 4;
+    return v;
+  }
+  uint64_t u64() {
+    uint64_t high = u32();
+    return (high << 32) | u32();
+  }
+  bool flag() { return u32() != 0; }
+  std::string str() {
+    uint32_t len = u32();
+    if (!ok || (uint64_t)(end - ptr) < len) {
+      ok = false;
+      return std::string();
+    }
+    std::string v(reinterpret_cast<const char *>(ptr), len);
+    ptr += len;
+    return v;
+  }
+};
+
+void table_def_serialize(const TableDef &table, std::string *out) {
+  out->clear();
+  schema_put_str(out, table.name);
+  schema_put_u64(out, table.id);
+  schema_put_u32(out, table.row_format);
+  schema_put_u32(out, table.instant_cols);
+  schema_put_u32(out, table.max_row_version);
+  schema_put_u32(out, table.columns.size());
+  for (size_t i = 0; i < table.columns.size(); i++) {
+    const ColumnDef &col = table.columns[i];
+    schema_put_str(out, col.name);
+    schema_put_str(out, col.column_type_utf8);
+    schema_put_u32(out, col.type);
+    schema_put_u32(out, col.is_nullable);
+    schema_put_u32(out, col.is_unsigned);
+    schema_put_u32(out, col.is_virtual);
+    schema_put_u32(out, col.hidden);
+    schema_put_u32(out, col.char_length);
+    schema_put_u32(out, col.numeric_precision);
+    schema_put_u32(out, col.numeric_scale);
+    schema_put_u32(out, col.datetime_precision);
+    schema_put_u32(out, col.collation_id);
+    schema_put_u32(out, col.n_elements);
+    schema_put_u32(out, col.version_added);
+    schema_put_u32(out, col.version_dropped);
+    schema_put_u32(out, col.physical_pos);
+    schema_put_u32(out, col.instant_v1);
+    schema_put_u32(out, col.default_null);
+    schema_put_str(out, col.default_value);
+  }
+  schema_put_u32(out, table.indexes.size());
+  for (size_t i = 0; i < table.indexes.size(); i++) {
+    const IndexDef &index = table.indexes[i];
+    schema_put_str(out, index.name);
+    schema_put_u32(out, index.type);
+    schema_put_u64(out, index.id);
+    schema_put_u32(out, index.root);
+    schema_put_u32(out, index.space_id);
+    schema_put_u32(out, index.fields.size());
+    for (size_t j = 0; j < index.fields.size(); j++) {
+      schema_put_u32(out, index.fields[j].col_no);
+      schema_put_u32(out, index.fields[j].length);
+      schema_put_u32(out, index.fields[j].is_key);
+    }
+  }
+}
+
+int table_def_deserialize(const std::string &in, TableDef *table) {
+  SchemaReader r;
+  r.ptr = reinterpret_cast<const byte *>(in.data());
+  r.end = r.ptr + in.size();
+  r.ok = true;
+
+  TableDef t;
+  t.name = r.str();
+  t.id = r.u64();
+  t.row_format = r.u32();
+  t.instant_cols = r.u32();
+  t.max_row_version = r.u32();
+  /* A corrupt count must not allocate more than the input could hold */
+  for (uint32_t n = r.u32(); r.ok && n > 0; n--) {
+    ColumnDef col;
+    col.name = r.str();
+    col.column_type_utf8 = r.str();
+    col.type = r.u32();
+    col.is_nullable = r.flag();
+    col.is_unsigned = r.flag();
+    col.is_virtual = r.flag();
+    col.hidden = r.u32();
+    col.char_length = r.u32();
+    col.numeric_precision = r.u32();
+    col.numeric_scale = r.u32();
+    col.datetime_precision = r.u32();
+    col.collation_id = r.u32();
+    col.n_elements = r.u32();
+    col.version_added = r.u32();
+    col.version_dropped = r.u32();
+    col.physical_pos = r.u32();
+    col.instant_v1 = r.flag();
+    col.default_null = r.flag();
+    col.default_value = r.str();
+    t.columns.push_back(col);
+  }
+  for (uint32_t n = r.u32(); r.ok && n > 0; n--) {
+    IndexDef index;
+    index.name = r.str();
+    index.type = r.u32();
+    index.id = r.u64();
+    index.root = r.u32();
+    index.space_id = r.u32();
+    for (uint32_t m = r.u32(); r.ok && m > 0; m--) {
+      IndexFieldDef field;
+      field.col_no = r.u32();
+      field.length = r.u32();
+      field.is_key = r.flag();
+      if (field.col_no >= t.columns.size()) {
+        r.ok = false;
+      }
+      index.fields.push_back(field);
+    }
+    t.indexes.push_back(index);
+  }
+  if (!r.ok || r.ptr != r.end) {
+    return -1;
+  }
+  *table = t;
+  return 0;
+}
+
+/** Read the compiled schema kept next to an SDI file.
+@param[in]	path	compiled schema file
+@param[in]	key	checksum and length of the SDI it was compiled from
+@param[out]	table	table definition
+@return 0 on success, -1 if the file is missing, stale or corrupt */
+static int table_def_read_schema(const std::string &path, uint64_t key,
+                                 TableDef *table) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file.is_open()) {
+    return -1;
+  }
+  std::string contents((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+  const size_t header = sizeof TABLE_DEF_SCHEMA_MAGIC + 8;
+  if (contents.size() < header ||
+      memcmp(contents.data(), TABLE_DEF_SCHEMA_MAGIC,
+             sizeof TABLE_DEF_SCHEMA_MAGIC) != 0 ||
+      mach_read_from_8(reinterpret_cast<const byte *>(contents.data()) +
+                       sizeof TABLE_DEF_SCHEMA_MAGIC) != key) {
+    return -1;
+  }
+  return table_def_deserialize(contents.substr(header), table);
+}
+
+/** Write the compiled schema next to an SDI file, replacing the old one
+atomically. Failures are only reported, the schema is then parsed again
+on the next run. */
+static void table_def_write_schema(const std::string &path, uint64_t key,
+                                   const TableDef &table) {
+  std::string body;
+  table_def_serialize(table, &body);
+  std::string contents(TABLE_DEF_SCHEMA_MAGIC, sizeof TABLE_DEF_SCHEMA_MAGIC);
+  schema_put_u64(&contents, key);
+  contents += body;
+
+  const std::string tmp = path + ".tmp";
+  std::ofstream file(tmp.c_str(), std::ios::binary | std::ios::trunc);
+  if (!file.write(contents.data(), contents.size()) || (file.close(), !file) ||
+      rename(tmp.c_str(), path.c_str()) != 0) {
+    fprintf(stderr, "[WARN] cannot write the compiled schema %s\n",
+            path.c_str());
+    unlink(tmp.c_str());
+  }
+}
+
+/** Table definitions loaded in this run, by SDI path. An entry is reused
+while the file keeps its identity, size and modification time. */
+struct TableDefCacheEntry {
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+  TableDef table;
+};
+static std::map<std::string, TableDefCacheEntry> table_def_cache;
+static std::mutex table_def_cache_mutex;
+
+/** Load a table definition without the in-memory cache. */
+static int table_def_load_file(const char *sdi_path, int fd, size_t size,
+                               TableDef *table) {
+  /* The in-situ parser needs a writable NUL terminated buffer. A private
+  mapping is one when the file does not end on a page boundary: the rest
+  of the last page reads as zeros. */
+  std::string copy;
+  char *json = nullptr;
+  void *map = MAP_FAILED;
+  if (table_def_is_tablespace(fd)) {
+    if (table_def_read_tablespace(fd, sdi_path, &copy) != 0) {
+      return -1;
+    }
+    size = copy.size();
+    json = &copy[0];
+  } else {
+    if (size % sysconf(_SC_PAGESIZE) != 0) {
+      map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    if (map != MAP_FAILED) {
+      json = static_cast<char *>(map);
+    } else {
+      copy.resize(size);
+      if (pread(fd, &copy[0], size, 0) != (ssize_t)size) {
+        std::cerr << "Failed to read SDI file " << sdi_path << std::endl;
+        return -1;
+      }
+      json = &copy[0];
+    }
+  }
+
+  int ret;
+  const std::string schema_path =
+      std::string(sdi_path) + TABLE_DEF_SCHEMA_SUFFIX;
+  const uint64_t key =
+      ((uint64_t)crc32(0, reinterpret_cast<const Bytef *>(json), size) << 32) |
+      (uint32_t)size;
+  if (table_def_use_schema_file &&
+      table_def_read_schema(schema_path, key, table) == 0) {
+    ret = 0;
+  } else {
+    ret = table_def_parse_json(json, sdi_path, table);
+    if (ret == 0 && table_def_use_schema_file) {
+      table_def_write_schema(schema_path, key, *table);
+    }
+  }
+  if (map != MAP_FAILED) {
+    munmap(map, size);
+  }
+  return ret;
+}
+
+int table_def_load(const char *sdi_path, TableDef *table) {
+  int fd = open(sdi_path, O_RDONLY);
+  struct stat stat_buf;
+  if (fd == -1 || fstat(fd, &stat_buf) == -1) {
+    std::cerr << "Failed to open SDI file " << sdi_path << ": "
+              << strerror(errno) << std::endl;
+    if (fd != -1) {
+      close(fd);
+    }
+    return -1;
+  }
+
+  std::lock_guard<std::mutex> lock(table_def_cache_mutex);
+  std::map<std::string, TableDefCacheEntry>::iterator it =
+      table_def_cache.find(sdi_path);
+  if (it != table_def_cache.end() && it->second.dev == stat_buf.st_dev &&
+      it->second.ino == stat_buf.st_ino &&
+      it->second.size == stat_buf.st_size &&
+      it->second.mtime == stat_buf.st_mtime) {
+    close(fd);
+    *table = it->second.table;
+    return 0;
+  }
+
+  TableDefCacheEntry entry;
+  int ret = table_def_load_file(sdi_path, fd, stat_buf.st_size, &entry.table);
+  close(fd);
+  if (ret != 0) {
+    return -1;
+  }
+  entry.dev = stat_buf.st_dev;
+  entry.ino = stat_buf.st_ino;
+  entry.size = stat_buf.st_size;
+  entry.mtime = stat_buf.st_mtime;
+  table_def_cache[sdi_path] = entry;
+  *table = entry.table;
+  return 0;
+}
+
+int table_def_find_column(const TableDef &table, const char *name) {
+  for (size_t i = 0; i < table.columns.size(); i++) {
+    if (strcasecmp(table.columns[i].name.c_str(), name) == 0) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+const IndexDef *table_def_clust_index(const TableDef &table) {
+  for (size_t i = 0; i < table.indexes.size(); i++) {
+    if (table.indexes[i].type == DD_INDEX_PRIMARY) {
+      return &table.indexes[i];
+    }
+  }
+  /* Without a PRIMARY KEY the first index is the clustered one
+  (either the first UNIQUE NOT NULL index or GEN_CLUST_INDEX). */
+  return table.indexes.empty() ? nullptr : &table.indexes[0];
+}
+
+const IndexDef *table_def_find_index(const TableDef &table, const char *name) {
+  for (size_t i = 0; i < table.indexes.size(); i++) {
+    if (strcasecmp(table.indexes[i].name.c_str(), name) == 0) {
+      return &table.indexes[i];
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,304 @@
+#include "include/table_scan.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/page0page.h"
+
+/** Select the output fields from a --columns list.
+@return 0 on success, -1 on an unknown column */
+static int table_scan_project(const char *columns, TableScan *scan) {
+  const std::string list(columns);
+  size_t start = 0;
+  for (;;) {
+    size_t end = list.find(',', start);
+    std::string name =
+        list.substr(start, end == std::string::npos ? end : end - start);
+    name.erase(0, name.find_first_not_of(" \t"));
+    name.erase(name.find_last_not_of(" \t") + 1);
+
+    size_t f = 0;
+    for (; f < scan->leaf_layout.fields.size(); f++) {
+      const ColumnDef &col =
+          scan->table.columns[scan->leaf_layout.fields[f].col_no];
+      if (strcasecmp(col.name.c_str(), name.c_str()) == 0) {
+        break;
+      }
+    }
+    if (f == scan->leaf_layout.fields.size()) {
+      if (!scan->leaf_layout.is_clustered &&
+          table_def_find_column(scan->table, name.c_str()) >= 0) {
+        fprintf(stderr, "[ERROR] --columns: column %s is not in index %s\n",
+                name.c_str(), scan->index->name.c_str());
+      } else {
+        fprintf(stderr, "[ERROR] --columns: unknown column %s\n",
+                name.c_str());
+      }
+      return -1;
+    }
+    scan->out_fields.push_back(f);
+
+    if (end == std::string::npos) {
+      return 0;
+    }
+    start = end + 1;
+  }
+}
+
+int table_scan_open(const char *sdi_path, const char *where,
+                    const char *columns, TableScan *scan) {
+  return table_scan_open_index(sdi_path, nullptr, where, columns, scan);
+}
+
+int table_scan_open_index(const char *sdi_path, const char *index_name,
+                          const char *where, const char *columns,
+                          TableScan *scan) {
+  if (table_def_load(sdi_path, &scan->table) != 0) {
+    return -1;
+  }
+  const IndexDef *clust = table_def_clust_index(scan->table);
+  if (index_name == nullptr || *index_name == '\0') {
+    scan->index = clust;
+    if (scan->index == nullptr) {
+      fprintf(stderr, "[ERROR] no clustered index in %s\n", sdi_path);
+      return -1;
+    }
+  } else {
+    scan->index = table_def_find_index(scan->table, index_name);
+    if (scan->index == nullptr) {
+      fprintf(stderr, "[ERROR] no index %s in %s\n", index_name, sdi_path);
+      return -1;
+    }
+    if (scan->index->type == DD_INDEX_FULLTEXT ||
+        scan->index->type == DD_INDEX_SPATIAL) {
+      fprintf(stderr, "[ERROR] index %s is not a B-tree of the table\n",
+              index_name);
+      return -1;
+    }
+  }
+  if (scan->index->root == 0 && scan->index != clust) {
+    fprintf(stderr, "[ERROR] no root page for index %s in %s\n",
+            scan->index->name.c_str(), sdi_path);
+    return -1;
+  }
+  /* The clustered index root of a file-per-table tablespace is page 4 */
+  scan->root = scan->index->root ? scan->index->root : 4;
+
+  if (rec_layout_build(scan->table, *scan->index, true, &scan->leaf_layout) !=
+          0 ||
+      rec_layout_build(scan->table, *scan->index, false,
+                       &scan->node_layout) != 0) {
+    return -1;
+  }
+
+  scan->out_fields.clear();
+  if (columns != nullptr && *columns != '\0') {
+    if (table_scan_project(columns, scan) != 0) {
+      return -1;
+    }
+  } else {
+    /* Visible columns in table order, and where they are in the record. */
+    std::vector<std::pair<uint32_t, size_t> > order;
+    for (size_t i = 0; i < scan->leaf_layout.fields.size(); i++) {
+      const uint32_t col_no = scan->leaf_layout.fields[i].col_no;
+      const ColumnDef &col = scan->table.columns[col_no];
+      if (col.hidden != 1 || col.is_virtual) {
+        continue;
+      }
+      order.push_back(std::make_pair(col_no, i));
+    }
+    std::sort(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); i++) {
+      scan->out_fields.push_back(order[i].second);
+    }
+  }
+
+  if (row_filter_compile(where, scan->leaf_layout, &scan->filter) != 0) {
+    return -1;
+  }
+
+  scan->n_decode = 0;
+  for (size_t i = 0; i < scan->out_fields.size(); i++) {
+    scan->n_decode = std::max(scan->n_decode, scan->out_fields[i] + 1);
+  }
+  for (size_t i = 0; i < scan->filter.preds.size(); i++) {
+    scan->n_decode = std::max(scan->n_decode, scan->filter.preds[i].field + 1);
+  }
+  return 0;
+}
+
+int table_scan_read_format(int fd, TableScan *scan) {
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE, UNIV_PAGE_SIZE) != 0) {
+    return -1;
+  }
+  int ret = -1;
+  if (page_read(fd, scan->root, buf) == 0 &&
+      fil_page_get_type(buf) == FIL_PAGE_INDEX) {
+    rec_layout_set_format(&scan->leaf_layout, buf);
+    rec_layout_set_format(&scan->node_layout, buf);
+    ret = 0;
+  }
+  free(buf);
+  return ret;
+}
+
+int64_t table_scan_rows(int fd, const TableScan &scan, const table_row_cb &cb,
+                        uint64_t *n_examined) {
+  std::vector<ulint> offs(scan.leaf_layout.fields.size());
+  uint64_t n_recs = 0;
+
+  int64_t n_pages = index_scan_leaves(
+      fd, scan.node_layout, scan.root,
+      [&](const byte *page, uint32_t page_no) {
+        (void)page_no;
+        const bool comp = page_is_comp(page);
+        const page_rec_next_func_t next_rec = page_rec_next_func(page);
+        for (const rec_t *rec = next_rec(page, page_get_infimum(page));
+             rec != nullptr; rec = next_rec(page, rec)) {
+          if (!page_rec_is_live(rec, comp)) {
+            continue;
+          }
+          n_recs++;
+          rec_layout_get_offsets(rec, scan.leaf_layout, offs.data(),
+                                 scan.n_decode);
+          if (!row_filter_match(scan.filter, rec, offs.data())) {
+            continue;
+          }
+          if (!cb(rec, offs.data())) {
+            return false;
+          }
+        }
+        return true;
+      });
+
+  if (n_examined != nullptr) {
+    *n_examined = n_recs;
+  }
+  return n_pages;
+}
+
+int64_t table_scan_pages(int fd, const TableScan &scan, const table_page_cb &cb,
+                         uint64_t *n_examined) {
+  PageBatch batch;
+  uint64_t n_recs = 0;
+
+  int64_t n_pages = index_scan_leaves(
+      fd, scan.node_layout, scan.root,
+      [&](const byte *page, uint32_t page_no) {
+        n_recs += page_batch_collect(page, page_no, scan.leaf_layout,
+                                     scan.n_decode, scan.filter, &batch);
+        return cb(batch);
+      });
+
+  if (n_examined != nullptr) {
+    *n_examined = n_recs;
+  }
+  return n_pages;
+}
+
+int64_t table_scan_range(int fd, const TableScan &scan, const SearchTuple *lo,
+                         const SearchTuple *hi, const table_row_cb &cb,
+                         uint64_t *n_examined) {
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  const uint64_t n_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE, UNIV_PAGE_SIZE) != 0) {
+    return -1;
+  }
+  std::vector<ulint> offs(scan.leaf_layout.fields.size());
+  /* The bounds are compared with the primary key fields */
+  const size_t n_decode =
+      std::max<size_t>(scan.n_decode, scan.leaf_layout.n_uniq);
+  const SearchTuple first;
+  if (lo == nullptr) {
+    lo = &first;
+  }
+
+  uint32_t n_reads = 0;
+  uint64_t n_recs = 0;
+  int64_t ret = -1;
+  uint32_t page_no =
+      btr_search_leaf(fd, scan.node_layout, scan.root, *lo, buf, &n_reads);
+  const rec_t *rec =
+      page_no == FIL_NULL
+          ? nullptr
+          : page_search(buf, scan.leaf_layout, *lo, false, offs.data());
+  const uint64_t index_id =
+      mach_read_from_8(buf + PAGE_HEADER + PAGE_INDEX_ID);
+
+  while (rec != nullptr) {
+    rec = page_rec_get_next(buf, rec);
+    if (rec == nullptr) {
+      /* End of the page, continue on the right sibling */
+      page_no = mach_read_from_4(buf + FIL_PAGE_NEXT);
+      if (page_no == FIL_NULL) {
+        ret = n_reads;
+        break;
+      }
+      if (n_reads > n_pages) {
+        fprintf(stderr, "[ERROR] leaf page list has a cycle at page %u\n",
+                page_no);
+        break;
+      }
+      if (page_read(fd, page_no, buf) != 0) {
+        fprintf(stderr, "[ERROR] read leaf page %u failed\n", page_no);
+        break;
+      }
+      n_reads++;
+      /* As in index_scan_leaves(), FIL_PAGE_NEXT may be stale or corrupt */
+      if (fil_page_get_type(buf) != FIL_PAGE_INDEX ||
+          mach_read_from_8(buf + PAGE_HEADER + PAGE_INDEX_ID) != index_id ||
+          mach_read_from_2(buf + PAGE_HEADER + PAGE_LEVEL) != 0) {
+        fprintf(stderr, "[ERROR] page %u is not a leaf page of index %lu\n",
+                page_no, index_id);
+        break;
+      }
+      rec = page_get_infimum(buf);
+      continue;
+    }
+    const bool comp = page_is_comp(buf);
+    if (comp && rec_get_status(rec) != REC_STATUS_ORDINARY) {
+      continue;
+    }
+    rec_layout_get_offsets(rec, scan.leaf_layout, offs.data(), n_decode);
+    const int cmp_hi =
+        hi != nullptr ? search_tuple_cmp(*hi, rec, offs.data()) : 1;
+    if (cmp_hi < 0) {
+      ret = n_reads;
+      break;
+    }
+    if (!(rec_get_info_bits(rec, comp) & REC_INFO_DELETED_FLAG)) {
+      n_recs++;
+      if (row_filter_match(scan.filter, rec, offs.data()) &&
+          !cb(rec, offs.data())) {
+        ret = n_reads;
+        break;
+      }
+    }
+    if (cmp_hi == 0 && hi->n_fields() == scan.leaf_layout.n_uniq) {
+      /* The primary key is unique, there is no need to read the next
+      page to find the end of the range. */
+      ret = n_reads;
+      break;
+    }
+  }
+
+  free(buf);
+  if (n_examined != nullptr) {
+    *n_examined = n_recs;
+  }
+  return ret;
+}
@@ -0,0 +1,433 @@
+#include "include/trx_timeline.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "include/fil0fil.h"
+#include "include/fut0lst.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+#include "include/undo_decoder.h"
+
+/** Magic number and version of a transaction index file */
+static const char TRX_TIMELINE_MAGIC[8] = {'I', 'N', 'N', 'O',
+                                           'T', 'R', 'X', '1'};
+/** The magic number, then the size, modification time and inode of the
+undo file the index was built from */
+static const size_t TRX_TIMELINE_HEADER_SIZE = sizeof TRX_TIMELINE_MAGIC + 24;
+
+/** Layout of a serialized TrxLog */
+static const size_t TRX_LOG_TRX_ID = 0;
+static const size_t TRX_LOG_TRX_NO = 8;
+static const size_t TRX_LOG_PAGE_NO = 16;
+static const size_t TRX_LOG_N_PAGES = 20;
+static const size_t TRX_LOG_N_RECORDS = 24;
+static const size_t TRX_LOG_TABLES = 28;
+static const size_t TRX_LOG_N_TABLES = 32;
+static const size_t TRX_LOG_OFFSET = 36;
+static const size_t TRX_LOG_TYPE = 38;
+static const size_t TRX_LOG_STATE = 39;
+static const size_t TRX_LOG_DEL_MARKS = 40;
+static const size_t TRX_LOG_SIZE = 41;
+
+/** Number of pages read by one pread() of the index build */
+static const uint32_t TRX_TIMELINE_READ_PAGES = 64;
+
+/** Links of the pages of the file while they are resolved to the header
+page of their undo log segment */
+static const uint32_t LINK_HEADER = UINT32_MAX;
+static const uint32_t LINK_NOT_UNDO = UINT32_MAX - 1;
+static const uint32_t LINK_ORPHAN = UINT32_MAX - 2;
+static const uint32_t LINK_VISITING = UINT32_MAX - 3;
+
+/** Resolve a page to the header page of its undo log segment by following
+TRX_UNDO_PAGE_NODE back, pointing every page of the path at the result.
+@return header page, or LINK_ORPHAN */
+static uint32_t timeline_owner(std::vector<uint32_t> *link, uint32_t page_no,
+                               std::vector<uint32_t> *path) {
+  path->clear();
+  uint32_t owner = LINK_ORPHAN;
+  for (uint32_t p = page_no;;) {
+    const uint32_t l = (*link)[p];
+    if (l == LINK_HEADER) {
+      owner = p;
+      break;
+    }
+    if (l >= link->size()) {
+      break;
+    }
+    (*link)[p] = LINK_VISITING;
+    path->push_back(p);
+    p = l;
+  }
+  for (size_t i = 0; i < path->size(); i++) {
+    (*link)[(*path)[i]] = owner;
+  }
+  return owner;
+}
+
+static void timeline_add_table(std::vector<uint64_t> *tables, uint64_t id) {
+  if (tables->empty() || tables->back() != id) {
+    tables->push_back(id);
+  }
+}
+
+static void timeline_put(std::string *out, const byte *data, size_t len) {
+  out->append(reinterpret_cast<const char *>(data), len);
+}
+
+int trx_timeline_build(int fd, std::string *index) {
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  const uint64_t n_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE,
+                     TRX_TIMELINE_READ_PAGES * UNIV_PAGE_SIZE) != 0) {
+    return -1;
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  std::vector<TrxLog> logs;
+  /* Last log of each header page, the owner of the other pages of the
+  segment */
+  std::vector<uint32_t> last_log(n_pages, UINT32_MAX);
+  std::vector<uint32_t> link(n_pages, LINK_NOT_UNDO);
+  /* Records and tables of the pages other than header pages */
+  std::vector<uint32_t> page_records(n_pages, 0);
+  std::vector<std::pair<uint32_t, uint64_t> > page_tables;
+
+  UndoLogHeader headers[UNDO_PAGE_MAX_LOGS];
+  UndoPlan plan;
+  UndoRecord rec;
+  UndoScanStats stats;
+  int ret = 0;
+  for (uint64_t first = 0; first < n_pages; first += TRX_TIMELINE_READ_PAGES) {
+    const uint64_t n =
+        std::min<uint64_t>(TRX_TIMELINE_READ_PAGES, n_pages - first);
+    ssize_t n_read = pread(fd, buf, n * UNIV_PAGE_SIZE, first * UNIV_PAGE_SIZE);
+    if (n_read != (ssize_t)(n * UNIV_PAGE_SIZE)) {
+      fprintf(stderr, "[ERROR] read of pages %lu..%lu failed: %s\n", first,
+              first + n - 1, n_read < 0 ? strerror(errno) : "short read");
+      ret = -1;
+      break;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+      const uint32_t page_no = first + i;
+      const byte *page = buf + i * UNIV_PAGE_SIZE;
+      if (fil_page_get_type(page) != FIL_PAGE_UNDO_LOG) {
+        continue;
+      }
+      const fil_addr_t prev =
+          flst_get_prev_addr(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_NODE);
+      if (prev.page != FIL_NULL) {
+        link[page_no] = prev.page;
+        undo_page_records(page_no, page, plan, &rec, &stats,
+                          [&](uint32_t, const UndoLogHeader *,
+                              const UndoRecord &r) {
+                            page_records[page_no]++;
+                            if (page_tables.empty() ||
+                                page_tables.back().first != page_no ||
+                                page_tables.back().second != r.table_id) {
+                              page_tables.push_back(
+                                  std::make_pair(page_no, r.table_id));
+                            }
+                            return true;
+                          });
+        continue;
+      }
+
+      link[page_no] = LINK_HEADER;
+      const size_t n_logs = undo_page_logs(page, headers);
+      if (n_logs == 0) {
+        continue;
+      }
+      const size_t base = logs.size();
+      const ulint type =
+          mach_read_from_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_TYPE);
+      for (size_t l = 0; l < n_logs; l++) {
+        TrxLog log;
+        log.trx_id = headers[l].trx_id;
+        log.trx_no = headers[l].trx_no;
+        log.page_no = page_no;
+        log.log_offset = headers[l].offset;
+        log.type = type;
+        log.del_marks = headers[l].del_marks;
+        log.n_pages = 1;
+        logs.push_back(log);
+      }
+      logs.back().state =
+          mach_read_from_2(page + TRX_UNDO_SEG_HDR + TRX_UNDO_STATE);
+      last_log[page_no] = logs.size() - 1;
+      undo_page_records(
+          page_no, page, plan, &rec, &stats,
+          [&](uint32_t, const UndoLogHeader *log, const UndoRecord &r) {
+            for (size_t l = base; l < logs.size(); l++) {
+              if (log != nullptr && logs[l].log_offset == log->offset) {
+                logs[l].n_records++;
+                timeline_add_table(&logs[l].tables, r.table_id);
+              }
+            }
+            return true;
+          });
+    }
+  }
+  free(buf);
+  if (ret != 0) {
+    return ret;
+  }
+
+  /* The other pages of a segment hold records of its last log */
+  std::vector<uint32_t> path;
+  size_t t = 0;
+  for (uint32_t page_no = 0; page_no < n_pages; page_no++) {
+    if (link[page_no] == LINK_HEADER || link[page_no] == LINK_NOT_UNDO) {
+      continue;
+    }
+    const uint32_t owner = timeline_owner(&link, page_no, &path);
+    TrxLog *log = owner != LINK_ORPHAN && last_log[owner] != UINT32_MAX
+                      ? &logs[last_log[owner]]
+                      : nullptr;
+    for (; t < page_tables.size() && page_tables[t].first <= page_no; t++) {
+      if (log != nullptr && page_tables[t].first == page_no) {
+        log->tables.push_back(page_tables[t].second);
+      }
+    }
+    if (log != nullptr) {
+      log->n_pages++;
+      log->n_records += page_records[page_no];
+    }
+  }
+
+  std::sort(logs.begin(), logs.end(), [](const TrxLog &a, const TrxLog &b) {
+    return a.trx_id != b.trx_id ? a.trx_id < b.trx_id
+                                : a.page_no != b.page_no
+                                      ? a.page_no < b.page_no
+                                      : a.log_offset < b.log_offset;
+  });
+  std::vector<uint32_t> by_trx_no(logs.size());
+  for (size_t i = 0; i < logs.size(); i++) {
+    by_trx_no[i] = i;
+  }
+  std::stable_sort(by_trx_no.begin(), by_trx_no.end(),
+                   [&](uint32_t a, uint32_t b) {
+                     return logs[a].trx_no < logs[b].trx_no;
+                   });
+
+  index->clear();
+  byte entry[TRX_LOG_SIZE];
+  std::string tables;
+  for (size_t i = 0; i < logs.size(); i++) {
+    TrxLog &log = logs[i];
+    std::sort(log.tables.begin(), log.tables.end());
+    log.tables.erase(std::unique(log.tables.begin(), log.tables.end()),
+                     log.tables.end());
+    mach_write_to_8(entry + TRX_LOG_TRX_ID, log.trx_id);
+    mach_write_to_8(entry + TRX_LOG_TRX_NO, log.trx_no);
+    mach_write_to_4(entry + TRX_LOG_PAGE_NO, log.page_no);
+    mach_write_to_4(entry + TRX_LOG_N_PAGES, log.n_pages);
+    mach_write_to_4(entry + TRX_LOG_N_RECORDS, log.n_records);
+    mach_write_to_4(entry + TRX_LOG_TABLES, tables.size() / 8);
+    mach_write_to_4(entry + TRX_LOG_N_TABLES, log.tables.size());
+    mach_write_to_2(entry + TRX_LOG_OFFSET, log.log_offset);
+    mach_write_to_1(entry + TRX_LOG_TYPE, log.type & 0xFF);
+    mach_write_to_1(entry + TRX_LOG_STATE, log.state & 0xFF);
+    mach_write_to_1(entry + TRX_LOG_DEL_MARKS, log.del_marks);
+    timeline_put(index, entry, TRX_LOG_SIZE);
+    for (size_t j = 0; j < log.tables.size(); j++) {
+      byte id[8];
+      mach_write_to_8(id, log.tables[j]);
+      tables.append(reinterpret_cast<const char *>(id), 8);
+    }
+  }
+
+  byte counts[8];
+  mach_write_to_4(counts, logs.size());
+  mach_write_to_4(counts + 4, tables.size() / 8);
+  index->insert(0, reinterpret_cast<const char *>(counts), 8);
+  index->append(tables);
+  for (size_t i = 0; i < by_trx_no.size(); i++) {
+    byte no[4];
+    mach_write_to_4(no, by_trx_no[i]);
+    timeline_put(index, no, 4);
+  }
+  return 0;
+}
+
+/** Header of the index file of an undo file: its size, modification time
+and inode, which must match for the index to be used. */
+static std::string timeline_header(const struct stat &st) {
+  std::string header(TRX_TIMELINE_MAGIC, sizeof TRX_TIMELINE_MAGIC);
+  byte key[24];
+  mach_write_to_8(key, st.st_size);
+  mach_write_to_8(key + 8, (uint64_t)st.st_mtim.tv_sec * 1000000000ULL +
+                               st.st_mtim.tv_nsec);
+  mach_write_to_8(key + 16, st.st_ino);
+  header.append(reinterpret_cast<const char *>(key), sizeof key);
+  return header;
+}
+
+TrxTimeline::TrxTimeline()
+    : map_(MAP_FAILED),
+      map_size_(0),
+      reused_(false),
+      n_logs_(0),
+      n_tables_(0),
+      logs_(nullptr),
+      tables_(nullptr),
+      by_trx_no_(nullptr) {}
+
+TrxTimeline::~TrxTimeline() { Close(); }
+
+void TrxTimeline::Close() {
+  if (map_ != MAP_FAILED) {
+    munmap(map_, map_size_);
+    map_ = MAP_FAILED;
+  }
+  built_.clear();
+  reused_ = false;
+  n_logs_ = 0;
+  n_tables_ = 0;
+}
+
+int TrxTimeline::Attach(const byte *body, size_t size) {
+  if (size < 8) {
+    return -1;
+  }
+  const uint64_t n_logs = mach_read_from_4(body);
+  const uint64_t n_tables = mach_read_from_4(body + 4);
+  if (size != 8 + n_logs * (TRX_LOG_SIZE + 4) + n_tables * 8) {
+    return -1;
+  }
+  n_logs_ = n_logs;
+  n_tables_ = n_tables;
+  logs_ = body + 8;
+  tables_ = logs_ + n_logs * TRX_LOG_SIZE;
+  by_trx_no_ = tables_ + n_tables * 8;
+  return 0;
+}
+
+int TrxTimeline::Open(const char *undo_path, int fd) {
+  Close();
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  const std::string header = timeline_header(st);
+  const std::string path = std::string(undo_path) + TRX_TIMELINE_SUFFIX;
+
+  int index_fd = open(path.c_str(), O_RDONLY);
+  struct stat index_st;
+  if (index_fd != -1 && fstat(index_fd, &index_st) == 0 &&
+      (size_t)index_st.st_size >= TRX_TIMELINE_HEADER_SIZE) {
+    map_size_ = index_st.st_size;
+    map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, index_fd, 0);
+  }
+  if (index_fd != -1) {
+    close(index_fd);
+  }
+  if (map_ != MAP_FAILED) {
+    const byte *data = static_cast<const byte *>(map_);
+    if (memcmp(data, header.data(), TRX_TIMELINE_HEADER_SIZE) == 0 &&
+        Attach(data + TRX_TIMELINE_HEADER_SIZE,
+               map_size_ - TRX_TIMELINE_HEADER_SIZE) == 0) {
+      reused_ = true;
+      return 0;
+    }
+    /* Stale or corrupt, built again */
+    munmap(map_, map_size_);
+    map_ = MAP_FAILED;
+  }
+
+  if (trx_timeline_build(fd, &built_) != 0 ||
+      Attach(reinterpret_cast<const byte *>(built_.data()), built_.size()) !=
+          0) {
+    return -1;
+  }
+  const std::string tmp = path + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (f == nullptr || fwrite(header.data(), 1, header.size(), f) !=
+                          header.size() ||
+      fwrite(built_.data(), 1, built_.size(), f) != built_.size() ||
+      fclose(f) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+    if (f != nullptr) {
+      unlink(tmp.c_str());
+    }
+    fprintf(stderr, "[WARN] cannot write the transaction index %s\n",
+            path.c_str());
+  }
+  return 0;
+}
+
+void TrxTimeline::ReadLog(uint32_t i, TrxLog *log) const {
+  const byte *e = logs_ + (size_t)i * TRX_LOG_SIZE;
+  log->trx_id = mach_read_from_8(e + TRX_LOG_TRX_ID);
+  log->trx_no = mach_read_from_8(e + TRX_LOG_TRX_NO);
+  log->page_no = mach_read_from_4(e + TRX_LOG_PAGE_NO);
+  log->n_pages = mach_read_from_4(e + TRX_LOG_N_PAGES);
+  log->n_records = mach_read_from_4(e + TRX_LOG_N_RECORDS);
+  log->log_offset = mach_read_from_2(e + TRX_LOG_OFFSET);
+  log->type = mach_read_from_1(e + TRX_LOG_TYPE);
+  log->state = mach_read_from_1(e + TRX_LOG_STATE);
+  log->del_marks = mach_read_from_1(e + TRX_LOG_DEL_MARKS) != 0;
+  const uint64_t first = mach_read_from_4(e + TRX_LOG_TABLES);
+  const uint64_t n = mach_read_from_4(e + TRX_LOG_N_TABLES);
+  log->tables.clear();
+  for (uint64_t t = first; t < first + n && t < n_tables_; t++) {
+    log->tables.push_back(mach_read_from_8(tables_ + t * 8));
+  }
+}
+
+uint64_t TrxTimeline::Find(uint64_t lo, uint64_t hi, bool by_trx_no,
+                           uint64_t table_id, const trx_log_cb &cb) const {
+  /* Entry of position i of the order searched */
+  auto entry = [&](uint32_t i) {
+    return by_trx_no ? mach_read_from_4(by_trx_no_ + (size_t)i * 4) : i;
+  };
+  auto key = [&](uint32_t i) {
+    return mach_read_from_8(logs_ + (size_t)entry(i) * TRX_LOG_SIZE +
+                            (by_trx_no ? TRX_LOG_TRX_NO : TRX_LOG_TRX_ID));
+  };
+  uint32_t low = 0;
+  uint32_t high = n_logs_;
+  while (low < high) {
+    const uint32_t mid = low + (high - low) / 2;
+    if (entry(mid) < n_logs_ && key(mid) < lo) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  uint64_t n_found = 0;
+  TrxLog log;
+  for (uint32_t i = low; i < n_logs_; i++) {
+    if (entry(i) >= n_logs_) {
+      continue;
+    }
+    if (key(i) > hi) {
+      break;
+    }
+    ReadLog(entry(i), &log);
+    if (table_id != 0 && !std::binary_search(log.tables.begin(),
+                                             log.tables.end(), table_id)) {
+      continue;
+    }
+    n_found++;
+    if (!cb(log)) {
+      break;
+    }
+  }
+  return n_found;
+}
@@ -0,0 +1,290 @@
+#include "include/undo_decoder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/fut0lst.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+
+/** Number of pages read by one pread() of an undo file scan */
+static const uint32_t UNDO_READ_PAGES = 64;
+
+/** Read the length and the data of a field of an undo record.
+@return false if the field does not end before end */
+static bool undo_read_field(const byte **ptr, const byte *end,
+                            UndoField *field) {
+  uint32_t len = mach_parse_compressed(ptr, end);
+  if (*ptr == nullptr) {
+    return false;
+  }
+  field->data = *ptr;
+  field->is_null = false;
+  field->is_extern = false;
+  if (len == UNIV_SQL_NULL) {
+    field->is_null = true;
+    field->len = 0;
+    return true;
+  }
+  if (len == UNIV_EXTERN_STORAGE_FIELD) {
+    /* The length of the field in the record, then the length of the
+    prefix written to the undo record */
+    mach_parse_compressed(ptr, end);
+    if (*ptr == nullptr) {
+      return false;
+    }
+    len = mach_parse_compressed(ptr, end);
+    if (*ptr == nullptr) {
+      return false;
+    }
+    field->data = *ptr;
+    field->is_extern = true;
+  } else if (len >= UNIV_EXTERN_STORAGE_FIELD) {
+    len -= UNIV_EXTERN_STORAGE_FIELD;
+    field->is_extern = true;
+  }
+  if ((ulint)(end - *ptr) < len) {
+    return false;
+  }
+  field->len = len;
+  *ptr += len;
+  return true;
+}
+
+int undo_rec_decode(const byte *page, ulint offset, ulint end,
+                    const UndoPlan &plan, UndoRecord *rec) {
+  /* The record starts with the offset of the next one and ends with its
+  own offset */
+  const byte *ptr = page + offset + 2;
+  const byte *rec_end = page + end - 2;
+  rec->offset = offset;
+  rec->pk.clear();
+  rec->update.clear();
+  rec->update_truncated = false;
+  rec->info_bits = 0;
+  rec->trx_id = 0;
+  rec->roll_ptr = 0;
+  if (ptr >= rec_end) {
+    return -1;
+  }
+  ulint type_cmpl = *ptr++;
+  if (type_cmpl & TRX_UNDO_MODIFY_BLOB) {
+    ptr++;
+  }
+  rec->updated_extern = (type_cmpl & TRX_UNDO_UPD_EXTERN) != 0;
+  type_cmpl &= ~(TRX_UNDO_UPD_EXTERN | TRX_UNDO_MODIFY_BLOB);
+  rec->type = type_cmpl & (TRX_UNDO_CMPL_INFO_MULT - 1);
+  rec->cmpl_info = type_cmpl / TRX_UNDO_CMPL_INFO_MULT;
+  rec->undo_no = mach_parse_u64_much_compressed(&ptr, rec_end);
+  if (ptr == nullptr) {
+    return -1;
+  }
+  rec->table_id = mach_parse_u64_much_compressed(&ptr, rec_end);
+  if (ptr == nullptr) {
+    return -1;
+  }
+
+  UndoField field;
+  switch (rec->type) {
+    case TRX_UNDO_INSERT_REC:
+      /* Only the primary key, up to the end of the record */
+      for (uint32_t i = 0; ptr < rec_end; i++) {
+        field.field_no = i;
+        if (!undo_read_field(&ptr, rec_end, &field)) {
+          return -1;
+        }
+        rec->pk.push_back(field);
+      }
+      return 0;
+    case TRX_UNDO_UPD_EXIST_REC:
+    case TRX_UNDO_UPD_DEL_REC:
+    case TRX_UNDO_DEL_MARK_REC:
+      break;
+    case TRX_UNDO_RENAME_TABLE:
+      return 0;
+    default:
+      return -1;
+  }
+
+  if (ptr >= rec_end) {
+    return -1;
+  }
+  rec->info_bits = *ptr++;
+  rec->trx_id = mach_u64_parse_compressed(&ptr, rec_end);
+  if (ptr == nullptr) {
+    return -1;
+  }
+  rec->roll_ptr = mach_u64_parse_compressed(&ptr, rec_end);
+  if (ptr == nullptr) {
+    return -1;
+  }
+  if (plan.layout == nullptr || rec->table_id != plan.table_id) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < plan.layout->n_uniq; i++) {
+    field.field_no = i;
+    if (!undo_read_field(&ptr, rec_end, &field)) {
+      return -1;
+    }
+    rec->pk.push_back(field);
+  }
+  if (rec->type == TRX_UNDO_DEL_MARK_REC) {
+    return 0;
+  }
+
+  const uint32_t n_fields = mach_parse_compressed(&ptr, rec_end);
+  if (ptr == nullptr || n_fields > plan.layout->fields.size()) {
+    return -1;
+  }
+  for (uint32_t i = 0; i < n_fields; i++) {
+    field.field_no = mach_parse_compressed(&ptr, rec_end);
+    if (ptr == nullptr || !undo_read_field(&ptr, rec_end, &field)) {
+      return -1;
+    }
+    rec->update.push_back(field);
+    if (field.is_extern && (page[offset + 2] & TRX_UNDO_MODIFY_BLOB)) {
+      /* The changes of a LOB updated in place follow, in a format of
+      their own */
+      rec->update_truncated = i + 1 < n_fields;
+      break;
+    }
+  }
+  /* The old values of the ordering fields that follow are not decoded */
+  return 0;
+}
+
+size_t undo_page_logs(const byte *page, UndoLogHeader *logs) {
+  const ulint free = mach_read_from_2(page + TRX_UNDO_PAGE_HDR +
+                                      TRX_UNDO_PAGE_FREE);
+  const fil_addr_t prev =
+      flst_get_prev_addr(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_NODE);
+  if (prev.page != FIL_NULL || free > UNIV_PAGE_SIZE - FIL_PAGE_DATA_END) {
+    return 0;
+  }
+  size_t n_logs = 0;
+  ulint log_offset =
+      mach_read_from_2(page + TRX_UNDO_SEG_HDR + TRX_UNDO_LAST_LOG);
+  while (log_offset != 0 && log_offset < free &&
+         n_logs < UNDO_PAGE_MAX_LOGS &&
+         (n_logs == 0 || log_offset < logs[n_logs - 1].offset)) {
+    const byte *log_hdr = page + log_offset;
+    UndoLogHeader &log = logs[n_logs++];
+    log.offset = log_offset;
+    log.trx_id = mach_read_from_8(log_hdr + TRX_UNDO_TRX_ID);
+    log.trx_no = mach_read_from_8(log_hdr + TRX_UNDO_TRX_NO);
+    log.del_marks = mach_read_from_2(log_hdr + TRX_UNDO_DEL_MARKS) != 0;
+    log_offset = mach_read_from_2(log_hdr + TRX_UNDO_PREV_LOG);
+  }
+  std::reverse(logs, logs + n_logs);
+  return n_logs;
+}
+
+bool undo_page_records(uint32_t page_no, const byte *page,
+                       const UndoPlan &plan, UndoRecord *rec,
+                       UndoScanStats *stats, const undo_rec_cb &cb) {
+  const ulint free = mach_read_from_2(page + TRX_UNDO_PAGE_HDR +
+                                      TRX_UNDO_PAGE_FREE);
+  if (free > UNIV_PAGE_SIZE - FIL_PAGE_DATA_END) {
+    stats->n_bad_records++;
+    return true;
+  }
+
+  /* The first page of an undo segment has the segment header and the
+  headers of the undo logs of the segment, each followed by its records.
+  The other pages hold records of the last log only. */
+  UndoLogHeader logs[UNDO_PAGE_MAX_LOGS];
+  const size_t n_logs = undo_page_logs(page, logs);
+
+  for (size_t l = 0; l < std::max<size_t>(n_logs, 1); l++) {
+    const UndoLogHeader *log = n_logs > 0 ? &logs[l] : nullptr;
+    ulint offset = TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_HDR_SIZE;
+    ulint end = free;
+    if (log != nullptr) {
+      offset = mach_read_from_2(page + log->offset + TRX_UNDO_LOG_START);
+      end = l + 1 < n_logs ? logs[l + 1].offset : free;
+    }
+    while (offset < end) {
+      const ulint next = mach_read_from_2(page + offset);
+      if (next <= offset || next > end ||
+          undo_rec_decode(page, offset, next, plan, rec) != 0) {
+        stats->n_bad_records++;
+        break;
+      }
+      stats->n_records++;
+      if (!cb(page_no, log, *rec)) {
+        return false;
+      }
+      offset = next;
+    }
+  }
+  return true;
+}
+
+int undo_scan_file(int fd, const UndoPlan &plan, const undo_rec_cb &cb,
+                   UndoScanStats *stats) {
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  const uint64_t n_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE,
+                     UNDO_READ_PAGES * UNIV_PAGE_SIZE) != 0) {
+    return -1;
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  UndoRecord rec;
+  int ret = 0;
+  for (uint64_t page_no = 0; page_no < n_pages; page_no += UNDO_READ_PAGES) {
+    const uint64_t n = std::min<uint64_t>(UNDO_READ_PAGES, n_pages - page_no);
+    ssize_t n_read = pread(fd, buf, n * UNIV_PAGE_SIZE, page_no * UNIV_PAGE_SIZE);
+    if (n_read != (ssize_t)(n * UNIV_PAGE_SIZE)) {
+      fprintf(stderr, "[ERROR] read of pages %lu..%lu failed: %s\n", page_no,
+              page_no + n - 1, n_read < 0 ? strerror(errno) : "short read");
+      ret = -1;
+      break;
+    }
+    stats->n_pages += n;
+    bool stop = false;
+    for (uint64_t i = 0; i < n && !stop; i++) {
+      const byte *page = buf + i * UNIV_PAGE_SIZE;
+      if (fil_page_get_type(page) != FIL_PAGE_UNDO_LOG) {
+        continue;
+      }
+      stats->n_undo_pages++;
+      stop = !undo_page_records(page_no + i, page, plan, &rec, stats, cb);
+    }
+    if (stop) {
+      break;
+    }
+  }
+  free(buf);
+  return ret;
+}
+
+const char *undo_rec_type_name(ulint type) {
+  switch (type) {
+    case TRX_UNDO_RENAME_TABLE:
+      return "rename_table";
+    case TRX_UNDO_INSERT_REC:
+      return "insert";
+    case TRX_UNDO_UPD_EXIST_REC:
+      return "update";
+    case TRX_UNDO_UPD_DEL_REC:
+      return "update_deleted";
+    case TRX_UNDO_DEL_MARK_REC:
+      return "delete_mark";
+    default:
+      return "unknown";
+  }
+}
@@ -0,0 +1,317 @@
+#include "include/undo_history.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/fut0lst.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+
+namespace {
+
+/** The walk of the history list of one rollback segment. */
+struct HistoryWalk {
+  RsegHistory *history;
+  /** Next node to visit, its page is read by the next round */
+  fil_addr_t next;
+  /** (header page, pages) of the undo log segments of the logs */
+  std::vector<std::pair<uint32_t, uint32_t>> segments;
+};
+
+/** The rollback segments walked by one thread. */
+struct HistoryThread {
+  HistoryThread() : failed(false) {}
+
+  std::vector<HistoryWalk> walks;
+  bool failed;
+};
+
+}  // namespace
+
+int undo_rseg_array_read(int fd, std::vector<uint32_t> *rseg_pages) {
+  byte *page = nullptr;
+  if (posix_memalign((void **)&page, UNIV_PAGE_SIZE, UNIV_PAGE_SIZE) != 0) {
+    return -1;
+  }
+  if (pread(fd, page, UNIV_PAGE_SIZE,
+            (uint64_t)FSP_RSEG_ARRAY_PAGE_NO * UNIV_PAGE_SIZE) !=
+      UNIV_PAGE_SIZE) {
+    fprintf(stderr, "[ERROR] read of the RSEG_ARRAY page failed\n");
+    free(page);
+    return -1;
+  }
+  if (fil_page_get_type(page) != FIL_PAGE_TYPE_RSEG_ARRAY ||
+      mach_read_from_4(page + RSEG_ARRAY_HEADER + RSEG_ARRAY_VERSION_OFFSET) !=
+          RSEG_ARRAY_VERSION) {
+    fprintf(stderr, "[ERROR] page %u is not an RSEG_ARRAY page, not an undo "
+            "tablespace?\n", (uint32_t)FSP_RSEG_ARRAY_PAGE_NO);
+    free(page);
+    return -1;
+  }
+  const byte *slots = page + RSEG_ARRAY_HEADER + RSEG_ARRAY_PAGES_OFFSET;
+  rseg_pages->clear();
+  for (ulint slot = 0; slot < TRX_SYS_N_RSEGS; slot++) {
+    rseg_pages->push_back(
+        mach_read_from_4(slots + slot * RSEG_ARRAY_SLOT_SIZE));
+  }
+  free(page);
+  return 0;
+}
+
+/** Read sorted distinct pages to consecutive frames of buf, one pread()
+per run of adjacent pages.
+@return 0 on success, -1 on a read error */
+static int history_read_pages(int fd, const std::vector<uint32_t> &pages,
+                              byte *buf) {
+  for (size_t i = 0; i < pages.size();) {
+    size_t n = 1;
+    while (i + n < pages.size() && pages[i + n] == pages[i] + n) {
+      n++;
+    }
+    const ssize_t len = n * UNIV_PAGE_SIZE;
+    ssize_t n_read = pread(fd, buf + i * UNIV_PAGE_SIZE, len,
+                           (uint64_t)pages[i] * UNIV_PAGE_SIZE);
+    if (n_read != len) {
+      fprintf(stderr, "[ERROR] read of pages %u..%u failed: %s\n", pages[i],
+              (uint32_t)(pages[i] + n - 1),
+              n_read < 0 ? strerror(errno) : "short read");
+      return -1;
+    }
+    i += n;
+  }
+  return 0;
+}
+
+/** Follow the history list of a rollback segment on a page, as long as
+its nodes are on that page.
+@return whether the walk goes on to another page */
+static bool history_walk_page(const byte *page, uint64_t n_pages,
+                              HistoryWalk *walk) {
+  RsegHistory &h = *walk->history;
+  const uint32_t page_no = walk->next.page;
+  while (walk->next.page == page_no) {
+    /* The node is TRX_UNDO_HISTORY_NODE of an undo log header */
+    const ulint boffset = walk->next.boffset;
+    if (boffset < FIL_PAGE_DATA + TRX_UNDO_HISTORY_NODE ||
+        boffset + FLST_NODE_SIZE > UNIV_PAGE_SIZE - FIL_PAGE_DATA_END ||
+        fil_page_get_type(page) != FIL_PAGE_UNDO_LOG) {
+      h.corrupt = true;
+      return false;
+    }
+    /* A list longer than its length loops */
+    if (h.n_logs == h.history_len) {
+      h.corrupt = true;
+      return false;
+    }
+    const byte *log_hdr = page + boffset - TRX_UNDO_HISTORY_NODE;
+    const uint64_t trx_no = mach_read_from_8(log_hdr + TRX_UNDO_TRX_NO);
+    h.oldest_trx_no = std::min(h.oldest_trx_no, trx_no);
+    h.newest_trx_no = std::max(h.newest_trx_no, trx_no);
+    walk->segments.push_back(std::make_pair(
+        page_no, (uint32_t)flst_get_len(page + TRX_UNDO_SEG_HDR +
+                                        TRX_UNDO_PAGE_LIST)));
+    h.n_logs++;
+    walk->next = flst_get_next_addr(page + boffset);
+  }
+  if (walk->next.page == FIL_NULL) {
+    h.corrupt = h.corrupt || h.n_logs != h.history_len;
+    return false;
+  }
+  if (walk->next.page >= n_pages) {
+    h.corrupt = true;
+    return false;
+  }
+  return true;
+}
+
+/** Walk the history lists of a set of rollback segments in lockstep. */
+static void history_walk_rsegs(int fd, uint64_t n_pages,
+                               HistoryThread *thread) {
+  std::vector<HistoryWalk> *walks = &thread->walks;
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE,
+                     walks->size() * UNIV_PAGE_SIZE) != 0) {
+    thread->failed = true;
+    return;
+  }
+  std::vector<HistoryWalk *> active;
+  std::vector<uint32_t> pages;
+
+  /* The first round reads the rollback segment headers */
+  for (size_t i = 0; i < walks->size(); i++) {
+    pages.push_back((*walks)[i].history->page_no);
+  }
+  std::sort(pages.begin(), pages.end());
+  pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+  if (history_read_pages(fd, pages, buf) != 0) {
+    free(buf);
+    thread->failed = true;
+    return;
+  }
+  for (size_t i = 0; i < walks->size(); i++) {
+    HistoryWalk &walk = (*walks)[i];
+    RsegHistory &h = *walk.history;
+    const size_t frame =
+        std::lower_bound(pages.begin(), pages.end(), h.page_no) - pages.begin();
+    const byte *rseg_hdr = buf + frame * UNIV_PAGE_SIZE + TRX_RSEG;
+    h.max_size = mach_read_from_4(rseg_hdr + TRX_RSEG_MAX_SIZE);
+    h.history_size = mach_read_from_4(rseg_hdr + TRX_RSEG_HISTORY_SIZE);
+    h.history_len = flst_get_len(rseg_hdr + TRX_RSEG_HISTORY);
+    walk.next = flst_get_first(rseg_hdr + TRX_RSEG_HISTORY);
+    if (walk.next.page == FIL_NULL) {
+      h.corrupt = h.history_len != 0;
+    } else if (walk.next.page >= n_pages) {
+      h.corrupt = true;
+    } else {
+      active.push_back(&walk);
+    }
+  }
+
+  while (!active.empty()) {
+    pages.clear();
+    for (size_t i = 0; i < active.size(); i++) {
+      pages.push_back(active[i]->next.page);
+    }
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+    if (history_read_pages(fd, pages, buf) != 0) {
+      thread->failed = true;
+      break;
+    }
+    size_t n_active = 0;
+    for (size_t i = 0; i < active.size(); i++) {
+      HistoryWalk *walk = active[i];
+      const size_t frame =
+          std::lower_bound(pages.begin(), pages.end(), walk->next.page) -
+          pages.begin();
+      if (history_walk_page(buf + frame * UNIV_PAGE_SIZE, n_pages, walk)) {
+        active[n_active++] = walk;
+      }
+    }
+    active.resize(n_active);
+  }
+  free(buf);
+
+  /* A cached undo log segment holds several logs of the history, its
+  pages are counted once */
+  for (size_t i = 0; i < walks->size(); i++) {
+    HistoryWalk &walk = (*walks)[i];
+    std::sort(walk.segments.begin(), walk.segments.end());
+    for (size_t s = 0; s < walk.segments.size(); s++) {
+      if (s > 0 && walk.segments[s].first == walk.segments[s - 1].first) {
+        continue;
+      }
+      walk.history->segments.push_back(walk.segments[s].first);
+      walk.history->n_seg_pages += walk.segments[s].second;
+    }
+  }
+}
+
+int undo_history_walk(int fd, const std::vector<uint32_t> &rseg_pages,
+                      uint32_t n_threads, std::vector<RsegHistory> *history) {
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  const uint64_t n_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+
+  history->clear();
+  for (size_t slot = 0; slot < rseg_pages.size(); slot++) {
+    if (rseg_pages[slot] == FIL_NULL) {
+      continue;
+    }
+    if (rseg_pages[slot] >= n_pages) {
+      fprintf(stderr, "[ERROR] rollback segment %u is on page %u, out of the "
+              "file\n", (uint32_t)slot, rseg_pages[slot]);
+      continue;
+    }
+    RsegHistory h;
+    h.rseg_id = slot;
+    h.page_no = rseg_pages[slot];
+    history->push_back(h);
+  }
+  if (history->empty()) {
+    return 0;
+  }
+
+  if (n_threads == 0) {
+    n_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  n_threads = std::min<uint64_t>(n_threads, history->size());
+  /* Round robin, the rollback segments in use are usually the first ones */
+  std::vector<HistoryThread> walkers(n_threads);
+  for (size_t i = 0; i < history->size(); i++) {
+    HistoryWalk walk;
+    walk.history = &(*history)[i];
+    walkers[i % n_threads].walks.push_back(walk);
+  }
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < n_threads; t++) {
+    threads.push_back(
+        std::thread(history_walk_rsegs, fd, n_pages, &walkers[t]));
+  }
+  for (uint32_t t = 0; t < n_threads; t++) {
+    threads[t].join();
+  }
+  for (uint32_t t = 0; t < n_threads; t++) {
+    if (walkers[t].failed) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void undo_history_print(const std::vector<RsegHistory> &history) {
+  uint64_t history_len = 0;
+  uint64_t history_size = 0;
+  uint64_t seg_pages = 0;
+  uint64_t n_corrupt = 0;
+  const RsegHistory *oldest = nullptr;
+  printf("%-6s %10s %12s %12s %10s %12s %20s %20s\n", "Rseg", "Page",
+         "History len", "Hist pages", "Segments", "Seg pages", "Oldest trx_no",
+         "Newest trx_no");
+  for (size_t i = 0; i < history.size(); i++) {
+    const RsegHistory &h = history[i];
+    history_len += h.n_logs;
+    history_size += h.history_size;
+    seg_pages += h.n_seg_pages;
+    n_corrupt += h.corrupt;
+    if (h.n_logs > 0 &&
+        (oldest == nullptr || h.oldest_trx_no < oldest->oldest_trx_no)) {
+      oldest = &h;
+    }
+    if (h.n_logs == 0) {
+      printf("%-6u %10u %12lu %12u %10s %12s %20s %20s%s\n", h.rseg_id,
+             h.page_no, h.n_logs, h.history_size, "-", "-", "-", "-",
+             h.corrupt ? " corrupt" : "");
+      continue;
+    }
+    printf("%-6u %10u %12lu %12u %10lu %12lu %20lu %20lu%s\n", h.rseg_id,
+           h.page_no, h.n_logs, h.history_size, (uint64_t)h.segments.size(),
+           h.n_seg_pages,
+           h.oldest_trx_no, h.newest_trx_no, h.corrupt ? " corrupt" : "");
+  }
+  printf("Rollback segments: %lu\n", (uint64_t)history.size());
+  printf("History list length: %lu\n", history_len);
+  printf("History pages: %lu, undo segment pages: %lu\n", history_size,
+         seg_pages);
+  if (oldest != nullptr) {
+    printf("Oldest trx_no: %lu in rseg %u\n", oldest->oldest_trx_no,
+           oldest->rseg_id);
+  }
+  if (n_corrupt > 0) {
+    printf("Rollback segments with a corrupt history list: %lu\n", n_corrupt);
+  }
+}
@@ -0,0 +1,462 @@
+#include "include/undo_usage.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/fsp0fsp.h"
+#include "include/fut0lst.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+#include "include/undo_decoder.h"
+#include "include/undo_history.h"
+
+/** Number of pages read by one pread() of a usage reader */
+static const uint32_t UNDO_USAGE_READ_PAGES = 64;
+
+/** Values of the page links other than the previous page of an undo log
+page. A segment header page has no previous page. */
+static const uint32_t UNDO_LINK_HEADER = FIL_NULL;
+static const uint32_t UNDO_LINK_NOT_UNDO = FIL_NULL - 1;
+static const uint32_t UNDO_LINK_ORPHAN = FIL_NULL - 2;
+static const uint32_t UNDO_LINK_VISITING = FIL_NULL - 3;
+
+namespace {
+
+/** What a reader thread found in its range of pages. */
+struct UndoUsageRange {
+  UndoUsageRange() : failed(false) {}
+
+  /** The page counters */
+  UndoSpaceUsage usage;
+  /** Segment header pages, in page order */
+  std::vector<UndoSegment> segments;
+  bool failed;
+};
+
+}  // namespace
+
+/** Read the segment header of the header page of an undo log segment. */
+static void undo_usage_segment(uint32_t page_no, const byte *page,
+                               UndoSegment *seg) {
+  seg->page_no = page_no;
+  seg->state = mach_read_from_2(page + TRX_UNDO_SEG_HDR + TRX_UNDO_STATE);
+  if (seg->state >= UNDO_N_STATES) {
+    seg->state = 0;
+  }
+  seg->type = mach_read_from_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_TYPE);
+  seg->list_len =
+      flst_get_len(page + TRX_UNDO_SEG_HDR + TRX_UNDO_PAGE_LIST);
+  seg->n_pages = 1;
+  const byte *fseg_hdr = page + TRX_UNDO_SEG_HDR + TRX_UNDO_FSEG_HEADER;
+  seg->inode_page = mach_read_from_4(fseg_hdr + FSEG_HDR_PAGE_NO);
+  seg->inode_offset = mach_read_from_2(fseg_hdr + FSEG_HDR_OFFSET);
+
+  /* The log headers are chained from the last one by TRX_UNDO_PREV_LOG,
+  at decreasing offsets */
+  ulint log_offset =
+      mach_read_from_2(page + TRX_UNDO_SEG_HDR + TRX_UNDO_LAST_LOG);
+  ulint prev_offset = UNIV_PAGE_SIZE;
+  while (log_offset >= TRX_UNDO_SEG_HDR + TRX_UNDO_SEG_HDR_SIZE &&
+         log_offset < prev_offset) {
+    seg->n_logs++;
+    prev_offset = log_offset;
+    log_offset = mach_read_from_2(page + log_offset + TRX_UNDO_PREV_LOG);
+  }
+}
+
+/** Classify one page. */
+static void undo_usage_page(uint32_t page_no, const byte *page,
+                            uint64_t n_pages, std::vector<uint32_t> *links,
+                            UndoUsageRange *range) {
+  UndoSpaceUsage &usage = range->usage;
+  switch (fil_page_get_type(page)) {
+    case FIL_PAGE_UNDO_LOG: {
+      usage.n_undo_pages++;
+      const uint32_t prev =
+          flst_get_prev_addr(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_NODE)
+              .page;
+      if (prev == FIL_NULL) {
+        UndoSegment seg;
+        undo_usage_segment(page_no, page, &seg);
+        range->segments.push_back(seg);
+        (*links)[page_no] = UNDO_LINK_HEADER;
+      } else {
+        (*links)[page_no] = prev < n_pages ? prev : UNDO_LINK_ORPHAN;
+      }
+      break;
+    }
+    case FIL_PAGE_TYPE_RSEG_ARRAY:
+    case FIL_PAGE_TYPE_SYS:
+      usage.n_rseg_pages++;
+      break;
+    case FIL_PAGE_TYPE_FSP_HDR:
+    case FIL_PAGE_TYPE_XDES:
+    case FIL_PAGE_INODE:
+      usage.n_space_pages++;
+      break;
+    case FIL_PAGE_TYPE_ALLOCATED:
+      usage.n_allocated_pages++;
+      break;
+    default:
+      usage.n_other_pages++;
+      break;
+  }
+}
+
+/** Read the pages [first, last) and classify them. */
+static void undo_usage_range(int fd, uint64_t n_pages, uint64_t first,
+                             uint64_t last, std::vector<uint32_t> *links,
+                             UndoUsageRange *range) {
+  byte *buf = nullptr;
+  if (posix_memalign((void **)&buf, UNIV_PAGE_SIZE,
+                     UNDO_USAGE_READ_PAGES * UNIV_PAGE_SIZE) != 0) {
+    range->failed = true;
+    return;
+  }
+  for (uint64_t page_no = first; page_no < last;
+       page_no += UNDO_USAGE_READ_PAGES) {
+    const uint64_t n =
+        std::min<uint64_t>(UNDO_USAGE_READ_PAGES, last - page_no);
+    ssize_t ret = pread(fd, buf, n * UNIV_PAGE_SIZE, page_no * UNIV_PAGE_SIZE);
+    if (ret != (ssize_t)(n * UNIV_PAGE_SIZE)) {
+      fprintf(stderr, "[ERROR] read of pages %lu..%lu failed: %s\n", page_no,
+              page_no + n - 1, ret < 0 ? strerror(errno) : "short read");
+      range->failed = true;
+      break;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+      undo_usage_page(page_no + i, buf + i * UNIV_PAGE_SIZE, n_pages, links,
+                      range);
+    }
+    range->usage.n_pages += n;
+  }
+  free(buf);
+}
+
+/** Find the segment header page of an undo log page by following the
+previous pages. The pages of the path are then linked to the header page
+directly, or marked as orphans, so that every page is followed once.
+@return header page, FIL_NULL if the page is linked to no header page */
+static uint32_t undo_usage_owner(uint32_t page_no, uint64_t n_pages,
+                                 std::vector<uint32_t> *links,
+                                 std::vector<uint32_t> *path) {
+  std::vector<uint32_t> &l = *links;
+  path->clear();
+  uint32_t owner = FIL_NULL;
+  for (uint32_t p = page_no;;) {
+    const uint32_t link = l[p];
+    if (link == UNDO_LINK_HEADER) {
+      owner = p;
+      break;
+    }
+    /* Not an undo log page, an orphan, or a loop */
+    if (link >= n_pages) {
+      break;
+    }
+    path->push_back(p);
+    l[p] = UNDO_LINK_VISITING;
+    p = link;
+  }
+  for (size_t i = 0; i < path->size(); i++) {
+    l[(*path)[i]] = owner == FIL_NULL ? UNDO_LINK_ORPHAN : owner;
+  }
+  return owner;
+}
+
+/** @return the segment of a header page, nullptr if none */
+static UndoSegment *undo_usage_find(std::vector<UndoSegment> &segments,
+                                    uint32_t page_no) {
+  std::vector<UndoSegment>::iterator it = std::lower_bound(
+      segments.begin(), segments.end(), page_no,
+      [](const UndoSegment &seg, uint32_t p) { return seg.page_no < p; });
+  return it != segments.end() && it->page_no == page_no ? &*it : nullptr;
+}
+
+/** Read the file segment inodes of the segments, one read per inode
+page. */
+static int undo_usage_inodes(int fd, uint64_t n_pages,
+                             std::vector<UndoSegment> &segments) {
+  std::vector<UndoSegment *> by_inode;
+  for (size_t i = 0; i < segments.size(); i++) {
+    if (segments[i].inode_page < n_pages &&
+        segments[i].inode_offset >= FSEG_ARR_OFFSET &&
+        segments[i].inode_offset + FSEG_INODE_SIZE <=
+            UNIV_PAGE_SIZE - FIL_PAGE_DATA_END) {
+      by_inode.push_back(&segments[i]);
+    }
+  }
+  std::sort(by_inode.begin(), by_inode.end(),
+            [](const UndoSegment *a, const UndoSegment *b) {
+              return a->inode_page < b->inode_page;
+            });
+  byte *page = nullptr;
+  if (posix_memalign((void **)&page, UNIV_PAGE_SIZE, UNIV_PAGE_SIZE) != 0) {
+    return -1;
+  }
+  uint32_t page_no = FIL_NULL;
+  for (size_t i = 0; i < by_inode.size(); i++) {
+    UndoSegment &seg = *by_inode[i];
+    if (seg.inode_page != page_no) {
+      page_no = seg.inode_page;
+      if (pread(fd, page, UNIV_PAGE_SIZE, (uint64_t)page_no * UNIV_PAGE_SIZE) !=
+          UNIV_PAGE_SIZE) {
+        fprintf(stderr, "[ERROR] read of inode page %u failed\n", page_no);
+        free(page);
+        return -1;
+      }
+    }
+    byte *inode = page + seg.inode_offset;
+    if (fil_page_get_type(page) != FIL_PAGE_INODE ||
+        mach_read_from_4(inode + FSEG_MAGIC_N) != FSEG_MAGIC_N_VALUE) {
+      continue;
+    }
+    ulint used = 0;
+    seg.reserved = fseg_n_reserved_pages_low(
+        mach_read_from_4(page + FIL_PAGE_SPACE_ID), inode, &used);
+    seg.used = std::min<ulint>(used, seg.reserved);
+  }
+  free(page);
+  return 0;
+}
+
+/** Find the rollback segment of every segment, from the undo slots of the
+rollback segment headers and from their history lists. */
+static int undo_usage_rsegs(int fd, uint64_t n_pages, uint32_t n_threads,
+                            UndoSpaceUsage *usage) {
+  std::vector<uint32_t> rseg_pages;
+  if (undo_rseg_array_read(fd, &rseg_pages) != 0) {
+    return -1;
+  }
+  byte *page = nullptr;
+  if (posix_memalign((void **)&page, UNIV_PAGE_SIZE, UNIV_PAGE_SIZE) != 0) {
+    return -1;
+  }
+  for (size_t slot = 0; slot < rseg_pages.size(); slot++) {
+    if (rseg_pages[slot] >= n_pages) {
+      continue;
+    }
+    RsegUsage rseg;
+    rseg.rseg_id = slot;
+    rseg.page_no = rseg_pages[slot];
+    usage->rsegs.push_back(rseg);
+    if (pread(fd, page, UNIV_PAGE_SIZE,
+              (uint64_t)rseg.page_no * UNIV_PAGE_SIZE) != UNIV_PAGE_SIZE) {
+      fprintf(stderr, "[ERROR] read of rollback segment page %u failed\n",
+              rseg.page_no);
+      free(page);
+      return -1;
+    }
+    const byte *slots = page + TRX_RSEG + TRX_RSEG_UNDO_SLOTS;
+    for (ulint i = 0; i < TRX_RSEG_N_SLOTS; i++) {
+      UndoSegment *seg = undo_usage_find(
+          usage->segments, mach_read_from_4(slots + i * TRX_RSEG_SLOT_SIZE));
+      if (seg != nullptr) {
+        seg->rseg_id = slot;
+        seg->in_slot = true;
+      }
+    }
+  }
+  free(page);
+
+  /* The segments of the committed transactions not purged yet are in no
+  undo slot unless they are cached for reuse */
+  std::vector<RsegHistory> history;
+  if (undo_history_walk(fd, rseg_pages, n_threads, &history) != 0) {
+    return -1;
+  }
+  for (size_t i = 0; i < history.size(); i++) {
+    for (size_t s = 0; s < history[i].segments.size(); s++) {
+      UndoSegment *seg =
+          undo_usage_find(usage->segments, history[i].segments[s]);
+      if (seg == nullptr) {
+        continue;
+      }
+      if (seg->rseg_id == UINT32_MAX) {
+        seg->rseg_id = history[i].rseg_id;
+      }
+      seg->in_history = true;
+    }
+  }
+  return 0;
+}
+
+int undo_usage_scan(int fd, uint32_t n_threads, UndoSpaceUsage *usage) {
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == -1) {
+    fprintf(stderr, "[ERROR] fstat failed: %s\n", strerror(errno));
+    return -1;
+  }
+  const uint64_t n_pages = stat_buf.st_size / UNIV_PAGE_SIZE;
+  if (n_threads == 0) {
+    n_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  /* Give every thread at least one read */
+  n_threads = std::max<uint64_t>(
+      1, std::min<uint64_t>(n_threads, n_pages / UNDO_USAGE_READ_PAGES));
+  const uint64_t per_thread = (n_pages + n_threads - 1) / n_threads;
+
+  /* The previous page of every undo log page, written by the thread of
+  its range */
+  std::vector<uint32_t> links(n_pages, UNDO_LINK_NOT_UNDO);
+  std::vector<UndoUsageRange> ranges(n_threads);
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < n_threads; t++) {
+    const uint64_t first = std::min(n_pages, t * per_thread);
+    const uint64_t last = std::min(n_pages, first + per_thread);
+    threads.push_back(std::thread(undo_usage_range, fd, n_pages, first, last,
+                                  &links, &ranges[t]));
+  }
+  for (uint32_t t = 0; t < n_threads; t++) {
+    threads[t].join();
+  }
+
+  /* The ranges are in page order, so are the segments once appended */
+  *usage = UndoSpaceUsage();
+  for (uint32_t t = 0; t < n_threads; t++) {
+    if (ranges[t].failed) {
+      return -1;
+    }
+    const UndoSpaceUsage &u = ranges[t].usage;
+    usage->n_pages += u.n_pages;
+    usage->n_undo_pages += u.n_undo_pages;
+    usage->n_rseg_pages += u.n_rseg_pages;
+    usage->n_space_pages += u.n_space_pages;
+    usage->n_allocated_pages += u.n_allocated_pages;
+    usage->n_other_pages += u.n_other_pages;
+    usage->segments.insert(usage->segments.end(), ranges[t].segments.begin(),
+                           ranges[t].segments.end());
+  }
+
+  std::vector<uint32_t> path;
+  for (uint64_t page_no = 0; page_no < n_pages; page_no++) {
+    const uint32_t link = links[page_no];
+    if (link == UNDO_LINK_HEADER || link == UNDO_LINK_NOT_UNDO) {
+      continue;
+    }
+    const uint32_t owner = link == UNDO_LINK_ORPHAN
+                               ? FIL_NULL
+                               : undo_usage_owner(page_no, n_pages, &links,
+                                                  &path);
+    UndoSegment *seg =
+        owner == FIL_NULL ? nullptr : undo_usage_find(usage->segments, owner);
+    if (seg == nullptr) {
+      usage->n_orphan_pages++;
+    } else {
+      seg->n_pages++;
+    }
+  }
+
+  if (undo_usage_inodes(fd, n_pages, usage->segments) != 0 ||
+      undo_usage_rsegs(fd, n_pages, n_threads, usage) != 0) {
+    return -1;
+  }
+  for (size_t i = 0; i < usage->segments.size(); i++) {
+    const UndoSegment &seg = usage->segments[i];
+    std::vector<RsegUsage>::iterator rseg = std::find_if(
+        usage->rsegs.begin(), usage->rsegs.end(),
+        [&](const RsegUsage &r) { return r.rseg_id == seg.rseg_id; });
+    if (rseg == usage->rsegs.end()) {
+      continue;
+    }
+    rseg->n_segments[seg.state]++;
+    rseg->n_pages[seg.state] += seg.n_pages;
+    if (seg.state == TRX_UNDO_CACHED && seg.n_logs > 1) {
+      rseg->n_cached_reused++;
+    }
+    rseg->n_reserved += seg.reserved;
+    rseg->n_free += seg.reserved - seg.used;
+  }
+  return 0;
+}
+
+/** @return "segments/pages" of a state */
+static std::string undo_usage_cell(uint64_t n_segments, uint64_t n_pages) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%lu/%lu", n_segments, n_pages);
+  return buf;
+}
+
+void undo_usage_print(const UndoSpaceUsage &usage) {
+  printf("Pages read: %lu\n", usage.n_pages);
+  printf("Undo log pages: %lu, of no segment: %lu\n", usage.n_undo_pages,
+         usage.n_orphan_pages);
+  printf("Rollback segment pages: %lu, space management pages: %lu, never "
+         "written: %lu, other: %lu\n",
+         usage.n_rseg_pages, usage.n_space_pages, usage.n_allocated_pages,
+         usage.n_other_pages);
+
+  /* Segments and pages, by state */
+  printf("%-6s %10s %16s %16s %16s %16s %8s %12s %12s\n", "Rseg", "Page",
+         "Active", "Cached", "To purge", "Other", "Reused", "Reserved",
+         "Free");
+  RsegUsage total;
+  uint64_t n_empty = 0;
+  for (size_t i = 0; i < usage.rsegs.size(); i++) {
+    const RsegUsage &r = usage.rsegs[i];
+    uint64_t n_segments = 0;
+    for (ulint s = 0; s < UNDO_N_STATES; s++) {
+      n_segments += r.n_segments[s];
+      total.n_segments[s] += r.n_segments[s];
+      total.n_pages[s] += r.n_pages[s];
+    }
+    total.n_cached_reused += r.n_cached_reused;
+    total.n_reserved += r.n_reserved;
+    total.n_free += r.n_free;
+    if (n_segments == 0) {
+      n_empty++;
+      continue;
+    }
+    const uint64_t n_other = r.n_segments[0] + r.n_segments[TRX_UNDO_TO_FREE] +
+                             r.n_segments[TRX_UNDO_PREPARED];
+    const uint64_t n_other_pages = r.n_pages[0] + r.n_pages[TRX_UNDO_TO_FREE] +
+                                   r.n_pages[TRX_UNDO_PREPARED];
+    printf("%-6u %10u %16s %16s %16s %16s %8lu %12lu %12lu\n", r.rseg_id,
+           r.page_no,
+           undo_usage_cell(r.n_segments[TRX_UNDO_ACTIVE],
+                           r.n_pages[TRX_UNDO_ACTIVE]).c_str(),
+           undo_usage_cell(r.n_segments[TRX_UNDO_CACHED],
+                           r.n_pages[TRX_UNDO_CACHED]).c_str(),
+           undo_usage_cell(r.n_segments[TRX_UNDO_TO_PURGE],
+                           r.n_pages[TRX_UNDO_TO_PURGE]).c_str(),
+           undo_usage_cell(n_other, n_other_pages).c_str(), r.n_cached_reused,
+           r.n_reserved, r.n_free);
+  }
+  if (n_empty > 0) {
+    printf("Rollback segments without undo log segments: %lu\n", n_empty);
+  }
+  printf("Total: active %s, cached %s (reused %lu), to purge %s "
+         "(segments/pages)\n",
+         undo_usage_cell(total.n_segments[TRX_UNDO_ACTIVE],
+                         total.n_pages[TRX_UNDO_ACTIVE]).c_str(),
+         undo_usage_cell(total.n_segments[TRX_UNDO_CACHED],
+                         total.n_pages[TRX_UNDO_CACHED]).c_str(),
+         total.n_cached_reused,
+         undo_usage_cell(total.n_segments[TRX_UNDO_TO_PURGE],
+                         total.n_pages[TRX_UNDO_TO_PURGE]).c_str());
+  printf("Pages reserved by the undo log segments: %lu, free: %lu\n",
+         total.n_reserved, total.n_free);
+
+  uint64_t n_lost = 0;
+  uint64_t n_lost_pages = 0;
+  for (size_t i = 0; i < usage.segments.size(); i++) {
+    if (usage.segments[i].rseg_id == UINT32_MAX) {
+      n_lost++;
+      n_lost_pages += usage.segments[i].n_pages;
+    }
+  }
+  if (n_lost > 0) {
+    printf("Undo log segments of no rollback segment: %lu, pages: %lu\n",
+           n_lost, n_lost_pages);
+  }
+}
@@ -0,0 +1,195 @@
+#include "../third_party/catch.hpp"
+#include "include/table_scan.h"
+#include "include/fil0fil.h"
+#include "include/mach_data.h"
+#include "include/fsp0types.h"
+#include "include/page0page.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char* kSdiPath = "/tmp/inno_test_btr_search.json";
+static const char* kIbdPath = "/tmp/inno_test_btr_search.ibd";
+
+/* CREATE TABLE t (id INT PRIMARY KEY) */
+static const char* kSdi =
+    "[\"ibd2sdi\", {\"type\": 1, \"id\": 1, \"object\": {"
+    "\"dd_object_type\": \"Table\", \"dd_object\": {\"name\": \"t\","
+    "\"columns\": ["
+    "{\"name\": \"id\", \"type\": 4, \"hidden\": 1, \"column_type_utf8\": \"int\"},"
+    "{\"name\": \"DB_TRX_ID\", \"type\": 10, \"hidden\": 2},"
+    "{\"name\": \"DB_ROLL_PTR\", \"type\": 9, \"hidden\": 2}],"
+    "\"indexes\": [{\"name\": \"PRIMARY\", \"type\": 1,"
+    "\"se_private_data\": \"id=100;root=3;\", \"elements\": ["
+    "{\"column_opx\": 0, \"length\": 4},"
+    "{\"column_opx\": 1, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 2, \"length\": 4294967295, \"hidden\": true}]}]}}}]";
+
+/* Build a compact index page holding fixed-size records whose first field
+is a 4 byte signed key, with a page directory slot for every 4 records. */
+static void build_page(byte* page, uint32_t page_no, uint32_t level,
+                       uint32_t prev, uint32_t next,
+                       const std::vector<int32_t>& keys,
+                       const std::vector<uint32_t>& children) {
+    memset(page, 0, UNIV_PAGE_SIZE);
+    mach_write_to_4(page + FIL_PAGE_OFFSET, page_no);
+    mach_write_to_4(page + FIL_PAGE_PREV, prev);
+    mach_write_to_4(page + FIL_PAGE_NEXT, next);
+    mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_INDEX);
+    mach_write_to_2(page + PAGE_HEADER + PAGE_LEVEL, level);
+    mach_write_to_2(page + PAGE_HEADER + PAGE_N_RECS, keys.size());
+    mach_write_to_2(page + PAGE_HEADER + PAGE_N_HEAP, 0x8000 | (keys.size() + 2));
+
+    byte* infimum = page + PAGE_NEW_INFIMUM;
+    byte* supremum = page + PAGE_NEW_SUPREMUM;
+    mach_write_to_2(infimum - 4, REC_STATUS_INFIMUM);
+    mach_write_to_2(supremum - 4, (1 << 3) | REC_STATUS_SUPREMUM);
+    memcpy(infimum, "infimum", 8);
+    memcpy(supremum, "supremum", 8);
+
+    std::vector<byte*> recs;
+    recs.push_back(infimum);
+    const uint32_t data_len = level ? 4 + 4 : 4 + 6 + 7;
+    byte* rec = page + PAGE_NEW_SUPREMUM_END + REC_N_NEW_EXTRA_BYTES;
+    for (size_t i = 0; i < keys.size(); i++) {
+        const bool min_rec = level > 0 && i == 0 && prev == FIL_NULL;
+        rec[-5] = min_rec ? REC_INFO_MIN_REC_FLAG : 0;
+        mach_write_to_2(rec - 4, ((i + 2) << 3) |
+                        (level ? REC_STATUS_NODE_PTR : REC_STATUS_ORDINARY));
+        mach_write_to_4(rec, (uint32_t)keys[i] ^ 0x80000000);
+        if (level) {
+            mach_write_to_4(rec + 4, children[i]);
+        }
+        recs.push_back(rec);
+        rec += data_len + REC_N_NEW_EXTRA_BYTES;
+    }
+    recs.push_back(supremum);
+    for (size_t i = 0; i + 1 < recs.size(); i++) {
+        mach_write_to_2(recs[i] - REC_NEXT, (recs[i + 1] - recs[i]) & 0xFFFF);
+    }
+
+    std::vector<byte*> owners;
+    owners.push_back(infimum);
+    for (size_t i = 4; i < keys.size(); i += 4) {
+        owners.push_back(recs[i]);
+    }
+    owners.push_back(supremum);
+    byte* dir = page + UNIV_PAGE_SIZE - PAGE_DIR;
+    for (size_t i = 0; i < owners.size(); i++) {
+        mach_write_to_2(dir - (i + 1) * PAGE_DIR_SLOT_SIZE, owners[i] - page);
+    }
+    mach_write_to_2(page + PAGE_HEADER + PAGE_N_DIR_SLOTS, owners.size());
+}
+
+/* Root page 3 over leaves 4, 5 and 6 holding the keys 2, 4, ..., 180 */
+static void build_tree() {
+    FILE* f = fopen(kSdiPath, "w");
+    fputs(kSdi, f);
+    fclose(f);
+
+    std::vector<byte> file(7 * UNIV_PAGE_SIZE);
+    std::vector<int32_t> node_keys;
+    std::vector<uint32_t> children;
+    for (uint32_t leaf = 0; leaf < 3; leaf++) {
+        std::vector<int32_t> keys;
+        for (int32_t k = 0; k < 30; k++) {
+            keys.push_back((leaf * 30 + k + 1) * 2);
+        }
+        uint32_t page_no = 4 + leaf;
+        build_page(&file[page_no * UNIV_PAGE_SIZE], page_no, 0,
+                   leaf ? page_no - 1 : FIL_NULL, leaf < 2 ? page_no + 1 : FIL_NULL,
+                   keys, std::vector<uint32_t>());
+        node_keys.push_back(keys[0]);
+        children.push_back(page_no);
+    }
+    build_page(&file[3 * UNIV_PAGE_SIZE], 3, 1, FIL_NULL, FIL_NULL, node_keys,
+               children);
+
+    f = fopen(kIbdPath, "wb");
+    fwrite(file.data(), 1, file.size(), f);
+    fclose(f);
+}
+
+/* Keys found by a range lookup, followed by the number of pages read */
+static std::vector<int64_t> lookup(const char* lo, const char* hi) {
+    std::vector<int64_t> ids;
+    TableScan scan;
+    REQUIRE(table_scan_open(kSdiPath, nullptr, nullptr, &scan) == 0);
+    SearchTuple lo_tuple;
+    SearchTuple hi_tuple;
+    if (lo) REQUIRE(search_tuple_build(scan.leaf_layout, lo, &lo_tuple) == 0);
+    if (hi) REQUIRE(search_tuple_build(scan.leaf_layout, hi, &hi_tuple) == 0);
+    const ColumnDef& id = scan.table.columns[0];
+
+    int fd = open(kIbdPath, O_RDONLY);
+    int64_t n_reads = table_scan_range(fd, scan, lo ? &lo_tuple : nullptr,
+                                       hi ? &hi_tuple : nullptr,
+                                       [&](const rec_t* rec, const ulint* offs) {
+        ids.push_back(rec_field_read_int(id, rec + rec_offs_field_start(offs, 0),
+                                         rec_offs_field_len(offs, 0)));
+        return true;
+    }, nullptr);
+    close(fd);
+    ids.push_back(n_reads);
+    return ids;
+}
+
+TEST_CASE(test_btr_search_point) {
+    build_tree();
+    /* root + one leaf */
+    REQUIRE(lookup("2", "2") == std::vector<int64_t>({2, 2}));
+    REQUIRE(lookup("60", "60") == std::vector<int64_t>({60, 2}));
+    REQUIRE(lookup("62", "62") == std::vector<int64_t>({62, 2}));
+    REQUIRE(lookup("150", "150") == std::vector<int64_t>({150, 2}));
+    REQUIRE(lookup("180", "180") == std::vector<int64_t>({180, 2}));
+    REQUIRE(lookup("77", "77") == std::vector<int64_t>({2}));
+    REQUIRE(lookup("-5", "-5") == std::vector<int64_t>({2}));
+    /* past the last key the scan stops at the end of the last leaf */
+    REQUIRE(lookup("181", "181") == std::vector<int64_t>({2}));
+}
+
+TEST_CASE(test_btr_search_range) {
+    build_tree();
+    REQUIRE(lookup("57", "65") == std::vector<int64_t>({58, 60, 62, 64, 3}));
+    REQUIRE(lookup(nullptr, "5") == std::vector<int64_t>({2, 4, 2}));
+    REQUIRE(lookup("177", nullptr) == std::vector<int64_t>({178, 180, 2}));
+    REQUIRE(lookup(nullptr, nullptr).size() == 91);
+    REQUIRE(lookup(nullptr, nullptr).back() == 4);
+}
+
+/* Overwrite 2 or 4 bytes at an offset of a page of the test file */
+static void patch_page(uint32_t page_no, ulint offset, uint32_t value,
+                       ulint len) {
+    byte field[4];
+    if (len == 2) {
+        mach_write_to_2(field, value);
+    } else {
+        mach_write_to_4(field, value);
+    }
+    int fd = open(kIbdPath, O_WRONLY);
+    REQUIRE(pwrite(fd, field, len, (off_t)page_no * UNIV_PAGE_SIZE + offset) ==
+            (ssize_t)len);
+    close(fd);
+}
+
+TEST_CASE(test_btr_search_corrupt) {
+    /* a child at the level of its parent */
+    build_tree();
+    patch_page(4, PAGE_HEADER + PAGE_LEVEL, 1, 2);
+    REQUIRE(lookup("2", "2") == std::vector<int64_t>({-1}));
+
+    /* a child of another index */
+    build_tree();
+    patch_page(5, PAGE_HEADER + PAGE_INDEX_ID + 4, 101, 4);
+    REQUIRE(lookup("62", "62") == std::vector<int64_t>({-1}));
+
+    /* a right sibling that is not a leaf, or of another index */
+    build_tree();
+    patch_page(4, FIL_PAGE_NEXT, 3, 4);
+    REQUIRE(lookup("57", "65") == std::vector<int64_t>({58, 60, -1}));
+    build_tree();
+    patch_page(5, PAGE_HEADER + PAGE_INDEX_ID + 4, 101, 4);
+    REQUIRE(lookup("57", "65") == std::vector<int64_t>({58, 60, -1}));
+}
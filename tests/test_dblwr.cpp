@@ -0,0 +1,206 @@
+#include "../third_party/catch.hpp"
+#include "include/dblwr.h"
+#include "include/fil0fil.h"
+#include "include/fil0types.h"
+#include "include/fsp0types.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+#include "include/page_crc32.h"
+#include "include/ut0crc32.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char* kDblwrSpace = "/tmp/inno_test_dblwr.ibd";
+static const char* kDblwrFile0 = "/tmp/inno_test_#ib_16384_0.dblwr";
+static const char* kDblwrFile1 = "/tmp/inno_test_#ib_16384_1.dblwr";
+static const char* kDblwrSys = "/tmp/inno_test_dblwr_ibdata1";
+
+/* A page of a tablespace with its LSN and a valid crc32 checksum */
+static void build_dblwr_page(byte* page, uint32_t space_id, uint32_t page_no,
+                             uint64_t lsn) {
+    memset(page, 0, UNIV_PAGE_SIZE);
+    mach_write_to_4(page + FIL_PAGE_OFFSET, page_no);
+    mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_INDEX);
+    mach_write_to_8(page + FIL_PAGE_LSN, lsn);
+    mach_write_to_4(page + FIL_PAGE_SPACE_ID, space_id);
+    mach_write_to_8(page + FIL_PAGE_DATA, lsn ^ page_no);
+    mach_write_to_4(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM + 4,
+                    lsn & 0xFFFFFFFF);
+    const uint32_t checksum = buf_calc_page_crc32(page, false);
+    mach_write_to_4(page + FIL_PAGE_SPACE_OR_CHKSUM, checksum);
+    mach_write_to_4(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM, checksum);
+}
+
+static void write_dblwr_file(const char* path, const std::vector<byte>& data) {
+    FILE* f = fopen(path, "wb");
+    fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+}
+
+TEST_CASE(test_page_is_corrupted) {
+    ut_crc32_init();
+    std::vector<byte> page(UNIV_PAGE_SIZE);
+    REQUIRE(page_is_zero(page.data()));
+    build_dblwr_page(page.data(), 9, 3, 1000);
+    REQUIRE(!page_is_zero(page.data()));
+    REQUIRE(!page_is_corrupted(page.data()));
+    page[FIL_PAGE_DATA + 100] ^= 1;
+    REQUIRE(page_is_corrupted(page.data()));
+    /* innodb_checksum_algorithm=none */
+    mach_write_to_4(&page[FIL_PAGE_SPACE_OR_CHKSUM], BUF_NO_CHECKSUM_MAGIC);
+    mach_write_to_4(&page[UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM],
+                    BUF_NO_CHECKSUM_MAGIC);
+    REQUIRE(!page_is_corrupted(page.data()));
+    /* A torn write */
+    mach_write_to_4(&page[FIL_PAGE_LSN + 4], 1001);
+    REQUIRE(page_is_corrupted(page.data()));
+}
+
+/* Write the checksums of innodb_checksum_algorithm=innodb: the new formula
+   in the header, then the old formula, which covers the header, in the
+   trailer */
+static void set_innodb_checksums(byte* page, uint32_t checksum) {
+    mach_write_to_4(page + FIL_PAGE_SPACE_OR_CHKSUM, checksum);
+    mach_write_to_4(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM,
+                    buf_calc_page_old_checksum(page));
+}
+
+TEST_CASE(test_page_is_corrupted_innodb_checksum) {
+    ut_crc32_init();
+    std::vector<byte> page(UNIV_PAGE_SIZE);
+    build_dblwr_page(page.data(), 9, 3, 1000);
+    const uint32_t crc = mach_read_from_4(&page[FIL_PAGE_SPACE_OR_CHKSUM]);
+    set_innodb_checksums(page.data(), buf_calc_page_new_checksum(page.data()));
+    REQUIRE(!page_is_corrupted(page.data()));
+    page[FIL_PAGE_DATA + 100] ^= 1;
+    REQUIRE(page_is_corrupted(page.data()));
+    page[FIL_PAGE_DATA + 100] ^= 1;
+    /* A header checksum of 0 is not checked */
+    set_innodb_checksums(page.data(), 0);
+    REQUIRE(!page_is_corrupted(page.data()));
+    /* Each field is checked against its own formula: a crc32 header with an
+       innodb trailer is corrupt */
+    set_innodb_checksums(page.data(), crc);
+    REQUIRE(page_is_corrupted(page.data()));
+    /* The old formula covers the first bytes of the page */
+    set_innodb_checksums(page.data(), buf_calc_page_new_checksum(page.data()));
+    page[FIL_PAGE_TYPE] ^= 1;
+    mach_write_to_4(&page[FIL_PAGE_SPACE_OR_CHKSUM],
+                    buf_calc_page_new_checksum(page.data()));
+    REQUIRE(page_is_corrupted(page.data()));
+}
+
+TEST_CASE(test_dblwr_restore) {
+    ut_crc32_init();
+    /* Copies of pages of space 9: 2, 3 and 4 in the first file, a newer
+    copy of 2 and an older one of 3 in the second, a torn copy, an empty
+    slot and page 6 of another space */
+    std::vector<byte> file0(6 * UNIV_PAGE_SIZE);
+    build_dblwr_page(&file0[0 * UNIV_PAGE_SIZE], 9, 2, 100);
+    build_dblwr_page(&file0[1 * UNIV_PAGE_SIZE], 9, 3, 200);
+    build_dblwr_page(&file0[2 * UNIV_PAGE_SIZE], 9, 4, 50);
+    build_dblwr_page(&file0[3 * UNIV_PAGE_SIZE], 10, 6, 100);
+    build_dblwr_page(&file0[4 * UNIV_PAGE_SIZE], 9, 5, 100);
+    file0[4 * UNIV_PAGE_SIZE + FIL_PAGE_LSN + 7] ^= 1;
+    std::vector<byte> file1(2 * UNIV_PAGE_SIZE);
+    build_dblwr_page(&file1[0], 9, 2, 150);
+    build_dblwr_page(&file1[UNIV_PAGE_SIZE], 9, 3, 120);
+    write_dblwr_file(kDblwrFile0, file0);
+    write_dblwr_file(kDblwrFile1, file1);
+
+    DblwrSet dblwr;
+    REQUIRE(dblwr.AddFile(kDblwrFile0) == 0);
+    REQUIRE(dblwr.AddFile(kDblwrFile1) == 0);
+    REQUIRE(dblwr.stats().n_files == 2);
+    REQUIRE(dblwr.stats().n_slots == 8);
+    REQUIRE(dblwr.stats().n_empty == 1);
+    REQUIRE(dblwr.stats().n_invalid == 1);
+    REQUIRE(dblwr.stats().n_superseded == 2);
+    REQUIRE(dblwr.n_pages() == 4);
+    REQUIRE(mach_read_from_8(dblwr.Find(9, 2) + FIL_PAGE_LSN) == 150);
+    REQUIRE(mach_read_from_8(dblwr.Find(9, 3) + FIL_PAGE_LSN) == 200);
+    REQUIRE(dblwr.Find(9, 5) == nullptr);
+    REQUIRE(dblwr.Find(9, 6) == nullptr);
+
+    /* Page 2 is torn, 3 zeroed, 4 corrupt but newer than its copy, 5 and
+    6 corrupt without a copy, 7 never written */
+    std::vector<byte> space(8 * UNIV_PAGE_SIZE);
+    for (uint32_t i = 0; i < 7; i++) {
+        build_dblwr_page(&space[i * UNIV_PAGE_SIZE], 9, i, 10 + i);
+    }
+    mach_write_to_4(&space[2 * UNIV_PAGE_SIZE + FIL_PAGE_LSN + 4], 99);
+    memset(&space[3 * UNIV_PAGE_SIZE], 0, UNIV_PAGE_SIZE);
+    build_dblwr_page(&space[4 * UNIV_PAGE_SIZE], 9, 4, 300);
+    space[4 * UNIV_PAGE_SIZE + FIL_PAGE_DATA] ^= 1;
+    space[5 * UNIV_PAGE_SIZE + FIL_PAGE_DATA] ^= 1;
+    space[6 * UNIV_PAGE_SIZE + FIL_PAGE_DATA] ^= 1;
+    write_dblwr_file(kDblwrSpace, space);
+
+    int fd = open(kDblwrSpace, O_RDWR);
+    REQUIRE(fd >= 0);
+    DblwrRestoreStats stats;
+    REQUIRE(dblwr_restore(fd, 9, dblwr, true, &stats) == 0);
+    REQUIRE(stats.n_pages == 8);
+    REQUIRE(stats.n_corrupt == 5);
+    REQUIRE(stats.corrupt_pages == (std::vector<uint32_t>{2, 3, 4, 5, 6}));
+    REQUIRE(stats.n_restored == 2);
+    REQUIRE(stats.n_stale_copy == 1);
+    REQUIRE(stats.n_no_copy == 2);
+    REQUIRE(stats.n_writes == 0);
+
+    stats = DblwrRestoreStats();
+    REQUIRE(dblwr_restore(fd, 9, dblwr, false, &stats) == 0);
+    REQUIRE(stats.n_restored == 2);
+    /* Pages 2 and 3 are adjacent */
+    REQUIRE(stats.n_writes == 1);
+    std::vector<byte> page(UNIV_PAGE_SIZE);
+    for (uint32_t page_no = 2; page_no <= 3; page_no++) {
+        REQUIRE(pread(fd, page.data(), UNIV_PAGE_SIZE, page_no * UNIV_PAGE_SIZE) ==
+                (ssize_t)UNIV_PAGE_SIZE);
+        REQUIRE(memcmp(page.data(), dblwr.Find(9, page_no), UNIV_PAGE_SIZE) == 0);
+    }
+
+    stats = DblwrRestoreStats();
+    REQUIRE(dblwr_restore(fd, 9, dblwr, true, &stats) == 0);
+    REQUIRE(stats.n_corrupt == 3);
+    REQUIRE(stats.n_restored == 0);
+    close(fd);
+    unlink(kDblwrSpace);
+    unlink(kDblwrFile0);
+    unlink(kDblwrFile1);
+}
+
+TEST_CASE(test_dblwr_system_space) {
+    ut_crc32_init();
+    /* The doublewrite buffer of MySQL before 8.0.20: two blocks of the
+    system tablespace found from its TRX_SYS page */
+    const uint32_t block1 = 8;
+    const uint32_t block2 = block1 + TRX_SYS_DOUBLEWRITE_BLOCK_SIZE;
+    std::vector<byte> ibdata((block2 + TRX_SYS_DOUBLEWRITE_BLOCK_SIZE) * UNIV_PAGE_SIZE);
+    byte* trx_sys = &ibdata[FSP_TRX_SYS_PAGE_NO * UNIV_PAGE_SIZE];
+    mach_write_to_2(trx_sys + FIL_PAGE_TYPE, FIL_PAGE_TYPE_TRX_SYS);
+    byte* doublewrite = trx_sys + TRX_SYS_DOUBLEWRITE;
+    mach_write_to_4(doublewrite + TRX_SYS_DOUBLEWRITE_MAGIC, TRX_SYS_DOUBLEWRITE_MAGIC_N);
+    mach_write_to_4(doublewrite + TRX_SYS_DOUBLEWRITE_BLOCK1, block1);
+    mach_write_to_4(doublewrite + TRX_SYS_DOUBLEWRITE_BLOCK2, block2);
+    build_dblwr_page(&ibdata[(block1 + 3) * UNIV_PAGE_SIZE], 9, 5, 100);
+    build_dblwr_page(&ibdata[(block2 + 1) * UNIV_PAGE_SIZE], 9, 6, 100);
+    write_dblwr_file(kDblwrSys, ibdata);
+
+    DblwrSet dblwr;
+    REQUIRE(dblwr.AddFile(kDblwrSys) == 0);
+    REQUIRE(dblwr.stats().n_slots == 2 * TRX_SYS_DOUBLEWRITE_BLOCK_SIZE);
+    REQUIRE(dblwr.n_pages() == 2);
+    REQUIRE(dblwr.Find(9, 5) != nullptr);
+    REQUIRE(dblwr.Find(9, 6) != nullptr);
+
+    /* Without the magic number there is no doublewrite buffer */
+    mach_write_to_4(doublewrite + TRX_SYS_DOUBLEWRITE_MAGIC, 0);
+    write_dblwr_file(kDblwrSys, ibdata);
+    DblwrSet none;
+    REQUIRE(none.AddFile(kDblwrSys) == -1);
+    unlink(kDblwrSys);
+}
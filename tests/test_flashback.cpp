@@ -0,0 +1,246 @@
+#include "../third_party/catch.hpp"
+#include "include/flashback.h"
+#include "include/undo_decoder.h"
+#include "include/fil0fil.h"
+#include "include/mach_data.h"
+#include "include/fsp0fsp.h"
+#include "include/fsp0types.h"
+#include "include/page0page.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+static const char* kSdiPath = "/tmp/inno_test_flashback.json";
+static const char* kIbdPath = "/tmp/inno_test_flashback.ibd";
+static const char* kUndoPath = "/tmp/inno_test_flashback.ibu";
+
+/* CREATE TABLE t (id INT PRIMARY KEY, v INT NOT NULL) */
+static const char* kSdi =
+    "[\"ibd2sdi\", {\"type\": 1, \"id\": 1, \"object\": {"
+    "\"dd_object_type\": \"Table\", \"dd_object\": {\"name\": \"t\","
+    "\"se_private_id\": 1200, \"columns\": ["
+    "{\"name\": \"id\", \"type\": 4, \"hidden\": 1, \"column_type_utf8\": \"int\"},"
+    "{\"name\": \"v\", \"type\": 4, \"hidden\": 1, \"column_type_utf8\": \"int\"},"
+    "{\"name\": \"DB_TRX_ID\", \"type\": 10, \"hidden\": 2},"
+    "{\"name\": \"DB_ROLL_PTR\", \"type\": 9, \"hidden\": 2}],"
+    "\"indexes\": [{\"name\": \"PRIMARY\", \"type\": 1,"
+    "\"se_private_data\": \"id=100;root=3;\", \"elements\": ["
+    "{\"column_opx\": 0, \"length\": 4},"
+    "{\"column_opx\": 2, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 3, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 1, \"length\": 4, \"hidden\": true}]}]}}}]";
+
+static const uint32_t kUndoSpaceId = 0xFFFFFFEF;
+
+struct version {
+    int32_t id;
+    int32_t v;
+    uint64_t trx_id;
+    uint64_t roll_ptr;
+    bool deleted;
+};
+
+static uint64_t roll_ptr(bool insert, uint32_t space_num, uint32_t page_no,
+                         uint32_t offset) {
+    return (uint64_t)insert << ROLL_PTR_INSERT_FLAG_POS |
+           (uint64_t)space_num << ROLL_PTR_SPACE_NUM_POS |
+           (uint64_t)page_no << ROLL_PTR_PAGE_POS | offset;
+}
+
+/* The root page 3 of t, a leaf with the current versions of the rows */
+static void build_leaf(byte* page, const std::vector<version>& rows) {
+    mach_write_to_4(page + FIL_PAGE_OFFSET, 3);
+    mach_write_to_4(page + FIL_PAGE_PREV, FIL_NULL);
+    mach_write_to_4(page + FIL_PAGE_NEXT, FIL_NULL);
+    mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_INDEX);
+    mach_write_to_2(page + PAGE_HEADER + PAGE_N_HEAP, 0x8000 | (rows.size() + 2));
+
+    byte* infimum = page + PAGE_NEW_INFIMUM;
+    byte* supremum = page + PAGE_NEW_SUPREMUM;
+    mach_write_to_2(infimum - 4, REC_STATUS_INFIMUM);
+    mach_write_to_2(supremum - 4, (1 << 3) | REC_STATUS_SUPREMUM);
+    byte* prev = infimum;
+    byte* rec = page + PAGE_NEW_SUPREMUM_END + REC_N_NEW_EXTRA_BYTES;
+    for (size_t i = 0; i < rows.size(); i++) {
+        rec[-5] = rows[i].deleted ? REC_INFO_DELETED_FLAG : 0;
+        mach_write_to_2(rec - 4, ((i + 2) << 3) | REC_STATUS_ORDINARY);
+        mach_write_to_4(rec, (uint32_t)rows[i].id ^ 0x80000000);
+        mach_write_to_6(rec + 4, rows[i].trx_id);
+        mach_write_to_7(rec + 4 + 6, rows[i].roll_ptr);
+        mach_write_to_4(rec + 4 + 6 + 7, (uint32_t)rows[i].v ^ 0x80000000);
+        mach_write_to_2(prev - REC_NEXT, (rec - prev) & 0xFFFF);
+        prev = rec;
+        rec += 4 + 6 + 7 + 4 + REC_N_NEW_EXTRA_BYTES;
+    }
+    mach_write_to_2(prev - REC_NEXT, (supremum - prev) & 0xFFFF);
+}
+
+static void put_compressed(std::vector<byte>* body, uint32_t n) {
+    byte buf[5];
+    body->insert(body->end(), buf, buf + mach_write_compressed(buf, n));
+}
+
+static void put_int_field(std::vector<byte>* body, int32_t n) {
+    byte buf[4];
+    mach_write_to_4(buf, (uint32_t)n ^ 0x80000000);
+    put_compressed(body, 4);
+    body->insert(body->end(), buf, buf + 4);
+}
+
+/* Append an undo record of the previous version of a row to an undo page,
+the old value of v for an update. @return roll pointer of the record */
+static uint64_t put_undo(byte* page, uint32_t page_no, ulint type,
+                         const version& prev) {
+    std::vector<byte> body;
+    byte buf[11];
+    body.push_back(type);
+    body.insert(body.end(), buf, buf + mach_u64_write_much_compressed(buf, 0));
+    body.insert(body.end(), buf,
+                buf + mach_u64_write_much_compressed(buf, 1200));
+    body.push_back(prev.deleted ? REC_INFO_DELETED_FLAG : 0);
+    body.insert(body.end(), buf,
+                buf + mach_u64_write_compressed(buf, prev.trx_id));
+    body.insert(body.end(), buf,
+                buf + mach_u64_write_compressed(buf, prev.roll_ptr));
+    put_int_field(&body, prev.id);
+    if (type != TRX_UNDO_DEL_MARK_REC) {
+        put_compressed(&body, 1);
+        put_compressed(&body, 3);
+        put_int_field(&body, prev.v);
+    }
+
+    byte* free = page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE;
+    ulint offset = mach_read_from_2(free);
+    if (offset == 0) {
+        mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_UNDO_LOG);
+        offset = TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_HDR_SIZE;
+    }
+    const ulint next = offset + 2 + body.size() + 2;
+    mach_write_to_2(page + offset, next);
+    memcpy(page + offset + 2, body.data(), body.size());
+    mach_write_to_2(page + next - 2, offset);
+    mach_write_to_2(free, next);
+    return roll_ptr(false, 1, page_no, offset);
+}
+
+static std::vector<std::pair<int32_t, int32_t> > flashback(
+        uint32_t capacity, FlashbackStats* stats, UndoPageCache** cache_out) {
+    TableScan scan;
+    REQUIRE(table_scan_open(kSdiPath, nullptr, "id,v", &scan) == 0);
+    int fd = open(kIbdPath, O_RDONLY);
+    int undo_fd = open(kUndoPath, O_RDONLY);
+    REQUIRE(fd >= 0);
+    REQUIRE(undo_fd >= 0);
+    UndoPageCache* cache = new UndoPageCache(capacity);
+    REQUIRE(cache->AddFile(undo_fd) == 1);
+    REQUIRE(cache->AddFile(undo_fd) == -1);
+
+    std::vector<std::pair<int32_t, int32_t> > rows;
+    REQUIRE(flashback_scan(fd, scan, cache, 100, [&](const FlashbackField* f) {
+        REQUIRE(f[0].len == 4);
+        REQUIRE(f[3].len == 4);
+        REQUIRE(mach_read_from_6(f[1].data) < 100);
+        rows.push_back(std::make_pair(
+            (int32_t)(mach_read_from_4(f[0].data) ^ 0x80000000),
+            (int32_t)(mach_read_from_4(f[3].data) ^ 0x80000000)));
+        return true;
+    }, stats) == 1);
+    close(fd);
+    close(undo_fd);
+    *cache_out = cache;
+    return rows;
+}
+
+TEST_CASE(test_undo_space_id2num) {
+    REQUIRE(undo_space_id2num(0) == 0);
+    REQUIRE(undo_space_id2num(3) == 3);
+    REQUIRE(undo_space_id2num(0xFFFFFFEF) == 1);
+    REQUIRE(undo_space_id2num(0xFFFFFFEE) == 2);
+    /* The id of undo space 1 after a truncation */
+    REQUIRE(undo_space_id2num(0xFFFFFFEF - 127) == 1);
+}
+
+TEST_CASE(test_flashback_scan) {
+    FILE* f = fopen(kSdiPath, "w");
+    fputs(kSdi, f);
+    fclose(f);
+
+    /* The undo tablespace: records on the adjacent pages 5 and 6 and on
+    page 9 */
+    std::vector<byte> undo(12 * UNIV_PAGE_SIZE);
+    mach_write_to_4(&undo[FSP_HEADER_OFFSET + FSP_SPACE_ID], kUndoSpaceId);
+    byte* p5 = &undo[5 * UNIV_PAGE_SIZE];
+    byte* p6 = &undo[6 * UNIV_PAGE_SIZE];
+    byte* p9 = &undo[9 * UNIV_PAGE_SIZE];
+    const uint64_t no_undo = roll_ptr(true, 1, 4, 200);
+
+    /* Row 2 was updated after trx 100, row 3 twice */
+    const uint64_t r2 = put_undo(p5, 5, TRX_UNDO_UPD_EXIST_REC,
+                                 {2, 20, 60, no_undo, false});
+    const uint64_t r3_old = put_undo(p9, 9, TRX_UNDO_UPD_EXIST_REC,
+                                     {3, 30, 70, no_undo, false});
+    const uint64_t r3 = put_undo(p6, 6, TRX_UNDO_UPD_EXIST_REC,
+                                 {3, 31, 130, r3_old, false});
+    /* Row 5 was deleted after trx 100, row 9 reinserted over a row deleted
+    before */
+    const uint64_t r5 = put_undo(p5, 5, TRX_UNDO_DEL_MARK_REC,
+                                 {5, 50, 80, no_undo, false});
+    const uint64_t r9 = put_undo(p6, 6, TRX_UNDO_UPD_DEL_REC,
+                                 {9, 90, 40, no_undo, true});
+    /* A record of another row, where the purged history of row 8 was */
+    const uint64_t r8 = put_undo(p6, 6, TRX_UNDO_UPD_EXIST_REC,
+                                 {7, 70, 20, no_undo, false});
+
+    std::vector<byte> ibd(4 * UNIV_PAGE_SIZE);
+    build_leaf(&ibd[3 * UNIV_PAGE_SIZE],
+               {{1, 10, 50, no_undo, false},
+                {2, 21, 120, r2, false},
+                {3, 32, 150, r3, false},
+                /* Inserted after trx 100 */
+                {4, 40, 110, roll_ptr(true, 1, 7, 100), false},
+                {5, 50, 120, r5, true},
+                /* Deleted before trx 100 */
+                {6, 60, 90, no_undo, true},
+                /* Undo space 2 was not given */
+                {7, 71, 200, roll_ptr(false, 2, 5, 100), false},
+                {8, 80, 130, r8, false},
+                {9, 91, 140, r9, false}});
+
+    f = fopen(kIbdPath, "wb");
+    fwrite(ibd.data(), 1, ibd.size(), f);
+    fclose(f);
+    f = fopen(kUndoPath, "wb");
+    fwrite(undo.data(), 1, undo.size(), f);
+    fclose(f);
+
+    const std::vector<std::pair<int32_t, int32_t> > expected = {
+        {1, 10}, {2, 20}, {3, 30}, {5, 50}};
+    for (uint32_t capacity = 1; capacity <= FLASHBACK_CACHE_PAGES;
+         capacity *= FLASHBACK_CACHE_PAGES) {
+        FlashbackStats stats;
+        UndoPageCache* cache = nullptr;
+        REQUIRE(flashback(capacity, &stats, &cache) == expected);
+        REQUIRE(stats.n_records == 9);
+        REQUIRE(stats.n_rows == 4);
+        REQUIRE(stats.n_rebuilt == 3);
+        REQUIRE(stats.n_versions == 5);
+        REQUIRE(stats.n_inserted_after == 1);
+        REQUIRE(stats.n_deleted == 2);
+        REQUIRE(stats.n_history_missing == 2);
+        REQUIRE(stats.n_rounds == 2);
+        if (capacity > 1) {
+            /* Pages 5 and 6 in one read, then page 9 */
+            REQUIRE(cache->n_reads() == 2);
+            REQUIRE(cache->n_pages_read() == 3);
+        } else {
+            REQUIRE(cache->n_pages_read() == 3);
+        }
+        delete cache;
+    }
+    unlink(kSdiPath);
+    unlink(kIbdPath);
+    unlink(kUndoPath);
+}
@@ -0,0 +1,422 @@
+#include "../third_party/catch.hpp"
+#include "include/lob_reader.h"
+#include "include/rec_decoder.h"
+#include "include/fil0fil.h"
+#include "include/mach_data.h"
+#include "include/fsp0types.h"
+#include "include/page0page.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+static const char* kLobPath = "/tmp/inno_test_lob.ibd";
+
+/* Byte i of the test values */
+static byte lob_byte(size_t i) {
+    return static_cast<byte>(i * 7 + i / 251);
+}
+
+static byte* file_page(std::vector<byte>& file, uint32_t page_no) {
+    if (file.size() < (page_no + 1) * UNIV_PAGE_SIZE) {
+        file.resize((page_no + 1) * UNIV_PAGE_SIZE);
+    }
+    return &file[page_no * UNIV_PAGE_SIZE];
+}
+
+static void write_addr(byte* p, uint32_t page_no, uint32_t boffset) {
+    mach_write_to_4(p, page_no);
+    mach_write_to_2(p + 4, boffset);
+}
+
+static void write_file(const std::vector<byte>& file) {
+    FILE* f = fopen(kLobPath, "wb");
+    REQUIRE(f != nullptr);
+    REQUIRE(fwrite(file.data(), 1, file.size(), f) == file.size());
+    fclose(f);
+}
+
+static void write_ref(byte* ref, uint32_t page_no, uint64_t len) {
+    memset(ref, 0, BTR_EXTERN_FIELD_REF_SIZE);
+    mach_write_to_4(ref + BTR_EXTERN_PAGE_NO, page_no);
+    mach_write_to_4(ref + BTR_EXTERN_LEN + 4, len);
+    ref[BTR_EXTERN_LEN] = BTR_EXTERN_OWNER_FLAG;
+}
+
+/* Build a new format LOB of len bytes with its first page at first_page_no
+and its data pages at pages. The index entries which do not fit the first
+page go to a LOB index page at index_page_no. */
+static void build_new_lob(std::vector<byte>& file, uint32_t first_page_no,
+                          uint32_t index_page_no,
+                          const std::vector<uint32_t>& pages, size_t len) {
+    const ulint entry_size = (ulint)BlobIndexEntry::SIZE;
+    const ulint first_data = (ulint)BlobFirstPage::LOB_PAGE_DATA +
+                             (ulint)BlobFirstPage::N_INDEX_ENTRIES * entry_size;
+    const ulint first_cap = UNIV_PAGE_SIZE - FIL_PAGE_DATA_END - first_data;
+    const ulint data_cap = UNIV_PAGE_SIZE - FIL_PAGE_DATA_END -
+                           (ulint)BlobDataPage::LOB_PAGE_DATA;
+
+    mach_write_to_2(file_page(file, first_page_no) + FIL_PAGE_TYPE,
+                    FIL_PAGE_TYPE_LOB_FIRST);
+    mach_write_to_2(file_page(file, index_page_no) + FIL_PAGE_TYPE,
+                    FIL_PAGE_TYPE_LOB_INDEX);
+
+    /* Entry i describes the first page for i = 0, then pages[i - 1] */
+    std::vector<std::pair<uint32_t, ulint> > addrs;
+    size_t pos = 0;
+    for (size_t i = 0; i <= pages.size(); i++) {
+        uint32_t entry_page;
+        ulint boffset;
+        if (i < (ulint)BlobFirstPage::N_INDEX_ENTRIES) {
+            entry_page = first_page_no;
+            boffset = (ulint)BlobFirstPage::LOB_PAGE_DATA + i * entry_size;
+        } else {
+            entry_page = index_page_no;
+            boffset = (ulint)BlobIndexPage::LOB_PAGE_DATA +
+                      (i - (ulint)BlobFirstPage::N_INDEX_ENTRIES) * entry_size;
+        }
+        addrs.push_back(std::make_pair(entry_page, boffset));
+
+        const uint32_t data_page_no = i == 0 ? first_page_no : pages[i - 1];
+        size_t n = std::min<size_t>(len - pos, i == 0 ? first_cap : data_cap);
+        byte* data;
+        if (i == 0) {
+            data = file_page(file, first_page_no) + first_data;
+            mach_write_to_4(file_page(file, first_page_no) +
+                            (ulint)BlobFirstPage::OFFSET_DATA_LEN, n);
+        } else {
+            byte* page = file_page(file, data_page_no);
+            mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_TYPE_LOB_DATA);
+            mach_write_to_4(page + (ulint)BlobDataPage::OFFSET_DATA_LEN, n);
+            data = page + (ulint)BlobDataPage::LOB_PAGE_DATA;
+        }
+        for (size_t j = 0; j < n; j++) {
+            data[j] = lob_byte(pos + j);
+        }
+        pos += n;
+
+        byte* entry = file_page(file, entry_page) + boffset;
+        mach_write_to_4(entry + (ulint)BlobIndexEntry::OFFSET_PAGE_NO, data_page_no);
+        mach_write_to_2(entry + (ulint)BlobIndexEntry::OFFSET_DATA_LEN, n);
+    }
+    REQUIRE(pos == len);
+
+    for (size_t i = 0; i < addrs.size(); i++) {
+        byte* entry = file_page(file, addrs[i].first) + addrs[i].second;
+        if (i > 0) {
+            write_addr(entry, addrs[i - 1].first, addrs[i - 1].second);
+        } else {
+            write_addr(entry, FIL_NULL, 0);
+        }
+        if (i + 1 < addrs.size()) {
+            write_addr(entry + FIL_ADDR_SIZE, addrs[i + 1].first, addrs[i + 1].second);
+        } else {
+            write_addr(entry + FIL_ADDR_SIZE, FIL_NULL, 0);
+        }
+    }
+    byte* base = file_page(file, first_page_no) + (ulint)BlobFirstPage::OFFSET_INDEX_LIST;
+    mach_write_to_4(base, addrs.size());
+    write_addr(base + 4, addrs.front().first, addrs.front().second);
+    write_addr(base + 4 + FIL_ADDR_SIZE, addrs.back().first, addrs.back().second);
+}
+
+TEST_CASE(test_lob_read_new_format) {
+    /* 80 data pages in three runs, more than one batch */
+    std::vector<uint32_t> pages;
+    for (uint32_t p = 10; p < 40; p++) pages.push_back(p);
+    for (uint32_t p = 60; p < 100; p++) pages.push_back(p);
+    for (uint32_t p = 45; p < 55; p++) pages.push_back(p);
+    /* The first page and 79 data pages full, 1234 bytes in the last one */
+    const size_t len = 15680 + 79 * 16327 + 1234;
+    std::vector<byte> file;
+    build_new_lob(file, 4, 5, pages, len);
+    write_file(file);
+
+    int fd = open(kLobPath, O_RDONLY);
+    REQUIRE(fd >= 0);
+    LobReader lob(fd);
+
+    /* A COMPACT record keeps a 768 byte prefix before the reference */
+    std::vector<byte> field(768 + BTR_EXTERN_FIELD_REF_SIZE);
+    for (size_t i = 0; i < 768; i++) field[i] = 'p';
+    write_ref(&field[768], 4, len);
+
+    std::string value;
+    size_t n_parts = 0;
+    int64_t ret = lob.ReadField(field.data(), field.size(),
+                                [&](const byte* data, ulint n) {
+        value.append(reinterpret_cast<const char*>(data), n);
+        n_parts++;
+        return true;
+    });
+    REQUIRE(ret == (int64_t)(768 + len));
+    REQUIRE(value.size() == 768 + len);
+    REQUIRE(n_parts == 1 + 81);
+    REQUIRE(value.compare(0, 768, std::string(768, 'p')) == 0);
+    bool same = true;
+    for (size_t i = 0; i < len && same; i++) {
+        same = (byte)value[768 + i] == lob_byte(i);
+    }
+    REQUIRE(same);
+
+    /* The reader stops when asked to */
+    size_t n_seen = 0;
+    ret = lob.Read(&field[768], [&](const byte*, ulint n) {
+        n_seen += n;
+        return false;
+    });
+    REQUIRE(ret == (int64_t)n_seen);
+
+    /* A length the LOB does not have, a reference to a data page */
+    write_ref(&field[768], 4, len + 1);
+    REQUIRE(lob.Read(&field[768], [](const byte*, ulint) { return true; }) == -1);
+    write_ref(&field[768], 10, len);
+    REQUIRE(lob.Read(&field[768], [](const byte*, ulint) { return true; }) == -1);
+    close(fd);
+
+    /* A data page of the wrong type */
+    mach_write_to_2(file_page(file, 70) + FIL_PAGE_TYPE, FIL_PAGE_TYPE_ALLOCATED);
+    write_file(file);
+    fd = open(kLobPath, O_RDONLY);
+    REQUIRE(fd >= 0);
+    LobReader corrupt(fd);
+    write_ref(&field[768], 4, len);
+    REQUIRE(corrupt.Read(&field[768], [](const byte*, ulint) { return true; }) == -1);
+    close(fd);
+    unlink(kLobPath);
+}
+
+/* Build an old format BLOB of len bytes on a chain of pages, the first
+part at FIL_PAGE_DATA of pages[0]. Every page holds part_len bytes. */
+static void build_old_blob(std::vector<byte>& file,
+                           const std::vector<uint32_t>& pages, size_t len,
+                           size_t part_len) {
+    size_t pos = 0;
+    for (size_t i = 0; i < pages.size(); i++) {
+        byte* page = file_page(file, pages[i]);
+        mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_TYPE_BLOB);
+        size_t n = std::min(part_len, len - pos);
+        byte* part = page + FIL_PAGE_DATA;
+        mach_write_to_4(part + BTR_BLOB_HDR_PART_LEN, n);
+        mach_write_to_4(part + BTR_BLOB_HDR_NEXT_PAGE_NO,
+                        i + 1 < pages.size() ? pages[i + 1] : FIL_NULL);
+        for (size_t j = 0; j < n; j++) {
+            part[BTR_BLOB_HDR_SIZE + j] = lob_byte(pos + j);
+        }
+        pos += n;
+    }
+    REQUIRE(pos == len);
+}
+
+static int64_t read_old_blob(const std::vector<byte>& file, uint32_t page_no,
+                             size_t len, std::string* value) {
+    write_file(file);
+    int fd = open(kLobPath, O_RDONLY);
+    REQUIRE(fd >= 0);
+    byte ref[BTR_EXTERN_FIELD_REF_SIZE];
+    write_ref(ref, page_no, len);
+    mach_write_to_4(ref + BTR_EXTERN_OFFSET, FIL_PAGE_DATA);
+    value->clear();
+    LobReader lob(fd);
+    int64_t ret = lob.Read(ref, [&](const byte* data, ulint n) {
+        value->append(reinterpret_cast<const char*>(data), n);
+        return true;
+    });
+    close(fd);
+    return ret;
+}
+
+TEST_CASE(test_lob_read_old_chain) {
+    const uint32_t chain[] = {7, 3, 12, 8, 9};
+    std::vector<uint32_t> pages(chain, chain + 5);
+    const size_t len = 4 * 16000 + 77;
+    std::vector<byte> file;
+    build_old_blob(file, pages, len, 16000);
+
+    std::string value;
+    REQUIRE(read_old_blob(file, 7, len, &value) == (int64_t)len);
+    REQUIRE(value.size() == len);
+    bool same = true;
+    for (size_t i = 0; i < len && same; i++) {
+        same = (byte)value[i] == lob_byte(i);
+    }
+    REQUIRE(same);
+
+    /* The chain is shorter than the reference says */
+    REQUIRE(read_old_blob(file, 7, len + 1, &value) == -1);
+
+    /* The chain comes back to page 3 */
+    std::vector<byte> cycle = file;
+    mach_write_to_4(file_page(cycle, 9) + FIL_PAGE_DATA + BTR_BLOB_HDR_NEXT_PAGE_NO, 3);
+    mach_write_to_4(file_page(cycle, 9) + FIL_PAGE_DATA + BTR_BLOB_HDR_PART_LEN, 0);
+    REQUIRE(read_old_blob(cycle, 7, len, &value) == -1);
+
+    /* The chain goes past the end of the file, or to a page of another type */
+    std::vector<byte> broken = file;
+    mach_write_to_4(file_page(broken, 12) + FIL_PAGE_DATA + BTR_BLOB_HDR_NEXT_PAGE_NO, 1000);
+    REQUIRE(read_old_blob(broken, 7, len, &value) == -1);
+    broken = file;
+    mach_write_to_2(file_page(broken, 8) + FIL_PAGE_TYPE, FIL_PAGE_INDEX);
+    REQUIRE(read_old_blob(broken, 7, len, &value) == -1);
+    unlink(kLobPath);
+}
+
+/* Build a compressed BLOB of value in a tablespace of 8K compressed pages:
+the zlib stream starts after the next page number at offset in the
+FIL_PAGE_TYPE_ZBLOB page pages[0] and goes on in FIL_PAGE_TYPE_ZBLOB2 pages
+from FIL_PAGE_DATA to the end of each page. */
+static void build_zblob(std::vector<byte>& file, const std::string& value,
+                        const std::vector<uint32_t>& pages, ulint offset) {
+    const ulint zip_size = 8192;
+    uLongf stream_len = compressBound(value.size());
+    std::vector<byte> stream(stream_len);
+    REQUIRE(compress(stream.data(), &stream_len,
+                     reinterpret_cast<const Bytef*>(value.data()),
+                     value.size()) == Z_OK);
+    uint32_t max_page = *std::max_element(pages.begin(), pages.end());
+    file.assign((max_page + 1) * zip_size, 0);
+    mach_write_to_4(&file[FIL_PAGE_DATA + 16], 4 << 1);
+    size_t pos = 0;
+    for (size_t i = 0; i < pages.size(); i++) {
+        byte* page = &file[pages[i] * zip_size];
+        ulint next = i == 0 ? offset : FIL_PAGE_NEXT;
+        ulint data = i == 0 ? offset + 4 : FIL_PAGE_DATA;
+        mach_write_to_2(page + FIL_PAGE_TYPE,
+                        i == 0 ? FIL_PAGE_TYPE_ZBLOB : FIL_PAGE_TYPE_ZBLOB2);
+        mach_write_to_4(page + next,
+                        i + 1 < pages.size() ? pages[i + 1] : FIL_NULL);
+        size_t n = std::min<size_t>(zip_size - data, stream_len - pos);
+        memcpy(page + data, &stream[pos], n);
+        pos += n;
+    }
+    REQUIRE(pos == stream_len);
+}
+
+static int64_t read_zblob(const std::vector<byte>& file, uint32_t page_no,
+                          ulint offset, size_t len, std::string* value) {
+    write_file(file);
+    int fd = open(kLobPath, O_RDONLY);
+    REQUIRE(fd >= 0);
+    byte ref[BTR_EXTERN_FIELD_REF_SIZE];
+    write_ref(ref, page_no, len);
+    mach_write_to_4(ref + BTR_EXTERN_OFFSET, offset);
+    value->clear();
+    LobReader lob(fd);
+    int64_t ret = lob.Read(ref, [&](const byte* data, ulint n) {
+        value->append(reinterpret_cast<const char*>(data), n);
+        return true;
+    });
+    /* The inflate stream is reused by the next value */
+    if (ret >= 0) {
+        std::string again;
+        REQUIRE(lob.Read(ref, [&](const byte* data, ulint n) {
+            again.append(reinterpret_cast<const char*>(data), n);
+            return true;
+        }) == ret);
+        REQUIRE(again == *value);
+    }
+    close(fd);
+    return ret;
+}
+
+TEST_CASE(test_lob_read_zblob) {
+    /* Half random bytes, half lob_byte(): compresses to a few pages */
+    std::string value;
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < 60000; i++) {
+        seed = seed * 1103515245 + 12345;
+        value += static_cast<char>(i % 2 ? seed >> 16 : lob_byte(i));
+    }
+    const uint32_t chain[] = {5, 2, 9, 3, 4, 10, 11, 12, 13, 14, 15};
+    std::vector<uint32_t> pages(chain, chain + 11);
+    std::vector<byte> file;
+    build_zblob(file, value, pages, 300);
+
+    std::string read;
+    REQUIRE(read_zblob(file, 5, 300, value.size(), &read) ==
+            (int64_t)value.size());
+    REQUIRE(read == value);
+
+    /* The stream inflates to less than the reference says */
+    REQUIRE(read_zblob(file, 5, 300, value.size() + 1, &read) == -1);
+
+    /* A page of the chain is of another type, or is corrupt */
+    std::vector<byte> broken = file;
+    mach_write_to_2(&broken[9 * 8192 + FIL_PAGE_TYPE], FIL_PAGE_TYPE_BLOB);
+    REQUIRE(read_zblob(broken, 5, 300, value.size(), &read) == -1);
+    broken = file;
+    memset(&broken[3 * 8192 + FIL_PAGE_DATA], 0xff, 100);
+    REQUIRE(read_zblob(broken, 5, 300, value.size(), &read) == -1);
+
+    /* The chain comes back to page 2 */
+    broken = file;
+    mach_write_to_4(&broken[4 * 8192 + FIL_PAGE_NEXT], 2);
+    REQUIRE(read_zblob(broken, 5, 300, value.size(), &read) == -1);
+    unlink(kLobPath);
+}
+
+TEST_CASE(test_lob_field_stream) {
+    /* A binary value read in several parts prints like the whole value,
+       with one 0x prefix */
+    const uint32_t chain[] = {3, 4, 5};
+    std::vector<uint32_t> pages(chain, chain + 3);
+    const size_t len = 2 * 1000 + 10;
+    std::vector<byte> file;
+    build_old_blob(file, pages, len, 1000);
+    write_file(file);
+    int fd = open(kLobPath, O_RDONLY);
+    REQUIRE(fd >= 0);
+    std::vector<byte> field(20 + BTR_EXTERN_FIELD_REF_SIZE);
+    for (size_t i = 0; i < 20; i++) field[i] = 0xab;
+    write_ref(&field[20], 3, len);
+    mach_write_to_4(&field[20] + BTR_EXTERN_OFFSET, FIL_PAGE_DATA);
+
+    ColumnDef col{};
+    col.type = DD_TYPE_BLOB;
+    col.collation_id = 63;
+    LobReader lob(fd);
+    RecFieldStream stream(col);
+    std::string streamed, whole;
+    size_t n_parts = 0;
+    int64_t ret = lob.ReadField(field.data(), field.size(),
+                                [&](const byte* data, ulint n) {
+        stream.Append(data, n, &streamed);
+        whole.append(reinterpret_cast<const char*>(data), n);
+        n_parts++;
+        return true;
+    });
+    close(fd);
+    unlink(kLobPath);
+    REQUIRE(ret == (int64_t)(20 + len));
+    REQUIRE(n_parts == 4);
+    std::string expected;
+    rec_field_to_string(col, reinterpret_cast<const byte*>(whole.data()),
+                        whole.size(), &expected);
+    REQUIRE(streamed == expected);
+    REQUIRE(streamed.compare(0, 6, "0xABAB") == 0);
+    REQUIRE(streamed.find("0x", 2) == std::string::npos);
+
+    /* JSON is printed in hex too */
+    col.type = DD_TYPE_JSON;
+    col.collation_id = 255;
+    RecFieldStream json(col);
+    std::string out;
+    json.Append(reinterpret_cast<const byte*>("\x01\x02"), 2, &out);
+    json.Append(reinterpret_cast<const byte*>("\x03"), 1, &out);
+    REQUIRE(out == "0x010203");
+
+    /* The spaces of a CHAR value are only dropped at the end of the value */
+    col.type = DD_TYPE_STRING;
+    RecFieldStream text(col);
+    out.clear();
+    text.Append(reinterpret_cast<const byte*>("ab  "), 4, &out);
+    text.Append(reinterpret_cast<const byte*>("   "), 3, &out);
+    text.Append(reinterpret_cast<const byte*>("c "), 2, &out);
+    text.Append(reinterpret_cast<const byte*>("  "), 2, &out);
+    REQUIRE(out == "ab     c");
+}
@@ -0,0 +1,176 @@
+#include "../third_party/catch.hpp"
+#include "include/table_scan.h"
+#include "include/page_decoder.h"
+#include "include/mach_data.h"
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/page0page.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/* Every kernel must agree with the scalar version, including the tail of
+a count that is not a multiple of the vector width. */
+TEST_CASE(test_int_be_decode_kernels) {
+    page_decoder_init();
+    const size_t n = 37;
+    std::vector<byte> in(n * 8);
+    srand(7);
+    for (size_t i = 0; i < in.size(); i++) {
+        in[i] = static_cast<byte>(rand());
+    }
+    const int_be_decode_func_t fast[] = {int_be_decode2, int_be_decode4,
+                                         int_be_decode8};
+    const int_be_decode_func_t slow[] = {int_be_decode2_scalar,
+                                         int_be_decode4_scalar,
+                                         int_be_decode8_scalar};
+    for (int flip = 0; flip < 2; flip++) {
+        for (int k = 0; k < 3; k++) {
+            std::vector<byte> a(n * 8), b(n * 8);
+            fast[k](in.data(), n, flip, a.data());
+            slow[k](in.data(), n, flip, b.data());
+            REQUIRE(a == b);
+        }
+    }
+
+    byte buf[8];
+    mach_write_to_4(buf, 0x80000000 - 7);
+    int32_t v32;
+    int_be_decode(buf, 1, 4, true, &v32);
+    REQUIRE(v32 == -7);
+    mach_write_to_4(buf, 0x80000000);
+    mach_write_to_4(buf + 4, 42);
+    int64_t v64;
+    int_be_decode(buf, 1, 8, true, &v64);
+    REQUIRE(v64 == 42);
+    buf[0] = 0x7f;
+    int8_t v8;
+    int_be_decode(buf, 1, 1, true, &v8);
+    REQUIRE(v8 == -1);
+}
+
+TEST_CASE(test_page_batch_sbtest1) {
+    TableScan scan;
+    REQUIRE(table_scan_open("tool/sbtest1.json", "k >= 15", "id,k", &scan) == 0);
+    int fd = open("tool/sbtest1.ibd", O_RDONLY);
+    REQUIRE(fd >= 0);
+
+    std::vector<int32_t> ids;
+    std::vector<int32_t> ks;
+    uint64_t n_examined = 0;
+    int64_t n_pages = table_scan_pages(fd, scan, [&](const PageBatch& batch) {
+        std::vector<int32_t> v(batch.size());
+        std::vector<uint8_t> valid(batch.size());
+        page_batch_decode_int(batch, scan.out_fields[0], 4, true, v.data(),
+                              valid.data());
+        ids.insert(ids.end(), v.begin(), v.end());
+        page_batch_decode_int(batch, scan.out_fields[1], 4, true, v.data(),
+                              valid.data());
+        ks.insert(ks.end(), v.begin(), v.end());
+        return true;
+    }, &n_examined);
+    close(fd);
+
+    REQUIRE(n_pages == 1);
+    REQUIRE(n_examined == 20);
+    REQUIRE(ids == std::vector<int32_t>({3, 4, 12, 14, 15, 16, 18, 20}));
+    REQUIRE(ks == std::vector<int32_t>({19, 15, 20, 16, 19, 19, 18, 17}));
+}
+
+/* CREATE TABLE t (id INT PRIMARY KEY, v VARCHAR(10), n INT)
+ROW_FORMAT=REDUNDANT */
+static const char* kRedundantSdi =
+    "{\"name\": \"t\", \"row_format\": 4, \"columns\": ["
+    "{\"name\": \"id\", \"type\": 4, \"hidden\": 1},"
+    "{\"name\": \"v\", \"type\": 16, \"hidden\": 1, \"is_nullable\": true,"
+    " \"char_length\": 10, \"collation_id\": 8},"
+    "{\"name\": \"n\", \"type\": 4, \"hidden\": 1, \"is_nullable\": true},"
+    "{\"name\": \"DB_TRX_ID\", \"type\": 10, \"hidden\": 2},"
+    "{\"name\": \"DB_ROLL_PTR\", \"type\": 9, \"hidden\": 2}],"
+    "\"indexes\": [{\"name\": \"PRIMARY\", \"type\": 1, \"elements\": ["
+    "{\"column_opx\": 0, \"length\": 4},"
+    "{\"column_opx\": 3, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 4, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 1, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 2, \"length\": 4294967295, \"hidden\": true}]}]}";
+
+/* Append a REDUNDANT (id, v, n) record to a leaf page, NULL for an empty v
+or a negative n. Every field end offset takes one byte. */
+static byte* put_old_rec(byte* page, byte* prev, byte* rec, uint32_t heap_no,
+                         bool deleted, int32_t id, const std::string& v,
+                         int32_t n) {
+    const ulint n_fields = 5;
+    byte* ends = rec - REC_N_OLD_EXTRA_BYTES;
+    rec[-6] = deleted ? REC_INFO_DELETED_FLAG : 0;
+    mach_write_to_3(rec - 5, (heap_no << 11) | (n_fields << 1) | 1);
+    mach_write_to_2(prev - REC_NEXT, rec - page);
+    mach_write_to_2(rec - REC_NEXT, PAGE_OLD_SUPREMUM);
+
+    ulint end = 0;
+    mach_write_to_4(rec, (uint32_t)id ^ 0x80000000);
+    ends[-1] = end += 4;
+    ends[-2] = end += 6;
+    ends[-3] = end += 7;
+    memcpy(rec + end, v.data(), v.size());
+    end += v.size();
+    ends[-4] = end | (v.empty() ? 0x80 : 0);
+    /* A NULL fixed-length field keeps its space */
+    mach_write_to_4(rec + end, n < 0 ? 0 : (uint32_t)n ^ 0x80000000);
+    end += 4;
+    ends[-5] = end | (n < 0 ? 0x80 : 0);
+    return rec + end + REC_N_OLD_EXTRA_BYTES + n_fields;
+}
+
+TEST_CASE(test_page_batch_redundant) {
+    rapidjson::Document d;
+    d.Parse(kRedundantSdi);
+    TableDef table;
+    REQUIRE(table_def_parse(d, &table) == 0);
+    RecLayout layout;
+    REQUIRE(rec_layout_build(table, table.indexes[0], true, &layout) == 0);
+    REQUIRE(!layout.is_compact);
+
+    std::vector<byte> page(UNIV_PAGE_SIZE);
+    mach_write_to_2(&page[FIL_PAGE_TYPE], FIL_PAGE_INDEX);
+    mach_write_to_2(&page[PAGE_HEADER + PAGE_N_HEAP], 5);
+    byte* infimum = &page[PAGE_OLD_INFIMUM];
+    byte* rec = &page[PAGE_OLD_SUPREMUM_END + REC_N_OLD_EXTRA_BYTES + 5];
+    byte* r1 = rec;
+    rec = put_old_rec(page.data(), infimum, r1, 2, false, 1, "ab", 5);
+    byte* r2 = rec;
+    rec = put_old_rec(page.data(), r1, r2, 3, true, 2, "gone", 6);
+    byte* r3 = rec;
+    put_old_rec(page.data(), r2, r3, 4, false, 3, "", -1);
+    REQUIRE(!page_is_comp(page.data()));
+    REQUIRE(page_first_user_rec(page.data()) == r1);
+
+    /* A plan built for another format takes the one of the page */
+    layout.is_compact = true;
+    rec_layout_set_format(&layout, page.data());
+    REQUIRE(!layout.is_compact);
+
+    RowFilter filter;
+    PageBatch batch;
+    REQUIRE(page_batch_collect(page.data(), 3, layout, layout.fields.size(),
+                               filter, &batch) == 2);
+    REQUIRE(batch.size() == 2);
+    REQUIRE(batch.recs[0] == r1);
+    REQUIRE(batch.recs[1] == r3);
+
+    std::vector<int32_t> ids(2), ns(2);
+    std::vector<uint8_t> valid(2);
+    page_batch_decode_int(batch, 0, 4, true, ids.data(), valid.data());
+    REQUIRE(ids == std::vector<int32_t>({1, 3}));
+    page_batch_decode_int(batch, 4, 4, true, ns.data(), valid.data());
+    REQUIRE(ns[0] == 5);
+    REQUIRE(valid == std::vector<uint8_t>({1, 0}));
+
+    const ulint* offs = batch.rec_offs(0);
+    REQUIRE(rec_offs_field_len(offs, 3) == 2);
+    REQUIRE(memcmp(r1 + rec_offs_field_start(offs, 3), "ab", 2) == 0);
+    REQUIRE(rec_offs_field_is_null(batch.rec_offs(1), 3));
+    REQUIRE(rec_layout_extra_size(r1, layout) == REC_N_OLD_EXTRA_BYTES + 5);
+}
@@ -0,0 +1,232 @@
+#include "../third_party/catch.hpp"
+#include "include/table_def.h"
+#include "include/rec_decoder.h"
+#include "include/index_scan.h"
+#include "include/mach_data.h"
+#include "include/fil0fil.h"
+#include "include/sdi_reader.h"
+#define UNIV_PAGE_SIZE 16384
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <vector>
+
+TEST_CASE(test_rec_field_read_int) {
+    ColumnDef col{};
+    col.type = DD_TYPE_LONG;
+    byte buf[4];
+    mach_write_to_4(buf, 0x80000000 + 42);
+    REQUIRE(rec_field_read_int(col, buf, 4) == 42);
+    mach_write_to_4(buf, 0x80000000 - 7);
+    REQUIRE(rec_field_read_int(col, buf, 4) == -7);
+    col.is_unsigned = true;
+    mach_write_to_4(buf, 0xfffffffe);
+    REQUIRE(rec_field_read_int(col, buf, 4) == 0xfffffffeLL);
+}
+
+TEST_CASE(test_rec_decode_sbtest1) {
+    TableDef table;
+    REQUIRE(table_def_load("tool/sbtest1.json", &table) == 0);
+    const IndexDef* clust = table_def_clust_index(table);
+    REQUIRE(clust != nullptr);
+    REQUIRE(clust->root == 4);
+
+    RecLayout layout;
+    REQUIRE(rec_layout_build(table, *clust, true, &layout) == 0);
+    /* id, DB_TRX_ID, DB_ROLL_PTR, k, c, pad */
+    REQUIRE(layout.fields.size() == 6);
+
+    int fd = open("tool/sbtest1.ibd", O_RDONLY);
+    REQUIRE(fd >= 0);
+    std::vector<byte> page(UNIV_PAGE_SIZE);
+    REQUIRE(page_read(fd, clust->root, page.data()) == 0);
+    close(fd);
+
+    const rec_t* rec = page_first_user_rec_comp(page.data());
+    REQUIRE(rec != nullptr);
+    std::vector<ulint> offs(layout.fields.size());
+    rec_layout_get_offsets(rec, layout, offs.data());
+
+    const ColumnDef& id = table.columns[layout.fields[0].col_no];
+    const ColumnDef& k = table.columns[layout.fields[3].col_no];
+    REQUIRE(rec_field_read_int(id, rec + rec_offs_field_start(offs.data(), 0),
+                               rec_offs_field_len(offs.data(), 0)) == 1);
+    REQUIRE(rec_field_read_int(k, rec + rec_offs_field_start(offs.data(), 3),
+                               rec_offs_field_len(offs.data(), 3)) == 9);
+    /* pad is CHAR(60) in utf8mb4, padded with spaces to 60 bytes */
+    REQUIRE(rec_offs_field_len(offs.data(), 5) == 60);
+}
+
+TEST_CASE(test_sdi_read_tablespace) {
+    int fd = open("tool/sbtest1.ibd", O_RDONLY);
+    REQUIRE(fd >= 0);
+    std::vector<byte> page(UNIV_PAGE_SIZE);
+    REQUIRE(page_read(fd, 0, page.data()) == 0);
+    REQUIRE(sdi_root_page(page.data()) == 3);
+    std::vector<SdiObject> objects;
+    REQUIRE(sdi_read_objects(fd, &objects) == 0);
+    close(fd);
+    /* The table and its tablespace */
+    REQUIRE(objects.size() == 2);
+    REQUIRE(objects[0].type == SDI_TYPE_TABLE);
+    REQUIRE(objects[1].type == SDI_TYPE_TABLESPACE);
+
+    /* The SDI of the tablespace is the ibd2sdi output */
+    TableDef json, ibd;
+    REQUIRE(table_def_load("tool/sbtest1.json", &json) == 0);
+    REQUIRE(table_def_load("tool/sbtest1.ibd", &ibd) == 0);
+    REQUIRE(ibd.name == json.name);
+    REQUIRE(ibd.columns.size() == json.columns.size());
+    for (size_t i = 0; i < ibd.columns.size(); i++) {
+        REQUIRE(ibd.columns[i].name == json.columns[i].name);
+        REQUIRE(ibd.columns[i].type == json.columns[i].type);
+    }
+    REQUIRE(ibd.indexes.size() == json.indexes.size());
+    for (size_t i = 0; i < ibd.indexes.size(); i++) {
+        REQUIRE(ibd.indexes[i].name == json.indexes[i].name);
+        REQUIRE(ibd.indexes[i].id == json.indexes[i].id);
+        REQUIRE(ibd.indexes[i].root == json.indexes[i].root);
+    }
+}
+
+TEST_CASE(test_table_def_schema_roundtrip) {
+    TableDef table;
+    REQUIRE(table_def_load("tool/sbtest1.json", &table) == 0);
+    std::string schema;
+    table_def_serialize(table, &schema);
+
+    TableDef copy;
+    REQUIRE(table_def_deserialize(schema, &copy) == 0);
+    REQUIRE(copy.name == table.name);
+    REQUIRE(table.id == 1122);
+    REQUIRE(copy.id == table.id);
+    REQUIRE(copy.row_format == table.row_format);
+    REQUIRE(copy.columns.size() == table.columns.size());
+    for (size_t i = 0; i < copy.columns.size(); i++) {
+        REQUIRE(copy.columns[i].name == table.columns[i].name);
+        REQUIRE(copy.columns[i].char_length == table.columns[i].char_length);
+        REQUIRE(copy.columns[i].collation_id == table.columns[i].collation_id);
+        REQUIRE(copy.columns[i].is_nullable == table.columns[i].is_nullable);
+    }
+    REQUIRE(copy.indexes.size() == table.indexes.size());
+    for (size_t i = 0; i < copy.indexes.size(); i++) {
+        REQUIRE(copy.indexes[i].id == table.indexes[i].id);
+        REQUIRE(copy.indexes[i].fields.size() == table.indexes[i].fields.size());
+    }
+    std::string again;
+    table_def_serialize(copy, &again);
+    REQUIRE(again == schema);
+
+    /* Truncated or padded input is rejected */
+    REQUIRE(table_def_deserialize(schema.substr(0, schema.size() - 1), &copy) == -1);
+    REQUIRE(table_def_deserialize(schema + '\0', &copy) == -1);
+}
+
+/* CREATE TABLE t (id INT PRIMARY KEY, a INT, b INT);
+ALTER TABLE t ADD COLUMN c INT NOT NULL DEFAULT 7, ALGORITHM=INSTANT;
+ALTER TABLE t DROP COLUMN b, ADD COLUMN d VARCHAR(10) AFTER id,
+ALGORITHM=INSTANT; */
+static const char* kInstantSdi =
+    "{\"name\": \"t\", \"columns\": ["
+    "{\"name\": \"id\", \"type\": 4, \"hidden\": 1,"
+    " \"se_private_data\": \"physical_pos=0;table_id=1;\"},"
+    "{\"name\": \"d\", \"type\": 16, \"hidden\": 1, \"is_nullable\": true,"
+    " \"char_length\": 10, \"collation_id\": 8,"
+    " \"se_private_data\": \"default_null=1;physical_pos=6;version_added=2;\"},"
+    "{\"name\": \"a\", \"type\": 4, \"hidden\": 1, \"is_nullable\": true,"
+    " \"se_private_data\": \"physical_pos=3;table_id=1;\"},"
+    "{\"name\": \"c\", \"type\": 4, \"hidden\": 1,"
+    " \"se_private_data\": \"default=80000007;physical_pos=5;version_added=1;\"},"
+    "{\"name\": \"DB_TRX_ID\", \"type\": 10, \"hidden\": 2,"
+    " \"se_private_data\": \"physical_pos=1;table_id=1;\"},"
+    "{\"name\": \"DB_ROLL_PTR\", \"type\": 9, \"hidden\": 2,"
+    " \"se_private_data\": \"physical_pos=2;table_id=1;\"},"
+    "{\"name\": \"!hidden!_dropped_v2_p4_b\", \"type\": 4, \"hidden\": 2,"
+    " \"is_nullable\": true,"
+    " \"se_private_data\": \"physical_pos=4;version_dropped=2;\"}],"
+    "\"indexes\": [{\"name\": \"PRIMARY\", \"type\": 1, \"elements\": ["
+    "{\"column_opx\": 0, \"length\": 4},"
+    "{\"column_opx\": 4, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 5, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 1, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 2, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 3, \"length\": 4294967295, \"hidden\": true}]}]}";
+
+/* Value of an INT field of a record, or -1 for NULL */
+static int64_t instant_int(const rec_t* rec, const RecLayout& layout,
+                           const ulint* offs, size_t i) {
+    if (rec_offs_field_is_null(offs, i)) {
+        return -1;
+    }
+    ulint len;
+    const byte* data = rec_field_get(rec, layout, offs, i, &len);
+    REQUIRE(len == 4);
+    return rec_field_read_int(layout.table->columns[layout.fields[i].col_no],
+                              data, len);
+}
+
+TEST_CASE(test_rec_decode_instant) {
+    rapidjson::Document d;
+    d.Parse(kInstantSdi);
+    TableDef table;
+    REQUIRE(table_def_parse(d, &table) == 0);
+    REQUIRE(table.max_row_version == 2);
+    RecLayout layout;
+    REQUIRE(rec_layout_build(table, table.indexes[0], true, &layout) == 0);
+    REQUIRE(layout.is_instant);
+    /* Physical order: id, DB_TRX_ID, DB_ROLL_PTR, a, b, c, d */
+    const char* names[] = {"id", "DB_TRX_ID", "DB_ROLL_PTR", "a",
+                           "!hidden!_dropped_v2_p4_b", "c", "d"};
+    REQUIRE(layout.fields.size() == 7);
+    for (size_t i = 0; i < 7; i++) {
+        REQUIRE(table.columns[layout.fields[i].col_no].name == names[i]);
+    }
+
+    byte buf[256] = {0};
+    std::vector<ulint> offs(layout.fields.size());
+
+    /* Written before the ADD of c: (1, a=5, b=NULL) */
+    rec_t* rec = buf + 16;
+    rec[-6] = 0x02;
+    mach_write_to_4(rec, 0x80000001);
+    mach_write_to_4(rec + 17, 0x80000005);
+    rec_layout_get_offsets(rec, layout, offs.data());
+    REQUIRE(instant_int(rec, layout, offs.data(), 3) == 5);
+    REQUIRE(instant_int(rec, layout, offs.data(), 4) == -1);
+    REQUIRE(instant_int(rec, layout, offs.data(), 5) == 7);
+    REQUIRE(rec_offs_field_is_null(offs.data(), 6));
+    REQUIRE(rec_layout_extra_size(rec, layout) == 6);
+
+    /* Row version 1: (2, a=NULL, b=6, c=8) */
+    rec = buf + 80;
+    rec[-5] = REC_INFO_VERSION_FLAG;
+    rec[-6] = 1;
+    rec[-7] = 0x01;
+    mach_write_to_4(rec, 0x80000002);
+    mach_write_to_4(rec + 17, 0x80000006);
+    mach_write_to_4(rec + 21, 0x80000008);
+    rec_layout_get_offsets(rec, layout, offs.data());
+    REQUIRE(instant_int(rec, layout, offs.data(), 3) == -1);
+    REQUIRE(instant_int(rec, layout, offs.data(), 4) == 6);
+    REQUIRE(instant_int(rec, layout, offs.data(), 5) == 8);
+    REQUIRE(rec_offs_field_is_null(offs.data(), 6));
+    REQUIRE(rec_layout_extra_size(rec, layout) == 7);
+
+    /* Row version 2, without b: (3, d='xy', a=9, c=10) */
+    rec = buf + 160;
+    rec[-5] = REC_INFO_VERSION_FLAG;
+    rec[-6] = 2;
+    rec[-7] = 0x00;
+    rec[-8] = 2;
+    mach_write_to_4(rec, 0x80000003);
+    mach_write_to_4(rec + 17, 0x80000009);
+    mach_write_to_4(rec + 21, 0x8000000a);
+    memcpy(rec + 25, "xy", 2);
+    rec_layout_get_offsets(rec, layout, offs.data());
+    REQUIRE(instant_int(rec, layout, offs.data(), 3) == 9);
+    REQUIRE(instant_int(rec, layout, offs.data(), 4) == -1);
+    REQUIRE(instant_int(rec, layout, offs.data(), 5) == 10);
+    REQUIRE(rec_offs_field_len(offs.data(), 6) == 2);
+    REQUIRE(memcmp(rec + rec_offs_field_start(offs.data(), 6), "xy", 2) == 0);
+    REQUIRE(rec_layout_extra_size(rec, layout) == 8);
+}
@@ -0,0 +1,792 @@
+#include "../third_party/catch.hpp"
+#include "include/redo_apply.h"
+#include "include/redo_log.h"
+#include "include/dblwr.h"
+#include "include/fil0fil.h"
+#include "include/fil0types.h"
+#include "include/fsp0fsp.h"
+#include "include/fsp0types.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+#include "include/page0types.h"
+#include "include/page_crc32.h"
+#include "include/rem0types.h"
+#include "include/rec.h"
+#include "include/ut0crc32.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char* kRedoDir = "/tmp/inno_test_redo";
+static const char* kRedoFile0 = "/tmp/inno_test_redo/#ib_redo7";
+static const char* kRedoFile1 = "/tmp/inno_test_redo/#ib_redo8";
+static const char* kLogFile0 = "/tmp/inno_test_ib_logfile0";
+static const char* kLogFile1 = "/tmp/inno_test_ib_logfile1";
+static const char* kApplyRedo = "/tmp/inno_test_apply_#ib_redo3";
+static const char* kApplySpace = "/tmp/inno_test_apply.ibd";
+
+/* Writes mini-transactions into log blocks as InnoDB does: the log of a
+block between its header and trailer, the first mini-transaction starting
+in a block noted in its header */
+class LogWriter {
+public:
+    explicit LogWriter(uint64_t lsn) : lsn_(lsn) {
+        blocks_.resize(OS_FILE_LOG_BLOCK_SIZE);
+        first_lsn_ = lsn / OS_FILE_LOG_BLOCK_SIZE * OS_FILE_LOG_BLOCK_SIZE;
+    }
+
+    /* @return start LSN of the mini-transaction */
+    uint64_t Mtr(const std::vector<byte>& log) {
+        const uint64_t start = lsn_;
+        byte* block = Block();
+        if (mach_read_from_2(block + LOG_BLOCK_FIRST_REC_GROUP) == 0) {
+            mach_write_to_2(block + LOG_BLOCK_FIRST_REC_GROUP, lsn_ % OS_FILE_LOG_BLOCK_SIZE);
+        }
+        for (byte b : log) {
+            Block()[lsn_ % OS_FILE_LOG_BLOCK_SIZE] = b;
+            lsn_++;
+            if (lsn_ % OS_FILE_LOG_BLOCK_SIZE == LOG_BLOCK_CHECKSUM) {
+                lsn_ += LOG_BLOCK_TRL_SIZE + LOG_BLOCK_HDR_SIZE;
+                blocks_.resize(blocks_.size() + OS_FILE_LOG_BLOCK_SIZE);
+            }
+        }
+        return start;
+    }
+
+    uint64_t lsn() const { return lsn_; }
+
+    /* The blocks with their headers and checksums, from first_lsn() */
+    std::vector<byte> Finish() {
+        for (size_t i = 0; i < blocks_.size(); i += OS_FILE_LOG_BLOCK_SIZE) {
+            byte* block = &blocks_[i];
+            const uint64_t lsn = first_lsn_ + i;
+            mach_write_to_4(block + LOG_BLOCK_HDR_NO, log_block_convert_lsn_to_no(lsn));
+            const bool last = i + OS_FILE_LOG_BLOCK_SIZE == blocks_.size();
+            mach_write_to_2(block + LOG_BLOCK_HDR_DATA_LEN,
+                            last ? lsn_ % OS_FILE_LOG_BLOCK_SIZE : OS_FILE_LOG_BLOCK_SIZE);
+            Seal(block);
+        }
+        return blocks_;
+    }
+
+    uint64_t first_lsn() const { return first_lsn_; }
+
+    static void Seal(byte* block) {
+        mach_write_to_4(block + LOG_BLOCK_CHECKSUM, ut_crc32(block, LOG_BLOCK_CHECKSUM));
+    }
+
+private:
+    byte* Block() { return &blocks_[blocks_.size() - OS_FILE_LOG_BLOCK_SIZE]; }
+
+    uint64_t lsn_;
+    uint64_t first_lsn_;
+    std::vector<byte> blocks_;
+};
+
+static void put_compressed(std::vector<byte>* log, uint32_t n) {
+    byte buf[5];
+    const ulint len = mach_write_compressed(buf, n);
+    log->insert(log->end(), buf, buf + len);
+}
+
+static void put_2(std::vector<byte>* log, uint32_t n) {
+    log->push_back(n >> 8);
+    log->push_back(n & 0xFF);
+}
+
+static void put_header(std::vector<byte>* log, byte type, uint32_t space_id, uint32_t page_no) {
+    log->push_back(type);
+    put_compressed(log, space_id);
+    put_compressed(log, page_no);
+}
+
+static void put_write_string(std::vector<byte>* log, uint32_t space_id, uint32_t page_no,
+                             uint32_t offset, uint32_t len, bool single) {
+    put_header(log, MLOG_WRITE_STRING | (single ? MLOG_SINGLE_REC_FLAG : 0), space_id, page_no);
+    put_2(log, offset);
+    put_2(log, len);
+    for (uint32_t i = 0; i < len; i++) {
+        log->push_back(i & 0xFF);
+    }
+}
+
+/* The index of a compact table with an INT key and a nullable VARCHAR, as
+logged by 8.0.28 and later or, without the version and compact flag, by
+8.0.27 */
+static void put_kv_index(std::vector<byte>* log, bool versioned) {
+    if (versioned) {
+        log->push_back(0); /* index log version */
+        log->push_back(1); /* compact */
+    }
+    put_2(log, 2);         /* fields */
+    put_2(log, 1);         /* unique fields */
+    put_2(log, 0x8004);    /* NOT NULL INT */
+    put_2(log, 0x7FFF);    /* VARCHAR */
+}
+
+/* A record inserted on a page of a compact table of 8.0.28 and later */
+static void put_rec_insert(std::vector<byte>* log, uint32_t space_id, uint32_t page_no) {
+    put_header(log, MLOG_REC_INSERT, space_id, page_no);
+    put_kv_index(log, true);
+    put_2(log, 99);        /* offset of the record before */
+    put_compressed(log, (10 << 1) | 1);
+    log->push_back(0);     /* info bits */
+    put_compressed(log, 20);
+    put_compressed(log, 3);
+    for (int i = 0; i < 10; i++) {
+        log->push_back(i);
+    }
+}
+
+static void write_redo_file(const char* path, uint32_t format, uint64_t start_lsn,
+                            uint64_t checkpoint_lsn, uint64_t checkpoint_offset,
+                            const std::vector<byte>& blocks, uint64_t size) {
+    std::vector<byte> file(LOG_FILE_HDR_SIZE);
+    mach_write_to_4(&file[LOG_HEADER_FORMAT], format);
+    mach_write_to_8(&file[LOG_HEADER_START_LSN], start_lsn);
+    strcpy((char*)&file[LOG_HEADER_CREATOR], "MySQL 8.0.36");
+    LogWriter::Seal(&file[0]);
+    if (checkpoint_lsn != 0) {
+        byte* cp = &file[LOG_CHECKPOINT_1];
+        mach_write_to_8(cp + LOG_CHECKPOINT_NO, 3);
+        mach_write_to_8(cp + LOG_CHECKPOINT_LSN, checkpoint_lsn);
+        mach_write_to_8(cp + LOG_CHECKPOINT_OFFSET, checkpoint_offset);
+        LogWriter::Seal(cp);
+    }
+    file.insert(file.end(), blocks.begin(), blocks.end());
+    file.resize(size);
+    FILE* f = fopen(path, "wb");
+    fwrite(file.data(), 1, file.size(), f);
+    fclose(f);
+}
+
+TEST_CASE(test_redo_parse_mtr) {
+    std::vector<byte> log;
+    put_write_string(&log, 5, 3, 100, 4, false);
+    put_rec_insert(&log, 5, 4);
+    log.push_back(MLOG_MULTI_REC_END);
+    std::vector<RedoRecord> recs;
+    size_t len = 0;
+    REQUIRE(redo_parse_mtr(log.data(), log.data() + log.size(), &recs, &len) == 1);
+    REQUIRE(len == log.size());
+    REQUIRE(recs.size() == 2);
+    REQUIRE(recs[0].type == MLOG_WRITE_STRING);
+    REQUIRE(recs[0].page_no == 3);
+    REQUIRE(recs[0].body_len == 2 + 2 + 4);
+    REQUIRE(recs[1].type == MLOG_REC_INSERT);
+    REQUIRE(recs[1].space_id == 5);
+    REQUIRE(recs[1].page_no == 4);
+    REQUIRE(recs[1].len == 3 + 10 + 2 + 1 + 3 + 10);
+    /* Any prefix is incomplete */
+    for (size_t n = 0; n < log.size(); n++) {
+        REQUIRE(redo_parse_mtr(log.data(), log.data() + n, &recs, &len) == 0);
+    }
+    /* A second record flagged single, and a type of unknown length */
+    log[0] |= MLOG_SINGLE_REC_FLAG;
+    REQUIRE(redo_parse_mtr(log.data(), log.data() + log.size(), &recs, &len) == 1);
+    REQUIRE(recs.size() == 1);
+    const size_t first_len = len;
+    REQUIRE(redo_parse_mtr(log.data() + first_len, log.data() + log.size(), &recs, &len) == 1);
+    REQUIRE(recs.size() == 1);
+    log[0] &= ~MLOG_SINGLE_REC_FLAG;
+    log[first_len] |= MLOG_SINGLE_REC_FLAG;
+    REQUIRE(redo_parse_mtr(log.data(), log.data() + log.size(), &recs, &len) == -1);
+    const byte test[] = {MLOG_TEST | MLOG_SINGLE_REC_FLAG, 1, 1, 0};
+    REQUIRE(redo_parse_mtr(test, test + sizeof(test), &recs, &len) == -1);
+    const byte dummy[] = {MLOG_DUMMY_RECORD, MLOG_DUMMY_RECORD};
+    REQUIRE(redo_parse_mtr(dummy, dummy + sizeof(dummy), &recs, &len) == 1);
+    REQUIRE(len == 1);
+    REQUIRE(recs.empty());
+}
+
+TEST_CASE(test_redo_log_files) {
+    ut_crc32_init();
+    mkdir(kRedoDir, 0755);
+    /* Two files of 8.0.30, the log of the second starting where the first
+    one ends */
+    const uint64_t start_lsn = 8192 * 100;
+    const uint64_t file_blocks = 3;
+    LogWriter writer(start_lsn + LOG_BLOCK_HDR_SIZE);
+    std::vector<uint64_t> starts;
+    std::vector<byte> log;
+    put_write_string(&log, 5, 3, 100, 40, true);
+    starts.push_back(writer.Mtr(log));
+    log.clear();
+    put_write_string(&log, 5, 3, 200, 1200, false);
+    put_rec_insert(&log, 5, 4);
+    log.push_back(MLOG_MULTI_REC_END);
+    starts.push_back(writer.Mtr(log));
+    log.clear();
+    put_header(&log, MLOG_UNDO_INSERT | MLOG_SINGLE_REC_FLAG, 2, 10);
+    put_2(&log, 3);
+    log.insert(log.end(), 3, 7);
+    for (int i = 0; i < 30; i++) {
+        starts.push_back(writer.Mtr(log));
+    }
+    const uint64_t end_lsn = writer.lsn();
+    std::vector<byte> blocks = writer.Finish();
+    REQUIRE(blocks.size() > file_blocks * OS_FILE_LOG_BLOCK_SIZE);
+    REQUIRE(blocks.size() < 2 * file_blocks * OS_FILE_LOG_BLOCK_SIZE);
+    const uint64_t file_size = LOG_FILE_HDR_SIZE + file_blocks * OS_FILE_LOG_BLOCK_SIZE;
+    write_redo_file(kRedoFile0, LOG_HEADER_FORMAT_8_0_30, start_lsn, start_lsn + 12, 0,
+                    std::vector<byte>(blocks.begin(), blocks.begin() + file_blocks * OS_FILE_LOG_BLOCK_SIZE),
+                    file_size);
+    write_redo_file(kRedoFile1, LOG_HEADER_FORMAT_8_0_30,
+                    start_lsn + file_blocks * OS_FILE_LOG_BLOCK_SIZE, 0, 0,
+                    std::vector<byte>(blocks.begin() + file_blocks * OS_FILE_LOG_BLOCK_SIZE, blocks.end()),
+                    file_size);
+
+    RedoLog redo;
+    REQUIRE(redo.Open(kRedoDir) == 0);
+    REQUIRE(redo.files().size() == 2);
+    REQUIRE(redo.files()[0].creator == "MySQL 8.0.36");
+    REQUIRE(redo.checkpoint_lsn() == start_lsn + 12);
+
+    std::vector<RedoRecord> recs;
+    RedoScanStats stats;
+    REQUIRE(redo.Scan(0, [&recs](const RedoRecord& rec) {
+        recs.push_back(rec);
+        return true;
+    }, &stats) == 0);
+    REQUIRE(stats.n_mtrs == 32);
+    REQUIRE(stats.n_records == 33);
+    REQUIRE(stats.n_bad_blocks == 0);
+    REQUIRE(stats.n_resyncs == 0);
+    REQUIRE(stats.n_unparsed_bytes == 0);
+    REQUIRE(stats.first_lsn == starts[0]);
+    REQUIRE(stats.end_lsn == end_lsn);
+    REQUIRE(stats.n_by_type[MLOG_UNDO_INSERT] == 30);
+    REQUIRE(recs[0].end_lsn == starts[1]);
+    REQUIRE(recs[1].start_lsn == starts[1]);
+    REQUIRE(recs[2].page_no == 4);
+    REQUIRE(recs[2].end_lsn == starts[2]);
+    REQUIRE(recs[32].space_id == 2);
+
+    std::vector<RedoPageChanges> pages;
+    stats = RedoScanStats();
+    REQUIRE(redo_changed_pages(redo, starts[2], &pages, &stats) == 0);
+    REQUIRE(pages.size() == 1);
+    REQUIRE(pages[0].space_id == 2);
+    REQUIRE(pages[0].n_records == 30);
+    REQUIRE(pages[0].last_lsn == end_lsn);
+    stats = RedoScanStats();
+    REQUIRE(redo_changed_pages(redo, 0, &pages, &stats) == 0);
+    REQUIRE(pages.size() == 3);
+    REQUIRE(pages[1].space_id == 5);
+    REQUIRE(pages[1].page_no == 3);
+    REQUIRE(pages[1].n_records == 2);
+    REQUIRE(pages[1].n_bytes == 3 + 4 + 40 + 3 + 4 + 1200);
+
+    /* A bad block: the log resumes at the first mini-transaction of a
+    later block */
+    blocks[OS_FILE_LOG_BLOCK_SIZE + 100] ^= 1;
+    write_redo_file(kRedoFile0, LOG_HEADER_FORMAT_8_0_30, start_lsn, start_lsn + 12, 0,
+                    std::vector<byte>(blocks.begin(), blocks.begin() + file_blocks * OS_FILE_LOG_BLOCK_SIZE),
+                    file_size);
+    RedoLog damaged;
+    REQUIRE(damaged.Open((std::string(kRedoFile0) + "," + kRedoFile1).c_str()) == 0);
+    stats = RedoScanStats();
+    REQUIRE(redo_changed_pages(damaged, 0, &pages, &stats) == 0);
+    REQUIRE(stats.n_bad_blocks == 1);
+    REQUIRE(stats.n_unparsed_bytes > 0);
+    REQUIRE(stats.n_records < 33);
+    REQUIRE(stats.end_lsn == end_lsn);
+    REQUIRE(pages.back().n_records > 0);
+
+    unlink(kRedoFile0);
+    unlink(kRedoFile1);
+    rmdir(kRedoDir);
+}
+
+TEST_CASE(test_redo_log_group) {
+    ut_crc32_init();
+    /* The ring of two ib_logfileN of 3 blocks each: the log wrapped from
+    the end of the second file to the start of the first one */
+    const uint64_t file_blocks = 3;
+    const uint64_t capacity = 2 * file_blocks * OS_FILE_LOG_BLOCK_SIZE;
+    const uint64_t first_lsn = capacity * 10 + 4 * OS_FILE_LOG_BLOCK_SIZE;
+    LogWriter writer(first_lsn + LOG_BLOCK_HDR_SIZE);
+    std::vector<byte> log;
+    put_write_string(&log, 9, 1, 0, 300, true);
+    for (int i = 0; i < 5; i++) {
+        log[1] = 9;
+        log[2] = i;
+        writer.Mtr(log);
+    }
+    std::vector<byte> blocks = writer.Finish();
+    REQUIRE(blocks.size() == 4 * OS_FILE_LOG_BLOCK_SIZE);
+    /* Ring positions 4 and 5 in the second file, then 0 and 1 */
+    std::vector<byte> file0(file_blocks * OS_FILE_LOG_BLOCK_SIZE);
+    std::vector<byte> file1(file_blocks * OS_FILE_LOG_BLOCK_SIZE);
+    memcpy(&file1[1 * OS_FILE_LOG_BLOCK_SIZE], &blocks[0], 2 * OS_FILE_LOG_BLOCK_SIZE);
+    memcpy(&file0[0], &blocks[2 * OS_FILE_LOG_BLOCK_SIZE], 2 * OS_FILE_LOG_BLOCK_SIZE);
+    /* The checkpoint in the second block of the log */
+    const uint64_t checkpoint_lsn = first_lsn + OS_FILE_LOG_BLOCK_SIZE + 20;
+    const uint64_t file_size = LOG_FILE_HDR_SIZE + file_blocks * OS_FILE_LOG_BLOCK_SIZE;
+    write_redo_file(kLogFile0, 4, 0, checkpoint_lsn,
+                    file_size + LOG_FILE_HDR_SIZE + 2 * OS_FILE_LOG_BLOCK_SIZE + 20,
+                    file0, file_size);
+    write_redo_file(kLogFile1, 4, 0, 0, 0, file1, file_size);
+
+    RedoLog redo;
+    REQUIRE(redo.Open((std::string(kLogFile0) + "," + kLogFile1).c_str()) == 0);
+    REQUIRE(redo.checkpoint_lsn() == checkpoint_lsn);
+    std::vector<uint32_t> pages;
+    RedoScanStats stats;
+    REQUIRE(redo.Scan(0, [&pages](const RedoRecord& rec) {
+        pages.push_back(rec.page_no);
+        return true;
+    }, &stats) == 0);
+    REQUIRE(pages == (std::vector<uint32_t>{0, 1, 2, 3, 4}));
+    REQUIRE(stats.first_lsn == first_lsn + LOG_BLOCK_HDR_SIZE);
+    REQUIRE(stats.end_lsn == writer.lsn());
+    REQUIRE(stats.n_blocks == 4);
+
+    /* Only the mini-transactions from an LSN on */
+    pages.clear();
+    stats = RedoScanStats();
+    REQUIRE(redo.Scan(checkpoint_lsn, [&pages](const RedoRecord& rec) {
+        pages.push_back(rec.page_no);
+        return true;
+    }, &stats) == 0);
+    REQUIRE(pages.size() < 5);
+    REQUIRE(pages.back() == 4);
+    unlink(kLogFile0);
+    unlink(kLogFile1);
+}
+
+static void put_u64_compressed(std::vector<byte>* log, uint64_t n) {
+    byte buf[9];
+    const ulint len = mach_u64_write_compressed(buf, n);
+    log->insert(log->end(), buf, buf + len);
+}
+
+static void put_2bytes(std::vector<byte>* log, uint32_t space_id, uint32_t page_no,
+                       uint32_t offset, uint32_t val, bool single) {
+    put_header(log, MLOG_2BYTES | (single ? MLOG_SINGLE_REC_FLAG : 0), space_id, page_no);
+    put_2(log, offset);
+    put_compressed(log, val);
+}
+
+/* The index of a compact clustered index logged by 8.0.28 and later: an
+INT primary key, the system columns and a nullable VARCHAR(10) */
+static void put_index(std::vector<byte>* log) {
+    log->push_back(0);
+    log->push_back(1);
+    put_2(log, 4);
+    put_2(log, 1);
+    put_2(log, 0x8004);
+    put_2(log, 0x8006);
+    put_2(log, 0x8007);
+    put_2(log, 0);
+}
+
+/* The position of the system columns, a roll pointer, a trx id and the
+offset of the record */
+static void put_sys_vals(std::vector<byte>* log, uint64_t trx_id, uint32_t offset) {
+    put_compressed(log, 1);
+    for (int i = 0; i < 7; i++) {
+        log->push_back(0x10 + i);
+    }
+    put_u64_compressed(log, trx_id);
+    put_2(log, offset);
+}
+
+static int apply(byte* page, uint32_t type, const std::vector<byte>& body) {
+    return redo_apply_record(page, 5, 7, type, body.data(), body.size());
+}
+
+static uint32_t page_field(const std::vector<byte>& page, uint32_t field) {
+    return mach_read_from_2(&page[PAGE_HEADER + field]);
+}
+
+/* The insert of a record of put_kv_index() after the record at cursor,
+logged whole with its info bits and origin */
+static std::vector<byte> kv_insert(uint32_t cursor, uint32_t key, const char* val) {
+    std::vector<byte> body;
+    put_kv_index(&body, true);
+    put_2(&body, cursor);
+    const uint32_t len = strlen(val);
+    put_compressed(&body, ((7 + 4 + len) << 1) | 1);
+    body.push_back(0);
+    put_compressed(&body, 7);
+    put_compressed(&body, 0);
+    body.push_back(len);            /* length of the VARCHAR */
+    body.push_back(0);              /* null flags */
+    body.insert(body.end(), 5, 0);  /* header */
+    put_2(&body, 0x8000);
+    put_2(&body, key);
+    body.insert(body.end(), val, val + len);
+    return body;
+}
+
+/* The keys of the records of a compact page of put_kv_index(), in list
+order, after checking each slot of the directory owns the records up to
+its own */
+static std::vector<uint32_t> page_keys(const std::vector<byte>& page) {
+    std::vector<uint32_t> keys;
+    const uint32_t n_slots = page_field(page, PAGE_N_DIR_SLOTS);
+    uint32_t slot = 0;
+    uint32_t n_owned = 0;
+    for (uint32_t offset = PAGE_NEW_INFIMUM;;) {
+        n_owned++;
+        const uint32_t owned = page[offset - REC_NEW_N_OWNED] & REC_N_OWNED_MASK;
+        if (owned != 0) {
+            REQUIRE(slot < n_slots);
+            REQUIRE(mach_read_from_2(&page[UNIV_PAGE_SIZE - PAGE_DIR -
+                                           (slot + 1) * PAGE_DIR_SLOT_SIZE]) == offset);
+            REQUIRE(owned == n_owned);
+            slot++;
+            n_owned = 0;
+        }
+        if (offset == PAGE_NEW_SUPREMUM) {
+            break;
+        }
+        if (offset != PAGE_NEW_INFIMUM) {
+            keys.push_back(mach_read_from_4(&page[offset]) & 0x7FFFFFFF);
+        }
+        offset = (offset + mach_read_from_2(&page[offset - REC_NEXT])) & (UNIV_PAGE_SIZE - 1);
+    }
+    REQUIRE(slot == n_slots);
+    REQUIRE(keys.size() == page_field(page, PAGE_N_RECS));
+    return keys;
+}
+
+TEST_CASE(test_redo_apply_record) {
+    std::vector<byte> page(UNIV_PAGE_SIZE, 0xEE);
+    std::vector<byte> body;
+    REQUIRE(apply(page.data(), MLOG_INIT_FILE_PAGE2, body) == 0);
+    REQUIRE(mach_read_from_4(&page[FIL_PAGE_OFFSET]) == 7);
+    REQUIRE(mach_read_from_4(&page[FIL_PAGE_SPACE_ID]) == 5);
+    REQUIRE(page[UNIV_PAGE_SIZE - 1] == 0);
+
+    put_2(&body, 1000);
+    put_compressed(&body, 0x12345678);
+    REQUIRE(apply(page.data(), MLOG_4BYTES, body) == 0);
+    REQUIRE(mach_read_from_4(&page[1000]) == 0x12345678);
+    /* Too big for the type, and past the end of the page */
+    REQUIRE(apply(page.data(), MLOG_2BYTES, body) == -1);
+    body.clear();
+    put_2(&body, UNIV_PAGE_SIZE - 1);
+    put_compressed(&body, 1);
+    REQUIRE(apply(page.data(), MLOG_2BYTES, body) == -1);
+    body.clear();
+    put_2(&body, 2000);
+    put_u64_compressed(&body, 0x123456789AULL);
+    REQUIRE(apply(page.data(), MLOG_8BYTES, body) == 0);
+    REQUIRE(mach_read_from_8(&page[2000]) == 0x123456789AULL);
+    body.clear();
+    put_2(&body, 3000);
+    put_2(&body, 3);
+    body.insert(body.end(), {'a', 'b', 'c'});
+    REQUIRE(apply(page.data(), MLOG_WRITE_STRING, body) == 0);
+    REQUIRE(memcmp(&page[3000], "abc", 3) == 0);
+
+    /* An undo page and a record added to it */
+    body.clear();
+    put_compressed(&body, 1);
+    REQUIRE(apply(page.data(), MLOG_UNDO_INIT, body) == 0);
+    REQUIRE(mach_read_from_2(&page[FIL_PAGE_TYPE]) == FIL_PAGE_UNDO_LOG);
+    const uint32_t first_free = TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_HDR_SIZE;
+    REQUIRE(mach_read_from_2(&page[TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE]) == first_free);
+    body.clear();
+    put_2(&body, 3);
+    body.insert(body.end(), {7, 8, 9});
+    REQUIRE(apply(page.data(), MLOG_UNDO_INSERT, body) == 0);
+    REQUIRE(mach_read_from_2(&page[TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE]) == first_free + 7);
+    REQUIRE(mach_read_from_2(&page[first_free]) == first_free + 7);
+    REQUIRE(page[first_free + 2] == 7);
+    REQUIRE(mach_read_from_2(&page[first_free + 5]) == first_free);
+    body.clear();
+    REQUIRE(apply(page.data(), MLOG_UNDO_ERASE_END, body) == 0);
+    REQUIRE(mach_read_from_8(&page[2000]) == 0);
+
+    /* A compact record: id 1, its system columns and "abc", the null flags
+    and the length of the VARCHAR before its header */
+    std::fill(page.begin(), page.end(), 0);
+    mach_write_to_2(&page[PAGE_HEADER + PAGE_N_HEAP], PAGE_IS_COMPACT | 3);
+    const uint32_t offset = 200;
+    byte* rec = &page[offset];
+    rec[-REC_N_NEW_EXTRA_BYTES - 2] = 3;
+    mach_write_to_4(rec, 0x80000001);
+    memcpy(rec + 4 + 6 + 7, "abc", 3);
+
+    body.clear();
+    put_index(&body);
+    body.push_back(0);
+    body.push_back(1);
+    put_sys_vals(&body, 0x55, offset);
+    REQUIRE(apply(page.data(), MLOG_REC_CLUST_DELETE_MARK, body) == 0);
+    REQUIRE(rec_get_info_bits(rec, true) == REC_INFO_DELETED_FLAG);
+    REQUIRE(mach_read_from_6(rec + 4) == 0x55);
+    REQUIRE(rec[4 + 6] == 0x10);
+    REQUIRE(rec[4 + 6 + 6] == 0x16);
+
+    /* The VARCHAR updated in place, the delete mark cleared, the system
+    columns kept */
+    body.clear();
+    put_index(&body);
+    body.push_back(BTR_KEEP_SYS_FLAG);
+    put_sys_vals(&body, 0x66, offset);
+    body.push_back(0);
+    put_compressed(&body, 1);
+    put_compressed(&body, 3);
+    put_compressed(&body, 3);
+    body.insert(body.end(), {'x', 'y', 'z'});
+    REQUIRE(apply(page.data(), MLOG_REC_UPDATE_IN_PLACE, body) == 0);
+    REQUIRE(rec_get_info_bits(rec, true) == 0);
+    REQUIRE(memcmp(rec + 4 + 6 + 7, "xyz", 3) == 0);
+    REQUIRE(mach_read_from_6(rec + 4) == 0x55);
+    /* A longer value is not an update in place */
+    body[body.size() - 5] = 4;
+    body.push_back('!');
+    REQUIRE(apply(page.data(), MLOG_REC_UPDATE_IN_PLACE, body) == 1);
+
+    /* The delete mark of a secondary index record of 8.0.27 */
+    body.clear();
+    put_2(&body, 1);
+    put_2(&body, 1);
+    put_2(&body, 0x8004);
+    body.push_back(1);
+    put_2(&body, offset);
+    REQUIRE(apply(page.data(), MLOG_COMP_REC_SEC_DELETE_MARK, body) == 0);
+    REQUIRE(rec_get_info_bits(rec, true) == REC_INFO_DELETED_FLAG);
+    /* Of 8.0.28 and later, logged with no index on a compact page too */
+    body.erase(body.begin(), body.begin() + 6);
+    body[0] = 0;
+    REQUIRE(apply(page.data(), MLOG_REC_SEC_DELETE_MARK, body) == 0);
+    REQUIRE(rec_get_info_bits(rec, true) == 0);
+    body[0] = 1;
+    REQUIRE(apply(page.data(), MLOG_REC_SEC_DELETE_MARK, body) == 0);
+    REQUIRE(rec_get_info_bits(rec, true) == REC_INFO_DELETED_FLAG);
+
+    /* An index page created, then records inserted in key order */
+    std::fill(page.begin(), page.end(), 0xEE);
+    body.clear();
+    REQUIRE(apply(page.data(), MLOG_COMP_PAGE_CREATE, body) == 0);
+    REQUIRE(mach_read_from_2(&page[FIL_PAGE_TYPE]) == FIL_PAGE_INDEX);
+    REQUIRE(page_field(page, PAGE_N_HEAP) == (PAGE_IS_COMPACT | 2));
+    REQUIRE(page_field(page, PAGE_HEAP_TOP) == PAGE_NEW_SUPREMUM_END);
+    REQUIRE(page_field(page, PAGE_DIRECTION) == PAGE_NO_DIRECTION);
+    REQUIRE(page[UNIV_PAGE_SIZE - PAGE_DIR - 1] == PAGE_NEW_INFIMUM);
+    REQUIRE(page_keys(page).empty());
+
+    REQUIRE(apply(page.data(), MLOG_REC_INSERT, kv_insert(PAGE_NEW_INFIMUM, 1, "abc")) == 0);
+    const uint32_t rec_size = 7 + 4 + 3;
+    std::vector<uint32_t> recs(1, PAGE_NEW_SUPREMUM_END + 7);
+    REQUIRE(page_field(page, PAGE_HEAP_TOP) == PAGE_NEW_SUPREMUM_END + rec_size);
+    REQUIRE(page_field(page, PAGE_N_HEAP) == (PAGE_IS_COMPACT | 3));
+    REQUIRE(page_field(page, PAGE_LAST_INSERT) == recs[0]);
+    REQUIRE(page_field(page, PAGE_DIRECTION) == PAGE_NO_DIRECTION);
+    REQUIRE(mach_read_from_2(&page[recs[0] - REC_NEW_HEAP_NO]) >> REC_HEAP_NO_SHIFT == 2);
+    REQUIRE(memcmp(&page[recs[0] + 4], "abc", 3) == 0);
+
+    /* Of 8.0.27, with the header and origin of the record before it and the
+    end segment only */
+    body.clear();
+    put_kv_index(&body, false);
+    put_2(&body, recs[0]);
+    put_compressed(&body, 7 << 1);
+    body.insert(body.end(), {0x80, 0, 0, 2, 'd', 'e', 'f'});
+    REQUIRE(apply(page.data(), MLOG_COMP_REC_INSERT_8027, body) == 0);
+    recs.push_back(recs[0] + rec_size);
+    REQUIRE(memcmp(&page[recs[1] + 4], "def", 3) == 0);
+    REQUIRE(page_field(page, PAGE_DIRECTION) == PAGE_RIGHT);
+    REQUIRE(page_field(page, PAGE_N_DIRECTION) == 1);
+
+    /* The ninth record of the supremum splits its slot */
+    for (uint32_t key = 3; key <= 10; key++) {
+        REQUIRE(apply(page.data(), MLOG_REC_INSERT, kv_insert(recs.back(), key, "ghi")) == 0);
+        recs.push_back(recs.back() + rec_size);
+    }
+    REQUIRE(page_keys(page) == std::vector<uint32_t>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}));
+    REQUIRE(page_field(page, PAGE_N_DIR_SLOTS) == 3);
+    REQUIRE(mach_read_from_2(&page[UNIV_PAGE_SIZE - PAGE_DIR - 2 * PAGE_DIR_SLOT_SIZE]) == recs[3]);
+    REQUIRE(page_field(page, PAGE_DIRECTION) == PAGE_RIGHT);
+    REQUIRE(page_field(page, PAGE_N_DIRECTION) == 9);
+
+    /* A record deleted goes to the free list, and is reused by the next
+    record that fits */
+    body.clear();
+    put_kv_index(&body, true);
+    put_2(&body, recs[4]);
+    REQUIRE(apply(page.data(), MLOG_REC_DELETE, body) == 0);
+    REQUIRE(page_field(page, PAGE_FREE) == recs[4]);
+    REQUIRE(page_field(page, PAGE_GARBAGE) == rec_size);
+    REQUIRE(page_field(page, PAGE_LAST_INSERT) == 0);
+    REQUIRE(page_keys(page) == std::vector<uint32_t>({1, 2, 3, 4, 6, 7, 8, 9, 10}));
+    REQUIRE(apply(page.data(), MLOG_REC_INSERT, kv_insert(recs[9], 11, "jkl")) == 0);
+    REQUIRE(page_field(page, PAGE_FREE) == 0);
+    REQUIRE(page_field(page, PAGE_GARBAGE) == 0);
+    REQUIRE(page_field(page, PAGE_N_HEAP) == (PAGE_IS_COMPACT | 12));
+    REQUIRE(mach_read_from_2(&page[recs[4] - REC_NEW_HEAP_NO]) >> REC_HEAP_NO_SHIFT == 6);
+    REQUIRE(memcmp(&page[recs[4] + 4], "jkl", 3) == 0);
+    REQUIRE(page_field(page, PAGE_DIRECTION) == PAGE_NO_DIRECTION);
+    REQUIRE(page_keys(page) == std::vector<uint32_t>({1, 2, 3, 4, 6, 7, 8, 9, 10, 11}));
+
+    /* The slot of keys 1 to 4 takes a record of the supremum slot on each
+    delete until that one has too few, then the two merge */
+    for (uint32_t i : {1, 2, 3, 5}) {
+        body.clear();
+        put_kv_index(&body, false);
+        put_2(&body, recs[i]);
+        REQUIRE(apply(page.data(), MLOG_COMP_REC_DELETE_8027, body) == 0);
+        REQUIRE(page_field(page, PAGE_N_DIR_SLOTS) == (i == 5 ? 2 : 3));
+        page_keys(page);
+    }
+    REQUIRE(page_keys(page) == std::vector<uint32_t>({1, 7, 8, 9, 10, 11}));
+    REQUIRE(page_field(page, PAGE_FREE) == recs[5]);
+    REQUIRE(page_field(page, PAGE_GARBAGE) == 4 * rec_size);
+    /* Neither the infimum nor the supremum can be deleted */
+    body.clear();
+    put_kv_index(&body, true);
+    put_2(&body, PAGE_NEW_SUPREMUM);
+    REQUIRE(apply(page.data(), MLOG_REC_DELETE, body) == -1);
+
+    /* A redundant page: no index logged, the field end offsets in the
+    header */
+    body.clear();
+    REQUIRE(apply(page.data(), MLOG_PAGE_CREATE, body) == 0);
+    REQUIRE(page_field(page, PAGE_N_HEAP) == 2);
+    put_2(&body, PAGE_OLD_INFIMUM);
+    put_compressed(&body, (15 << 1) | 1);
+    body.push_back(0);
+    put_compressed(&body, 8);
+    put_compressed(&body, 0);
+    body.insert(body.end(), {7, 4, 0, 0, 0, (2 << 1) | 1, 0, 0, 0x80, 0, 0, 1, 'x', 'y', 'z'});
+    REQUIRE(apply(page.data(), MLOG_REC_INSERT_8027, body) == 0);
+    const uint32_t old_rec = PAGE_OLD_SUPREMUM_END + 8;
+    REQUIRE(mach_read_from_2(&page[PAGE_OLD_INFIMUM - REC_NEXT]) == old_rec);
+    REQUIRE(mach_read_from_2(&page[old_rec - REC_NEXT]) == PAGE_OLD_SUPREMUM);
+    REQUIRE((page[PAGE_OLD_SUPREMUM - REC_OLD_N_OWNED] & REC_N_OWNED_MASK) == 2);
+    REQUIRE(page_field(page, PAGE_N_RECS) == 1);
+    body.clear();
+    put_2(&body, old_rec);
+    REQUIRE(apply(page.data(), MLOG_REC_DELETE_8027, body) == 0);
+    REQUIRE(mach_read_from_2(&page[PAGE_OLD_INFIMUM - REC_NEXT]) == PAGE_OLD_SUPREMUM);
+    REQUIRE(page_field(page, PAGE_FREE) == old_rec);
+    REQUIRE(page_field(page, PAGE_GARBAGE) == 15);
+    REQUIRE(page_field(page, PAGE_N_RECS) == 0);
+    /* A record of a compact table does not fit the page */
+    std::vector<byte> log;
+    put_rec_insert(&log, 5, 7);
+    REQUIRE(apply(page.data(), MLOG_REC_INSERT,
+                  std::vector<byte>(log.begin() + 3, log.end())) == -1);
+}
+
+/* A page of space 5 with its LSN and a valid crc32 checksum */
+static void build_apply_page(byte* page, uint32_t page_no, uint64_t lsn) {
+    memset(page, 0, UNIV_PAGE_SIZE);
+    mach_write_to_4(page + FIL_PAGE_OFFSET, page_no);
+    mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_INDEX);
+    mach_write_to_8(page + FIL_PAGE_LSN, lsn);
+    mach_write_to_4(page + FIL_PAGE_SPACE_ID, 5);
+    mach_write_to_4(page + FSP_HEADER_OFFSET + FSP_SPACE_ID, 5);
+    mach_write_to_4(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM + 4,
+                    lsn & 0xFFFFFFFF);
+    const uint32_t checksum = buf_calc_page_crc32(page, false);
+    mach_write_to_4(page + FIL_PAGE_SPACE_OR_CHKSUM, checksum);
+    mach_write_to_4(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM, checksum);
+}
+
+TEST_CASE(test_redo_apply_pages) {
+    ut_crc32_init();
+    const uint64_t start_lsn = 8192 * 100;
+    LogWriter writer(start_lsn + LOG_BLOCK_HDR_SIZE);
+    std::vector<uint64_t> starts;
+    std::vector<byte> log;
+    put_2bytes(&log, 5, 1, 100, 0xABCD, true);
+    starts.push_back(writer.Mtr(log));
+    log.clear();
+    put_write_string(&log, 5, 2, 200, 16, false);
+    put_2bytes(&log, 5, 1, 102, 0x1234, false);
+    log.push_back(MLOG_MULTI_REC_END);
+    starts.push_back(writer.Mtr(log));
+    log.clear();
+    log.push_back(MLOG_REC_INSERT | MLOG_SINGLE_REC_FLAG);
+    put_rec_insert(&log, 5, 2);
+    log.erase(log.begin() + 1);
+    starts.push_back(writer.Mtr(log));
+    log.clear();
+    put_2bytes(&log, 5, 2, 300, 1, true);
+    starts.push_back(writer.Mtr(log));
+    log.clear();
+    put_2bytes(&log, 6, 1, 100, 2, true);
+    starts.push_back(writer.Mtr(log));
+    const uint64_t end_lsn = writer.lsn();
+    std::vector<byte> blocks = writer.Finish();
+    write_redo_file(kApplyRedo, LOG_HEADER_FORMAT_8_0_30, start_lsn, start_lsn + 12, 0,
+                    blocks, LOG_FILE_HDR_SIZE + blocks.size());
+
+    /* Pages 1 and 2 as of the start of the log, page 3 older than the log
+    and page 0 as of its end */
+    std::vector<byte> space(4 * UNIV_PAGE_SIZE);
+    build_apply_page(&space[0], 0, end_lsn);
+    build_apply_page(&space[UNIV_PAGE_SIZE], 1, starts[0]);
+    build_apply_page(&space[2 * UNIV_PAGE_SIZE], 2, starts[0]);
+    build_apply_page(&space[3 * UNIV_PAGE_SIZE], 3, start_lsn - 1000);
+    FILE* f = fopen(kApplySpace, "wb");
+    fwrite(space.data(), 1, space.size(), f);
+    fclose(f);
+
+    RedoLog redo;
+    REQUIRE(redo.Open(kApplyRedo) == 0);
+    int fd = open(kApplySpace, O_RDWR);
+    REQUIRE(fd >= 0);
+    std::vector<RedoPageApply> pages;
+    RedoApplyStats stats;
+    REQUIRE(redo_apply_pages(fd, 5, {3, 2, 1, 0, 1}, redo, UINT64_MAX, true,
+                             &pages, &stats) == 0);
+    REQUIRE(pages.size() == 4);
+    REQUIRE(pages[0].state == REDO_PAGE_CURRENT);
+    REQUIRE(pages[1].state == REDO_PAGE_APPLIED);
+    REQUIRE(pages[1].n_applied == 2);
+    REQUIRE(pages[1].new_lsn == starts[2]);
+    REQUIRE(pages[2].state == REDO_PAGE_STOPPED);
+    REQUIRE(pages[2].n_applied == 1);
+    REQUIRE(pages[2].new_lsn == starts[2]);
+    REQUIRE(pages[2].stop_type == MLOG_REC_INSERT);
+    REQUIRE(pages[2].stop_lsn == starts[2]);
+    REQUIRE(pages[2].n_left == 2);
+    REQUIRE(pages[3].state == REDO_PAGE_LOG_MISSING);
+    REQUIRE(stats.n_records == 5);
+    REQUIRE(stats.n_changed == 2);
+    REQUIRE(stats.n_writes == 0);
+
+    /* Up to the end of the first mini-transaction only */
+    stats = RedoApplyStats();
+    REQUIRE(redo_apply_pages(fd, 5, {1, 2}, redo, starts[1], true, &pages, &stats) == 0);
+    REQUIRE(pages[0].new_lsn == starts[1]);
+    REQUIRE(pages[0].n_applied == 1);
+    REQUIRE(pages[1].state == REDO_PAGE_CURRENT);
+
+    stats = RedoApplyStats();
+    REQUIRE(redo_apply_pages(fd, 5, {1, 2}, redo, UINT64_MAX, false, &pages, &stats) == 0);
+    REQUIRE(stats.n_writes == 2);
+    std::vector<byte> page(UNIV_PAGE_SIZE);
+    REQUIRE(pread(fd, page.data(), UNIV_PAGE_SIZE, UNIV_PAGE_SIZE) == (ssize_t)UNIV_PAGE_SIZE);
+    REQUIRE(!page_is_corrupted(page.data()));
+    REQUIRE(mach_read_from_8(&page[FIL_PAGE_LSN]) == starts[2]);
+    REQUIRE(mach_read_from_2(&page[100]) == 0xABCD);
+    REQUIRE(mach_read_from_2(&page[102]) == 0x1234);
+    REQUIRE(pread(fd, page.data(), UNIV_PAGE_SIZE, 2 * UNIV_PAGE_SIZE) == (ssize_t)UNIV_PAGE_SIZE);
+    REQUIRE(!page_is_corrupted(page.data()));
+    REQUIRE(page[200 + 15] == 15);
+    REQUIRE(mach_read_from_2(&page[300]) == 0);
+
+    /* Applied again, page 1 is current and page 2 stops again */
+    stats = RedoApplyStats();
+    REQUIRE(redo_apply_pages(fd, 5, {1, 2}, redo, UINT64_MAX, false, &pages, &stats) == 0);
+    REQUIRE(pages[0].state == REDO_PAGE_CURRENT);
+    REQUIRE(pages[1].state == REDO_PAGE_STOPPED);
+    REQUIRE(pages[1].n_applied == 0);
+    REQUIRE(stats.n_writes == 0);
+    REQUIRE(redo_apply_pages(fd, 5, {4}, redo, UINT64_MAX, true, &pages, &stats) == -1);
+    close(fd);
+    unlink(kApplySpace);
+    unlink(kApplyRedo);
+}
@@ -0,0 +1,214 @@
+#include "../third_party/catch.hpp"
+#include "include/table_scan.h"
+#include "include/fil0fil.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+/* Ids of the rows of tool/sbtest1.ibd matching a --where clause */
+static std::vector<int64_t> matching_ids(const char* where) {
+    std::vector<int64_t> ids;
+    TableScan scan;
+    if (table_scan_open("tool/sbtest1.json", where, nullptr, &scan) != 0) {
+        ids.push_back(-1);
+        return ids;
+    }
+    int fd = open("tool/sbtest1.ibd", O_RDONLY);
+    const ColumnDef& id = scan.table.columns[scan.leaf_layout.fields[0].col_no];
+    table_scan_rows(fd, scan, [&](const rec_t* rec, const ulint* offs) {
+        ids.push_back(rec_field_read_int(id, rec + rec_offs_field_start(offs, 0),
+                                         rec_offs_field_len(offs, 0)));
+        return true;
+    }, nullptr);
+    close(fd);
+    return ids;
+}
+
+TEST_CASE(test_row_filter_compare) {
+    REQUIRE(matching_ids("").size() == 20);
+    REQUIRE(matching_ids("id = 7") == std::vector<int64_t>({7}));
+    REQUIRE(matching_ids("id > 18") == std::vector<int64_t>({19, 20}));
+    REQUIRE(matching_ids("id <= 2 or").front() == -1);
+    /* k of rows 1..20 is 9 14 19 15 10 12 13 10 3 11 10 20 2 16 19 19 2 18 5 17 */
+    REQUIRE(matching_ids("k BETWEEN 2 AND 3") == std::vector<int64_t>({9, 13, 17}));
+    REQUIRE(matching_ids("k in (19, 20) and id != 3") ==
+            std::vector<int64_t>({12, 15, 16}));
+    REQUIRE(matching_ids("k >= -5 AND id < 3") == std::vector<int64_t>({1, 2}));
+    REQUIRE(matching_ids("k IS NULL").empty());
+}
+
+TEST_CASE(test_row_filter_string) {
+    REQUIRE(matching_ids("pad = '67847967377-48000963322-62604785301-91415491898-96926520291'") ==
+            std::vector<int64_t>({1}));
+    /* CHAR comparisons ignore the trailing space padding */
+    REQUIRE(matching_ids("pad IN ('67847967377-48000963322-62604785301-91415491898-96926520291   ', 'x')") ==
+            std::vector<int64_t>({1}));
+    REQUIRE(matching_ids("c >= '8' AND c < '9'") == std::vector<int64_t>({1, 10}));
+    REQUIRE(matching_ids("nosuch = 1").front() == -1);
+    REQUIRE(matching_ids("k = 'abc'").front() == -1);
+}
+
+TEST_CASE(test_row_filter_system_column) {
+    /* DB_TRX_ID is a 6-byte unsigned integer: every row of the file was
+       inserted by transaction 64261248 */
+    REQUIRE(matching_ids("DB_TRX_ID > 0").size() == 20);
+    REQUIRE(matching_ids("DB_TRX_ID = 64261248").size() == 20);
+    REQUIRE(matching_ids("DB_TRX_ID < 64261248").empty());
+    REQUIRE(matching_ids("DB_TRX_ID = 64261248 AND id = 5") ==
+            std::vector<int64_t>({5}));
+    REQUIRE(matching_ids("DB_TRX_ID = -1").front() == -1);
+}
+
+TEST_CASE(test_table_scan_columns) {
+    TableScan scan;
+    /* id, DB_TRX_ID, DB_ROLL_PTR, k, c, pad */
+    REQUIRE(table_scan_open("tool/sbtest1.json", nullptr, "k,id", &scan) == 0);
+    REQUIRE(scan.out_fields == std::vector<size_t>({3, 0}));
+    REQUIRE(scan.n_decode == 4);
+
+    TableScan filtered;
+    REQUIRE(table_scan_open("tool/sbtest1.json", "pad = 'x'", "DB_TRX_ID",
+                            &filtered) == 0);
+    REQUIRE(filtered.out_fields == std::vector<size_t>({1}));
+    REQUIRE(filtered.n_decode == 6);
+
+    TableScan all;
+    REQUIRE(table_scan_open("tool/sbtest1.json", nullptr, nullptr, &all) == 0);
+    REQUIRE(all.out_fields == std::vector<size_t>({0, 3, 4, 5}));
+
+    TableScan bad;
+    REQUIRE(table_scan_open("tool/sbtest1.json", nullptr, "id,nosuch", &bad) != 0);
+}
+
+TEST_CASE(test_table_scan_secondary) {
+    TableScan scan;
+    /* k_1 records are (k, id) */
+    REQUIRE(table_scan_open_index("tool/sbtest1.json", "k_1", "k <= 10", nullptr,
+                                  &scan) == 0);
+    REQUIRE(scan.root == 5);
+    REQUIRE(!scan.leaf_layout.is_clustered);
+    REQUIRE(scan.leaf_layout.fields.size() == 2);
+    REQUIRE(scan.leaf_layout.n_uniq == 2);
+    REQUIRE(scan.node_layout.fields.size() == 3);
+    REQUIRE(scan.out_fields == std::vector<size_t>({1, 0}));
+
+    std::vector<int64_t> ids;
+    uint64_t n_examined = 0;
+    int fd = open("tool/sbtest1.ibd", O_RDONLY);
+    const ColumnDef& id = scan.table.columns[scan.leaf_layout.fields[1].col_no];
+    int64_t n_pages = table_scan_rows(fd, scan, [&](const rec_t* rec, const ulint* offs) {
+        ids.push_back(rec_field_read_int(id, rec + rec_offs_field_start(offs, 1),
+                                         rec_offs_field_len(offs, 1)));
+        return true;
+    }, &n_examined);
+    close(fd);
+    /* In (k, id) order */
+    REQUIRE(ids == std::vector<int64_t>({13, 17, 9, 19, 1, 5, 8, 11}));
+    REQUIRE(n_pages == 1);
+    REQUIRE(n_examined == 20);
+
+    TableScan bad;
+    REQUIRE(table_scan_open_index("tool/sbtest1.json", "k_1", nullptr, "k,c",
+                                  &bad) != 0);
+    REQUIRE(table_scan_open_index("tool/sbtest1.json", "k_1", "pad = 'x'",
+                                  nullptr, &bad) != 0);
+    REQUIRE(table_scan_open_index("tool/sbtest1.json", "nosuch", nullptr,
+                                  nullptr, &bad) != 0);
+}
+
+static const char* kTypesSdiPath = "/tmp/inno_test_row_filter.json";
+
+/* CREATE TABLE t (id INT PRIMARY KEY, d DATE, t2 TIME(2), t6 TIME(6),
+   b BINARY(4), n DECIMAL(5,2)) */
+static const char* kTypesSdi =
+    "[\"ibd2sdi\", {\"type\": 1, \"id\": 1, \"object\": {"
+    "\"dd_object_type\": \"Table\", \"dd_object\": {\"name\": \"t\","
+    "\"columns\": ["
+    "{\"name\": \"id\", \"type\": 4, \"hidden\": 1, \"column_type_utf8\": \"int\"},"
+    "{\"name\": \"d\", \"type\": 15, \"hidden\": 1, \"column_type_utf8\": \"date\"},"
+    "{\"name\": \"t2\", \"type\": 20, \"hidden\": 1, \"datetime_precision\": 2,"
+    "\"column_type_utf8\": \"time(2)\"},"
+    "{\"name\": \"t6\", \"type\": 20, \"hidden\": 1, \"datetime_precision\": 6,"
+    "\"column_type_utf8\": \"time(6)\"},"
+    "{\"name\": \"b\", \"type\": 29, \"hidden\": 1, \"char_length\": 4,"
+    "\"collation_id\": 63, \"column_type_utf8\": \"binary(4)\"},"
+    "{\"name\": \"n\", \"type\": 21, \"hidden\": 1, \"numeric_precision\": 5,"
+    "\"numeric_scale\": 2, \"column_type_utf8\": \"decimal(5,2)\"},"
+    "{\"name\": \"DB_TRX_ID\", \"type\": 10, \"hidden\": 2},"
+    "{\"name\": \"DB_ROLL_PTR\", \"type\": 9, \"hidden\": 2}],"
+    "\"indexes\": [{\"name\": \"PRIMARY\", \"type\": 1,"
+    "\"se_private_data\": \"id=100;root=3;\", \"elements\": ["
+    "{\"column_opx\": 0, \"length\": 4},"
+    "{\"column_opx\": 6, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 7, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 1, \"length\": 3},"
+    "{\"column_opx\": 2, \"length\": 4},"
+    "{\"column_opx\": 3, \"length\": 6},"
+    "{\"column_opx\": 4, \"length\": 4},"
+    "{\"column_opx\": 5, \"length\": 3}]}]}}}]";
+
+/* Compile a --where clause against the table of kTypesSdi */
+static int compile_types(const char* where) {
+    FILE* f = fopen(kTypesSdiPath, "w");
+    fputs(kTypesSdi, f);
+    fclose(f);
+    TableScan scan;
+    return table_scan_open(kTypesSdiPath, where, nullptr, &scan);
+}
+
+/* Stored form of a value of a column of kTypesSdi, "-" if it does not fit */
+static std::string encode_types(const char* name, const char* value,
+                                bool* pad_space = nullptr) {
+    FILE* f = fopen(kTypesSdiPath, "w");
+    fputs(kTypesSdi, f);
+    fclose(f);
+    TableScan scan;
+    REQUIRE(table_scan_open(kTypesSdiPath, nullptr, nullptr, &scan) == 0);
+    const RecLayout& layout = scan.leaf_layout;
+    for (size_t i = 0; i < layout.fields.size(); i++) {
+        if (layout.table->columns[layout.fields[i].col_no].name != name) {
+            continue;
+        }
+        std::string key;
+        bool pad;
+        if (rec_field_encode(layout, i, value, &key, &pad) != 0) {
+            return "-";
+        }
+        if (pad_space) *pad_space = pad;
+        return key;
+    }
+    return "-";
+}
+
+TEST_CASE(test_row_filter_datetime_literal) {
+    REQUIRE(encode_types("d", "2024-01-01") != "-");
+    REQUIRE(encode_types("d", "2024-01-01 10:00:00") != "-");
+    REQUIRE(encode_types("d", "2024-01-01 10:00:00.5") != "-");
+    /* nothing may follow the date or the time */
+    REQUIRE(encode_types("d", "2024-01-01xyz") == "-");
+    REQUIRE(encode_types("d", "2024-01-01 10") == "-");
+    REQUIRE(encode_types("d", "2024-01-01 10:00:00x") == "-");
+    REQUIRE(encode_types("d", "2024-01-01 10:00:00.5x") == "-");
+}
+
+TEST_CASE(test_row_filter_time) {
+    /* 1:02:03 is (1 << 12 | 2 << 6 | 3) + 0x800000 */
+    REQUIRE(encode_types("t2", "01:02:03.5") == std::string("\x80\x10\x83\x32", 4));
+    REQUIRE(encode_types("t2", "-01:02:03") == std::string("\x7F\xEF\x7D\x00", 4));
+    /* -0.5 is stored as -1 and .50 */
+    REQUIRE(encode_types("t2", "-00:00:00.5") == std::string("\x7F\xFF\xFF\x32", 4));
+    REQUIRE(encode_types("t6", "00:00:01.000001") ==
+            std::string("\x80\x00\x01\x00\x00\x01", 6));
+    REQUIRE(encode_types("t2", "839:00:00") == "-");
+    REQUIRE(encode_types("t2", "01:02:03 ") == "-");
+    REQUIRE(compile_types("t2 BETWEEN '00:00:00' AND '12:00:00'") == 0);
+}
+
+TEST_CASE(test_row_filter_binary_and_decimal) {
+    /* BINARY values are padded with 0x00, trailing spaces are data */
+    bool pad_space = true;
+    REQUIRE(encode_types("b", "ab ", &pad_space) == "ab ");
+    REQUIRE(!pad_space);
+    REQUIRE(compile_types("n = 1.5") == -1);
+    REQUIRE(compile_types("n IS NOT NULL") == 0);
+}
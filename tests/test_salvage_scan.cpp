@@ -0,0 +1,197 @@
+#include "../third_party/catch.hpp"
+#include "include/salvage_scan.h"
+#include "include/fil0fil.h"
+#include "include/mach_data.h"
+#include "include/fsp0types.h"
+#include "include/page0page.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+static const char* kSdiPath = "/tmp/inno_test_salvage.json";
+static const char* kIbdPath = "/tmp/inno_test_salvage.ibd";
+
+/* CREATE TABLE t (id INT PRIMARY KEY, v INT NOT NULL) */
+static const char* kSdi =
+    "[\"ibd2sdi\", {\"type\": 1, \"id\": 1, \"object\": {"
+    "\"dd_object_type\": \"Table\", \"dd_object\": {\"name\": \"t\","
+    "\"columns\": ["
+    "{\"name\": \"id\", \"type\": 4, \"hidden\": 1, \"column_type_utf8\": \"int\"},"
+    "{\"name\": \"v\", \"type\": 4, \"hidden\": 1, \"column_type_utf8\": \"int\"},"
+    "{\"name\": \"DB_TRX_ID\", \"type\": 10, \"hidden\": 2},"
+    "{\"name\": \"DB_ROLL_PTR\", \"type\": 9, \"hidden\": 2}],"
+    "\"indexes\": [{\"name\": \"PRIMARY\", \"type\": 1,"
+    "\"se_private_data\": \"id=100;root=3;\", \"elements\": ["
+    "{\"column_opx\": 0, \"length\": 4},"
+    "{\"column_opx\": 2, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 3, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 1, \"length\": 4}]}]}}}]";
+
+typedef std::pair<int32_t, int32_t> row;
+
+/* Build a compact leaf page of (id, v) rows, a negative id is stored
+delete-marked. The purged rows follow the live ones in the heap, the
+free ones on the PAGE_FREE list and the garbage ones on no list. The page
+directory is left empty, salvage does not use it. */
+static void build_leaf(byte* page, uint32_t page_no, uint64_t index_id,
+                       uint64_t lsn, const std::vector<row>& rows,
+                       const std::vector<row>& free_rows = std::vector<row>(),
+                       const std::vector<row>& garbage_rows = std::vector<row>()) {
+    memset(page, 0, UNIV_PAGE_SIZE);
+    mach_write_to_4(page + FIL_PAGE_OFFSET, page_no);
+    mach_write_to_4(page + FIL_PAGE_LSN, lsn >> 32);
+    mach_write_to_4(page + FIL_PAGE_LSN + 4, lsn & 0xFFFFFFFF);
+    mach_write_to_4(page + UNIV_PAGE_SIZE - FIL_PAGE_END_LSN_OLD_CHKSUM + 4,
+                    lsn & 0xFFFFFFFF);
+    mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_INDEX);
+    mach_write_to_4(page + PAGE_HEADER + PAGE_INDEX_ID, index_id >> 32);
+    mach_write_to_4(page + PAGE_HEADER + PAGE_INDEX_ID + 4, index_id & 0xFFFFFFFF);
+    const size_t n_heap = rows.size() + free_rows.size() + garbage_rows.size() + 2;
+    mach_write_to_2(page + PAGE_HEADER + PAGE_N_HEAP, 0x8000 | n_heap);
+
+    byte* infimum = page + PAGE_NEW_INFIMUM;
+    byte* supremum = page + PAGE_NEW_SUPREMUM;
+    mach_write_to_2(infimum - 4, REC_STATUS_INFIMUM);
+    mach_write_to_2(supremum - 4, (1 << 3) | REC_STATUS_SUPREMUM);
+
+    const std::vector<row>* lists[3] = {&rows, &free_rows, &garbage_rows};
+    byte* rec = page + PAGE_NEW_SUPREMUM_END + REC_N_NEW_EXTRA_BYTES;
+    size_t heap_no = 2;
+    for (int l = 0; l < 3; l++) {
+        byte* prev = l == 0 ? infimum : nullptr;
+        for (size_t i = 0; i < lists[l]->size(); i++) {
+            const row& r = (*lists[l])[i];
+            const bool deleted = r.first < 0 || l > 0;
+            const int32_t id = r.first < 0 ? -r.first : r.first;
+            rec[-5] = deleted ? REC_INFO_DELETED_FLAG : 0;
+            mach_write_to_2(rec - 4, (heap_no++ << 3) | REC_STATUS_ORDINARY);
+            mach_write_to_4(rec, (uint32_t)id ^ 0x80000000);
+            mach_write_to_4(rec + 4, 0x100);
+            mach_write_to_4(rec + 4 + 6 + 7, (uint32_t)r.second ^ 0x80000000);
+            if (prev != nullptr) {
+                mach_write_to_2(prev - REC_NEXT, (rec - prev) & 0xFFFF);
+            } else if (l == 1) {
+                mach_write_to_2(page + PAGE_HEADER + PAGE_FREE, rec - page);
+            }
+            prev = l < 2 ? rec : nullptr;
+            rec += 4 + 6 + 7 + 4 + REC_N_NEW_EXTRA_BYTES;
+        }
+        if (l == 0) {
+            mach_write_to_2(prev - REC_NEXT, (supremum - prev) & 0xFFFF);
+        }
+    }
+    mach_write_to_2(page + PAGE_HEADER + PAGE_HEAP_TOP,
+                    rec - REC_N_NEW_EXTRA_BYTES - page);
+}
+
+/* Rows of the salvage of the test file as (id, v) */
+static std::vector<std::pair<int32_t, int32_t> > salvage(uint32_t n_threads,
+                                                         bool deleted,
+                                                         SalvageStats* stats) {
+    std::vector<std::pair<int32_t, int32_t> > rows;
+    TableScan scan;
+    REQUIRE(table_scan_open(kSdiPath, nullptr, "id,v", &scan) == 0);
+    int fd = open(kIbdPath, O_RDONLY);
+    int64_t n = salvage_scan(fd, scan, n_threads, deleted, [&](const PageBatch& batch) {
+        for (size_t i = 0; i < batch.size(); i++) {
+            const ulint* offs = batch.rec_offs(i);
+            int32_t id = (int32_t)(mach_read_from_4(batch.recs[i] +
+                rec_offs_field_start(offs, scan.out_fields[0])) ^ 0x80000000);
+            int32_t v = (int32_t)(mach_read_from_4(batch.recs[i] +
+                rec_offs_field_start(offs, scan.out_fields[1])) ^ 0x80000000);
+            rows.push_back(std::make_pair(id, v));
+        }
+        return true;
+    }, stats);
+    close(fd);
+    REQUIRE(n == (int64_t)stats->n_leaf_pages);
+    return rows;
+}
+
+TEST_CASE(test_salvage_scan) {
+    FILE* f = fopen(kSdiPath, "w");
+    fputs(kSdi, f);
+    fclose(f);
+
+    /* Enough pages for several reader threads, the leaves are spread out */
+    const uint32_t n_pages = 512;
+    std::vector<byte> file(n_pages * UNIV_PAGE_SIZE);
+    /* Current leaves */
+    build_leaf(&file[10 * UNIV_PAGE_SIZE], 10, 100, 500,
+               {row(1, 10), row(2, 20), row(3, 30)},
+               {row(11, 110), row(12, 120)}, {row(13, 130)});
+    build_leaf(&file[300 * UNIV_PAGE_SIZE], 300, 100, 700,
+               {row(4, 41), row(-5, 50), row(6, 60)});
+    /* A stale copy from before row 4 was updated and row 5 deleted, read
+    after the newer copy. Row 7 is only found here. */
+    build_leaf(&file[400 * UNIV_PAGE_SIZE], 400, 100, 600,
+               {row(4, 40), row(5, 50), row(7, 70)});
+    /* Another index, and a torn page */
+    build_leaf(&file[200 * UNIV_PAGE_SIZE], 200, 101, 900, {row(8, 80)});
+    build_leaf(&file[250 * UNIV_PAGE_SIZE], 250, 100, 900, {row(9, 90)});
+    file[251 * UNIV_PAGE_SIZE - 1] ^= 1;
+
+    f = fopen(kIbdPath, "wb");
+    fwrite(file.data(), 1, file.size(), f);
+    fclose(f);
+
+    const std::vector<row> expected = {row(1, 10), row(2, 20), row(3, 30),
+                                       row(4, 41), row(6, 60), row(7, 70)};
+    for (uint32_t n_threads = 1; n_threads <= 4; n_threads += 3) {
+        SalvageStats stats;
+        REQUIRE(salvage(n_threads, false, &stats) == expected);
+        REQUIRE(stats.n_pages == n_pages);
+        REQUIRE(stats.n_leaf_pages == 3);
+        REQUIRE(stats.n_torn_pages == 1);
+        REQUIRE(stats.n_records == 9);
+        REQUIRE(stats.n_rows == 7);
+        REQUIRE(stats.n_deleted == 1);
+    }
+
+    /* Row 5 is deleted on the newest page, 11 and 12 were purged to the
+    free list and 13 is left in the garbage space */
+    const std::vector<row> deleted = {row(5, 50), row(11, 110), row(12, 120),
+                                      row(13, 130)};
+    for (uint32_t n_threads = 1; n_threads <= 4; n_threads += 3) {
+        SalvageStats stats;
+        REQUIRE(salvage(n_threads, true, &stats) == deleted);
+        REQUIRE(stats.n_records == 12);
+        REQUIRE(stats.n_free_records == 2);
+        REQUIRE(stats.n_garbage_records == 1);
+        REQUIRE(stats.n_rows == 10);
+        REQUIRE(stats.n_deleted == 4);
+    }
+}
+
+TEST_CASE(test_salvage_scan_split) {
+    FILE* f = fopen(kSdiPath, "w");
+    fputs(kSdi, f);
+    fclose(f);
+
+    const uint32_t n_pages = 64;
+    std::vector<byte> file(n_pages * UNIV_PAGE_SIZE);
+    /* Rows 1 and 2 moved to page 20 by a split of page 30, which purged
+    its copies of them later. Row 5 was deleted after the move, row 4 was
+    purged for good. */
+    build_leaf(&file[20 * UNIV_PAGE_SIZE], 20, 100, 500,
+               {row(1, 10), row(2, 20), row(-5, 50)});
+    build_leaf(&file[30 * UNIV_PAGE_SIZE], 30, 100, 800, {row(3, 30)},
+               {row(1, 11), row(2, 21), row(5, 51)}, {row(4, 40)});
+    f = fopen(kIbdPath, "wb");
+    fwrite(file.data(), 1, file.size(), f);
+    fclose(f);
+
+    SalvageStats stats;
+    REQUIRE(salvage(1, false, &stats) ==
+            std::vector<row>({row(1, 10), row(2, 20), row(3, 30)}));
+    /* The purged copies of the moved rows do not make them deleted */
+    REQUIRE(salvage(1, true, &stats) ==
+            std::vector<row>({row(4, 40), row(5, 50)}));
+    REQUIRE(stats.n_rows == 5);
+    REQUIRE(stats.n_deleted == 2);
+    unlink(kSdiPath);
+    unlink(kIbdPath);
+}
@@ -0,0 +1,216 @@
+#include "../third_party/catch.hpp"
+#include "include/space_usage.h"
+#include "include/fil0fil.h"
+#include "include/lob_reader.h"
+#include "include/mach_data.h"
+#include "include/fsp0types.h"
+#include "include/page0page.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char* kSdiPath = "/tmp/inno_test_usage.json";
+static const char* kIbdPath = "/tmp/inno_test_usage.ibd";
+
+/* CREATE TABLE t (id INT PRIMARY KEY, b BLOB) ROW_FORMAT=DYNAMIC */
+static const char* kSdi =
+    "[\"ibd2sdi\", {\"type\": 1, \"id\": 1, \"object\": {"
+    "\"dd_object_type\": \"Table\", \"dd_object\": {\"name\": \"t\","
+    "\"row_format\": 2, \"columns\": ["
+    "{\"name\": \"id\", \"type\": 4, \"hidden\": 1, \"column_type_utf8\": \"int\"},"
+    "{\"name\": \"b\", \"type\": 27, \"hidden\": 1, \"is_nullable\": true,"
+    "\"char_length\": 65535, \"column_type_utf8\": \"blob\"},"
+    "{\"name\": \"DB_TRX_ID\", \"type\": 10, \"hidden\": 2},"
+    "{\"name\": \"DB_ROLL_PTR\", \"type\": 9, \"hidden\": 2}],"
+    "\"indexes\": [{\"name\": \"PRIMARY\", \"type\": 1,"
+    "\"se_private_data\": \"id=100;root=3;\", \"elements\": ["
+    "{\"column_opx\": 0, \"length\": 4},"
+    "{\"column_opx\": 2, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 3, \"length\": 4294967295, \"hidden\": true},"
+    "{\"column_opx\": 1, \"length\": 4294967295}]}]}}}]";
+
+/* A row of the test table: b is NULL, inline or a reference to the LOB or
+BLOB starting at lob_page */
+struct usage_row {
+    int32_t id;
+    bool null;
+    uint32_t inline_len;
+    uint32_t lob_page;
+    uint32_t lob_len;
+};
+
+static byte* usage_page(std::vector<byte>& file, uint32_t page_no) {
+    return &file[page_no * UNIV_PAGE_SIZE];
+}
+
+/* Build the compact leaf page of the clustered index */
+static void build_usage_leaf(byte* page, const std::vector<usage_row>& rows) {
+    mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_INDEX);
+    mach_write_to_4(page + PAGE_HEADER + PAGE_INDEX_ID + 4, 100);
+    mach_write_to_2(page + PAGE_HEADER + PAGE_N_HEAP, 0x8000 | (rows.size() + 2));
+    mach_write_to_2(page + PAGE_HEADER + PAGE_N_RECS, rows.size());
+    byte* infimum = page + PAGE_NEW_INFIMUM;
+    byte* supremum = page + PAGE_NEW_SUPREMUM;
+    mach_write_to_2(infimum - 4, REC_STATUS_INFIMUM);
+    mach_write_to_2(supremum - 4, (1 << 3) | REC_STATUS_SUPREMUM);
+
+    /* Extra bytes: 2 byte length of b, null bitmap, fixed header */
+    byte* rec = page + PAGE_NEW_SUPREMUM_END + 2 + 1 + REC_N_NEW_EXTRA_BYTES;
+    byte* prev = infimum;
+    for (size_t i = 0; i < rows.size(); i++) {
+        const usage_row& r = rows[i];
+        mach_write_to_2(rec - 4, ((i + 2) << 3) | REC_STATUS_ORDINARY);
+        mach_write_to_2(prev - REC_NEXT, (rec - prev) & 0xFFFF);
+        mach_write_to_4(rec, (uint32_t)r.id ^ 0x80000000);
+        mach_write_to_4(rec + 4, 0x100);
+        ulint len = 0;
+        if (r.null) {
+            rec[-REC_N_NEW_EXTRA_BYTES - 1] = 1;
+        } else if (r.lob_page != FIL_NULL) {
+            len = BTR_EXTERN_FIELD_REF_SIZE;
+            byte* ref = rec + 4 + 6 + 7;
+            mach_write_to_4(ref + BTR_EXTERN_PAGE_NO, r.lob_page);
+            mach_write_to_4(ref + BTR_EXTERN_OFFSET, FIL_PAGE_DATA);
+            mach_write_to_4(ref + BTR_EXTERN_LEN + 4, r.lob_len);
+            rec[-REC_N_NEW_EXTRA_BYTES - 2] = 0xC0;
+            rec[-REC_N_NEW_EXTRA_BYTES - 3] = len;
+        } else {
+            len = r.inline_len;
+            rec[-REC_N_NEW_EXTRA_BYTES - 2] = 0x80;
+            rec[-REC_N_NEW_EXTRA_BYTES - 3] = len;
+        }
+        prev = rec;
+        rec += 4 + 6 + 7 + len + 2 + 1 + REC_N_NEW_EXTRA_BYTES;
+    }
+    mach_write_to_2(prev - REC_NEXT, (supremum - prev) & 0xFFFF);
+    mach_write_to_2(page + PAGE_HEADER + PAGE_HEAP_TOP,
+                    rec - 2 - 1 - REC_N_NEW_EXTRA_BYTES - page);
+}
+
+/* Build an old format BLOB chain */
+static void build_usage_blob(std::vector<byte>& file,
+                             const std::vector<uint32_t>& pages) {
+    for (size_t i = 0; i < pages.size(); i++) {
+        byte* page = usage_page(file, pages[i]);
+        mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_TYPE_BLOB);
+        mach_write_to_4(page + FIL_PAGE_DATA + BTR_BLOB_HDR_NEXT_PAGE_NO,
+                        i + 1 < pages.size() ? pages[i + 1] : FIL_NULL);
+    }
+}
+
+static void write_usage_addr(byte* p, uint32_t page_no, uint32_t boffset) {
+    mach_write_to_4(p, page_no);
+    mach_write_to_2(p + 4, boffset);
+}
+
+/* Build a new format LOB whose index entries are all in the first page,
+with one older version of the second entry */
+static void build_usage_lob(std::vector<byte>& file, uint32_t first_page_no,
+                            const std::vector<uint32_t>& data_pages,
+                            uint32_t old_page_no) {
+    byte* first = usage_page(file, first_page_no);
+    mach_write_to_2(first + FIL_PAGE_TYPE, FIL_PAGE_TYPE_LOB_FIRST);
+    const ulint entry_size = (ulint)BlobIndexEntry::SIZE;
+    const ulint entries = (ulint)BlobFirstPage::LOB_PAGE_DATA;
+    byte* base = first + (ulint)BlobFirstPage::OFFSET_INDEX_LIST;
+    const size_t n = data_pages.size() + 1;
+    mach_write_to_4(base, n);
+    write_usage_addr(base + 4, first_page_no, entries);
+    write_usage_addr(base + 10, first_page_no, entries + (n - 1) * entry_size);
+    for (size_t i = 0; i < n; i++) {
+        byte* entry = first + entries + i * entry_size;
+        write_usage_addr(entry + (ulint)BlobIndexEntry::OFFSET_NEXT,
+                         i + 1 < n ? first_page_no : FIL_NULL,
+                         i + 1 < n ? entries + (i + 1) * entry_size : 0);
+        mach_write_to_4(entry + (ulint)BlobIndexEntry::OFFSET_PAGE_NO,
+                        i == 0 ? first_page_no : data_pages[i - 1]);
+    }
+    /* The version is in the last slot of the first page */
+    const ulint version_off = entries + 9 * entry_size;
+    byte* versions = first + entries + entry_size +
+                     (ulint)BlobIndexEntry::OFFSET_VERSIONS;
+    mach_write_to_4(versions, 1);
+    write_usage_addr(versions + 4, first_page_no, version_off);
+    write_usage_addr(first + version_off + (ulint)BlobIndexEntry::OFFSET_NEXT,
+                     FIL_NULL, 0);
+    mach_write_to_4(first + version_off + (ulint)BlobIndexEntry::OFFSET_PAGE_NO,
+                    old_page_no);
+    for (size_t i = 0; i < data_pages.size(); i++) {
+        mach_write_to_2(usage_page(file, data_pages[i]) + FIL_PAGE_TYPE,
+                        FIL_PAGE_TYPE_LOB_DATA);
+    }
+    mach_write_to_2(usage_page(file, old_page_no) + FIL_PAGE_TYPE,
+                    FIL_PAGE_TYPE_LOB_DATA);
+}
+
+static void check_usage(uint32_t n_threads) {
+    TableScan scan;
+    REQUIRE(table_scan_open(kSdiPath, nullptr, nullptr, &scan) == 0);
+    int fd = open(kIbdPath, O_RDONLY);
+    REQUIRE(fd >= 0);
+    table_scan_read_format(fd, &scan);
+    SpaceUsage usage;
+    REQUIRE(space_usage_scan(fd, scan, n_threads, &usage) == 0);
+    close(fd);
+
+    REQUIRE(usage.n_pages == 200);
+    REQUIRE(usage.n_recs == 5);
+    REQUIRE(usage.columns.size() == 4);
+    /* id, DB_TRX_ID, DB_ROLL_PTR, b */
+    const ColumnUsage& id = usage.columns[0];
+    REQUIRE(id.n_values == 5);
+    REQUIRE(id.inrow_bytes == 20);
+    REQUIRE(id.lob_pages == 0);
+    const ColumnUsage& b = usage.columns[3];
+    REQUIRE(b.n_values == 4);
+    REQUIRE(b.n_null == 1);
+    REQUIRE(b.inrow_bytes == 3 * BTR_EXTERN_FIELD_REF_SIZE + 10);
+    REQUIRE(b.n_extern == 3);
+    REQUIRE(b.extern_bytes == 30000 + 40000 + 9);
+    /* The BLOB chain 5 -> 150, the LOB 70 with 120 and 190 and the older
+    version in 121, nothing for the reference to page 60 */
+    REQUIRE(b.lob_pages == 2 + 4);
+    REQUIRE(usage.n_lobs == 2);
+    REQUIRE(usage.n_dangling == 1);
+    /* Page 199 is a BLOB page of no value */
+    REQUIRE(usage.n_lob_pages == 7);
+    REQUIRE(usage.indexes.size() == 1);
+    REQUIRE(usage.indexes[0].n_leaf_pages == 1);
+    REQUIRE(usage.indexes[0].n_recs == 5);
+}
+
+TEST_CASE(test_space_usage) {
+    FILE* f = fopen(kSdiPath, "w");
+    fputs(kSdi, f);
+    fclose(f);
+
+    /* Enough pages for several reader threads, the values cross the
+    ranges of the threads */
+    std::vector<byte> file(200 * UNIV_PAGE_SIZE);
+    std::vector<usage_row> rows;
+    usage_row r1 = {1, false, 0, 5, 30000};
+    usage_row r2 = {2, false, 0, 70, 40000};
+    usage_row r3 = {3, true, 0, FIL_NULL, 0};
+    usage_row r4 = {4, false, 10, FIL_NULL, 0};
+    usage_row r5 = {5, false, 0, 60, 9};
+    rows.push_back(r1);
+    rows.push_back(r2);
+    rows.push_back(r3);
+    rows.push_back(r4);
+    rows.push_back(r5);
+    build_usage_leaf(usage_page(file, 3), rows);
+    build_usage_blob(file, {5, 150});
+    build_usage_blob(file, {199});
+    build_usage_lob(file, 70, {120, 190}, 121);
+
+    f = fopen(kIbdPath, "wb");
+    fwrite(file.data(), 1, file.size(), f);
+    fclose(f);
+
+    check_usage(1);
+    check_usage(3);
+    unlink(kSdiPath);
+    unlink(kIbdPath);
+}
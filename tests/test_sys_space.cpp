@@ -0,0 +1,131 @@
+#include "../third_party/catch.hpp"
+#include "include/sys_space.h"
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/mach_data.h"
+#include "include/page0page.h"
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char* kSysSpace1 = "/tmp/inno_test_ibdata1";
+static const char* kSysSpace2 = "/tmp/inno_test_ibdata2";
+
+static void write_sys_file(const char* path, const std::vector<byte>& data) {
+    FILE* f = fopen(path, "wb");
+    fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+}
+
+TEST_CASE(test_sys_space_parse) {
+    std::vector<SysDataFile> files;
+    REQUIRE(sys_space_parse("ibdata1:12M;ibdata2:1G:autoextend:max:2G", &files) == 0);
+    REQUIRE(files.size() == 2);
+    REQUIRE(files[0].file_name == "ibdata1");
+    REQUIRE(files[0].n_pages == (12 << 20) / UNIV_PAGE_SIZE);
+    REQUIRE(!files[0].autoextend);
+    REQUIRE(files[1].n_pages == (1 << 30) / UNIV_PAGE_SIZE);
+    REQUIRE(files[1].autoextend);
+
+    REQUIRE(sys_space_parse("a,b", &files) == 0);
+    REQUIRE(files.size() == 2);
+    REQUIRE(files[1].file_name == "b");
+    REQUIRE(files[1].n_pages == 0);
+
+    REQUIRE(sys_space_is_multi_file("a,b"));
+    REQUIRE(sys_space_is_multi_file("ibdata1:12M"));
+    REQUIRE(!sys_space_is_multi_file("ibdata1"));
+    REQUIRE(sys_space_parse("ibdata1:12X", &files) == -1);
+    REQUIRE(sys_space_parse("ibdata1:12M:autoextend;ibdata2:12M", &files) == -1);
+    REQUIRE(sys_space_parse("ibdata1;;ibdata2", &files) == -1);
+}
+
+TEST_CASE(test_sys_space_read) {
+    /* ibdata1 of 8 pages with the TRX_SYS page, ibdata2 of 5 pages */
+    std::vector<byte> file1(8 * UNIV_PAGE_SIZE);
+    std::vector<byte> file2(5 * UNIV_PAGE_SIZE);
+    for (uint32_t i = 0; i < 8; i++) {
+        byte* page = &file1[i * UNIV_PAGE_SIZE];
+        mach_write_to_4(page + FIL_PAGE_OFFSET, i);
+        mach_write_to_2(page + FIL_PAGE_TYPE, i < 4 ? FIL_PAGE_TYPE_SYS : FIL_PAGE_INDEX);
+    }
+    for (uint32_t i = 0; i < 5; i++) {
+        byte* page = &file2[i * UNIV_PAGE_SIZE];
+        mach_write_to_4(page + FIL_PAGE_OFFSET, 8 + i);
+        mach_write_to_2(page + FIL_PAGE_TYPE, i < 2 ? FIL_PAGE_INDEX : FIL_PAGE_UNDO_LOG);
+    }
+    byte* trx_sys = &file1[FSP_TRX_SYS_PAGE_NO * UNIV_PAGE_SIZE];
+    mach_write_to_2(trx_sys + FIL_PAGE_TYPE, FIL_PAGE_TYPE_TRX_SYS);
+    byte* header = trx_sys + TRX_SYS;
+    mach_write_to_8(header + TRX_SYS_TRX_ID_STORE, 4096);
+    for (uint32_t slot = 0; slot < TRX_SYS_N_RSEGS; slot++) {
+        byte* s = header + TRX_SYS_RSEGS + slot * TRX_SYS_RSEG_SLOT_SIZE;
+        mach_write_to_4(s + TRX_SYS_RSEG_SPACE, slot < 2 ? slot * 7 : FIL_NULL);
+        mach_write_to_4(s + TRX_SYS_RSEG_PAGE_NO, slot < 2 ? 6 + slot : FIL_NULL);
+    }
+    byte* log_info = header + TRX_SYS_MYSQL_LOG_INFO;
+    mach_write_to_4(log_info + TRX_SYS_MYSQL_LOG_MAGIC_N_FLD, TRX_SYS_MYSQL_LOG_MAGIC_N);
+    mach_write_to_4(log_info + TRX_SYS_MYSQL_LOG_OFFSET_HIGH, 1);
+    mach_write_to_4(log_info + TRX_SYS_MYSQL_LOG_OFFSET_LOW, 154);
+    strcpy((char*)log_info + TRX_SYS_MYSQL_LOG_NAME, "./binlog.000042");
+    write_sys_file(kSysSpace1, file1);
+    write_sys_file(kSysSpace2, file2);
+
+    const std::string spec = std::string(kSysSpace1) + ":128K;" + kSysSpace2 + ":16K:autoextend";
+    SysSpace space;
+    REQUIRE(space.Open(spec.c_str()) == 0);
+    REQUIRE(space.files().size() == 2);
+    REQUIRE(space.files()[1].first_page == 8);
+    /* The last file grew past its declared size */
+    REQUIRE(space.files()[1].n_pages == 5);
+    REQUIRE(space.n_pages() == 13);
+
+    size_t f = 0;
+    uint64_t offset = 0;
+    REQUIRE(space.Locate(7, &f, &offset) == 0);
+    REQUIRE(f == 0);
+    REQUIRE(offset == 7 * UNIV_PAGE_SIZE);
+    REQUIRE(space.Locate(10, &f, &offset) == 0);
+    REQUIRE(f == 1);
+    REQUIRE(offset == 2 * UNIV_PAGE_SIZE);
+    REQUIRE(space.Locate(13, &f, &offset) == -1);
+
+    std::vector<byte> buf(4 * UNIV_PAGE_SIZE);
+    REQUIRE(space.ReadPages(6, 4, buf.data()) == 0);
+    for (uint32_t i = 0; i < 4; i++) {
+        REQUIRE(mach_read_from_4(&buf[i * UNIV_PAGE_SIZE] + FIL_PAGE_OFFSET) == 6 + i);
+    }
+    REQUIRE(space.ReadPages(11, 4, buf.data()) == -1);
+
+    for (uint32_t n_threads = 1; n_threads <= 4; n_threads += 3) {
+        std::vector<PageTypeRun> runs;
+        REQUIRE(sys_space_page_types(space, n_threads, &runs) == 0);
+        /* SYS 0..3, INDEX 4, TRX_SYS 5, INDEX 6..9 across the files, UNDO */
+        REQUIRE(runs.size() == 5);
+        REQUIRE(runs[0].n_pages == 4);
+        REQUIRE(runs[2].type == FIL_PAGE_TYPE_TRX_SYS);
+        REQUIRE(runs[3].type == FIL_PAGE_INDEX);
+        REQUIRE(runs[3].first_page == 6);
+        REQUIRE(runs[3].n_pages == 4);
+        REQUIRE(runs[4].type == FIL_PAGE_UNDO_LOG);
+        REQUIRE(runs[4].n_pages == 3);
+    }
+
+    REQUIRE(space.ReadPages(FSP_TRX_SYS_PAGE_NO, 1, buf.data()) == 0);
+    TrxSysInfo info;
+    REQUIRE(trx_sys_decode(buf.data(), &info) == 0);
+    REQUIRE(info.max_trx_id == 4096);
+    REQUIRE(info.has_binlog);
+    REQUIRE(info.binlog_name == "./binlog.000042");
+    REQUIRE(info.binlog_offset == (1ULL << 32 | 154));
+    REQUIRE(info.rsegs.size() == 2);
+    REQUIRE(info.rsegs[1].slot == 1);
+    REQUIRE(info.rsegs[1].space_id == 7);
+    REQUIRE(info.rsegs[1].page_no == 7);
+    REQUIRE(trx_sys_decode(&file1[0], &info) == -1);
+
+    unlink(kSysSpace1);
+    unlink(kSysSpace2);
+}
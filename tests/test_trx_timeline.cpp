@@ -0,0 +1,193 @@
+#include "../third_party/catch.hpp"
+#include "include/trx_timeline.h"
+#include "include/undo_decoder.h"
+#include "include/fil0fil.h"
+#include "include/mach_data.h"
+#include "include/fut0lst.h"
+#include "include/page0page.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char* kTrxTimelinePath = "/tmp/inno_test_trx_timeline.ibu";
+
+static byte* timeline_page(std::vector<byte>& file, uint32_t page_no) {
+    return &file[page_no * UNIV_PAGE_SIZE];
+}
+
+/* An undo log page, prev is FIL_NULL for the header page of a segment */
+static byte* build_timeline_page(std::vector<byte>& file, uint32_t page_no,
+                                 uint32_t prev, ulint type) {
+    byte* page = timeline_page(file, page_no);
+    mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_UNDO_LOG);
+    mach_write_to_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_TYPE, type);
+    byte* node = page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_NODE + FLST_PREV;
+    mach_write_to_4(node + FIL_ADDR_PAGE, prev);
+    mach_write_to_2(node + FIL_ADDR_BYTE,
+                    prev == FIL_NULL ? 0 : TRX_UNDO_PAGE_HDR);
+    mach_write_to_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE,
+                    TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_HDR_SIZE);
+    return page;
+}
+
+/* Append an insert record of a table at TRX_UNDO_PAGE_FREE */
+static void put_timeline_rec(byte* page, uint64_t table_id) {
+    const ulint offset =
+        mach_read_from_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE);
+    byte* p = page + offset + 2;
+    *p++ = TRX_UNDO_INSERT_REC;
+    p += mach_u64_write_much_compressed(p, 0);
+    p += mach_u64_write_much_compressed(p, table_id);
+    p += mach_write_compressed(p, 4);
+    mach_write_to_4(p, 1);
+    p += 4;
+    const ulint next = p - page + 2;
+    mach_write_to_2(page + offset, next);
+    mach_write_to_2(page + next - 2, offset);
+    mach_write_to_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE, next);
+}
+
+/* Start an undo log at TRX_UNDO_PAGE_FREE of the header page of a
+segment */
+static void put_timeline_log(byte* page, uint64_t trx_id, uint64_t trx_no,
+                             bool del_marks) {
+    ulint log = mach_read_from_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE);
+    const ulint prev = mach_read_from_2(page + TRX_UNDO_SEG_HDR + TRX_UNDO_LAST_LOG);
+    if (prev == 0) {
+        log = TRX_UNDO_SEG_HDR + TRX_UNDO_SEG_HDR_SIZE;
+    } else {
+        mach_write_to_2(page + prev + TRX_UNDO_NEXT_LOG, log);
+    }
+    mach_write_to_8(page + log + TRX_UNDO_TRX_ID, trx_id);
+    mach_write_to_8(page + log + TRX_UNDO_TRX_NO, trx_no);
+    mach_write_to_2(page + log + TRX_UNDO_DEL_MARKS, del_marks);
+    mach_write_to_2(page + log + TRX_UNDO_LOG_START, log + 46);
+    mach_write_to_2(page + log + TRX_UNDO_PREV_LOG, prev);
+    mach_write_to_2(page + TRX_UNDO_SEG_HDR + TRX_UNDO_LAST_LOG, log);
+    mach_write_to_2(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE, log + 46);
+}
+
+static std::vector<uint64_t> find_trx(const TrxTimeline& timeline, uint64_t lo,
+                                      uint64_t hi, bool by_trx_no,
+                                      uint64_t table_id) {
+    std::vector<uint64_t> ids;
+    timeline.Find(lo, hi, by_trx_no, table_id, [&](const TrxLog& log) {
+        ids.push_back(log.trx_id);
+        return true;
+    });
+    return ids;
+}
+
+static void check_trx_timeline(const TrxTimeline& timeline) {
+    REQUIRE(timeline.n_logs() == 3);
+    std::vector<TrxLog> logs;
+    timeline.Find(0, UINT64_MAX, false, 0, [&](const TrxLog& log) {
+        logs.push_back(log);
+        return true;
+    });
+    REQUIRE(logs.size() == 3);
+    REQUIRE(logs[0].trx_id == 90);
+    REQUIRE(logs[0].type == TRX_UNDO_INSERT);
+    REQUIRE(logs[0].state == TRX_UNDO_ACTIVE);
+    REQUIRE(logs[0].page_no == 5);
+    REQUIRE(logs[0].n_pages == 1);
+    REQUIRE(logs[0].n_records == 1);
+    /* The first log of the reused segment only has its header page */
+    REQUIRE(logs[1].trx_id == 100);
+    REQUIRE(logs[1].trx_no == 110);
+    REQUIRE(logs[1].state == 0);
+    REQUIRE(!logs[1].del_marks);
+    REQUIRE(logs[1].n_pages == 1);
+    REQUIRE(logs[1].n_records == 1);
+    REQUIRE(logs[1].tables == std::vector<uint64_t>{1122});
+    /* The last one has the pages chained after it */
+    REQUIRE(logs[2].trx_id == 105);
+    REQUIRE(logs[2].type == TRX_UNDO_UPDATE);
+    REQUIRE(logs[2].state == TRX_UNDO_CACHED);
+    REQUIRE(logs[2].del_marks);
+    REQUIRE(logs[2].page_no == 3);
+    REQUIRE(logs[2].log_offset > logs[1].log_offset);
+    REQUIRE(logs[2].n_pages == 3);
+    REQUIRE(logs[2].n_records == 4);
+    REQUIRE(logs[2].tables == (std::vector<uint64_t>{77, 99, 1122}));
+
+    REQUIRE(find_trx(timeline, 95, 200, false, 0) ==
+            (std::vector<uint64_t>{100, 105}));
+    REQUIRE(find_trx(timeline, 105, 105, false, 0) ==
+            std::vector<uint64_t>{105});
+    REQUIRE(find_trx(timeline, 0, UINT64_MAX, true, 0) ==
+            (std::vector<uint64_t>{90, 105, 100}));
+    REQUIRE(find_trx(timeline, 100, 109, true, 0) ==
+            std::vector<uint64_t>{105});
+    REQUIRE(find_trx(timeline, 0, UINT64_MAX, false, 77) ==
+            std::vector<uint64_t>{105});
+    REQUIRE(find_trx(timeline, 0, UINT64_MAX, false, 1122).size() == 3);
+    REQUIRE(find_trx(timeline, 0, UINT64_MAX, false, 5).empty());
+    REQUIRE(find_trx(timeline, 200, UINT64_MAX, false, 0).empty());
+}
+
+TEST_CASE(test_trx_timeline) {
+    std::vector<byte> file(12 * UNIV_PAGE_SIZE);
+
+    /* A reused cached update segment: two logs, the last one continued on
+    pages 7 and 9 */
+    byte* page = build_timeline_page(file, 3, FIL_NULL, TRX_UNDO_UPDATE);
+    mach_write_to_2(page + TRX_UNDO_SEG_HDR + TRX_UNDO_STATE, TRX_UNDO_CACHED);
+    put_timeline_log(page, 100, 110, false);
+    put_timeline_rec(page, 1122);
+    put_timeline_log(page, 105, 108, true);
+    put_timeline_rec(page, 99);
+    put_timeline_rec(page, 1122);
+    put_timeline_rec(build_timeline_page(file, 7, 3, TRX_UNDO_UPDATE), 77);
+    put_timeline_rec(build_timeline_page(file, 9, 7, TRX_UNDO_UPDATE), 1122);
+
+    /* An active insert segment */
+    page = build_timeline_page(file, 5, FIL_NULL, TRX_UNDO_INSERT);
+    mach_write_to_2(page + TRX_UNDO_SEG_HDR + TRX_UNDO_STATE, TRX_UNDO_ACTIVE);
+    put_timeline_log(page, 90, 0, false);
+    put_timeline_rec(page, 1122);
+
+    /* An undo page of no segment */
+    put_timeline_rec(build_timeline_page(file, 10, 11, TRX_UNDO_UPDATE), 55);
+
+    FILE* f = fopen(kTrxTimelinePath, "wb");
+    fwrite(file.data(), 1, file.size(), f);
+    fclose(f);
+    const std::string index_path = std::string(kTrxTimelinePath) + TRX_TIMELINE_SUFFIX;
+    unlink(index_path.c_str());
+
+    int fd = open(kTrxTimelinePath, O_RDONLY);
+    REQUIRE(fd >= 0);
+    {
+        TrxTimeline timeline;
+        REQUIRE(timeline.Open(kTrxTimelinePath, fd) == 0);
+        REQUIRE(!timeline.reused());
+        check_trx_timeline(timeline);
+    }
+    {
+        TrxTimeline timeline;
+        REQUIRE(timeline.Open(kTrxTimelinePath, fd) == 0);
+        REQUIRE(timeline.reused());
+        check_trx_timeline(timeline);
+    }
+    close(fd);
+
+    /* A changed undo file is indexed again */
+    f = fopen(kTrxTimelinePath, "ab");
+    fwrite(file.data(), 1, UNIV_PAGE_SIZE, f);
+    fclose(f);
+    fd = open(kTrxTimelinePath, O_RDONLY);
+    REQUIRE(fd >= 0);
+    {
+        TrxTimeline timeline;
+        REQUIRE(timeline.Open(kTrxTimelinePath, fd) == 0);
+        REQUIRE(!timeline.reused());
+        check_trx_timeline(timeline);
+    }
+    close(fd);
+    unlink(index_path.c_str());
+    unlink(kTrxTimelinePath);
+}
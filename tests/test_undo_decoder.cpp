@@ -0,0 +1,203 @@
+#include "../third_party/catch.hpp"
+#include "include/undo_decoder.h"
+#include "include/table_def.h"
+#include "include/rec_decoder.h"
+#include "include/mach_data.h"
+#include "include/fil0fil.h"
+#include "include/fsp0types.h"
+#include "include/page0page.h"
+#include <cstring>
+#include <vector>
+
+TEST_CASE(test_mach_compressed_roundtrip) {
+    const uint32_t values[] = {0, 0x7F, 0x80, 0x3FFF, 0x4000, 0x1FFFFF,
+                               0x200000, 0xFFFFFFF, 0x10000000,
+                               UNIV_EXTERN_STORAGE_FIELD, 0xFFFFFFFE,
+                               UNIV_SQL_NULL};
+    byte buf[16];
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        ulint n = mach_write_compressed(buf, values[i]);
+        const byte* ptr = buf;
+        REQUIRE(mach_parse_compressed(&ptr, buf + n) == values[i]);
+        REQUIRE(ptr == buf + n);
+        /* A truncated value is reported, not read past the end */
+        ptr = buf;
+        mach_parse_compressed(&ptr, buf + n - 1);
+        REQUIRE(ptr == nullptr);
+    }
+    const uint64_t values64[] = {0, 1, 0xFFFFFFFF, 0x100000000ULL,
+                                 0x123456789ABCULL, 0xFFFFFFFFFFFFFFFFULL};
+    for (size_t i = 0; i < sizeof(values64) / sizeof(values64[0]); i++) {
+        ulint n = mach_u64_write_compressed(buf, values64[i]);
+        const byte* ptr = buf;
+        REQUIRE(mach_u64_parse_compressed(&ptr, buf + n) == values64[i]);
+        REQUIRE(ptr == buf + n);
+        n = mach_u64_write_much_compressed(buf, values64[i]);
+        ptr = buf;
+        REQUIRE(mach_parse_u64_much_compressed(&ptr, buf + n) == values64[i]);
+        REQUIRE(ptr == buf + n);
+    }
+}
+
+/* Write an undo record at offset: the offset of the next record, the body
+and the offset of the record. @return offset of the next record */
+static ulint put_undo_rec(byte* page, ulint offset, const std::vector<byte>& body) {
+    const ulint next = offset + 2 + body.size() + 2;
+    mach_write_to_2(page + offset, next);
+    memcpy(page + offset + 2, body.data(), body.size());
+    mach_write_to_2(page + next - 2, offset);
+    return next;
+}
+
+static void put_compressed(std::vector<byte>* body, uint32_t n) {
+    byte buf[5];
+    body->insert(body->end(), buf, buf + mach_write_compressed(buf, n));
+}
+
+static void put_much_compressed(std::vector<byte>* body, uint64_t n) {
+    byte buf[11];
+    body->insert(body->end(), buf, buf + mach_u64_write_much_compressed(buf, n));
+}
+
+static void put_u64_compressed(std::vector<byte>* body, uint64_t n) {
+    byte buf[9];
+    body->insert(body->end(), buf, buf + mach_u64_write_compressed(buf, n));
+}
+
+static void put_field(std::vector<byte>* body, const byte* data, uint32_t len) {
+    put_compressed(body, len);
+    body->insert(body->end(), data, data + len);
+}
+
+/* The body of an update record of sbtest1: the primary key id, then the
+old value of c */
+static std::vector<byte> update_body(ulint type, uint64_t undo_no,
+                                     uint64_t table_id, int32_t id,
+                                     const char* old_c) {
+    std::vector<byte> body;
+    body.push_back(type);
+    put_much_compressed(&body, undo_no);
+    put_much_compressed(&body, table_id);
+    body.push_back(0);
+    put_u64_compressed(&body, 0x1234);
+    put_u64_compressed(&body, 0x01000000A00110ULL);
+    byte key[4];
+    mach_write_to_4(key, (uint32_t)id ^ 0x80000000);
+    put_field(&body, key, 4);
+    if (old_c != nullptr) {
+        put_compressed(&body, 1);
+        put_compressed(&body, 4);
+        put_field(&body, (const byte*)old_c, strlen(old_c));
+    }
+    return body;
+}
+
+TEST_CASE(test_undo_page_records) {
+    TableDef table;
+    REQUIRE(table_def_load("tool/sbtest1.json", &table) == 0);
+    RecLayout layout;
+    REQUIRE(rec_layout_build(table, *table_def_clust_index(table), true,
+                             &layout) == 0);
+    UndoPlan plan;
+    plan.table_id = table.id;
+    plan.layout = &layout;
+
+    /* The first page of an update undo segment with two undo logs: an
+    update of sbtest1, then a delete mark of sbtest1 and an update of
+    another table */
+    std::vector<byte> page(UNIV_PAGE_SIZE);
+    byte* p = page.data();
+    mach_write_to_2(p + FIL_PAGE_TYPE, FIL_PAGE_UNDO_LOG);
+    mach_write_to_2(p + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_TYPE, TRX_UNDO_UPDATE);
+    mach_write_to_4(p + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_NODE, FIL_NULL);
+    const ulint log1 = TRX_UNDO_SEG_HDR + 30;
+    mach_write_to_8(p + log1 + TRX_UNDO_TRX_ID, 100);
+    mach_write_to_2(p + log1 + TRX_UNDO_LOG_START, log1 + 46);
+    ulint offset = put_undo_rec(
+        p, log1 + 46, update_body(TRX_UNDO_UPD_EXIST_REC, 0, 1122, 7, "old"));
+    const ulint log2 = offset;
+    mach_write_to_8(p + log2 + TRX_UNDO_TRX_ID, 101);
+    mach_write_to_8(p + log2 + TRX_UNDO_TRX_NO, 102);
+    mach_write_to_2(p + log2 + TRX_UNDO_DEL_MARKS, 1);
+    mach_write_to_2(p + log2 + TRX_UNDO_LOG_START, log2 + 46);
+    mach_write_to_2(p + log2 + TRX_UNDO_PREV_LOG, log1);
+    mach_write_to_2(p + log1 + TRX_UNDO_NEXT_LOG, log2);
+    mach_write_to_2(p + TRX_UNDO_SEG_HDR + TRX_UNDO_LAST_LOG, log2);
+    offset = put_undo_rec(
+        p, log2 + 46, update_body(TRX_UNDO_DEL_MARK_REC, 1, 1122, 8, nullptr));
+    offset = put_undo_rec(
+        p, offset, update_body(TRX_UNDO_UPD_EXIST_REC, 2, 99, 9, "other"));
+    mach_write_to_2(p + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE, offset);
+
+    std::vector<std::string> seen;
+    UndoRecord rec;
+    UndoScanStats stats;
+    REQUIRE(undo_page_records(
+        5, p, plan, &rec, &stats,
+        [&](uint32_t page_no, const UndoLogHeader* log, const UndoRecord& r) {
+            REQUIRE(page_no == 5);
+            REQUIRE(log != nullptr);
+            std::string s = std::to_string(log->trx_id) + " " +
+                            undo_rec_type_name(r.type) + " " +
+                            std::to_string(r.undo_no) + " " +
+                            std::to_string(r.pk.size()) + " " +
+                            std::to_string(r.update.size());
+            if (r.table_id == 1122) {
+                REQUIRE(r.trx_id == 0x1234);
+                REQUIRE(r.roll_ptr == 0x01000000A00110ULL);
+                REQUIRE(r.pk[0].len == 4);
+                s += " " + std::to_string(mach_read_from_4(r.pk[0].data) ^ 0x80000000);
+            }
+            if (!r.update.empty()) {
+                REQUIRE(r.update[0].field_no == 4);
+                s += " " + std::string((const char*)r.update[0].data,
+                                       r.update[0].len);
+            }
+            seen.push_back(s);
+            return true;
+        }));
+    REQUIRE(stats.n_records == 3);
+    REQUIRE(stats.n_bad_records == 0);
+    REQUIRE(seen.size() == 3);
+    REQUIRE(seen[0] == "100 update 0 1 1 7 old");
+    REQUIRE(seen[1] == "101 delete_mark 1 1 0 8");
+    /* Not the table of the plan: the key length is not known */
+    REQUIRE(seen[2] == "101 update 2 0 0");
+
+    /* A later page of an insert undo log: the records follow the page
+    header, the fields of an insert record run to its end */
+    memset(p, 0, UNIV_PAGE_SIZE);
+    mach_write_to_2(p + FIL_PAGE_TYPE, FIL_PAGE_UNDO_LOG);
+    mach_write_to_2(p + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_TYPE, TRX_UNDO_INSERT);
+    mach_write_to_4(p + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_NODE, 4);
+    std::vector<byte> body;
+    body.push_back(TRX_UNDO_INSERT_REC);
+    put_much_compressed(&body, 0x1FFFFFFFFULL);
+    put_much_compressed(&body, 1122);
+    byte key[4];
+    mach_write_to_4(key, 42 ^ 0x80000000);
+    put_field(&body, key, 4);
+    offset = put_undo_rec(p, TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_HDR_SIZE, body);
+    /* A record whose field runs past its end */
+    body.back() = 0;
+    body[body.size() - 5] = 20;
+    offset = put_undo_rec(p, offset, body);
+    mach_write_to_2(p + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_FREE, offset);
+
+    stats = UndoScanStats();
+    size_t n = 0;
+    REQUIRE(undo_page_records(
+        6, p, plan, &rec, &stats,
+        [&](uint32_t, const UndoLogHeader* log, const UndoRecord& r) {
+            REQUIRE(log == nullptr);
+            REQUIRE(r.type == TRX_UNDO_INSERT_REC);
+            REQUIRE(r.undo_no == 0x1FFFFFFFFULL);
+            REQUIRE(r.pk.size() == 1);
+            REQUIRE((mach_read_from_4(r.pk[0].data) ^ 0x80000000) == 42);
+            n++;
+            return true;
+        }));
+    REQUIRE(n == 1);
+    REQUIRE(stats.n_records == 1);
+    REQUIRE(stats.n_bad_records == 1);
+}
@@ -0,0 +1,144 @@
+#include "../third_party/catch.hpp"
+#include "include/undo_history.h"
+#include "include/fil0fil.h"
+#include "include/mach_data.h"
+#include "include/fsp0types.h"
+#include "include/fut0lst.h"
+#include "include/page0page.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char* kUndoPath = "/tmp/inno_test_history.ibu";
+
+static byte* history_page(std::vector<byte>& file, uint32_t page_no) {
+    return &file[page_no * UNIV_PAGE_SIZE];
+}
+
+static void write_history_addr(byte* p, uint32_t page_no, uint32_t boffset) {
+    mach_write_to_4(p + FIL_ADDR_PAGE, page_no);
+    mach_write_to_2(p + FIL_ADDR_BYTE, boffset);
+}
+
+/* An undo log in the history: its header at log_offset of page_no, the
+undo log segment of the page with seg_pages pages */
+struct history_log {
+    uint32_t page_no;
+    uint32_t log_offset;
+    uint64_t trx_no;
+    uint32_t seg_pages;
+};
+
+/* Build a rollback segment header page and the history list of its logs,
+first the newest */
+static void build_rseg(std::vector<byte>& file, uint32_t rseg_page,
+                       uint32_t history_size, uint32_t history_len,
+                       const std::vector<history_log>& logs) {
+    byte* rseg = history_page(file, rseg_page);
+    mach_write_to_2(rseg + FIL_PAGE_TYPE, FIL_PAGE_TYPE_SYS);
+    mach_write_to_4(rseg + TRX_RSEG + TRX_RSEG_MAX_SIZE, 0xFFFFFFFE);
+    mach_write_to_4(rseg + TRX_RSEG + TRX_RSEG_HISTORY_SIZE, history_size);
+    byte* base = rseg + TRX_RSEG + TRX_RSEG_HISTORY;
+    mach_write_to_4(base + FLST_LEN, history_len);
+    write_history_addr(base + FLST_FIRST, FIL_NULL, 0);
+    write_history_addr(base + FLST_LAST, FIL_NULL, 0);
+    for (size_t i = 0; i < logs.size(); i++) {
+        const history_log& log = logs[i];
+        byte* page = history_page(file, log.page_no);
+        mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_UNDO_LOG);
+        mach_write_to_4(page + TRX_UNDO_SEG_HDR + TRX_UNDO_PAGE_LIST + FLST_LEN,
+                        log.seg_pages);
+        mach_write_to_8(page + log.log_offset + TRX_UNDO_TRX_NO, log.trx_no);
+        const uint32_t node = log.log_offset + TRX_UNDO_HISTORY_NODE;
+        if (i == 0) {
+            write_history_addr(base + FLST_FIRST, log.page_no, node);
+        }
+        if (i + 1 < logs.size()) {
+            write_history_addr(page + node + FLST_NEXT, logs[i + 1].page_no,
+                               logs[i + 1].log_offset + TRX_UNDO_HISTORY_NODE);
+        } else {
+            write_history_addr(page + node + FLST_NEXT, FIL_NULL, 0);
+            write_history_addr(base + FLST_LAST, log.page_no, node);
+        }
+    }
+}
+
+static void check_history(uint32_t n_threads) {
+    int fd = open(kUndoPath, O_RDONLY);
+    REQUIRE(fd >= 0);
+    std::vector<uint32_t> rseg_pages;
+    REQUIRE(undo_rseg_array_read(fd, &rseg_pages) == 0);
+    REQUIRE(rseg_pages.size() == TRX_SYS_N_RSEGS);
+    std::vector<RsegHistory> history;
+    REQUIRE(undo_history_walk(fd, rseg_pages, n_threads, &history) == 0);
+    close(fd);
+
+    REQUIRE(history.size() == 4);
+    const RsegHistory& r0 = history[0];
+    REQUIRE(r0.rseg_id == 0);
+    REQUIRE(r0.page_no == 10);
+    REQUIRE(r0.history_len == 4);
+    REQUIRE(r0.n_logs == 4);
+    REQUIRE(r0.history_size == 9);
+    /* Two logs share the cached segment of page 20 */
+    REQUIRE(r0.segments.size() == 3);
+    REQUIRE(r0.segments[0] == 20);
+    REQUIRE(r0.n_seg_pages == 3 + 1 + 2);
+    REQUIRE(r0.oldest_trx_no == 20);
+    REQUIRE(r0.newest_trx_no == 50);
+    REQUIRE(!r0.corrupt);
+
+    const RsegHistory& r1 = history[1];
+    REQUIRE(r1.rseg_id == 1);
+    REQUIRE(r1.n_logs == 0);
+    REQUIRE(!r1.corrupt);
+
+    const RsegHistory& r2 = history[2];
+    REQUIRE(r2.rseg_id == 5);
+    REQUIRE(r2.n_logs == 2);
+    REQUIRE(r2.oldest_trx_no == 90);
+    REQUIRE(!r2.corrupt);
+
+    /* A node that points to itself */
+    const RsegHistory& r3 = history[3];
+    REQUIRE(r3.rseg_id == 6);
+    REQUIRE(r3.corrupt);
+    REQUIRE(r3.n_logs == 5);
+}
+
+TEST_CASE(test_undo_history_walk) {
+    std::vector<byte> file(40 * UNIV_PAGE_SIZE);
+    byte* array = history_page(file, FSP_RSEG_ARRAY_PAGE_NO);
+    mach_write_to_2(array + FIL_PAGE_TYPE, FIL_PAGE_TYPE_RSEG_ARRAY);
+    mach_write_to_4(array + RSEG_ARRAY_HEADER + RSEG_ARRAY_VERSION_OFFSET,
+                    RSEG_ARRAY_VERSION);
+    byte* slots = array + RSEG_ARRAY_HEADER + RSEG_ARRAY_PAGES_OFFSET;
+    for (uint32_t slot = 0; slot < TRX_SYS_N_RSEGS; slot++) {
+        mach_write_to_4(slots + slot * RSEG_ARRAY_SLOT_SIZE, FIL_NULL);
+    }
+    mach_write_to_4(slots + 0 * RSEG_ARRAY_SLOT_SIZE, 10);
+    mach_write_to_4(slots + 1 * RSEG_ARRAY_SLOT_SIZE, 11);
+    mach_write_to_4(slots + 5 * RSEG_ARRAY_SLOT_SIZE, 12);
+    mach_write_to_4(slots + 6 * RSEG_ARRAY_SLOT_SIZE, 13);
+
+    const uint32_t log1 = TRX_UNDO_SEG_HDR + TRX_UNDO_SEG_HDR_SIZE;
+    const uint32_t log2 = log1 + 300;
+    build_rseg(file, 10, 9, 4,
+               {{20, log2, 50, 3}, {20, log1, 40, 3}, {25, log1, 30, 1},
+                {21, log1, 20, 2}});
+    build_rseg(file, 11, 0, 0, {});
+    build_rseg(file, 12, 2, 2, {{22, log1, 100, 1}, {23, log1, 90, 1}});
+    build_rseg(file, 13, 1, 5, {{24, log1, 7, 1}});
+    write_history_addr(history_page(file, 24) + log1 + TRX_UNDO_HISTORY_NODE +
+                       FLST_NEXT, 24, log1 + TRX_UNDO_HISTORY_NODE);
+
+    FILE* f = fopen(kUndoPath, "wb");
+    fwrite(file.data(), 1, file.size(), f);
+    fclose(f);
+
+    check_history(1);
+    check_history(3);
+    unlink(kUndoPath);
+}
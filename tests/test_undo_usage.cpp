@@ -0,0 +1,191 @@
+#include "../third_party/catch.hpp"
+#include "include/undo_usage.h"
+#include "include/undo_decoder.h"
+#include "include/fil0fil.h"
+#include "include/mach_data.h"
+#include "include/fsp0types.h"
+#include "include/fsp0fsp.h"
+#include "include/fut0lst.h"
+#include "include/page0page.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char* kUndoUsagePath = "/tmp/inno_test_undo_usage.ibu";
+
+static byte* undo_usage_page(std::vector<byte>& file, uint32_t page_no) {
+    return &file[page_no * UNIV_PAGE_SIZE];
+}
+
+static void write_usage_addr(byte* p, uint32_t page_no, uint32_t boffset) {
+    mach_write_to_4(p + FIL_ADDR_PAGE, page_no);
+    mach_write_to_2(p + FIL_ADDR_BYTE, boffset);
+}
+
+/* An undo log page, prev is FIL_NULL for the header page of a segment */
+static byte* build_undo_page(std::vector<byte>& file, uint32_t page_no,
+                             uint32_t prev) {
+    byte* page = undo_usage_page(file, page_no);
+    mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_UNDO_LOG);
+    write_usage_addr(page + TRX_UNDO_PAGE_HDR + TRX_UNDO_PAGE_NODE + FLST_PREV,
+                     prev, prev == FIL_NULL ? 0 : TRX_UNDO_PAGE_HDR);
+    return page;
+}
+
+/* The header page of an undo log segment with n_logs undo logs */
+static void build_undo_segment(std::vector<byte>& file, uint32_t page_no,
+                               ulint state, uint32_t list_len, uint32_t n_logs,
+                               uint32_t inode_offset) {
+    byte* page = build_undo_page(file, page_no, FIL_NULL);
+    mach_write_to_2(page + TRX_UNDO_SEG_HDR + TRX_UNDO_STATE, state);
+    mach_write_to_4(page + TRX_UNDO_SEG_HDR + TRX_UNDO_PAGE_LIST + FLST_LEN,
+                    list_len);
+    byte* fseg = page + TRX_UNDO_SEG_HDR + TRX_UNDO_FSEG_HEADER;
+    mach_write_to_4(fseg + FSEG_HDR_PAGE_NO, 2);
+    mach_write_to_2(fseg + FSEG_HDR_OFFSET, inode_offset);
+    uint32_t log = 0;
+    for (uint32_t i = 0; i < n_logs; i++) {
+        const uint32_t next = TRX_UNDO_SEG_HDR + TRX_UNDO_SEG_HDR_SIZE + i * 200;
+        mach_write_to_2(page + next + TRX_UNDO_PREV_LOG, log);
+        log = next;
+    }
+    mach_write_to_2(page + TRX_UNDO_SEG_HDR + TRX_UNDO_LAST_LOG, log);
+}
+
+/* A file segment inode with n_frag fragment pages and n_free free
+extents */
+static void build_inode(byte* page, uint32_t offset, uint32_t n_frag,
+                        uint32_t n_free) {
+    byte* inode = page + offset;
+    mach_write_to_8(inode + FSEG_ID, offset);
+    mach_write_to_4(inode + FSEG_FREE + FLST_LEN, n_free);
+    mach_write_to_4(inode + FSEG_MAGIC_N, FSEG_MAGIC_N_VALUE);
+    for (uint32_t i = 0; i < FSEG_FRAG_ARR_N_SLOTS; i++) {
+        mach_write_to_4(inode + FSEG_FRAG_ARR + i * FSEG_FRAG_SLOT_SIZE,
+                        i < n_frag ? 100 + i : FIL_NULL);
+    }
+}
+
+static byte* build_rseg_page(std::vector<byte>& file, uint32_t page_no) {
+    byte* page = undo_usage_page(file, page_no);
+    mach_write_to_2(page + FIL_PAGE_TYPE, FIL_PAGE_TYPE_SYS);
+    byte* base = page + TRX_RSEG + TRX_RSEG_HISTORY;
+    write_usage_addr(base + FLST_FIRST, FIL_NULL, 0);
+    write_usage_addr(base + FLST_LAST, FIL_NULL, 0);
+    for (uint32_t i = 0; i < TRX_RSEG_N_SLOTS; i++) {
+        mach_write_to_4(page + TRX_RSEG + TRX_RSEG_UNDO_SLOTS +
+                        i * TRX_RSEG_SLOT_SIZE, FIL_NULL);
+    }
+    return page;
+}
+
+static void check_undo_usage(uint32_t n_threads) {
+    int fd = open(kUndoUsagePath, O_RDONLY);
+    REQUIRE(fd >= 0);
+    UndoSpaceUsage usage;
+    REQUIRE(undo_usage_scan(fd, n_threads, &usage) == 0);
+    close(fd);
+
+    REQUIRE(usage.n_pages == 200);
+    REQUIRE(usage.n_undo_pages == 11);
+    /* 160 is linked to a page that is not an undo page, 170 and 171 to
+    each other */
+    REQUIRE(usage.n_orphan_pages == 3);
+    REQUIRE(usage.n_rseg_pages == 3);
+    REQUIRE(usage.n_space_pages == 2);
+    REQUIRE(usage.n_allocated_pages == 200 - 16);
+
+    REQUIRE(usage.segments.size() == 5);
+    REQUIRE(usage.segments[0].page_no == 20);
+    REQUIRE(usage.segments[0].n_pages == 3);
+    REQUIRE(usage.segments[0].in_slot);
+    REQUIRE(usage.segments[1].n_logs == 2);
+    REQUIRE(usage.segments[2].page_no == 40);
+    REQUIRE(usage.segments[2].in_history);
+    REQUIRE(!usage.segments[2].in_slot);
+    REQUIRE(usage.segments[2].reserved == 2 + FSP_EXTENT_SIZE);
+    REQUIRE(usage.segments[2].used == 2);
+    REQUIRE(usage.segments[4].page_no == 60);
+    REQUIRE(usage.segments[4].rseg_id == UINT32_MAX);
+
+    REQUIRE(usage.rsegs.size() == 2);
+    const RsegUsage& r0 = usage.rsegs[0];
+    REQUIRE(r0.rseg_id == 0);
+    REQUIRE(r0.n_segments[TRX_UNDO_ACTIVE] == 1);
+    REQUIRE(r0.n_pages[TRX_UNDO_ACTIVE] == 3);
+    REQUIRE(r0.n_segments[TRX_UNDO_CACHED] == 1);
+    REQUIRE(r0.n_cached_reused == 1);
+    REQUIRE(r0.n_segments[TRX_UNDO_TO_PURGE] == 1);
+    REQUIRE(r0.n_pages[TRX_UNDO_TO_PURGE] == 2);
+    REQUIRE(r0.n_reserved == 3 + 2 + FSP_EXTENT_SIZE);
+    REQUIRE(r0.n_free == FSP_EXTENT_SIZE);
+    const RsegUsage& r1 = usage.rsegs[1];
+    REQUIRE(r1.rseg_id == 4);
+    REQUIRE(r1.n_segments[TRX_UNDO_ACTIVE] == 1);
+    REQUIRE(r1.n_pages[TRX_UNDO_ACTIVE] == 1);
+}
+
+TEST_CASE(test_undo_usage_scan) {
+    std::vector<byte> file(200 * UNIV_PAGE_SIZE);
+    mach_write_to_2(undo_usage_page(file, 0) + FIL_PAGE_TYPE,
+                    FIL_PAGE_TYPE_FSP_HDR);
+    byte* inodes = undo_usage_page(file, 2);
+    mach_write_to_2(inodes + FIL_PAGE_TYPE, FIL_PAGE_INODE);
+    const uint32_t inode20 = FSEG_ARR_OFFSET;
+    const uint32_t inode40 = FSEG_ARR_OFFSET + FSEG_INODE_SIZE;
+    build_inode(inodes, inode20, 3, 0);
+    build_inode(inodes, inode40, 2, 1);
+
+    byte* array = undo_usage_page(file, FSP_RSEG_ARRAY_PAGE_NO);
+    mach_write_to_2(array + FIL_PAGE_TYPE, FIL_PAGE_TYPE_RSEG_ARRAY);
+    mach_write_to_4(array + RSEG_ARRAY_HEADER + RSEG_ARRAY_VERSION_OFFSET,
+                    RSEG_ARRAY_VERSION);
+    byte* slots = array + RSEG_ARRAY_HEADER + RSEG_ARRAY_PAGES_OFFSET;
+    for (uint32_t slot = 0; slot < TRX_SYS_N_RSEGS; slot++) {
+        mach_write_to_4(slots + slot * RSEG_ARRAY_SLOT_SIZE, FIL_NULL);
+    }
+    mach_write_to_4(slots, 10);
+    mach_write_to_4(slots + 4 * RSEG_ARRAY_SLOT_SIZE, 11);
+
+    /* Rseg 0: an active segment of 3 pages and a reused cached one in its
+    slots, a segment of 2 pages to purge in its history */
+    byte* rseg = build_rseg_page(file, 10);
+    mach_write_to_4(rseg + TRX_RSEG + TRX_RSEG_UNDO_SLOTS, 20);
+    mach_write_to_4(rseg + TRX_RSEG + TRX_RSEG_UNDO_SLOTS + TRX_RSEG_SLOT_SIZE,
+                    30);
+    build_undo_segment(file, 20, TRX_UNDO_ACTIVE, 3, 1, inode20);
+    build_undo_page(file, 70, 20);
+    build_undo_page(file, 150, 70);
+    build_undo_segment(file, 30, TRX_UNDO_CACHED, 1, 2, 0);
+    build_undo_segment(file, 40, TRX_UNDO_TO_PURGE, 2, 1, inode40);
+    build_undo_page(file, 100, 40);
+    const uint32_t log = TRX_UNDO_SEG_HDR + TRX_UNDO_SEG_HDR_SIZE;
+    byte* base = rseg + TRX_RSEG + TRX_RSEG_HISTORY;
+    mach_write_to_4(base + FLST_LEN, 1);
+    write_usage_addr(base + FLST_FIRST, 40, log + TRX_UNDO_HISTORY_NODE);
+    write_usage_addr(base + FLST_LAST, 40, log + TRX_UNDO_HISTORY_NODE);
+    write_usage_addr(undo_usage_page(file, 40) + log + TRX_UNDO_HISTORY_NODE +
+                     FLST_NEXT, FIL_NULL, 0);
+
+    /* Rseg 4: one active segment */
+    rseg = build_rseg_page(file, 11);
+    mach_write_to_4(rseg + TRX_RSEG + TRX_RSEG_UNDO_SLOTS +
+                    5 * TRX_RSEG_SLOT_SIZE, 50);
+    build_undo_segment(file, 50, TRX_UNDO_ACTIVE, 1, 1, 0);
+
+    /* A segment of no rollback segment and undo pages of no segment */
+    build_undo_segment(file, 60, TRX_UNDO_TO_FREE, 1, 1, 0);
+    build_undo_page(file, 160, 199);
+    build_undo_page(file, 170, 171);
+    build_undo_page(file, 171, 170);
+
+    FILE* f = fopen(kUndoUsagePath, "wb");
+    fwrite(file.data(), 1, file.size(), f);
+    fclose(f);
+
+    check_undo_usage(1);
+    check_undo_usage(3);
+    unlink(kUndoUsagePath);
+}